@@ -59,6 +59,434 @@
 #include <time.h>
 #include <pthread.h>
 
+/* Number of unstable bytes buffered for all the files */
+static uint64_t cache_inode_unstable_total = 0;
+
+/* Incremented each time unstable data is dropped without being written */
+static unsigned int cache_inode_unstable_epoch = 0;
+
+/**
+ *
+ * cache_inode_unstable_account: updates the counters of unstable bytes.
+ *
+ * @param pentry [INOUT] the regular file whose unstable data changed.
+ * @param delta [IN] number of bytes added (or removed if negative).
+ *
+ * @return nothing (void function)
+ *
+ */
+static void cache_inode_unstable_account(cache_entry_t * pentry, int64_t delta)
+{
+  pentry->object.file.unstable_data.length += delta;
+  __sync_fetch_and_add(&cache_inode_unstable_total, (uint64_t) delta);
+}                               /* cache_inode_unstable_account */
+
+/**
+ *
+ * cache_inode_unstable_free_range: removes a range from the unstable data of a file.
+ *
+ * @param pentry [INOUT] the regular file.
+ * @param prange [IN] the range to be freed.
+ *
+ * @return nothing (void function)
+ *
+ */
+static void cache_inode_unstable_free_range(cache_entry_t * pentry,
+                                            cache_inode_unstable_range_t * prange)
+{
+  cache_inode_unstable_account(pentry, -(int64_t) prange->length);
+  glist_del(&prange->q);
+  Mem_Free(prange->buffer);
+  Mem_Free(prange);
+}                               /* cache_inode_unstable_free_range */
+
+/**
+ *
+ * cache_inode_unstable_init: initializes the unstable data of a regular file.
+ *
+ * @param pentry [INOUT] the regular file.
+ *
+ * @return nothing (void function)
+ *
+ */
+void cache_inode_unstable_init(cache_entry_t * pentry)
+{
+  init_glist(&pentry->object.file.unstable_data.ranges);
+  pentry->object.file.unstable_data.length = 0;
+}                               /* cache_inode_unstable_init */
+
+/**
+ *
+ * cache_inode_unstable_add: keeps an unstable write in memory until it is committed.
+ *
+ * The written range is merged with the ranges it overlaps or touches, so that
+ * sequential unstable writes end up in one large range that is flushed by a
+ * single FSAL write. Data of the new write takes precedence over the data
+ * already buffered. If the file or the server holds too much unstable data,
+ * the unstable data of the file is flushed first. The entry must be write
+ * locked by the caller.
+ *
+ * @param pentry [INOUT] the regular file.
+ * @param offset [IN] offset of the write.
+ * @param length [IN] length of the write.
+ * @param buffer [IN] the data to be written.
+ * @param pclient [IN] ressource allocated by the client for the nfs management.
+ * @param pcontext [IN] fsal context for the operation.
+ * @param pstatus [OUT] returned status, CACHE_INODE_NO_SPACE_LEFT if the write
+ *                      is too large to be buffered.
+ *
+ * @return the same as *pstatus
+ *
+ */
+cache_inode_status_t cache_inode_unstable_add(cache_entry_t * pentry,
+                                              uint64_t offset,
+                                              fsal_size_t length,
+                                              caddr_t buffer,
+                                              cache_inode_client_t * pclient,
+                                              fsal_op_context_t * pcontext,
+                                              cache_inode_status_t * pstatus)
+{
+  cache_inode_unstable_data_t *udata = &pentry->object.file.unstable_data;
+  cache_inode_unstable_range_t *prange = NULL;
+  cache_inode_unstable_range_t *pfirst = NULL;
+  struct glist_head *glist;
+  struct glist_head *glistn;
+  struct glist_head *pnext = &udata->ranges;
+  uint64_t end = offset + length;
+  uint64_t start;
+  uint64_t newlen;
+  uint64_t newsize;
+  uint64_t oldlen;
+  caddr_t newbuff;
+
+  *pstatus = CACHE_INODE_SUCCESS;
+
+  if(length == 0)
+    return *pstatus;
+
+  if(length > CACHE_INODE_UNSTABLE_BUFFERSIZE)
+    {
+      *pstatus = CACHE_INODE_NO_SPACE_LEFT;
+      return *pstatus;
+    }
+
+  /* Flush what is buffered for this file if the limits would be exceeded */
+  if((udata->length + length > CACHE_INODE_UNSTABLE_BUFFERSIZE) ||
+     (cache_inode_unstable_total + length > CACHE_INODE_UNSTABLE_MAX_TOTAL))
+    {
+      if(cache_inode_unstable_flush(pentry, 0, 0, pclient, pcontext, pstatus) !=
+         CACHE_INODE_SUCCESS)
+        return *pstatus;
+    }
+
+  /* Look for the first range that overlaps or touches [offset, end) */
+  glist_for_each(glist, &udata->ranges)
+    {
+      prange = glist_entry(glist, cache_inode_unstable_range_t, q);
+
+      if(prange->offset + prange->length < offset)
+        continue;
+
+      if(prange->offset <= end)
+        pfirst = prange;
+      else
+        pnext = glist;
+
+      break;
+    }
+
+  if(pfirst == NULL)
+    {
+      /* A new range, inserted before the first range located after it */
+      if((prange = (cache_inode_unstable_range_t *)
+          Mem_Alloc(sizeof(cache_inode_unstable_range_t))) == NULL)
+        {
+          *pstatus = CACHE_INODE_MALLOC_ERROR;
+          return *pstatus;
+        }
+
+      if((prange->buffer = Mem_Alloc_Label(length, "Cache_Inode Unstable Buffer")) == NULL)
+        {
+          Mem_Free(prange);
+          *pstatus = CACHE_INODE_MALLOC_ERROR;
+          return *pstatus;
+        }
+
+      prange->offset = offset;
+      prange->length = length;
+      prange->size = length;
+      memcpy(prange->buffer, buffer, length);
+
+      glist_add_tail(pnext, &prange->q);
+      cache_inode_unstable_account(pentry, length);
+
+      return *pstatus;
+    }
+
+  /* Compute the bounds of the merged range */
+  start = (offset < pfirst->offset) ? offset : pfirst->offset;
+  newlen = end - start;
+  for(glist = pfirst->q.next; glist != &udata->ranges; glist = glist->next)
+    {
+      prange = glist_entry(glist, cache_inode_unstable_range_t, q);
+
+      if(prange->offset > end)
+        break;
+
+      if(prange->offset + prange->length - start > newlen)
+        newlen = prange->offset + prange->length - start;
+    }
+  if(pfirst->offset + pfirst->length - start > newlen)
+    newlen = pfirst->offset + pfirst->length - start;
+
+  /* Get a buffer large enough for the merged range in the first range */
+  if(start < pfirst->offset)
+    {
+      if((newbuff = Mem_Alloc_Label(newlen, "Cache_Inode Unstable Buffer")) == NULL)
+        {
+          *pstatus = CACHE_INODE_MALLOC_ERROR;
+          return *pstatus;
+        }
+
+      memcpy(newbuff + (pfirst->offset - start), pfirst->buffer, pfirst->length);
+      Mem_Free(pfirst->buffer);
+      pfirst->buffer = newbuff;
+      pfirst->size = newlen;
+    }
+  else if(newlen > pfirst->size)
+    {
+      /* Grow geometrically, sequential writes are appended to the same range */
+      newsize = 2 * pfirst->size;
+      if(newsize < newlen)
+        newsize = newlen;
+      if(newsize > CACHE_INODE_UNSTABLE_BUFFERSIZE)
+        newsize = newlen;
+
+      if((newbuff = Mem_Realloc_Label(pfirst->buffer, newsize,
+                                      "Cache_Inode Unstable Buffer")) == NULL)
+        {
+          *pstatus = CACHE_INODE_MALLOC_ERROR;
+          return *pstatus;
+        }
+
+      pfirst->buffer = newbuff;
+      pfirst->size = newsize;
+    }
+
+  oldlen = pfirst->length;
+  pfirst->length = (pfirst->offset - start) + pfirst->length;
+  pfirst->offset = start;
+
+  /* Move the data of the following merged ranges into the first one */
+  glist_for_each_safe(glist, glistn, &udata->ranges)
+    {
+      prange = glist_entry(glist, cache_inode_unstable_range_t, q);
+
+      if(prange == pfirst || prange->offset < start)
+        continue;
+
+      if(prange->offset > end)
+        break;
+
+      memcpy(pfirst->buffer + (prange->offset - start), prange->buffer, prange->length);
+      cache_inode_unstable_free_range(pentry, prange);
+    }
+
+  /* The new data overwrites what was buffered */
+  memcpy(pfirst->buffer + (offset - start), buffer, length);
+  pfirst->length = newlen;
+  cache_inode_unstable_account(pentry, (int64_t) newlen - (int64_t) oldlen);
+
+  return *pstatus;
+}                               /* cache_inode_unstable_add */
+
+/**
+ *
+ * cache_inode_unstable_flush: writes the unstable data of a file to the FSAL.
+ *
+ * Every range that intersects [offset, offset + count) is written as a whole
+ * and then freed. A range that could not be written is kept for a later
+ * attempt. The entry must be write locked by the caller.
+ *
+ * @param pentry [INOUT] the regular file.
+ * @param offset [IN] beginning of the area to be flushed.
+ * @param count [IN] length of the area, 0 or 0xFFFFFFFF for the whole file.
+ * @param pclient [IN] ressource allocated by the client for the nfs management.
+ * @param pcontext [IN] fsal context for the operation.
+ * @param pstatus [OUT] returned status.
+ *
+ * @return the same as *pstatus
+ *
+ */
+cache_inode_status_t cache_inode_unstable_flush(cache_entry_t * pentry,
+                                                uint64_t offset,
+                                                fsal_size_t count,
+                                                cache_inode_client_t * pclient,
+                                                fsal_op_context_t * pcontext,
+                                                cache_inode_status_t * pstatus)
+{
+  cache_inode_unstable_data_t *udata = &pentry->object.file.unstable_data;
+  cache_inode_unstable_range_t *prange;
+  struct glist_head *glist;
+  struct glist_head *glistn;
+  fsal_status_t fsal_status;
+  fsal_attrib_list_t post_write_attr;
+  fsal_seek_t seek_descriptor;
+  fsal_size_t done;
+  fsal_size_t io_size;
+  cache_inode_status_t status;
+  uint64_t end = offset + count;
+
+  *pstatus = CACHE_INODE_SUCCESS;
+
+  if(glist_empty(&udata->ranges))
+    return *pstatus;
+
+  if(count == 0 || count == 0xFFFFFFFFL)
+    end = (uint64_t) - 1;
+
+  if(cache_inode_open(pentry, pclient, FSAL_O_WRONLY, pcontext, pstatus) !=
+     CACHE_INODE_SUCCESS)
+    return *pstatus;
+
+  glist_for_each_safe(glist, glistn, &udata->ranges)
+    {
+      prange = glist_entry(glist, cache_inode_unstable_range_t, q);
+
+      if(prange->offset + prange->length <= offset)
+        continue;
+
+      if(prange->offset >= end)
+        break;
+
+      seek_descriptor.whence = FSAL_SEEK_SET;
+      for(done = 0; done < prange->length; done += io_size)
+        {
+          seek_descriptor.offset = prange->offset + done;
+          io_size = 0;
+#ifdef _USE_MFSL
+          fsal_status = MFSL_write(&(pentry->object.file.open_fd.mfsl_fd),
+                                   &seek_descriptor, prange->length - done,
+                                   prange->buffer + done, &io_size,
+                                   &pclient->mfsl_context, NULL);
+#else
+          fsal_status = FSAL_write(&(pentry->object.file.open_fd.fd),
+                                   &seek_descriptor, prange->length - done,
+                                   prange->buffer + done, &io_size);
+#endif
+          if(FSAL_IS_ERROR(fsal_status) || io_size == 0)
+            break;
+        }
+
+      if(done < prange->length)
+        {
+          LogMajor(COMPONENT_CACHE_INODE,
+                   "cache_inode_unstable_flush: FSAL_write failed, fsal_status.major = %d, %llu unstable bytes kept for entry %p",
+                   fsal_status.major, (unsigned long long)udata->length, pentry);
+
+          *pstatus = FSAL_IS_ERROR(fsal_status) ?
+              cache_inode_error_convert(fsal_status) : CACHE_INODE_IO_ERROR;
+          break;
+        }
+
+      cache_inode_unstable_free_range(pentry, prange);
+    }
+
+  if(cache_inode_close(pentry, pclient, &status) != CACHE_INODE_SUCCESS)
+    LogEvent(COMPONENT_CACHE_INODE,
+             "cache_inode_unstable_flush: cache_inode_close = %d", status);
+
+  /* Update the size with what is now in the FSAL */
+  post_write_attr.asked_attributes = FSAL_ATTR_SIZE | FSAL_ATTR_SPACEUSED;
+  fsal_status = FSAL_getattrs(&(pentry->object.file.handle), pcontext, &post_write_attr);
+  if(!FSAL_IS_ERROR(fsal_status))
+    {
+      if(post_write_attr.filesize > pentry->object.file.attributes.filesize)
+        pentry->object.file.attributes.filesize = post_write_attr.filesize;
+      pentry->object.file.attributes.spaceused = post_write_attr.spaceused;
+    }
+
+  return *pstatus;
+}                               /* cache_inode_unstable_flush */
+
+/**
+ *
+ * cache_inode_unstable_truncate: drops the unstable data located after a new end of file.
+ *
+ * The entry must be write locked by the caller.
+ *
+ * @param pentry [INOUT] the regular file.
+ * @param length [IN] the new size of the file.
+ *
+ * @return nothing (void function)
+ *
+ */
+void cache_inode_unstable_truncate(cache_entry_t * pentry, uint64_t length)
+{
+  cache_inode_unstable_range_t *prange;
+  struct glist_head *glist;
+  struct glist_head *glistn;
+
+  glist_for_each_safe(glist, glistn, &pentry->object.file.unstable_data.ranges)
+    {
+      prange = glist_entry(glist, cache_inode_unstable_range_t, q);
+
+      if(prange->offset >= length)
+        cache_inode_unstable_free_range(pentry, prange);
+      else if(prange->offset + prange->length > length)
+        {
+          cache_inode_unstable_account(pentry,
+                                       -(int64_t) (prange->offset + prange->length - length));
+          prange->length = length - prange->offset;
+        }
+    }
+}                               /* cache_inode_unstable_truncate */
+
+/**
+ *
+ * cache_inode_unstable_release: frees the unstable data of a file that leaves the cache.
+ *
+ * If some data is dropped this way, the write verifier epoch is changed so
+ * that the clients send their uncommitted writes again.
+ *
+ * @param pentry [INOUT] the regular file.
+ *
+ * @return nothing (void function)
+ *
+ */
+void cache_inode_unstable_release(cache_entry_t * pentry)
+{
+  struct glist_head *glist;
+  struct glist_head *glistn;
+
+  if(glist_empty(&pentry->object.file.unstable_data.ranges))
+    return;
+
+  LogEvent(COMPONENT_CACHE_INODE,
+           "cache_inode_unstable_release: %llu unstable bytes dropped for entry %p",
+           (unsigned long long)pentry->object.file.unstable_data.length, pentry);
+
+  glist_for_each_safe(glist, glistn, &pentry->object.file.unstable_data.ranges)
+    cache_inode_unstable_free_range(pentry,
+                                    glist_entry(glist, cache_inode_unstable_range_t, q));
+
+  __sync_fetch_and_add(&cache_inode_unstable_epoch, 1);
+}                               /* cache_inode_unstable_release */
+
+/**
+ *
+ * cache_inode_unstable_get_epoch: returns the number of times unstable data was dropped.
+ *
+ * It is to be mixed into the write verifier.
+ *
+ * @return the current epoch.
+ *
+ */
+unsigned int cache_inode_unstable_get_epoch(void)
+{
+  return cache_inode_unstable_epoch;
+}                               /* cache_inode_unstable_get_epoch */
+
 /**
  *
  * cache_inode_commit: commits a write operation on unstable storage
@@ -95,10 +523,6 @@ cache_inode_commit(cache_entry_t * pentry,
                    cache_inode_status_t * pstatus)
 {
     cache_inode_status_t status;
-    fsal_seek_t seek_descriptor;
-    fsal_size_t size_io_done;
-    fsal_boolean_t eof;
-    cache_inode_unstable_data_t *udata;
     fsal_status_t fsal_status;
 
     /* Do not use this function is Data Cache is used */
@@ -124,7 +548,7 @@ cache_inode_commit(cache_entry_t * pentry,
           V_w(&pentry->lock);
           
           /* stats */
-          pclient->stat.func_stats.nb_err_unrecover[CACHE_INODE_COMMIT] += 1;
+          inc_func_err_unrecover(pclient, CACHE_INODE_COMMIT);
           
           return *pstatus;
         }
@@ -148,7 +572,7 @@ cache_inode_commit(cache_entry_t * pentry,
         V_w(&pentry->lock);
 
         /* stats */
-        pclient->stat.func_stats.nb_err_unrecover[CACHE_INODE_COMMIT] += 1;
+        inc_func_err_unrecover(pclient, CACHE_INODE_COMMIT);
 
         *pstatus = CACHE_INODE_FSAL_ERROR;
         return *pstatus;
@@ -165,7 +589,7 @@ cache_inode_commit(cache_entry_t * pentry,
           V_w(&pentry->lock);
           
           /* stats */
-          pclient->stat.func_stats.nb_err_unrecover[CACHE_INODE_COMMIT] += 1;
+          inc_func_err_unrecover(pclient, CACHE_INODE_COMMIT);
           
           return *pstatus;
         }
@@ -178,55 +602,25 @@ cache_inode_commit(cache_entry_t * pentry,
      * will either be writing to the buffer, or writing a stable write to the
      * file system if the buffer is already full. */
 
-    udata = &pentry->object.file.unstable_data;
-    if(udata->buffer == NULL)
-        {
-            *pstatus = CACHE_INODE_SUCCESS;
-            return *pstatus;
-        }
-    if(count == 0 || count == 0xFFFFFFFFL)
-        {
-            /* Count = 0 means "flush all data to permanent storage */
-            seek_descriptor.offset = udata->offset;
-            seek_descriptor.whence = FSAL_SEEK_SET;
+    P_w(&pentry->lock);
 
-            status = cache_inode_rdwr(pentry,
-                                      CACHE_INODE_WRITE,
-                                      &seek_descriptor, udata->length,
-                                      &size_io_done, pfsal_attr,
-                                      udata->buffer, &eof, ht,
-                                      pclient, pcontext, TRUE, pstatus);
-            if (status != CACHE_INODE_SUCCESS)
-                return *pstatus;
+    /* Count = 0 means "flush all data to permanent storage" */
+    if(cache_inode_unstable_flush(pentry, offset, count,
+                                  pclient, pcontext, pstatus) != CACHE_INODE_SUCCESS)
+      {
+        V_w(&pentry->lock);
 
-            P_w(&pentry->lock);
+        /* stats */
+        inc_func_err_unrecover(pclient, CACHE_INODE_COMMIT);
 
-            Mem_Free(udata->buffer);
-            udata->buffer = NULL;
+        return *pstatus;
+      }
+
+    if(pfsal_attr != NULL)
+      *pfsal_attr = pentry->object.file.attributes;
+
+    V_w(&pentry->lock);
 
-            V_w(&pentry->lock);
-        }
-    else
-        {
-            if(offset < udata->offset)
-                {
-                    *pstatus = CACHE_INODE_INVALID_ARGUMENT;
-                    return *pstatus;
-                }
-
-            seek_descriptor.offset = offset;
-            seek_descriptor.whence = FSAL_SEEK_SET;
-
-            return cache_inode_rdwr(pentry,
-                                    CACHE_INODE_WRITE,
-                                    &seek_descriptor,
-                                    count,
-                                    &size_io_done,
-                                    pfsal_attr,
-                                    (char *)(udata->buffer + offset - udata->offset),
-                                    &eof, ht, pclient,
-                                    pcontext, TRUE, pstatus);
-    }
   /* Regulat exit */
   *pstatus = CACHE_INODE_SUCCESS;
   return *pstatus;
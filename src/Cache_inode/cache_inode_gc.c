@@ -100,14 +100,6 @@ static int cache_inode_gc_clean_entry(cache_entry_t * pentry,
                (caddr_t)pthread_self(),
                pentry, pentry->internal_md.type);
 
-  /* sanity check */
-  if((pentry->gc_lru_entry != NULL) &&
-     ((cache_entry_t *) pentry->gc_lru_entry->buffdata.pdata) != pentry)
-    {
-      LogCrit(COMPONENT_CACHE_INODE_GC,
-              "cache_inode_gc_clean_entry: LRU entry pointed by this pentry doesn't match the GC LRU");
-    }
-
   /* Get the FSAL handle */
   if((pfsal_handle = cache_inode_get_fsal_handle(pentry, &status)) == NULL)
     {
@@ -187,7 +179,7 @@ static int cache_inode_gc_clean_entry(cache_entry_t * pentry,
     {
       parent_iter_next = parent_iter->next_parent;
 
-      ReleaseToPool(parent_iter, &pgcparam->pclient->pool_parent);
+      CACHE_INODE_RELEASE_TO_POOL(parent_iter, pgcparam->pclient, pool_parent);
 
       parent_iter = parent_iter_next;
     }
@@ -195,17 +187,26 @@ static int cache_inode_gc_clean_entry(cache_entry_t * pentry,
   LogFullDebug(COMPONENT_CACHE_INODE_GC,
                "++++> parent directory sent back to pool");
 
+  if(pentry->internal_md.type == REGULAR_FILE)
+    {
+      cache_inode_unstable_release(pentry);
+      cache_inode_readahead_release(pentry);
+    }
+
   /* If entry is a DIR_CONTINUE or a DIR_BEGINNING, release pdir_data */
   if(pentry->internal_md.type == DIR_BEGINNING)
     {
       /* Put the pentry back to the pool */
-      ReleaseToPool(pentry->object.dir_begin.pdir_data, &pgcparam->pclient->pool_dir_data);
+      CACHE_INODE_RELEASE_TO_POOL(pentry->object.dir_begin.pdir_data, pgcparam->pclient,
+                                  pool_dir_data);
+      cache_inode_dirent_index_release(pentry);
     }
 
   if(pentry->internal_md.type == DIR_CONTINUE)
     {
       /* Put the pentry back to the pool */
-      ReleaseToPool(pentry->object.dir_cont.pdir_data, &pgcparam->pclient->pool_dir_data);
+      CACHE_INODE_RELEASE_TO_POOL(pentry->object.dir_cont.pdir_data, pgcparam->pclient,
+                                  pool_dir_data);
     }
   LogFullDebug(COMPONENT_CACHE_INODE_GC,
                "++++> pdir_data (if needed) sent back to pool");
@@ -217,7 +218,10 @@ static int cache_inode_gc_clean_entry(cache_entry_t * pentry,
 
   /* Release symlink, if applicable */
   if (pentry->internal_md.type == SYMBOLIC_LINK)
-    cache_inode_release_symlink(pentry, &pgcparam->pclient->pool_entry_symlink);
+    cache_inode_release_symlink(pentry, pgcparam->pclient);
+
+  /* The entry is no more to be seen by the garbage collector */
+  cache_inode_lru_remove(pentry);
 
   /* Free and Destroy the mutex associated with the pentry */
   V_w(&pentry->lock);
@@ -225,7 +229,7 @@ static int cache_inode_gc_clean_entry(cache_entry_t * pentry,
   cache_inode_mutex_destroy(pentry);
 
   /* Put the pentry back to the pool */
-  ReleaseToPool(pentry, &pgcparam->pclient->pool_entry);
+  CACHE_INODE_RELEASE_TO_POOL(pentry, pgcparam->pclient, pool_entry);
 
   /* Regular exit */
   pgcparam->nb_to_be_purged = pgcparam->nb_to_be_purged - 1;
@@ -252,6 +256,7 @@ static int cache_inode_gc_invalidate_related_dirent(cache_entry_t * pentry,
                                                     cache_inode_param_gc_t * pgcparam)
 {
   cache_inode_parent_entry_t *parent_iter = NULL;
+  cache_entry_t *pdir_begin = NULL;
 
   /* Set the cache status as INVALID in the directory entries */
   for(parent_iter = pentry->parent_list; parent_iter != NULL;
@@ -293,12 +298,9 @@ static int cache_inode_gc_invalidate_related_dirent(cache_entry_t * pentry,
             }
           else
             {
-              parent_iter->parent->object.dir_begin.pdir_data->dir_entries[parent_iter->
-                                                                           subdirpos].
-                  active = INVALID;
+              cache_inode_dirent_invalidate(parent_iter->parent, parent_iter->subdirpos);
               /* Garbage invalidates the effet of the readdir previously made */
               parent_iter->parent->object.dir_begin.has_been_readdir = CACHE_INODE_NO;
-              parent_iter->parent->object.dir_begin.nbactive -= 1;
             }
         }
       else
@@ -314,10 +316,12 @@ static int cache_inode_gc_invalidate_related_dirent(cache_entry_t * pentry,
             }
           else
             {
-              parent_iter->parent->object.dir_cont.pdir_data->dir_entries[parent_iter->
-                                                                          subdirpos].
-                  active = INVALID;
-              parent_iter->parent->object.dir_cont.nbactive -= 1;
+              /* The name index is in the DIR_BEGINNING, readers use it
+               * under the lock of that entry, not the lock of the chunk */
+              pdir_begin = parent_iter->parent->object.dir_cont.pdir_begin;
+              P_w(&pdir_begin->lock);
+              cache_inode_dirent_invalidate(parent_iter->parent, parent_iter->subdirpos);
+              V_w(&pdir_begin->lock);
             }
         }
 
@@ -337,8 +341,7 @@ static int cache_inode_gc_invalidate_related_dirent(cache_entry_t * pentry,
  *
  * @return LRU_LIST_SET_INVALID if entry is successfully suppressed, LRU_LIST_DO_NOT_SET_INVALID otherwise
  *
- * @see LRU_invalidate_by_function
- * @see LRU_gc_invalid
+ * @see cache_inode_lru_apply
  *
  */
 int cache_inode_gc_suppress_file(cache_entry_t * pentry,
@@ -346,6 +349,14 @@ int cache_inode_gc_suppress_file(cache_entry_t * pentry,
 {
   P_w(&pentry->lock);
 
+  /* A file with uncommitted unstable data stays in cache until it is committed */
+  if(pentry->internal_md.type == REGULAR_FILE &&
+     !glist_empty(&pentry->object.file.unstable_data.ranges))
+    {
+      V_w(&pentry->lock);
+      return LRU_LIST_DO_NOT_SET_INVALID;
+    }
+
   LogFullDebug(COMPONENT_CACHE_INODE_GC,
                "Entry %p (REGULAR_FILE/SYMBOLIC_LINK) will be garbaged",
                pentry);
@@ -383,8 +394,7 @@ int cache_inode_gc_suppress_file(cache_entry_t * pentry,
  *
  * @return 1 if entry is successfully suppressed, 0 otherwise
  *
- * @see LRU_invalidate_by_function
- * @see LRU_gc_invalid
+ * @see cache_inode_lru_apply
  *
  */
 int cache_inode_gc_suppress_directory(cache_entry_t * pentry,
@@ -457,25 +467,21 @@ int cache_inode_gc_suppress_directory(cache_entry_t * pentry,
  * If entry is invalidated, does the cleaning stuff on it.
  *
  * @param pentry [IN] pointer to the entry to test
+ * @param pgcparam [INOUT] gc parameters.
  *
- * @return 1 if entry must be set invalid, 0 if not.
+ * @return LRU_LIST_SET_INVALID if entry was garbaged, LRU_LIST_DO_NOT_SET_INVALID if not.
  *
- * @see LRU_invalidate_by_function
- * @see LRU_gc_invalid
+ * @see cache_inode_lru_apply
  *
  */
-int cache_inode_gc_function(LRU_entry_t * plru_entry, void *addparam)
+static int cache_inode_gc_function(cache_entry_t * pentry,
+                                   cache_inode_param_gc_t * pgcparam)
 {
   time_t entry_time = 0;
   time_t current_time = time(NULL);
-  cache_entry_t *pentry = NULL;
-  cache_inode_param_gc_t *pgcparam = (cache_inode_param_gc_t *) addparam;
 
   time_t allocated;
 
-  /* Get the entry */
-  pentry = (cache_entry_t *) (plru_entry->buffdata.pdata);
-
   /* Get the entry time (the larger value in read_time and mod_time ) */
   if(pentry->internal_md.read_time > pentry->internal_md.mod_time)
     entry_time = pentry->internal_md.read_time;
@@ -572,20 +578,20 @@ cache_inode_gc_policy_t cache_inode_get_gc_policy(void)
 
 /**
  *
- * cache_inode_gc: Perform garbbage collection on the ressources managed by a client.
+ * cache_inode_gc: Perform garbbage collection on the cache_inode entries.
  *
- * Perform garbbage collection on the ressources managed by a client.
+ * Perform garbbage collection on the cache_inode entries. The oldest entries of
+ * the global LRU are garbaged, according to the gc policy, until the low water
+ * mark is reached. This is called by the reaper thread.
  *
  * @param ht      [INOUT] the hashtable used to stored the cache_inode entries.
  * @param pclient [INOUT] ressource allocated by the client for the nfs management.
  * @param pstatus [OUT]   returned status.
  *
  * @return CACHE_INODE_SUCCESS if operation is a success \n
- * @return CACHE_INODE_LRU_ERROR if allocation error occured when validating the entry
  *
  * @see HashTable_GetSize
- * @see LRU_invalidate_by_function
- * @see LRU_gc_invalid
+ * @see cache_inode_lru_apply
  *
  */
 cache_inode_status_t cache_inode_gc(hash_table_t * ht,
@@ -594,96 +600,50 @@ cache_inode_status_t cache_inode_gc(hash_table_t * ht,
 {
   cache_inode_param_gc_t gcparam;
   unsigned int hash_size;
-  unsigned int invalid_before_gc = 0;
-  unsigned int invalid_after_gc = 0;
+  unsigned int nb_seen;
 
   /* Set the return default to CACHE_INODE_SUCCESS */
   *pstatus = CACHE_INODE_SUCCESS;
 
-  /* Is this time to gc ? */
-  if(pclient->call_since_last_gc < cache_inode_gc_policy.nb_call_before_gc)
-    return *pstatus;
-
-  if(time(NULL) - pclient->time_of_last_gc < (int)(cache_inode_gc_policy.run_interval))
-    return *pstatus;
-
-  /* Actual GC will be made */
-  pclient->call_since_last_gc = 0;
-  pclient->time_of_last_gc = time(NULL);
-
   LogInfo(COMPONENT_CACHE_INODE_GC, "Checking if garbage collection is needed");
 
   /* 1st ; we get the hash table size to see if garbage is required */
   hash_size = HashTable_GetSize(ht);
 
-  if(hash_size > cache_inode_gc_policy.hwmark_nb_entries)
-    {
-      /*
-       * Garbage collection is made in several steps
-       *    1- Set the oldest entry as invalid and garbage their contents
-       *    2- Free the invalid entry in the LRU
-       *
-       *    Behaviour: - A DIR_BEGINNING is garbaged with all its DIR_CONTINUE associated
-       *               - A directory is garbaged when all its entries are garbaged
-       *
-       */
-
-      gcparam.ht = ht;
-      gcparam.pclient = pclient;
-      gcparam.nb_to_be_purged = hash_size - cache_inode_gc_policy.lwmark_nb_entries;    /* try to purge until lw mark is reached */
-
-      LogInfo(COMPONENT_CACHE_INODE_GC,
-              "Garbage collection started (to be purged=%u, LRU size=%u)",
-              pclient->lru_gc->nb_entry, gcparam.nb_to_be_purged);
-
-      invalid_before_gc = pclient->lru_gc->nb_invalid;
-      if(LRU_invalidate_by_function
-         (pclient->lru_gc, cache_inode_gc_function, (void *)&gcparam) != LRU_LIST_SUCCESS)
-        {
-          *pstatus = CACHE_INODE_LRU_ERROR;
-          return *pstatus;
-        }
+  if(hash_size <= cache_inode_gc_policy.hwmark_nb_entries)
+    return *pstatus;
 
-      invalid_after_gc = pclient->lru_gc->nb_invalid;
+  /*
+   * Garbage collection is made on the oldest entries of each LRU lane.
+   *
+   *    Behaviour: - A DIR_BEGINNING is garbaged with all its DIR_CONTINUE associated
+   *               - A directory is garbaged when all its entries are garbaged
+   *
+   */
 
-      /* Removes the LRU entries and put them back to the pool */
-      if(LRU_gc_invalid(pclient->lru_gc, NULL) != LRU_LIST_SUCCESS)
-        {
-          *pstatus = CACHE_INODE_LRU_ERROR;
-          return *pstatus;
-        }
+  gcparam.ht = ht;
+  gcparam.pclient = pclient;
+  gcparam.nb_to_be_purged = hash_size - cache_inode_gc_policy.lwmark_nb_entries;        /* try to purge until lw mark is reached */
 
-      LogInfo(COMPONENT_CACHE_INODE_GC,
-              "Garbage collection finished, %u entries removed",
-              invalid_after_gc - invalid_before_gc);
+  LogInfo(COMPONENT_CACHE_INODE_GC,
+          "Garbage collection started (to be purged=%u, LRU size=%u)",
+          gcparam.nb_to_be_purged, cache_inode_lru_count());
 
-      *pstatus = CACHE_INODE_SUCCESS;
-    }
-  else
-    {
-      /* no garbage is required, just gets ride of the invalid in tyhe LRU list */
-      /* Removes the LRU entries and put them back to the pool */
-      if(LRU_gc_invalid(pclient->lru_gc, NULL) != LRU_LIST_SUCCESS)
-        {
-          *pstatus = CACHE_INODE_LRU_ERROR;
-          return *pstatus;
-        }
-      else
-        *pstatus = CACHE_INODE_SUCCESS;
-    }
+  nb_seen = cache_inode_lru_apply(cache_inode_gc_function, &gcparam);
+
+  LogInfo(COMPONENT_CACHE_INODE_GC,
+          "Garbage collection finished, %u entries removed (%u seen)",
+          hash_size - cache_inode_gc_policy.lwmark_nb_entries - gcparam.nb_to_be_purged,
+          nb_seen);
 
   return *pstatus;
 }                               /* cache_inode_gc */
 
-int cache_inode_gc_fd_func(LRU_entry_t * plru_entry, void *addparam)
+static int cache_inode_gc_fd_func(cache_entry_t * pentry,
+                                  cache_inode_param_gc_t * pgcparam)
 {
-  cache_entry_t *pentry = NULL;
-  cache_inode_param_gc_t *pgcparam = (cache_inode_param_gc_t *) addparam;
   cache_inode_status_t status;
 
-  /* Get the entry */
-  pentry = (cache_entry_t *) (plru_entry->buffdata.pdata);
-
   /* check if a file descriptor is opened on the file for a long time */
 
   if((pentry->internal_md.type == REGULAR_FILE)
@@ -697,11 +657,8 @@ int cache_inode_gc_fd_func(LRU_entry_t * plru_entry, void *addparam)
       pgcparam->nb_to_be_purged--;
     }
 
-  /* return true for continuing */
-  if(pgcparam->nb_to_be_purged == 0)
-    return FALSE;
-  else
-    return TRUE;
+  /* The entry is kept in the cache */
+  return LRU_LIST_DO_NOT_SET_INVALID;
 }
 
 /**
@@ -727,12 +684,7 @@ cache_inode_status_t cache_inode_gc_fd(cache_inode_client_t * pclient,
   gcparam.pclient = pclient;
   gcparam.nb_to_be_purged = pclient->max_fd_per_thread;
 
-  if(LRU_apply_function(pclient->lru_gc, cache_inode_gc_fd_func, (void *)&gcparam) !=
-     LRU_LIST_SUCCESS)
-    {
-      *pstatus = CACHE_INODE_LRU_ERROR;
-      return *pstatus;
-    }
+  cache_inode_lru_apply(cache_inode_gc_fd_func, &gcparam);
 
   LogDebug(COMPONENT_CACHE_INODE_GC,
            "File descriptor GC: %u files closed",
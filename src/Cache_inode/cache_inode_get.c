@@ -129,7 +129,7 @@ cache_entry_t *cache_inode_get_located(cache_inode_fsal_data_t * pfsdata,
   /* cache_invalidate calls this with no context or client */
   if (pclient) {
     pclient->stat.nb_call_total += 1;
-    pclient->stat.func_stats.nb_call[CACHE_INODE_GET] += 1;
+    inc_func_call(pclient, CACHE_INODE_GET);
   }
 
   /* Turn the input to a hash key */
@@ -140,7 +140,7 @@ cache_entry_t *cache_inode_get_located(cache_inode_fsal_data_t * pfsdata,
       /* stats */
       /* cache_invalidate calls this with no context or client */
       if (pclient) {
-	pclient->stat.func_stats.nb_err_unrecover[CACHE_INODE_GET] += 1;
+	inc_func_err_unrecover(pclient, CACHE_INODE_GET);
 	ppoolfsdata = (cache_inode_fsal_data_t *) key.pdata;
 	ReleaseToPool(ppoolfsdata, &pclient->pool_key);
       }
@@ -214,7 +214,7 @@ cache_entry_t *cache_inode_get_located(cache_inode_fsal_data_t * pfsdata,
             }
 
           /* stats */
-          pclient->stat.func_stats.nb_err_unrecover[CACHE_INODE_GET] += 1;
+          inc_func_err_unrecover(pclient, CACHE_INODE_GET);
 
           /* Free this key */
           cache_inode_release_fsaldata_key(&key, pclient);
@@ -228,7 +228,7 @@ cache_entry_t *cache_inode_get_located(cache_inode_fsal_data_t * pfsdata,
           *pstatus = CACHE_INODE_FSAL_ERROR;
 
           /* stats */
-          pclient->stat.func_stats.nb_err_unrecover[CACHE_INODE_GET] += 1;
+          inc_func_err_unrecover(pclient, CACHE_INODE_GET);
 
           /* Free this key */
           cache_inode_release_fsaldata_key(&key, pclient);
@@ -251,7 +251,7 @@ cache_entry_t *cache_inode_get_located(cache_inode_fsal_data_t * pfsdata,
               *pstatus = cache_inode_error_convert(fsal_status);
 
               /* stats */
-              pclient->stat.func_stats.nb_err_unrecover[CACHE_INODE_GET] += 1;
+              inc_func_err_unrecover(pclient, CACHE_INODE_GET);
 
               /* Free this key */
               cache_inode_release_fsaldata_key(&key, pclient);
@@ -287,7 +287,7 @@ cache_entry_t *cache_inode_get_located(cache_inode_fsal_data_t * pfsdata,
                                          pstatus)) == NULL)
         {
           /* stats */
-          pclient->stat.func_stats.nb_err_unrecover[CACHE_INODE_GET] += 1;
+          inc_func_err_unrecover(pclient, CACHE_INODE_GET);
 
           /* Free this key */
           cache_inode_release_fsaldata_key(&key, pclient);
@@ -313,7 +313,7 @@ cache_entry_t *cache_inode_get_located(cache_inode_fsal_data_t * pfsdata,
       }
 
       /* stats */
-      pclient->stat.func_stats.nb_err_unrecover[CACHE_INODE_GET] += 1;
+      inc_func_err_unrecover(pclient, CACHE_INODE_GET);
 
       /* Free this key */
       cache_inode_release_fsaldata_key(&key, pclient);
@@ -350,7 +350,7 @@ cache_entry_t *cache_inode_get_located(cache_inode_fsal_data_t * pfsdata,
    }
 
   /* stats */
-  pclient->stat.func_stats.nb_success[CACHE_INODE_GET] += 1;
+  inc_func_success(pclient, CACHE_INODE_GET);
 
   /* Free this key */
   cache_inode_release_fsaldata_key(&key, pclient);
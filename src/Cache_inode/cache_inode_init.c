@@ -56,6 +56,7 @@
 #include <sys/param.h>
 #include <time.h>
 #include <pthread.h>
+#include <string.h>
 
 /**
  *
@@ -76,6 +77,9 @@ hash_table_t *cache_inode_init(cache_inode_parameter_t param,
 
   ht = HashTable_Init(param.hparam);
 
+  /* The LRU used for garbage collection is shared by all the clients */
+  cache_inode_lru_init();
+
   if(ht != NULL)
     *pstatus = CACHE_INODE_SUCCESS;
   else
@@ -103,16 +107,19 @@ int cache_inode_client_init(cache_inode_client_t * pclient,
                             cache_inode_client_parameter_t param,
                             int thread_index, void *pworker_data)
 {
-  LRU_status_t lru_status;
   char name[256];
 
   if(thread_index < SMALL_CLIENT_INDEX)
     sprintf(name, "Cache Inode Worker #%d", thread_index);
   else if(thread_index == SMALL_CLIENT_INDEX)
     sprintf(name, "Cache Inode Small Client");
+  else if(thread_index == REAPER_THREAD_INDEX)
+    sprintf(name, "Cache Inode Reaper");
   else
     sprintf(name, "Cache Inode NLM Async #%d", thread_index - NLM_THREAD_INDEX);
 
+  memset(&pclient->stat, 0, sizeof(cache_inode_stat_t));
+
   pclient->attrmask = param.attrmask;
   pclient->nb_prealloc = param.nb_prealloc_entry;
   pclient->nb_pre_dir_data = param.nb_pre_dir_data;
@@ -131,10 +138,6 @@ int cache_inode_client_init(cache_inode_client_t * pclient,
   pclient->retention = param.retention;
   pclient->max_fd_per_thread = param.max_fd_per_thread;
 
-  /* introducing desynchronisation for GC */
-  pclient->time_of_last_gc = time(NULL) + thread_index * 20;
-  pclient->call_since_last_gc = thread_index * 20;
-
   pclient->time_of_last_gc_fd = time(NULL);
 
   MakePool(&pclient->pool_entry, pclient->nb_prealloc, cache_entry_t, NULL, NULL);
@@ -222,15 +225,6 @@ int cache_inode_client_init(cache_inode_client_t * pclient,
       return 1;
     }
 
-  param.lru_param.name = name;
-
-  if((pclient->lru_gc = LRU_Init(param.lru_param, &lru_status)) == NULL)
-    {
-      LogCrit(COMPONENT_CACHE_INODE,
-              "Can't init %s lru gc", name);
-      return 1;
-    }
-
   /* Everything was ok, return 0 */
   return 0;
 }                               /* cache_inode_client_init */
@@ -111,7 +111,7 @@ cache_inode_status_t cache_inode_link(cache_entry_t * pentry_src,
 
   /* stats */
   pclient->stat.nb_call_total += 1;
-  pclient->stat.func_stats.nb_call[CACHE_INODE_LINK] += 1;
+  inc_func_call(pclient, CACHE_INODE_LINK);
 
   /* Is the destination a directory ? */
   if(pentry_dir_dest->internal_md.type != DIR_BEGINNING &&
@@ -119,7 +119,7 @@ cache_inode_status_t cache_inode_link(cache_entry_t * pentry_src,
     {
       /* Bad type .... */
       *pstatus = CACHE_INODE_BAD_TYPE;
-      pclient->stat.func_stats.nb_err_unrecover[CACHE_INODE_LINK] += 1;
+      inc_func_err_unrecover(pclient, CACHE_INODE_LINK);
 
       return *pstatus;
     }
@@ -134,7 +134,7 @@ cache_inode_status_t cache_inode_link(cache_entry_t * pentry_src,
       *pstatus = status;
 
       /* stats */
-      pclient->stat.func_stats.nb_err_unrecover[CACHE_INODE_LINK] += 1;
+      inc_func_err_unrecover(pclient, CACHE_INODE_LINK);
 
       /* pentry is a directory */
       return *pstatus;
@@ -148,7 +148,7 @@ cache_inode_status_t cache_inode_link(cache_entry_t * pentry_src,
     {
       /* There exists such an entry... */
       *pstatus = CACHE_INODE_ENTRY_EXISTS;
-      pclient->stat.func_stats.nb_err_unrecover[CACHE_INODE_LINK] += 1;
+      inc_func_err_unrecover(pclient, CACHE_INODE_LINK);
 
       return *pstatus;
     }
@@ -159,7 +159,7 @@ cache_inode_status_t cache_inode_link(cache_entry_t * pentry_src,
     {
       /* Bad type .... */
       *pstatus = CACHE_INODE_BAD_TYPE;
-      pclient->stat.func_stats.nb_err_unrecover[CACHE_INODE_LINK] += 1;
+      inc_func_err_unrecover(pclient, CACHE_INODE_LINK);
 
       return *pstatus;
     }
@@ -216,7 +216,7 @@ cache_inode_status_t cache_inode_link(cache_entry_t * pentry_src,
               "WARNING: unknown source pentry type: internal_md.type=%d, line %d in file %s",
               pentry_src->internal_md.type, __LINE__, __FILE__);
       *pstatus = CACHE_INODE_BAD_TYPE;
-      pclient->stat.func_stats.nb_err_unrecover[CACHE_INODE_LINK] += 1;
+      inc_func_err_unrecover(pclient, CACHE_INODE_LINK);
       return *pstatus;
     }
 
@@ -240,7 +240,7 @@ cache_inode_status_t cache_inode_link(cache_entry_t * pentry_src,
               "WARNING: unknown source pentry type: internal_md.type=%d, line %d in file %s",
               pentry_src->internal_md.type, __LINE__, __FILE__);
       *pstatus = CACHE_INODE_BAD_TYPE;
-      pclient->stat.func_stats.nb_err_unrecover[CACHE_INODE_LINK] += 1;
+      inc_func_err_unrecover(pclient, CACHE_INODE_LINK);
       return *pstatus;
     }
 
@@ -355,9 +355,9 @@ cache_inode_status_t cache_inode_link(cache_entry_t * pentry_src,
 
   /* stats */
   if(*pstatus != CACHE_INODE_SUCCESS)
-    pclient->stat.func_stats.nb_err_retryable[CACHE_INODE_LINK] += 1;
+    inc_func_err_retryable(pclient, CACHE_INODE_LINK);
   else
-    pclient->stat.func_stats.nb_success[CACHE_INODE_LINK] += 1;
+    inc_func_success(pclient, CACHE_INODE_LINK);
 
   return *pstatus;
 }
@@ -83,7 +83,7 @@ cache_entry_t *cache_inode_lookup_sw(cache_entry_t * pentry_parent,
                                      fsal_op_context_t * pcontext,
                                      cache_inode_status_t * pstatus, int use_mutex)
 {
-  cache_entry_t *pdir_chain = NULL;
+  cache_inode_dir_entry_t *pdirent = NULL;
   cache_entry_t *pentry = NULL;
   fsal_status_t fsal_status;
 #ifdef _USE_MFSL
@@ -98,7 +98,6 @@ cache_entry_t *cache_inode_lookup_sw(cache_entry_t * pentry_parent,
   cache_inode_status_t cache_status;
   cache_inode_fsal_data_t new_entry_fsdata;
   fsal_accessflags_t access_mask = 0;
-  int i = 0;
 
   memset( (char *)&new_entry_fsdata, 0, sizeof( new_entry_fsdata ) ) ; 
 
@@ -107,7 +106,7 @@ cache_entry_t *cache_inode_lookup_sw(cache_entry_t * pentry_parent,
 
   /* stats */
   pclient->stat.nb_call_total += 1;
-  pclient->stat.func_stats.nb_call[CACHE_INODE_LOOKUP] += 1;
+  inc_func_call(pclient, CACHE_INODE_LOOKUP);
 
   /* Get lock on the pentry */
   if(use_mutex == TRUE)
@@ -136,7 +135,7 @@ cache_entry_t *cache_inode_lookup_sw(cache_entry_t * pentry_parent,
       *pstatus = CACHE_INODE_NOT_A_DIRECTORY;
 
       /* stats */
-      pclient->stat.func_stats.nb_err_unrecover[CACHE_INODE_LOOKUP] += 1;
+      inc_func_err_unrecover(pclient, CACHE_INODE_LOOKUP);
 
       if(use_mutex == TRUE)
         V_r(&pentry_parent->lock);
@@ -173,79 +172,19 @@ cache_entry_t *cache_inode_lookup_sw(cache_entry_t * pentry_parent,
           if(use_mutex == TRUE)
             V_r(&pentry_parent->lock);
 
-          pclient->stat.func_stats.nb_err_retryable[CACHE_INODE_GETATTR] += 1;
+          inc_func_err_retryable(pclient, CACHE_INODE_GETATTR);
           return NULL;
         }
 
-      /* Try to look into the dir and its dir_cont. At this point, it must be said than lock on dir_cont are
-       *  taken when a lock is previously acquired on the related dir_begin */
-      pdir_chain = pentry_parent;
-
-      do
+      /* Look the name up in the dirent index of the dir_chain. At this point, it must be said than lock
+       * on dir_cont are taken when a lock is previously acquired on the related dir_begin */
+      pdirent = cache_inode_dirent_find(pentry_parent, pname, FALSE, NULL);
+      if(pdirent != NULL)
         {
-          /* Is this entry known ? */
-          if(pdir_chain->internal_md.type == DIR_BEGINNING)
-            {
-              for(i = 0; i < CHILDREN_ARRAY_SIZE; i++)
-                {
-                  if(pdir_chain->object.dir_begin.pdir_data->dir_entries[i].active ==
-                     VALID)
-                    if(!FSAL_namecmp
-                       (pname,
-                        &(pentry_parent->object.dir_begin.pdir_data->dir_entries[i].
-                          name)))
-                      {
-                        /* Entry was found */
-                        pentry =
-                            pentry_parent->object.dir_begin.pdir_data->dir_entries[i].
-                            pentry;
-                        LogFullDebug(COMPONENT_CACHE_INODE,
-                                     "Cache Hit detected (dir_begin)");
-                        break;
-                      }
-                }
-
-              /* Do we have to go on browsing the cache_inode ? */
-              if(pdir_chain->object.dir_begin.end_of_dir == END_OF_DIR)
-                {
-                  break;
-                }
-
-              /* Next step */
-              pdir_chain = pdir_chain->object.dir_begin.pdir_cont;
-            }
-          else
-            {
-              /* The element in the dir_chain is a DIR_CONTINUE */
-              for(i = 0; i < CHILDREN_ARRAY_SIZE; i++)
-                {
-                  if(pdir_chain->object.dir_cont.pdir_data->dir_entries[i].active ==
-                     VALID)
-                    if(!FSAL_namecmp
-                       (pname,
-                        &(pdir_chain->object.dir_cont.pdir_data->dir_entries[i].name)))
-                      {
-                        /* Entry was found */
-                        pentry =
-                            pdir_chain->object.dir_cont.pdir_data->dir_entries[i].pentry;
-                        LogFullDebug(COMPONENT_CACHE_INODE,
-                                     "Cache Hit detected (dir_cont)");
-                        break;
-                      }
-                }
-
-              /* Do we have to go on browsing the cache_inode ? */
-              if(pdir_chain->object.dir_cont.end_of_dir == END_OF_DIR)
-                {
-                  break;
-                }
-
-              /* Next step */
-              pdir_chain = pdir_chain->object.dir_cont.pdir_cont;
-            }
-
+          /* Entry was found */
+          pentry = pdirent->pentry;
+          LogFullDebug(COMPONENT_CACHE_INODE, "Cache Hit detected");
         }
-      while(pentry == NULL);
 
       /* At this point, if pentry == NULL, we are not looking for a known son, query fsal for lookup */
       if(pentry == NULL)
@@ -326,7 +265,7 @@ cache_entry_t *cache_inode_lookup_sw(cache_entry_t * pentry_parent,
                 }
 
               /* stats */
-              pclient->stat.func_stats.nb_err_unrecover[CACHE_INODE_LOOKUP] += 1;
+              inc_func_err_unrecover(pclient, CACHE_INODE_LOOKUP);
 
               return NULL;
             }
@@ -370,7 +309,7 @@ cache_entry_t *cache_inode_lookup_sw(cache_entry_t * pentry_parent,
                     }
 
                   /* stats */
-                  pclient->stat.func_stats.nb_err_unrecover[CACHE_INODE_LOOKUP] += 1;
+                  inc_func_err_unrecover(pclient, CACHE_INODE_LOOKUP);
 
                   return NULL;
                 }
@@ -391,7 +330,7 @@ cache_entry_t *cache_inode_lookup_sw(cache_entry_t * pentry_parent,
                 V_r(&pentry_parent->lock);
 
               /* stats */
-              pclient->stat.func_stats.nb_err_unrecover[CACHE_INODE_LOOKUP] += 1;
+              inc_func_err_unrecover(pclient, CACHE_INODE_LOOKUP);
 
               return NULL;
             }
@@ -410,7 +349,7 @@ cache_entry_t *cache_inode_lookup_sw(cache_entry_t * pentry_parent,
                 V_r(&pentry_parent->lock);
 
               /* stats */
-              pclient->stat.func_stats.nb_err_unrecover[CACHE_INODE_LOOKUP] += 1;
+              inc_func_err_unrecover(pclient, CACHE_INODE_LOOKUP);
 
               return NULL;
             }
@@ -428,9 +367,9 @@ cache_entry_t *cache_inode_lookup_sw(cache_entry_t * pentry_parent,
 
   /* stat */
   if(*pstatus != CACHE_INODE_SUCCESS)
-    pclient->stat.func_stats.nb_err_retryable[CACHE_INODE_LOOKUP] += 1;
+    inc_func_err_retryable(pclient, CACHE_INODE_LOOKUP);
   else
-    pclient->stat.func_stats.nb_success[CACHE_INODE_LOOKUP] += 1;
+    inc_func_success(pclient, CACHE_INODE_LOOKUP);
 
   return pentry;
 }                               /* cache_inode_lookup_sw */
@@ -89,7 +89,7 @@ cache_entry_t *cache_inode_lookupp_sw(cache_entry_t * pentry,
 
   /* stats */
   pclient->stat.nb_call_total += 1;
-  pclient->stat.func_stats.nb_call[CACHE_INODE_LOOKUP] += 1;
+  inc_func_call(pclient, CACHE_INODE_LOOKUP);
 
   /* The entry should be a directory */
   if(use_mutex)
@@ -101,7 +101,7 @@ cache_entry_t *cache_inode_lookupp_sw(cache_entry_t * pentry,
       *pstatus = CACHE_INODE_BAD_TYPE;
 
       /* stats */
-      pclient->stat.func_stats.nb_err_unrecover[CACHE_INODE_LOOKUPP] += 1;
+      inc_func_err_unrecover(pclient, CACHE_INODE_LOOKUPP);
 
       return NULL;
     }
@@ -110,7 +110,7 @@ cache_entry_t *cache_inode_lookupp_sw(cache_entry_t * pentry,
   if(cache_inode_renew_entry(pentry, NULL, ht, pclient, pcontext, pstatus) !=
      CACHE_INODE_SUCCESS)
     {
-      pclient->stat.func_stats.nb_err_retryable[CACHE_INODE_GETATTR] += 1;
+      inc_func_err_retryable(pclient, CACHE_INODE_GETATTR);
       return NULL;
     }
 
@@ -153,7 +153,7 @@ cache_entry_t *cache_inode_lookupp_sw(cache_entry_t * pentry,
             }
 
           /* stats */
-          pclient->stat.func_stats.nb_err_unrecover[CACHE_INODE_LOOKUPP] += 1;
+          inc_func_err_unrecover(pclient, CACHE_INODE_LOOKUPP);
 
           return NULL;
         }
@@ -169,7 +169,7 @@ cache_entry_t *cache_inode_lookupp_sw(cache_entry_t * pentry,
             V_r(&pentry->lock);
 
           /* stats */
-          pclient->stat.func_stats.nb_err_unrecover[CACHE_INODE_LOOKUPP] += 1;
+          inc_func_err_unrecover(pclient, CACHE_INODE_LOOKUPP);
 
           return NULL;
         }
@@ -181,9 +181,9 @@ cache_entry_t *cache_inode_lookupp_sw(cache_entry_t * pentry,
 
   /* stat */
   if(*pstatus != CACHE_INODE_SUCCESS)
-    pclient->stat.func_stats.nb_err_retryable[CACHE_INODE_LOOKUPP] += 1;
+    inc_func_err_retryable(pclient, CACHE_INODE_LOOKUPP);
   else
-    pclient->stat.func_stats.nb_success[CACHE_INODE_LOOKUPP] += 1;
+    inc_func_success(pclient, CACHE_INODE_LOOKUPP);
 
   return pentry_parent;
 }                               /* cache_inode_lookupp_sw */
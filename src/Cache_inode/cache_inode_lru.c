@@ -0,0 +1,373 @@
+/*
+ * vim:expandtab:shiftwidth=8:tabstop=8:
+ *
+ * Copyright CEA/DAM/DIF  (2008)
+ * contributeur : Philippe DENIEL   philippe.deniel@cea.fr
+ *                Thomas LEIBOVICI  thomas.leibovici@cea.fr
+ *
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * ---------------------------------------
+ */
+
+/**
+ * \file    cache_inode_lru.c
+ * \brief   Global LRU of the cache_inode entries, used by the garbage collector.
+ *
+ * cache_inode_lru.c : the entries are kept in a LRU shared by all the
+ * clients. The LRU is split into CACHE_INODE_LRU_NB_LANES lanes, an entry is
+ * always queued in the lane selected by its address. Workers touching an
+ * entry move it to the MRU end of its lane, the reaper thread scans the lanes
+ * from the LRU end.
+ *
+ * Lock ordering: a lane lock is taken with the entry's lock held (from
+ * cache_inode_valid), so an entry lock must never be taken while a lane lock
+ * is held. To achieve this, cache_inode_lru_apply detaches a batch of entries
+ * from a lane (flagging them CACHE_INODE_LRU_RECLAIM) and works on them after
+ * having released the lane lock.
+ *
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#ifdef _SOLARIS
+#include "solaris_port.h"
+#endif                          /* _SOLARIS */
+
+#include "log_macros.h"
+#include "HashData.h"
+#include "HashTable.h"
+#include "LRU_List.h"
+#include "fsal.h"
+#include "cache_inode.h"
+#include "stuff_alloc.h"
+
+#include <unistd.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/param.h>
+#include <sys/time.h>
+#include <time.h>
+#include <pthread.h>
+
+static cache_inode_lru_lane_t cache_inode_lru_lanes[CACHE_INODE_LRU_NB_LANES];
+static pthread_once_t cache_inode_lru_once = PTHREAD_ONCE_INIT;
+
+/* Number of entries known to the LRU (queued or being examined by the gc) */
+static unsigned int cache_inode_lru_nb_entries = 0;
+
+/* Used to wake the reaper up when the high water mark is crossed */
+static pthread_mutex_t cache_inode_lru_reaper_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t cache_inode_lru_reaper_cond = PTHREAD_COND_INITIALIZER;
+static unsigned int cache_inode_lru_hwmark = 0;
+static volatile int cache_inode_lru_reaper_waiting = FALSE;
+
+cache_inode_lru_recycle_t cache_inode_lru_recycle;
+
+static void cache_inode_lru_init_once(void)
+{
+  unsigned int i;
+
+  for(i = 0; i < CACHE_INODE_LRU_NB_LANES; i++)
+    {
+      pthread_mutex_init(&cache_inode_lru_lanes[i].lock, NULL);
+      init_glist(&cache_inode_lru_lanes[i].q);
+      cache_inode_lru_lanes[i].size = 0;
+    }
+
+  memset(&cache_inode_lru_recycle, 0, sizeof(cache_inode_lru_recycle));
+  pthread_mutex_init(&cache_inode_lru_recycle.lock, NULL);
+}                               /* cache_inode_lru_init_once */
+
+/**
+ *
+ * cache_inode_lru_init: Init the global LRU used for garbage collection.
+ *
+ * Init the global LRU used for garbage collection. Can be called several times,
+ * only the first call has an effect.
+ *
+ * @return nothing (void function)
+ *
+ */
+void cache_inode_lru_init(void)
+{
+  pthread_once(&cache_inode_lru_once, cache_inode_lru_init_once);
+}                               /* cache_inode_lru_init */
+
+/**
+ *
+ * cache_inode_lru_ref: Moves an entry to the MRU end of its lane.
+ *
+ * Moves an entry to the MRU end of its lane, inserting it if it is not yet in
+ * the LRU. Entries currently examined by the garbage collector are left alone,
+ * they will be queued back if they survive.
+ *
+ * @param pentry [INOUT] entry that was just used.
+ *
+ * @return nothing (void function)
+ *
+ */
+void cache_inode_lru_ref(cache_entry_t * pentry)
+{
+  cache_inode_lru_lane_t *plane = &cache_inode_lru_lanes[CACHE_INODE_LRU_LANE(pentry)];
+  unsigned int nb_entries = 0;
+
+  P(plane->lock);
+
+  if(pentry->lru_flags & CACHE_INODE_LRU_RECLAIM)
+    {
+      V(plane->lock);
+      return;
+    }
+
+  if(pentry->lru_flags & CACHE_INODE_LRU_LINKED)
+    glist_del(&pentry->lru_q);
+  else
+    {
+      pentry->lru_flags |= CACHE_INODE_LRU_LINKED;
+      plane->size += 1;
+      nb_entries = __sync_add_and_fetch(&cache_inode_lru_nb_entries, 1);
+    }
+
+  glist_add_tail(&plane->q, &pentry->lru_q);
+
+  V(plane->lock);
+
+  /* Wake the reaper up if the cache grew too large */
+  if(cache_inode_lru_reaper_waiting && cache_inode_lru_hwmark != 0 &&
+     nb_entries > cache_inode_lru_hwmark)
+    {
+      P(cache_inode_lru_reaper_mutex);
+      if(cache_inode_lru_reaper_waiting)
+        {
+          cache_inode_lru_reaper_waiting = FALSE;
+          pthread_cond_signal(&cache_inode_lru_reaper_cond);
+        }
+      V(cache_inode_lru_reaper_mutex);
+    }
+}                               /* cache_inode_lru_ref */
+
+/**
+ *
+ * cache_inode_lru_remove: Removes an entry from the LRU.
+ *
+ * Removes an entry from the LRU, this is to be called before the entry is
+ * released to its pool.
+ *
+ * @param pentry [INOUT] entry to be removed.
+ *
+ * @return nothing (void function)
+ *
+ */
+void cache_inode_lru_remove(cache_entry_t * pentry)
+{
+  cache_inode_lru_lane_t *plane = &cache_inode_lru_lanes[CACHE_INODE_LRU_LANE(pentry)];
+
+  P(plane->lock);
+
+  if(pentry->lru_flags & CACHE_INODE_LRU_LINKED)
+    {
+      glist_del(&pentry->lru_q);
+      plane->size -= 1;
+      __sync_sub_and_fetch(&cache_inode_lru_nb_entries, 1);
+    }
+  else if(pentry->lru_flags & CACHE_INODE_LRU_RECLAIM)
+    __sync_sub_and_fetch(&cache_inode_lru_nb_entries, 1);
+
+  pentry->lru_flags = 0;
+
+  V(plane->lock);
+}                               /* cache_inode_lru_remove */
+
+/**
+ *
+ * cache_inode_lru_count: Returns the number of entries in the LRU.
+ *
+ * @return the number of entries in the LRU.
+ *
+ */
+unsigned int cache_inode_lru_count(void)
+{
+  return __sync_fetch_and_add(&cache_inode_lru_nb_entries, 0);
+}                               /* cache_inode_lru_count */
+
+/**
+ *
+ * cache_inode_lru_requeue: Queues back an entry detached by cache_inode_lru_apply.
+ *
+ * @param pentry [INOUT] entry to be queued back.
+ * @param at_head [IN] TRUE to queue it at the LRU end, FALSE at the MRU end.
+ *
+ * @return nothing (void function)
+ *
+ */
+static void cache_inode_lru_requeue(cache_entry_t * pentry, int at_head)
+{
+  cache_inode_lru_lane_t *plane = &cache_inode_lru_lanes[CACHE_INODE_LRU_LANE(pentry)];
+
+  P(plane->lock);
+
+  /* Entry was removed from the LRU while it was detached */
+  if(!(pentry->lru_flags & CACHE_INODE_LRU_RECLAIM))
+    {
+      V(plane->lock);
+      return;
+    }
+
+  pentry->lru_flags = CACHE_INODE_LRU_LINKED;
+  plane->size += 1;
+
+  if(at_head)
+    glist_add(&plane->q, &pentry->lru_q);
+  else
+    glist_add_tail(&plane->q, &pentry->lru_q);
+
+  V(plane->lock);
+}                               /* cache_inode_lru_requeue */
+
+/**
+ *
+ * cache_inode_lru_apply: Applies a gc function to the entries of the LRU.
+ *
+ * Applies a gc function to the entries of the LRU, oldest entries of each lane
+ * first, until pgcparam->nb_to_be_purged reaches zero or every entry was seen
+ * once. The function is called with no lane lock held. It returns
+ * LRU_LIST_SET_INVALID if it released the entry, which must then have been
+ * removed from the LRU with cache_inode_lru_remove. Entries it keeps are
+ * queued back at the MRU end of their lane.
+ *
+ * @param func [IN] the function to be applied.
+ * @param pgcparam [INOUT] gc parameter passed to func.
+ *
+ * @return the number of entries passed to func.
+ *
+ */
+unsigned int cache_inode_lru_apply(cache_inode_lru_func_t func,
+                                   cache_inode_param_gc_t * pgcparam)
+{
+  cache_entry_t *batch[CACHE_INODE_LRU_BATCH];
+  cache_inode_lru_lane_t *plane = NULL;
+  unsigned int lane;
+  unsigned int budget;
+  unsigned int nb_batch;
+  unsigned int nb_seen = 0;
+  unsigned int i;
+  int j;
+
+  for(lane = 0; lane < CACHE_INODE_LRU_NB_LANES && pgcparam->nb_to_be_purged > 0; lane++)
+    {
+      plane = &cache_inode_lru_lanes[lane];
+
+      /* Do not look twice at the same entry during one pass */
+      P(plane->lock);
+      budget = plane->size;
+      V(plane->lock);
+
+      while(budget > 0 && pgcparam->nb_to_be_purged > 0)
+        {
+          /* Detach a batch of entries from the LRU end of the lane */
+          P(plane->lock);
+          for(nb_batch = 0;
+              nb_batch < CACHE_INODE_LRU_BATCH && nb_batch < budget && !glist_empty(&plane->q);
+              nb_batch++)
+            {
+              batch[nb_batch] = glist_first_entry(&plane->q, cache_entry_t, lru_q);
+              glist_del(&batch[nb_batch]->lru_q);
+              batch[nb_batch]->lru_flags = CACHE_INODE_LRU_RECLAIM;
+              plane->size -= 1;
+            }
+          V(plane->lock);
+
+          if(nb_batch == 0)
+            break;
+
+          budget -= nb_batch;
+
+          for(i = 0; i < nb_batch && pgcparam->nb_to_be_purged > 0; i++)
+            {
+              nb_seen += 1;
+              if(func(batch[i], pgcparam) != LRU_LIST_SET_INVALID)
+                cache_inode_lru_requeue(batch[i], FALSE);
+            }
+
+          /* Entries that were not examined keep their place in the LRU */
+          for(j = (int)nb_batch - 1; j >= (int)i; j--)
+            cache_inode_lru_requeue(batch[j], TRUE);
+        }
+    }
+
+  return nb_seen;
+}                               /* cache_inode_lru_apply */
+
+/**
+ *
+ * cache_inode_lru_set_recycle_client: Sets the client whose pools are shared.
+ *
+ * Sets the client whose pools are shared with the other clients. This is the
+ * reaper thread's client: the entries it garbages are released to its pools
+ * and reused by the workers.
+ *
+ * @param pclient [IN] the reaper thread's client.
+ *
+ * @return nothing (void function)
+ *
+ */
+void cache_inode_lru_set_recycle_client(cache_inode_client_t * pclient)
+{
+  cache_inode_lru_init();
+
+  P(cache_inode_lru_recycle.lock);
+  cache_inode_lru_recycle.pclient = pclient;
+  V(cache_inode_lru_recycle.lock);
+}                               /* cache_inode_lru_set_recycle_client */
+
+/**
+ *
+ * cache_inode_lru_wait_reaper: Waits until the reaper has something to do.
+ *
+ * Waits until the number of entries in the LRU goes above hwmark or timeout
+ * seconds elapsed.
+ *
+ * @param hwmark [IN] high water mark, in number of entries.
+ * @param timeout [IN] maximum time to wait, in seconds.
+ *
+ * @return nothing (void function)
+ *
+ */
+void cache_inode_lru_wait_reaper(unsigned int hwmark, unsigned int timeout)
+{
+  struct timeval now;
+  struct timespec deadline;
+
+  gettimeofday(&now, NULL);
+  deadline.tv_sec = now.tv_sec + timeout;
+  deadline.tv_nsec = now.tv_usec * 1000;
+
+  P(cache_inode_lru_reaper_mutex);
+
+  cache_inode_lru_hwmark = hwmark;
+
+  if(cache_inode_lru_count() <= hwmark)
+    {
+      cache_inode_lru_reaper_waiting = TRUE;
+      pthread_cond_timedwait(&cache_inode_lru_reaper_cond,
+                             &cache_inode_lru_reaper_mutex, &deadline);
+      cache_inode_lru_reaper_waiting = FALSE;
+    }
+
+  V(cache_inode_lru_reaper_mutex);
+}                               /* cache_inode_lru_wait_reaper */
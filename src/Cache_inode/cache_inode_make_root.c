@@ -88,7 +88,8 @@ cache_entry_t *cache_inode_make_root(cache_inode_fsal_data_t * pfsdata,
   if((pentry = cache_inode_new_entry(pfsdata, NULL, DIR_BEGINNING, NULL, NULL, ht, pclient, pcontext, FALSE,    /* This is a population, not a creation */
                                      pstatus)) != NULL)
     {
-      GetFromPool(next_parent_entry, &pclient->pool_parent, cache_inode_parent_entry_t);
+      CACHE_INODE_GET_FROM_POOL(next_parent_entry, pclient, pool_parent,
+                                cache_inode_parent_entry_t);
 
       if(next_parent_entry == NULL)
         {
@@ -49,6 +49,7 @@
 #include "cache_content.h"
 #include "stuff_alloc.h"
 #include "nfs4_acls.h"
+#include "nfs_stat_registry.h"
 
 #include <unistd.h>
 #include <sys/types.h>
@@ -82,13 +83,79 @@ char *cache_inode_function_names[] = {
   "cache_inode_add_data_cache",
   "cache_inode_release_data_cache",
   "cache_inode_renew_entry",
-  "cache_inode_commit"
-  "cache_inode_add_state",
+  "cache_inode_commit",
   "cache_inode_add_state",
+  "cache_inode_del_state",
   "cache_inode_get_state",
   "cache_inode_set_state",
 };
 
+/* Latency histogram of each function */
+static int cache_inode_histograms[CACHE_INODE_NB_COMMAND];
+static int cache_inode_stats_registered = FALSE;
+
+/**
+ *
+ * cache_inode_register_stats: registers the latency histograms of the functions.
+ *
+ * Histograms are named after the functions, like "cache_inode.cache_inode_getattr".
+ * Calls made before are not measured.
+ *
+ * @return nothing (void function)
+ *
+ */
+void cache_inode_register_stats(void)
+{
+  char name[NFS_STAT_NAME_LEN];
+  unsigned int i;
+
+  for(i = 0; i < CACHE_INODE_NB_COMMAND; i++)
+    {
+      snprintf(name, NFS_STAT_NAME_LEN, "cache_inode.%s", cache_inode_function_names[i]);
+      cache_inode_histograms[i] = nfs_stat_register_histogram(name);
+    }
+
+  cache_inode_stats_registered = TRUE;
+}                               /* cache_inode_register_stats */
+
+/**
+ *
+ * cache_inode_stat_start: starts measuring the latency of a call.
+ *
+ * @param pclient [INOUT] the client doing the call.
+ * @param func    [IN]    the function, CACHE_INODE_GETATTR for example.
+ *
+ * @return nothing (void function)
+ *
+ */
+void cache_inode_stat_start(cache_inode_client_t * pclient, int func)
+{
+  if(cache_inode_stats_registered)
+    pclient->stat.func_start[func] = nfs_stat_now();
+}                               /* cache_inode_stat_start */
+
+/**
+ *
+ * cache_inode_stat_end: records the latency of a call.
+ *
+ * Outcomes that were not preceded by a measured call are ignored.
+ *
+ * @param pclient [INOUT] the client doing the call.
+ * @param func    [IN]    the function, CACHE_INODE_GETATTR for example.
+ *
+ * @return nothing (void function)
+ *
+ */
+void cache_inode_stat_end(cache_inode_client_t * pclient, int func)
+{
+  if(pclient->stat.func_start[func] == 0)
+    return;
+
+  nfs_stat_histogram_record(cache_inode_histograms[func],
+                            nfs_stat_now() - pclient->stat.func_start[func]);
+  pclient->stat.func_start[func] = 0;
+}                               /* cache_inode_stat_end */
+
 const char *cache_inode_err_str(cache_inode_status_t err)
 {
   switch(err)
@@ -210,7 +277,7 @@ int cache_inode_fsaldata_2_key(hash_buffer_t * pkey, cache_inode_fsal_data_t * p
 
   if(pclient != NULL)
     {
-      GetFromPool(ppoolfsdata, &pclient->pool_key, cache_inode_fsal_data_t);
+      CACHE_INODE_GET_FROM_POOL(ppoolfsdata, pclient, pool_key, cache_inode_fsal_data_t);
       if(ppoolfsdata == NULL)
         {
           LogDebug(COMPONENT_CACHE_INODE,
@@ -249,7 +316,7 @@ void cache_inode_release_fsaldata_key(hash_buffer_t * pkey,
 
   ppoolfsdata = (cache_inode_fsal_data_t *) pkey->pdata;
 
-  ReleaseToPool(ppoolfsdata, &pclient->pool_key);
+  CACHE_INODE_RELEASE_TO_POOL(ppoolfsdata, pclient, pool_key);
 }                               /* cache_inode_release_fsaldata_key */
 
 /**
@@ -299,7 +366,7 @@ cache_entry_t *cache_inode_new_entry(cache_inode_fsal_data_t * pfsdata,
 
   /* stat */
   pclient->stat.nb_call_total += 1;
-  pclient->stat.func_stats.nb_call[CACHE_INODE_NEW_ENTRY] += 1;
+  inc_func_call(pclient, CACHE_INODE_NEW_ENTRY);
 
   /* Turn the input to a hash key */
   if(cache_inode_fsaldata_2_key(&key, pfsdata, NULL))
@@ -307,7 +374,7 @@ cache_entry_t *cache_inode_new_entry(cache_inode_fsal_data_t * pfsdata,
       *pstatus = CACHE_INODE_UNAPPROPRIATED_KEY;
 
       /* stat */
-      pclient->stat.func_stats.nb_err_unrecover[CACHE_INODE_NEW_ENTRY] += 1;
+      inc_func_err_unrecover(pclient, CACHE_INODE_NEW_ENTRY);
       cache_inode_release_fsaldata_key(&key, pclient);
 
       return NULL;
@@ -325,12 +392,12 @@ cache_entry_t *cache_inode_new_entry(cache_inode_fsal_data_t * pfsdata,
                pentry, pentry->internal_md.type, pentry->internal_md.valid_state, type);
 
       /* stat */
-      pclient->stat.func_stats.nb_err_retryable[CACHE_INODE_NEW_ENTRY] += 1;
+      inc_func_err_retryable(pclient, CACHE_INODE_NEW_ENTRY);
 
       return pentry;
     }
 
-  GetFromPool(pentry, &pclient->pool_entry, cache_entry_t);
+  CACHE_INODE_GET_FROM_POOL(pentry, pclient, pool_entry, cache_entry_t);
   if(pentry == NULL)
     {
       LogCrit(COMPONENT_CACHE_INODE,
@@ -338,7 +405,7 @@ cache_entry_t *cache_inode_new_entry(cache_inode_fsal_data_t * pfsdata,
       *pstatus = CACHE_INODE_MALLOC_ERROR;
 
       /* stat */
-      pclient->stat.func_stats.nb_err_unrecover[CACHE_INODE_NEW_ENTRY] += 1;
+      inc_func_err_unrecover(pclient, CACHE_INODE_NEW_ENTRY);
 
       return NULL;
     }
@@ -346,7 +413,7 @@ cache_entry_t *cache_inode_new_entry(cache_inode_fsal_data_t * pfsdata,
   /* if entry is of tyep DIR_CONTINUE or DIR_BEGINNING, it should have a pdir_data */
   if(type == DIR_BEGINNING || type == DIR_CONTINUE || type == FS_JUNCTION )
     {
-      GetFromPool(pdir_data, &pclient->pool_dir_data, cache_inode_dir_data_t);
+      CACHE_INODE_GET_FROM_POOL(pdir_data, pclient, pool_dir_data, cache_inode_dir_data_t);
       if(pdir_data == NULL)
         {
           LogCrit(COMPONENT_CACHE_INODE,
@@ -354,7 +421,7 @@ cache_entry_t *cache_inode_new_entry(cache_inode_fsal_data_t * pfsdata,
           *pstatus = CACHE_INODE_MALLOC_ERROR;
 
           /* stat */
-          pclient->stat.func_stats.nb_err_unrecover[CACHE_INODE_NEW_ENTRY] += 1;
+          inc_func_err_unrecover(pclient, CACHE_INODE_NEW_ENTRY);
 
           return NULL;
         }
@@ -376,7 +443,7 @@ cache_entry_t *cache_inode_new_entry(cache_inode_fsal_data_t * pfsdata,
       *pstatus = CACHE_INODE_INIT_ENTRY_FAILED;
 
       /* stat */
-      pclient->stat.func_stats.nb_err_retryable[CACHE_INODE_NEW_ENTRY] += 1;
+      inc_func_err_retryable(pclient, CACHE_INODE_NEW_ENTRY);
 
       return NULL;
     }
@@ -417,7 +484,7 @@ cache_entry_t *cache_inode_new_entry(cache_inode_fsal_data_t * pfsdata,
 
                 }
               /* stat */
-              pclient->stat.func_stats.nb_err_unrecover[CACHE_INODE_NEW_ENTRY] += 1;
+              inc_func_err_unrecover(pclient, CACHE_INODE_NEW_ENTRY);
 
               return NULL;
             }
@@ -436,8 +503,9 @@ cache_entry_t *cache_inode_new_entry(cache_inode_fsal_data_t * pfsdata,
   pentry->internal_md.mod_time = pentry->internal_md.alloc_time = time(NULL);
   pentry->internal_md.refresh_time = pentry->internal_md.alloc_time;
 
-  pentry->gc_lru_entry = NULL;
-  pentry->gc_lru = NULL;
+  /* The entry is queued in the LRU by cache_inode_valid */
+  init_glist(&pentry->lru_q);
+  pentry->lru_flags = 0;
 
   /* No parent for now, it will be added in cache_inode_add_cached_dirent */
   pentry->parent_list = NULL;
@@ -470,7 +538,7 @@ cache_entry_t *cache_inode_new_entry(cache_inode_fsal_data_t * pfsdata,
           *pstatus = CACHE_INODE_INIT_ENTRY_FAILED;
 
           /* stat */
-          pclient->stat.func_stats.nb_err_retryable[CACHE_INODE_NEW_ENTRY] += 1;
+          inc_func_err_retryable(pclient, CACHE_INODE_NEW_ENTRY);
           return NULL;
         }
       pentry->object.file.open_fd.fileno = 0;
@@ -481,8 +549,8 @@ cache_entry_t *cache_inode_new_entry(cache_inode_fsal_data_t * pfsdata,
 #else
       memset(&(pentry->object.file.open_fd.fd), 0, sizeof(fsal_file_t));
 #endif
-      memset(&(pentry->object.file.unstable_data), 0,
-             sizeof(cache_inode_unstable_data_t));
+      cache_inode_unstable_init(pentry);
+      cache_inode_readahead_init(pentry);
 #ifdef _USE_PROXY
       pentry->object.file.pname = NULL;
       pentry->object.file.pentry_parent_open = NULL;
@@ -511,6 +579,7 @@ cache_entry_t *cache_inode_new_entry(cache_inode_fsal_data_t * pfsdata,
       pentry->object.dir_begin.nbactive = 0;
       pentry->object.dir_begin.nbdircont = 0;
       pentry->object.dir_begin.referral = NULL;
+      cache_inode_dirent_index_init(pentry);
 
       for(i = 0; i < CHILDREN_ARRAY_SIZE; i++)
         {
@@ -549,7 +618,7 @@ cache_entry_t *cache_inode_new_entry(cache_inode_fsal_data_t * pfsdata,
           ReleaseToPool(pentry, &pclient->pool_entry);
 
           /* stat */
-          pclient->stat.func_stats.nb_err_unrecover[CACHE_INODE_NEW_ENTRY] += 1;
+          inc_func_err_unrecover(pclient, CACHE_INODE_NEW_ENTRY);
 
           return NULL;
           break;
@@ -570,8 +639,8 @@ cache_entry_t *cache_inode_new_entry(cache_inode_fsal_data_t * pfsdata,
       LogDebug(COMPONENT_CACHE_INODE,
                "cache_inode_new_entry: Adding a SYMBOLIC_LINK pentry = %p",
                pentry);
-      GetFromPool(pentry->object.symlink, &pclient->pool_entry_symlink,
-                  cache_inode_symlink_t);
+      CACHE_INODE_GET_FROM_POOL(pentry->object.symlink, pclient, pool_entry_symlink,
+                                cache_inode_symlink_t);
       if(pentry->object.symlink == NULL)
         {
           LogDebug(COMPONENT_CACHE_INODE,
@@ -589,7 +658,7 @@ cache_entry_t *cache_inode_new_entry(cache_inode_fsal_data_t * pfsdata,
           *pstatus = cache_inode_error_convert(fsal_status);
           LogDebug(COMPONENT_CACHE_INODE,
                    "cache_inode_new_entry: FSAL_pathcpy failed");
-          cache_inode_release_symlink(pentry, &pclient->pool_entry_symlink);
+          cache_inode_release_symlink(pentry, pclient);
           ReleaseToPool(pentry, &pclient->pool_entry);
         }
 
@@ -678,6 +747,7 @@ cache_entry_t *cache_inode_new_entry(cache_inode_fsal_data_t * pfsdata,
       pentry->object.dir_begin.nbactive = 0;
       pentry->object.dir_begin.nbdircont = 0;
       pentry->object.dir_begin.referral = NULL;
+      cache_inode_dirent_index_init(pentry);
 
       for(i = 0; i < CHILDREN_ARRAY_SIZE; i++)
         {
@@ -698,7 +768,7 @@ cache_entry_t *cache_inode_new_entry(cache_inode_fsal_data_t * pfsdata,
       ReleaseToPool(pentry, &pclient->pool_entry);
 
       /* stat */
-      pclient->stat.func_stats.nb_err_unrecover[CACHE_INODE_NEW_ENTRY] += 1;
+      inc_func_err_unrecover(pclient, CACHE_INODE_NEW_ENTRY);
 
       return NULL;
     }
@@ -709,7 +779,7 @@ cache_entry_t *cache_inode_new_entry(cache_inode_fsal_data_t * pfsdata,
       *pstatus = CACHE_INODE_UNAPPROPRIATED_KEY;
 
       /* stat */
-      pclient->stat.func_stats.nb_err_unrecover[CACHE_INODE_NEW_ENTRY] += 1;
+      inc_func_err_unrecover(pclient, CACHE_INODE_NEW_ENTRY);
       cache_inode_release_fsaldata_key(&key, pclient);
 
       return NULL;
@@ -725,7 +795,7 @@ cache_entry_t *cache_inode_new_entry(cache_inode_fsal_data_t * pfsdata,
     {
       /* Put the entry back in its pool */
       if (pentry->object.symlink)
-         cache_inode_release_symlink(pentry, &pclient->pool_entry_symlink);
+         cache_inode_release_symlink(pentry, pclient);
       ReleaseToPool(pentry, &pclient->pool_entry);
       LogWarn(COMPONENT_CACHE_INODE,
               "cache_inode_new_entry: entry could not be added to hash, rc=%d",
@@ -736,7 +806,7 @@ cache_entry_t *cache_inode_new_entry(cache_inode_fsal_data_t * pfsdata,
          *pstatus = CACHE_INODE_HASH_SET_ERROR;
 
          /* stat */
-         pclient->stat.func_stats.nb_err_unrecover[CACHE_INODE_NEW_ENTRY] += 1;
+         inc_func_err_unrecover(pclient, CACHE_INODE_NEW_ENTRY);
 
          return NULL;
        }
@@ -751,7 +821,7 @@ cache_entry_t *cache_inode_new_entry(cache_inode_fsal_data_t * pfsdata,
         if( ( rc = HashTable_Get( ht, &key, &value ) ) != HASHTABLE_SUCCESS )
          {
             *pstatus = CACHE_INODE_HASH_SET_ERROR ;
-            pclient->stat.func_stats.nb_err_unrecover[CACHE_INODE_NEW_ENTRY] += 1;
+            inc_func_err_unrecover(pclient, CACHE_INODE_NEW_ENTRY);
             return NULL ;
          }
 
@@ -825,7 +895,7 @@ cache_entry_t *cache_inode_new_entry(cache_inode_fsal_data_t * pfsdata,
   *pstatus = CACHE_INODE_SUCCESS;
 
   /* stat */
-  pclient->stat.func_stats.nb_success[CACHE_INODE_NEW_ENTRY] += 1;
+  inc_func_success(pclient, CACHE_INODE_NEW_ENTRY);
 
   return pentry;
 }                               /* cache_inode_new_entry */
@@ -992,8 +1062,6 @@ cache_inode_status_t cache_inode_valid(cache_entry_t * pentry,
 
   cache_inode_status_t cache_status;
   cache_content_status_t cache_content_status;
-  LRU_status_t lru_status;
-  LRU_entry_t *plru_entry = NULL;
   cache_content_client_t *pclient_content = NULL;
   cache_content_entry_t *pentry_content = NULL;
 #ifndef _NO_BUDDY_SYSTEM
@@ -1009,31 +1077,8 @@ cache_inode_status_t cache_inode_valid(cache_entry_t * pentry,
       return cache_inode_valid(pentry->object.dir_cont.pdir_begin, op, pclient);
     }
 
-  /* Invalidate former entry if needed */
-  if(pentry->gc_lru != NULL && pentry->gc_lru_entry)
-    {
-      if(LRU_invalidate(pentry->gc_lru, pentry->gc_lru_entry) != LRU_LIST_SUCCESS)
-        {
-          if (pentry->object.symlink)
-            cache_inode_release_symlink(pentry, &pclient->pool_entry_symlink);
-          ReleaseToPool(pentry, &pclient->pool_entry);
-          return CACHE_INODE_LRU_ERROR;
-        }
-    }
-
-  if((plru_entry = LRU_new_entry(pclient->lru_gc, &lru_status)) == NULL)
-    {
-      if (pentry->object.symlink)
-        cache_inode_release_symlink(pentry, &pclient->pool_entry_symlink);
-      ReleaseToPool(pentry, &pclient->pool_entry);
-      return CACHE_INODE_LRU_ERROR;
-    }
-  plru_entry->buffdata.pdata = (caddr_t) pentry;
-  plru_entry->buffdata.len = sizeof(cache_entry_t);
-
-  /* Setting the anchors */
-  pentry->gc_lru = pclient->lru_gc;
-  pentry->gc_lru_entry = plru_entry;
+  /* Move the entry to the MRU end of the global LRU */
+  cache_inode_lru_ref(pentry);
 
   /* Update internal md */
   /*
@@ -1052,9 +1097,6 @@ cache_inode_status_t cache_inode_valid(cache_entry_t * pentry,
       pentry->internal_md.refresh_time = pentry->internal_md.mod_time;
     }
 
-  /* Add a call to the GC counter */
-  pclient->call_since_last_gc += 1;
-
   /* If open/close fd cache is used for FSAL, manage it here */
     LogFullDebug(COMPONENT_CACHE_INODE_GC,
                  "--------> use_cache=%u fileno=%d last_op=%u time(NULL)=%u delta=%u retention=%u",
@@ -1111,31 +1153,8 @@ cache_inode_status_t cache_inode_valid(cache_entry_t * pentry,
 
 #endif
   LogFullDebug(COMPONENT_CACHE_INODE_GC,
-               "(pthread_self=%p) LRU GC state: nb_entries=%d nb_invalid=%d nb_call_gc=%d param.nb_call_gc_invalid=%d",
-               (caddr_t)pthread_self(),
-               pclient->lru_gc->nb_entry,
-               pclient->lru_gc->nb_invalid,
-               pclient->lru_gc->nb_call_gc,
-               pclient->lru_gc->parameter.nb_call_gc_invalid);
-
-  LogFullDebug(COMPONENT_CACHE_INODE_GC,
-               "LRU GC state: nb_entries=%d nb_invalid=%d nb_call_gc=%d param.nb_call_gc_invalid=%d",
-               pclient->lru_gc->nb_entry,
-               pclient->lru_gc->nb_invalid,
-               pclient->lru_gc->nb_call_gc,
-               pclient->lru_gc->parameter.nb_call_gc_invalid);
-
-  LogFullDebug(COMPONENT_CACHE_INODE_GC,
-               "LRU GC state: nb_entries=%d nb_invalid=%d nb_call_gc=%d param.nb_call_gc_invalid=%d",
-               pclient->lru_gc->nb_entry,
-               pclient->lru_gc->nb_invalid,
-               pclient->lru_gc->nb_call_gc,
-               pclient->lru_gc->parameter.nb_call_gc_invalid);
-
-
-  /* Call LRU_gc_invalid to get ride of the unused invalid lru entries */
-  if(LRU_gc_invalid(pclient->lru_gc, NULL) != LRU_LIST_SUCCESS)
-    return CACHE_INODE_LRU_ERROR;
+               "(pthread_self=%p) LRU GC state: nb_entries=%u",
+               (caddr_t)pthread_self(), cache_inode_lru_count());
 
   return CACHE_INODE_SUCCESS;
 }                               /* cache_inode_valid */
@@ -1715,6 +1734,7 @@ static void cache_inode_invalidate_related_dirent(cache_entry_t * pentry,
                                                   cache_inode_client_t * pclient)
 {
   cache_inode_parent_entry_t *parent_iter = NULL;
+  cache_entry_t *pdir_begin = NULL;
 
   /* Set the cache status as INVALID in the directory entries */
   for(parent_iter = pentry->parent_list; parent_iter != NULL;
@@ -1756,12 +1776,9 @@ static void cache_inode_invalidate_related_dirent(cache_entry_t * pentry,
             }
           else
             {
-              parent_iter->parent->object.dir_begin.pdir_data->dir_entries[parent_iter->
-                                                                           subdirpos].
-                  active = INVALID;
+              cache_inode_dirent_invalidate(parent_iter->parent, parent_iter->subdirpos);
               /* Garbagge invalidates the effet of the readdir previously made */
               parent_iter->parent->object.dir_begin.has_been_readdir = CACHE_INODE_NO;
-              parent_iter->parent->object.dir_begin.nbactive -= 1;
             }
         }
       else
@@ -1777,10 +1794,12 @@ static void cache_inode_invalidate_related_dirent(cache_entry_t * pentry,
             }
           else
             {
-              parent_iter->parent->object.dir_cont.pdir_data->dir_entries[parent_iter->
-                                                                          subdirpos].
-                  active = INVALID;
-              parent_iter->parent->object.dir_cont.nbactive -= 1;
+              /* The name index is in the DIR_BEGINNING, readers use it
+               * under the lock of that entry, not the lock of the chunk */
+              pdir_begin = parent_iter->parent->object.dir_cont.pdir_begin;
+              P_w(&pdir_begin->lock);
+              cache_inode_dirent_invalidate(parent_iter->parent, parent_iter->subdirpos);
+              V_w(&pdir_begin->lock);
             }
         }
 
@@ -1843,15 +1862,8 @@ cache_inode_status_t cache_inode_kill_entry(cache_entry_t * pentry,
       return *pstatus;
     }
 
-  /* Invalidate the related LRU gc entry (no more required) */
-  if(pentry->gc_lru_entry != NULL)
-    {
-      if(LRU_invalidate(pentry->gc_lru, pentry->gc_lru_entry) != LRU_LIST_SUCCESS)
-        {
-          *pstatus = CACHE_INODE_LRU_ERROR;
-          return *pstatus;
-        }
-    }
+  /* Remove the entry from the gc LRU (no more required) */
+  cache_inode_lru_remove(pentry);
 
   fsaldata.handle = *pfsal_handle;
 
@@ -1953,6 +1965,13 @@ cache_inode_status_t cache_inode_kill_entry(cache_entry_t * pentry,
                   "Could not removed datacached entry for pentry %p", pentry);
     }
 
+  /* Unstable data that was never committed is lost, as is prefetched data */
+  if(pentry->internal_md.type == REGULAR_FILE)
+    {
+      cache_inode_unstable_release(pentry);
+      cache_inode_readahead_release(pentry);
+    }
+
   /* If entry is a DIR_CONTINUE or a DIR_BEGINNING, release pdir_data */
   if(pentry->internal_md.type == DIR_BEGINNING)
     {
@@ -1963,6 +1982,7 @@ cache_inode_status_t cache_inode_kill_entry(cache_entry_t * pentry,
         }
       /* Put the pentry back to the pool */
       ReleaseToPool(pentry->object.dir_begin.pdir_data, &pclient->pool_dir_data);
+      cache_inode_dirent_index_release(pentry);
     }
 
   if(pentry->internal_md.type == DIR_CONTINUE)
@@ -1993,19 +2013,19 @@ cache_inode_status_t cache_inode_kill_entry(cache_entry_t * pentry,
  *
  * releases an allocated symlink component, if any
  *
- * @param pool [INOUT] pool which owns pentry
  * @param pentry [INOUT] entry to be released
+ * @param pclient [INOUT] client whose pool receives the symlink component
  *
  * @return  (void)
  *
  */
 void cache_inode_release_symlink(cache_entry_t * pentry,
-                                 struct prealloc_pool *pool)
+                                 cache_inode_client_t * pclient)
 {
     assert(pentry);
     assert(pentry->internal_md.type == SYMBOLIC_LINK);
     if (pentry->object.symlink) {
-        ReleaseToPool(pentry->object.symlink, pool);
+        CACHE_INODE_RELEASE_TO_POOL(pentry->object.symlink, pclient, pool_entry_symlink);
         pentry->object.symlink = NULL;
     }
 }
@@ -134,14 +134,14 @@ cache_inode_status_t cache_inode_rdwr(cache_entry_t * pentry,
       statindex = CACHE_INODE_READ_DATA;
       io_direction = CACHE_CONTENT_READ;
       openflags = FSAL_O_RDONLY;
-      pclient->stat.func_stats.nb_call[CACHE_INODE_READ_DATA] += 1;
+      inc_func_call(pclient, CACHE_INODE_READ_DATA);
     }
   else
     {
       statindex = CACHE_INODE_WRITE_DATA;
       io_direction = CACHE_CONTENT_WRITE;
       openflags = FSAL_O_WRONLY;
-      pclient->stat.func_stats.nb_call[CACHE_INODE_WRITE_DATA] += 1;
+      inc_func_call(pclient, CACHE_INODE_WRITE_DATA);
     }
 
   P_w(&pentry->lock);
@@ -153,7 +153,7 @@ cache_inode_status_t cache_inode_rdwr(cache_entry_t * pentry,
       V_w(&pentry->lock);
 
       /* stats */
-      pclient->stat.func_stats.nb_err_unrecover[statindex] += 1;
+      inc_func_err_unrecover(pclient, statindex);
 
       return *pstatus;
     }
@@ -165,37 +165,24 @@ cache_inode_status_t cache_inode_rdwr(cache_entry_t * pentry,
       V_w(&pentry->lock);
 
       /* stats */
-      pclient->stat.func_stats.nb_err_unrecover[statindex] += 1;
+      inc_func_err_unrecover(pclient, statindex);
 
       return *pstatus;
     }
 
+  /* Prefetched data would be stale after this write */
+  if(read_or_write == CACHE_INODE_WRITE)
+    cache_inode_readahead_invalidate(pentry);
+
   /* Do we use stable or unstable storage ? */
   if(stable == FSAL_UNSAFE_WRITE_TO_GANESHA_BUFFER)
     {
       /* Data will be stored in memory and not flush to FSAL */
-
-      /* If the unstable_data buffer allocated ? */
-      if(pentry->object.file.unstable_data.buffer == NULL)
+      if(cache_inode_unstable_add(pentry,
+                                  seek_descriptor->offset,
+                                  buffer_size,
+                                  buffer, pclient, pcontext, pstatus) == CACHE_INODE_SUCCESS)
         {
-          if((pentry->object.file.unstable_data.buffer =
-              Mem_Alloc_Label(CACHE_INODE_UNSTABLE_BUFFERSIZE,
-                              "Cache_Inode Unstable Buffer")) == NULL)
-            {
-              *pstatus = CACHE_INODE_MALLOC_ERROR;
-              V_w(&pentry->lock);
-
-              /* stats */
-              pclient->stat.func_stats.nb_err_unrecover[statindex] += 1;
-
-              return *pstatus;
-            }
-
-          pentry->object.file.unstable_data.offset = seek_descriptor->offset;
-          pentry->object.file.unstable_data.length = buffer_size;
-
-          memcpy(pentry->object.file.unstable_data.buffer, buffer, buffer_size);
-
           /* Set mtime and ctime */
           pentry->object.file.attributes.mtime.seconds = time(NULL);
           pentry->object.file.attributes.mtime.nseconds = 0;
@@ -203,35 +190,47 @@ cache_inode_status_t cache_inode_rdwr(cache_entry_t * pentry,
           /* BUGAZOMEU : write operation must NOT modify file's ctime */
           pentry->object.file.attributes.ctime = pentry->object.file.attributes.mtime;
 
+          /* The file grows as soon as the data is buffered */
+          if(seek_descriptor->offset + buffer_size >
+             pentry->object.file.attributes.filesize)
+            pentry->object.file.attributes.filesize =
+                seek_descriptor->offset + buffer_size;
+
           *pio_size = buffer_size;
-        }                       /* if( pentry->object.file.unstable_data.buffer == NULL ) */
+        }
+      else if(*pstatus == CACHE_INODE_NO_SPACE_LEFT)
+        {
+          /* Too large to be buffered, go back to regular situation */
+          stable = FSAL_SAFE_WRITE_TO_FS;
+        }
       else
         {
-          if((pentry->object.file.unstable_data.offset < seek_descriptor->offset) &&
-             (buffer_size + seek_descriptor->offset < CACHE_INODE_UNSTABLE_BUFFERSIZE))
-            {
-              pentry->object.file.unstable_data.length =
-                  buffer_size + seek_descriptor->offset;
-              memcpy((char *)(pentry->object.file.unstable_data.buffer +
-                              seek_descriptor->offset), buffer, buffer_size);
-
-              /* Set mtime and ctime */
-              pentry->object.file.attributes.mtime.seconds = time(NULL);
-              pentry->object.file.attributes.mtime.nseconds = 0;
+          V_w(&pentry->lock);
 
-              /* BUGAZOMEU : write operation must NOT modify file's ctime */
-              pentry->object.file.attributes.ctime = pentry->object.file.attributes.mtime;
+          /* stats */
+          inc_func_err_unrecover(pclient, statindex);
 
-              *pio_size = buffer_size;
-            }
-          else
-            {
-              /* Go back to regular situation */
-              stable = FSAL_SAFE_WRITE_TO_FS;
-            }
+          return *pstatus;
         }
+    }
+
+  /* Direct IOs must not be mixed with buffered unstable data: write it first */
+  if((stable == FSAL_SAFE_WRITE_TO_FS ||
+      stable == FSAL_UNSAFE_WRITE_TO_FS_BUFFER) &&
+     !glist_empty(&pentry->object.file.unstable_data.ranges))
+    {
+      if(cache_inode_unstable_flush(pentry, 0, 0, pclient, pcontext, pstatus) !=
+         CACHE_INODE_SUCCESS)
+        {
+          V_w(&pentry->lock);
+
+          /* stats */
+          inc_func_err_unrecover(pclient, statindex);
 
+          return *pstatus;
+        }
     }
+
   /* if( stable == FALSE ) */
   if(stable == FSAL_SAFE_WRITE_TO_FS ||
      stable == FSAL_UNSAFE_WRITE_TO_FS_BUFFER)
@@ -304,7 +303,7 @@ cache_inode_status_t cache_inode_rdwr(cache_entry_t * pentry,
                       cache_content_status);
 
               /* stats */
-              pclient->stat.func_stats.nb_err_unrecover[statindex] += 1;
+              inc_func_err_unrecover(pclient, statindex);
 
               return *pstatus;
             }
@@ -324,6 +323,17 @@ cache_inode_status_t cache_inode_rdwr(cache_entry_t * pentry,
               buffstat.st_blksize * buffstat.st_blocks;
 
         }
+      else if(read_or_write == CACHE_INODE_READ &&
+              cache_inode_readahead_get(pentry, pcontext,
+                                        seek_descriptor->offset, io_size,
+                                        buffer, pio_size, p_fsal_eof))
+        {
+          /* Served from the data prefetched by the read-ahead threads */
+          LogFullDebug(COMPONENT_CACHE_INODE,
+                       "cache_inode_rdwr: inode/readahead: io_size=%llu, pio_size=%llu, eof=%d, seek=%d.%"PRIu64,
+                       io_size, *pio_size, *p_fsal_eof, seek_descriptor->whence,
+                       seek_descriptor->offset);
+        }
       else
         {
           /* No data cache entry, we operated directly on FSAL */
@@ -339,7 +349,7 @@ cache_inode_status_t cache_inode_rdwr(cache_entry_t * pentry,
               V_w(&pentry->lock);
 
               /* stats */
-              pclient->stat.func_stats.nb_err_unrecover[statindex] += 1;
+              inc_func_err_unrecover(pclient, statindex);
 
               return *pstatus;
             }
@@ -432,7 +442,7 @@ cache_inode_status_t cache_inode_rdwr(cache_entry_t * pentry,
               V_w(&pentry->lock);
 
               /* stats */
-              pclient->stat.func_stats.nb_err_unrecover[statindex] += 1;
+              inc_func_err_unrecover(pclient, statindex);
 
               return *pstatus;
             }
@@ -450,7 +460,7 @@ cache_inode_status_t cache_inode_rdwr(cache_entry_t * pentry,
               V_w(&pentry->lock);
 
               /* stats */
-              pclient->stat.func_stats.nb_err_unrecover[statindex] += 1;
+              inc_func_err_unrecover(pclient, statindex);
 
               return *pstatus;
             }
@@ -480,6 +490,9 @@ cache_inode_status_t cache_inode_rdwr(cache_entry_t * pentry,
                   pentry->object.file.attributes.spaceused = post_write_attr.spaceused;
                 }
             }
+          else
+            cache_inode_readahead_update(pentry, pcontext, seek_descriptor->offset,
+                                         *pio_size, *p_fsal_eof);
 
         }
 
@@ -518,18 +531,18 @@ cache_inode_status_t cache_inode_rdwr(cache_entry_t * pentry,
       *pstatus = cache_inode_valid(pentry, CACHE_INODE_OP_GET, pclient);
 
       if(*pstatus != CACHE_INODE_SUCCESS)
-        pclient->stat.func_stats.nb_err_unrecover[CACHE_INODE_READ] += 1;
+        inc_func_err_unrecover(pclient, CACHE_INODE_READ);
       else
-        pclient->stat.func_stats.nb_success[CACHE_INODE_READ] += 1;
+        inc_func_success(pclient, CACHE_INODE_READ);
     }
   else
     {
       *pstatus = cache_inode_valid(pentry, CACHE_INODE_OP_SET, pclient);
 
       if(*pstatus != CACHE_INODE_SUCCESS)
-        pclient->stat.func_stats.nb_err_unrecover[CACHE_INODE_WRITE] += 1;
+        inc_func_err_unrecover(pclient, CACHE_INODE_WRITE);
       else
-        pclient->stat.func_stats.nb_success[CACHE_INODE_WRITE] += 1;
+        inc_func_success(pclient, CACHE_INODE_WRITE);
     }
 
   V_w(&pentry->lock);
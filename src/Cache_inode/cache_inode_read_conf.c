@@ -79,6 +79,7 @@ cache_inode_status_t cache_inode_read_conf_hash_parameter(config_file_t in_confi
   int err;
   char *key_name;
   char *key_value;
+  int engine;
   config_item_t block;
 
   /* Is the config tree initialized ? */
@@ -131,6 +132,17 @@ cache_inode_status_t cache_inode_read_conf_hash_parameter(config_file_t in_confi
         {
           pparam->hparam.nb_node_prealloc = atoi(key_value);
         }
+      else if(!strcasecmp(key_name, "Hash_Engine"))
+        {
+          if((engine = HashTable_EngineFromStr(key_value)) < 0)
+            {
+              LogCrit(COMPONENT_CONFIG,
+                      "Invalid hash engine %s (item %s), expected RBT or Open_Addressing",
+                      key_value, CONF_LABEL_CACHE_INODE_HASH);
+              return CACHE_INODE_INVALID_ARGUMENT;
+            }
+          pparam->hparam.engine = engine;
+        }
       else
         {
           LogCrit(COMPONENT_CONFIG,
@@ -325,6 +337,18 @@ cache_inode_status_t cache_inode_read_conf_client_parameter(config_file_t in_con
         {
           pparam->use_fsal_hash = StrToBoolean(key_value);
         }
+      else if(!strcasecmp(key_name, "ReadAhead_Max_Window"))
+        {
+          pparam->readahead_max_window = atoi(key_value);
+        }
+      else if(!strcasecmp(key_name, "ReadAhead_Max_Memory"))
+        {
+          pparam->readahead_max_memory = atoi(key_value);
+        }
+      else if(!strcasecmp(key_name, "ReadAhead_Nb_Threads"))
+        {
+          pparam->nb_readahead_thread = atoi(key_value);
+        }
       else if(!strcasecmp(key_name, "DebugLevel"))
         {
           DebugLevel = ReturnLevelAscii(key_value);
@@ -479,6 +503,8 @@ void cache_inode_print_conf_hash_parameter(FILE * output, cache_inode_parameter_
           param.hparam.alphabet_length);
   fprintf(output, "CacheInode Hash: Prealloc_Node_Pool_Size = %d\n",
           param.hparam.nb_node_prealloc);
+  fprintf(output, "CacheInode Hash: Hash_Engine             = %s\n",
+          HashTable_EngineToStr(param.hparam.engine));
 }                               /* cache_inode_print_conf_hash_parameter */
 
 /**
@@ -0,0 +1,704 @@
+/*
+ * vim:expandtab:shiftwidth=8:tabstop=8:
+ *
+ * Copyright CEA/DAM/DIF  (2008)
+ * contributeur : Philippe DENIEL   philippe.deniel@cea.fr
+ *                Thomas LEIBOVICI  thomas.leibovici@cea.fr
+ *
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * ---------------------------------------
+ */
+
+/**
+ * \file    cache_inode_readahead.c
+ * \brief   Sequential read detection and asynchronous read-ahead.
+ *
+ * cache_inode_readahead.c : cache_inode_rdwr reports every read of a regular
+ * file (not data cached) here. After CACHE_INODE_READAHEAD_MIN_SEQ
+ * consecutive sequential reads, the data following the stream is prefetched
+ * by the read-ahead threads, with their own FSAL file descriptor, and kept
+ * in one of the CACHE_INODE_READAHEAD_NB_EXTENTS extents of the file. The
+ * next reads are served from these extents. The window starts at four times
+ * the size of the reads, doubles each time a prefetch is scheduled while the
+ * stream is served from memory, and is reset by a non sequential read. The
+ * memory used by all the prefetched extents is bounded.
+ *
+ * Locking: the read-ahead state of a file is protected by one of
+ * CACHE_INODE_READAHEAD_NB_LOCKS mutexes selected by the entry's address,
+ * not by the entry's lock, so that the read-ahead threads never take the
+ * entry's lock. The queue mutex may be taken with such a mutex held, never
+ * the other way round.
+ *
+ * A job keeps a copy of the fsal context of its read, which points into the
+ * export: the jobs are drained before the exports removed by a reload are
+ * freed.
+ *
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#ifdef _SOLARIS
+#include "solaris_port.h"
+#endif                          /* _SOLARIS */
+
+#include "log_macros.h"
+#include "HashData.h"
+#include "HashTable.h"
+#include "fsal.h"
+#include "cache_inode.h"
+#include "stuff_alloc.h"
+
+#include <unistd.h>
+#include <string.h>
+#include <sys/types.h>
+#include <time.h>
+#include <pthread.h>
+
+#define CACHE_INODE_READAHEAD_LOCK( pentry ) \
+  ((unsigned int)(((unsigned long)(pentry) >> 6) % CACHE_INODE_READAHEAD_NB_LOCKS))
+
+typedef struct cache_inode_readahead_job__
+{
+  struct glist_head q;          /**< Link in the read-ahead queue                    */
+  cache_entry_t *pentry;        /**< The file to be read                             */
+  fsal_handle_t handle;         /**< Copy of the file's handle                       */
+  fsal_op_context_t context;    /**< Copy of the context of the triggering read      */
+  uint64_t offset;              /**< Offset of the data to be prefetched             */
+  uint64_t length;              /**< Number of bytes to be prefetched                */
+  unsigned int generation;      /**< Generation of the file when the job was queued  */
+  int running;                  /**< Taken by a read-ahead thread                    */
+  uint64_t seq;                 /**< Order in which the running jobs were taken      */
+} cache_inode_readahead_job_t;
+
+static pthread_once_t cache_inode_readahead_once = PTHREAD_ONCE_INIT;
+static pthread_mutex_t cache_inode_readahead_locks[CACHE_INODE_READAHEAD_NB_LOCKS];
+static pthread_cond_t cache_inode_readahead_conds[CACHE_INODE_READAHEAD_NB_LOCKS];
+
+static struct glist_head cache_inode_readahead_queue;
+static pthread_mutex_t cache_inode_readahead_queue_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t cache_inode_readahead_queue_cond = PTHREAD_COND_INITIALIZER;
+
+/* Jobs taken by the read-ahead threads, under the queue mutex */
+static struct glist_head cache_inode_readahead_running;
+static pthread_cond_t cache_inode_readahead_done_cond = PTHREAD_COND_INITIALIZER;
+static uint64_t cache_inode_readahead_seq = 0;
+
+/* Read-ahead is disabled as long as cache_inode_readahead_set_param did not enable it */
+static uint64_t cache_inode_readahead_max_window = 0;
+static uint64_t cache_inode_readahead_max_memory = 0;
+
+/* Bytes held by the extents and reserved by the queued jobs */
+static uint64_t cache_inode_readahead_memory = 0;
+
+static void cache_inode_readahead_init_once(void)
+{
+  unsigned int i;
+
+  for(i = 0; i < CACHE_INODE_READAHEAD_NB_LOCKS; i++)
+    {
+      pthread_mutex_init(&cache_inode_readahead_locks[i], NULL);
+      pthread_cond_init(&cache_inode_readahead_conds[i], NULL);
+    }
+
+  init_glist(&cache_inode_readahead_queue);
+  init_glist(&cache_inode_readahead_running);
+}                               /* cache_inode_readahead_init_once */
+
+/**
+ *
+ * cache_inode_readahead_set_param: enables the read-ahead.
+ *
+ * To be called before the read-ahead threads are started.
+ *
+ * @param pparam [IN] the cache_inode client parameters.
+ *
+ * @return 0 if read-ahead is enabled, 1 if it is disabled.
+ *
+ */
+int cache_inode_readahead_set_param(cache_inode_client_parameter_t * pparam)
+{
+  pthread_once(&cache_inode_readahead_once, cache_inode_readahead_init_once);
+
+#ifdef _USE_MFSL
+  /* The read-ahead threads read from the FSAL and would miss the data still in MFSL */
+  LogEvent(COMPONENT_CACHE_INODE, "Read-ahead is not available with MFSL");
+  return 1;
+#else
+  if(pparam->readahead_max_window == 0 || pparam->readahead_max_memory == 0 ||
+     pparam->nb_readahead_thread == 0)
+    return 1;
+
+  cache_inode_readahead_max_memory = pparam->readahead_max_memory;
+  cache_inode_readahead_max_window = pparam->readahead_max_window;
+
+  LogEvent(COMPONENT_CACHE_INODE,
+           "Read-ahead enabled: window=%u bytes, memory=%u bytes, %u threads",
+           pparam->readahead_max_window, pparam->readahead_max_memory,
+           pparam->nb_readahead_thread);
+
+  return 0;
+#endif
+}                               /* cache_inode_readahead_set_param */
+
+/**
+ *
+ * cache_inode_readahead_free_extent: frees a prefetched extent.
+ *
+ * @param pextent [INOUT] the extent.
+ *
+ * @return nothing (void function)
+ *
+ */
+static void cache_inode_readahead_free_extent(cache_inode_readahead_extent_t * pextent)
+{
+  if(pextent->buffer == NULL)
+    return;
+
+  Mem_Free(pextent->buffer);
+  __sync_fetch_and_sub(&cache_inode_readahead_memory, pextent->length);
+
+  pextent->buffer = NULL;
+  pextent->length = 0;
+  pextent->eof = FALSE;
+}                               /* cache_inode_readahead_free_extent */
+
+/**
+ *
+ * cache_inode_readahead_free_slot: finds an extent that can receive new data.
+ *
+ * An extent is free if it is empty, expired or entirely behind the stream.
+ *
+ * @param pra [INOUT] the read-ahead state of the file.
+ * @param now [IN] current time.
+ *
+ * @return the extent, or NULL if all of them are still useful.
+ *
+ */
+static cache_inode_readahead_extent_t *cache_inode_readahead_free_slot(cache_inode_readahead_t * pra,
+                                                                       time_t now)
+{
+  unsigned int i;
+
+  for(i = 0; i < CACHE_INODE_READAHEAD_NB_EXTENTS; i++)
+    if(pra->extent[i].buffer == NULL ||
+       pra->extent[i].time + CACHE_INODE_READAHEAD_LIFETIME < now ||
+       pra->extent[i].offset + pra->extent[i].length <= pra->next_offset)
+      return &pra->extent[i];
+
+  return NULL;
+}                               /* cache_inode_readahead_free_slot */
+
+/**
+ *
+ * cache_inode_readahead_record: records a read and queues a prefetch if needed.
+ *
+ * The read-ahead lock of the entry must be held.
+ *
+ * @param pentry [INOUT] the regular file.
+ * @param pcontext [IN] fsal context of the read.
+ * @param offset [IN] offset of the read.
+ * @param io_size [IN] number of bytes read.
+ * @param eof [IN] the read reached the end of file.
+ * @param hit [IN] the read was served from a prefetched extent.
+ *
+ * @return nothing (void function)
+ *
+ */
+static void cache_inode_readahead_record(cache_entry_t * pentry,
+                                         fsal_op_context_t * pcontext,
+                                         uint64_t offset,
+                                         fsal_size_t io_size,
+                                         fsal_boolean_t eof, fsal_boolean_t hit)
+{
+  cache_inode_readahead_t *pra = &pentry->object.file.readahead;
+  cache_inode_readahead_job_t *pjob;
+  uint64_t ahead;
+  unsigned int i;
+  int moved;
+
+  if(offset == pra->next_offset && pra->seq_count > 0)
+    pra->seq_count += 1;
+  else
+    {
+      pra->seq_count = 1;
+      pra->window = 0;
+    }
+  pra->next_offset = offset + io_size;
+
+  if(pra->seq_count < CACHE_INODE_READAHEAD_MIN_SEQ || eof || io_size == 0 ||
+     pra->pjob != NULL)
+    return;
+
+  /* How far past the stream is the data already prefetched ? */
+  ahead = pra->next_offset;
+  do
+    {
+      moved = FALSE;
+      for(i = 0; i < CACHE_INODE_READAHEAD_NB_EXTENTS; i++)
+        if(pra->extent[i].buffer != NULL &&
+           pra->extent[i].offset <= ahead &&
+           pra->extent[i].offset + pra->extent[i].length > ahead)
+          {
+            /* Nothing to prefetch after the end of file */
+            if(pra->extent[i].eof)
+              return;
+
+            ahead = pra->extent[i].offset + pra->extent[i].length;
+            moved = TRUE;
+          }
+    }
+  while(moved);
+
+  /* Grow the window while the stream consumes what was prefetched */
+  if(pra->window == 0)
+    pra->window = 4 * io_size;
+  else if(hit)
+    pra->window *= 2;
+  if(pra->window > cache_inode_readahead_max_window)
+    pra->window = cache_inode_readahead_max_window;
+
+  if(ahead - pra->next_offset >= pra->window / 2)
+    return;
+
+  if(cache_inode_readahead_free_slot(pra, time(NULL)) == NULL)
+    return;
+
+  /* Reserve the memory of the prefetch */
+  if(__sync_add_and_fetch(&cache_inode_readahead_memory, pra->window) >
+     cache_inode_readahead_max_memory)
+    {
+      __sync_fetch_and_sub(&cache_inode_readahead_memory, pra->window);
+      return;
+    }
+
+  if((pjob = (cache_inode_readahead_job_t *)
+      Mem_Alloc(sizeof(cache_inode_readahead_job_t))) == NULL)
+    {
+      __sync_fetch_and_sub(&cache_inode_readahead_memory, pra->window);
+      return;
+    }
+
+  pjob->pentry = pentry;
+  pjob->handle = pentry->object.file.handle;
+  pjob->context = *pcontext;
+  pjob->offset = ahead;
+  pjob->length = pra->window;
+  pjob->generation = pra->generation;
+  pjob->running = FALSE;
+
+  pra->pjob = pjob;
+
+  P(cache_inode_readahead_queue_mutex);
+  glist_add_tail(&cache_inode_readahead_queue, &pjob->q);
+  pthread_cond_signal(&cache_inode_readahead_queue_cond);
+  V(cache_inode_readahead_queue_mutex);
+}                               /* cache_inode_readahead_record */
+
+/**
+ *
+ * cache_inode_readahead_init: initializes the read-ahead state of a regular file.
+ *
+ * @param pentry [INOUT] the regular file.
+ *
+ * @return nothing (void function)
+ *
+ */
+void cache_inode_readahead_init(cache_entry_t * pentry)
+{
+  pthread_once(&cache_inode_readahead_once, cache_inode_readahead_init_once);
+
+  memset(&pentry->object.file.readahead, 0, sizeof(cache_inode_readahead_t));
+}                               /* cache_inode_readahead_init */
+
+/**
+ *
+ * cache_inode_readahead_get: serves a read from the prefetched extents.
+ *
+ * The entry must be locked by the caller.
+ *
+ * @param pentry [INOUT] the regular file.
+ * @param pcontext [IN] fsal context for the operation.
+ * @param offset [IN] offset of the read.
+ * @param size [IN] number of bytes to be read.
+ * @param buffer [OUT] the buffer for the data.
+ * @param pio_size [OUT] number of bytes read.
+ * @param p_fsal_eof [OUT] the read reached the end of file.
+ *
+ * @return TRUE if the read was served, FALSE if it is to be done by the FSAL.
+ *
+ */
+fsal_boolean_t cache_inode_readahead_get(cache_entry_t * pentry,
+                                         fsal_op_context_t * pcontext,
+                                         uint64_t offset,
+                                         fsal_size_t size,
+                                         caddr_t buffer,
+                                         fsal_size_t * pio_size,
+                                         fsal_boolean_t * p_fsal_eof)
+{
+  cache_inode_readahead_t *pra = &pentry->object.file.readahead;
+  cache_inode_readahead_extent_t *pextent;
+  unsigned int lock = CACHE_INODE_READAHEAD_LOCK(pentry);
+  fsal_boolean_t found = FALSE;
+  time_t now;
+  uint64_t avail;
+  unsigned int i;
+
+  if(cache_inode_readahead_max_window == 0)
+    return FALSE;
+
+  P(cache_inode_readahead_locks[lock]);
+
+  now = time(NULL);
+  for(i = 0; i < CACHE_INODE_READAHEAD_NB_EXTENTS; i++)
+    {
+      pextent = &pra->extent[i];
+
+      if(pextent->buffer == NULL)
+        continue;
+
+      if(pextent->time + CACHE_INODE_READAHEAD_LIFETIME < now)
+        {
+          cache_inode_readahead_free_extent(pextent);
+          continue;
+        }
+
+      if(offset < pextent->offset || offset >= pextent->offset + pextent->length)
+        continue;
+
+      /* Only a read that ends in the extent, or at the end of file, is served */
+      avail = pextent->offset + pextent->length - offset;
+      if(avail < size && !pextent->eof)
+        continue;
+
+      *pio_size = (avail < size) ? avail : size;
+      memcpy(buffer, pextent->buffer + (offset - pextent->offset), *pio_size);
+      *p_fsal_eof = (pextent->eof && *pio_size == avail);
+      found = TRUE;
+      break;
+    }
+
+  if(found)
+    cache_inode_readahead_record(pentry, pcontext, offset, *pio_size, *p_fsal_eof, TRUE);
+
+  V(cache_inode_readahead_locks[lock]);
+
+  return found;
+}                               /* cache_inode_readahead_get */
+
+/**
+ *
+ * cache_inode_readahead_update: records a read done by the FSAL.
+ *
+ * @param pentry [INOUT] the regular file.
+ * @param pcontext [IN] fsal context for the operation.
+ * @param offset [IN] offset of the read.
+ * @param io_size [IN] number of bytes read.
+ * @param eof [IN] the read reached the end of file.
+ *
+ * @return nothing (void function)
+ *
+ */
+void cache_inode_readahead_update(cache_entry_t * pentry,
+                                  fsal_op_context_t * pcontext,
+                                  uint64_t offset,
+                                  fsal_size_t io_size, fsal_boolean_t eof)
+{
+  unsigned int lock = CACHE_INODE_READAHEAD_LOCK(pentry);
+
+  if(cache_inode_readahead_max_window == 0)
+    return;
+
+  P(cache_inode_readahead_locks[lock]);
+  cache_inode_readahead_record(pentry, pcontext, offset, io_size, eof, FALSE);
+  V(cache_inode_readahead_locks[lock]);
+}                               /* cache_inode_readahead_update */
+
+/**
+ *
+ * cache_inode_readahead_invalidate: drops the prefetched data of a modified file.
+ *
+ * A prefetch that is running will be dropped when it completes.
+ *
+ * @param pentry [INOUT] the regular file.
+ *
+ * @return nothing (void function)
+ *
+ */
+void cache_inode_readahead_invalidate(cache_entry_t * pentry)
+{
+  cache_inode_readahead_t *pra = &pentry->object.file.readahead;
+  unsigned int lock = CACHE_INODE_READAHEAD_LOCK(pentry);
+  unsigned int i;
+
+  if(cache_inode_readahead_max_window == 0)
+    return;
+
+  P(cache_inode_readahead_locks[lock]);
+
+  pra->generation += 1;
+  pra->seq_count = 0;
+  pra->window = 0;
+  for(i = 0; i < CACHE_INODE_READAHEAD_NB_EXTENTS; i++)
+    cache_inode_readahead_free_extent(&pra->extent[i]);
+
+  V(cache_inode_readahead_locks[lock]);
+}                               /* cache_inode_readahead_invalidate */
+
+/**
+ *
+ * cache_inode_readahead_release: frees the read-ahead state of a file that leaves the cache.
+ *
+ * A queued prefetch is cancelled, a running one is waited for, so that no
+ * read-ahead thread uses the entry once this function returns.
+ *
+ * @param pentry [INOUT] the regular file.
+ *
+ * @return nothing (void function)
+ *
+ */
+void cache_inode_readahead_release(cache_entry_t * pentry)
+{
+  cache_inode_readahead_t *pra = &pentry->object.file.readahead;
+  cache_inode_readahead_job_t *pjob;
+  unsigned int lock = CACHE_INODE_READAHEAD_LOCK(pentry);
+  unsigned int i;
+
+  if(cache_inode_readahead_max_window == 0)
+    return;
+
+  P(cache_inode_readahead_locks[lock]);
+
+  pra->generation += 1;
+
+  if((pjob = pra->pjob) != NULL)
+    {
+      P(cache_inode_readahead_queue_mutex);
+      if(!pjob->running)
+        {
+          glist_del(&pjob->q);
+          pra->pjob = NULL;
+        }
+      V(cache_inode_readahead_queue_mutex);
+
+      if(pra->pjob == NULL)
+        {
+          __sync_fetch_and_sub(&cache_inode_readahead_memory, pjob->length);
+          Mem_Free(pjob);
+        }
+      else
+        while(pra->pjob != NULL)
+          pthread_cond_wait(&cache_inode_readahead_conds[lock],
+                            &cache_inode_readahead_locks[lock]);
+    }
+
+  for(i = 0; i < CACHE_INODE_READAHEAD_NB_EXTENTS; i++)
+    cache_inode_readahead_free_extent(&pra->extent[i]);
+
+  pra->seq_count = 0;
+  pra->window = 0;
+
+  V(cache_inode_readahead_locks[lock]);
+}                               /* cache_inode_readahead_release */
+
+/**
+ *
+ * cache_inode_readahead_drain: cancels the queued prefetches and waits for
+ * the running ones.
+ *
+ * Called before the exports removed by a reload are freed: once it returns,
+ * no read-ahead thread uses the fsal context of a request started before.
+ * Only the jobs running when it is called are waited for.
+ *
+ * @return nothing (void function)
+ *
+ */
+void cache_inode_readahead_drain(void)
+{
+  struct glist_head cancelled;
+  struct glist_head *glist;
+  cache_inode_readahead_job_t *pjob;
+  unsigned int lock;
+  uint64_t last;
+  int busy;
+
+  if(cache_inode_readahead_max_window == 0)
+    return;
+
+  init_glist(&cancelled);
+
+  /* The queued jobs are taken as if they were running, so that
+   * cache_inode_readahead_release waits for them to be cancelled */
+  P(cache_inode_readahead_queue_mutex);
+  while(!glist_empty(&cache_inode_readahead_queue))
+    {
+      pjob = glist_first_entry(&cache_inode_readahead_queue,
+                               cache_inode_readahead_job_t, q);
+      glist_del(&pjob->q);
+      pjob->running = TRUE;
+      glist_add_tail(&cancelled, &pjob->q);
+    }
+  last = cache_inode_readahead_seq;
+  V(cache_inode_readahead_queue_mutex);
+
+  while(!glist_empty(&cancelled))
+    {
+      pjob = glist_first_entry(&cancelled, cache_inode_readahead_job_t, q);
+      glist_del(&pjob->q);
+
+      lock = CACHE_INODE_READAHEAD_LOCK(pjob->pentry);
+      P(cache_inode_readahead_locks[lock]);
+      pjob->pentry->object.file.readahead.pjob = NULL;
+      pthread_cond_broadcast(&cache_inode_readahead_conds[lock]);
+      V(cache_inode_readahead_locks[lock]);
+
+      __sync_fetch_and_sub(&cache_inode_readahead_memory, pjob->length);
+      Mem_Free(pjob);
+    }
+
+  P(cache_inode_readahead_queue_mutex);
+  do
+    {
+      busy = FALSE;
+      glist_for_each(glist, &cache_inode_readahead_running)
+        if(glist_entry(glist, cache_inode_readahead_job_t, q)->seq <= last)
+          busy = TRUE;
+
+      if(busy)
+        pthread_cond_wait(&cache_inode_readahead_done_cond,
+                          &cache_inode_readahead_queue_mutex);
+    }
+  while(busy);
+  V(cache_inode_readahead_queue_mutex);
+}                               /* cache_inode_readahead_drain */
+
+/**
+ *
+ * cache_inode_readahead_thread: a read-ahead thread.
+ *
+ * @param arg [IN] the memory manager parameters of the thread (NULL if none).
+ *
+ * @return never returns.
+ *
+ */
+void *cache_inode_readahead_thread(void *arg)
+{
+  cache_inode_readahead_job_t *pjob;
+  cache_inode_readahead_t *pra;
+  cache_inode_readahead_extent_t *pextent;
+  fsal_status_t fsal_status;
+  fsal_file_t fd;
+  fsal_seek_t seek_descriptor;
+  fsal_size_t read_size;
+  fsal_size_t io_size;
+  fsal_boolean_t eof;
+  caddr_t buffer;
+  unsigned int lock;
+
+  SetNameFunction("cache_inode_readahead");
+
+#ifndef _NO_BUDDY_SYSTEM
+  if(arg != NULL && BuddyInit((buddy_parameter_t *) arg) != BUDDY_SUCCESS)
+    LogFatal(COMPONENT_CACHE_INODE,
+             "CACHE INODE READAHEAD: Memory manager could not be initialized");
+#endif
+
+  while(1)
+    {
+      P(cache_inode_readahead_queue_mutex);
+      while(glist_empty(&cache_inode_readahead_queue))
+        pthread_cond_wait(&cache_inode_readahead_queue_cond,
+                          &cache_inode_readahead_queue_mutex);
+
+      pjob = glist_first_entry(&cache_inode_readahead_queue,
+                               cache_inode_readahead_job_t, q);
+      glist_del(&pjob->q);
+      pjob->running = TRUE;
+      pjob->seq = ++cache_inode_readahead_seq;
+      glist_add_tail(&cache_inode_readahead_running, &pjob->q);
+      V(cache_inode_readahead_queue_mutex);
+
+      /* Read the data without any lock held */
+      read_size = 0;
+      eof = FALSE;
+      buffer = Mem_Alloc_Label(pjob->length, "Cache_Inode ReadAhead Buffer");
+      if(buffer != NULL)
+        {
+          fsal_status = FSAL_open(&pjob->handle, &pjob->context, FSAL_O_RDONLY, &fd, NULL);
+          if(!FSAL_IS_ERROR(fsal_status))
+            {
+              seek_descriptor.whence = FSAL_SEEK_SET;
+              while(read_size < pjob->length && !eof)
+                {
+                  seek_descriptor.offset = pjob->offset + read_size;
+                  fsal_status = FSAL_read(&fd, &seek_descriptor, pjob->length - read_size,
+                                          buffer + read_size, &io_size, &eof);
+                  if(FSAL_IS_ERROR(fsal_status) || io_size == 0)
+                    break;
+                  read_size += io_size;
+                }
+              FSAL_close(&fd);
+            }
+          else
+            LogDebug(COMPONENT_CACHE_INODE,
+                     "cache_inode_readahead_thread: FSAL_open failed, fsal_status.major = %d",
+                     fsal_status.major);
+        }
+
+      lock = CACHE_INODE_READAHEAD_LOCK(pjob->pentry);
+      P(cache_inode_readahead_locks[lock]);
+
+      pra = &pjob->pentry->object.file.readahead;
+
+      /* Keep the data only if the file was not modified meanwhile */
+      pextent = NULL;
+      if(read_size > 0 && pjob->generation == pra->generation)
+        pextent = cache_inode_readahead_free_slot(pra, time(NULL));
+
+      if(pextent != NULL)
+        {
+          cache_inode_readahead_free_extent(pextent);
+          pextent->offset = pjob->offset;
+          pextent->length = read_size;
+          pextent->buffer = buffer;
+          pextent->eof = eof;
+          pextent->time = time(NULL);
+
+          /* Only the bytes actually read stay accounted */
+          __sync_fetch_and_sub(&cache_inode_readahead_memory, pjob->length - read_size);
+        }
+      else
+        {
+          if(buffer != NULL)
+            Mem_Free(buffer);
+          __sync_fetch_and_sub(&cache_inode_readahead_memory, pjob->length);
+        }
+
+      pra->pjob = NULL;
+      pthread_cond_broadcast(&cache_inode_readahead_conds[lock]);
+      V(cache_inode_readahead_locks[lock]);
+
+      P(cache_inode_readahead_queue_mutex);
+      glist_del(&pjob->q);
+      pthread_cond_broadcast(&cache_inode_readahead_done_cond);
+      V(cache_inode_readahead_queue_mutex);
+
+      Mem_Free(pjob);
+    }
+
+  return NULL;
+}                               /* cache_inode_readahead_thread */
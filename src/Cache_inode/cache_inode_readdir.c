@@ -46,16 +46,283 @@
 #include "log_macros.h"
 #include "HashData.h"
 #include "HashTable.h"
+#include "lookup3.h"
 #include "stuff_alloc.h"
 #include "fsal.h"
 #include "cache_inode.h"
 
+#include <stddef.h>
 #include <unistd.h>
 #include <sys/types.h>
 #include <sys/param.h>
 #include <time.h>
 #include <pthread.h>
 
+/**
+ *
+ * cache_inode_dirent_begin: gets the DIR_BEGINNING of a dir_chain.
+ *
+ * @param pdir_chain [IN] a DIR_BEGINNING or a DIR_CONTINUE.
+ *
+ * @return the DIR_BEGINNING that heads the dir_chain.
+ *
+ */
+static cache_entry_t *cache_inode_dirent_begin(cache_entry_t * pdir_chain)
+{
+  if(pdir_chain->internal_md.type == DIR_CONTINUE)
+    return pdir_chain->object.dir_cont.pdir_begin;
+
+  return pdir_chain;
+}                               /* cache_inode_dirent_begin */
+
+/**
+ *
+ * cache_inode_dirent_data: gets the dirent array of an element of a dir_chain.
+ *
+ * @param pdir_chain [IN] a DIR_BEGINNING or a DIR_CONTINUE.
+ *
+ * @return the dirent array.
+ *
+ */
+static cache_inode_dir_data_t *cache_inode_dirent_data(cache_entry_t * pdir_chain)
+{
+  if(pdir_chain->internal_md.type == DIR_CONTINUE)
+    return pdir_chain->object.dir_cont.pdir_data;
+
+  return pdir_chain->object.dir_begin.pdir_data;
+}                               /* cache_inode_dirent_data */
+
+/**
+ *
+ * cache_inode_dirent_hash: computes the value of a name in the dirent_names index.
+ *
+ * @param pname [IN] the name to be hashed.
+ *
+ * @return the rbt value for this name.
+ *
+ */
+static long cache_inode_dirent_hash(fsal_name_t * pname)
+{
+  uint32_t h1 = 0;
+  uint32_t h2 = 0;
+
+  Lookup3_hash_buff_dual(pname->name, pname->len, &h1, &h2);
+
+  return (long)(((uint64_t) h1 << 32) | h2);
+}                               /* cache_inode_dirent_hash */
+
+/**
+ *
+ * cache_inode_dirent_index_insert: adds an active dirent to the dirent_names index.
+ *
+ * @param pdir_chain [IN] the DIR_BEGINNING or DIR_CONTINUE that contains the dirent.
+ * @param slot [IN] position of the dirent in the dirent array.
+ *
+ * @return nothing (void function)
+ *
+ */
+static void cache_inode_dirent_index_insert(cache_entry_t * pdir_chain,
+                                            unsigned int slot)
+{
+  struct rbt_head *head =
+      &cache_inode_dirent_begin(pdir_chain)->object.dir_begin.dirent_names;
+  cache_inode_dir_entry_t *pdirent = &cache_inode_dirent_data(pdir_chain)->dir_entries[slot];
+  struct rbt_node *pn;
+  long rbt_value = cache_inode_dirent_hash(&pdirent->name);
+
+  RBT_FIND(head, pn, rbt_value);
+
+  RBT_VALUE(&pdirent->name_node) = rbt_value;
+  RBT_OPAQ(&pdirent->name_node) = pdir_chain;
+  RBT_INSERT(head, &pdirent->name_node, pn);
+}                               /* cache_inode_dirent_index_insert */
+
+/**
+ *
+ * cache_inode_dirent_index_init: initializes the dirent indexes of a DIR_BEGINNING.
+ *
+ * @param pentry_dir [INOUT] the DIR_BEGINNING.
+ *
+ * @return nothing (void function)
+ *
+ */
+void cache_inode_dirent_index_init(cache_entry_t * pentry_dir)
+{
+  RBT_HEAD_INIT(&pentry_dir->object.dir_begin.dirent_names);
+  pentry_dir->object.dir_begin.pdir_cont_index = NULL;
+  pentry_dir->object.dir_begin.dir_cont_index_size = 0;
+  pentry_dir->object.dir_begin.dir_cont_index_nb = 1;
+}                               /* cache_inode_dirent_index_init */
+
+/**
+ *
+ * cache_inode_dirent_index_release: frees the dirent indexes of a DIR_BEGINNING.
+ *
+ * The dirent_names nodes are embedded in the dirent arrays, so only the
+ * chunk index has to be freed.
+ *
+ * @param pentry_dir [INOUT] the DIR_BEGINNING.
+ *
+ * @return nothing (void function)
+ *
+ */
+void cache_inode_dirent_index_release(cache_entry_t * pentry_dir)
+{
+  if(pentry_dir->object.dir_begin.pdir_cont_index != NULL)
+    Mem_Free(pentry_dir->object.dir_begin.pdir_cont_index);
+
+  cache_inode_dirent_index_init(pentry_dir);
+}                               /* cache_inode_dirent_index_release */
+
+/**
+ *
+ * cache_inode_dirent_chunk_set: records a DIR_CONTINUE as the last chunk of its dir_chain.
+ *
+ * @param pentry_dir [INOUT] the DIR_BEGINNING.
+ * @param pdir_cont [IN] the DIR_CONTINUE just chained.
+ *
+ * @return CACHE_INODE_SUCCESS or CACHE_INODE_MALLOC_ERROR.
+ *
+ */
+static cache_inode_status_t cache_inode_dirent_chunk_set(cache_entry_t * pentry_dir,
+                                                         cache_entry_t * pdir_cont)
+{
+  unsigned int pos = pdir_cont->object.dir_cont.dir_cont_pos;
+  unsigned int newsize;
+  cache_entry_t **pindex;
+
+  if(pos >= pentry_dir->object.dir_begin.dir_cont_index_size)
+    {
+      newsize = pentry_dir->object.dir_begin.dir_cont_index_size * 2;
+      if(newsize <= pos)
+        newsize = (pos < NB_CHUNCK_READDIR) ? NB_CHUNCK_READDIR * 2 : pos * 2;
+
+      if(pentry_dir->object.dir_begin.pdir_cont_index == NULL)
+        pindex = (cache_entry_t **) Mem_Alloc(newsize * sizeof(cache_entry_t *));
+      else
+        pindex = (cache_entry_t **) Mem_Realloc(pentry_dir->object.dir_begin.pdir_cont_index,
+                                                newsize * sizeof(cache_entry_t *));
+      if(pindex == NULL)
+        return CACHE_INODE_MALLOC_ERROR;
+
+      pentry_dir->object.dir_begin.pdir_cont_index = pindex;
+      pentry_dir->object.dir_begin.dir_cont_index_size = newsize;
+    }
+
+  pentry_dir->object.dir_begin.pdir_cont_index[pos] = pdir_cont;
+  pentry_dir->object.dir_begin.dir_cont_index_nb = pos + 1;
+
+  return CACHE_INODE_SUCCESS;
+}                               /* cache_inode_dirent_chunk_set */
+
+/**
+ *
+ * cache_inode_dirent_chunk: gets an element of a dir_chain from its position.
+ *
+ * Position 0 is the DIR_BEGINNING, position n is the DIR_CONTINUE whose dir_cont_pos is n.
+ * A readdir cookie lies in the chunk at position cookie / CHILDREN_ARRAY_SIZE.
+ *
+ * @param pentry_dir [IN] the DIR_BEGINNING.
+ * @param pos [IN] position of the chunk in the dir_chain.
+ *
+ * @return the chunk, or NULL if pos is beyond the end of the dir_chain.
+ *
+ */
+cache_entry_t *cache_inode_dirent_chunk(cache_entry_t * pentry_dir, unsigned int pos)
+{
+  if(pos == 0)
+    return pentry_dir;
+
+  if(pos >= pentry_dir->object.dir_begin.dir_cont_index_nb)
+    return NULL;
+
+  return pentry_dir->object.dir_begin.pdir_cont_index[pos];
+}                               /* cache_inode_dirent_chunk */
+
+/**
+ *
+ * cache_inode_dirent_find: looks up a name in the dirent_names index of a dir_chain.
+ *
+ * @param pentry_parent [IN] a DIR_BEGINNING or a DIR_CONTINUE of the dir_chain.
+ * @param pname [IN] the name to look for.
+ * @param check_state [IN] if TRUE, dirents pointing to an entry that is neither VALID nor STALE are skipped.
+ * @param ppdir_chain [OUT] if not NULL, the chunk that contains the dirent.
+ *
+ * @return the active dirent with this name, or NULL if it is not cached.
+ *
+ */
+cache_inode_dir_entry_t *cache_inode_dirent_find(cache_entry_t * pentry_parent,
+                                                 fsal_name_t * pname,
+                                                 int check_state,
+                                                 cache_entry_t ** ppdir_chain)
+{
+  struct rbt_head *head =
+      &cache_inode_dirent_begin(pentry_parent)->object.dir_begin.dirent_names;
+  struct rbt_node *pn;
+  cache_inode_dir_entry_t *pdirent;
+  cache_inode_entry_valid_state_t vstate;
+  long rbt_value = cache_inode_dirent_hash(pname);
+
+  RBT_FIND_LEFT(head, pn, rbt_value);
+
+  while(pn != NULL && RBT_VALUE(pn) == rbt_value)
+    {
+      pdirent = (cache_inode_dir_entry_t *) ((caddr_t) pn -
+                                             offsetof(cache_inode_dir_entry_t,
+                                                      name_node));
+
+      if(pdirent->active == VALID && !FSAL_namecmp(pname, &pdirent->name))
+        {
+          vstate = pdirent->pentry->internal_md.valid_state;
+
+          if(!check_state || vstate == VALID || vstate == STALE)
+            {
+              if(vstate == STALE)
+                LogDebug(COMPONENT_NFS_READDIR, "found STALE cache entry");
+
+              if(ppdir_chain != NULL)
+                *ppdir_chain = (cache_entry_t *) RBT_OPAQ(pn);
+
+              return pdirent;
+            }
+        }
+
+      RBT_INCREMENT(pn);
+    }
+
+  return NULL;
+}                               /* cache_inode_dirent_find */
+
+/**
+ *
+ * cache_inode_dirent_invalidate: sets a dirent invalid and drops it from the dirent_names index.
+ *
+ * Does nothing if the dirent is not active.
+ *
+ * @param pdir_chain [INOUT] the DIR_BEGINNING or DIR_CONTINUE that contains the dirent.
+ * @param slot [IN] position of the dirent in the dirent array.
+ *
+ * @return nothing (void function)
+ *
+ */
+void cache_inode_dirent_invalidate(cache_entry_t * pdir_chain, unsigned int slot)
+{
+  cache_inode_dir_entry_t *pdirent = &cache_inode_dirent_data(pdir_chain)->dir_entries[slot];
+  struct rbt_head *head =
+      &cache_inode_dirent_begin(pdir_chain)->object.dir_begin.dirent_names;
+
+  if(pdirent->active != VALID)
+    return;
+
+  RBT_UNLINK(head, &pdirent->name_node);
+  pdirent->active = INVALID;
+
+  if(pdir_chain->internal_md.type == DIR_BEGINNING)
+    pdir_chain->object.dir_begin.nbactive -= 1;
+  else
+    pdir_chain->object.dir_cont.nbactive -= 1;
+}                               /* cache_inode_dirent_invalidate */
+
 /**
  *
  * cache_inode_operate_cached_dirent: locates a dirent in the cached dirent, and perform an operation on it.
@@ -81,8 +348,8 @@ cache_entry_t *cache_inode_operate_cached_dirent(cache_entry_t * pentry_parent,
 {
   cache_entry_t *pdir_chain = NULL;
   cache_entry_t *pentry = NULL;
+  cache_inode_dir_entry_t *pdirent = NULL;
   fsal_status_t fsal_status;
-  LRU_List_state_t vstate;
   int i = 0;
 
   /* Set the return default to CACHE_INODE_SUCCESS */
@@ -97,167 +364,58 @@ cache_entry_t *cache_inode_operate_cached_dirent(cache_entry_t * pentry_parent,
       return NULL;
     }
 
-  /* Try to look into the dir and its dir_cont. At this point, it must be said than lock on dir_cont are
-   *  taken when a lock is previously acquired on the related dir_begin */
-  pdir_chain = pentry_parent;
+  /* Look the name up in the dirent index of the dir_chain. At this point, it must be said than lock on
+   * dir_cont are taken when a lock is previously acquired on the related dir_begin */
+  pdirent = cache_inode_dirent_find(pentry_parent, pname, TRUE, &pdir_chain);
 
-  do
+  if(pdirent == NULL)
     {
-      /* Is this entry known ? */
-      if(pdir_chain->internal_md.type == DIR_BEGINNING)
-        {
-          for(i = 0; i < CHILDREN_ARRAY_SIZE; i++)
-            {
+      *pstatus = CACHE_INODE_NOT_FOUND;
+      return NULL;
+    }
 
-              LogFullDebug(COMPONENT_NFS_READDIR,
-                           "DIR_BEGINNING %d | %d | %s | %s",
-                           pdir_chain->object.dir_begin.pdir_data->dir_entries[i].active,
-                           pdir_chain->object.dir_begin.pdir_data->dir_entries[i].pentry->
-                           internal_md.valid_state, pname->name,
-                           pdir_chain->object.dir_begin.pdir_data->dir_entries[i].name.name);
-
-              vstate = pdir_chain->object.dir_begin.pdir_data->dir_entries[i].pentry->internal_md.valid_state;
-
-              if(pdir_chain->object.dir_begin.pdir_data->dir_entries[i].active == VALID
-                 && (vstate == VALID || vstate == STALE)
-                 && !FSAL_namecmp(pname,
-                                  &(pdir_chain->object.dir_begin.pdir_data->
-                                    dir_entries[i].name)))
-                {
-                  if (vstate == STALE)
-                    LogDebug(COMPONENT_NFS_READDIR,
-                             "DIR_BEGINNING: found STALE cache entry");
-
-                  /* Entry was found */
-                  pentry = pdir_chain->object.dir_begin.pdir_data->dir_entries[i].pentry;
-                  *pstatus = CACHE_INODE_SUCCESS;
-                  break;
-                }
-            }
+  /* Entry was found */
+  pentry = pdirent->pentry;
+  i = pdirent - cache_inode_dirent_data(pdir_chain)->dir_entries;
 
-          if(pentry != NULL)
-            break;              /* Exit the do...while loop */
+  switch (dirent_op)
+    {
+    case CACHE_INODE_DIRENT_OP_REMOVE:
+      /* Related DIR_BEGINNING or DIR_CONTINUE is pointed by pdir_chain, entry is the i-th is dir_entries
+       * The dirent entry is removed by being set invalid */
+      cache_inode_dirent_invalidate(pdir_chain, i);
+      *pstatus = CACHE_INODE_SUCCESS;
+      break;
 
-          /* Do we have to go on browsing the cache_inode ? */
-          /* We have to check if eod is reached and no pentry found */
-          if(pdir_chain->object.dir_begin.end_of_dir == END_OF_DIR)
-            {
-              pentry = NULL;
-              *pstatus = CACHE_INODE_NOT_FOUND;
-              break;
-            }
+    case CACHE_INODE_DIRENT_OP_RENAME:
+      /* Entry to rename is the i-th in pdir_chain, it has to be indexed under its new name */
+      cache_inode_dirent_invalidate(pdir_chain, i);
 
-          /* Next step, release the lock and acquire a new one */
-          pdir_chain = pdir_chain->object.dir_begin.pdir_cont;
-        }
-      else
-        {
-          /* Entry is no DIR_BEGINNING, it is of type DIR_CONTINUE */
-          for(i = 0; i < CHILDREN_ARRAY_SIZE; i++)
-            {
-              /*
-                 printf( "DIR_CONTINUE %d | %d | %s | %s\n",
-                 pdir_chain->object.dir_cont.pdir_data->dir_entries[i].active,
-                 pdir_chain->object.dir_cont.pdir_data->dir_entries[i].pentry->internal_md.valid_state,
-                 name.name,
-                 pdir_chain->object.dir_cont.pdir_data->dir_entries[i].name.name ) ; */
-
-              vstate = pdir_chain->object.dir_cont.pdir_data->dir_entries[i].pentry->internal_md.valid_state;
-
-              if(pdir_chain->object.dir_cont.pdir_data->dir_entries[i].active == VALID
-                 && (vstate == VALID || vstate == STALE)
-                 && !FSAL_namecmp(pname,
-                                  &(pdir_chain->object.dir_cont.pdir_data->
-                                    dir_entries[i].name)))
-                {
-                  if (vstate == STALE)
-                    LogDebug(COMPONENT_NFS_READDIR,
-                             "DIR_CONTINUE: found STALE cache entry");
-
-                  /* Entry was found */
-                  pentry = pdir_chain->object.dir_cont.pdir_data->dir_entries[i].pentry;
-                  *pstatus = CACHE_INODE_SUCCESS;
-                  break;
-                }
-            }
+      fsal_status = FSAL_namecpy(&pdirent->name, newname);
 
-          if(pentry != NULL)
-            break;              /* Exit the do...while loop */
+      pdirent->active = VALID;
+      if(pdir_chain->internal_md.type == DIR_BEGINNING)
+        pdir_chain->object.dir_begin.nbactive += 1;
+      else
+        pdir_chain->object.dir_cont.nbactive += 1;
+      cache_inode_dirent_index_insert(pdir_chain, i);
 
-          /* Do we have to go on browsing the cache_inode ? */
-          if(pdir_chain->object.dir_cont.end_of_dir == END_OF_DIR)
-            {
-              pentry = NULL;
-              *pstatus = CACHE_INODE_NOT_FOUND;
-              break;
-            }
-          /* Next step */
-          pdir_chain = pdir_chain->object.dir_cont.pdir_cont;
+      if(FSAL_IS_ERROR(fsal_status))
+        {
+          *pstatus = cache_inode_error_convert(fsal_status);
         }
-
-    }
-  while(pentry == NULL);
-
-  /* Did we find something */
-  if(pentry != NULL)
-    {
-      /* Yes, we did ! */
-      switch (dirent_op)
+      else
         {
-        case CACHE_INODE_DIRENT_OP_REMOVE:
-          /* Related DIR_BEGINNING or DIR_CONTINUE is pointed by pdir_chain, entry is the i-th is dir_entries
-           * The dirent entry is removed by being set invalid */
-
-          if(pdir_chain->internal_md.type == DIR_BEGINNING)
-            {
-              pdir_chain->object.dir_begin.pdir_data->dir_entries[i].active = INVALID;
-              pdir_chain->object.dir_begin.nbactive -= 1;
-              *pstatus = CACHE_INODE_SUCCESS;
-            }
-          else if(pdir_chain->internal_md.type == DIR_CONTINUE)
-            {
-              pdir_chain->object.dir_cont.pdir_data->dir_entries[i].active = INVALID;
-              pdir_chain->object.dir_cont.nbactive -= 1;
-              *pstatus = CACHE_INODE_SUCCESS;
-            }
-          else
-            *pstatus = CACHE_INODE_INVALID_ARGUMENT;
-          break;
+          *pstatus = CACHE_INODE_SUCCESS;
+        }
+      break;
 
-        case CACHE_INODE_DIRENT_OP_RENAME:
-          /* Entry to rename is the i-th in pdir_chain */
-          if(pdir_chain->internal_md.type == DIR_BEGINNING)
-            {
-              fsal_status =
-                  FSAL_namecpy(&
-                               (pdir_chain->object.dir_begin.pdir_data->dir_entries[i].
-                                name), newname);
-            }
-          else
-            {
-              fsal_status =
-                  FSAL_namecpy(&
-                               (pdir_chain->object.dir_cont.pdir_data->dir_entries[i].
-                                name), newname);
-            }
+    default:
+      /* Should never occurs, in any case, it cost nothing to handle this situation */
+      *pstatus = CACHE_INODE_INVALID_ARGUMENT;
+      break;
 
-          if(FSAL_IS_ERROR(fsal_status))
-            {
-              *pstatus = cache_inode_error_convert(fsal_status);
-            }
-          else
-            {
-              *pstatus = CACHE_INODE_SUCCESS;
-            }
-          break;
-
-        default:
-          /* Should never occurs, in any case, it cost nothing to handle this situation */
-          *pstatus = CACHE_INODE_INVALID_ARGUMENT;
-          break;
-
-        }                       /* switch */
-    }
+    }                           /* switch */
 
   /* Last lock released */
 
@@ -515,13 +673,26 @@ cache_inode_status_t cache_inode_add_cached_dirent(cache_entry_t * pentry_parent
           return *pstatus;
         }
 
+      /* A reused DIR_CONTINUE is now the last element of the dir_chain, the
+       * invalidated ones that may follow it will be chained again when needed */
+      pentry->object.dir_cont.end_of_dir = END_OF_DIR;
+
+      /* Make the new DIR_CONTINUE reachable by cookie */
+      if(cache_inode_dirent_chunk_set(cache_inode_dirent_begin(pdir_chain),
+                                      pentry) != CACHE_INODE_SUCCESS)
+        {
+          *pstatus = CACHE_INODE_MALLOC_ERROR;
+          return *pstatus;
+        }
+
       /* slot to be used in the dirent array will be the first */
       slot_index = 0;
     }
 
   /* pentry is not NULL, if it was NULL a new DIR_CONTINUE has just been allocated */
 
-  GetFromPool(next_parent_entry, &pclient->pool_parent, cache_inode_parent_entry_t);
+  CACHE_INODE_GET_FROM_POOL(next_parent_entry, pclient, pool_parent,
+                            cache_inode_parent_entry_t);
 
   if(next_parent_entry == NULL)
     {
@@ -535,44 +706,24 @@ cache_inode_status_t cache_inode_add_cached_dirent(cache_entry_t * pentry_parent
   next_parent_entry->parent = NULL;
   next_parent_entry->next_parent = NULL;
 
-  if(pentry->internal_md.type == DIR_BEGINNING)
+  fsal_status =
+      FSAL_namecpy(&cache_inode_dirent_data(pentry)->dir_entries[slot_index].name, pname);
+  if(FSAL_IS_ERROR(fsal_status))
     {
-      pentry->object.dir_begin.nbactive += 1;
-
-      pentry->object.dir_begin.pdir_data->dir_entries[slot_index].active = VALID;
-      pentry->object.dir_begin.pdir_data->dir_entries[slot_index].pentry = pentry_added;
-
-      fsal_status =
-          FSAL_namecpy(&pentry->object.dir_begin.pdir_data->dir_entries[slot_index].name,
-                       pname);
-      if(FSAL_IS_ERROR(fsal_status))
-        {
-          *pstatus = CACHE_INODE_FSAL_ERROR;
-          pentry->object.dir_begin.nbactive -= 1;
-          pentry = NULL;
-          return *pstatus;
-        }
+      *pstatus = CACHE_INODE_FSAL_ERROR;
+      CACHE_INODE_RELEASE_TO_POOL(next_parent_entry, pclient, pool_parent);
+      pentry = NULL;
+      return *pstatus;
     }
-  else
-    {
-      /* DIR_CONTINUE */
-      pentry->object.dir_cont.nbactive += 1;
 
-      pentry->object.dir_cont.pdir_data->dir_entries[slot_index].active = VALID;
-      pentry->object.dir_cont.pdir_data->dir_entries[slot_index].pentry = pentry_added;
-
-      fsal_status =
-          FSAL_namecpy(&pentry->object.dir_cont.pdir_data->dir_entries[slot_index].name,
-                       pname);
-      if(FSAL_IS_ERROR(fsal_status))
-        {
-          *pstatus = CACHE_INODE_FSAL_ERROR;
-          pentry->object.dir_cont.nbactive -= 1;
-          pentry = NULL;
-          return *pstatus;
-        }
+  if(pentry->internal_md.type == DIR_BEGINNING)
+    pentry->object.dir_begin.nbactive += 1;
+  else
+    pentry->object.dir_cont.nbactive += 1;
 
-    }
+  cache_inode_dirent_data(pentry)->dir_entries[slot_index].active = VALID;
+  cache_inode_dirent_data(pentry)->dir_entries[slot_index].pentry = pentry_added;
+  cache_inode_dirent_index_insert(pentry, slot_index);
 
   /* link with the parent entry (insert as first entry) */
   next_parent_entry->subdirpos = slot_index;
@@ -621,6 +772,10 @@ cache_inode_status_t cache_inode_invalidate_all_cached_dirent(cache_entry_t * pe
       return *pstatus;
     }
 
+  /* The dirent_names nodes are dropped all at once, the dirents are set invalid below */
+  RBT_HEAD_INIT(&pentry_dir->object.dir_begin.dirent_names);
+  pentry_dir->object.dir_begin.dir_cont_index_nb = 1;
+
   /* Get ride of entries cached in the DIR_BEGINNING */
   pentry = pentry_dir;
 
@@ -765,6 +920,7 @@ cache_inode_status_t cache_inode_readdir_populate(cache_entry_t * pentry_dir,
   cache_entry_t *next_pentry_parent = NULL;
   cache_entry_t *pentry_parent = pentry_dir;
   fsal_attrib_list_t object_attributes;
+  fsal_attrib_list_t *pentry_attributes;
 
   cache_inode_create_arg_t create_arg;
   cache_inode_file_type_t type;
@@ -854,11 +1010,12 @@ cache_inode_status_t cache_inode_readdir_populate(cache_entry_t * pentry_dir,
                                  &end_cookie,
                                  &nbfound, &fsal_eod, &pclient->mfsl_context, NULL);
 #else
-      fsal_status = FSAL_readdir(&fsal_dirhandle,
-                                 begin_cookie,
-                                 pclient->attrmask,
-                                 FSAL_READDIR_SIZE * sizeof(fsal_dirent_t),
-                                 array_dirent, &end_cookie, &nbfound, &fsal_eod);
+      /* Names, handles and attributes of a whole batch come in one FSAL call */
+      fsal_status = FSAL_readdir_plus(&fsal_dirhandle,
+                                      begin_cookie,
+                                      pclient->attrmask,
+                                      FSAL_READDIR_SIZE,
+                                      array_dirent, &end_cookie, &nbfound, &fsal_eod);
 #endif
 
       if(FSAL_IS_ERROR(fsal_status))
@@ -932,7 +1089,14 @@ cache_inode_status_t cache_inode_readdir_populate(cache_entry_t * pentry_dir,
           new_entry_fsdata.handle = array_dirent[iter].handle;
           new_entry_fsdata.cookie = 0;
 
-          if((pentry = cache_inode_new_entry(&new_entry_fsdata, &array_dirent[iter].attributes, type, &create_arg, NULL, ht, pclient, pcontext, FALSE,  /* This is population and no creation */
+          /* The FSAL could not read these attributes, cache_inode_new_entry will ask again */
+          if(FSAL_TEST_MASK(array_dirent[iter].attributes.asked_attributes,
+                            FSAL_ATTR_RDATTR_ERR))
+            pentry_attributes = NULL;
+          else
+            pentry_attributes = &array_dirent[iter].attributes;
+
+          if((pentry = cache_inode_new_entry(&new_entry_fsdata, pentry_attributes, type, &create_arg, NULL, ht, pclient, pcontext, FALSE,  /* This is population and no creation */
                                              pstatus)) == NULL)
             return *pstatus;
 
@@ -946,11 +1110,12 @@ cache_inode_status_t cache_inode_readdir_populate(cache_entry_t * pentry_dir,
              && cache_status != CACHE_INODE_ENTRY_EXISTS)
             return *pstatus;
 
+          /* The dir_chain is filled in order, the next free slot is in the
+           * DIR_CONTINUE that received this entry or in the following ones,
+           * so the insertion does not rescan the chunks already full */
+          pentry_parent = next_pentry_parent;
         }
 
-      /* Step to next item in dir_chain */
-      pentry_parent = next_pentry_parent;
-
       /* Get prepared for next step */
       begin_cookie = end_cookie;
     }
@@ -1029,7 +1194,7 @@ cache_inode_status_t cache_inode_readdir(cache_entry_t * dir_pentry,
 
   /* stats */
   pclient->stat.nb_call_total += 1;
-  pclient->stat.func_stats.nb_call[CACHE_INODE_READDIR] += 1;
+  inc_func_call(pclient, CACHE_INODE_READDIR);
 
   LogFullDebug(COMPONENT_NFS_READDIR,
                "--> Cache_inode_readdir: parameters are cookie=%u nbwanted=%u",
@@ -1045,7 +1210,7 @@ cache_inode_status_t cache_inode_readdir(cache_entry_t * dir_pentry,
       *peod_met = TO_BE_CONTINUED;
 
       /* stats */
-      pclient->stat.func_stats.nb_success[CACHE_INODE_READDIR] += 1;
+      inc_func_success(pclient, CACHE_INODE_READDIR);
 
       return *pstatus;
     }
@@ -1056,7 +1221,7 @@ cache_inode_status_t cache_inode_readdir(cache_entry_t * dir_pentry,
   if(cache_inode_renew_entry(dir_pentry, NULL, ht, pclient, pcontext, pstatus) !=
      CACHE_INODE_SUCCESS)
     {
-      pclient->stat.func_stats.nb_err_retryable[CACHE_INODE_GETATTR] += 1;
+      inc_func_err_retryable(pclient, CACHE_INODE_GETATTR);
       V_w(&dir_pentry->lock);
       return *pstatus;
     }
@@ -1069,7 +1234,7 @@ cache_inode_status_t cache_inode_readdir(cache_entry_t * dir_pentry,
       *pstatus = CACHE_INODE_BAD_TYPE;
 
       /* stats */
-      pclient->stat.func_stats.nb_err_unrecover[CACHE_INODE_READDIR] += 1;
+      inc_func_err_unrecover(pclient, CACHE_INODE_READDIR);
 
       return *pstatus;
     }
@@ -1083,7 +1248,7 @@ cache_inode_status_t cache_inode_readdir(cache_entry_t * dir_pentry,
     {
       V_w(&dir_pentry->lock);
 
-      pclient->stat.func_stats.nb_err_retryable[CACHE_INODE_READDIR] += 1;
+      inc_func_err_retryable(pclient, CACHE_INODE_READDIR);
       return *pstatus;
     }
 
@@ -1100,7 +1265,7 @@ cache_inode_status_t cache_inode_readdir(cache_entry_t * dir_pentry,
                                           pcontext, pstatus) != CACHE_INODE_SUCCESS)
             {
               /* stats */
-              pclient->stat.func_stats.nb_err_unrecover[CACHE_INODE_READDIR] += 1;
+              inc_func_err_unrecover(pclient, CACHE_INODE_READDIR);
 
               V_w(&dir_pentry->lock);
               return *pstatus;
@@ -1130,7 +1295,7 @@ cache_inode_status_t cache_inode_readdir(cache_entry_t * dir_pentry,
                                           pcontext, pstatus) != CACHE_INODE_SUCCESS)
             {
               /* stats */
-              pclient->stat.func_stats.nb_err_unrecover[CACHE_INODE_READDIR] += 1;
+              inc_func_err_unrecover(pclient, CACHE_INODE_READDIR);
 
               V_w(&dir_pentry->lock);
               return *pstatus;
@@ -1162,80 +1327,40 @@ cache_inode_status_t cache_inode_readdir(cache_entry_t * dir_pentry,
       /* First call: the two first entries should be '.' and '..' */
     }
 
-  /* loop into the dirent array to locate the pdir_chain item related to the input cookie */
-  nbdirchain = 0;
-  pentry_to_read = dir_pentry;
+  /* Locate the pdir_chain item related to the input cookie through the chunk index */
+  nbdirchain = cookie / CHILDREN_ARRAY_SIZE;
 
-  while(cookie - first_pentry_cookie >= CHILDREN_ARRAY_SIZE)    /* ????? */
+  if(cookie < first_pentry_cookie ||
+     (pentry_to_read = cache_inode_dirent_chunk(cache_inode_dirent_begin(dir_pentry),
+                                                nbdirchain)) == NULL)
     {
-      nbdirchain += 1;
+      /* The provided cookie was far too big for this pdir_chain. The
+       * client to cache_inode tried to read beyond the end of directory.
+       * In this case, return that EOD was met, but no entries found. */
 
-      if(pentry_to_read->internal_md.type == DIR_BEGINNING)
-        {
-          /* if cookie - first_pentry_cookie is bigger than  CHILDREN_ARRAY_SIZE
-           * then the provided cookie was far too big for this pdir_chain. The
-           * client to cache_inode tried to read beyond the end of directory.
-           * In this case, return that EOD was met, but no entries found. */
-
-          if(pentry_to_read->object.dir_begin.end_of_dir == END_OF_DIR)
-            {
-              /* stats */
-              pclient->stat.func_stats.nb_success[CACHE_INODE_READDIR] += 1;
-
-              if(pentry_to_read->internal_md.type == DIR_BEGINNING)
-                *pstatus = cache_inode_valid(pentry_to_read, CACHE_INODE_OP_GET, pclient);
-              else
-                *pstatus = CACHE_INODE_SUCCESS;
-
-              V_r(&dir_pentry->lock);
-
-              LogFullDebug(COMPONENT_NFS_READDIR,
-                           "Big input cookie found in cache_inode_readdir (DIR_BEGIN) : pentry=%p cookie=%d first_pentry_cookie=%d nbdirchain=%d",
-                           pentry_to_read, cookie,
-                           first_pentry_cookie, nbdirchain);
-
-              /* Set the returned values */
-              *pnbfound = 0;
-              *pend_cookie = cookie;
-              *peod_met = END_OF_DIR;
+      /* stats */
+      inc_func_success(pclient, CACHE_INODE_READDIR);
 
-              return *pstatus;
-            }
-          pentry_iter = pentry_to_read->object.dir_begin.pdir_cont;
-        }
+      if(dir_pentry->internal_md.type == DIR_BEGINNING)
+        *pstatus = cache_inode_valid(dir_pentry, CACHE_INODE_OP_GET, pclient);
       else
-        {
-          if(pentry_to_read->object.dir_cont.end_of_dir == END_OF_DIR)
-            {
-              V_r(&dir_pentry->lock);
+        *pstatus = CACHE_INODE_SUCCESS;
 
-              /* stats */
-              pclient->stat.func_stats.nb_success[CACHE_INODE_READDIR] += 1;
+      V_r(&dir_pentry->lock);
 
-              /* OPeration is a success */
-              *pstatus = CACHE_INODE_SUCCESS;
-              LogFullDebug(COMPONENT_NFS_READDIR,
-                           "Trouble found in cache_inode_readdir (DIR_CONTINUE) : pentry=%p cookie=%d first_pentry_cookie=%d nbdirchain=%d",
-                           pentry_to_read, cookie,
-                           first_pentry_cookie, nbdirchain);
-              /* Set the returned values */
-              *pnbfound = 0;
-              *pend_cookie = cookie;
-              *peod_met = END_OF_DIR;
-
-              return *pstatus;
-            }
-          pentry_iter = pentry_to_read->object.dir_cont.pdir_cont;
-        }
+      LogFullDebug(COMPONENT_NFS_READDIR,
+                   "Big input cookie found in cache_inode_readdir : pentry=%p cookie=%d first_pentry_cookie=%d nbdirchain=%d",
+                   dir_pentry, cookie, first_pentry_cookie, nbdirchain);
 
-      pentry_to_read = pentry_iter;
+      /* Set the returned values */
+      *pnbfound = 0;
+      *pend_cookie = cookie;
+      *peod_met = END_OF_DIR;
 
-      /* At this step, pentry can't be something different of a DIR_CONTINUE,
-       * becase  cookie - first_pentry_cookie >= CHILDREN_ARRAY_SIZE */
-      first_pentry_cookie =
-          pentry_to_read->object.dir_cont.dir_cont_pos * CHILDREN_ARRAY_SIZE;
+      return *pstatus;
+    }
 
-    }                           /* while */
+  first_pentry_cookie = nbdirchain * CHILDREN_ARRAY_SIZE;
 
   LogFullDebug(COMPONENT_NFS_READDIR,
                "About to readdir in  cache_inode_readdir: pentry=%p cookie=%d first_pentry_cookie=%d nbdirchain=%d",
@@ -1302,44 +1427,22 @@ cache_inode_status_t cache_inode_readdir(cache_entry_t * dir_pentry,
       if((cookie_iter % CHILDREN_ARRAY_SIZE) == 0)
         {
           /* It's time to step to the next dir_cont */
-          if(pentry_to_read->internal_md.type == DIR_BEGINNING)
+          pentry_iter = cache_inode_dirent_chunk(cache_inode_dirent_begin(dir_pentry),
+                                                 cookie_iter / CHILDREN_ARRAY_SIZE);
+          if(pentry_iter == NULL)
             {
-              if(pentry_to_read->object.dir_begin.end_of_dir == END_OF_DIR)
-                {
-                  /* End of dir is reached */
-                  *peod_met = END_OF_DIR;
-
-                  *pstatus = CACHE_INODE_SUCCESS;
-                  V_r(&dir_pentry->lock);
-
-                  /* stats */
-                  pclient->stat.func_stats.nb_err_unrecover[CACHE_INODE_READDIR] += 1;
-
-                  return *pstatus;
-                }
-              pentry_iter = pentry_to_read->object.dir_begin.pdir_cont;
-              pentry_to_read = pentry_iter;
-              /* cookie_iter = 0 ; */
-            }
-          else
-            {
-              if(pentry_to_read->object.dir_cont.end_of_dir == END_OF_DIR)
-                {
-                  /* End of dir is reached */
-                  *peod_met = END_OF_DIR;
+              /* End of dir is reached */
+              *peod_met = END_OF_DIR;
 
-                  *pstatus = CACHE_INODE_SUCCESS;
-                  V_r(&dir_pentry->lock);
+              *pstatus = CACHE_INODE_SUCCESS;
+              V_r(&dir_pentry->lock);
 
-                  /* stats */
-                  pclient->stat.func_stats.nb_err_unrecover[CACHE_INODE_READDIR] += 1;
+              /* stats */
+              inc_func_err_unrecover(pclient, CACHE_INODE_READDIR);
 
-                  return *pstatus;
-                }
-              pentry_iter = pentry_to_read->object.dir_cont.pdir_cont;
-              pentry_to_read = pentry_iter;
-              /* cookie_iter = 0 ; */
+              return *pstatus;
             }
+          pentry_to_read = pentry_iter;
         }
       /* if( cookie_iter == CHILDREN_ARRAY_SIZE ) */
     }                           /* for( i = 0 ; i < nbwanted ; i ++ ) */
@@ -1353,9 +1456,9 @@ cache_inode_status_t cache_inode_readdir(cache_entry_t * dir_pentry,
 
   /* stat */
   if(*pstatus != CACHE_INODE_SUCCESS)
-    pclient->stat.func_stats.nb_err_retryable[CACHE_INODE_READDIR] += 1;
+    inc_func_err_retryable(pclient, CACHE_INODE_READDIR);
   else
-    pclient->stat.func_stats.nb_success[CACHE_INODE_READDIR] += 1;
+    inc_func_success(pclient, CACHE_INODE_READDIR);
 
   return *pstatus;
 }                               /* cache_inode_readdir */
@@ -67,14 +67,14 @@ cache_inode_status_t cache_inode_readlink(cache_entry_t * pentry, fsal_path_t *
 
   /* stats */
   pclient->stat.nb_call_total += 1;
-  pclient->stat.func_stats.nb_call[CACHE_INODE_READLINK] += 1;
+  inc_func_call(pclient, CACHE_INODE_READLINK);
 
   /* Lock the entry */
   P_w(&pentry->lock);
   if(cache_inode_renew_entry(pentry, NULL, ht, pclient, pcontext, pstatus) !=
      CACHE_INODE_SUCCESS)
     {
-      pclient->stat.func_stats.nb_err_retryable[CACHE_INODE_READLINK] += 1;
+      inc_func_err_retryable(pclient, CACHE_INODE_READLINK);
       V_w(&pentry->lock);
       return *pstatus;
     }
@@ -97,7 +97,7 @@ cache_inode_status_t cache_inode_readlink(cache_entry_t * pentry, fsal_path_t *
       V_r(&pentry->lock);
 
       /* stats */
-      pclient->stat.func_stats.nb_err_unrecover[CACHE_INODE_READLINK] += 1;
+      inc_func_err_unrecover(pclient, CACHE_INODE_READLINK);
 
       return *pstatus;
       break;
@@ -127,7 +127,7 @@ cache_inode_status_t cache_inode_readlink(cache_entry_t * pentry, fsal_path_t *
               *pstatus = CACHE_INODE_FSAL_ESTALE;
             }
           /* stats */
-          pclient->stat.func_stats.nb_err_unrecover[CACHE_INODE_READLINK] += 1;
+          inc_func_err_unrecover(pclient, CACHE_INODE_READLINK);
 
           return *pstatus;
         }
@@ -141,9 +141,9 @@ cache_inode_status_t cache_inode_readlink(cache_entry_t * pentry, fsal_path_t *
 
   /* stat */
   if(*pstatus != CACHE_INODE_SUCCESS)
-    pclient->stat.func_stats.nb_err_retryable[CACHE_INODE_READLINK] += 1;
+    inc_func_err_retryable(pclient, CACHE_INODE_READLINK);
   else
-    pclient->stat.func_stats.nb_success[CACHE_INODE_READLINK] += 1;
+    inc_func_success(pclient, CACHE_INODE_READLINK);
 
   return *pstatus;
 }                               /* cache_inode_readlink */
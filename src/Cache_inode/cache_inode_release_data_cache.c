@@ -69,7 +69,7 @@ cache_inode_status_t cache_inode_release_data_cache(cache_entry_t * pentry,
 
   /* stats */
   pclient->stat.nb_call_total += 1;
-  pclient->stat.func_stats.nb_call[CACHE_INODE_RELEASE_DATA_CACHE] += 1;
+  inc_func_call(pclient, CACHE_INODE_RELEASE_DATA_CACHE);
 
   P_w(&pentry->lock);
 
@@ -80,7 +80,7 @@ cache_inode_status_t cache_inode_release_data_cache(cache_entry_t * pentry,
       V_w(&pentry->lock);
 
       /* stats */
-      pclient->stat.func_stats.nb_err_unrecover[CACHE_INODE_RELEASE_DATA_CACHE] += 1;
+      inc_func_err_unrecover(pclient, CACHE_INODE_RELEASE_DATA_CACHE);
 
       return *pstatus;
     }
@@ -93,7 +93,7 @@ cache_inode_status_t cache_inode_release_data_cache(cache_entry_t * pentry,
       V_w(&pentry->lock);
 
       /* stats */
-      pclient->stat.func_stats.nb_err_retryable[CACHE_INODE_RELEASE_DATA_CACHE] += 1;
+      inc_func_err_retryable(pclient, CACHE_INODE_RELEASE_DATA_CACHE);
 
       return *pstatus;
     }
@@ -107,7 +107,7 @@ cache_inode_status_t cache_inode_release_data_cache(cache_entry_t * pentry,
       V_w(&pentry->lock);
 
       /* stats */
-      pclient->stat.func_stats.nb_err_unrecover[CACHE_INODE_RELEASE_DATA_CACHE] += 1;
+      inc_func_err_unrecover(pclient, CACHE_INODE_RELEASE_DATA_CACHE);
 
       return *pstatus;
     }
@@ -119,7 +119,7 @@ cache_inode_status_t cache_inode_release_data_cache(cache_entry_t * pentry,
   *pstatus = CACHE_INODE_SUCCESS;
 
   /* stats */
-  pclient->stat.func_stats.nb_err_unrecover[CACHE_INODE_RELEASE_DATA_CACHE] += 1;
+  inc_func_err_unrecover(pclient, CACHE_INODE_RELEASE_DATA_CACHE);
 
   return *pstatus;
 }                               /* cache_inode_release_data_cache */
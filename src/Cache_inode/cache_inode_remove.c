@@ -50,46 +50,16 @@
 cache_inode_status_t cache_inode_is_dir_empty(cache_entry_t * pentry)
 {
   cache_inode_status_t status;
-  cache_entry_t *pentry_iter;
 
   /* Sanity check */
   if(pentry->internal_md.type != DIR_BEGINNING)
     return CACHE_INODE_BAD_TYPE;
 
-  /* Initialisation */
-  status = CACHE_INODE_SUCCESS;
-  pentry_iter = pentry;
-
-  do
-    {
-      if(pentry_iter->internal_md.type == DIR_BEGINNING)
-        {
-          if(pentry_iter->object.dir_begin.nbactive != 0)
-            {
-              status = CACHE_INODE_DIR_NOT_EMPTY;
-              break;
-            }
-
-          if(pentry_iter->object.dir_begin.end_of_dir == END_OF_DIR)
-            break;
-
-          pentry_iter = pentry_iter->object.dir_begin.pdir_cont;
-        }
-      else
-        {
-          if(pentry_iter->object.dir_cont.nbactive != 0)
-            {
-              status = CACHE_INODE_DIR_NOT_EMPTY;
-              break;
-            }
-
-          if(pentry_iter->object.dir_cont.end_of_dir == END_OF_DIR)
-            break;
-
-          pentry_iter = pentry_iter->object.dir_cont.pdir_cont;
-        }
-    }
-  while(pentry_iter != NULL);
+  /* Every active dirent of the dir_chain is in the dirent_names index */
+  if(RBT_COUNT(&pentry->object.dir_begin.dirent_names) != 0)
+    status = CACHE_INODE_DIR_NOT_EMPTY;
+  else
+    status = CACHE_INODE_SUCCESS;
 
   return status;
 }                               /* cache_inode_is_dir_empty */
@@ -146,15 +116,8 @@ cache_inode_status_t cache_inode_clean_internal(cache_entry_t * to_remove_entry,
       return status;
     }
 
-  /* Invalidate the related LRU gc entry (no more required) */
-  if(to_remove_entry->gc_lru_entry != NULL)
-    {
-      if(LRU_invalidate(to_remove_entry->gc_lru, to_remove_entry->gc_lru_entry)
-         != LRU_LIST_SUCCESS)
-        {
-          return CACHE_INODE_LRU_ERROR;
-        }
-    }
+  /* Remove the entry from the gc LRU (no more required) */
+  cache_inode_lru_remove(to_remove_entry);
 
   /* delete the entry from the cache */
   fsaldata.handle = *pfsal_handle_remove;
@@ -211,11 +174,19 @@ cache_inode_status_t cache_inode_clean_internal(cache_entry_t * to_remove_entry,
       parent_iter = parent_iter_next;
     }
 
+  /* Unstable data of a removed file is not to be written */
+  if(to_remove_entry->internal_md.type == REGULAR_FILE)
+    {
+      cache_inode_unstable_release(to_remove_entry);
+      cache_inode_readahead_release(to_remove_entry);
+    }
+
   /* If entry is a DIR_CONTINUE or a DIR_BEGINNING, release pdir_data */
   if(to_remove_entry->internal_md.type == DIR_BEGINNING)
     {
       /* Put the pentry back to the pool */
       ReleaseToPool(to_remove_entry->object.dir_begin.pdir_data, &pclient->pool_dir_data);
+      cache_inode_dirent_index_release(to_remove_entry);
     }
 
   if(to_remove_entry->internal_md.type == DIR_CONTINUE)
@@ -268,7 +239,7 @@ cache_inode_status_t cache_inode_remove_sw(cache_entry_t * pentry,             /
 
   /* stats */
   pclient->stat.nb_call_total += 1;
-  pclient->stat.func_stats.nb_call[CACHE_INODE_REMOVE] += 1;
+  inc_func_call(pclient, CACHE_INODE_REMOVE);
 
   /* pentry is a directory */
   if(use_mutex)
@@ -443,7 +414,7 @@ cache_inode_status_t cache_inode_remove_sw(cache_entry_t * pentry,             /
           V_w(&to_remove_entry->lock);
           V_w(&pentry->lock);
         }
-      pclient->stat.func_stats.nb_err_unrecover[CACHE_INODE_REMOVE] += 1;
+      inc_func_err_unrecover(pclient, CACHE_INODE_REMOVE);
       return status;
     }
 
@@ -613,9 +584,9 @@ cache_inode_status_t cache_inode_remove_sw(cache_entry_t * pentry,             /
     }
 
   if(status == CACHE_INODE_SUCCESS)
-    pclient->stat.func_stats.nb_success[CACHE_INODE_REMOVE] += 1;
+    inc_func_success(pclient, CACHE_INODE_REMOVE);
   else
-    pclient->stat.func_stats.nb_err_unrecover[CACHE_INODE_REMOVE] += 1;
+    inc_func_err_unrecover(pclient, CACHE_INODE_REMOVE);
 
   return status;
 }                               /* cache_inode_remove */
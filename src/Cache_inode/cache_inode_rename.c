@@ -150,7 +150,7 @@ cache_inode_status_t cache_inode_rename(cache_entry_t * pentry_dirsrc,
 
   /* stats */
   pclient->stat.nb_call_total += 1;
-  pclient->stat.func_stats.nb_call[CACHE_INODE_RENAME] += 1;
+  inc_func_call(pclient, CACHE_INODE_RENAME);
 
   /* Are we working on directories ? */
   if((pentry_dirsrc->internal_md.type != DIR_BEGINNING
@@ -160,7 +160,7 @@ cache_inode_status_t cache_inode_rename(cache_entry_t * pentry_dirsrc,
     {
       /* Bad type .... */
       *pstatus = CACHE_INODE_BAD_TYPE;
-      pclient->stat.func_stats.nb_err_unrecover[CACHE_INODE_RENAME] += 1;
+      inc_func_err_unrecover(pclient, CACHE_INODE_RENAME);
 
       return *pstatus;
     }
@@ -198,7 +198,7 @@ cache_inode_status_t cache_inode_rename(cache_entry_t * pentry_dirsrc,
                                                       pcontext, pstatus)) == NULL)
     {
       /* Source object does not exist */
-      pclient->stat.func_stats.nb_err_unrecover[CACHE_INODE_RENAME] += 1;
+      inc_func_err_unrecover(pclient, CACHE_INODE_RENAME);
 
       /* If FSAL FH is staled, then this was managed in cache_inode_lookup */
       if(*pstatus != CACHE_INODE_FSAL_ESTALE)
@@ -245,7 +245,7 @@ cache_inode_status_t cache_inode_rename(cache_entry_t * pentry_dirsrc,
             }
 
           /* Return EISDIR */
-          pclient->stat.func_stats.nb_err_unrecover[CACHE_INODE_RENAME] += 1;
+          inc_func_err_unrecover(pclient, CACHE_INODE_RENAME);
           *pstatus = CACHE_INODE_IS_A_DIRECTORY;
 
           return *pstatus;
@@ -255,7 +255,7 @@ cache_inode_status_t cache_inode_rename(cache_entry_t * pentry_dirsrc,
          pentry_lookup_src->internal_md.type == DIR_BEGINNING)
         {
           /* Return ENOTDIR */
-          pclient->stat.func_stats.nb_err_unrecover[CACHE_INODE_RENAME] += 1;
+          inc_func_err_unrecover(pclient, CACHE_INODE_RENAME);
           *pstatus = CACHE_INODE_NOT_A_DIRECTORY;
 
           V_w(&pentry_dirsrc->lock);
@@ -273,7 +273,7 @@ cache_inode_status_t cache_inode_rename(cache_entry_t * pentry_dirsrc,
           /* There is in fact only one file (may be one of the arguments is a hard link to the other) */
 
           /* Return SUCCESS */
-          pclient->stat.func_stats.nb_success[CACHE_INODE_RENAME] += 1;
+          inc_func_success(pclient, CACHE_INODE_RENAME);
           *pstatus = cache_inode_valid(pentry_dirdest, CACHE_INODE_OP_SET, pclient);
 
           V_w(&pentry_dirsrc->lock);
@@ -295,7 +295,7 @@ cache_inode_status_t cache_inode_rename(cache_entry_t * pentry_dirsrc,
          (cache_inode_is_dir_empty(pentry_lookup_dest) != CACHE_INODE_SUCCESS))
         {
           /* The entry is a non-empty directory */
-          pclient->stat.func_stats.nb_err_unrecover[CACHE_INODE_RENAME] += 1;
+          inc_func_err_unrecover(pclient, CACHE_INODE_RENAME);
           *pstatus = CACHE_INODE_DIR_NOT_EMPTY;
 
           V_w(&pentry_dirsrc->lock);
@@ -318,7 +318,7 @@ cache_inode_status_t cache_inode_rename(cache_entry_t * pentry_dirsrc,
                                            &attrlookup, ht, pclient, pcontext, pstatus);
       if(status != CACHE_INODE_SUCCESS)
         {
-          pclient->stat.func_stats.nb_err_unrecover[CACHE_INODE_RENAME] += 1;
+          inc_func_err_unrecover(pclient, CACHE_INODE_RENAME);
           *pstatus = status;
 
           V_w(&pentry_dirsrc->lock);
@@ -368,7 +368,7 @@ cache_inode_status_t cache_inode_rename(cache_entry_t * pentry_dirsrc,
   else
     {
       *pstatus = CACHE_INODE_BAD_TYPE;
-      pclient->stat.func_stats.nb_err_unrecover[CACHE_INODE_RENAME] += 1;
+      inc_func_err_unrecover(pclient, CACHE_INODE_RENAME);
 
       V_w(&pentry_dirsrc->lock);
       if(pentry_dirsrc != pentry_dirdest)
@@ -406,7 +406,7 @@ cache_inode_status_t cache_inode_rename(cache_entry_t * pentry_dirsrc,
         }
 
       *pstatus = CACHE_INODE_BAD_TYPE;
-      pclient->stat.func_stats.nb_err_unrecover[CACHE_INODE_RENAME] += 1;
+      inc_func_err_unrecover(pclient, CACHE_INODE_RENAME);
 
       V_w(&pentry_dirsrc->lock);
       if(pentry_dirsrc != pentry_dirdest)
@@ -434,7 +434,7 @@ cache_inode_status_t cache_inode_rename(cache_entry_t * pentry_dirsrc,
   if(FSAL_IS_ERROR(fsal_status))
     {
       *pstatus = cache_inode_error_convert(fsal_status);
-      pclient->stat.func_stats.nb_err_unrecover[CACHE_INODE_RENAME] += 1;
+      inc_func_err_unrecover(pclient, CACHE_INODE_RENAME);
 
       V_w(&pentry_dirsrc->lock);
       if(pentry_dirsrc != pentry_dirdest)
@@ -514,7 +514,7 @@ cache_inode_status_t cache_inode_rename(cache_entry_t * pentry_dirsrc,
 
       if(status != CACHE_INODE_SUCCESS)
         {
-          pclient->stat.func_stats.nb_err_unrecover[CACHE_INODE_RENAME] += 1;
+          inc_func_err_unrecover(pclient, CACHE_INODE_RENAME);
           *pstatus = status;
 
           /* Unlock the pentry and exits */
@@ -537,7 +537,7 @@ cache_inode_status_t cache_inode_rename(cache_entry_t * pentry_dirsrc,
                                              NULL, ht, pclient, pcontext, pstatus);
       if(status != CACHE_INODE_SUCCESS)
         {
-          pclient->stat.func_stats.nb_err_unrecover[CACHE_INODE_RENAME] += 1;
+          inc_func_err_unrecover(pclient, CACHE_INODE_RENAME);
           *pstatus = status;
 
           V_w(&pentry_dirsrc->lock);
@@ -554,7 +554,7 @@ cache_inode_status_t cache_inode_rename(cache_entry_t * pentry_dirsrc,
                                           poldname,
                                           ht, pclient, &status) != CACHE_INODE_SUCCESS)
         {
-          pclient->stat.func_stats.nb_err_unrecover[CACHE_INODE_RENAME] += 1;
+          inc_func_err_unrecover(pclient, CACHE_INODE_RENAME);
           *pstatus = status;
 
           V_w(&pentry_dirsrc->lock);
@@ -572,15 +572,15 @@ cache_inode_status_t cache_inode_rename(cache_entry_t * pentry_dirsrc,
 
   /* stat */
   if(*pstatus != CACHE_INODE_SUCCESS)
-    pclient->stat.func_stats.nb_err_retryable[CACHE_INODE_RENAME] += 1;
+    inc_func_err_retryable(pclient, CACHE_INODE_RENAME);
   else
     {
       *pstatus = cache_inode_valid(pentry_dirdest, CACHE_INODE_OP_SET, pclient);
 
       if(*pstatus != CACHE_INODE_SUCCESS)
-        pclient->stat.func_stats.nb_err_retryable[CACHE_INODE_RENAME] += 1;
+        inc_func_err_retryable(pclient, CACHE_INODE_RENAME);
       else
-        pclient->stat.func_stats.nb_success[CACHE_INODE_RENAME] += 1;
+        inc_func_success(pclient, CACHE_INODE_RENAME);
     }
 
   /* unlock entries */
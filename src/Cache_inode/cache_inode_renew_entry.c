@@ -223,7 +223,7 @@ cache_inode_status_t cache_inode_renew_entry(cache_entry_t * pentry,
               *pstatus = CACHE_INODE_FSAL_ESTALE;
             }
           /* stat */
-          pclient->stat.func_stats.nb_err_unrecover[CACHE_INODE_RENEW_ENTRY] += 1;
+          inc_func_err_unrecover(pclient, CACHE_INODE_RENEW_ENTRY);
 
           LogDebug(COMPONENT_CACHE_INODE,
                    "cache_inode_renew_entry: returning %d (%s) from FSAL_getattrs for getattr/mtime checking",
@@ -288,7 +288,7 @@ cache_inode_status_t cache_inode_renew_entry(cache_entry_t * pentry,
 	pentry->internal_md.valid_state = VALID;
 
       /* stat */
-      pclient->stat.func_stats.nb_call[CACHE_INODE_RENEW_ENTRY] += 1;
+      inc_func_call(pclient, CACHE_INODE_RENEW_ENTRY);
 
       /* Log */
       LogDebug(COMPONENT_CACHE_INODE,
@@ -326,7 +326,7 @@ cache_inode_status_t cache_inode_renew_entry(cache_entry_t * pentry,
               *pstatus = cache_inode_error_convert(fsal_status);
 
               /* stat */
-              pclient->stat.func_stats.nb_err_unrecover[CACHE_INODE_RENEW_ENTRY] += 1;
+              inc_func_err_unrecover(pclient, CACHE_INODE_RENEW_ENTRY);
 
               if(fsal_status.major == ERR_FSAL_STALE)
                 {
@@ -382,7 +382,7 @@ cache_inode_status_t cache_inode_renew_entry(cache_entry_t * pentry,
          pentry->internal_md.valid_state = VALID;
 
       /* stat */
-      pclient->stat.func_stats.nb_call[CACHE_INODE_RENEW_ENTRY] += 1;
+      inc_func_call(pclient, CACHE_INODE_RENEW_ENTRY);
 
       /* Log */
       LogDebug(COMPONENT_CACHE_INODE,
@@ -417,7 +417,7 @@ cache_inode_status_t cache_inode_renew_entry(cache_entry_t * pentry,
           *pstatus = cache_inode_error_convert(fsal_status);
 
           /* stat */
-          pclient->stat.func_stats.nb_err_unrecover[CACHE_INODE_RENEW_ENTRY] += 1;
+          inc_func_err_unrecover(pclient, CACHE_INODE_RENEW_ENTRY);
 
           if(fsal_status.major == ERR_FSAL_STALE)
             {
@@ -469,7 +469,7 @@ cache_inode_status_t cache_inode_renew_entry(cache_entry_t * pentry,
 	pentry->internal_md.valid_state = VALID;
       
       /* stat */
-      pclient->stat.func_stats.nb_call[CACHE_INODE_RENEW_ENTRY] += 1;
+      inc_func_call(pclient, CACHE_INODE_RENEW_ENTRY);
 
       /* Log */
       LogDebug(COMPONENT_CACHE_INODE,
@@ -522,7 +522,7 @@ cache_inode_status_t cache_inode_renew_entry(cache_entry_t * pentry,
           *pstatus = cache_inode_error_convert(fsal_status);
 
           /* stat */
-          pclient->stat.func_stats.nb_err_unrecover[CACHE_INODE_RENEW_ENTRY] += 1;
+          inc_func_err_unrecover(pclient, CACHE_INODE_RENEW_ENTRY);
 
           if(fsal_status.major == ERR_FSAL_STALE)
             {
@@ -597,7 +597,7 @@ cache_inode_status_t cache_inode_renew_entry(cache_entry_t * pentry,
         {
           *pstatus = cache_inode_error_convert(fsal_status);
           /* stats */
-          pclient->stat.func_stats.nb_err_unrecover[CACHE_INODE_RENEW_ENTRY] += 1;
+          inc_func_err_unrecover(pclient, CACHE_INODE_RENEW_ENTRY);
 
           if(fsal_status.major == ERR_FSAL_STALE)
             {
@@ -625,7 +625,7 @@ cache_inode_status_t cache_inode_renew_entry(cache_entry_t * pentry,
             {
               *pstatus = cache_inode_error_convert(fsal_status);
               /* stats */
-              pclient->stat.func_stats.nb_err_unrecover[CACHE_INODE_RENEW_ENTRY] += 1;
+              inc_func_err_unrecover(pclient, CACHE_INODE_RENEW_ENTRY);
             }
         }
 
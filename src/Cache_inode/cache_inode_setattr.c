@@ -92,7 +92,7 @@ cache_inode_status_t cache_inode_setattr(cache_entry_t * pentry, fsal_attrib_lis
 
   /* stat */
   pclient->stat.nb_call_total += 1;
-  pclient->stat.func_stats.nb_call[CACHE_INODE_SETATTR] += 1;
+  inc_func_call(pclient, CACHE_INODE_SETATTR);
 
   /* Lock the entry */
   P_w(&pentry->lock);
@@ -101,6 +101,9 @@ cache_inode_status_t cache_inode_setattr(cache_entry_t * pentry, fsal_attrib_lis
     {
     case REGULAR_FILE:
       pfsal_handle = &pentry->object.file.handle;
+
+      /* Drop the prefetched data, the file may change */
+      cache_inode_readahead_invalidate(pentry);
       break;
 
     case SYMBOLIC_LINK:
@@ -162,7 +165,7 @@ cache_inode_status_t cache_inode_setattr(cache_entry_t * pentry, fsal_attrib_lis
       V_w(&pentry->lock);
 
       /* stat */
-      pclient->stat.func_stats.nb_err_unrecover[CACHE_INODE_SETATTR] += 1;
+      inc_func_err_unrecover(pclient, CACHE_INODE_SETATTR);
 
       if(fsal_status.major == ERR_FSAL_STALE)
         {
@@ -186,6 +189,10 @@ cache_inode_status_t cache_inode_setattr(cache_entry_t * pentry, fsal_attrib_lis
 
   if(pattr->asked_attributes & FSAL_ATTR_SIZE)
     {
+      /* Buffered unstable data past the new end of file is to be dropped */
+      if(pentry->internal_md.type == REGULAR_FILE)
+        cache_inode_unstable_truncate(pentry, pattr->filesize);
+
       truncate_attributes.asked_attributes = pclient->attrmask;
 
       fsal_status = FSAL_truncate(pfsal_handle,
@@ -196,7 +203,7 @@ cache_inode_status_t cache_inode_setattr(cache_entry_t * pentry, fsal_attrib_lis
           V_w(&pentry->lock);
 
           /* stat */
-          pclient->stat.func_stats.nb_err_unrecover[CACHE_INODE_SETATTR] += 1;
+          inc_func_err_unrecover(pclient, CACHE_INODE_SETATTR);
 
           if(fsal_status.major == ERR_FSAL_STALE)
             {
@@ -350,9 +357,9 @@ cache_inode_status_t cache_inode_setattr(cache_entry_t * pentry, fsal_attrib_lis
 
   /* stat */
   if(*pstatus != CACHE_INODE_SUCCESS)
-    pclient->stat.func_stats.nb_err_retryable[CACHE_INODE_SETATTR] += 1;
+    inc_func_err_retryable(pclient, CACHE_INODE_SETATTR);
   else
-    pclient->stat.func_stats.nb_success[CACHE_INODE_SETATTR] += 1;
+    inc_func_success(pclient, CACHE_INODE_SETATTR);
 
   return *pstatus;
 }                               /* cache_inode_setattr */
@@ -92,7 +92,7 @@ cache_inode_status_t cache_inode_truncate_sw(cache_entry_t * pentry,
 
   /* stats */
   pclient->stat.nb_call_total += 1;
-  pclient->stat.func_stats.nb_call[CACHE_INODE_TRUNCATE] += 1;
+  inc_func_call(pclient, CACHE_INODE_TRUNCATE);
 
   if(use_mutex)
     P_w(&pentry->lock);
@@ -105,7 +105,7 @@ cache_inode_status_t cache_inode_truncate_sw(cache_entry_t * pentry,
         V_w(&pentry->lock);
 
       /* stats */
-      pclient->stat.func_stats.nb_err_unrecover[CACHE_INODE_TRUNCATE] += 1;
+      inc_func_err_unrecover(pclient, CACHE_INODE_TRUNCATE);
 
       return *pstatus;
     }
@@ -123,7 +123,7 @@ cache_inode_status_t cache_inode_truncate_sw(cache_entry_t * pentry,
             V_w(&pentry->lock);
 
           /* stats */
-          pclient->stat.func_stats.nb_err_unrecover[CACHE_INODE_TRUNCATE] += 1;
+          inc_func_err_unrecover(pclient, CACHE_INODE_TRUNCATE);
 
           return *pstatus;
         }
@@ -143,6 +143,10 @@ cache_inode_status_t cache_inode_truncate_sw(cache_entry_t * pentry,
     }
   else
     {
+      /* Buffered unstable data past the new end of file is to be dropped */
+      cache_inode_unstable_truncate(pentry, length);
+      cache_inode_readahead_invalidate(pentry);
+
       /* Call FSAL to actually truncate */
       pentry->object.file.attributes.asked_attributes = pclient->attrmask;
 #ifdef _USE_MFSL
@@ -164,7 +168,7 @@ cache_inode_status_t cache_inode_truncate_sw(cache_entry_t * pentry,
             V_w(&pentry->lock);
 
           /* stats */
-          pclient->stat.func_stats.nb_err_unrecover[CACHE_INODE_TRUNCATE] += 1;
+          inc_func_err_unrecover(pclient, CACHE_INODE_TRUNCATE);
 
           if(fsal_status.major == ERR_FSAL_STALE)
             {
@@ -200,9 +204,9 @@ cache_inode_status_t cache_inode_truncate_sw(cache_entry_t * pentry,
 
   /* stat */
   if(*pstatus != CACHE_INODE_SUCCESS)
-    pclient->stat.func_stats.nb_err_retryable[CACHE_INODE_TRUNCATE] += 1;
+    inc_func_err_retryable(pclient, CACHE_INODE_TRUNCATE);
   else
-    pclient->stat.func_stats.nb_success[CACHE_INODE_TRUNCATE] += 1;
+    inc_func_success(pclient, CACHE_INODE_TRUNCATE);
 
   return *pstatus;
 }                               /* cache_inode_truncate_sw */
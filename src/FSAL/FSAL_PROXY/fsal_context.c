@@ -236,7 +236,16 @@ fsal_status_t PROXYFSAL_InitClientContext(fsal_op_context_t *context)
   addr_rpc.sin_family = AF_INET;
   addr_rpc.sin_addr.s_addr = p_thr_context->srv_addr;
 
-  if(!strcmp(p_thr_context->srv_proto, "udp"))
+  if(FSAL_proxy_rpc_multiplexed())
+    {
+      /* The calls of this thread will go through the shared connections */
+      if(FSAL_proxy_rpc_init() != 0)
+        Return(ERR_FSAL_FAULT, 0, INDEX_FSAL_InitClientContext);
+
+      p_thr_context->rpc_client = NULL;
+      p_thr_context->socket = -1;
+    }
+  else if(!strcmp(p_thr_context->srv_proto, "udp"))
     {
       if((sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP)) < 0)
         Return(ERR_FSAL_FAULT, errno, INDEX_FSAL_InitClientContext);
@@ -330,15 +339,16 @@ fsal_status_t PROXYFSAL_InitClientContext(fsal_op_context_t *context)
     }
   else
 #endif                          /* _USE_GSSRPC */
-  if((p_thr_context->rpc_client->cl_auth = authunix_create_default()) == NULL)
+  if(p_thr_context->rpc_client != NULL &&
+     (p_thr_context->rpc_client->cl_auth = authunix_create_default()) == NULL)
     {
       Return(ERR_FSAL_INVAL, 0, INDEX_FSAL_InitClientContext);
     }
 
   /* test if the newly created context can 'ping' the server via PROC_NULL */
-  if((rc = clnt_call(p_thr_context->rpc_client, NFSPROC4_NULL,
-                     (xdrproc_t) xdr_void, (caddr_t) NULL,
-                     (xdrproc_t) xdr_void, (caddr_t) NULL, timeout)) != RPC_SUCCESS)
+  if((rc = FSAL_proxy_rpc_call(p_thr_context, NFSPROC4_NULL,
+                               (xdrproc_t) xdr_void, (caddr_t) NULL,
+                               (xdrproc_t) xdr_void, (caddr_t) NULL, timeout)) != RPC_SUCCESS)
     {
       Return(ERR_FSAL_INVAL, rc, INDEX_FSAL_InitClientContext);
     }
@@ -138,6 +138,14 @@ int fsal_internal_ClientReconnect(proxyfsal_op_context_t * p_thr_context);
 fsal_status_t FSAL_proxy_open_confirm(proxyfsal_file_t * pfd);
 void *FSAL_proxy_change_user(proxyfsal_op_context_t * p_thr_context);
 
+int FSAL_proxy_rpc_multiplexed(void);
+int FSAL_proxy_rpc_init(void);
+int FSAL_proxy_rpc_wait_connected(unsigned int seconds);
+enum clnt_stat FSAL_proxy_rpc_call(proxyfsal_op_context_t * p_context,
+                                   rpcproc_t proc,
+                                   xdrproc_t xdr_args, caddr_t args,
+                                   xdrproc_t xdr_res, caddr_t res, struct timeval timeout);
+
 /* All the call to FSAL to be wrapped */
 fsal_status_t PROXYFSAL_access(fsal_handle_t * p_object_handle,    /* IN */
                                fsal_op_context_t * p_context,      /* IN */
@@ -267,8 +267,9 @@ do {
   do {                                                                                    \
   if( __renew_rc == 0 )                                                                   \
       {                                                                                   \
-        if( FSAL_proxy_change_user( pcontext ) == NULL ) break  ;                         \
-        if( ( rc = clnt_call( pcontext->rpc_client, NFSPROC4_COMPOUND,                    \
+        if( !FSAL_proxy_rpc_multiplexed() &&                                              \
+            FSAL_proxy_change_user( pcontext ) == NULL ) break  ;                         \
+        if( ( rc = FSAL_proxy_rpc_call( pcontext, NFSPROC4_COMPOUND,                      \
                               (xdrproc_t)xdr_COMPOUND4args, (caddr_t)&argcompound,        \
                               (xdrproc_t)xdr_COMPOUND4res,  (caddr_t)&rescompound,        \
                               timeout ) ) == RPC_SUCCESS )                                \
@@ -283,9 +284,9 @@ do {
 }  while( 0 )
 
 #define COMPOUNDV4_EXECUTE_SIMPLE( pcontext, argcompound, rescompound )   \
-   clnt_call( pcontext->rpc_client, NFSPROC4_COMPOUND,                    \
-              (xdrproc_t)xdr_COMPOUND4args, (caddr_t)&argcompound,        \
-              (xdrproc_t)xdr_COMPOUND4res,  (caddr_t)&rescompound,        \
-              timeout )
+   FSAL_proxy_rpc_call( pcontext, NFSPROC4_COMPOUND,                      \
+                        (xdrproc_t)xdr_COMPOUND4args, (caddr_t)&argcompound, \
+                        (xdrproc_t)xdr_COMPOUND4res,  (caddr_t)&rescompound, \
+                        timeout )
 
 #endif                          /* _FSAL_NFSV4_MACROS_H */
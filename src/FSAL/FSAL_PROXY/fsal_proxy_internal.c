@@ -1221,6 +1221,19 @@ int fsal_internal_ClientReconnect(proxyfsal_op_context_t * p_thr_context)
 
   LogEvent( COMPONENT_FSAL, "Remote server lost, trying to reconnect to remote server" ) ;
 
+  /* The shared connections are reconnected by their reply threads */
+  if(FSAL_proxy_rpc_multiplexed())
+    {
+      if(FSAL_proxy_rpc_wait_connected(p_thr_context->retry_sleeptime) != 0)
+        return -1;
+
+      fsal_status = FSAL_proxy_setclientid_renego(p_thr_context);
+      if(FSAL_IS_ERROR(fsal_status))
+        return -1;
+
+      return 0;
+    }
+
   /* First of all, close the formerly opened socket that is now useless */
   if( close( p_thr_context->socket ) == -1 )
     LogMajor( COMPONENT_FSAL,
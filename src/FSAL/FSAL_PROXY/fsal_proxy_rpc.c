@@ -0,0 +1,727 @@
+/*
+ * vim:expandtab:shiftwidth=8:tabstop=8:
+ */
+
+/**
+ *
+ * \file    fsal_proxy_rpc.c
+ * \brief   XID multiplexed RPC client used to talk to the remote server.
+ *
+ * Instead of one blocking RPC client per worker thread, the calls of all the
+ * threads are sent over a few shared TCP connections. Each connection has a
+ * reply thread that reads the replies and hands them over to the waiting
+ * callers by XID, so many COMPOUNDs are in flight at the same time on each
+ * connection. A connection that breaks is reconnected by its reply thread,
+ * the calls in flight fail and are retried by COMPOUNDV4_EXECUTE.
+ *
+ * The multiplexed client is only used for TCP with AUTH_UNIX credentials:
+ * UDP and RPCSEC_GSS keep the per thread CLIENT.
+ *
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#ifdef _SOLARIS
+#include "solaris_port.h"
+#endif                          /* _SOLARIS */
+
+#ifdef _USE_GSSRPC
+#include <gssrpc/rpc.h>
+#include <gssrpc/clnt.h>
+#include <gssrpc/xdr.h>
+#include <gssrpc/auth.h>
+#else
+#include <rpc/rpc.h>
+#include <rpc/clnt.h>
+#include <rpc/xdr.h>
+#include <rpc/auth.h>
+#endif
+
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/time.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+
+#include "nfs4.h"
+#include "BuddyMalloc.h"
+#include "stuff_alloc.h"
+#include "nlm_list.h"
+#include "fsal_internal.h"
+#include "fsal_common.h"
+
+#define FSAL_PROXY_RPC_NB_BUCKETS   64
+#define FSAL_PROXY_RPC_MAX_RECORD   (64 * 1024 * 1024)
+#define FSAL_PROXY_RPC_LAST_FRAG    0x80000000
+#define FSAL_PROXY_RPC_HEADER_SIZE  1024    /* Room for call header and credentials */
+
+typedef struct fsal_proxy_rpc_call__
+{
+  struct glist_head q;          /**< Link in the connection's pending calls */
+  u_int32_t xid;
+  pthread_cond_t cond;
+  int done;
+  enum clnt_stat status;
+  char *reply;                  /**< The reply record, owned by the caller once done */
+  u_int reply_len;
+} fsal_proxy_rpc_call_t;
+
+typedef struct fsal_proxy_rpc_conn__
+{
+  pthread_mutex_t lock;         /**< Protects pending, socket and connected */
+  pthread_mutex_t send_lock;    /**< Serializes the records written to the socket */
+  pthread_cond_t connected_cond;
+  int socket;
+  int connected;
+  struct glist_head pending[FSAL_PROXY_RPC_NB_BUCKETS];
+  pthread_t thrid;
+  unsigned int index;
+} fsal_proxy_rpc_conn_t;
+
+static fsal_proxy_rpc_conn_t *fsal_proxy_rpc_conns = NULL;
+static unsigned int fsal_proxy_rpc_nb_conns = 0;
+static unsigned int fsal_proxy_rpc_next_conn = 0;
+static u_int32_t fsal_proxy_rpc_xid = 0;
+static char fsal_proxy_rpc_hostname[MAXNAMLEN];
+
+extern proxyfs_specific_initinfo_t global_fsal_proxy_specific_info;
+
+#ifndef _NO_BUDDY_SYSTEM
+extern buddy_parameter_t default_buddy_parameter;
+#endif
+
+/**
+ * fsal_proxy_rpc_connect: opens a TCP connection to the remote server.
+ *
+ * \return the socket, or -1 if failed.
+ */
+static int fsal_proxy_rpc_connect(void)
+{
+  struct sockaddr_in addr_rpc;
+  int sock;
+  int priv_port = 0;
+  int one = 1;
+
+  memset(&addr_rpc, 0, sizeof(addr_rpc));
+  addr_rpc.sin_port = global_fsal_proxy_specific_info.srv_port;
+  addr_rpc.sin_family = AF_INET;
+  addr_rpc.sin_addr.s_addr = global_fsal_proxy_specific_info.srv_addr;
+
+  if(global_fsal_proxy_specific_info.use_privileged_client_port == TRUE)
+    sock = rresvport(&priv_port);
+  else
+    sock = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+
+  if(sock < 0)
+    {
+      LogCrit(COMPONENT_FSAL, "FSAL RPC: cannot create a tcp socket, errno=%u", errno);
+      return -1;
+    }
+
+  if(connect(sock, (struct sockaddr *)&addr_rpc, sizeof(addr_rpc)) < 0)
+    {
+      LogCrit(COMPONENT_FSAL,
+              "FSAL RPC: Cannot connect to server addr=%u.%u.%u.%u port=%u",
+              (ntohl(global_fsal_proxy_specific_info.srv_addr) & 0xFF000000) >> 24,
+              (ntohl(global_fsal_proxy_specific_info.srv_addr) & 0x00FF0000) >> 16,
+              (ntohl(global_fsal_proxy_specific_info.srv_addr) & 0x0000FF00) >> 8,
+              (ntohl(global_fsal_proxy_specific_info.srv_addr) & 0x000000FF),
+              ntohs(global_fsal_proxy_specific_info.srv_port));
+      close(sock);
+      return -1;
+    }
+
+  /* Small COMPOUNDs must not wait for each other */
+  setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+  return sock;
+}                               /* fsal_proxy_rpc_connect */
+
+/**
+ * fsal_proxy_rpc_readn: reads exactly len bytes from a socket.
+ *
+ * \return 0 if successful, -1 if the connection is broken.
+ */
+static int fsal_proxy_rpc_readn(int sock, char *buff, size_t len)
+{
+  ssize_t rc;
+
+  while(len > 0)
+    {
+      rc = read(sock, buff, len);
+      if(rc < 0 && errno == EINTR)
+        continue;
+      if(rc <= 0)
+        return -1;
+      buff += rc;
+      len -= rc;
+    }
+
+  return 0;
+}                               /* fsal_proxy_rpc_readn */
+
+/**
+ * fsal_proxy_rpc_writen: writes exactly len bytes to a socket.
+ *
+ * \return 0 if successful, -1 if the connection is broken.
+ */
+static int fsal_proxy_rpc_writen(int sock, char *buff, size_t len)
+{
+  ssize_t rc;
+
+  while(len > 0)
+    {
+      rc = write(sock, buff, len);
+      if(rc < 0 && errno == EINTR)
+        continue;
+      if(rc <= 0)
+        return -1;
+      buff += rc;
+      len -= rc;
+    }
+
+  return 0;
+}                               /* fsal_proxy_rpc_writen */
+
+/**
+ * fsal_proxy_rpc_read_record: reads a whole record marked RPC message.
+ *
+ * \return the record (to be freed with Mem_Free), or NULL if the connection is broken.
+ */
+static char *fsal_proxy_rpc_read_record(int sock, u_int * plen)
+{
+  char *record = NULL;
+  char *newrecord;
+  u_int32_t mark;
+  u_int len = 0;
+  u_int fraglen;
+
+  do
+    {
+      if(fsal_proxy_rpc_readn(sock, (char *)&mark, sizeof(mark)) != 0)
+        break;
+
+      mark = ntohl(mark);
+      fraglen = mark & ~FSAL_PROXY_RPC_LAST_FRAG;
+
+      if(len + fraglen > FSAL_PROXY_RPC_MAX_RECORD)
+        {
+          LogCrit(COMPONENT_FSAL, "FSAL RPC: record too large from server (%u bytes)",
+                  len + fraglen);
+          break;
+        }
+
+      if((newrecord = Mem_Realloc(record, len + fraglen + 1)) == NULL)
+        break;
+      record = newrecord;
+
+      if(fsal_proxy_rpc_readn(sock, record + len, fraglen) != 0)
+        break;
+
+      len += fraglen;
+
+      if(mark & FSAL_PROXY_RPC_LAST_FRAG)
+        {
+          *plen = len;
+          return record;
+        }
+    }
+  while(1);
+
+  if(record != NULL)
+    Mem_Free(record);
+
+  return NULL;
+}                               /* fsal_proxy_rpc_read_record */
+
+/**
+ * fsal_proxy_rpc_fail_pending: fails all the calls in flight on a broken connection.
+ *
+ * The connection's lock must be held.
+ */
+static void fsal_proxy_rpc_fail_pending(fsal_proxy_rpc_conn_t * pconn)
+{
+  struct glist_head *glist;
+  struct glist_head *glistn;
+  fsal_proxy_rpc_call_t *pcall;
+  unsigned int i;
+
+  for(i = 0; i < FSAL_PROXY_RPC_NB_BUCKETS; i++)
+    glist_for_each_safe(glist, glistn, &pconn->pending[i])
+      {
+        pcall = glist_entry(glist, fsal_proxy_rpc_call_t, q);
+        glist_del(&pcall->q);
+        pcall->status = RPC_CANTRECV;
+        pcall->done = TRUE;
+        pthread_cond_signal(&pcall->cond);
+      }
+}                               /* fsal_proxy_rpc_fail_pending */
+
+/**
+ * fsal_proxy_rpc_reply_thread: reads the replies of a connection and wakes their callers up.
+ *
+ * \param arg (input): the connection.
+ *
+ * \return never returns.
+ */
+static void *fsal_proxy_rpc_reply_thread(void *arg)
+{
+  fsal_proxy_rpc_conn_t *pconn = (fsal_proxy_rpc_conn_t *) arg;
+  struct glist_head *glist;
+  fsal_proxy_rpc_call_t *pcall;
+  char *record;
+  u_int len;
+  u_int32_t xid;
+  int sock;
+#ifndef _NO_BUDDY_SYSTEM
+  buddy_parameter_t buddy_param = default_buddy_parameter;
+
+  if(BuddyInit(&buddy_param) != BUDDY_SUCCESS)
+    {
+      LogCrit(COMPONENT_FSAL,
+              "FSAL RPC: Memory manager could not be initialized, exiting...");
+      exit(1);
+    }
+#endif
+
+  while(1)
+    {
+      P(pconn->lock);
+      sock = pconn->socket;
+      V(pconn->lock);
+
+      if(sock < 0)
+        {
+          /* Connection lost, try to get it back */
+          if((sock = fsal_proxy_rpc_connect()) < 0)
+            {
+              sleep(global_fsal_proxy_specific_info.retry_sleeptime);
+              continue;
+            }
+
+          LogEvent(COMPONENT_FSAL, "FSAL RPC: connection #%u to the remote server is back",
+                   pconn->index);
+
+          P(pconn->lock);
+          pconn->socket = sock;
+          pconn->connected = TRUE;
+          pthread_cond_broadcast(&pconn->connected_cond);
+          V(pconn->lock);
+        }
+
+      if((record = fsal_proxy_rpc_read_record(sock, &len)) == NULL)
+        {
+          LogEvent(COMPONENT_FSAL, "FSAL RPC: connection #%u to the remote server lost",
+                   pconn->index);
+
+          /* Senders hold send_lock while writing on the socket */
+          P(pconn->send_lock);
+          P(pconn->lock);
+          pconn->connected = FALSE;
+          pconn->socket = -1;
+          close(sock);
+          fsal_proxy_rpc_fail_pending(pconn);
+          V(pconn->lock);
+          V(pconn->send_lock);
+          continue;
+        }
+
+      if(len < sizeof(xid))
+        {
+          Mem_Free(record);
+          continue;
+        }
+
+      memcpy(&xid, record, sizeof(xid));
+      xid = ntohl(xid);
+
+      P(pconn->lock);
+      pcall = NULL;
+      glist_for_each(glist, &pconn->pending[xid % FSAL_PROXY_RPC_NB_BUCKETS])
+        if(glist_entry(glist, fsal_proxy_rpc_call_t, q)->xid == xid)
+          {
+            pcall = glist_entry(glist, fsal_proxy_rpc_call_t, q);
+            break;
+          }
+
+      if(pcall != NULL)
+        {
+          glist_del(&pcall->q);
+          pcall->reply = record;
+          pcall->reply_len = len;
+          pcall->status = RPC_SUCCESS;
+          pcall->done = TRUE;
+          pthread_cond_signal(&pcall->cond);
+          record = NULL;
+        }
+      V(pconn->lock);
+
+      /* The caller gave up (timeout) */
+      if(record != NULL)
+        {
+          LogDebug(COMPONENT_FSAL, "FSAL RPC: dropping reply for unknown xid %u", xid);
+          Mem_Free(record);
+        }
+    }
+
+  return NULL;
+}                               /* fsal_proxy_rpc_reply_thread */
+
+/**
+ * FSAL_proxy_rpc_init: opens the shared connections to the remote server.
+ *
+ * Does nothing if the multiplexed client is not to be used, or if it is
+ * already initialized.
+ *
+ * \return 0 if successful, -1 if failed.
+ */
+int FSAL_proxy_rpc_init(void)
+{
+  static pthread_mutex_t init_mutex = PTHREAD_MUTEX_INITIALIZER;
+  fsal_proxy_rpc_conn_t *pconns;
+  pthread_attr_t attr_thr;
+  struct timeval now;
+  unsigned int nb;
+  unsigned int i;
+  unsigned int j;
+  int rc;
+
+  if(!FSAL_proxy_rpc_multiplexed())
+    return 0;
+
+  P(init_mutex);
+
+  if(fsal_proxy_rpc_conns != NULL)
+    {
+      V(init_mutex);
+      return 0;
+    }
+
+  nb = global_fsal_proxy_specific_info.nb_rpc_connections;
+
+  if((pconns = (fsal_proxy_rpc_conn_t *) Mem_Alloc(nb * sizeof(fsal_proxy_rpc_conn_t))) == NULL)
+    {
+      V(init_mutex);
+      return -1;
+    }
+
+  if(gethostname(fsal_proxy_rpc_hostname, MAXNAMLEN) == -1)
+    strncpy(fsal_proxy_rpc_hostname, "NFS-GANESHA/Proxy", MAXNAMLEN);
+
+  gettimeofday(&now, NULL);
+  fsal_proxy_rpc_xid = (u_int32_t) (getpid() ^ now.tv_sec ^ now.tv_usec);
+
+  pthread_attr_init(&attr_thr);
+  pthread_attr_setscope(&attr_thr, PTHREAD_SCOPE_SYSTEM);
+  pthread_attr_setdetachstate(&attr_thr, PTHREAD_CREATE_DETACHED);
+
+  for(i = 0; i < nb; i++)
+    {
+      pthread_mutex_init(&pconns[i].lock, NULL);
+      pthread_mutex_init(&pconns[i].send_lock, NULL);
+      pthread_cond_init(&pconns[i].connected_cond, NULL);
+      for(j = 0; j < FSAL_PROXY_RPC_NB_BUCKETS; j++)
+        init_glist(&pconns[i].pending[j]);
+      pconns[i].index = i;
+
+      if((pconns[i].socket = fsal_proxy_rpc_connect()) < 0)
+        {
+          /* The server must be there at startup, as with the per thread clients */
+          while(i-- > 0)
+            close(pconns[i].socket);
+          Mem_Free(pconns);
+          V(init_mutex);
+          return -1;
+        }
+      pconns[i].connected = TRUE;
+    }
+
+  for(i = 0; i < nb; i++)
+    if((rc = pthread_create(&pconns[i].thrid, &attr_thr,
+                            fsal_proxy_rpc_reply_thread, (void *)&pconns[i])) != 0)
+      {
+        LogError(COMPONENT_FSAL, ERR_SYS, ERR_PTHREAD_CREATE, rc);
+        exit(1);
+      }
+
+  fsal_proxy_rpc_nb_conns = nb;
+  fsal_proxy_rpc_conns = pconns;
+
+  V(init_mutex);
+
+  LogEvent(COMPONENT_FSAL,
+           "FSAL RPC: %u multiplexed connections to the remote server are open", nb);
+
+  return 0;
+}                               /* FSAL_proxy_rpc_init */
+
+/**
+ * FSAL_proxy_rpc_multiplexed: tells if the calls go through the shared connections.
+ *
+ * \return TRUE if the multiplexed client is used.
+ */
+int FSAL_proxy_rpc_multiplexed(void)
+{
+  return (global_fsal_proxy_specific_info.nb_rpc_connections > 0 &&
+          !strcmp(global_fsal_proxy_specific_info.srv_proto, "tcp") &&
+          global_fsal_proxy_specific_info.active_krb5 != TRUE);
+}                               /* FSAL_proxy_rpc_multiplexed */
+
+/**
+ * FSAL_proxy_rpc_wait_connected: waits until all the shared connections are up.
+ *
+ * \param seconds (input): how long to wait at most.
+ *
+ * \return 0 if all the connections are up, -1 otherwise.
+ */
+int FSAL_proxy_rpc_wait_connected(unsigned int seconds)
+{
+  struct timespec deadline;
+  unsigned int i;
+  int rc = 0;
+
+  deadline.tv_sec = time(NULL) + seconds;
+  deadline.tv_nsec = 0;
+
+  for(i = 0; i < fsal_proxy_rpc_nb_conns; i++)
+    {
+      P(fsal_proxy_rpc_conns[i].lock);
+      while(!fsal_proxy_rpc_conns[i].connected && rc == 0)
+        if(pthread_cond_timedwait(&fsal_proxy_rpc_conns[i].connected_cond,
+                                  &fsal_proxy_rpc_conns[i].lock, &deadline) == ETIMEDOUT)
+          rc = -1;
+      V(fsal_proxy_rpc_conns[i].lock);
+    }
+
+  return rc;
+}                               /* FSAL_proxy_rpc_wait_connected */
+
+/**
+ * fsal_proxy_rpc_encode: builds the record of a call.
+ *
+ * \return the record length, 0 if it could not be encoded.
+ */
+static u_int fsal_proxy_rpc_encode(proxyfsal_op_context_t * p_context,
+                                   u_int32_t xid,
+                                   rpcproc_t proc,
+                                   xdrproc_t xdr_args, caddr_t args, char **precord)
+{
+  struct rpc_msg call_msg;
+  AUTH *auth;
+  XDR xdrs;
+  u_int32_t proc32 = proc;
+  u_int32_t mark;
+  u_int size = global_fsal_proxy_specific_info.srv_sendsize + FSAL_PROXY_RPC_HEADER_SIZE;
+  u_int len = 0;
+  char *record;
+
+  /* AUTH_UNIX credential of the caller, as FSAL_proxy_change_user does */
+  if((auth = authunix_create(fsal_proxy_rpc_hostname,
+                             p_context->credential.user,
+                             p_context->credential.group,
+                             p_context->credential.nbgroups,
+                             p_context->credential.alt_groups)) == NULL)
+    return 0;
+
+  memset(&call_msg, 0, sizeof(call_msg));
+  call_msg.rm_xid = xid;
+  call_msg.rm_direction = CALL;
+  call_msg.rm_call.cb_rpcvers = RPC_MSG_VERSION;
+  call_msg.rm_call.cb_prog = global_fsal_proxy_specific_info.srv_prognum;
+  call_msg.rm_call.cb_vers = FSAL_PROXY_NFS_V4;
+
+  /* Grow the buffer until the arguments fit in (large WRITEs) */
+  while(size <= FSAL_PROXY_RPC_MAX_RECORD)
+    {
+      if((record = Mem_Alloc(size)) == NULL)
+        break;
+
+      xdrmem_create(&xdrs, record + sizeof(mark), size - sizeof(mark), XDR_ENCODE);
+
+      if(xdr_callhdr(&xdrs, &call_msg) &&
+         xdr_u_int32_t(&xdrs, &proc32) &&
+         AUTH_MARSHALL(auth, &xdrs) && (*xdr_args) (&xdrs, args))
+        {
+          len = XDR_GETPOS(&xdrs);
+          XDR_DESTROY(&xdrs);
+
+          mark = htonl(FSAL_PROXY_RPC_LAST_FRAG | len);
+          memcpy(record, &mark, sizeof(mark));
+
+          *precord = record;
+          len += sizeof(mark);
+          break;
+        }
+
+      XDR_DESTROY(&xdrs);
+      Mem_Free(record);
+      size *= 2;
+    }
+
+  auth_destroy(auth);
+
+  return len;
+}                               /* fsal_proxy_rpc_encode */
+
+/**
+ * fsal_proxy_rpc_decode: decodes the reply of a call.
+ *
+ * \return the status of the call.
+ */
+static enum clnt_stat fsal_proxy_rpc_decode(char *reply, u_int len,
+                                            xdrproc_t xdr_res, caddr_t res)
+{
+  struct rpc_msg reply_msg;
+  XDR xdrs;
+  enum clnt_stat status;
+
+  memset(&reply_msg, 0, sizeof(reply_msg));
+  reply_msg.acpted_rply.ar_verf = _null_auth;
+  reply_msg.acpted_rply.ar_results.where = res;
+  reply_msg.acpted_rply.ar_results.proc = xdr_res;
+
+  xdrmem_create(&xdrs, reply, len, XDR_DECODE);
+
+  if(!xdr_replymsg(&xdrs, &reply_msg))
+    status = RPC_CANTDECODERES;
+  else if(reply_msg.rm_reply.rp_stat != MSG_ACCEPTED)
+    status = (reply_msg.rjcted_rply.rj_stat == AUTH_ERROR) ? RPC_AUTHERROR : RPC_VERSMISMATCH;
+  else
+    switch (reply_msg.acpted_rply.ar_stat)
+      {
+      case SUCCESS:
+        status = RPC_SUCCESS;
+        break;
+      case PROG_UNAVAIL:
+        status = RPC_PROGUNAVAIL;
+        break;
+      case PROG_MISMATCH:
+        status = RPC_PROGVERSMISMATCH;
+        break;
+      case PROC_UNAVAIL:
+        status = RPC_PROCUNAVAIL;
+        break;
+      case GARBAGE_ARGS:
+        status = RPC_CANTDECODEARGS;
+        break;
+      default:
+        status = RPC_SYSTEMERROR;
+        break;
+      }
+
+  /* The verifier may have been allocated by the decoding */
+  if(reply_msg.rm_reply.rp_stat == MSG_ACCEPTED &&
+     reply_msg.acpted_rply.ar_verf.oa_base != NULL)
+    {
+      xdrs.x_op = XDR_FREE;
+      xdr_opaque_auth(&xdrs, &reply_msg.acpted_rply.ar_verf);
+    }
+
+  XDR_DESTROY(&xdrs);
+
+  return status;
+}                               /* fsal_proxy_rpc_decode */
+
+/**
+ * FSAL_proxy_rpc_call: calls a procedure of the remote server.
+ *
+ * With the multiplexed client, the call is sent over one of the shared
+ * connections and the thread waits for its reply only. Otherwise, this is
+ * a clnt_call on the context's own CLIENT.
+ *
+ * \return the status of the call, as clnt_call.
+ */
+enum clnt_stat FSAL_proxy_rpc_call(proxyfsal_op_context_t * p_context,
+                                   rpcproc_t proc,
+                                   xdrproc_t xdr_args, caddr_t args,
+                                   xdrproc_t xdr_res, caddr_t res, struct timeval timeout)
+{
+  fsal_proxy_rpc_conn_t *pconn;
+  fsal_proxy_rpc_call_t call;
+  struct timespec deadline;
+  struct timeval now;
+  char *record = NULL;
+  u_int len;
+  int sock;
+  int sent;
+
+  if(!FSAL_proxy_rpc_multiplexed())
+    return clnt_call(p_context->rpc_client, proc, xdr_args, args, xdr_res, res, timeout);
+
+  if(fsal_proxy_rpc_conns == NULL)
+    return RPC_CANTSEND;
+
+  /* Spread the calls over the connections */
+  pconn = &fsal_proxy_rpc_conns[__sync_fetch_and_add(&fsal_proxy_rpc_next_conn, 1) %
+                                fsal_proxy_rpc_nb_conns];
+
+  memset(&call, 0, sizeof(call));
+  call.xid = __sync_add_and_fetch(&fsal_proxy_rpc_xid, 1);
+  call.status = RPC_TIMEDOUT;
+
+  if((len = fsal_proxy_rpc_encode(p_context, call.xid, proc, xdr_args, args, &record)) == 0)
+    return RPC_CANTENCODEARGS;
+
+  pthread_cond_init(&call.cond, NULL);
+
+  /* Register the call before sending it, the reply may come back at once */
+  P(pconn->lock);
+  if(!pconn->connected)
+    {
+      V(pconn->lock);
+      pthread_cond_destroy(&call.cond);
+      Mem_Free(record);
+      return RPC_CANTSEND;
+    }
+  glist_add_tail(&pconn->pending[call.xid % FSAL_PROXY_RPC_NB_BUCKETS], &call.q);
+  V(pconn->lock);
+
+  P(pconn->send_lock);
+  sock = pconn->socket;
+  sent = (sock >= 0 && fsal_proxy_rpc_writen(sock, record, len) == 0);
+  if(!sent && sock >= 0)
+    {
+      /* Let the reply thread see the connection is broken */
+      shutdown(sock, SHUT_RDWR);
+    }
+  V(pconn->send_lock);
+
+  Mem_Free(record);
+
+  gettimeofday(&now, NULL);
+  deadline.tv_sec = now.tv_sec + timeout.tv_sec +
+      (now.tv_usec + timeout.tv_usec) / 1000000;
+  deadline.tv_nsec = ((now.tv_usec + timeout.tv_usec) % 1000000) * 1000;
+
+  P(pconn->lock);
+  if(!sent && !call.done)
+    {
+      glist_del(&call.q);
+      call.status = RPC_CANTSEND;
+      call.done = TRUE;
+    }
+  while(!call.done)
+    if(pthread_cond_timedwait(&call.cond, &pconn->lock, &deadline) == ETIMEDOUT &&
+       !call.done)
+      {
+        glist_del(&call.q);
+        call.done = TRUE;
+      }
+  V(pconn->lock);
+
+  pthread_cond_destroy(&call.cond);
+
+  if(call.reply == NULL)
+    return call.status;
+
+  call.status = fsal_proxy_rpc_decode(call.reply, call.reply_len, xdr_res, res);
+  Mem_Free(call.reply);
+
+  return call.status;
+}                               /* FSAL_proxy_rpc_call */
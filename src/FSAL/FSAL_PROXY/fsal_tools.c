@@ -518,6 +518,7 @@ fsal_status_t PROXYFSAL_SetDefault_FS_specific_parameter(fsal_parameter_t * out_
   init_info->srv_sendsize = FSAL_PROXY_SEND_BUFFER_SIZE;   /* Default Buffer Send Size    */
   init_info->srv_recvsize = FSAL_PROXY_RECV_BUFFER_SIZE;   /* Default Buffer Send Size    */
   init_info->use_privileged_client_port = FALSE;   /* No privileged port by default */
+  init_info->nb_rpc_connections = FSAL_PROXY_NB_RPC_CONNECTIONS;  /* Shared connections */
 
   init_info->active_krb5 = FALSE;  /* No RPCSEC_GSS by default */
   strncpy(init_info->local_principal, "(no principal set)", MAXNAMLEN);    /* Principal is nfs@<host>  */
@@ -978,6 +979,10 @@ fsal_status_t PROXYFSAL_load_FS_specific_parameter_from_conf(config_file_t in_co
         {
            init_info->use_privileged_client_port = StrToBoolean( key_value ) ;
         }
+      else if(!STRCMP(key_name, "Multiplexed_Connections"))
+        {
+          init_info->nb_rpc_connections = (unsigned int)atoi(key_value);
+        }
       else if(!STRCMP(key_name, "Retry_SleepTime"))
         {
           init_info->retry_sleeptime = (unsigned int)atoi(key_value);
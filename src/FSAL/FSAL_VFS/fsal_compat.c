@@ -31,6 +31,7 @@ fsal_functions_t fsal_vfs_functions = {
   .fsal_mknode = VFSFSAL_mknode,
   .fsal_opendir = VFSFSAL_opendir,
   .fsal_readdir = VFSFSAL_readdir,
+  .fsal_readdir_plus = VFSFSAL_readdir_plus,
   .fsal_closedir = VFSFSAL_closedir,
   .fsal_open_by_name = VFSFSAL_open_by_name,
   .fsal_open = VFSFSAL_open,
@@ -110,257 +110,282 @@ fsal_status_t VFSFSAL_opendir(fsal_handle_t * p_dir_handle,  /* IN */
 
 }
 
-/**
- * FSAL_readdir :
- *     Read the entries of an opened directory.
- *     
- * \param dir_descriptor (input):
- *        Pointer to the directory descriptor filled by FSAL_opendir.
- * \param start_position (input):
- *        Cookie that indicates the first object to be read during
- *        this readdir operation.
- *        This should be :
- *        - FSAL_READDIR_FROM_BEGINNING for reading the content
- *          of the directory from the beginning.
- *        - The end_position parameter returned by the previous
- *          call to FSAL_readdir.
- * \param get_attr_mask (input)
- *        Specify the set of attributes to be retrieved for directory entries.
- * \param buffersize (input)
- *        The size (in bytes) of the buffer where
- *        the direntries are to be stored.
- * \param pdirent (output)
- *        Adresse of the buffer where the direntries are to be stored.
- * \param end_position (output)
- *        Cookie that indicates the current position in the directory.
- * \param nb_entries (output)
- *        Pointer to the number of entries read during the call.
- * \param end_of_dir (output)
- *        Pointer to a boolean that indicates if the end of dir
- *        has been reached during the call.
- * 
- * \return Major error codes :
- *        - ERR_FSAL_NO_ERROR     (no error)
- *        - Another error code if an error occured.
- */
-
-struct linux_dirent
+/* Entry returned by SYS_getdents64, d_off is a 64 bits directory offset
+ * that lseek accepts */
+struct linux_dirent64
 {
-  long d_ino;
-  long d_off;                   /* Be careful, SYS_getdents is a 32 bits call */
+  uint64_t d_ino;
+  int64_t d_off;
   unsigned short d_reclen;
+  unsigned char d_type;
   char d_name[];
 };
 
-#define BUF_SIZE 1024
+/* Size of the getdents64 buffer, a few hundred entries per syscall */
+#define VFS_READDIR_BUFFER_SIZE 32768
 
-fsal_status_t VFSFSAL_readdir(fsal_dir_t * dir_descriptor,      /* IN */
-                              fsal_cookie_t startposition,      /* IN */
-                              fsal_attrib_mask_t get_attr_mask, /* IN */
-                              fsal_mdsize_t buffersize,         /* IN */
-                              fsal_dirent_t * p_pdirent,        /* OUT */
-                              fsal_cookie_t * end_position,     /* OUT */
-                              fsal_count_t * p_nb_entries,      /* OUT */
-                              fsal_boolean_t * p_end_of_dir     /* OUT */
+/**
+ * vfsfsal_readdir_batch :
+ *     Fills up to max_dir_entries dirents with their name, handle and attributes.
+ *     Every entry costs a fstatat and a name_to_handle_at relative to the directory
+ *     descriptor, the directory itself is read with getdents64 into a large buffer.
+ *     Entries removed between getdents64 and fstatat are skipped.
+ *
+ * \return Major error codes :
+ *        - ERR_FSAL_NO_ERROR     (no error)
+ *        - Another error code if an error occured.
+ */
+static fsal_status_t vfsfsal_readdir_batch(vfsfsal_dir_t * p_dir_descriptor,     /* IN */
+                                           fsal_cookie_t * p_start_position,    /* IN */
+                                           fsal_attrib_mask_t get_attr_mask,    /* IN */
+                                           fsal_count_t max_dir_entries,        /* IN */
+                                           fsal_dirent_t * p_pdirent,   /* OUT */
+                                           vfsfsal_cookie_t * p_end_position,   /* OUT */
+                                           fsal_count_t * p_nb_entries, /* OUT */
+                                           fsal_boolean_t * p_end_of_dir        /* OUT */
     )
 {
-  vfsfsal_dir_t * p_dir_descriptor = (vfsfsal_dir_t * ) dir_descriptor;
   vfsfsal_cookie_t start_position;
-  vfsfsal_cookie_t * p_end_position = (vfsfsal_cookie_t *) end_position;
+  fsal_dirent_t *p_entry;
+  struct linux_dirent64 *dp = NULL;
+  struct stat buffstat;
   fsal_status_t st;
-  fsal_count_t max_dir_entries;
-  fsal_name_t entry_name;
-  char buff[BUF_SIZE];
-  struct linux_dirent *dp = NULL;
+  char *buff;
   int bpos = 0;
-  int tmpfd = 0;
-
-  char d_type;
-  struct stat buffstat;
-
-  int errsv, rc = 0;
-
-  memset(buff, 0, BUF_SIZE);
-  memset(&entry_name, 0, sizeof(fsal_name_t));
-
-  /*****************/
-  /* sanity checks */
-  /*****************/
+  int errsv = 0;
+  int rc = 0;
 
-  if(!p_dir_descriptor || !p_pdirent || !p_end_position || !p_nb_entries || !p_end_of_dir)
-    Return(ERR_FSAL_FAULT, 0, INDEX_FSAL_readdir);
+  *p_nb_entries = 0;
+  *p_end_of_dir = FALSE;
 
-  max_dir_entries = (buffersize / sizeof(fsal_dirent_t));
+  /*****************************************************/
+  /* seek into the directory                           */
+  /* The cookie of an entry is the offset of the next  */
+  /* one, so a batch that stopped in the middle of the */
+  /* getdents64 buffer resumes exactly where it ended  */
+  /*****************************************************/
+  memcpy(&start_position, p_start_position, sizeof(vfsfsal_cookie_t));
 
-  /***************************/
-  /* seek into the directory */
-  /***************************/
-  start_position.data.cookie = (off_t) startposition.data;
-  errno = 0;
-  if(start_position.data.cookie == 0)
-    {
-      //rewinddir(p_dir_descriptor->p_dir);
-      rc = errno;
-    }
-  else
-    {
-      //seekdir(p_dir_descriptor->p_dir, start_position.cookie);
-      rc = errno;
-    }
+  if(lseek(p_dir_descriptor->fd, start_position.data.cookie, SEEK_SET) == (off_t) - 1)
+    ReturnCode(posix2fsal_error(errno), errno);
 
-  if(rc)
-    Return(posix2fsal_error(rc), rc, INDEX_FSAL_readdir);
+  if((buff = (char *)Mem_Alloc_Label(VFS_READDIR_BUFFER_SIZE, "vfs_readdir")) == NULL)
+    ReturnCode(ERR_FSAL_NOMEM, ENOMEM);
 
   /************************/
   /* browse the directory */
   /************************/
 
-  *p_nb_entries = 0;
   while(*p_nb_entries < max_dir_entries)
     {
-    /***********************/
-      /* read the next entry */
-    /***********************/
+      /* One token for a whole getdents64 buffer and the calls made for its entries */
       TakeTokenFSCall();
-      rc = syscall(SYS_getdents, p_dir_descriptor->fd, buff, BUF_SIZE);
-      ReleaseTokenFSCall();
+
+      rc = syscall(SYS_getdents64, p_dir_descriptor->fd, buff, VFS_READDIR_BUFFER_SIZE);
       if(rc < 0)
         {
-          rc = errno;
-          Return(posix2fsal_error(rc), rc, INDEX_FSAL_readdir);
+          errsv = errno;
+          ReleaseTokenFSCall();
+          Mem_Free(buff);
+          ReturnCode(posix2fsal_error(errsv), errsv);
         }
+
       /* End of directory */
       if(rc == 0)
         {
-          *p_end_of_dir = 1;
+          ReleaseTokenFSCall();
+          *p_end_of_dir = TRUE;
           break;
         }
 
-    /***********************************/
-      /* Get information about the entry */
-    /***********************************/
-
-      for(bpos = 0; bpos < rc;)
+      for(bpos = 0; bpos < rc && *p_nb_entries < max_dir_entries; bpos += dp->d_reclen)
         {
-          dp = (struct linux_dirent *)(buff + bpos);
-          d_type = *(buff + bpos + dp->d_reclen - 1);
-                                                    /** @todo not used for the moment. Waiting for information on symlink management */
-          bpos += dp->d_reclen;
-
-          /* LogFullDebug(COMPONENT_FSAL,
-                          "\tino=%8ld|%8lx off=%d|%x reclen=%d|%x name=%s|%d",
-                          dp->d_ino, dp->d_ino, (int)dp->d_off, (int)dp->d_off, 
-                          dp->d_reclen, dp->d_reclen, dp->d_name, (int)dp->d_name[0]  ) ; */
+          dp = (struct linux_dirent64 *)(buff + bpos);
 
-          if(!(*p_nb_entries < max_dir_entries))
-            break;
+          /* The entry is consumed, whatever is done with it below */
+          start_position.data.cookie = dp->d_off;
 
           /* skip . and .. */
           if(!strcmp(dp->d_name, ".") || !strcmp(dp->d_name, ".."))
             continue;
 
-          /* build the full path of the file into "fsalpath */
-          if(FSAL_IS_ERROR
-             (st =
-              FSAL_str2name(dp->d_name, FSAL_MAX_NAME_LEN,
-                            &(p_pdirent[*p_nb_entries].name))))
-            ReturnStatus(st, INDEX_FSAL_readdir);
+          if(fstatat(p_dir_descriptor->fd, dp->d_name, &buffstat, AT_SYMLINK_NOFOLLOW) < 0)
+            {
+              errsv = errno;
 
-          d_type = DT_UNKNOWN;
+              /* Removed since getdents64 listed it */
+              if(errsv == ENOENT)
+                continue;
 
-          // TODO: there is a race here, because between handle fetch
-          // and open at things might change.  we need to figure out if there
-          // is another way to open without the pcontext
+              ReleaseTokenFSCall();
+              Mem_Free(buff);
+              ReturnCode(posix2fsal_error(errsv), errsv);
+            }
 
-          strncpy(entry_name.name, dp->d_name, sizeof(entry_name.name));
-          entry_name.len = strlen(entry_name.name);
+          p_entry = &p_pdirent[*p_nb_entries];
 
-         if((tmpfd =
-              openat(p_dir_descriptor->fd, dp->d_name, O_RDONLY | O_NOFOLLOW, 0600)) < 0)
+          if(FSAL_IS_ERROR(st = FSAL_str2name(dp->d_name, FSAL_MAX_NAME_LEN,
+                                              &p_entry->name)))
             {
-              errsv = errno;
-              if(errsv != ELOOP)        /* ( p_dir_descriptor->fd, dp->d_name) is not a symlink */
-                Return(posix2fsal_error(errsv), errsv, INDEX_FSAL_readdir);
-              else
-                d_type = DT_LNK;
+              ReleaseTokenFSCall();
+              Mem_Free(buff);
+              return st;
             }
 
-          /* get object handle */
-          TakeTokenFSCall();
-          if(d_type != DT_LNK)
-            {
-              st = fsal_internal_fd2handle((fsal_op_context_t *)&(p_dir_descriptor->context),
-					   tmpfd, &(p_pdirent[*p_nb_entries].handle));
-              close(tmpfd);
-            }
-          else
+          /* name_to_handle_at does not follow symlinks without AT_SYMLINK_FOLLOW */
+          st = fsal_internal_get_handle_at(p_dir_descriptor->fd, dp->d_name,
+                                           &p_entry->handle);
+          if(FSAL_IS_ERROR(st))
             {
-              if(fstatat(p_dir_descriptor->fd, dp->d_name, &buffstat, AT_SYMLINK_NOFOLLOW)
-                 < 0)
-                {
-                  ReleaseTokenFSCall();
-                  Return(posix2fsal_error(errno), errno, INDEX_FSAL_readdir);
-                }
-
-              st = fsal_internal_get_handle_at( p_dir_descriptor->fd, dp->d_name,
-						&p_pdirent[*p_nb_entries].handle) ;
-              if(FSAL_IS_ERROR(st))
-                {
-                  ReleaseTokenFSCall();
-                  ReturnStatus(st, INDEX_FSAL_readdir);
-                }
-              p_pdirent[*p_nb_entries].attributes.asked_attributes = get_attr_mask;
-
-              st = posix2fsal_attributes(&buffstat, &p_pdirent[*p_nb_entries].attributes);
-              if(FSAL_IS_ERROR(st))
-                {
-                  ReleaseTokenFSCall();
-                  FSAL_CLEAR_MASK(p_pdirent[*p_nb_entries].attributes.asked_attributes);
-                  FSAL_SET_MASK(p_pdirent[*p_nb_entries].attributes.asked_attributes,
-                                FSAL_ATTR_RDATTR_ERR);
-                  ReturnStatus(st, INDEX_FSAL_getattrs);
-                }
+              if(st.major == ERR_FSAL_NOENT)
+                continue;
 
+              ReleaseTokenFSCall();
+              Mem_Free(buff);
+              return st;
             }
-          ReleaseTokenFSCall();
 
-          if(FSAL_IS_ERROR(st))
-            ReturnStatus(st, INDEX_FSAL_readdir);
+          /************************
+           * Fills the attributes *
+           ************************/
+          p_entry->attributes.asked_attributes = get_attr_mask;
 
-    /************************
-     * Fills the attributes *
-     ************************/
-          if(d_type != DT_LNK)
+          st = posix2fsal_attributes(&buffstat, &p_entry->attributes);
+          if(FSAL_IS_ERROR(st))
             {
-              p_pdirent[*p_nb_entries].attributes.asked_attributes = get_attr_mask;
-
-              st = VFSFSAL_getattrs(&p_pdirent[*p_nb_entries].handle,
-                                    (fsal_op_context_t *) & p_dir_descriptor->context,
-                                    &p_pdirent[*p_nb_entries].attributes);
-              if(FSAL_IS_ERROR(st))
-                {
-                  FSAL_CLEAR_MASK(p_pdirent[*p_nb_entries].attributes.asked_attributes);
-                  FSAL_SET_MASK(p_pdirent[*p_nb_entries].attributes.asked_attributes,
-                                FSAL_ATTR_RDATTR_ERR);
-                }
+              FSAL_CLEAR_MASK(p_entry->attributes.asked_attributes);
+              FSAL_SET_MASK(p_entry->attributes.asked_attributes, FSAL_ATTR_RDATTR_ERR);
             }
-          //p_pdirent[*p_nb_entries].cookie.cookie = dp->d_off;
-          ((vfsfsal_cookie_t *) (&p_pdirent[*p_nb_entries].cookie))->data.cookie = dp->d_off;
-          p_pdirent[*p_nb_entries].nextentry = NULL;
-          if(*p_nb_entries)
-            p_pdirent[*p_nb_entries - 1].nextentry = &(p_pdirent[*p_nb_entries]);
 
-          //(*p_end_position) = p_pdirent[*p_nb_entries].cookie;
-          memcpy((char *)p_end_position, (char *)&p_pdirent[*p_nb_entries].cookie,
-                 sizeof(vfsfsal_cookie_t));
+          memcpy(&p_entry->cookie, &start_position, sizeof(vfsfsal_cookie_t));
+          p_entry->nextentry = NULL;
+          if(*p_nb_entries)
+            p_pdirent[*p_nb_entries - 1].nextentry = p_entry;
 
           (*p_nb_entries)++;
-
         }                       /* for */
+
+      ReleaseTokenFSCall();
     }                           /* While */
 
-  Return(ERR_FSAL_NO_ERROR, 0, INDEX_FSAL_readdir);
+  Mem_Free(buff);
+
+  memcpy(p_end_position, &start_position, sizeof(vfsfsal_cookie_t));
+
+  ReturnCode(ERR_FSAL_NO_ERROR, 0);
+}                               /* vfsfsal_readdir_batch */
+
+/**
+ * FSAL_readdir :
+ *     Read the entries of an opened directory.
+ *     
+ * \param dir_descriptor (input):
+ *        Pointer to the directory descriptor filled by FSAL_opendir.
+ * \param start_position (input):
+ *        Cookie that indicates the first object to be read during
+ *        this readdir operation.
+ *        This should be :
+ *        - FSAL_READDIR_FROM_BEGINNING for reading the content
+ *          of the directory from the beginning.
+ *        - The end_position parameter returned by the previous
+ *          call to FSAL_readdir.
+ * \param get_attr_mask (input)
+ *        Specify the set of attributes to be retrieved for directory entries.
+ * \param buffersize (input)
+ *        The size (in bytes) of the buffer where
+ *        the direntries are to be stored.
+ * \param pdirent (output)
+ *        Adresse of the buffer where the direntries are to be stored.
+ * \param end_position (output)
+ *        Cookie that indicates the current position in the directory.
+ * \param nb_entries (output)
+ *        Pointer to the number of entries read during the call.
+ * \param end_of_dir (output)
+ *        Pointer to a boolean that indicates if the end of dir
+ *        has been reached during the call.
+ * 
+ * \return Major error codes :
+ *        - ERR_FSAL_NO_ERROR     (no error)
+ *        - Another error code if an error occured.
+ */
+fsal_status_t VFSFSAL_readdir(fsal_dir_t * dir_descriptor,      /* IN */
+                              fsal_cookie_t startposition,      /* IN */
+                              fsal_attrib_mask_t get_attr_mask, /* IN */
+                              fsal_mdsize_t buffersize,         /* IN */
+                              fsal_dirent_t * p_pdirent,        /* OUT */
+                              fsal_cookie_t * end_position,     /* OUT */
+                              fsal_count_t * p_nb_entries,      /* OUT */
+                              fsal_boolean_t * p_end_of_dir     /* OUT */
+    )
+{
+  fsal_status_t st;
+
+  /*****************/
+  /* sanity checks */
+  /*****************/
+
+  if(!dir_descriptor || !p_pdirent || !end_position || !p_nb_entries || !p_end_of_dir)
+    Return(ERR_FSAL_FAULT, 0, INDEX_FSAL_readdir);
+
+  st = vfsfsal_readdir_batch((vfsfsal_dir_t *) dir_descriptor, &startposition,
+                             get_attr_mask, buffersize / sizeof(fsal_dirent_t),
+                             p_pdirent, (vfsfsal_cookie_t *) end_position,
+                             p_nb_entries, p_end_of_dir);
+
+  ReturnStatus(st, INDEX_FSAL_readdir);
+}
+
+/**
+ * FSAL_readdir_plus :
+ *     Read a batch of entries of an opened directory, with their handle and
+ *     their attributes.
+ *
+ * \param dir_descriptor (input):
+ *        Pointer to the directory descriptor filled by FSAL_opendir.
+ * \param start_position (input):
+ *        Cookie that indicates the first object to be read, as for FSAL_readdir.
+ * \param get_attr_mask (input)
+ *        Specify the set of attributes to be retrieved for directory entries.
+ * \param nb_max (input)
+ *        The number of dirents available in pdirent.
+ * \param pdirent (output)
+ *        Adresse of the array where the direntries are to be stored.
+ * \param end_position (output)
+ *        Cookie that indicates the current position in the directory.
+ * \param nb_entries (output)
+ *        Pointer to the number of entries read during the call.
+ * \param end_of_dir (output)
+ *        Pointer to a boolean that indicates if the end of dir
+ *        has been reached during the call.
+ *
+ * \return Major error codes :
+ *        - ERR_FSAL_NO_ERROR     (no error)
+ *        - Another error code if an error occured.
+ */
+fsal_status_t VFSFSAL_readdir_plus(fsal_dir_t * dir_descriptor, /* IN */
+                                   fsal_cookie_t startposition, /* IN */
+                                   fsal_attrib_mask_t get_attr_mask,    /* IN */
+                                   fsal_count_t nb_max, /* IN */
+                                   fsal_dirent_t * p_pdirent,   /* OUT */
+                                   fsal_cookie_t * end_position,        /* OUT */
+                                   fsal_count_t * p_nb_entries, /* OUT */
+                                   fsal_boolean_t * p_end_of_dir        /* OUT */
+    )
+{
+  fsal_status_t st;
+
+  /*****************/
+  /* sanity checks */
+  /*****************/
+
+  if(!dir_descriptor || !p_pdirent || !end_position || !p_nb_entries || !p_end_of_dir)
+    Return(ERR_FSAL_FAULT, 0, INDEX_FSAL_readdir_plus);
+
+  st = vfsfsal_readdir_batch((vfsfsal_dir_t *) dir_descriptor, &startposition,
+                             get_attr_mask, nb_max, p_pdirent,
+                             (vfsfsal_cookie_t *) end_position, p_nb_entries, p_end_of_dir);
 
+  ReturnStatus(st, INDEX_FSAL_readdir_plus);
 }
 
 /**
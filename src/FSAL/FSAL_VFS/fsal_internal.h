@@ -203,6 +203,15 @@ fsal_status_t VFSFSAL_readdir(fsal_dir_t * p_dir_descriptor, /* IN */
                               fsal_count_t * p_nb_entries,      /* OUT */
                               fsal_boolean_t * p_end_of_dir /* OUT */ );
 
+fsal_status_t VFSFSAL_readdir_plus(fsal_dir_t * p_dir_descriptor,    /* IN */
+                                   fsal_cookie_t start_position,       /* IN */
+                                   fsal_attrib_mask_t get_attr_mask,   /* IN */
+                                   fsal_count_t nb_max, /* IN */
+                                   fsal_dirent_t * p_pdirent,  /* OUT */
+                                   fsal_cookie_t * p_end_position,     /* OUT */
+                                   fsal_count_t * p_nb_entries,        /* OUT */
+                                   fsal_boolean_t * p_end_of_dir /* OUT */ );
+
 fsal_status_t VFSFSAL_closedir(fsal_dir_t * p_dir_descriptor /* IN */ );
 
 fsal_status_t VFSFSAL_open_by_name(fsal_handle_t * dirhandle,        /* IN */
@@ -16,6 +16,7 @@
 #include <dlfcn.h>              /* For dlopen */
 #endif
 
+#include <stdio.h>
 #include <string.h> /* For strncpy */
 
 #define fsal_increment_nbcall( _f_,_struct_status_ )
@@ -23,6 +24,8 @@
 #include "fsal.h"
 #include "fsal_glue.h"
 #include "fsal_up.h"
+#include "nfs_stat_registry.h"
+#include "fsal_admission.h"
 
 int __thread my_fsalid = -1 ;
 
@@ -37,6 +40,95 @@ fsal_const_t fsal_consts_array[NB_AVAILABLE_FSAL];
 #define fsal_consts fsal_consts_array[0]
 #endif
 
+/* Latency histogram of each FSAL function, all the FSALs together */
+static int fsal_stat_histograms[FSAL_NB_FUNC];
+static int fsal_stat_registered = FALSE;
+
+/**
+ * FSAL_register_stats :
+ *     Registers the latency histograms of the FSAL functions, named like
+ *     "fsal.FSAL_read". Calls made before are not measured.
+ */
+void FSAL_register_stats(void)
+{
+  char name[NFS_STAT_NAME_LEN];
+  unsigned int i;
+
+  for(i = 0; i < FSAL_NB_FUNC; i++)
+    {
+      if(strstr(fsal_function_names[i], "unused") != NULL)
+        {
+          fsal_stat_histograms[i] = -1;
+          continue;
+        }
+
+      snprintf(name, NFS_STAT_NAME_LEN, "fsal.%s", fsal_function_names[i]);
+      fsal_stat_histograms[i] = nfs_stat_register_histogram(name);
+    }
+
+  fsal_stat_registered = TRUE;
+}
+
+static inline uint64_t fsal_stat_start(void)
+{
+  return fsal_stat_registered ? nfs_stat_now() : 0;
+}
+
+static inline void fsal_stat_end(int index, uint64_t start)
+{
+  if(start != 0)
+    nfs_stat_histogram_record(fsal_stat_histograms[index], nfs_stat_now() - start);
+}
+
+/* The next call of this thread fails with ERR_FSAL_DELAY rather than wait
+ * when its export has too many calls waiting already */
+static __thread int fsal_admit_may_refuse = FALSE;
+
+/* Export of the last call of this thread that had a context: the calls on a
+ * file or directory descriptor are made for the same request */
+static __thread void *fsal_admit_last_key = NULL;
+
+/**
+ * FSAL_SetCongestionDelay :
+ *     Makes the next call of the current thread fail with ERR_FSAL_DELAY
+ *     instead of waiting if its export is congested. Workers set it before
+ *     each NFSv3 request, so that a slow export cannot hold all of them, and
+ *     so that only a request that has changed nothing yet is refused.
+ */
+void FSAL_SetCongestionDelay(fsal_boolean_t delay)
+{
+  fsal_admit_may_refuse = delay;
+}
+
+static inline int fsal_admit_start(fsal_admit_ticket_t * pticket,
+                                   fsal_op_context_t * p_context,
+                                   fsal_admit_class_t class)
+{
+  if(p_context != NULL)
+    fsal_admit_last_key = p_context->export_context;
+
+  if(fsal_admit_enter(pticket, fsal_admit_last_key, class,
+                      fsal_admit_may_refuse) != FSAL_ADMIT_SUCCESS)
+    return FALSE;
+
+  fsal_admit_may_refuse = FALSE;
+  return TRUE;
+}
+
+static inline void fsal_admit_done(fsal_admit_ticket_t * pticket, fsal_status_t status)
+{
+  fsal_admit_exit(pticket, status.major == ERR_FSAL_DELAY);
+}
+
+static inline fsal_status_t fsal_admit_refused(void)
+{
+  fsal_status_t status;
+
+  status.major = ERR_FSAL_DELAY;
+  status.minor = 0;
+  return status;
+}
+
 
 int FSAL_name2fsalid( char * fsname )
 {
@@ -169,15 +261,39 @@ fsal_status_t FSAL_access(fsal_handle_t * object_handle,        /* IN */
                           fsal_accessflags_t access_type,       /* IN */
                           fsal_attrib_list_t * object_attributes /* [ IN/OUT ] */ )
 {
-  return fsal_functions.fsal_access(object_handle, p_context, access_type,
-                                    object_attributes);
+  fsal_status_t status;
+  fsal_admit_ticket_t ticket;
+  uint64_t start;
+
+  if(!fsal_admit_start(&ticket, p_context, FSAL_ADMIT_METADATA))
+    return fsal_admit_refused();
+  start = fsal_stat_start();
+
+  status = fsal_functions.fsal_access(object_handle, p_context, access_type,
+                                      object_attributes);
+
+  fsal_stat_end(INDEX_FSAL_access, start);
+  fsal_admit_done(&ticket, status);
+  return status;
 }
 
 fsal_status_t FSAL_getattrs(fsal_handle_t * p_filehandle,       /* IN */
                             fsal_op_context_t * p_context,      /* IN */
                             fsal_attrib_list_t * p_object_attributes /* IN/OUT */ )
 {
-  return fsal_functions.fsal_getattrs(p_filehandle, p_context, p_object_attributes);
+  fsal_status_t status;
+  fsal_admit_ticket_t ticket;
+  uint64_t start;
+
+  if(!fsal_admit_start(&ticket, p_context, FSAL_ADMIT_METADATA))
+    return fsal_admit_refused();
+  start = fsal_stat_start();
+
+  status = fsal_functions.fsal_getattrs(p_filehandle, p_context, p_object_attributes);
+
+  fsal_stat_end(INDEX_FSAL_getattrs, start);
+  fsal_admit_done(&ticket, status);
+  return status;
 }
 
 fsal_status_t FSAL_getattrs_descriptor(fsal_file_t * p_file_descriptor,         /* IN */
@@ -185,18 +301,30 @@ fsal_status_t FSAL_getattrs_descriptor(fsal_file_t * p_file_descriptor,
                                        fsal_op_context_t * p_context,           /* IN */
                                        fsal_attrib_list_t * p_object_attributes /* IN/OUT */ )
 {
+  fsal_status_t status;
+  fsal_admit_ticket_t ticket;
+  uint64_t start;
+
+  if(!fsal_admit_start(&ticket, p_context, FSAL_ADMIT_METADATA))
+    return fsal_admit_refused();
+  start = fsal_stat_start();
+
    if(fsal_functions.fsal_getattrs_descriptor != NULL && p_file_descriptor != NULL)
     {
       LogFullDebug(COMPONENT_FSAL,
                    "FSAL_getattrs_descriptor calling fsal_getattrs_descriptor");
-      return fsal_functions.fsal_getattrs_descriptor(p_file_descriptor, p_filehandle, p_context, p_object_attributes);
+      status = fsal_functions.fsal_getattrs_descriptor(p_file_descriptor, p_filehandle, p_context, p_object_attributes);
     }
   else
     {
       LogFullDebug(COMPONENT_FSAL,
                    "FSAL_getattrs_descriptor calling fsal_getattrs");
-      return fsal_functions.fsal_getattrs(p_filehandle, p_context, p_object_attributes);
+      status = fsal_functions.fsal_getattrs(p_filehandle, p_context, p_object_attributes);
     }
+
+  fsal_stat_end(INDEX_FSAL_getattrs_descriptor, start);
+  fsal_admit_done(&ticket, status);
+  return status;
 }
 
 fsal_status_t FSAL_setattrs(fsal_handle_t * p_filehandle,       /* IN */
@@ -204,8 +332,20 @@ fsal_status_t FSAL_setattrs(fsal_handle_t * p_filehandle,       /* IN */
                             fsal_attrib_list_t * p_attrib_set,  /* IN */
                             fsal_attrib_list_t * p_object_attributes /* [ IN/OUT ] */ )
 {
-  return fsal_functions.fsal_setattrs(p_filehandle, p_context, p_attrib_set,
-                                      p_object_attributes);
+  fsal_status_t status;
+  fsal_admit_ticket_t ticket;
+  uint64_t start;
+
+  if(!fsal_admit_start(&ticket, p_context, FSAL_ADMIT_METADATA))
+    return fsal_admit_refused();
+  start = fsal_stat_start();
+
+  status = fsal_functions.fsal_setattrs(p_filehandle, p_context, p_attrib_set,
+                                        p_object_attributes);
+
+  fsal_stat_end(INDEX_FSAL_setattrs, start);
+  fsal_admit_done(&ticket, status);
+  return status;
 }
 
 fsal_status_t FSAL_BuildExportContext(fsal_export_context_t * p_export_context, /* OUT */
@@ -218,6 +358,11 @@ fsal_status_t FSAL_BuildExportContext(fsal_export_context_t * p_export_context,
 
 fsal_status_t FSAL_CleanUpExportContext(fsal_export_context_t * p_export_context) /* IN */
 {
+  /* The admission windows of the export go with it */
+  fsal_admit_release(p_export_context);
+  if(fsal_admit_last_key == p_export_context)
+    fsal_admit_last_key = NULL;
+
   return fsal_functions.fsal_cleanupexportcontext(p_export_context);
 }
 
@@ -246,8 +391,20 @@ fsal_status_t FSAL_create(fsal_handle_t * p_parent_directory_handle,    /* IN */
                           fsal_handle_t * p_object_handle,      /* OUT */
                           fsal_attrib_list_t * p_object_attributes /* [ IN/OUT ] */ )
 {
-  return fsal_functions.fsal_create(p_parent_directory_handle, p_filename, p_context,
-                                    accessmode, p_object_handle, p_object_attributes);
+  fsal_status_t status;
+  fsal_admit_ticket_t ticket;
+  uint64_t start;
+
+  if(!fsal_admit_start(&ticket, p_context, FSAL_ADMIT_METADATA))
+    return fsal_admit_refused();
+  start = fsal_stat_start();
+
+  status = fsal_functions.fsal_create(p_parent_directory_handle, p_filename, p_context,
+                                      accessmode, p_object_handle, p_object_attributes);
+
+  fsal_stat_end(INDEX_FSAL_create, start);
+  fsal_admit_done(&ticket, status);
+  return status;
 }
 
 fsal_status_t FSAL_mkdir(fsal_handle_t * p_parent_directory_handle,     /* IN */
@@ -257,8 +414,20 @@ fsal_status_t FSAL_mkdir(fsal_handle_t * p_parent_directory_handle,     /* IN */
                          fsal_handle_t * p_object_handle,       /* OUT */
                          fsal_attrib_list_t * p_object_attributes /* [ IN/OUT ] */ )
 {
-  return fsal_functions.fsal_mkdir(p_parent_directory_handle, p_dirname, p_context,
-                                   accessmode, p_object_handle, p_object_attributes);
+  fsal_status_t status;
+  fsal_admit_ticket_t ticket;
+  uint64_t start;
+
+  if(!fsal_admit_start(&ticket, p_context, FSAL_ADMIT_METADATA))
+    return fsal_admit_refused();
+  start = fsal_stat_start();
+
+  status = fsal_functions.fsal_mkdir(p_parent_directory_handle, p_dirname, p_context,
+                                     accessmode, p_object_handle, p_object_attributes);
+
+  fsal_stat_end(INDEX_FSAL_mkdir, start);
+  fsal_admit_done(&ticket, status);
+  return status;
 }
 
 fsal_status_t FSAL_link(fsal_handle_t * p_target_handle,        /* IN */
@@ -267,8 +436,20 @@ fsal_status_t FSAL_link(fsal_handle_t * p_target_handle,        /* IN */
                         fsal_op_context_t * p_context,  /* IN */
                         fsal_attrib_list_t * p_attributes /* [ IN/OUT ] */ )
 {
-  return fsal_functions.fsal_link(p_target_handle, p_dir_handle, p_link_name, p_context,
-                                  p_attributes);
+  fsal_status_t status;
+  fsal_admit_ticket_t ticket;
+  uint64_t start;
+
+  if(!fsal_admit_start(&ticket, p_context, FSAL_ADMIT_METADATA))
+    return fsal_admit_refused();
+  start = fsal_stat_start();
+
+  status = fsal_functions.fsal_link(p_target_handle, p_dir_handle, p_link_name, p_context,
+                                    p_attributes);
+
+  fsal_stat_end(INDEX_FSAL_link, start);
+  fsal_admit_done(&ticket, status);
+  return status;
 }
 
 fsal_status_t FSAL_mknode(fsal_handle_t * parentdir_handle,     /* IN */
@@ -280,8 +461,20 @@ fsal_status_t FSAL_mknode(fsal_handle_t * parentdir_handle,     /* IN */
                           fsal_handle_t * p_object_handle,      /* OUT (handle to the created node) */
                           fsal_attrib_list_t * node_attributes /* [ IN/OUT ] */ )
 {
-  return fsal_functions.fsal_mknode(parentdir_handle, p_node_name, p_context, accessmode,
-                                    nodetype, dev, p_object_handle, node_attributes);
+  fsal_status_t status;
+  fsal_admit_ticket_t ticket;
+  uint64_t start;
+
+  if(!fsal_admit_start(&ticket, p_context, FSAL_ADMIT_METADATA))
+    return fsal_admit_refused();
+  start = fsal_stat_start();
+
+  status = fsal_functions.fsal_mknode(parentdir_handle, p_node_name, p_context, accessmode,
+                                      nodetype, dev, p_object_handle, node_attributes);
+
+  fsal_stat_end(INDEX_FSAL_mknode, start);
+  fsal_admit_done(&ticket, status);
+  return status;
 }
 
 fsal_status_t FSAL_opendir(fsal_handle_t * p_dir_handle,        /* IN */
@@ -289,8 +482,20 @@ fsal_status_t FSAL_opendir(fsal_handle_t * p_dir_handle,        /* IN */
                            fsal_dir_t * p_dir_descriptor,       /* OUT */
                            fsal_attrib_list_t * p_dir_attributes /* [ IN/OUT ] */ )
 {
-  return fsal_functions.fsal_opendir(p_dir_handle, p_context, p_dir_descriptor,
-                                     p_dir_attributes);
+  fsal_status_t status;
+  fsal_admit_ticket_t ticket;
+  uint64_t start;
+
+  if(!fsal_admit_start(&ticket, p_context, FSAL_ADMIT_METADATA))
+    return fsal_admit_refused();
+  start = fsal_stat_start();
+
+  status = fsal_functions.fsal_opendir(p_dir_handle, p_context, p_dir_descriptor,
+                                       p_dir_attributes);
+
+  fsal_stat_end(INDEX_FSAL_opendir, start);
+  fsal_admit_done(&ticket, status);
+  return status;
 }
 
 fsal_status_t FSAL_readdir(fsal_dir_t * p_dir_descriptor,       /* IN */
@@ -302,14 +507,70 @@ fsal_status_t FSAL_readdir(fsal_dir_t * p_dir_descriptor,       /* IN */
                            fsal_count_t * p_nb_entries, /* OUT */
                            fsal_boolean_t * p_end_of_dir /* OUT */ )
 {
-  return fsal_functions.fsal_readdir(p_dir_descriptor, start_position, get_attr_mask,
-                                     buffersize, p_pdirent, p_end_position, p_nb_entries,
-                                     p_end_of_dir);
+  fsal_status_t status;
+  fsal_admit_ticket_t ticket;
+  uint64_t start;
+
+  if(!fsal_admit_start(&ticket, NULL, FSAL_ADMIT_METADATA))
+    return fsal_admit_refused();
+  start = fsal_stat_start();
+
+  status = fsal_functions.fsal_readdir(p_dir_descriptor, start_position, get_attr_mask,
+                                       buffersize, p_pdirent, p_end_position, p_nb_entries,
+                                       p_end_of_dir);
+
+  fsal_stat_end(INDEX_FSAL_readdir, start);
+  fsal_admit_done(&ticket, status);
+  return status;
+}
+
+/**
+ * FSAL_readdir_plus :
+ *     Reads up to nb_max entries of an opened directory, each with its
+ *     handle and its attributes, in a single call. Entries whose attributes
+ *     could not be read have FSAL_ATTR_RDATTR_ERR set. FSALs without a batch
+ *     implementation are served by their FSAL_readdir.
+ */
+fsal_status_t FSAL_readdir_plus(fsal_dir_t * p_dir_descriptor,  /* IN */
+                                fsal_cookie_t start_position,   /* IN */
+                                fsal_attrib_mask_t get_attr_mask,       /* IN */
+                                fsal_count_t nb_max,    /* IN */
+                                fsal_dirent_t * p_pdirent,      /* OUT */
+                                fsal_cookie_t * p_end_position, /* OUT */
+                                fsal_count_t * p_nb_entries,    /* OUT */
+                                fsal_boolean_t * p_end_of_dir /* OUT */ )
+{
+  fsal_status_t status;
+  fsal_admit_ticket_t ticket;
+  uint64_t start;
+
+  if(!fsal_admit_start(&ticket, NULL, FSAL_ADMIT_METADATA))
+    return fsal_admit_refused();
+  start = fsal_stat_start();
+
+  if(fsal_functions.fsal_readdir_plus == NULL)
+    status = fsal_functions.fsal_readdir(p_dir_descriptor, start_position, get_attr_mask,
+                                         nb_max * sizeof(fsal_dirent_t), p_pdirent,
+                                         p_end_position, p_nb_entries, p_end_of_dir);
+  else
+    status = fsal_functions.fsal_readdir_plus(p_dir_descriptor, start_position, get_attr_mask,
+                                              nb_max, p_pdirent, p_end_position, p_nb_entries,
+                                              p_end_of_dir);
+
+  fsal_stat_end(INDEX_FSAL_readdir_plus, start);
+  fsal_admit_done(&ticket, status);
+  return status;
 }
 
 fsal_status_t FSAL_closedir(fsal_dir_t * p_dir_descriptor /* IN */ )
 {
-  return fsal_functions.fsal_closedir(p_dir_descriptor);
+  fsal_status_t status;
+  uint64_t start = fsal_stat_start();
+
+  status = fsal_functions.fsal_closedir(p_dir_descriptor);
+
+  fsal_stat_end(INDEX_FSAL_closedir, start);
+  return status;
 }
 
 fsal_status_t FSAL_open_by_name(fsal_handle_t * dirhandle,      /* IN */
@@ -319,8 +580,20 @@ fsal_status_t FSAL_open_by_name(fsal_handle_t * dirhandle,      /* IN */
                                 fsal_file_t * file_descriptor,  /* OUT */
                                 fsal_attrib_list_t * file_attributes /* [ IN/OUT ] */ )
 {
-  return fsal_functions.fsal_open_by_name(dirhandle, filename, p_context, openflags,
-                                          file_descriptor, file_attributes);
+  fsal_status_t status;
+  fsal_admit_ticket_t ticket;
+  uint64_t start;
+
+  if(!fsal_admit_start(&ticket, p_context, FSAL_ADMIT_METADATA))
+    return fsal_admit_refused();
+  start = fsal_stat_start();
+
+  status = fsal_functions.fsal_open_by_name(dirhandle, filename, p_context, openflags,
+                                            file_descriptor, file_attributes);
+
+  fsal_stat_end(INDEX_FSAL_open_by_name, start);
+  fsal_admit_done(&ticket, status);
+  return status;
 }
 
 fsal_status_t FSAL_open(fsal_handle_t * p_filehandle,   /* IN */
@@ -329,8 +602,20 @@ fsal_status_t FSAL_open(fsal_handle_t * p_filehandle,   /* IN */
                         fsal_file_t * p_file_descriptor,        /* OUT */
                         fsal_attrib_list_t * p_file_attributes /* [ IN/OUT ] */ )
 {
-  return fsal_functions.fsal_open(p_filehandle, p_context, openflags, p_file_descriptor,
-                                  p_file_attributes);
+  fsal_status_t status;
+  fsal_admit_ticket_t ticket;
+  uint64_t start;
+
+  if(!fsal_admit_start(&ticket, p_context, FSAL_ADMIT_METADATA))
+    return fsal_admit_refused();
+  start = fsal_stat_start();
+
+  status = fsal_functions.fsal_open(p_filehandle, p_context, openflags, p_file_descriptor,
+                                    p_file_attributes);
+
+  fsal_stat_end(INDEX_FSAL_open, start);
+  fsal_admit_done(&ticket, status);
+  return status;
 }
 
 fsal_status_t FSAL_read(fsal_file_t * p_file_descriptor,        /* IN */
@@ -340,8 +625,20 @@ fsal_status_t FSAL_read(fsal_file_t * p_file_descriptor,        /* IN */
                         fsal_size_t * p_read_amount,    /* OUT */
                         fsal_boolean_t * p_end_of_file /* OUT */ )
 {
-  return fsal_functions.fsal_read(p_file_descriptor, p_seek_descriptor, buffer_size,
-                                  buffer, p_read_amount, p_end_of_file);
+  fsal_status_t status;
+  fsal_admit_ticket_t ticket;
+  uint64_t start;
+
+  if(!fsal_admit_start(&ticket, NULL, FSAL_ADMIT_DATA))
+    return fsal_admit_refused();
+  start = fsal_stat_start();
+
+  status = fsal_functions.fsal_read(p_file_descriptor, p_seek_descriptor, buffer_size,
+                                    buffer, p_read_amount, p_end_of_file);
+
+  fsal_stat_end(INDEX_FSAL_read, start);
+  fsal_admit_done(&ticket, status);
+  return status;
 }
 
 fsal_status_t FSAL_write(fsal_file_t * p_file_descriptor,       /* IN */
@@ -350,18 +647,48 @@ fsal_status_t FSAL_write(fsal_file_t * p_file_descriptor,       /* IN */
                          caddr_t buffer,        /* IN */
                          fsal_size_t * p_write_amount /* OUT */ )
 {
-  return fsal_functions.fsal_write(p_file_descriptor, p_seek_descriptor, buffer_size,
-                                   buffer, p_write_amount);
+  fsal_status_t status;
+  fsal_admit_ticket_t ticket;
+  uint64_t start;
+
+  if(!fsal_admit_start(&ticket, NULL, FSAL_ADMIT_DATA))
+    return fsal_admit_refused();
+  start = fsal_stat_start();
+
+  status = fsal_functions.fsal_write(p_file_descriptor, p_seek_descriptor, buffer_size,
+                                     buffer, p_write_amount);
+
+  fsal_stat_end(INDEX_FSAL_write, start);
+  fsal_admit_done(&ticket, status);
+  return status;
 }
 
 fsal_status_t FSAL_sync(fsal_file_t * p_file_descriptor)
 {
-  return fsal_functions.fsal_sync(p_file_descriptor);
+  fsal_status_t status;
+  fsal_admit_ticket_t ticket;
+  uint64_t start;
+
+  if(!fsal_admit_start(&ticket, NULL, FSAL_ADMIT_DATA))
+    return fsal_admit_refused();
+  start = fsal_stat_start();
+
+  status = fsal_functions.fsal_sync(p_file_descriptor);
+
+  fsal_stat_end(INDEX_FSAL_sync, start);
+  fsal_admit_done(&ticket, status);
+  return status;
 }
 
 fsal_status_t FSAL_close(fsal_file_t * p_file_descriptor /* IN */ )
 {
-  return fsal_functions.fsal_close(p_file_descriptor);
+  fsal_status_t status;
+  uint64_t start = fsal_stat_start();
+
+  status = fsal_functions.fsal_close(p_file_descriptor);
+
+  fsal_stat_end(INDEX_FSAL_close, start);
+  return status;
 }
 
 fsal_status_t FSAL_open_by_fileid(fsal_handle_t * filehandle,   /* IN */
@@ -371,21 +698,51 @@ fsal_status_t FSAL_open_by_fileid(fsal_handle_t * filehandle,   /* IN */
                                   fsal_file_t * file_descriptor,        /* OUT */
                                   fsal_attrib_list_t * file_attributes /* [ IN/OUT ] */ )
 {
-  return fsal_functions.fsal_open_by_fileid(filehandle, fileid, p_context, openflags,
-                                            file_descriptor, file_attributes);
+  fsal_status_t status;
+  fsal_admit_ticket_t ticket;
+  uint64_t start;
+
+  if(!fsal_admit_start(&ticket, p_context, FSAL_ADMIT_METADATA))
+    return fsal_admit_refused();
+  start = fsal_stat_start();
+
+  status = fsal_functions.fsal_open_by_fileid(filehandle, fileid, p_context, openflags,
+                                              file_descriptor, file_attributes);
+
+  fsal_stat_end(INDEX_FSAL_open_by_fileid, start);
+  fsal_admit_done(&ticket, status);
+  return status;
 }
 
 fsal_status_t FSAL_close_by_fileid(fsal_file_t * file_descriptor /* IN */ ,
                                    fsal_u64_t fileid)
 {
-  return fsal_functions.fsal_close_by_fileid(file_descriptor, fileid);
+  fsal_status_t status;
+  uint64_t start = fsal_stat_start();
+
+  status = fsal_functions.fsal_close_by_fileid(file_descriptor, fileid);
+
+  fsal_stat_end(INDEX_FSAL_close_by_fileid, start);
+  return status;
 }
 
 fsal_status_t FSAL_dynamic_fsinfo(fsal_handle_t * p_filehandle, /* IN */
                                   fsal_op_context_t * p_context,        /* IN */
                                   fsal_dynamicfsinfo_t * p_dynamicinfo /* OUT */ )
 {
-  return fsal_functions.fsal_dynamic_fsinfo(p_filehandle, p_context, p_dynamicinfo);
+  fsal_status_t status;
+  fsal_admit_ticket_t ticket;
+  uint64_t start;
+
+  if(!fsal_admit_start(&ticket, p_context, FSAL_ADMIT_METADATA))
+    return fsal_admit_refused();
+  start = fsal_stat_start();
+
+  status = fsal_functions.fsal_dynamic_fsinfo(p_filehandle, p_context, p_dynamicinfo);
+
+  fsal_stat_end(INDEX_FSAL_dynamic_fsinfo, start);
+  fsal_admit_done(&ticket, status);
+  return status;
 }
 
 fsal_status_t FSAL_Init(fsal_parameter_t * init_info /* IN */ )
@@ -518,8 +875,20 @@ fsal_status_t FSAL_lookup(fsal_handle_t * p_parent_directory_handle,    /* IN */
                           fsal_handle_t * p_object_handle,      /* OUT */
                           fsal_attrib_list_t * p_object_attributes /* [ IN/OUT ] */ )
 {
-  return fsal_functions.fsal_lookup(p_parent_directory_handle, p_filename, p_context,
-                                    p_object_handle, p_object_attributes);
+  fsal_status_t status;
+  fsal_admit_ticket_t ticket;
+  uint64_t start;
+
+  if(!fsal_admit_start(&ticket, p_context, FSAL_ADMIT_METADATA))
+    return fsal_admit_refused();
+  start = fsal_stat_start();
+
+  status = fsal_functions.fsal_lookup(p_parent_directory_handle, p_filename, p_context,
+                                      p_object_handle, p_object_attributes);
+
+  fsal_stat_end(INDEX_FSAL_lookup, start);
+  fsal_admit_done(&ticket, status);
+  return status;
 }
 
 fsal_status_t FSAL_lookupPath(fsal_path_t * p_path,     /* IN */
@@ -527,8 +896,20 @@ fsal_status_t FSAL_lookupPath(fsal_path_t * p_path,     /* IN */
                               fsal_handle_t * object_handle,    /* OUT */
                               fsal_attrib_list_t * p_object_attributes /* [ IN/OUT ] */ )
 {
-  return fsal_functions.fsal_lookuppath(p_path, p_context, object_handle,
-                                        p_object_attributes);
+  fsal_status_t status;
+  fsal_admit_ticket_t ticket;
+  uint64_t start;
+
+  if(!fsal_admit_start(&ticket, p_context, FSAL_ADMIT_METADATA))
+    return fsal_admit_refused();
+  start = fsal_stat_start();
+
+  status = fsal_functions.fsal_lookuppath(p_path, p_context, object_handle,
+                                          p_object_attributes);
+
+  fsal_stat_end(INDEX_FSAL_lookupPath, start);
+  fsal_admit_done(&ticket, status);
+  return status;
 }
 
 fsal_status_t FSAL_lookupJunction(fsal_handle_t * p_junction_handle,    /* IN */
@@ -537,8 +918,20 @@ fsal_status_t FSAL_lookupJunction(fsal_handle_t * p_junction_handle,    /* IN */
                                   fsal_attrib_list_t *
                                   p_fsroot_attributes /* [ IN/OUT ] */ )
 {
-  return fsal_functions.fsal_lookupjunction(p_junction_handle, p_context, p_fsoot_handle,
-                                            p_fsroot_attributes);
+  fsal_status_t status;
+  fsal_admit_ticket_t ticket;
+  uint64_t start;
+
+  if(!fsal_admit_start(&ticket, p_context, FSAL_ADMIT_METADATA))
+    return fsal_admit_refused();
+  start = fsal_stat_start();
+
+  status = fsal_functions.fsal_lookupjunction(p_junction_handle, p_context, p_fsoot_handle,
+                                              p_fsroot_attributes);
+
+  fsal_stat_end(INDEX_FSAL_lookupJunction, start);
+  fsal_admit_done(&ticket, status);
+  return status;
 }
 
 fsal_status_t FSAL_CleanObjectResources(fsal_handle_t * in_fsal_handle)
@@ -569,7 +962,19 @@ fsal_status_t FSAL_rcp(fsal_handle_t * filehandle,      /* IN */
                        fsal_path_t * p_local_path,      /* IN */
                        fsal_rcpflag_t transfer_opt /* IN */ )
 {
-  return fsal_functions.fsal_rcp(filehandle, p_context, p_local_path, transfer_opt);
+  fsal_status_t status;
+  fsal_admit_ticket_t ticket;
+  uint64_t start;
+
+  if(!fsal_admit_start(&ticket, p_context, FSAL_ADMIT_DATA))
+    return fsal_admit_refused();
+  start = fsal_stat_start();
+
+  status = fsal_functions.fsal_rcp(filehandle, p_context, p_local_path, transfer_opt);
+
+  fsal_stat_end(INDEX_FSAL_rcp, start);
+  fsal_admit_done(&ticket, status);
+  return status;
 }
 
 fsal_status_t FSAL_rcp_by_fileid(fsal_handle_t * filehandle,    /* IN */
@@ -578,8 +983,20 @@ fsal_status_t FSAL_rcp_by_fileid(fsal_handle_t * filehandle,    /* IN */
                                  fsal_path_t * p_local_path,    /* IN */
                                  fsal_rcpflag_t transfer_opt /* IN */ )
 {
-  return fsal_functions.fsal_rcp_by_fileid(filehandle, fileid, p_context, p_local_path,
-                                           transfer_opt);
+  fsal_status_t status;
+  fsal_admit_ticket_t ticket;
+  uint64_t start;
+
+  if(!fsal_admit_start(&ticket, p_context, FSAL_ADMIT_DATA))
+    return fsal_admit_refused();
+  start = fsal_stat_start();
+
+  status = fsal_functions.fsal_rcp_by_fileid(filehandle, fileid, p_context, p_local_path,
+                                             transfer_opt);
+
+  fsal_stat_end(INDEX_FSAL_rcp, start);
+  fsal_admit_done(&ticket, status);
+  return status;
 }
 
 fsal_status_t FSAL_rename(fsal_handle_t * p_old_parentdir_handle,       /* IN */
@@ -590,9 +1007,21 @@ fsal_status_t FSAL_rename(fsal_handle_t * p_old_parentdir_handle,       /* IN */
                           fsal_attrib_list_t * p_src_dir_attributes,    /* [ IN/OUT ] */
                           fsal_attrib_list_t * p_tgt_dir_attributes /* [ IN/OUT ] */ )
 {
-  return fsal_functions.fsal_rename(p_old_parentdir_handle, p_old_name,
-                                    p_new_parentdir_handle, p_new_name, p_context,
-                                    p_src_dir_attributes, p_tgt_dir_attributes);
+  fsal_status_t status;
+  fsal_admit_ticket_t ticket;
+  uint64_t start;
+
+  if(!fsal_admit_start(&ticket, p_context, FSAL_ADMIT_METADATA))
+    return fsal_admit_refused();
+  start = fsal_stat_start();
+
+  status = fsal_functions.fsal_rename(p_old_parentdir_handle, p_old_name,
+                                      p_new_parentdir_handle, p_new_name, p_context,
+                                      p_src_dir_attributes, p_tgt_dir_attributes);
+
+  fsal_stat_end(INDEX_FSAL_rename, start);
+  fsal_admit_done(&ticket, status);
+  return status;
 }
 
 void FSAL_get_stats(fsal_statistics_t * stats,  /* OUT */
@@ -606,8 +1035,20 @@ fsal_status_t FSAL_readlink(fsal_handle_t * p_linkhandle,       /* IN */
                             fsal_path_t * p_link_content,       /* OUT */
                             fsal_attrib_list_t * p_link_attributes /* [ IN/OUT ] */ )
 {
-  return fsal_functions.fsal_readlink(p_linkhandle, p_context, p_link_content,
-                                      p_link_attributes);
+  fsal_status_t status;
+  fsal_admit_ticket_t ticket;
+  uint64_t start;
+
+  if(!fsal_admit_start(&ticket, p_context, FSAL_ADMIT_METADATA))
+    return fsal_admit_refused();
+  start = fsal_stat_start();
+
+  status = fsal_functions.fsal_readlink(p_linkhandle, p_context, p_link_content,
+                                        p_link_attributes);
+
+  fsal_stat_end(INDEX_FSAL_readlink, start);
+  fsal_admit_done(&ticket, status);
+  return status;
 }
 
 fsal_status_t FSAL_symlink(fsal_handle_t * p_parent_directory_handle,   /* IN */
@@ -618,9 +1059,21 @@ fsal_status_t FSAL_symlink(fsal_handle_t * p_parent_directory_handle,   /* IN */
                            fsal_handle_t * p_link_handle,       /* OUT */
                            fsal_attrib_list_t * p_link_attributes /* [ IN/OUT ] */ )
 {
-  return fsal_functions.fsal_symlink(p_parent_directory_handle, p_linkname, p_linkcontent,
-                                     p_context, accessmode, p_link_handle,
-                                     p_link_attributes);
+  fsal_status_t status;
+  fsal_admit_ticket_t ticket;
+  uint64_t start;
+
+  if(!fsal_admit_start(&ticket, p_context, FSAL_ADMIT_METADATA))
+    return fsal_admit_refused();
+  start = fsal_stat_start();
+
+  status = fsal_functions.fsal_symlink(p_parent_directory_handle, p_linkname, p_linkcontent,
+                                       p_context, accessmode, p_link_handle,
+                                       p_link_attributes);
+
+  fsal_stat_end(INDEX_FSAL_symlink, start);
+  fsal_admit_done(&ticket, status);
+  return status;
 }
 
 int FSAL_handlecmp(fsal_handle_t * handle1, fsal_handle_t * handle2,
@@ -717,8 +1170,20 @@ fsal_status_t FSAL_truncate(fsal_handle_t * p_filehandle,
                             fsal_file_t * file_descriptor,
                             fsal_attrib_list_t * p_object_attributes)
 {
-  return fsal_functions.fsal_truncate(p_filehandle, p_context, length, file_descriptor,
-                                      p_object_attributes);
+  fsal_status_t status;
+  fsal_admit_ticket_t ticket;
+  uint64_t start;
+
+  if(!fsal_admit_start(&ticket, p_context, FSAL_ADMIT_METADATA))
+    return fsal_admit_refused();
+  start = fsal_stat_start();
+
+  status = fsal_functions.fsal_truncate(p_filehandle, p_context, length, file_descriptor,
+                                        p_object_attributes);
+
+  fsal_stat_end(INDEX_FSAL_truncate, start);
+  fsal_admit_done(&ticket, status);
+  return status;
 }
 
 fsal_status_t FSAL_unlink(fsal_handle_t * p_parent_directory_handle,    /* IN */
@@ -727,8 +1192,20 @@ fsal_status_t FSAL_unlink(fsal_handle_t * p_parent_directory_handle,    /* IN */
                           fsal_attrib_list_t *
                           p_parent_directory_attributes /* [IN/OUT ] */ )
 {
-  return fsal_functions.fsal_unlink(p_parent_directory_handle, p_object_name, p_context,
-                                    p_parent_directory_attributes);
+  fsal_status_t status;
+  fsal_admit_ticket_t ticket;
+  uint64_t start;
+
+  if(!fsal_admit_start(&ticket, p_context, FSAL_ADMIT_METADATA))
+    return fsal_admit_refused();
+  start = fsal_stat_start();
+
+  status = fsal_functions.fsal_unlink(p_parent_directory_handle, p_object_name, p_context,
+                                      p_parent_directory_attributes);
+
+  fsal_stat_end(INDEX_FSAL_unlink, start);
+  fsal_admit_done(&ticket, status);
+  return status;
 }
 
 char *FSAL_GetFSName()
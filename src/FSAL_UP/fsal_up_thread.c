@@ -45,6 +45,7 @@ void create_fsal_up_threads()
   pthread_attr_t attr_thr;
   fsal_up_arg_t *fsal_up_args;
   exportlist_t *pcurrent;
+  nfs_export_reader_t export_reader;
 
   /* Initialization of thread attrinbutes borrowed from nfs_init.c */
   if(pthread_attr_init(&attr_thr) != 0)
@@ -59,10 +60,10 @@ void create_fsal_up_threads()
   if(pthread_attr_setstacksize(&attr_thr, THREAD_STACK_SIZE) != 0)
     LogDebug(COMPONENT_THREAD, "can't set pthread's stack size");
 
-  /* The admin thread is the only other thread that may be
-   * messing around with the export entries. */
-
-  //  LOCK EXPORT LIST
+  /* A reload of the exports waits for this walk to be done before freeing
+   * them, each FSAL UP thread holds the export it was given */
+  nfs_export_reader_register(&export_reader);
+  nfs_export_reader_enter(&export_reader);
   for(pcurrent = nfs_param.pexportlist;
       pcurrent != NULL;
       pcurrent = pcurrent->next)
@@ -102,10 +103,12 @@ void create_fsal_up_threads()
             }
 
           fsal_up_args->export_entry = pcurrent;
+          nfs_export_get(pcurrent);
 
           if( ( rc = pthread_create( &pcurrent->fsal_up_thr, &attr_thr,
                                      fsal_up_thread,(void *)fsal_up_args)) != 0)
             {
+              nfs_export_put(pcurrent);
               Mem_Free(fsal_up_args);
               LogFatal(COMPONENT_THREAD,
                        "Could not create fsal_up_thread, error = %d (%s)",
@@ -114,6 +117,8 @@ void create_fsal_up_threads()
             }
         }
     }
+  nfs_export_reader_exit(&export_reader);
+  nfs_export_reader_unregister(&export_reader);
 }
 
 /* Given to MakePool() to be used as a constructor of
@@ -219,7 +224,7 @@ fsal_status_t process_event(fsal_up_event_t *event, fsal_up_event_functions_t *e
   return status;
 }
 
-/* The admin exportlist must be locked before calling this function!! */
+/* To be called within an export reader section, as create_fsal_up_threads does */
 static int fsal_up_thread_exists(exportlist_t *entry)
 {
   exportlist_t *pcurrent;
@@ -316,6 +321,7 @@ void *fsal_up_thread(void *Arg)
     {
       LogCrit(COMPONENT_FSAL_UP, "Error: FSAL UP TYPE: %s does not exist. "
               "Exiting FSAL UP thread.", fsal_up_args->export_entry->fsal_up_type);
+      nfs_export_put(fsal_up_args->export_entry);
       Mem_Free(Arg);
       return NULL;
     }
@@ -399,6 +405,8 @@ void *fsal_up_thread(void *Arg)
                       fsal_up_args->export_entry->filesystem_id.major,
                       fsal_up_args->export_entry->filesystem_id.minor,
                       fsal_up_args->export_entry->id);
+              nfs_export_put(fsal_up_args->export_entry);
+              Mem_Free(Arg);
               return NULL;
             }
           else
@@ -438,6 +446,7 @@ void *fsal_up_thread(void *Arg)
                fsal_up_args->export_entry->id);
     }
 
+  nfs_export_put(fsal_up_args->export_entry);
   Mem_Free(Arg);
   return NULL;
 }                               /* fsal_up_thread */
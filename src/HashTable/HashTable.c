@@ -173,6 +173,7 @@
 
 #include <stdio.h>
 #include <string.h>
+#include <strings.h>
 #include <pthread.h>
 #include "RW_Lock.h"
 #include "HashTable.h"
@@ -387,6 +388,36 @@ static int Key_Locate(hash_table_t * ht, hash_buffer_t * buffkey, unsigned int h
 
 /* ------ This group contains all the functions used to manipulate the hash table from outside this module ----- */
 
+/**
+ *
+ * HashTable_EngineFromStr: Converts an engine name, as found in the configuration file, to a hash_engine_t.
+ *
+ * @param str the name of the engine ("RBT" or "Open_Addressing", case insensitive).
+ *
+ * @return the engine, or -1 if the name is unknown.
+ *
+ */
+int HashTable_EngineFromStr(char *str)
+{
+  if(!strcasecmp(str, "RBT"))
+    return HASHTABLE_ENGINE_RBT;
+
+  if(!strcasecmp(str, "Open_Addressing"))
+    return HASHTABLE_ENGINE_OPEN_ADDRESSING;
+
+  return -1;
+}                               /* HashTable_EngineFromStr */
+
+const char *HashTable_EngineToStr(hash_engine_t engine)
+{
+  switch(engine)
+    {
+      case HASHTABLE_ENGINE_RBT:             return "RBT";
+      case HASHTABLE_ENGINE_OPEN_ADDRESSING: return "Open_Addressing";
+    }
+  return "Unknown";
+}                               /* HashTable_EngineToStr */
+
 /**
  * @defgroup HashTableExportedFunctions
  *@{
@@ -425,6 +456,20 @@ hash_table_t *HashTable_Init(hash_parameter_t hparam)
 
   /* we have to keep the discriminant values */
   ht->parameter = hparam;
+  ht->partitions = NULL;
+
+  if(hparam.engine == HASHTABLE_ENGINE_OPEN_ADDRESSING)
+    {
+      if(HashTable_Open_Init(ht) != HASHTABLE_SUCCESS)
+        {
+          Mem_Free( ht ) ;
+          return NULL;
+        }
+      return ht;
+    }
+
+  /* Anything else is the historical RBT engine */
+  ht->parameter.engine = HASHTABLE_ENGINE_RBT;
 
   if(pthread_mutexattr_init(&mutexattr) != 0)
     {
@@ -588,6 +633,9 @@ int HashTable_Test_And_Set(hash_table_t * ht, hash_buffer_t * buffkey,
   else if(buffval == NULL)
     return HASHTABLE_ERROR_INVALID_ARGUMENT;
 
+  if(ht->parameter.engine == HASHTABLE_ENGINE_OPEN_ADDRESSING)
+    return HashTable_Open_Test_And_Set(ht, buffkey, buffval, how);
+
   /* Compute values to locate into the hashtable */
   if( ht->parameter.hash_func_both != NULL )
    {
@@ -719,6 +767,9 @@ int HashTable_GetRef(hash_table_t * ht, hash_buffer_t * buffkey, hash_buffer_t *
   if(ht == NULL || buffkey == NULL || buffval == NULL)
     return HASHTABLE_ERROR_INVALID_ARGUMENT;
 
+  if(ht->parameter.engine == HASHTABLE_ENGINE_OPEN_ADDRESSING)
+    return HashTable_Open_GetRef(ht, buffkey, buffval, get_ref);
+
   /* Compute values to locate into the hashtable */
   if( ht->parameter.hash_func_both != NULL )
    {
@@ -804,6 +855,9 @@ int HashTable_Get_and_Del(hash_table_t  * ht,
   if(ht == NULL || buffkey == NULL || buffval == NULL)
     return HASHTABLE_ERROR_INVALID_ARGUMENT;
 
+  if(ht->parameter.engine == HASHTABLE_ENGINE_OPEN_ADDRESSING)
+    return HashTable_Open_Get_and_Del(ht, buffkey, buffval, buff_used_key);
+
   /* Compute values to locate into the hashtable */
   if( ht->parameter.hash_func_both != NULL )
    {
@@ -894,6 +948,9 @@ int HashTable_Delall(hash_table_t * ht, int (*free_func)(hash_buffer_t, hash_buf
 
   LogFullDebug(COMPONENT_HASHTABLE, "Deleting all entries in hashtable.");
 
+  if(ht->parameter.engine == HASHTABLE_ENGINE_OPEN_ADDRESSING)
+    return HashTable_Open_Delall(ht, free_func);
+
   /* For each bucket of the hashtable */
   for(hashval = 0; hashval < ht->parameter.index_size; hashval++)
     {
@@ -970,6 +1027,9 @@ int HashTable_DelRef(hash_table_t * ht, hash_buffer_t * buffkey,
   if(ht == NULL || buffkey == NULL)
     return HASHTABLE_ERROR_INVALID_ARGUMENT;
 
+  if(ht->parameter.engine == HASHTABLE_ENGINE_OPEN_ADDRESSING)
+    return HashTable_Open_DelRef(ht, buffkey, p_usedbuffkey, p_usedbuffdata, put_ref);
+
   /* Compute values to locate into the hashtable */
   if( ht->parameter.hash_func_both != NULL )
    {
@@ -1055,6 +1115,7 @@ int HashTable_Del(hash_table_t * ht, hash_buffer_t * buffkey,
 void HashTable_GetStats(hash_table_t * ht, hash_stat_t * hstat)
 {
   unsigned int i = 0;
+  unsigned int num_node = 0;
 
   /* Sanity check */
   if(ht == NULL || hstat == NULL)
@@ -1087,13 +1148,19 @@ void HashTable_GetStats(hash_table_t * ht, hash_stat_t * hstat)
 
   for(i = 0; i < ht->parameter.index_size; i++)
     {
-      if(ht->array_rbt[i].rbt_num_node > hstat->computed.max_rbt_num_node)
-        hstat->computed.max_rbt_num_node = ht->array_rbt[i].rbt_num_node;
+      /* With the open addressing engine, the "rbt" figures describe the partitions */
+      if(ht->parameter.engine == HASHTABLE_ENGINE_OPEN_ADDRESSING)
+        num_node = ht->partitions[i].nb_used;
+      else
+        num_node = ht->array_rbt[i].rbt_num_node;
+
+      if(num_node > hstat->computed.max_rbt_num_node)
+        hstat->computed.max_rbt_num_node = num_node;
 
-      if(ht->array_rbt[i].rbt_num_node < hstat->computed.min_rbt_num_node)
-        hstat->computed.min_rbt_num_node = ht->array_rbt[i].rbt_num_node;
+      if(num_node < hstat->computed.min_rbt_num_node)
+        hstat->computed.min_rbt_num_node = num_node;
 
-      hstat->computed.average_rbt_num_node += ht->array_rbt[i].rbt_num_node;
+      hstat->computed.average_rbt_num_node += num_node;
 
       hstat->dynamic.nb_entries += ht->stat_dynamic[i].nb_entries;
 
@@ -1185,6 +1252,12 @@ void HashTable_Log(log_components_t component, hash_table_t * ht)
 
   LogFullDebug(component, "The hash contains %d entries", nb_entries);
 
+  if(ht->parameter.engine == HASHTABLE_ENGINE_OPEN_ADDRESSING)
+    {
+      HashTable_Open_Dump(ht, component, FALSE);
+      return;
+    }
+
   for(i = 0; i < ht->parameter.index_size; i++)
     {
       tete_rbt = &((ht->array_rbt)[i]);
@@ -1266,6 +1339,12 @@ void HashTable_Print( hash_table_t * ht)
 
   fprintf(stderr,"The hash contains %d entries\n", nb_entries);
 
+  if(ht->parameter.engine == HASHTABLE_ENGINE_OPEN_ADDRESSING)
+    {
+      HashTable_Open_Dump(ht, COMPONENT_HASHTABLE, TRUE);
+      return;
+    }
+
   for(i = 0; i < ht->parameter.index_size; i++)
     {
       tete_rbt = &((ht->array_rbt)[i]);
@@ -0,0 +1,813 @@
+/*
+ * vim:expandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * ---------------------------------------
+ */
+
+/**
+ * \file    HashTable_open.c
+ * \brief   Open addressing engine for the hash tables.
+ *
+ * HashTable_open.c : the index_size partitions of the table (selected by
+ * hashval, as the RBTs of the default engine are) are lock stripes. Each
+ * partition is a linear probing table of hash_data_t which doubles its size
+ * on its own when it gets 3/4 full, so a resize only stalls the writers of
+ * one stripe. Removal uses backward shift deletion, there is no tombstone.
+ *
+ * Writers serialize on the partition mutex and make the partition sequence
+ * counter odd while they modify the slots. HashTable_Get reads the slots
+ * without any lock and retries when the sequence changed under its feet.
+ * As a key may be freed by its owner as soon as it is removed, the lock-free
+ * reader only compares the inline copy of the key kept in the slot: when that
+ * cannot tell (the key is too long for the copy, or the bytes differ while the
+ * tags are the same), the lookup is done again with the lock held.
+ * Slot arrays replaced by a resize are retired: a reader that sampled the old
+ * array can safely finish its probe before noticing the resize. The lock-free
+ * readers are counted per partition, the retired arrays are freed by the next
+ * writer that finds none of them. The statistics bumped by those readers are
+ * updated with atomic adds.
+ *
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+#include "HashTable.h"
+#include "stuff_alloc.h"
+#include "log_macros.h"
+
+#ifndef TRUE
+#define TRUE 1
+#endif
+
+#ifndef FALSE
+#define FALSE 0
+#endif
+
+#ifndef P
+#define P( a ) pthread_mutex_lock( &a )
+#endif
+
+#ifndef V
+#define V( a ) pthread_mutex_unlock( &a )
+#endif
+
+/**
+ * @defgroup HashTableOpenInternalFunctions
+ *@{
+ */
+
+/**
+ *
+ * Open_Compute_Values: computes the partition and the slot tag of a key.
+ *
+ * @param ht the hashtable to be used.
+ * @param buffkey the key.
+ * @param phashval [OUT] the partition of the key.
+ * @param ptag [OUT] the tag of the key, never 0.
+ *
+ * @return HASHTABLE_SUCCESS or HASHTABLE_ERROR_INVALID_ARGUMENT.
+ *
+ */
+static int Open_Compute_Values(hash_table_t * ht, hash_buffer_t * buffkey,
+                               unsigned int *phashval, uint64_t * ptag)
+{
+  uint32_t hashval = 0;
+  uint32_t rbt_value = 0;
+  uint64_t tag;
+
+  if(ht->parameter.hash_func_both != NULL)
+    {
+      if((*(ht->parameter.hash_func_both)) (&ht->parameter, buffkey, &hashval, &rbt_value) == 0)
+        return HASHTABLE_ERROR_INVALID_ARGUMENT;
+    }
+  else
+    {
+      hashval = (*(ht->parameter.hash_func_key)) (&ht->parameter, buffkey);
+      rbt_value = (*(ht->parameter.hash_func_rbt)) (&ht->parameter, buffkey);
+    }
+
+  if(hashval >= ht->parameter.index_size)
+    return HASHTABLE_ERROR_INVALID_ARGUMENT;
+
+  /* The rbt value is the only entropy left inside a partition: spread it on
+   * the 64 bits of the tag (finalizer of murmur3) so that the low bits used
+   * to pick the slot are well distributed */
+  tag = ((uint64_t) hashval << 32) | rbt_value;
+  tag ^= tag >> 33;
+  tag *= 0xff51afd7ed558ccdULL;
+  tag ^= tag >> 33;
+  tag *= 0xc4ceb9fe1a85ec53ULL;
+  tag ^= tag >> 33;
+
+  if(tag == 0)
+    tag = 1;
+
+  *phashval = hashval;
+  *ptag = tag;
+
+  return HASHTABLE_SUCCESS;
+}                               /* Open_Compute_Values */
+
+/**
+ *
+ * Open_Alloc_Array: allocates an empty slot array.
+ *
+ * @param nb_slots the number of slots, a power of 2.
+ *
+ * @return the new array, NULL if allocation failed.
+ *
+ */
+static hash_slot_array_t *Open_Alloc_Array(unsigned int nb_slots)
+{
+  hash_slot_array_t *array;
+
+  array = (hash_slot_array_t *) Mem_Calloc_Label(1,
+                                                 sizeof(hash_slot_array_t) +
+                                                 (nb_slots - 1) * sizeof(hash_slot_t),
+                                                 "hash_slot_array_t");
+  if(array == NULL)
+    return NULL;
+
+  array->mask = nb_slots - 1;
+  array->retired = NULL;
+
+  return array;
+}                               /* Open_Alloc_Array */
+
+/**
+ *
+ * Open_Locate: looks for a key in a slot array.
+ *
+ * Called with the partition lock held.
+ *
+ * @return the index of the slot holding the key, -1 if not found.
+ *
+ */
+static int Open_Locate(hash_table_t * ht, hash_slot_array_t * array,
+                       hash_buffer_t * buffkey, uint64_t tag)
+{
+  unsigned int mask = array->mask;
+  unsigned int i = tag & mask;
+  unsigned int probe;
+  uint64_t slot_tag;
+  hash_buffer_t slot_key;
+
+  for(probe = 0; probe <= mask; probe++)
+    {
+      slot_tag = array->slots[i].tag;
+
+      if(slot_tag == 0)
+        return -1;
+
+      if(slot_tag == tag)
+        {
+          slot_key = array->slots[i].data.buffkey;
+          if(slot_key.pdata != NULL
+             && ht->parameter.compare_key(buffkey, &slot_key) == 0)
+            return i;
+        }
+
+      i = (i + 1) & mask;
+    }
+
+  return -1;
+}                               /* Open_Locate */
+
+/**
+ *
+ * Open_Locate_Inline: looks for a key in a slot array, without the lock.
+ *
+ * Only the inline copies of the keys are compared, the keys themselves are
+ * never dereferenced. The caller validates the result with the partition
+ * sequence counter.
+ *
+ * @return the index of the slot holding the key, -1 if not found,
+ *         -2 if the inline copies cannot tell.
+ *
+ */
+static int Open_Locate_Inline(hash_slot_array_t * array, hash_buffer_t * buffkey, uint64_t tag)
+{
+  unsigned int mask = array->mask;
+  unsigned int i = tag & mask;
+  unsigned int probe;
+  int unsure = FALSE;
+
+  for(probe = 0; probe <= mask; probe++)
+    {
+      if(array->slots[i].tag == 0)
+        break;
+
+      if(array->slots[i].tag == tag)
+        {
+          if(buffkey->len != 0 && array->slots[i].key_len == buffkey->len
+             && memcmp(array->slots[i].key, buffkey->pdata, buffkey->len) == 0)
+            return i;
+
+          /* Same tag, maybe the same key */
+          unsure = TRUE;
+        }
+
+      i = (i + 1) & mask;
+    }
+
+  return unsure ? -2 : -1;
+}                               /* Open_Locate_Inline */
+
+/**
+ *
+ * Open_Set_Key: stores a key in a slot, with its inline copy when it fits.
+ *
+ */
+static void Open_Set_Key(hash_slot_t * pslot, hash_buffer_t * buffkey)
+{
+  pslot->data.buffkey = *buffkey;
+
+  if(buffkey->pdata != NULL && buffkey->len != 0 && buffkey->len <= HASHTABLE_OPEN_INLINE_KEY)
+    {
+      memcpy(pslot->key, buffkey->pdata, buffkey->len);
+      pslot->key_len = buffkey->len;
+    }
+  else
+    pslot->key_len = 0;
+}                               /* Open_Set_Key */
+
+/**
+ *
+ * Open_Insert_Slot: puts an entry in the first free slot of its probe sequence.
+ *
+ * The key must not be in the array and the array must have a free slot.
+ *
+ */
+static void Open_Insert_Slot(hash_slot_array_t * array, uint64_t tag, hash_data_t * pdata)
+{
+  unsigned int i = tag & array->mask;
+
+  while(array->slots[i].tag != 0)
+    i = (i + 1) & array->mask;
+
+  Open_Set_Key(&array->slots[i], &pdata->buffkey);
+  array->slots[i].data.buffval = pdata->buffval;
+  array->slots[i].tag = tag;
+}                               /* Open_Insert_Slot */
+
+/**
+ *
+ * Open_Remove_Slot: empties a slot, shifting back the entries of the cluster
+ * that follows it so that no probe sequence is broken.
+ *
+ */
+static void Open_Remove_Slot(hash_slot_array_t * array, unsigned int hole)
+{
+  unsigned int mask = array->mask;
+  unsigned int j = hole;
+  unsigned int home;
+
+  for(;;)
+    {
+      j = (j + 1) & mask;
+
+      if(array->slots[j].tag == 0)
+        break;
+
+      /* The entry in j may fill the hole if its home slot is not between the
+       * hole (excluded) and j (included), cyclically speaking */
+      home = array->slots[j].tag & mask;
+      if(((j - home) & mask) >= ((j - hole) & mask))
+        {
+          array->slots[hole] = array->slots[j];
+          hole = j;
+        }
+    }
+
+  array->slots[hole].tag = 0;
+  array->slots[hole].data.buffkey.pdata = NULL;
+  array->slots[hole].data.buffkey.len = 0;
+  array->slots[hole].key_len = 0;
+}                               /* Open_Remove_Slot */
+
+/**
+ *
+ * Open_Grow: doubles the slot array of a partition.
+ *
+ * Called with the partition lock held and the sequence counter odd.
+ *
+ * @return HASHTABLE_SUCCESS or HASHTABLE_INSERT_MALLOC_ERROR.
+ *
+ */
+static int Open_Grow(hash_table_t * ht, hash_partition_t * part, unsigned int hashval)
+{
+  hash_slot_array_t *old = part->array;
+  hash_slot_array_t *array;
+  unsigned int i;
+
+  if((array = Open_Alloc_Array((old->mask + 1) * 2)) == NULL)
+    return HASHTABLE_INSERT_MALLOC_ERROR;
+
+  for(i = 0; i <= old->mask; i++)
+    if(old->slots[i].tag != 0)
+      Open_Insert_Slot(array, old->slots[i].tag, &old->slots[i].data);
+
+  /* Lock-free readers may still walk the old array */
+  old->retired = part->retired;
+  part->retired = old;
+
+  __sync_synchronize();
+  part->array = array;
+
+  LogFullDebug(COMPONENT_HASHTABLE,
+               "Hash table %s: partition %u now has %u slots for %u entries",
+               ht->parameter.name != NULL ? ht->parameter.name : "Unamed",
+               hashval, array->mask + 1, part->nb_used);
+
+  return HASHTABLE_SUCCESS;
+}                               /* Open_Grow */
+
+static void Open_Write_Begin(hash_partition_t * part)
+{
+  P(part->lock);
+  part->seq += 1;
+  __sync_synchronize();
+}                               /* Open_Write_Begin */
+
+static void Open_Write_End(hash_partition_t * part)
+{
+  hash_slot_array_t *array;
+
+  __sync_synchronize();
+  part->seq += 1;
+
+  /* A reader that comes after the barrier sees the current array, so once
+   * no reader is counted nobody can still be walking a retired one */
+  if(part->retired != NULL)
+    {
+      __sync_synchronize();
+      if(part->nb_readers == 0)
+        while((array = part->retired) != NULL)
+          {
+            part->retired = array->retired;
+            Mem_Free(array);
+          }
+    }
+
+  V(part->lock);
+}                               /* Open_Write_End */
+
+/*}@ */
+
+/**
+ * @defgroup HashTableOpenFunctions
+ *@{
+ */
+
+/**
+ *
+ * HashTable_Open_Init: builds the partitions of an open addressing table.
+ *
+ * Each partition starts with enough slots to hold nb_node_prealloc entries
+ * below the resize threshold.
+ *
+ * @param ht the hashtable, whose parameter field is already set.
+ *
+ * @return HASHTABLE_SUCCESS or HASHTABLE_INSERT_MALLOC_ERROR.
+ *
+ */
+int HashTable_Open_Init(hash_table_t * ht)
+{
+  unsigned int i;
+  unsigned int nb_slots = HASHTABLE_OPEN_MIN_SLOTS;
+
+  ht->array_rbt = NULL;
+  ht->array_lock = NULL;
+  ht->node_prealloc = NULL;
+  ht->pdata_prealloc = NULL;
+
+  while(nb_slots * 3 < ht->parameter.nb_node_prealloc * 4)
+    nb_slots *= 2;
+
+  if((ht->stat_dynamic =
+      (hash_stat_dynamic_t *) Mem_Calloc_Label(ht->parameter.index_size,
+                                               sizeof(hash_stat_dynamic_t),
+                                               "hash_stat_dynamic_t")) == NULL)
+    return HASHTABLE_INSERT_MALLOC_ERROR;
+
+  if((ht->partitions =
+      (hash_partition_t *) Mem_Calloc_Label(ht->parameter.index_size,
+                                            sizeof(hash_partition_t),
+                                            "hash_partition_t")) == NULL)
+    {
+      Mem_Free(ht->stat_dynamic);
+      return HASHTABLE_INSERT_MALLOC_ERROR;
+    }
+
+  for(i = 0; i < ht->parameter.index_size; i++)
+    {
+      if(pthread_mutex_init(&ht->partitions[i].lock, NULL) != 0)
+        return HASHTABLE_INSERT_MALLOC_ERROR;
+
+      ht->partitions[i].seq = 0;
+      ht->partitions[i].nb_used = 0;
+      ht->partitions[i].nb_readers = 0;
+      ht->partitions[i].retired = NULL;
+
+      if((ht->partitions[i].array = Open_Alloc_Array(nb_slots)) == NULL)
+        return HASHTABLE_INSERT_MALLOC_ERROR;
+    }
+
+  return HASHTABLE_SUCCESS;
+}                               /* HashTable_Open_Init */
+
+/**
+ *
+ * HashTable_Open_Test_And_Set: HashTable_Test_And_Set for the open addressing engine.
+ *
+ */
+int HashTable_Open_Test_And_Set(hash_table_t * ht, hash_buffer_t * buffkey,
+                                hash_buffer_t * buffval, hashtable_set_how_t how)
+{
+  unsigned int hashval;
+  uint64_t tag;
+  hash_partition_t *part;
+  hash_data_t data;
+  int idx;
+  int rc;
+
+  if(Open_Compute_Values(ht, buffkey, &hashval, &tag) != HASHTABLE_SUCCESS)
+    return HASHTABLE_ERROR_INVALID_ARGUMENT;
+
+  part = &ht->partitions[hashval];
+
+  Open_Write_Begin(part);
+
+  idx = Open_Locate(ht, part->array, buffkey, tag);
+
+  if(idx >= 0)
+    {
+      /* An entry of that key already exists */
+      if(how == HASHTABLE_SET_HOW_TEST_ONLY)
+        {
+          ht->stat_dynamic[hashval].ok.nb_test += 1;
+          Open_Write_End(part);
+          return HASHTABLE_SUCCESS;
+        }
+
+      if(how == HASHTABLE_SET_HOW_SET_NO_OVERWRITE)
+        {
+          ht->stat_dynamic[hashval].err.nb_test += 1;
+          Open_Write_End(part);
+          return HASHTABLE_ERROR_KEY_ALREADY_EXISTS;
+        }
+
+      Open_Set_Key(&part->array->slots[idx], buffkey);
+      part->array->slots[idx].data.buffval = *buffval;
+    }
+  else
+    {
+      if(how == HASHTABLE_SET_HOW_TEST_ONLY)
+        {
+          ht->stat_dynamic[hashval].notfound.nb_test += 1;
+          Open_Write_End(part);
+          return HASHTABLE_ERROR_NO_SUCH_KEY;
+        }
+
+      /* Keep the load factor below 3/4 */
+      if((part->nb_used + 1) * 4 > (part->array->mask + 1) * 3)
+        if((rc = Open_Grow(ht, part, hashval)) != HASHTABLE_SUCCESS)
+          {
+            ht->stat_dynamic[hashval].err.nb_set += 1;
+            Open_Write_End(part);
+            return rc;
+          }
+
+      data.buffkey = *buffkey;
+      data.buffval = *buffval;
+      Open_Insert_Slot(part->array, tag, &data);
+
+      part->nb_used += 1;
+      ht->stat_dynamic[hashval].nb_entries += 1;
+    }
+
+  ht->stat_dynamic[hashval].ok.nb_set += 1;
+
+  Open_Write_End(part);
+
+  return HASHTABLE_SUCCESS;
+}                               /* HashTable_Open_Test_And_Set */
+
+/**
+ *
+ * HashTable_Open_GetRef: HashTable_GetRef for the open addressing engine.
+ *
+ * Without get_ref the lookup is lock-free: it is attempted optimistically
+ * up to HASHTABLE_OPEN_READ_RETRIES times, then the partition lock is taken.
+ * The lock is taken at once when the inline copies of the keys cannot tell
+ * whether the key is there.
+ * With get_ref, the reference must be taken while no writer can remove the
+ * entry, so the lock is always taken.
+ *
+ */
+int HashTable_Open_GetRef(hash_table_t * ht, hash_buffer_t * buffkey, hash_buffer_t * buffval,
+                          void (*get_ref)(hash_buffer_t *) )
+{
+  unsigned int hashval;
+  uint64_t tag;
+  hash_partition_t *part;
+  hash_slot_array_t *array;
+  hash_buffer_t val;
+  unsigned int seq;
+  unsigned int tries;
+  int idx;
+
+  if(Open_Compute_Values(ht, buffkey, &hashval, &tag) != HASHTABLE_SUCCESS)
+    return HASHTABLE_ERROR_INVALID_ARGUMENT;
+
+  part = &ht->partitions[hashval];
+
+  if(get_ref == NULL)
+    {
+      /* Keeps the arrays this reader may sample from being freed */
+      __sync_fetch_and_add(&part->nb_readers, 1);
+
+      for(tries = 0; tries < HASHTABLE_OPEN_READ_RETRIES; tries++)
+        {
+          seq = part->seq;
+          if(seq & 1)
+            {
+              /* A writer is busy on this partition */
+              sched_yield();
+              continue;
+            }
+          __sync_synchronize();
+
+          array = part->array;
+          idx = Open_Locate_Inline(array, buffkey, tag);
+          if(idx >= 0)
+            val = array->slots[idx].data.buffval;
+
+          __sync_synchronize();
+          if(part->seq != seq)
+            continue;
+
+          if(idx == -2)
+            break;
+
+          __sync_fetch_and_sub(&part->nb_readers, 1);
+
+          if(idx < 0)
+            {
+              __sync_fetch_and_add(&ht->stat_dynamic[hashval].notfound.nb_get, 1);
+              return HASHTABLE_ERROR_NO_SUCH_KEY;
+            }
+
+          *buffval = val;
+          __sync_fetch_and_add(&ht->stat_dynamic[hashval].ok.nb_get, 1);
+          return HASHTABLE_SUCCESS;
+        }
+
+      __sync_fetch_and_sub(&part->nb_readers, 1);
+    }
+
+  P(part->lock);
+
+  if((idx = Open_Locate(ht, part->array, buffkey, tag)) < 0)
+    {
+      __sync_fetch_and_add(&ht->stat_dynamic[hashval].notfound.nb_get, 1);
+      V(part->lock);
+      return HASHTABLE_ERROR_NO_SUCH_KEY;
+    }
+
+  *buffval = part->array->slots[idx].data.buffval;
+  __sync_fetch_and_add(&ht->stat_dynamic[hashval].ok.nb_get, 1);
+
+  if(get_ref != NULL)
+    get_ref(buffval);
+
+  V(part->lock);
+
+  return HASHTABLE_SUCCESS;
+}                               /* HashTable_Open_GetRef */
+
+/**
+ *
+ * HashTable_Open_Get_and_Del: HashTable_Get_and_Del for the open addressing engine.
+ *
+ */
+int HashTable_Open_Get_and_Del(hash_table_t  * ht, hash_buffer_t * buffkey,
+                               hash_buffer_t * buffval, hash_buffer_t * buff_used_key)
+{
+  unsigned int hashval;
+  uint64_t tag;
+  hash_partition_t *part;
+  int idx;
+
+  if(Open_Compute_Values(ht, buffkey, &hashval, &tag) != HASHTABLE_SUCCESS)
+    return HASHTABLE_ERROR_INVALID_ARGUMENT;
+
+  part = &ht->partitions[hashval];
+
+  Open_Write_Begin(part);
+
+  if((idx = Open_Locate(ht, part->array, buffkey, tag)) < 0)
+    {
+      __sync_fetch_and_add(&ht->stat_dynamic[hashval].notfound.nb_get, 1);
+      Open_Write_End(part);
+      return HASHTABLE_ERROR_NO_SUCH_KEY;
+    }
+
+  *buffval = part->array->slots[idx].data.buffval;
+
+  if(buff_used_key != NULL)
+    *buff_used_key = part->array->slots[idx].data.buffkey;
+
+  __sync_fetch_and_add(&ht->stat_dynamic[hashval].ok.nb_get, 1);
+
+  Open_Remove_Slot(part->array, idx);
+
+  part->nb_used -= 1;
+  ht->stat_dynamic[hashval].nb_entries -= 1;
+  ht->stat_dynamic[hashval].ok.nb_del += 1;
+
+  Open_Write_End(part);
+
+  return HASHTABLE_SUCCESS;
+}                               /* HashTable_Open_Get_and_Del */
+
+/**
+ *
+ * HashTable_Open_DelRef: HashTable_DelRef for the open addressing engine.
+ *
+ */
+int HashTable_Open_DelRef(hash_table_t * ht, hash_buffer_t * buffkey,
+                          hash_buffer_t * p_usedbuffkey, hash_buffer_t * p_usedbuffdata,
+                          int (*put_ref)(hash_buffer_t *) )
+{
+  unsigned int hashval;
+  uint64_t tag;
+  hash_partition_t *part;
+  hash_data_t *pdata;
+  int idx;
+
+  if(Open_Compute_Values(ht, buffkey, &hashval, &tag) != HASHTABLE_SUCCESS)
+    return HASHTABLE_ERROR_INVALID_ARGUMENT;
+
+  part = &ht->partitions[hashval];
+
+  Open_Write_Begin(part);
+
+  if((idx = Open_Locate(ht, part->array, buffkey, tag)) < 0)
+    {
+      ht->stat_dynamic[hashval].notfound.nb_del += 1;
+      Open_Write_End(part);
+      return HASHTABLE_ERROR_NO_SUCH_KEY;
+    }
+
+  pdata = &part->array->slots[idx].data;
+
+  if(p_usedbuffkey != NULL)
+    *p_usedbuffkey = pdata->buffkey;
+
+  if(p_usedbuffdata != NULL)
+    *p_usedbuffdata = pdata->buffval;
+
+  if(put_ref != NULL)
+    if(put_ref(&pdata->buffval) != 0)
+      {
+        Open_Write_End(part);
+        return HASHTABLE_NOT_DELETED;
+      }
+
+  Open_Remove_Slot(part->array, idx);
+
+  part->nb_used -= 1;
+  ht->stat_dynamic[hashval].nb_entries -= 1;
+  ht->stat_dynamic[hashval].ok.nb_del += 1;
+
+  Open_Write_End(part);
+
+  return HASHTABLE_SUCCESS;
+}                               /* HashTable_Open_DelRef */
+
+/**
+ *
+ * HashTable_Open_Delall: HashTable_Delall for the open addressing engine.
+ *
+ */
+int HashTable_Open_Delall(hash_table_t * ht,
+                          int (*free_func)(hash_buffer_t, hash_buffer_t) )
+{
+  unsigned int hashval;
+  unsigned int i;
+  hash_partition_t *part;
+  hash_data_t data;
+
+  for(hashval = 0; hashval < ht->parameter.index_size; hashval++)
+    {
+      part = &ht->partitions[hashval];
+
+      Open_Write_Begin(part);
+
+      i = 0;
+      while(part->nb_used != 0 && i <= part->array->mask)
+        {
+          /* Removing a slot may shift another entry into it, so only move
+           * forward when the slot is empty */
+          if(part->array->slots[i].tag == 0)
+            {
+              i += 1;
+              continue;
+            }
+
+          data = part->array->slots[i].data;
+          Open_Remove_Slot(part->array, i);
+
+          part->nb_used -= 1;
+          ht->stat_dynamic[hashval].nb_entries -= 1;
+          ht->stat_dynamic[hashval].ok.nb_del += 1;
+
+          if(free_func(data.buffkey, data.buffval) == 0)
+            {
+              Open_Write_End(part);
+              return HASHTABLE_ERROR_DELALL_FAIL;
+            }
+        }
+
+      Open_Write_End(part);
+    }
+
+  return HASHTABLE_SUCCESS;
+}                               /* HashTable_Open_Delall */
+
+/**
+ *
+ * HashTable_Open_Dump: displays the entries of an open addressing table, for HashTable_Log and HashTable_Print.
+ *
+ * @param ht the hashtable to be used.
+ * @param component the component debugging config to use.
+ * @param to_stderr if TRUE, print on stderr instead of logging.
+ *
+ */
+void HashTable_Open_Dump(hash_table_t * ht, log_components_t component, int to_stderr)
+{
+  char dispkey[HASHTABLE_DISPLAY_STRLEN];
+  char dispval[HASHTABLE_DISPLAY_STRLEN];
+  hash_partition_t *part;
+  hash_slot_array_t *array;
+  unsigned int hashval;
+  unsigned int i;
+
+  for(hashval = 0; hashval < ht->parameter.index_size; hashval++)
+    {
+      part = &ht->partitions[hashval];
+
+      P(part->lock);
+
+      array = part->array;
+
+      if(to_stderr)
+        fprintf(stderr,
+                "The partition in position %u contains: %u entries in %u slots\n",
+                hashval, part->nb_used, array->mask + 1);
+      else
+        LogFullDebug(component,
+                     "The partition in position %u contains: %u entries in %u slots",
+                     hashval, part->nb_used, array->mask + 1);
+
+      for(i = 0; i <= array->mask; i++)
+        {
+          if(array->slots[i].tag == 0)
+            continue;
+
+          ht->parameter.key_to_str(&(array->slots[i].data.buffkey), dispkey);
+          ht->parameter.val_to_str(&(array->slots[i].data.buffval), dispval);
+
+          if(to_stderr)
+            fprintf(stderr, "%s => %s; slot=%u tag=%llx\n",
+                    dispkey, dispval, i, (unsigned long long)array->slots[i].tag);
+          else
+            LogFullDebug(component, "%s => %s; slot=%u tag=%llx",
+                         dispkey, dispval, i, (unsigned long long)array->slots[i].tag);
+        }
+
+      V(part->lock);
+    }
+}                               /* HashTable_Open_Dump */
+
+/* @} */
@@ -80,6 +80,7 @@
 #include <stdlib.h>
 #include <strings.h>
 #include <string.h>
+#include <pthread.h>
 #include "BuddyMalloc.h"
 #include "HashTable.h"
 #include "MesureTemps.h"
@@ -93,6 +94,10 @@
 #define CRITERE 12
 #define CRITERE_2 14
 
+#define BENCH_NB_THREADS 8
+#define BENCH_NB_KEYS   200000  /* Shared between the threads */
+#define BENCH_NB_GETS   4       /* Number of lookups of each key */
+
 int compare_string_buffer(hash_buffer_t * buff1, hash_buffer_t * buff2)
 {
   /* Test if one of teh entries are NULL */
@@ -117,11 +122,8 @@ unsigned long simple_hash_func(hash_parameter_t * p_hparam, hash_buffer_t * buff
 unsigned long double_hash_func(hash_parameter_t * p_hparam, hash_buffer_t * buffclef);
 unsigned long rbt_hash_func(hash_parameter_t * p_hparam, hash_buffer_t * buffclef);
 
-int main(int argc, char *argv[])
+static void test_engine(hash_engine_t engine)
 {
-  SetDefaultLogging("TEST");
-  SetNamePgm("test_cmchash");
-
   hash_table_t *ht = NULL;
   hash_parameter_t hparam;
   hash_buffer_t buffval;
@@ -147,8 +149,10 @@ int main(int argc, char *argv[])
   hparam.compare_key = compare_string_buffer;
   hparam.key_to_str = display_buff;
   hparam.val_to_str = display_buff;
+  hparam.name = "test";
+  hparam.engine = engine;
 
-  BuddyInit(NULL);
+  LogTest("=========== Engine %s ===========", HashTable_EngineToStr(engine));
 
   /* Init de la table */
   if((ht = HashTable_Init(hparam)) == NULL)
@@ -433,6 +437,186 @@ int main(int argc, char *argv[])
       exit(1);
     }
 
+  if(statistiques.dynamic.nb_entries != MAXTEST - MAXDESTROY - 1)
+    {
+      LogTest("Test FAILED: Incorrect statistics: nb_entries ");
+      exit(1);
+    }
+}                               /* test_engine */
+
+/* Throughput comparison of the engines: each thread inserts its share of the
+ * keys, then looks all the keys up, then removes its share */
+typedef struct bench_arg__
+{
+  hash_table_t *ht;
+  int first;
+  int last;
+  char (*keys)[10];
+  int failures;
+} bench_arg_t;
+
+static pthread_barrier_t bench_barrier;
+
+static void *bench_thread(void *arg)
+{
+  bench_arg_t *pbench = (bench_arg_t *) arg;
+  hash_buffer_t buffkey;
+  hash_buffer_t buffval;
+  int i, loop;
+
+  BuddyInit(NULL);
+
+  pthread_barrier_wait(&bench_barrier);
+  for(i = pbench->first; i < pbench->last; i++)
+    {
+      buffkey.pdata = pbench->keys[i];
+      buffkey.len = strlen(pbench->keys[i]);
+      buffval = buffkey;
+      if(HashTable_Test_And_Set(pbench->ht, &buffkey, &buffval,
+                                HASHTABLE_SET_HOW_SET_NO_OVERWRITE) != HASHTABLE_SUCCESS)
+        pbench->failures += 1;
+    }
+
+  pthread_barrier_wait(&bench_barrier);
+  pthread_barrier_wait(&bench_barrier);
+  for(loop = 0; loop < BENCH_NB_GETS; loop++)
+    for(i = 0; i < BENCH_NB_KEYS; i++)
+      {
+        /* Start at a different key in each thread */
+        int k = (i + pbench->first) % BENCH_NB_KEYS;
+
+        buffkey.pdata = pbench->keys[k];
+        buffkey.len = strlen(pbench->keys[k]);
+        if(HashTable_Get(pbench->ht, &buffkey, &buffval) != HASHTABLE_SUCCESS
+           || buffval.pdata != pbench->keys[k])
+          pbench->failures += 1;
+      }
+
+  pthread_barrier_wait(&bench_barrier);
+  pthread_barrier_wait(&bench_barrier);
+  for(i = pbench->first; i < pbench->last; i++)
+    {
+      buffkey.pdata = pbench->keys[i];
+      buffkey.len = strlen(pbench->keys[i]);
+      if(HashTable_Del(pbench->ht, &buffkey, NULL, NULL) != HASHTABLE_SUCCESS)
+        pbench->failures += 1;
+    }
+  pthread_barrier_wait(&bench_barrier);
+
+  return NULL;
+}                               /* bench_thread */
+
+static void bench_engine(hash_engine_t engine, char (*keys)[10])
+{
+  hash_parameter_t hparam;
+  hash_table_t *ht;
+  pthread_t threads[BENCH_NB_THREADS];
+  bench_arg_t args[BENCH_NB_THREADS];
+  struct Temps debut, fin;
+  int i;
+
+  memset(&hparam, 0, sizeof(hparam));
+  hparam.index_size = PRIME;
+  hparam.alphabet_length = 10;
+  hparam.nb_node_prealloc = NB_PREALLOC;
+  hparam.hash_func_key = simple_hash_func;
+  hparam.hash_func_rbt = rbt_hash_func;
+  hparam.compare_key = compare_string_buffer;
+  hparam.key_to_str = display_buff;
+  hparam.val_to_str = display_buff;
+  hparam.name = "bench";
+  hparam.engine = engine;
+
+  if((ht = HashTable_Init(hparam)) == NULL)
+    {
+      LogTest("Test FAILED: Bad init");
+      exit(1);
+    }
+
+  pthread_barrier_init(&bench_barrier, NULL, BENCH_NB_THREADS + 1);
+
+  for(i = 0; i < BENCH_NB_THREADS; i++)
+    {
+      args[i].ht = ht;
+      args[i].keys = keys;
+      args[i].first = i * (BENCH_NB_KEYS / BENCH_NB_THREADS);
+      args[i].last = (i + 1) * (BENCH_NB_KEYS / BENCH_NB_THREADS);
+      args[i].failures = 0;
+      pthread_create(&threads[i], NULL, bench_thread, &args[i]);
+    }
+
+  pthread_barrier_wait(&bench_barrier);
+  MesureTemps(&debut, NULL);
+  pthread_barrier_wait(&bench_barrier);
+  MesureTemps(&fin, &debut);
+  LogTest("%-16s %d threads: %d inserts in %s",
+          HashTable_EngineToStr(engine), BENCH_NB_THREADS, BENCH_NB_KEYS,
+          ConvertiTempsChaine(fin, NULL));
+
+  if(HashTable_GetSize(ht) != BENCH_NB_KEYS)
+    {
+      LogTest("Test FAILED: %u entries instead of %d", HashTable_GetSize(ht), BENCH_NB_KEYS);
+      exit(1);
+    }
+
+  pthread_barrier_wait(&bench_barrier);
+  MesureTemps(&debut, NULL);
+  pthread_barrier_wait(&bench_barrier);
+  MesureTemps(&fin, &debut);
+  LogTest("%-16s %d threads: %d lookups in %s",
+          HashTable_EngineToStr(engine), BENCH_NB_THREADS,
+          BENCH_NB_THREADS * BENCH_NB_GETS * BENCH_NB_KEYS,
+          ConvertiTempsChaine(fin, NULL));
+
+  pthread_barrier_wait(&bench_barrier);
+  MesureTemps(&debut, NULL);
+  pthread_barrier_wait(&bench_barrier);
+  MesureTemps(&fin, &debut);
+  LogTest("%-16s %d threads: %d deletes in %s",
+          HashTable_EngineToStr(engine), BENCH_NB_THREADS, BENCH_NB_KEYS,
+          ConvertiTempsChaine(fin, NULL));
+
+  for(i = 0; i < BENCH_NB_THREADS; i++)
+    {
+      pthread_join(threads[i], NULL);
+      if(args[i].failures != 0)
+        {
+          LogTest("Test FAILED: %d failed operations in thread %d", args[i].failures, i);
+          exit(1);
+        }
+    }
+
+  if(HashTable_GetSize(ht) != 0)
+    {
+      LogTest("Test FAILED: %u entries left after the deletes", HashTable_GetSize(ht));
+      exit(1);
+    }
+
+  pthread_barrier_destroy(&bench_barrier);
+}                               /* bench_engine */
+
+int main(int argc, char *argv[])
+{
+  static char keys[BENCH_NB_KEYS][10];
+  int i;
+
+  SetDefaultLogging("TEST");
+  SetNamePgm("test_cmchash");
+
+  BuddyInit(NULL);
+
+  test_engine(HASHTABLE_ENGINE_RBT);
+  test_engine(HASHTABLE_ENGINE_OPEN_ADDRESSING);
+
+  LogTest("-----------------------------------------");
+  LogTest("Throughput comparison of the engines");
+
+  for(i = 0; i < BENCH_NB_KEYS; i++)
+    sprintf(keys[i], "%d", i);
+
+  bench_engine(HASHTABLE_ENGINE_RBT, keys);
+  bench_engine(HASHTABLE_ENGINE_OPEN_ADDRESSING, keys);
+
   /* Tous les tests sont ok */
   BuddyDumpMem(stdout);
 
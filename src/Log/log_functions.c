@@ -44,6 +44,8 @@
 #include <string.h>
 #include <signal.h>
 #include <libgen.h>
+#include <sys/time.h>
+#include <sys/uio.h>
 
 #include "log_macros.h"
 //#include "nfs_core.h"
@@ -75,7 +77,7 @@ const char *fsal_function_names[] = {
   "FSAL_getattrs", "FSAL_setattrs", "FSAL_link", "FSAL_opendir", "FSAL_readdir",
   "FSAL_closedir", "FSAL_open", "FSAL_read", "FSAL_write", "FSAL_close",
   "FSAL_readlink", "FSAL_symlink", "FSAL_rename", "FSAL_unlink", "FSAL_mknode",
-  "FSAL_unused_20", "FSAL_dynamic_fsinfo", "FSAL_rcp", "FSAL_Init",
+  "FSAL_readdir_plus", "FSAL_dynamic_fsinfo", "FSAL_rcp", "FSAL_Init",
   "FSAL_get_stats", "FSAL_unused_25", "FSAL_unused_26", "FSAL_unused_27",
   "FSAL_BuildExportContext", "FSAL_InitClientContext", "FSAL_GetClientContext",
   "FSAL_lookupPath", "FSAL_lookupJunction", "FSAL_test_access",
@@ -83,7 +85,8 @@ const char *fsal_function_names[] = {
   "FSAL_ListXAttrs", "FSAL_GetXAttrValue", "FSAL_SetXAttrValue", "FSAL_GetXAttrAttrs",
   "FSAL_close_by_fileid", "FSAL_setattr_access", "FSAL_merge_attrs", "FSAL_rename_access",
   "FSAL_unlink_access", "FSAL_link_access", "FSAL_create_access", "FSAL_unused_49", "FSAL_CleanUpExportContext",
-  "FSAL_getextattrs", "FSAL_sync", "FSAL_lock_op", "FSAL_unused_58"
+  "FSAL_getextattrs", "FSAL_sync", "FSAL_getattrs_descriptor", "FSAL_lock_op",
+  "FSAL_UP_init", "FSAL_UP_addfilter", "FSAL_UP_getevents", "FSAL_unused_58"
 };
 
 /* les code d'error */
@@ -183,10 +186,38 @@ static int syslog_opened = 0 ;
  * Variables specifiques aux threads.
  */
 
+/*
+ * Ring of formatted messages used by asynchronous logging.
+ *
+ * There is one ring per thread: the owner thread is the only producer and the
+ * log writer the only consumer, so no lock is needed to fill or drain it.
+ * Records are a log_record_hdr_t followed by the text, padded to 4 bytes, and
+ * never wrap around the end of the buffer.
+ */
+typedef struct log_ring__
+{
+  char *buffer;
+  volatile unsigned long head;  /* bytes produced, written by the owner only */
+  volatile unsigned long tail;  /* bytes consumed, written by the writer only */
+  volatile int orphan;          /* the owner thread has exited */
+  struct log_ring__ *next;
+} log_ring_t;
+
+typedef struct log_record_hdr__
+{
+  unsigned short len;
+  unsigned short fileidx;
+} log_record_hdr_t;
+
+/* Record filling the end of the buffer when the next one doesn't fit */
+#define LOG_RECORD_PAD 0xFFFF
+#define LOG_RECORD_SIZE(len) ((sizeof(log_record_hdr_t) + (len) + 3) & ~3UL)
+
 typedef struct ThreadLogContext_t
 {
 
   char nom_fonction[STR_LEN];
+  log_ring_t *ring;
 
 } ThreadLogContext_t;
 
@@ -261,10 +292,22 @@ static struct tm *Localtime_r(const time_t * p_time, struct tm *p_tm)
 # define Localtime_r localtime_r
 #endif
 
+/* Called at thread exit: the ring is left to the log writer, which frees it
+ * once it has been drained */
+static void free_thread_context(void *arg)
+{
+  ThreadLogContext_t *context = (ThreadLogContext_t *) arg;
+
+  if(context->ring != NULL)
+    context->ring->orphan = 1;
+
+  free(context);
+}                               /* free_thread_context */
+
 /* Init of pthread_keys */
 static void init_keys(void)
 {
-  if(pthread_key_create(&thread_key, NULL) == -1)
+  if(pthread_key_create(&thread_key, free_thread_context) == -1)
     LogCrit(COMPONENT_LOG,
             "init_keys - pthread_key_create returned %d (%s)",
             errno, strerror(errno));
@@ -310,6 +353,7 @@ static ThreadLogContext_t *Log_GetThreadContext(int ok_errors)
 
       /* inits thread structures */
       p_current_thread_vars->nom_fonction[0] = '\0';
+      p_current_thread_vars->ring = NULL;
 
       /* set the specific value */
       pthread_setspecific(thread_key, (void *)p_current_thread_vars);
@@ -622,13 +666,444 @@ static int DisplayBuffer_valist(char *buffer, log_components_t component, char *
   return log_vsnprintf(buffer, STR_LEN_TXT, format, arguments);
 }
 
+/*
+ * Asynchronous logging
+ */
+
+typedef struct log_file__
+{
+  char path[MAXPATHLEN];
+  int fd;
+} log_file_t;
+
+static int log_async_active = 0;
+static pthread_t log_writer_thrid;
+
+/* Files written by the log writer, entries are never removed */
+static log_file_t log_files[LOG_MAX_FILES];
+static int log_nb_files = 0;
+static pthread_mutex_t log_files_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/* All the threads' rings */
+static log_ring_t *log_rings = NULL;
+static pthread_mutex_t log_rings_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/* Serializes the consumers of the rings (the writer, FlushLogs) */
+static pthread_mutex_t log_drain_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/* The writer sleeps on this condition between two drains */
+static pthread_mutex_t log_writer_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t log_writer_cond = PTHREAD_COND_INITIALIZER;
+static volatile int log_writer_waiting = 0;
+
+static volatile int log_reopen_requested = 0;
+static volatile unsigned long log_dropped = 0;
+
+/**
+ * log_get_fileidx: gets the index of a component's log file in log_files.
+ *
+ * The index is cached in the component, the table is only looked at the
+ * first time a file is used.
+ *
+ * @param component the component the message is logged for
+ *
+ * @return the index, or -1 if the table is full.
+ */
+static int log_get_fileidx(log_components_t component)
+{
+  int i;
+
+  if(LogComponents[component].comp_log_fileidx > 0)
+    return LogComponents[component].comp_log_fileidx - 1;
+
+  pthread_mutex_lock(&log_files_mutex);
+
+  for(i = 0; i < log_nb_files; i++)
+    if(!strcmp(log_files[i].path, LogComponents[component].comp_log_file))
+      break;
+
+  if(i == log_nb_files)
+    {
+      if(log_nb_files == LOG_MAX_FILES)
+        {
+          pthread_mutex_unlock(&log_files_mutex);
+          return -1;
+        }
+
+      strncpy(log_files[i].path, LogComponents[component].comp_log_file, MAXPATHLEN);
+      log_files[i].fd = -1;
+      log_nb_files += 1;
+    }
+
+  pthread_mutex_unlock(&log_files_mutex);
+
+  LogComponents[component].comp_log_fileidx = i + 1;
+
+  return i;
+}                               /* log_get_fileidx */
+
+/**
+ * log_get_ring: gets the ring of the current thread, allocating it the first time.
+ *
+ * @return the ring, or NULL if it could not be allocated.
+ */
+static log_ring_t *log_get_ring(void)
+{
+  ThreadLogContext_t *context = Log_GetThreadContext(0);
+  log_ring_t *ring;
+
+  if(context == NULL)
+    return NULL;
+
+  if(context->ring != NULL)
+    return context->ring;
+
+  if((ring = (log_ring_t *) malloc(sizeof(log_ring_t))) == NULL)
+    return NULL;
+
+  if((ring->buffer = (char *)malloc(LOG_RING_SIZE)) == NULL)
+    {
+      free(ring);
+      return NULL;
+    }
+
+  ring->head = 0;
+  ring->tail = 0;
+  ring->orphan = 0;
+
+  pthread_mutex_lock(&log_rings_mutex);
+  ring->next = log_rings;
+  log_rings = ring;
+  pthread_mutex_unlock(&log_rings_mutex);
+
+  context->ring = ring;
+
+  return ring;
+}                               /* log_get_ring */
+
+/**
+ * log_ring_push: queues a formatted message to the current thread's ring.
+ *
+ * @param ring the ring of the current thread
+ * @param fileidx index of the destination file in log_files
+ * @param text the message
+ * @param len length of the message
+ */
+static void log_ring_push(log_ring_t * ring, int fileidx, char *text, size_t len)
+{
+  unsigned long head = ring->head;
+  unsigned long offset = head % LOG_RING_SIZE;
+  unsigned long contig = LOG_RING_SIZE - offset;
+  unsigned long needed = LOG_RECORD_SIZE(len);
+  unsigned long used;
+  log_record_hdr_t *hdr;
+
+  if(contig < LOG_RECORD_SIZE(len))
+    needed += contig;
+
+  if(LOG_RING_SIZE - (head - ring->tail) < needed)
+    {
+      /* The writer is late, don't block the caller */
+      __sync_fetch_and_add(&log_dropped, 1);
+      return;
+    }
+
+  if(contig < LOG_RECORD_SIZE(len))
+    {
+      hdr = (log_record_hdr_t *) (ring->buffer + offset);
+      hdr->len = 0;
+      hdr->fileidx = LOG_RECORD_PAD;
+      head += contig;
+      offset = 0;
+    }
+
+  hdr = (log_record_hdr_t *) (ring->buffer + offset);
+  hdr->len = len;
+  hdr->fileidx = fileidx;
+  memcpy(ring->buffer + offset + sizeof(log_record_hdr_t), text, len);
+
+  /* The record must be complete before the writer can see it */
+  __sync_synchronize();
+  ring->head = head + LOG_RECORD_SIZE(len);
+
+  /* Don't wait for the next periodic drain when the ring fills up */
+  used = ring->head - ring->tail;
+  if(used > LOG_RING_SIZE / 2 && log_writer_waiting)
+    {
+      pthread_mutex_lock(&log_writer_mutex);
+      pthread_cond_signal(&log_writer_cond);
+      pthread_mutex_unlock(&log_writer_mutex);
+    }
+}                               /* log_ring_push */
+
+/* writev that does not give up on short writes */
+static void log_writev(int fileidx, struct iovec *iov, int iovcnt)
+{
+  log_file_t *file = &log_files[fileidx];
+  ssize_t written;
+
+  if(file->fd == -1)
+    {
+      file->fd = open(file->path, O_WRONLY | O_APPEND | O_CREAT, masque_log);
+      if(file->fd == -1)
+        {
+          fprintf(stderr, "Error %s : %s : status %d on file %s\n",
+                  tab_systeme_err[ERR_FICHIER_LOG].label,
+                  tab_systeme_err[ERR_FICHIER_LOG].msg, errno, file->path);
+          return;
+        }
+    }
+
+  while(iovcnt > 0)
+    {
+      written = writev(file->fd, iov, iovcnt);
+      if(written < 0)
+        {
+          if(errno == EINTR)
+            continue;
+          fprintf(stderr,
+                  "Error: couldn't complete write to the log file, ensure disk has not filled up");
+          return;
+        }
+
+      /* Skip what has been written */
+      while(iovcnt > 0 && written >= (ssize_t) iov->iov_len)
+        {
+          written -= iov->iov_len;
+          iov++;
+          iovcnt--;
+        }
+      if(iovcnt > 0)
+        {
+          iov->iov_base = (char *)iov->iov_base + written;
+          iov->iov_len -= written;
+        }
+    }
+}                               /* log_writev */
+
+#define LOG_IOV_MAX 64
+
+/**
+ * log_ring_drain: writes all the records of a ring to their files.
+ *
+ * Consecutive records for the same file are written with a single writev.
+ * Must be called with log_drain_mutex held.
+ *
+ * @param ring the ring to drain
+ */
+static void log_ring_drain(log_ring_t * ring)
+{
+  struct iovec iov[LOG_IOV_MAX];
+  int iovcnt = 0;
+  int fileidx = -1;
+  unsigned long head = ring->head;
+  unsigned long tail = ring->tail;
+  unsigned long offset;
+  log_record_hdr_t *hdr;
+
+  /* Don't read the records before head */
+  __sync_synchronize();
+
+  while(tail != head)
+    {
+      offset = tail % LOG_RING_SIZE;
+      hdr = (log_record_hdr_t *) (ring->buffer + offset);
+
+      if(hdr->fileidx == LOG_RECORD_PAD)
+        {
+          tail += LOG_RING_SIZE - offset;
+          continue;
+        }
+
+      if(iovcnt == LOG_IOV_MAX || (iovcnt > 0 && hdr->fileidx != fileidx))
+        {
+          log_writev(fileidx, iov, iovcnt);
+          iovcnt = 0;
+        }
+
+      fileidx = hdr->fileidx;
+      iov[iovcnt].iov_base = ring->buffer + offset + sizeof(log_record_hdr_t);
+      iov[iovcnt].iov_len = hdr->len;
+      iovcnt++;
+
+      tail += LOG_RECORD_SIZE(hdr->len);
+    }
+
+  if(iovcnt > 0)
+    log_writev(fileidx, iov, iovcnt);
+
+  /* The space can be reused once the records have been written */
+  __sync_synchronize();
+  ring->tail = tail;
+}                               /* log_ring_drain */
+
+/**
+ * FlushLogs: writes all the pending asynchronous messages.
+ *
+ * Called periodically by the log writer, and at exit.
+ */
+void FlushLogs(void)
+{
+  log_ring_t *ring;
+  log_ring_t **pprev;
+  int i;
+
+  if(!log_async_active)
+    return;
+
+  pthread_mutex_lock(&log_drain_mutex);
+
+  if(log_reopen_requested)
+    {
+      /* The files may have been moved away by logrotate */
+      log_reopen_requested = 0;
+      for(i = 0; i < log_nb_files; i++)
+        if(log_files[i].fd != -1)
+          {
+            close(log_files[i].fd);
+            log_files[i].fd = -1;
+          }
+    }
+
+  pthread_mutex_lock(&log_rings_mutex);
+
+  pprev = &log_rings;
+  while((ring = *pprev) != NULL)
+    {
+      log_ring_drain(ring);
+
+      /* The owner is gone and won't add anything */
+      if(ring->orphan && ring->head == ring->tail)
+        {
+          *pprev = ring->next;
+          free(ring->buffer);
+          free(ring);
+          continue;
+        }
+
+      pprev = &ring->next;
+    }
+
+  pthread_mutex_unlock(&log_rings_mutex);
+  pthread_mutex_unlock(&log_drain_mutex);
+}                               /* FlushLogs */
+
+/**
+ * ReopenLogFiles: makes the log writer reopen its files.
+ *
+ * To be called when the log files are rotated (SIGHUP).
+ */
+void ReopenLogFiles(void)
+{
+  log_reopen_requested = 1;
+}                               /* ReopenLogFiles */
+
+/**
+ * GetLogDropCount: number of messages dropped because a thread's ring was full.
+ */
+unsigned long GetLogDropCount(void)
+{
+  return log_dropped;
+}                               /* GetLogDropCount */
+
+static void *log_writer_thread(void *arg)
+{
+  struct timeval now;
+  struct timespec timeout;
+  unsigned long dropped;
+  unsigned long reported = 0;
+
+  SetNameFunction("log_writer");
+
+  while(1)
+    {
+      gettimeofday(&now, NULL);
+      timeout.tv_sec = now.tv_sec + LOG_FLUSH_DELAY / 1000;
+      timeout.tv_nsec = now.tv_usec * 1000 + (LOG_FLUSH_DELAY % 1000) * 1000000;
+      if(timeout.tv_nsec >= 1000000000)
+        {
+          timeout.tv_sec += 1;
+          timeout.tv_nsec -= 1000000000;
+        }
+
+      pthread_mutex_lock(&log_writer_mutex);
+      log_writer_waiting = 1;
+      pthread_cond_timedwait(&log_writer_cond, &log_writer_mutex, &timeout);
+      log_writer_waiting = 0;
+      pthread_mutex_unlock(&log_writer_mutex);
+
+      FlushLogs();
+
+      dropped = log_dropped;
+      if(dropped != reported)
+        {
+          LogWarn(COMPONENT_LOG,
+                  "%lu log messages were dropped because the log writer could not keep up (%lu since startup)",
+                  dropped - reported, dropped);
+          reported = dropped;
+        }
+    }
+
+  return NULL;
+}                               /* log_writer_thread */
+
+/**
+ * StartLogWriter: switches logging to files to asynchronous mode.
+ *
+ * Must be called after the process is daemonized, the writer thread would
+ * not survive a fork.
+ *
+ * @return 0 if successfull, -1 otherwise.
+ */
+int StartLogWriter(void)
+{
+  pthread_attr_t attr;
+  int rc;
+
+  if(log_async_active)
+    return 0;
+
+  pthread_attr_init(&attr);
+  pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+
+  if((rc = pthread_create(&log_writer_thrid, &attr, log_writer_thread, NULL)) != 0)
+    {
+      LogCrit(COMPONENT_LOG,
+              "Could not create the log writer thread, error %d (%s)",
+              rc, strerror(rc));
+      return -1;
+    }
+
+  log_async_active = 1;
+
+  /* Write what is still in the rings when the process exits */
+  atexit(FlushLogs);
+
+  LogEvent(COMPONENT_LOG, "Asynchronous logging to files started");
+
+  return 0;
+}                               /* StartLogWriter */
+
 static int DisplayLogPath_valist(char *path, char * function, log_components_t component, char *format, va_list arguments)
 {
   char tampon[STR_LEN_TXT];
   int fd, my_status;
+  int fileidx;
+  log_ring_t *ring;
 
   DisplayLogString_valist(tampon, function, component, format, arguments);
 
+  /* Messages about the logging itself are never delayed */
+  if(path[0] != '\0' && log_async_active && component != COMPONENT_LOG_EMERG)
+    {
+      if((fileidx = log_get_fileidx(component)) != -1 &&
+         (ring = log_get_ring()) != NULL)
+        {
+          log_ring_push(ring, fileidx, tampon, strlen(tampon));
+          return SUCCES;
+        }
+    }
+
   if(path[0] != '\0')
     {
 #ifdef _LOCK_LOG
@@ -1286,6 +1761,7 @@ int SetComponentLogFile(log_components_t component, char *name)
 
   LogComponents[component].comp_log_type = newtype;
   strncpy(LogComponents[component].comp_log_file, name, MAXPATHLEN);
+  LogComponents[component].comp_log_fileidx = 0;
 
   if (component == COMPONENT_LOG && changed)
     LogChanges("Changing log destination for %s from %s to %s",
@@ -0,0 +1,13 @@
+#!/bin/sh
+##
+## test_liblog_ASYNC.sh
+## test asynchronous logging to a file (multi-threaded)
+##
+
+FILE=/tmp/test_liblog.async.$$
+
+./test_liblog ASYNC $FILE
+RC=$?
+
+rm -f $FILE
+exit $RC
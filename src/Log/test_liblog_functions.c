@@ -35,6 +35,7 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <unistd.h>
 #include "log_macros.h"
 
 #ifndef TRUE
@@ -463,9 +464,80 @@ void *run_MT_Tests(void *arg)
   return NULL ;
 }
 
-static char usage[] = "usage:\n\ttest_liblog STD|MT\n";
-
 #define NB_THREADS 20
+#define NB_ASYNC_MESSAGES 1000
+
+void *run_ASYNC_Tests(void *arg)
+{
+  int i;
+
+  SetNameFunction((char *)arg);
+
+  for(i = 0; i < NB_ASYNC_MESSAGES; i++)
+    LogEvent(COMPONENT_DISPATCH, "async message %d", i);
+
+  return NULL;
+}
+
+/* Every message is either in the file or counted as dropped */
+int Test_ASYNC(char *file)
+{
+  pthread_t threads[NB_THREADS];
+  char thread_name[NB_THREADS][256];
+  char line[2048];
+  unsigned long found = 0;
+  unsigned long expected;
+  FILE *log_file;
+  int i;
+
+  unlink(file);
+  SetDefaultLogging(file);
+
+  if(StartLogWriter() != 0)
+    {
+      LogTest("FAILED: could not start the log writer");
+      return 1;
+    }
+
+  for(i = 0; i < NB_THREADS; i++)
+    {
+      snprintf(thread_name[i], 256, "thread %3d", i);
+      pthread_create(&threads[i], NULL, run_ASYNC_Tests, (void *)thread_name[i]);
+    }
+
+  for(i = 0; i < NB_THREADS; i++)
+    pthread_join(threads[i], NULL);
+
+  FlushLogs();
+
+  if((log_file = fopen(file, "r")) == NULL)
+    {
+      LogTest("FAILED: could not open %s", file);
+      return 1;
+    }
+
+  while(fgets(line, sizeof(line), log_file) != NULL)
+    if(strstr(line, "DISPATCH: EVENT: async message") != NULL)
+      found++;
+
+  fclose(log_file);
+
+  expected = NB_THREADS * NB_ASYNC_MESSAGES - GetLogDropCount();
+
+  SetDefaultLogging("STDOUT");
+
+  if(found != expected)
+    {
+      LogTest("FAILED: %lu messages in %s, %lu expected (%lu dropped)",
+              found, file, expected, GetLogDropCount());
+      return 1;
+    }
+
+  LogTest("PASSED: %lu messages written, %lu dropped", found, GetLogDropCount());
+  return 0;
+}
+
+static char usage[] = "usage:\n\ttest_liblog STD|MT|ASYNC\n";
 
 int main(int argc, char *argv[])
 {
@@ -549,6 +621,19 @@ int main(int argc, char *argv[])
 
         }
 
+      /* TEST asynchronous logging */
+
+      else if(!strcmp(argv[1], "ASYNC") && argc >= 3)
+        {
+          SetNamePgm("test_liblog");
+          SetNameHost("localhost");
+          SetNameFunction("async");
+          SetDefaultLogging("STDOUT");
+          InitLogging();
+
+          return Test_ASYNC(argv[2]);
+        }
+
       /* unknown test */
       else
         {
@@ -47,6 +47,7 @@
 #include <sys/file.h>           /* for having FNDELAY */
 #include <sys/select.h>
 #include <poll.h>
+#include <sys/epoll.h>
 #include "HashData.h"
 #include "HashTable.h"
 #include "log_macros.h"
@@ -72,225 +73,160 @@
 
 void DispatchWork9P( request_data_t *preq, unsigned int worker_index)
 {
-  LRU_entry_t *pentry = NULL;
-  LRU_status_t status;
-
   LogDebug(COMPONENT_DISPATCH,
            "Awaking Worker Thread #%u for 9P request %p, tcpsock=%lu",
            worker_index, preq, preq->rcontent._9p.pconn->sockfd);
 
-  P(workers_data[worker_index].request_mutex);
-  P(workers_data[worker_index].request_pool_mutex);
-
-  pentry = LRU_new_entry(workers_data[worker_index].pending_request, &status);
-
-  if(pentry == NULL)
-    {
-      V(workers_data[worker_index].request_pool_mutex);
-      V(workers_data[worker_index].request_mutex);
-      LogMajor(COMPONENT_DISPATCH,
-               "Error while inserting 9P pending request to Worker Thread #%u... Exiting",
-               worker_index);
-      Fatal();
-    }
-
-  pentry->buffdata.pdata = (caddr_t) preq;
-  pentry->buffdata.len = sizeof(*preq);
-
-  if(pthread_cond_signal(&(workers_data[worker_index].req_condvar)) == -1)
-    {
-      V(workers_data[worker_index].request_pool_mutex);
-      V(workers_data[worker_index].request_mutex);
-      LogMajor(COMPONENT_THREAD,
-               "Error %d (%s) while signalling Worker Thread #%u... Exiting",
-               errno, strerror(errno), worker_index);
-      Fatal();
-    }
-  V(workers_data[worker_index].request_pool_mutex);
-  V(workers_data[worker_index].request_mutex);
+  DispatchWork(preq, worker_index);
 }
 
+/* One epoll set per I/O thread, a connection is read by a single thread */
+static int _9p_epoll_fd[_9P_MAX_IO_THREADS];
 
 /**
- * Selects the smallest request queue,
- * whome the worker is ready and is not garbagging.
+ * _9p_conn_release: releases a reference on a 9P connection.
+ *
+ * The I/O thread holds a reference until the client disconnects, and every
+ * request holds one until its reply is sent. The last release closes the
+ * socket, so that its number can not be reused while a reply is pending.
+ *
+ * @param pconn the connection to release
+ *
+ * @return nothing (void function)
+ *
  */
-static unsigned int select_worker_queue()
+void _9p_conn_release( _9p_conn_t * pconn )
 {
-  #define NO_VALUE_CHOOSEN  1000000
-  unsigned int worker_index = NO_VALUE_CHOOSEN;
-  unsigned int avg_number_pending = NO_VALUE_CHOOSEN;
-  unsigned int total_number_pending = 0;
+  unsigned int i ;
 
-  static unsigned int counter;
+  if( __sync_sub_and_fetch( &pconn->refcount, 1 ) != 0 )
+    return ;
 
-  unsigned int i;
-  static unsigned int last;
-  unsigned int cpt = 0;
-  worker_available_rc rc;
+  LogDebug( COMPONENT_9P, "Closing 9p socket #%ld", pconn->sockfd ) ;
 
-  counter++;
+  /* The fids not clunked release their export */
+  for( i = 0 ; i < _9P_FID_PER_CONN ; i++ )
+    nfs_export_put( pconn->fids[i].pexport ) ;
 
-  /* Calculate the average queue length if counter is bigger than configured value. */
-  if(counter > nfs_param.core_param.nb_call_before_queue_avg)
-    {
-      for(i = 0; i < nfs_param.core_param.nb_worker; i++)
-        {
-          total_number_pending += workers_data[i].pending_request->nb_entry;
-        }
-      avg_number_pending = total_number_pending / nfs_param.core_param.nb_worker;
-      /* Reset counter. */
-      counter = 0;
-    }
-
-  /* Choose the queue whose length is smaller than average. */
-      for(i = (last + 1) % nfs_param.core_param.nb_worker, cpt = 0;
-          cpt < nfs_param.core_param.nb_worker;
-          cpt++, i = (i + 1) % nfs_param.core_param.nb_worker)
-        {
-          /* Choose only fully initialized workers and that does not gc. */
-          rc = worker_available(i, avg_number_pending);
-          if(rc == WORKER_AVAILABLE)
-            {
-              worker_index = i;
-              break;
-            }
-          else if(rc == WORKER_ALL_PAUSED)
-            {
-              /* Wait for the threads to awaken */
-              rc = wait_for_workers_to_awaken();
-              /*              if(rc == PAUSE_EXIT)
-                {
-                }
-              */
-            }
-          else if(rc == WORKER_EXIT)
-            {
-            } 
-        }
-
-  if(worker_index == NO_VALUE_CHOOSEN)
-    worker_index = (last + 1) % nfs_param.core_param.nb_worker;
-
-  last = worker_index;
-
-  return worker_index;
-
-}                               /* select_worker_queue */
+  close( pconn->sockfd ) ;
+  pthread_mutex_destroy( &pconn->lock ) ;
+  Mem_Free( pconn ) ;
+} /* _9p_conn_release */
 
 /**
- * _9p_socket_thread: 9p socket manager.
+ * _9p_conn_close: stops reading a 9P connection.
  *
- * This function is the main loop for the 9p socket manager. One such thread exists per connection.
+ * Called by the I/O thread when the client shuts down or sends garbage. A
+ * message partly read is dropped, the requests already handed to the workers
+ * are still processed.
  *
- * @param Arg the socket number cast as a void * in pthread_create
+ * @param pconn the connection to close
  *
- * @return NULL 
+ * @return nothing (void function)
  *
  */
-
-
-void * _9p_socket_thread( void * Arg )
+static void _9p_conn_close( _9p_conn_t * pconn )
 {
-  long int tcp_sock = (long int)Arg;
-  int rc = -1 ;
-  struct pollfd fds[1] ;
-  int fdcount = 1 ;
-  static char my_name[MAXNAMLEN];
-  struct sockaddr_in addrpeer ;
-  socklen_t addrpeerlen = sizeof( addrpeer ) ;
-  char strcaller[MAXNAMLEN] ;
-  request_data_t *preq = NULL;
-  unsigned int worker_index;
+  request_data_t *preq = pconn->preq ;
 
-  char * _9pmsg ;
-  uint32_t * p_9pmsglen = NULL ;
+  if( epoll_ctl( _9p_epoll_fd[pconn->io_thread], EPOLL_CTL_DEL, pconn->sockfd, NULL ) == -1 )
+    LogMajor( COMPONENT_9P,
+              "Cannot remove 9p socket #%ld from epoll set, error %d (%s)",
+              pconn->sockfd, errno, strerror( errno ) ) ;
 
-  _9p_conn_t _9p_conn ;
-
-  int readlen = 0  ;
+  if( preq != NULL )
+   {
+     P(workers_data[preq->pool_index].request_pool_mutex);
+     ReleaseToPool(preq, &workers_data[preq->pool_index].request_pool);
+     V(workers_data[preq->pool_index].request_pool_mutex);
+     pconn->preq = NULL ;
+   }
 
-  printf( "Je gre la socket %ld\n", tcp_sock );
+  _9p_conn_release( pconn ) ;
+} /* _9p_conn_close */
 
-  snprintf(my_name, MAXNAMLEN, "9p_sock_mgr#fd=%ld", tcp_sock);
-  SetNameFunction(my_name);
+/**
+ * _9p_conn_recv: non blocking read on a 9P connection.
+ *
+ * @param pconn  the connection to read
+ * @param buff   where to store the data
+ * @param len    the number of bytes wanted
+ *
+ * @return the number of bytes read, 0 if nothing is available yet, -1 if
+ *         the connection must be closed.
+ *
+ */
+static ssize_t _9p_conn_recv( _9p_conn_t * pconn, char * buff, u32 len )
+{
+  ssize_t readlen ;
 
-  /* Init the _9p_conn_t structure */
-  _9p_conn.sockfd = tcp_sock ;
- 
-  if( gettimeofday( &_9p_conn.birth, NULL ) == -1 )
-   LogFatal( COMPONENT_9P, "Can get connection's time of birth" ) ;
+  do
+    readlen = recv( pconn->sockfd, buff, len, 0 ) ;
+  while( readlen == -1 && errno == EINTR ) ;
 
-#ifndef _NO_BUDDY_SYSTEM
-  if((rc = BuddyInit(&nfs_param.buddy_param_tcp_mgr)) != BUDDY_SUCCESS)
-    {
-      /* Failed init */
-      #ifdef _DEBUG_MEMLEAKS
-      {
-        FILE *output = fopen("/tmp/buddymem", "w");
-        if (output != NULL)
-          BuddyDumpAll(output);
-      }
-      #endif
-      LogFatal(COMPONENT_DISPATCH, "Memory manager could not be initialized");
-    }
-#endif
+  if( readlen > 0 )
+    return readlen ;
 
-  if( ( rc =  getpeername( tcp_sock, (struct sockaddr *)&addrpeer, &addrpeerlen) ) == -1 )
+  if( readlen == 0 )
    {
-      LogMajor(COMPONENT_9P,
-               "Cannot get peername to tcp socket for 9p, error %d (%s)", errno, strerror(errno));
-      strncpy( strcaller, "(unresolved)", MAXNAMLEN ) ;
-   }
-  else
-   {
-     snprintf(strcaller, MAXNAMLEN, "0x%x=%d.%d.%d.%d",
-              ntohl(addrpeer.sin_addr.s_addr),
-             (ntohl(addrpeer.sin_addr.s_addr) & 0xFF000000) >> 24,
-             (ntohl(addrpeer.sin_addr.s_addr) & 0x00FF0000) >> 16,
-             (ntohl(addrpeer.sin_addr.s_addr) & 0x0000FF00) >> 8,
-             (ntohl(addrpeer.sin_addr.s_addr) & 0x000000FF));
-
-     LogEvent( COMPONENT_9P, "9p socket #%ld is connected to %s", tcp_sock, strcaller ) ; 
+     LogEvent( COMPONENT_9P, "Client on socket %ld has shut down", pconn->sockfd ) ;
+     return -1 ;
    }
 
-  /* Set up the structure used by poll */
-  memset( (char *)fds, 0, sizeof( struct pollfd ) ) ;
-  fds[0].fd = tcp_sock ;
-  fds[0].events = POLLIN|POLLPRI| POLLRDBAND|POLLRDNORM|POLLRDHUP|POLLHUP|POLLERR|POLLNVAL;
+  if( errno == EAGAIN || errno == EWOULDBLOCK )
+    return 0 ;
 
+  LogEvent( COMPONENT_9P, "Error %d (%s) while reading 9p socket %ld",
+            errno, strerror( errno ), pconn->sockfd ) ;
+  return -1 ;
+} /* _9p_conn_recv */
 
-  for( ;; ) /* Infinite loop */
+/**
+ * _9p_conn_read: reads the messages available on a 9P connection.
+ *
+ * The header is read into the connection, then the body straight into a
+ * request taken from the pool of the worker that will process it, so an idle
+ * connection holds no request. Complete messages are dispatched as soon as
+ * they are read.
+ *
+ * @param pconn the connection to read
+ *
+ * @return 0 if successful, -1 if the connection must be closed.
+ *
+ */
+static int _9p_conn_read( _9p_conn_t * pconn )
+{
+  request_data_t *preq = NULL ;
+  unsigned int worker_index ;
+  unsigned int nb_msg = 0 ;
+  ssize_t readlen ;
+  u32 msglen ;
+
+  while( nb_msg < _9P_MAX_MSG_PER_EVENT )
    {
-    
-     if( ( rc = poll( fds, fdcount, -1 ) ) == -1 ) /* timeout = -1 =>Wait indefinitely for incoming events */
+     if( pconn->preq == NULL )
       {
-         /* Interruption if not an issue */
-         if( errno == EINTR )
-           continue ;
+        /* An incoming 9P request: the msg has a 4 bytes header showing the size of the msg including the header */
+        readlen = _9p_conn_recv( pconn, pconn->hdr + pconn->hdr_len, _9P_HDR_SIZE - pconn->hdr_len ) ;
+        if( readlen <= 0 )
+          return readlen ;
 
-         LogCrit( COMPONENT_9P,
-                  "Got error %u (%s) on fd %ld connect to %s while polling on socket", 
-                  errno, strerror( errno ), tcp_sock, strcaller ) ;
+        pconn->hdr_len += readlen ;
+        if( pconn->hdr_len < _9P_HDR_SIZE )
+          continue ;
 
-      }
+        memcpy( &msglen, pconn->hdr, _9P_HDR_SIZE ) ;
 
-     if( fds[0].revents & POLLNVAL )
-      {
-        LogEvent( COMPONENT_9P, "Client %s on socket %lu produced POLLNVAL", strcaller, tcp_sock ) ;
-                  close( tcp_sock );
-        return NULL ;
-      }
+        LogFullDebug( COMPONENT_9P, "Received message of size %u on socket %ld",
+                      msglen, pconn->sockfd ) ;
 
-     if( fds[0].revents & (POLLERR|POLLHUP|POLLRDHUP) )
-      {
-        LogEvent( COMPONENT_9P, "Client %s on socket %lu has shut down and closed", strcaller, tcp_sock ) ;
-                  close( tcp_sock );
-        return NULL ;
-      }
+        if( msglen < _9P_HDR_SIZE + _9P_TYPE_SIZE + _9P_TAG_SIZE || msglen > _9P_MSG_SIZE )
+         {
+           LogEvent( COMPONENT_9P, "Badly formed 9P message of size %u on socket %ld",
+                     msglen, pconn->sockfd ) ;
+           return -1 ;
+         }
 
-     if( fds[0].revents & (POLLIN|POLLRDNORM) )
-      {
         /* choose a worker depending on its queue length */
         worker_index = select_worker_queue();
 
@@ -302,60 +238,168 @@ void * _9p_socket_thread( void * Arg )
 
         V(workers_data[worker_index].request_pool_mutex);
 
-        /* Prepare to read the message */
-        preq->rtype = _9P_REQUEST ;
-        _9pmsg = preq->rcontent._9p._9pmsg ;
-        preq->rcontent._9p.pconn = &_9p_conn ;
-
-        /* An incoming 9P request: the msg has a 4 bytes header showing the size of the msg including the header */
-        if( (readlen = recv( fds[0].fd, _9pmsg ,_9P_HDR_SIZE, 0) == _9P_HDR_SIZE ) )
+        if( preq == NULL )
          {
-	    p_9pmsglen = (uint32_t *)_9pmsg ;
-
-            LogFullDebug( COMPONENT_9P,
-                          "Received message of size %u from client %s on socket %lu",
-			   *p_9pmsglen, strcaller, tcp_sock ) ;
-
-	     if( ( *p_9pmsglen < _9P_HDR_SIZE ) ||
-		 ( readlen = recv( fds[0].fd,
-				   (char *)(_9pmsg + _9P_HDR_SIZE),  
-                                    *p_9pmsglen - _9P_HDR_SIZE, 0 ) ) !=  *p_9pmsglen - _9P_HDR_SIZE )
-                 
-             {
-		LogEvent( COMPONENT_9P, 
-			  "Badly formed 9P message: Header is too small for client %s on socket %lu", 
-                          strcaller, tcp_sock ) ;
-
-                /* Release the entry */
-                P(workers_data[worker_index].request_pool_mutex);
-                ReleaseToPool(preq, &workers_data[worker_index].request_pool);
-  		workers_data[worker_index].passcounter += 1;
-                V(workers_data[worker_index].request_pool_mutex);
-
-                continue ;
-             }
-	    else
-             {
-		/* Message os OK push it the request to the right worker */
-                DispatchWork9P(preq, worker_index);
-             }
+           LogMajor( COMPONENT_9P, "Cannot allocate a request for socket %ld", pconn->sockfd ) ;
+           return -1 ;
          }
-        else if( readlen == 0 )
+
+        preq->rtype = _9P_REQUEST ;
+        preq->pool_index = worker_index ;
+        preq->rcontent._9p.pconn = pconn ;
+        memcpy( preq->rcontent._9p._9pmsg, pconn->hdr, _9P_HDR_SIZE ) ;
+
+        pconn->preq = preq ;
+        pconn->msg_len = msglen ;
+        pconn->read_len = _9P_HDR_SIZE ;
+        pconn->hdr_len = 0 ;
+      }
+
+     preq = pconn->preq ;
+     readlen = _9p_conn_recv( pconn, preq->rcontent._9p._9pmsg + pconn->read_len,
+                              pconn->msg_len - pconn->read_len ) ;
+     if( readlen <= 0 )
+       return readlen ;
+
+     pconn->read_len += readlen ;
+     if( pconn->read_len < pconn->msg_len )
+       continue ;
+
+     /* Message is OK push it the request to the right worker, which releases the connection when done */
+     pconn->preq = NULL ;
+     __sync_fetch_and_add( &pconn->refcount, 1 ) ;
+     DispatchWork9P( preq, preq->pool_index ) ;
+     nb_msg += 1 ;
+   }
+
+  return 0 ;
+} /* _9p_conn_read */
+
+/**
+ * _9p_io_thread: 9p I/O thread.
+ *
+ * This function is the main loop of a 9p I/O thread. It waits for the
+ * connections it owns to be readable and reads the messages they carry,
+ * without ever blocking on a single client.
+ *
+ * @param Arg the index of the thread cast as a void * in pthread_create
+ *
+ * @return NULL
+ *
+ */
+void * _9p_io_thread( void * Arg )
+{
+  unsigned long index = (unsigned long)Arg ;
+  struct epoll_event events[_9P_EPOLL_MAX_EVENTS] ;
+  char my_name[MAXNAMLEN] ;
+  _9p_conn_t * pconn ;
+  int rc ;
+  int i ;
+
+  snprintf( my_name, MAXNAMLEN, "9p_io_thr#%lu", index ) ;
+  SetNameFunction( my_name ) ;
+
+#ifndef _NO_BUDDY_SYSTEM
+  if((rc = BuddyInit(&nfs_param.buddy_param_tcp_mgr)) != BUDDY_SUCCESS)
+    LogFatal(COMPONENT_9P_DISPATCH, "Memory manager could not be initialized");
+#endif
+
+  for( ;; ) /* Infinite loop */
+   {
+     if( ( rc = epoll_wait( _9p_epoll_fd[index], events, _9P_EPOLL_MAX_EVENTS, -1 ) ) == -1 )
+      {
+        /* Interruption if not an issue */
+        if( errno != EINTR )
+          LogCrit( COMPONENT_9P_DISPATCH,
+                   "Got error %u (%s) while waiting on 9p sockets", errno, strerror( errno ) ) ;
+        continue ;
+      }
+
+     for( i = 0 ; i < rc ; i++ )
+      {
+        pconn = (_9p_conn_t *)events[i].data.ptr ;
+
+        /* Read what is left before handling a hang up */
+        if( events[i].events & EPOLLIN )
          {
-           LogEvent( COMPONENT_9P, "Client %s on socket %lu has shut down", strcaller, tcp_sock ) ;
-           close( tcp_sock );
-           return NULL ;
+           if( _9p_conn_read( pconn ) != 0 )
+             _9p_conn_close( pconn ) ;
          }
-        else
+        else if( events[i].events & (EPOLLERR|EPOLLHUP|EPOLLRDHUP) )
          {
-	   LogEvent( COMPONENT_9P, "Badly formed 9P header for client %s on socket %lu", strcaller, tcp_sock ) ;
-           continue ;
+           LogEvent( COMPONENT_9P, "Client on socket %ld has shut down and closed", pconn->sockfd ) ;
+           _9p_conn_close( pconn ) ;
          }
       }
-   } /* for( ;; ) */
- 
+   }
+
   return NULL ;
-} /* _9p_socket_thread */
+} /* _9p_io_thread */
+
+/**
+ * _9p_conn_create: sets up a newly accepted 9P connection.
+ *
+ * The socket is made non blocking and given to the I/O threads in turn.
+ *
+ * @param sock the accepted socket
+ * @param paddr the address of the client
+ *
+ * @return nothing (void function)
+ *
+ */
+static void _9p_conn_create( long int sock, struct sockaddr_in * paddr )
+{
+  static unsigned int next_io_thread = 0 ;
+  struct epoll_event ev ;
+  _9p_conn_t * pconn ;
+  int flags ;
+
+  if( ( flags = fcntl( sock, F_GETFL, 0 ) ) == -1 ||
+      fcntl( sock, F_SETFL, flags | O_NONBLOCK ) == -1 )
+   {
+     LogMajor( COMPONENT_9P_DISPATCH,
+               "Cannot make 9p socket #%ld non blocking, error %d (%s)",
+               sock, errno, strerror( errno ) ) ;
+     close( sock ) ;
+     return ;
+   }
+
+  if( ( pconn = (_9p_conn_t *)Mem_Alloc_Label( sizeof( _9p_conn_t ), "_9p_conn_t" ) ) == NULL )
+   {
+     LogMajor( COMPONENT_9P_DISPATCH, "Cannot allocate connection for 9p socket #%ld", sock ) ;
+     close( sock ) ;
+     return ;
+   }
+
+  memset( (char *)pconn, 0, sizeof( _9p_conn_t ) ) ;
+  pconn->sockfd = sock ;
+  pconn->refcount = 1 ;
+  pthread_mutex_init( &pconn->lock, NULL ) ;
+
+  if( gettimeofday( &pconn->birth, NULL ) == -1 )
+   LogFatal( COMPONENT_9P, "Can get connection's time of birth" ) ;
+
+  LogEvent( COMPONENT_9P, "9p socket #%ld is connected to %d.%d.%d.%d", sock,
+            (ntohl(paddr->sin_addr.s_addr) & 0xFF000000) >> 24,
+            (ntohl(paddr->sin_addr.s_addr) & 0x00FF0000) >> 16,
+            (ntohl(paddr->sin_addr.s_addr) & 0x0000FF00) >> 8,
+            (ntohl(paddr->sin_addr.s_addr) & 0x000000FF));
+
+  pconn->io_thread = next_io_thread ;
+  next_io_thread = ( next_io_thread + 1 ) % nfs_param._9p_param.nb_io_threads ;
+
+  memset( &ev, 0, sizeof( ev ) ) ;
+  ev.events = EPOLLIN|EPOLLRDHUP ;
+  ev.data.ptr = pconn ;
+
+  if( epoll_ctl( _9p_epoll_fd[pconn->io_thread], EPOLL_CTL_ADD, sock, &ev ) == -1 )
+   {
+     LogMajor( COMPONENT_9P_DISPATCH,
+               "Cannot add 9p socket #%ld to epoll set, error %d (%s)",
+               sock, errno, strerror( errno ) ) ;
+     _9p_conn_release( pconn ) ;
+   }
+} /* _9p_conn_create */
 
 /**
  * _9p_create_socket: create the accept socket for 9P 
@@ -477,7 +521,8 @@ void _9p_dispatcher_svc_run( long int sock )
   socklen_t addrlen = sizeof( addr ) ;
   long int newsock = -1 ;
   pthread_attr_t attr_thr;
-  pthread_t tcp_thrid ;
+  pthread_t io_thrid ;
+  unsigned long i ;
 
 #ifdef _DEBUG_MEMLEAKS
   static int nb_iter_memleaks = 0;
@@ -496,23 +541,33 @@ void _9p_dispatcher_svc_run( long int sock )
   if(pthread_attr_setstacksize(&attr_thr, THREAD_STACK_SIZE) != 0)
     LogDebug(COMPONENT_9P_DISPATCH, "can't set pthread's stack size");
 
+  /* Starting the I/O threads, each with its own epoll set */
+  for( i = 0 ; i < nfs_param._9p_param.nb_io_threads ; i++ )
+   {
+     if( ( _9p_epoll_fd[i] = epoll_create( _9P_EPOLL_MAX_EVENTS ) ) == -1 )
+       LogFatal(COMPONENT_9P_DISPATCH,
+                "Cannot create epoll set for 9p I/O thread #%lu, error %d (%s)",
+                i, errno, strerror(errno));
+
+     if( ( rc = pthread_create( &io_thrid, &attr_thr, _9p_io_thread, (void *)i ) ) != 0 )
+       LogFatal(COMPONENT_THREAD,
+                "Could not create 9p I/O thread, error = %d (%s)",
+                rc, strerror(rc));
+   }
 
-  LogEvent( COMPONENT_9P_DISPATCH, "9P dispatcher started" ) ;
+  LogEvent( COMPONENT_9P_DISPATCH, "9P dispatcher started with %u I/O threads",
+            nfs_param._9p_param.nb_io_threads ) ;
   while(TRUE)
     {
+      addrlen = sizeof( addr ) ;
       if( ( newsock = accept( sock, (struct sockaddr *)&addr, &addrlen ) ) < 0 )
        {
-	 LogCrit( COMPONENT_9P_DISPATCH, "accept failed" ) ;
+         if( errno != EINTR )
+	   LogCrit( COMPONENT_9P_DISPATCH, "accept failed, error %d (%s)", errno, strerror(errno) ) ;
 	 continue ; 
        }
 
-      /* Starting the thread dedicated to signal handling */
-      if( ( rc = pthread_create( &tcp_thrid, &attr_thr, _9p_socket_thread, (void *)newsock ) ) != 0 )
-       {
-         LogFatal(COMPONENT_THREAD,
-                  "Could not create 9p socket manager thread, error = %d (%s)",
-                  errno, strerror(errno));
-       }
+      _9p_conn_create( newsock, &addr ) ;
 
 #ifdef _DEBUG_MEMLEAKS
       if(nb_iter_memleaks > 1000)
@@ -46,6 +46,7 @@
 #include <stdio.h>
 #include <string.h>
 #include <pthread.h>
+#include <unistd.h>
 #include "nfs_core.h"
 #include "stuff_alloc.h"
 #include "log_macros.h"
@@ -72,7 +73,6 @@ void admin_replace_exports()
   V(mutex_admin_condvar);
 }
 
-/* Skips deleting first entry of export list. */
 int rebuild_export_list()
 {
   int status = 0;
@@ -124,37 +124,244 @@ int rebuild_export_list()
   return 1;
 }
 
-static void ChangeoverExports()
+/* Export epoch, bumped each time a new export list is published */
+static volatile unsigned int export_epoch = 1;
+
+/* Threads other than the workers that walk the export list */
+static nfs_export_reader_t *export_readers = NULL;
+static pthread_mutex_t export_readers_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/* Removed exports still held, by the admin thread only */
+static exportlist_t *retired_exports = NULL;
+
+/**
+ *
+ * nfs_export_epoch_enter: marks the start of a request for a worker.
+ *
+ * The export list (and its index) read during the request stay valid until
+ * nfs_export_epoch_exit is called, even if the exports are reloaded meanwhile.
+ *
+ * @param pworker [INOUT] the worker
+ *
+ * @return nothing (void function)
+ *
+ */
+void nfs_export_epoch_enter(nfs_worker_data_t * pworker)
+{
+  pworker->export_epoch = export_epoch;
+
+  /* The epoch must be visible before the export list is read */
+  __sync_synchronize();
+}                               /* nfs_export_epoch_enter */
+
+/**
+ *
+ * nfs_export_epoch_exit: marks the end of a request for a worker.
+ *
+ * @param pworker [INOUT] the worker
+ *
+ * @return nothing (void function)
+ *
+ */
+void nfs_export_epoch_exit(nfs_worker_data_t * pworker)
+{
+  __sync_synchronize();
+  pworker->export_epoch = 0;
+}                               /* nfs_export_epoch_exit */
+
+/**
+ *
+ * nfs_export_reader_register: makes a thread take part in the grace period
+ * of the export reloads.
+ *
+ * @param preader [INOUT] the state of the thread, kept as long as it runs
+ *
+ * @return nothing (void function)
+ *
+ */
+void nfs_export_reader_register(nfs_export_reader_t * preader)
+{
+  preader->export_epoch = 0;
+
+  P(export_readers_mutex);
+  preader->next = export_readers;
+  export_readers = preader;
+  V(export_readers_mutex);
+}                               /* nfs_export_reader_register */
+
+/**
+ *
+ * nfs_export_reader_unregister: removes a thread that stops from the grace
+ * period of the export reloads.
+ *
+ * @param preader [INOUT] the state of the thread
+ *
+ * @return nothing (void function)
+ *
+ */
+void nfs_export_reader_unregister(nfs_export_reader_t * preader)
+{
+  nfs_export_reader_t **ppreader;
+
+  P(export_readers_mutex);
+  for(ppreader = &export_readers; *ppreader != NULL; ppreader = &(*ppreader)->next)
+    if(*ppreader == preader)
+      {
+        *ppreader = preader->next;
+        break;
+      }
+  V(export_readers_mutex);
+}                               /* nfs_export_reader_unregister */
+
+/**
+ *
+ * nfs_export_reader_enter: marks the start of a walk of the export list.
+ *
+ * Same as nfs_export_epoch_enter, for a registered thread.
+ *
+ * @param preader [INOUT] the state of the thread
+ *
+ * @return nothing (void function)
+ *
+ */
+void nfs_export_reader_enter(nfs_export_reader_t * preader)
+{
+  preader->export_epoch = export_epoch;
+  __sync_synchronize();
+}                               /* nfs_export_reader_enter */
+
+/**
+ *
+ * nfs_export_reader_exit: marks the end of a walk of the export list.
+ *
+ * @param preader [INOUT] the state of the thread
+ *
+ * @return nothing (void function)
+ *
+ */
+void nfs_export_reader_exit(nfs_export_reader_t * preader)
+{
+  __sync_synchronize();
+  preader->export_epoch = 0;
+}                               /* nfs_export_reader_exit */
+
+/**
+ *
+ * WaitExportGracePeriod: waits for the requests started before an epoch.
+ *
+ * Only the requests and the walks still running on the previous export list
+ * are waited for, the workers keep on serving new requests with the new one.
+ *
+ * @param epoch [IN] the epoch the new export list was published with
+ *
+ * @return nothing (void function)
+ *
+ */
+static void WaitExportGracePeriod(unsigned int epoch)
+{
+  nfs_export_reader_t *preader;
+  unsigned int i;
+  unsigned int worker_epoch;
+
+  for(i = 0; i < nfs_param.core_param.nb_worker; i++)
+    while(1)
+      {
+        worker_epoch = workers_data[i].export_epoch;
+        if(worker_epoch == 0 || (int)(worker_epoch - epoch) >= 0)
+          break;
+        usleep(1000);
+      }
+
+  P(export_readers_mutex);
+  for(preader = export_readers; preader != NULL; preader = preader->next)
+    while(1)
+      {
+        worker_epoch = preader->export_epoch;
+        if(worker_epoch == 0 || (int)(worker_epoch - epoch) >= 0)
+          break;
+        usleep(1000);
+      }
+  V(export_readers_mutex);
+}                               /* WaitExportGracePeriod */
+
+/**
+ *
+ * RetireExports: frees the exports of a previous list, or keeps them aside
+ * while they are held.
+ *
+ * The exports kept by a previous reload are freed as well once their last
+ * holder released them.
+ *
+ * @param pold [IN] the previous list, no request or walk may use it anymore
+ *
+ * @return nothing (void function)
+ *
+ */
+static void RetireExports(exportlist_t * pold)
 {
   exportlist_t *pcurrent;
+  exportlist_t *pnext;
+  exportlist_t *pheld = NULL;
 
-  /* Now we know that the configuration was parsed successfully.
-   * And that worker threads are no longer accessing the export list.
-   * Remove all but the first export entry in the exports list.
-   */
-  pcurrent = nfs_param.pexportlist->next;
+  /* The exports left by the previous reloads come first */
+  for(pcurrent = retired_exports; pcurrent != NULL && pcurrent->next != NULL;
+      pcurrent = pcurrent->next) ;
+  if(pcurrent != NULL)
+    pcurrent->next = pold;
+  else
+    retired_exports = pold;
 
-  while(pcurrent != NULL)
+  for(pcurrent = retired_exports; pcurrent != NULL; pcurrent = pnext)
     {
-      /* Leave the head so that the list may be replaced later without
-       * changing the reference pointer in worker threads. */
-      CleanUpExportContext(&pcurrent->FS_export_context);
+      pnext = pcurrent->next;
 
-      if (pcurrent == nfs_param.pexportlist)
-        break;
+      if(__sync_fetch_and_add(&pcurrent->refcount, 0) != 0)
+        {
+          LogDebug(COMPONENT_MAIN,
+                   "replace_exports: Export Entry #%u removed but still held",
+                   pcurrent->id);
+          pcurrent->next = pheld;
+          pheld = pcurrent;
+          continue;
+        }
 
-      nfs_param.pexportlist->next = RemoveExportEntry(pcurrent);
-      pcurrent = nfs_param.pexportlist->next;
+      CleanUpExportContext(&pcurrent->FS_export_context);
+      RemoveExportEntry(pcurrent);
     }
 
-  /* Changed the old export list head to the new export list head.
-   * All references to the exports list should be up-to-date now. */
-  memcpy(nfs_param.pexportlist, temp_pexportlist, sizeof(exportlist_t));
+  retired_exports = pheld;
+}                               /* RetireExports */
+
+static void ChangeoverExports()
+{
+  exportlist_t *pold;
+  export_index_t *pold_index = NULL;
+  unsigned int epoch;
+
+  /* Now we know that the configuration was parsed successfully.
+   * Publish the new list and its index: requests starting from now on use
+   * them, while requests in progress finish with the previous ones.
+   */
+  if(!nfs_export_index_publish(temp_pexportlist, &pold_index))
+    LogCrit(COMPONENT_MAIN,
+            "replace_exports: Error indexing the new export list, lookups will walk the list");
 
-  /* We no longer need the head that was created for
-   * the new list since the export list is built as a linked list. */
-  Mem_Free(temp_pexportlist);
+  pold = __sync_lock_test_and_set(&nfs_param.pexportlist, temp_pexportlist);
   temp_pexportlist = NULL;
+
+  epoch = __sync_add_and_fetch(&export_epoch, 1);
+  if(epoch == 0)
+    epoch = __sync_add_and_fetch(&export_epoch, 1);
+
+  /* Reclaim the previous list once no request may still be using it */
+  WaitExportGracePeriod(epoch);
+
+  nfs_export_index_free(pold_index);
+
+  /* The prefetches queued by these requests use the context of their export */
+  cache_inode_readahead_drain();
+
+  RetireExports(pold);
 }
 
 void *admin_thread(void *Arg)
@@ -191,16 +398,6 @@ void *admin_thread(void *Arg)
           continue;
         }
 
-      if(pause_workers(PAUSE_RELOAD_EXPORTS) == PAUSE_EXIT)
-        {
-          LogDebug(COMPONENT_MAIN,
-                   "Export reload interrupted by shutdown while pausing workers");
-          /* Be helpfull and exit
-           * (other termination will just blow us away, and that's ok...
-           */
-          break;
-        }
-
       /* Clear the id mapping cache for gss principals to uid/gid.
        * The id mapping may have changed.
        */
@@ -216,19 +413,6 @@ void *admin_thread(void *Arg)
 
       LogEvent(COMPONENT_MAIN,
                "Exports reloaded and active");
-
-      /* wake_workers could return PAUSE_PAUSE, but we don't have to do
-       * anything special in that case.
-       */
-      if(wake_workers(AWAKEN_RELOAD_EXPORTS) == PAUSE_EXIT)
-        {
-          LogDebug(COMPONENT_MAIN,
-                   "Export reload interrupted by shutdown while waking workers");
-          /* Be helpfull and exit
-           * (other termination will just blow us away, and that's ok...
-           */
-          break;
-        }
     }
 
   return NULL;
@@ -0,0 +1,118 @@
+/*
+ * vim:expandtab:shiftwidth=8:tabstop=8:
+ *
+ * Copyright CEA/DAM/DIF  (2008)
+ * contributeur : Philippe DENIEL   philippe.deniel@cea.fr
+ *                Thomas LEIBOVICI  thomas.leibovici@cea.fr
+ *
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * ---------------------------------------
+ */
+
+/**
+ * \file    nfs_cache_inode_reaper_thread.c
+ * \brief   The file that contain the 'cache_inode_reaper_thread' routine for the nfsd.
+ *
+ * nfs_cache_inode_reaper_thread.c : garbage collection of the cache_inode
+ * entries. The thread sleeps until the global LRU grows above the high water
+ * mark (or the gc run interval elapses) and then garbages the oldest entries
+ * until the low water mark is reached. The workers do no more cache_inode gc
+ * by themselves.
+ *
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#ifdef _SOLARIS
+#include "solaris_port.h"
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include "HashData.h"
+#include "HashTable.h"
+#include "log_macros.h"
+#include "stuff_alloc.h"
+#include "nfs_core.h"
+#include "cache_inode.h"
+
+/* The reaper's own cache_inode client, its pools get the garbaged entries */
+static cache_inode_client_t reaper_cache_inode_client;
+
+/**
+ * cache_inode_reaper_thread: the cache_inode garbage collector.
+ *
+ * @param arg [IN] the cache_inode hash table.
+ *
+ * @return never returns.
+ *
+ */
+void *cache_inode_reaper_thread(void *arg)
+{
+  hash_table_t *ht = (hash_table_t *) arg;
+  cache_inode_gc_policy_t gcpol;
+  cache_inode_status_t cache_status;
+#ifndef _NO_BUDDY_SYSTEM
+  int rc;
+#endif
+
+  SetNameFunction("cache_inode_reaper");
+
+  LogEvent(COMPONENT_CACHE_INODE_GC,
+           "NFS CACHE INODE REAPER : Starting, my pthread id is %p",
+           (caddr_t) pthread_self());
+
+#ifndef _NO_BUDDY_SYSTEM
+  if((rc = BuddyInit(&nfs_param.buddy_param_worker)) != BUDDY_SUCCESS)
+    {
+      /* Failed init */
+      LogFatal(COMPONENT_CACHE_INODE_GC,
+               "NFS CACHE INODE REAPER : Memory manager could not be initialized");
+    }
+#endif
+
+  if(cache_inode_client_init(&reaper_cache_inode_client,
+                             nfs_param.cache_layers_param.cache_inode_client_param,
+                             REAPER_THREAD_INDEX, NULL))
+    {
+      LogFatal(COMPONENT_CACHE_INODE_GC,
+               "NFS CACHE INODE REAPER : Cache Inode client could not be initialized");
+    }
+
+  /* Entries garbaged from now on are reused by the workers */
+  cache_inode_lru_set_recycle_client(&reaper_cache_inode_client);
+
+  while(1)
+    {
+      gcpol = cache_inode_get_gc_policy();
+
+      /* Sleep until the cache grows too large or the run interval elapsed */
+      cache_inode_lru_wait_reaper(gcpol.hwmark_nb_entries,
+                                  gcpol.run_interval > 0 ? gcpol.run_interval : 1);
+
+      if(cache_inode_gc(ht, &reaper_cache_inode_client, &cache_status) !=
+         CACHE_INODE_SUCCESS)
+        {
+          LogCrit(COMPONENT_CACHE_INODE_GC,
+                  "NFS CACHE INODE REAPER : FAILURE: Bad cache_inode garbage collection");
+        }
+    }
+
+  return NULL;
+}                               /* cache_inode_reaper_thread */
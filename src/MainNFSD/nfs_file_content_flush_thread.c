@@ -92,6 +92,7 @@ void *nfs_file_content_flush_thread(void *flush_data_arg)
 #endif
   nfs_flush_thread_data_t *p_flush_data = NULL;
   exportlist_t *pexport;
+  nfs_export_reader_t export_reader;
   char function_name[MAXNAMLEN];
 #ifdef _USE_XFS
   xfsfsal_export_context_t export_context ;
@@ -133,7 +134,10 @@ void *nfs_file_content_flush_thread(void *flush_data_arg)
                p_flush_data->thread_index);
     }
 
-  /* check for each pexport entry to get those who are data cached */
+  /* check for each pexport entry to get those who are data cached. A reload
+   * of the exports waits for the flush to be done before freeing them */
+  nfs_export_reader_register(&export_reader);
+  nfs_export_reader_enter(&export_reader);
   for(pexport = nfs_param.pexportlist; pexport != NULL; pexport = pexport->next)
     {
 
@@ -203,6 +207,8 @@ void *nfs_file_content_flush_thread(void *flush_data_arg)
                  "Export Entry #%u is not data cached, skipping..",
                  pexport->id);
     }
+  nfs_export_reader_exit(&export_reader);
+  nfs_export_reader_unregister(&export_reader);
 
   /* Tell the admin that flush is done */
   LogEvent(COMPONENT_MAIN,
@@ -148,9 +148,13 @@ void *file_content_gc_thread(void *IndexArg)
 
   char logfile_arg[MAXPATHLEN];
   char *loglevel_arg;
+  nfs_export_reader_t export_reader;
 
   SetNameFunction("file_content_gc_thread");
 
+  /* The exports checked are kept until the check is done */
+  nfs_export_reader_register(&export_reader);
+
   LogEvent(COMPONENT_MAIN,
            "NFS FILE CONTENT GARBAGE COLLECTION : Starting GC thread");
   LogDebug(COMPONENT_MAIN,
@@ -164,6 +168,7 @@ void *file_content_gc_thread(void *IndexArg)
 
       LogEvent(COMPONENT_MAIN,
                "NFS FILE CONTENT GARBAGE COLLECTION : awakening...");
+      nfs_export_reader_enter(&export_reader);
       for(pexport = nfs_param.pexportlist; pexport != NULL; pexport = pexport->next)
         {
           if(pexport->options & EXPORT_OPTION_USE_DATACACHE)
@@ -205,6 +210,7 @@ void *file_content_gc_thread(void *IndexArg)
                 }
             }
         }                       /* for */
+      nfs_export_reader_exit(&export_reader);
 
       if (strncmp(fcc_log_path, "/dev/null", 9) == 0)
 	switch(LogComponents[COMPONENT_CACHE_INODE_GC].comp_log_type)
@@ -91,11 +91,12 @@ pthread_t worker_thrid[NB_MAX_WORKER_THREAD];
 pthread_t flusher_thrid[NB_MAX_FLUSHER_THREAD];
 nfs_flush_thread_data_t flush_info[NB_MAX_FLUSHER_THREAD];
 
-pthread_t rpc_dispatcher_thrid;
+pthread_t rpc_dispatcher_thrid[NB_MAX_DISPATCHER_THREAD];
 pthread_t stat_thrid;
 pthread_t stat_exporter_thrid;
 pthread_t admin_thrid;
 pthread_t fcc_gc_thrid;
+pthread_t cache_inode_reaper_thrid;
 pthread_t sigmgr_thrid;
 
 #ifdef _USE_9P
@@ -135,6 +136,8 @@ void *sigmgr_thread( void * arg )
         {
           LogEvent(COMPONENT_MAIN,
                    "SIGHUP_HANDLER: Received SIGHUP.... initiating export list reload");
+          /* Log files may have been rotated */
+          ReopenLogFiles();
           admin_replace_exports();
         }
     }
@@ -224,11 +227,16 @@ void nfs_print_param_config()
   printf("\tNFS_Program = %u ;\n", nfs_param.core_param.program[P_NFS]);
   printf("\tMNT_Program = %u ;\n", nfs_param.core_param.program[P_NFS]);
   printf("\tNb_Worker = %u ; \n", nfs_param.core_param.nb_worker);
+  printf("\tNb_Dispatcher = %u ; \n", nfs_param.core_param.nb_dispatcher);
   printf("\tb_Call_Before_Queue_Avg = %u ; \n", nfs_param.core_param.nb_call_before_queue_avg);
-  printf("\tNb_MaxConcurrentGC = %u ; \n", nfs_param.core_param.nb_max_concurrent_gc);
   printf("\tDupReq_Expiration = %lu ; \n", nfs_param.core_param.expiration_dupreq);
   printf("\tCore_Dump_Size = %ld ; \n", nfs_param.core_param.core_dump_size);
   printf("\tNb_Max_Fd = %d ; \n", nfs_param.core_param.nb_max_fd);
+  printf("\tMax_Conn_Requests = %u ; \n", nfs_param.core_param.max_conn_requests);
+  printf("\tFSAL_Admission = %u ; \n", nfs_param.core_param.fsal_admission.enabled);
+  printf("\tFSAL_Min_Calls = %u ; \n", nfs_param.core_param.fsal_admission.min_window);
+  printf("\tFSAL_Max_Calls = %u ; \n", nfs_param.core_param.fsal_admission.max_window);
+  printf("\tFSAL_Latency_Tolerance = %u ; \n", nfs_param.core_param.fsal_admission.tolerance);
   printf("\tStats_File_Path = %s ; \n", nfs_param.core_param.stats_file_path);
   printf("\tStats_Update_Delay = %d ; \n", nfs_param.core_param.stats_update_delay);
   printf("\tLong_Processing_Threshold = %d ; \n", nfs_param.core_param.long_processing_threshold);
@@ -241,6 +249,11 @@ void nfs_print_param_config()
   else
     printf("\tDump_Stats_Per_Client = FALSE ;\n");
 
+  if(nfs_param.core_param.async_logging)
+    printf("\tAsync_Logging = TRUE ; \n");
+  else
+    printf("\tAsync_Logging = FALSE ;\n");
+
   if(nfs_param.core_param.drop_io_errors)
     printf("\tDrop_IO_Errors = TRUE ; \n");
   else
@@ -276,8 +289,8 @@ void nfs_set_param_default()
 
   /* Core parameters */
   nfs_param.core_param.nb_worker = NB_WORKER_THREAD_DEFAULT;
+  nfs_param.core_param.nb_dispatcher = NB_DISPATCHER_THREAD_DEFAULT;
   nfs_param.core_param.nb_call_before_queue_avg = NB_REQUEST_BEFORE_QUEUE_AVG;
-  nfs_param.core_param.nb_max_concurrent_gc = NB_MAX_CONCURRENT_GC;
   nfs_param.core_param.expiration_dupreq = DUPREQ_EXPIRATION;
   nfs_param.core_param.port[P_NFS] = NFS_PORT;
   nfs_param.core_param.port[P_MNT] = 0;
@@ -292,6 +305,7 @@ void nfs_set_param_default()
 #endif
 #ifdef _USE_9P
   nfs_param._9p_param._9p_port = _9P_PORT ;
+  nfs_param._9p_param.nb_io_threads = _9P_NB_IO_THREADS ;
 #endif
 #ifdef _USE_QUOTA
   nfs_param.core_param.program[P_RQUOTA] = RQUOTAPROG;
@@ -302,6 +316,12 @@ void nfs_set_param_default()
   nfs_param.core_param.drop_delay_errors = TRUE;
   nfs_param.core_param.core_dump_size = 0;
   nfs_param.core_param.nb_max_fd = -1;       /* Use OS's default */
+  nfs_param.core_param.max_conn_requests = NFS_MAX_CONN_REQUESTS;
+  nfs_param.core_param.fsal_admission.enabled = FALSE;
+  nfs_param.core_param.fsal_admission.min_window = FSAL_ADMIT_MIN_WINDOW;
+  nfs_param.core_param.fsal_admission.max_window = FSAL_ADMIT_MAX_WINDOW;
+  nfs_param.core_param.fsal_admission.tolerance = FSAL_ADMIT_TOLERANCE;
+  nfs_param.core_param.fsal_admission.base_period = FSAL_ADMIT_BASE_PERIOD;
   nfs_param.core_param.stats_update_delay = 60;
   nfs_param.core_param.long_processing_threshold = 10; /* seconds */
   nfs_param.core_param.tcp_fridge_expiration_delay = -1;
@@ -315,6 +335,7 @@ void nfs_set_param_default()
   nfs_param.core_param.use_nfs_commit = FALSE;
   strncpy(nfs_param.core_param.stats_file_path, "/tmp/ganesha.stat", MAXPATHLEN);
   nfs_param.core_param.dump_stats_per_client = 0;
+  nfs_param.core_param.async_logging = TRUE;
   strncpy(nfs_param.core_param.stats_per_client_directory, "/tmp", MAXPATHLEN);
 
   nfs_param.core_param.max_send_buffer_size = NFS_DEFAULT_SEND_BUFFER_SIZE;
@@ -324,20 +345,12 @@ void nfs_set_param_default()
   nfs_param.core_param.nsm_use_caller_name = FALSE;
 #endif
 
-  /* Worker parameters : LRU */
-  nfs_param.worker_param.lru_param.nb_entry_prealloc = NB_PREALLOC_LRU_WORKER;
-  nfs_param.worker_param.lru_param.clean_entry = clean_pending_request;
-  nfs_param.worker_param.lru_param.entry_to_str = print_pending_request;
-
-  /* Worker parameters : LRU dupreq */
-  nfs_param.worker_param.lru_dupreq.nb_entry_prealloc = NB_PREALLOC_LRU_DUPREQ;
-  nfs_param.worker_param.lru_dupreq.clean_entry = clean_entry_dupreq;
-  nfs_param.worker_param.lru_dupreq.entry_to_str = print_entry_dupreq;
+  /* Worker parameters : pending requests queue */
+  nfs_param.worker_param.pending_queue_size = NB_PENDING_QUEUE_SIZE;
 
   /* Worker parameters : GC */
   nfs_param.worker_param.nb_pending_prealloc = NB_MAX_PENDING_REQUEST;
   nfs_param.worker_param.nb_before_gc = NB_REQUEST_BEFORE_GC;
-  nfs_param.worker_param.nb_dupreq_prealloc = NB_PREALLOC_HASH_DUPREQ;
   nfs_param.worker_param.nb_dupreq_before_gc = NB_PREALLOC_GC_DUPREQ;
 
   /* Workers parameters : IP/Name values pool prealloc */
@@ -369,19 +382,19 @@ void nfs_set_param_default()
   nfs_param.nfsv4_param.returns_err_fh_expired = TRUE;
   nfs_param.nfsv4_param.use_open_confirm = TRUE;
   nfs_param.nfsv4_param.return_bad_stateid = TRUE;
+#ifdef _USE_NFS4_1
+  nfs_param.nfsv4_param.max_session_slots = NFS41_MAX_SLOTS;
+  nfs_param.nfsv4_param.session_drc_max_memory = NFS41_DRC_MAX_MEMORY;
+#endif
   strncpy(nfs_param.nfsv4_param.domainname, DEFAULT_DOMAIN, MAXNAMLEN);
   strncpy(nfs_param.nfsv4_param.idmapconf, DEFAULT_IDMAPCONF, MAXPATHLEN);
 
-  /* Worker parameters : dupreq hash table */
+  /* Worker parameters : dupreq cache partitions */
   nfs_param.dupreq_param.hash_param.index_size = PRIME_DUPREQ;
   nfs_param.dupreq_param.hash_param.alphabet_length = 10;    /* Xid is a numerical decimal value */
   nfs_param.dupreq_param.hash_param.nb_node_prealloc = NB_PREALLOC_HASH_DUPREQ;
-  nfs_param.dupreq_param.hash_param.hash_func_key = dupreq_value_hash_func;
-  nfs_param.dupreq_param.hash_param.hash_func_rbt = dupreq_rbt_hash_func;
-  nfs_param.dupreq_param.hash_param.compare_key = compare_req;
-  nfs_param.dupreq_param.hash_param.key_to_str = display_req_key;
-  nfs_param.dupreq_param.hash_param.val_to_str = display_req_val;
   nfs_param.dupreq_param.hash_param.name = "Duplicate Request Cache";
+  nfs_param.dupreq_param.tcp_window = DUPREQ_TCP_WINDOW;
 
   /*  Worker parameters : IP/name hash table */
   nfs_param.ip_name_param.hash_param.index_size = PRIME_IP_NAME;
@@ -394,8 +407,18 @@ void nfs_set_param_default()
   nfs_param.ip_name_param.hash_param.val_to_str = display_ip_name_val;
   nfs_param.ip_name_param.hash_param.name = "IP Name";
   nfs_param.ip_name_param.expiration_time = IP_NAME_EXPIRATION;
+  nfs_param.ip_name_param.negative_expiration_time = IP_NAME_NEGATIVE_EXPIRATION;
+  nfs_param.ip_name_param.resolver_threads = IP_NAME_RESOLVER_THREADS;
+  nfs_param.ip_name_param.resolve_timeout = IP_NAME_RESOLVE_TIMEOUT;
+  nfs_param.ip_name_param.max_entries = IP_NAME_MAX_ENTRIES;
   strncpy(nfs_param.ip_name_param.mapfile, "", MAXPATHLEN);
 
+  /*  Worker parameters : fair share between the clients, off by default */
+  nfs_param.fair_share_param.enabled = FALSE;
+  nfs_param.fair_share_param.default_weight = NFS_FAIR_SHARE_WEIGHT;
+  nfs_param.fair_share_param.default_max_rate = NFS_FAIR_SHARE_MAX_RATE;
+  nfs_param.fair_share_param.nb_clients = 0;
+
   /*  Worker parameters : UID_MAPPER hash table */
   nfs_param.uidmap_cache_param.hash_param.index_size = PRIME_ID_MAPPER;
   nfs_param.uidmap_cache_param.hash_param.alphabet_length = 10;      /* Not used for UID_MAPPER */
@@ -650,6 +673,9 @@ void nfs_set_param_default()
   nfs_param.cache_layers_param.cache_inode_client_param.use_cache = 0;
   nfs_param.cache_layers_param.cache_inode_client_param.use_fsal_hash = 1;
   nfs_param.cache_layers_param.cache_inode_client_param.retention = 60;
+  nfs_param.cache_layers_param.cache_inode_client_param.readahead_max_window = 1024 * 1024;
+  nfs_param.cache_layers_param.cache_inode_client_param.readahead_max_memory = 64 * 1024 * 1024;
+  nfs_param.cache_layers_param.cache_inode_client_param.nb_readahead_thread = 4;
 
   /* Data cache client parameters */
   nfs_param.cache_layers_param.cache_content_client_param.nb_prealloc_entry = 128;
@@ -1019,6 +1045,24 @@ int nfs_set_param_from_conf(nfs_start_info_t * p_start_info)
                  "IP/name configuration read from config file");
     }
 
+  /* Worker parameters: fair share of the workers between the clients */
+  if((rc = nfs_read_fair_share_conf(config_struct, &nfs_param.fair_share_param)) < 0)
+    {
+      LogCrit(COMPONENT_INIT,
+              "Error while parsing fair share configuration");
+      return -1;
+    }
+  else
+    {
+      /* No such stanza in configuration file */
+      if(rc == 1)
+        LogDebug(COMPONENT_INIT,
+		 "No fair share configuration found in config file, using default");
+      else
+        LogDebug(COMPONENT_INIT,
+                 "fair share configuration read from config file");
+    }
+
   /* Worker paramters: uid_mapper hash table, same config for uid and uname resolution */
   if(((rc = nfs_read_uidmap_conf(config_struct, &nfs_param.uidmap_cache_param)) < 0)
      || ((rc = nfs_read_uidmap_conf(config_struct, &nfs_param.unamemap_cache_param)) <
@@ -1336,6 +1380,14 @@ int nfs_set_param_from_conf(nfs_start_info_t * p_start_info)
 #endif
     }
 
+  /* Index the export entries by id, path and tag */
+  if(!nfs_export_index_publish(nfs_param.pexportlist, NULL))
+    {
+      LogCrit(COMPONENT_INIT,
+              "Error while indexing export entries");
+      return -1;
+    }
+
   LogEvent(COMPONENT_INIT, "Configuration file successfully parsed");
 
   /* freeing syntax tree : */
@@ -1371,26 +1423,43 @@ int nfs_check_param_consistency()
       return 1;
     }
 
-  if(nfs_param.worker_param.nb_before_gc <
-     nfs_param.worker_param.lru_param.nb_entry_prealloc / 2)
+  if(nfs_param.core_param.nb_dispatcher <= 0 ||
+     nfs_param.core_param.nb_dispatcher > NB_MAX_DISPATCHER_THREAD)
     {
       LogCrit(COMPONENT_INIT,
-              "BAD PARAMETER: worker_param.nb_before_gc is too small: %d",
-              nfs_param.worker_param.nb_before_gc);
+              "BAD PARAMETER: number of dispatchers must be between 1 and %d",
+              NB_MAX_DISPATCHER_THREAD);
+      return 1;
+    }
+
+  if(nfs_param.core_param.max_conn_requests == 0)
+    {
       LogCrit(COMPONENT_INIT,
-              "BAD PARAMETER: It should be at least half of worker_param.lru_param.nb_entry_prealloc = %d",
-              nfs_param.worker_param.lru_param.nb_entry_prealloc);
+              "BAD PARAMETER: at least one request per connection must be allowed");
+      return 1;
+    }
 
+#ifndef HAVE_SYS_EPOLL_H
+  /* Without epoll, every dispatcher would select on the same sockets */
+  if(nfs_param.core_param.nb_dispatcher != 1)
+    {
+      LogWarn(COMPONENT_INIT,
+              "epoll is not available, only one rpc dispatcher thread will be used");
+      nfs_param.core_param.nb_dispatcher = 1;
+    }
+#endif
+
+  if(nfs_param.worker_param.pending_queue_size == 0)
+    {
+      LogCrit(COMPONENT_INIT,
+              "BAD PARAMETER: worker_param.pending_queue_size must be greater than 0");
       return 1;
     }
 
-  if(nfs_param.dupreq_param.hash_param.nb_node_prealloc <
-     nfs_param.worker_param.lru_dupreq.nb_entry_prealloc)
+  if(nfs_param.dupreq_param.hash_param.index_size == 0)
     {
       LogCrit(COMPONENT_INIT,
-              "BAD PARAMETER(dupreq): nb_node_prealloc = %d should be greater than nb_entry_prealloc = %d",
-              nfs_param.dupreq_param.hash_param.nb_node_prealloc,
-              nfs_param.worker_param.lru_dupreq.nb_entry_prealloc);
+              "BAD PARAMETER(dupreq): Index_Size must be greater than 0");
       return 1;
     }
 #ifdef _USE_MFSL_ASYNC
@@ -1522,6 +1591,7 @@ static void nfs_Start_threads(bool_t flush_datacache_mode)
 {
   int rc = 0;
   pthread_attr_t attr_thr;
+  pthread_t thrid;
   unsigned long i = 0;
 
   LogDebug(COMPONENT_THREAD,
@@ -1578,16 +1648,21 @@ static void nfs_Start_threads(bool_t flush_datacache_mode)
     nlm_startup();
 #endif
 
-  /* Starting the rpc dispatcher thread */
-  if((rc =
-      pthread_create(&rpc_dispatcher_thrid, &attr_thr, rpc_dispatcher_thread,
-                     &nfs_param)) != 0)
+  /* Starting the rpc dispatcher threads */
+  for(i = 0; i < nfs_param.core_param.nb_dispatcher; i++)
     {
-      LogFatal(COMPONENT_THREAD,
-               "Could not create rpc_dispatcher_thread, error = %d (%s)",
-               errno, strerror(errno));
+      if((rc =
+          pthread_create(&(rpc_dispatcher_thrid[i]), &attr_thr, rpc_dispatcher_thread,
+                         (void *)i)) != 0)
+        {
+          LogFatal(COMPONENT_THREAD,
+                   "Could not create rpc_dispatcher_thread #%lu, error = %d (%s)",
+                   i, errno, strerror(errno));
+        }
     }
-  LogEvent(COMPONENT_THREAD, "rpc dispatcher thread was started successfully");
+  LogEvent(COMPONENT_THREAD,
+           "%d rpc dispatcher threads were started successfully",
+           nfs_param.core_param.nb_dispatcher);
 
 #ifdef _USE_9P
   /* Starting the 9p dispatcher thread */
@@ -1645,6 +1720,39 @@ static void nfs_Start_threads(bool_t flush_datacache_mode)
 
 #endif      /*  _USE_STAT_EXPORTER */
 
+  /* Starting the cache inode reaper thread */
+  if((rc =
+      pthread_create(&cache_inode_reaper_thrid, &attr_thr, cache_inode_reaper_thread,
+                     (void *)workers_data[0].ht)) != 0)
+    {
+      LogFatal(COMPONENT_THREAD,
+               "Could not create cache_inode_reaper_thread, error = %d (%s)",
+               errno, strerror(errno));
+    }
+  LogEvent(COMPONENT_THREAD, "cache inode reaper thread was started successfully");
+
+  /* Starting the cache inode read-ahead threads */
+  if(cache_inode_readahead_set_param(&nfs_param.cache_layers_param.cache_inode_client_param) == 0)
+    {
+      for(i = 0; i < nfs_param.cache_layers_param.cache_inode_client_param.nb_readahead_thread; i++)
+        {
+#ifndef _NO_BUDDY_SYSTEM
+          rc = pthread_create(&thrid, &attr_thr, cache_inode_readahead_thread,
+                              (void *)&nfs_param.buddy_param_worker);
+#else
+          rc = pthread_create(&thrid, &attr_thr, cache_inode_readahead_thread, NULL);
+#endif
+          if(rc != 0)
+            {
+              LogFatal(COMPONENT_THREAD,
+                       "Could not create cache_inode_readahead_thread #%lu, error = %d (%s)",
+                       i, errno, strerror(errno));
+            }
+        }
+      LogEvent(COMPONENT_THREAD,
+               "%lu cache inode read-ahead threads were started successfully", i);
+    }
+
   if(nfs_param.cache_layers_param.dcgcpol.run_interval != 0)
     {
       /* Starting the nfs file content gc thread  */
@@ -1693,6 +1801,32 @@ static void nfs_Init(const nfs_start_info_t * p_start_info)
   unsigned int fsalid = 0 ;
 #endif
 
+  /* Latency histograms of every layer, before anything is measured */
+  if(nfs_rpc_register_stats() != 0)
+    LogFatal(COMPONENT_INIT, "Impossible to register the request statistics");
+  nfs4_Compound_register_stats();
+#ifdef _USE_9P
+  _9p_register_stats();
+#endif
+  cache_inode_register_stats();
+  FSAL_register_stats();
+  LogInfo(COMPONENT_INIT, "Request statistics successfully registered");
+
+  /* Adaptive limit of the FSAL calls of each export */
+  if(fsal_admit_init(&nfs_param.core_param.fsal_admission) != FSAL_ADMIT_SUCCESS)
+    LogFatal(COMPONENT_INIT,
+             "BAD PARAMETER: FSAL_Min_Calls must be between 1 and FSAL_Max_Calls, and FSAL_Latency_Tolerance above 100");
+
+  /* Fair share of the workers between the clients and the exports */
+  if(nfs_fair_share_init(&nfs_param.fair_share_param) != NFS_FAIR_SHARE_SUCCESS)
+    LogFatal(COMPONENT_INIT,
+             "BAD PARAMETER: fair share weights must be between 1 and %d, and rates at most 1000000",
+             NFS_FAIR_SHARE_MAX_WEIGHT);
+  if(nfs_param.fair_share_param.enabled)
+    LogInfo(COMPONENT_INIT,
+            "Requests are shared fairly between %u weighted clients and the others",
+            nfs_param.fair_share_param.nb_clients);
+
   /* FSAL Initialisation */
 #ifdef _USE_SHARED_FSAL
   saved_fsalid = FSAL_GetId() ;
@@ -1846,12 +1980,6 @@ static void nfs_Init(const nfs_start_info_t * p_start_info)
   memset((char *)workers_data, 0,
          sizeof(nfs_worker_data_t) * nfs_param.core_param.nb_worker);
 
-  if(nfs_Init_gc_counter() != 0)
-    {
-      LogFatal(COMPONENT_INIT, "Error while initializing worker gc counter");
-    }
-  LogDebug(COMPONENT_INIT, "worker gc counter successfully initialized");
-
   LogDebug(COMPONENT_INIT, "Initializing workers data structure");
 
   for(i = 0; i < nfs_param.core_param.nb_worker; i++)
@@ -1894,20 +2022,6 @@ static void nfs_Init(const nfs_start_info_t * p_start_info)
           Fatal();
         }
 
-      /* Allocation of the nfs dupreq pool */
-      MakePool(&workers_data[i].dupreq_pool,
-               nfs_param.worker_param.nb_dupreq_prealloc,
-               dupreq_entry_t, NULL, NULL);
-      NamePool(&workers_data[i].dupreq_pool, "Duplicate Request Pool %d", i);
-
-      if(!IsPoolPreallocated(&workers_data[i].dupreq_pool))
-        {
-          LogCrit(COMPONENT_INIT,
-                  "Error while allocating duplicate request pool #%d", i);
-          LogError(COMPONENT_INIT, ERR_SYS, ERR_MALLOC, errno);
-          Fatal();
-        }
-
       /* Allocation of the IP/name pool */
       MakePool(&workers_data[i].ip_stats_pool,
                nfs_param.worker_param.nb_ip_stats_prealloc,
@@ -2249,6 +2363,14 @@ void nfs_start(nfs_start_info_t * p_start_info)
       exit(0);
     }
 
+  /* From now on, log files are written by a dedicated thread */
+  if(nfs_param.core_param.async_logging)
+    {
+      if(StartLogWriter() != 0)
+        LogCrit(COMPONENT_INIT,
+                "Could not start the log writer, logging synchronously");
+    }
+
   /* Set the Core dump size if set */
   if(nfs_param.core_param.core_dump_size != -1)
     {
@@ -43,11 +43,15 @@
 #endif
 
 #include <stdio.h>
+#include <stddef.h>
 #include <string.h>
 #include <pthread.h>
 #include <fcntl.h>
 #include <sys/file.h>           /* for having FNDELAY */
 #include <sys/select.h>
+#ifdef HAVE_SYS_EPOLL_H
+#include <sys/epoll.h>
+#endif
 #include "HashData.h"
 #include "HashTable.h"
 #include "rpc.h"
@@ -76,7 +80,40 @@
   #define P_FAMILY AF_INET6
 #endif
 
-static pthread_mutex_t lock_worker_selection = PTHREAD_MUTEX_INITIALIZER;
+#ifdef HAVE_SYS_EPOLL_H
+/* Maximum number of events returned by a single epoll_wait */
+#define RPC_EPOLL_MAX_EVENTS 64
+
+/* One epoll set per dispatcher thread. Socket 'sock' is owned by dispatcher
+ * (sock % nb_dispatcher), so a given SVCXPRT is only ever read by one thread */
+static int rpc_epoll_fd[NB_MAX_DISPATCHER_THREAD];
+#endif
+
+/* Requests of a TCP connection are decoded and queued as soon as their record
+ * is complete, without waiting for the replies of the previous ones. Each
+ * connection counts its requests in progress: it is no longer read when it
+ * has too many of them, and when it dies its socket is kept open (and its
+ * number reserved) until the last reply has been sent. Replies that did not
+ * fit in the socket wait in its send queue, written by the dispatcher when
+ * the socket has room again; a connection with too many of them waiting is
+ * not read either. Indexed by socket. */
+#define RPC_CONN_LOCKS 64
+
+typedef struct rpc_conn_state__
+{
+  unsigned int nb_inflight;
+  unsigned int pending;         /* bytes waiting in the send queue */
+  unsigned int events;          /* epoll events watched */
+  bool_t paused;
+  bool_t dead;
+} rpc_conn_state_t;
+
+static rpc_conn_state_t *rpc_conn;
+static pthread_mutex_t rpc_conn_lock[RPC_CONN_LOCKS];
+
+#if !defined(HAVE_SYS_EPOLL_H) && defined(_USE_TIRPC)
+extern rw_lock_t Svc_fd_lock;
+#endif
 
 #if !defined(_NO_BUDDY_SYSTEM) && defined(_DEBUG_MEMLEAKS)
 /**
@@ -264,9 +301,15 @@ void Create_udp(protos prot)
 void Create_tcp(protos prot)
 {
 #ifdef _USE_TIRPC
+  int maxrec = NFS_MAX_TCP_RECORD_SIZE;
+
   tcp_xprt[prot] = Svc_vc_create(tcp_socket[prot],
                                  nfs_param.core_param.max_send_buffer_size,
                                  nfs_param.core_param.max_recv_buffer_size);
+
+  /* Records are reassembled in a buffer that grows up to this size */
+  if(tcp_xprt[prot] != NULL)
+    SVC_CONTROL(tcp_xprt[prot], SVCSET_CONNMAXREC, &maxrec);
 #else
   tcp_xprt[prot] = Svctcp_create(tcp_socket[prot],
                                  nfs_param.core_param.max_send_buffer_size,
@@ -450,6 +493,291 @@ void Register_program(protos prot, int flag, int vers)
     }
 }
 
+#ifdef HAVE_SYS_EPOLL_H
+/**
+ * rpc_epoll_add: add a socket to the epoll set of the dispatcher owning it.
+ *
+ * @return 0 if successful, -1 otherwise.
+ *
+ */
+static int rpc_epoll_add(int sock, bool_t edge_triggered)
+{
+  struct epoll_event ev;
+  unsigned int index = sock % nfs_param.core_param.nb_dispatcher;
+
+  memset(&ev, 0, sizeof(ev));
+  ev.events = EPOLLIN;
+  if(edge_triggered)
+    ev.events |= EPOLLET;
+  ev.data.fd = sock;
+
+  if(epoll_ctl(rpc_epoll_fd[index], EPOLL_CTL_ADD, sock, &ev) == -1)
+    {
+      LogCrit(COMPONENT_DISPATCH,
+              "Cannot add socket %d to the epoll set of dispatcher #%u, error %d (%s)",
+              sock, index, errno, strerror(errno));
+      return -1;
+    }
+
+  LogFullDebug(COMPONENT_DISPATCH,
+               "Socket %d is managed by dispatcher #%u", sock, index);
+  return 0;
+}
+
+/**
+ * Create_event_loops: create the epoll sets used by the dispatcher threads.
+ *
+ * UDP sockets are non blocking and are drained on every wakeup, so they are
+ * edge-triggered. A call to SVC_RECV on a rendezvous xprt accepts only one
+ * connection, so the listening TCP sockets stay level-triggered.
+ *
+ */
+void Create_event_loops(void)
+{
+  unsigned int i;
+  protos p;
+
+  for(i = 0; i < nfs_param.core_param.nb_dispatcher; i++)
+    {
+      rpc_epoll_fd[i] = epoll_create(RPC_EPOLL_MAX_EVENTS);
+
+      if(rpc_epoll_fd[i] == -1)
+        LogFatal(COMPONENT_DISPATCH,
+                 "Cannot create epoll set for dispatcher #%u, error %d (%s)",
+                 i, errno, strerror(errno));
+    }
+
+  for(p = P_NFS; p < P_COUNT; p++)
+    if(test_for_additional_nfs_protocols(p))
+      {
+        if(rpc_epoll_add(udp_socket[p], TRUE) != 0 ||
+           rpc_epoll_add(tcp_socket[p], FALSE) != 0)
+          LogFatal(COMPONENT_DISPATCH,
+                   "Cannot watch the %s sockets", tags[p]);
+      }
+}
+#endif                          /* HAVE_SYS_EPOLL_H */
+
+/**
+ * nfs_rpc_add_conn: hand a new TCP connection to the dispatcher threads.
+ *
+ * Called when a connection is accepted. Its socket is non blocking: every
+ * time data arrives, the dispatcher owning the socket adds it to the record
+ * being reassembled, and a complete record is decoded and queued to a worker
+ * like a UDP request. No thread is dedicated to a connection. The socket is
+ * level-triggered, so records already waiting after a complete one are read
+ * on the next wakeup.
+ *
+ * @param sock the connected socket
+ *
+ * @return 0 if successful, -1 otherwise.
+ *
+ */
+int nfs_rpc_add_conn(int sock)
+{
+  P(rpc_conn_lock[sock % RPC_CONN_LOCKS]);
+  memset(&rpc_conn[sock], 0, sizeof(rpc_conn_state_t));
+#ifdef HAVE_SYS_EPOLL_H
+  rpc_conn[sock].events = EPOLLIN;
+#endif
+  V(rpc_conn_lock[sock % RPC_CONN_LOCKS]);
+
+#ifdef HAVE_SYS_EPOLL_H
+  return rpc_epoll_add(sock, FALSE);
+#else
+  /* The socket stays in Svc_fdset, watched by the only dispatcher */
+  return 0;
+#endif
+}                               /* nfs_rpc_add_conn */
+
+/**
+ * nfs_rpc_watch_conn: update the events watched on a TCP connection.
+ *
+ * A connection is read unless it is paused or has too many bytes waiting to
+ * be sent, and is watched for room in its socket while bytes are waiting.
+ * Called with the lock of the connection held.
+ *
+ */
+static void nfs_rpc_watch_conn(int sock)
+{
+  bool_t watch = !rpc_conn[sock].paused &&
+                 rpc_conn[sock].pending <= NFS_MAX_CONN_PENDING;
+#ifdef HAVE_SYS_EPOLL_H
+  struct epoll_event ev;
+
+  memset(&ev, 0, sizeof(ev));
+  ev.events = watch ? EPOLLIN : 0;
+  if(rpc_conn[sock].pending > 0)
+    ev.events |= EPOLLOUT;
+  ev.data.fd = sock;
+
+  if(ev.events == rpc_conn[sock].events)
+    return;
+  rpc_conn[sock].events = ev.events;
+
+  if(epoll_ctl(rpc_epoll_fd[sock % nfs_param.core_param.nb_dispatcher],
+               EPOLL_CTL_MOD, sock, &ev) == -1)
+    LogCrit(COMPONENT_DISPATCH,
+            "Cannot change the events of socket %d, error %d (%s)",
+            sock, errno, strerror(errno));
+#else
+#ifdef _USE_TIRPC
+  P_w(&Svc_fd_lock);
+#endif
+  if(watch)
+    FD_SET(sock, &Svc_fdset);
+  else
+    FD_CLR(sock, &Svc_fdset);
+#ifdef _USE_TIRPC
+  V_w(&Svc_fd_lock);
+#endif
+#endif
+}                               /* nfs_rpc_watch_conn */
+
+/**
+ * nfs_rpc_conn_pending: bytes of a TCP connection wait for room in its socket.
+ *
+ * Called by the RPC layer, with the send queue of the connection locked,
+ * each time the number of bytes waiting in it changes. The dispatcher owning
+ * the socket writes them when the socket has room again, and stops reading
+ * the connection while more than NFS_MAX_CONN_PENDING bytes are waiting. The
+ * bytes of a dead connection are dropped with it.
+ *
+ * @param sock the connected socket
+ * @param pending the number of bytes waiting
+ *
+ * @return TRUE if the dispatcher writes the bytes, FALSE if the caller has to.
+ *
+ */
+bool_t nfs_rpc_conn_pending(int sock, unsigned int pending)
+{
+#ifdef HAVE_SYS_EPOLL_H
+  P(rpc_conn_lock[sock % RPC_CONN_LOCKS]);
+  rpc_conn[sock].pending = pending;
+  if(!rpc_conn[sock].dead)
+    nfs_rpc_watch_conn(sock);
+  V(rpc_conn_lock[sock % RPC_CONN_LOCKS]);
+  return TRUE;
+#else
+  /* Without epoll, the dispatcher does not wait for room in sockets */
+  return FALSE;
+#endif
+}                               /* nfs_rpc_conn_pending */
+
+/**
+ * nfs_rpc_hold_conn: account a request to its TCP connection.
+ *
+ * Called by the dispatcher before queueing a request. Once the connection has
+ * Max_Conn_Requests requests in progress, it is not read until some replies
+ * have been sent.
+ *
+ * @param preqnfs the request being queued
+ *
+ * @return nothing (void function)
+ *
+ */
+static void nfs_rpc_hold_conn(nfs_request_data_t * preqnfs)
+{
+  int sock = preqnfs->xprt->XP_SOCK;
+
+  preqnfs->conn_sock = -1;
+  if(get_xprt_type(preqnfs->xprt) != XPRT_TCP)
+    return;
+
+  preqnfs->conn_sock = sock;
+
+  P(rpc_conn_lock[sock % RPC_CONN_LOCKS]);
+  rpc_conn[sock].nb_inflight += 1;
+  if(rpc_conn[sock].nb_inflight >= nfs_param.core_param.max_conn_requests &&
+     !rpc_conn[sock].paused)
+    {
+      LogFullDebug(COMPONENT_DISPATCH,
+                   "%u requests in progress on socket %d, no longer reading it",
+                   rpc_conn[sock].nb_inflight, sock);
+      rpc_conn[sock].paused = TRUE;
+      nfs_rpc_watch_conn(sock);
+    }
+  V(rpc_conn_lock[sock % RPC_CONN_LOCKS]);
+}                               /* nfs_rpc_hold_conn */
+
+/**
+ * nfs_rpc_release_conn: a request of a TCP connection is done.
+ *
+ * Called by the worker once the reply is sent, or the request dropped. The
+ * last request of a dead connection destroys it.
+ *
+ * @param preqnfs the request that is done
+ *
+ * @return nothing (void function)
+ *
+ */
+void nfs_rpc_release_conn(nfs_request_data_t * preqnfs)
+{
+  int sock = preqnfs->conn_sock;
+  bool_t destroy = FALSE;
+
+  if(sock < 0)
+    return;
+
+  preqnfs->conn_sock = -1;
+
+  P(rpc_conn_lock[sock % RPC_CONN_LOCKS]);
+  rpc_conn[sock].nb_inflight -= 1;
+  if(rpc_conn[sock].dead)
+    destroy = (rpc_conn[sock].nb_inflight == 0);
+  else if(rpc_conn[sock].paused &&
+          rpc_conn[sock].nb_inflight <= nfs_param.core_param.max_conn_requests / 2)
+    {
+      rpc_conn[sock].paused = FALSE;
+      nfs_rpc_watch_conn(sock);
+    }
+  V(rpc_conn_lock[sock % RPC_CONN_LOCKS]);
+
+  if(destroy && Xports[sock] != NULL)
+    {
+      LogDebug(COMPONENT_DISPATCH,
+               "Last reply sent on dead socket %d, destroying it", sock);
+      SVC_DESTROY(Xports[sock]);
+    }
+}                               /* nfs_rpc_release_conn */
+
+/**
+ * nfs_rpc_close_conn: a TCP connection died.
+ *
+ * The connection is no longer read. It is destroyed now if no request is in
+ * progress, otherwise by the worker sending the last reply, so that the
+ * socket is not reused while replies are pending.
+ *
+ * @param xprt the dead connection
+ *
+ * @return nothing (void function)
+ *
+ */
+static void nfs_rpc_close_conn(SVCXPRT * xprt)
+{
+  int sock = xprt->XP_SOCK;
+  bool_t destroy;
+
+  P(rpc_conn_lock[sock % RPC_CONN_LOCKS]);
+  destroy = (rpc_conn[sock].nb_inflight == 0);
+  if(!destroy && !rpc_conn[sock].dead)
+    {
+      rpc_conn[sock].dead = TRUE;
+#ifdef HAVE_SYS_EPOLL_H
+      /* Hang-ups are reported even with no event requested */
+      epoll_ctl(rpc_epoll_fd[sock % nfs_param.core_param.nb_dispatcher],
+                EPOLL_CTL_DEL, sock, NULL);
+#else
+      rpc_conn[sock].paused = TRUE;
+      nfs_rpc_watch_conn(sock);
+#endif
+    }
+  V(rpc_conn_lock[sock % RPC_CONN_LOCKS]);
+
+  if(destroy && Xports[sock] != NULL)
+    SVC_DESTROY(Xports[sock]);
+}                               /* nfs_rpc_close_conn */
+
 /**
  * nfs_Init_svc: Init the svc descriptors for the nfs daemon.
  *
@@ -460,6 +788,7 @@ void Register_program(protos prot, int flag, int vers)
 void nfs_Init_svc()
 {
   int one = 1;
+  int i;
   protos p;
 
   /* Initialize all the sockets to -1 because it makes some code later easier */
@@ -474,6 +803,16 @@ void nfs_Init_svc()
 
   InitRPC(nfs_param.core_param.nb_max_fd);
 
+  rpc_conn = (rpc_conn_state_t *) Mem_Alloc_Label(nfs_param.core_param.nb_max_fd *
+                                                  sizeof(rpc_conn_state_t),
+                                                  "rpc_conn_state_t");
+  if(rpc_conn == NULL)
+    LogFatal(COMPONENT_DISPATCH, "Cannot allocate the connection states");
+  memset(rpc_conn, 0, nfs_param.core_param.nb_max_fd * sizeof(rpc_conn_state_t));
+
+  for(i = 0; i < RPC_CONN_LOCKS; i++)
+    pthread_mutex_init(&rpc_conn_lock[i], NULL);
+
 #ifdef _USE_TIRPC
   LogInfo(COMPONENT_DISPATCH, "NFS INIT: using TIRPC");
 
@@ -597,6 +936,11 @@ void nfs_Init_svc()
   /* Allocation of the SVCXPRT */
   Create_SVCXPRT();
 
+#ifdef HAVE_SYS_EPOLL_H
+  /* Dispatch the sockets among the dispatcher threads */
+  Create_event_loops();
+#endif
+
 #ifdef _HAVE_GSSAPI
   /* Acquire RPCSEC_GSS basis if needed */
   if(nfs_param.krb5_param.active_krb5 == TRUE)
@@ -645,73 +989,138 @@ void nfs_Init_svc()
 }                               /* nfs_Init_svc */
 
 /**
- * Selects the smallest request queue,
- * whome the worker is ready and is not garbagging.
+ * select_worker_queue: chooses the worker a new request is queued to.
+ *
+ * Workers are scanned round-robin from a shared atomic counter, so that the
+ * dispatcher threads don't need a lock to pick a queue. An idle worker is
+ * preferred; when all of them are busy the request goes to the next worker in
+ * turn and idle siblings steal it when they are done (see DispatchWork).
+ *
+ * @return the index of the chosen worker.
  */
-static unsigned int select_worker_queue()
+unsigned int select_worker_queue(void)
 {
-  #define NO_VALUE_CHOOSEN  1000000
-  unsigned int worker_index = NO_VALUE_CHOOSEN;
-  unsigned int avg_number_pending = NO_VALUE_CHOOSEN;
-  unsigned int total_number_pending = 0;
-
-  static unsigned int counter;
-
-  unsigned int i;
   static unsigned int last;
-  unsigned int cpt = 0;
+  unsigned int start;
+  unsigned int i;
+  unsigned int cpt;
   worker_available_rc rc;
 
-  P(lock_worker_selection);
-  counter++;
+  start = __sync_fetch_and_add(&last, 1) % nfs_param.core_param.nb_worker;
 
-  /* Calculate the average queue length if counter is bigger than configured value. */
-  if(counter > nfs_param.core_param.nb_call_before_queue_avg)
+  for(i = start, cpt = 0;
+      cpt < nfs_param.core_param.nb_worker;
+      cpt++, i = (i + 1) % nfs_param.core_param.nb_worker)
     {
-      for(i = 0; i < nfs_param.core_param.nb_worker; i++)
+      /* Choose only fully initialized workers and that does not gc. */
+      rc = worker_available(i);
+      if(rc == WORKER_AVAILABLE)
+        return i;
+      else if(rc == WORKER_ALL_PAUSED)
         {
-          total_number_pending += workers_data[i].pending_request->nb_entry;
+          /* Wait for the threads to awaken */
+          wait_for_workers_to_awaken();
         }
-      avg_number_pending = total_number_pending / nfs_param.core_param.nb_worker;
-      /* Reset counter. */
-      counter = 0;
     }
-  V(lock_worker_selection);
 
-  /* Choose the queue whose length is smaller than average. */
-      for(i = (last + 1) % nfs_param.core_param.nb_worker, cpt = 0;
-          cpt < nfs_param.core_param.nb_worker;
-          cpt++, i = (i + 1) % nfs_param.core_param.nb_worker)
+  return start;
+}                               /* select_worker_queue */
+
+/* Operations looked at for the file handle of an NFSv4 compound: a PUTFH
+ * comes first, or right after the SEQUENCE of an NFSv4.1 compound */
+#define NFS4_EXPORTID_OPS 2
+
+/**
+ * nfs_rpc_get_exportid: finds the export of a request, for the fair share.
+ *
+ * The export id is only read from the file handle, the handle is checked
+ * by the worker which rejects the request if it is not valid.
+ *
+ * @param preqnfs the request, with its arguments decoded
+ *
+ * @return the export id, or -1 if the request is not about an export.
+ *
+ */
+static int nfs_rpc_get_exportid(nfs_request_data_t * preqnfs)
+{
+  struct svc_req *ptr_req = &preqnfs->req;
+  nfs_arg_t *parg_nfs = &preqnfs->arg_nfs;
+  nfs_argop4 *pargop;
+  unsigned int i;
+#ifdef _USE_NLM
+  netobj *pfh3 = NULL;
+#endif
+
+  if(ptr_req->rq_prog == nfs_param.core_param.program[P_NFS])
+    {
+      if(ptr_req->rq_proc == NFSPROC_NULL)
+        return -1;
+
+      switch (ptr_req->rq_vers)
         {
-          /* Choose only fully initialized workers and that does not gc. */
-          rc = worker_available(i, avg_number_pending);
-          if(rc == WORKER_AVAILABLE)
-            {
-              worker_index = i;
-              break;
-            }
-          else if(rc == WORKER_ALL_PAUSED)
-            {
-              /* Wait for the threads to awaken */
-              rc = wait_for_workers_to_awaken();
-              /*              if(rc == PAUSE_EXIT)
-                {
-                }
-              */
-            }
-          else if(rc == WORKER_EXIT)
+        case NFS_V2:
+          return nfs2_FhandleToExportId((fhandle2 *) parg_nfs);
+
+        case NFS_V3:
+          return nfs3_FhandleToExportId((nfs_fh3 *) parg_nfs);
+
+        case NFS_V4:
+          for(i = 0; i < parg_nfs->arg_compound4.argarray.argarray_len &&
+              i < NFS4_EXPORTID_OPS; i++)
             {
+              pargop = &parg_nfs->arg_compound4.argarray.argarray_val[i];
+              if(pargop->argop != NFS4_OP_PUTFH)
+                continue;
+
+              if(pargop->nfs_argop4_u.opputfh.object.nfs_fh4_len <
+                 offsetof(file_handle_v4_t, exportid) + sizeof(unsigned int))
+                return -1;
+
+              return nfs4_FhandleToExportId(&pargop->nfs_argop4_u.opputfh.object);
             }
-        }
+          return -1;
 
-  if(worker_index == NO_VALUE_CHOOSEN)
-    worker_index = (last + 1) % nfs_param.core_param.nb_worker;
+        default:
+          return -1;
+        }
+    }
 
-  last = worker_index;
+#ifdef _USE_NLM
+  if(ptr_req->rq_prog == nfs_param.core_param.program[P_NLM])
+    {
+      switch(ptr_req->rq_proc)
+        {
+          case NLMPROC4_TEST:
+          case NLMPROC4_TEST_MSG:
+          case NLMPROC4_GRANTED:
+          case NLMPROC4_GRANTED_MSG:
+            pfh3 = &parg_nfs->arg_nlm4_test.alock.fh;
+            break;
+
+          case NLMPROC4_LOCK:
+          case NLMPROC4_LOCK_MSG:
+          case NLMPROC4_NM_LOCK:
+            pfh3 = &parg_nfs->arg_nlm4_lock.alock.fh;
+            break;
+
+          case NLMPROC4_CANCEL:
+          case NLMPROC4_CANCEL_MSG:
+            pfh3 = &parg_nfs->arg_nlm4_cancel.alock.fh;
+            break;
+
+          case NLMPROC4_UNLOCK:
+          case NLMPROC4_UNLOCK_MSG:
+            pfh3 = &parg_nfs->arg_nlm4_unlock.alock.fh;
+            break;
+        }
 
-  return worker_index;
+      if(pfh3 != NULL)
+        return nlm4_FhandleToExportId(pfh3);
+    }
+#endif
 
-}                               /* select_worker_queue */
+  return -1;
+}                               /* nfs_rpc_get_exportid */
 
 /**
  * process_rpc_request: process an RPC request.
@@ -747,9 +1156,9 @@ process_status_t process_rpc_request(SVCXPRT *xprt)
     }
 
   LogFullDebug(COMPONENT_DISPATCH,
-               "Use request from Worker Thread #%u's pool, xprt->xp_sock=%d, thread has %d pending requests",
+               "Use request from Worker Thread #%u's pool, xprt->xp_sock=%d, thread has %u pending requests",
                worker_index, xprt->XP_SOCK,
-               workers_data[worker_index].pending_request->nb_entry);
+               req_queue_length(&workers_data[worker_index].pending_request));
 
   /* Get a pnfsreq from the worker's pool */
   P(workers_data[worker_index].request_pool_mutex);
@@ -768,6 +1177,7 @@ process_status_t process_rpc_request(SVCXPRT *xprt)
 
   /* Set the request as a NFS related one */
   pnfsreq->rtype = NFS_REQUEST ;
+  pnfsreq->pool_index = worker_index;
 
   /* Set up cred area */
   cred_area = pnfsreq->rcontent.nfs.cred_area;
@@ -780,6 +1190,7 @@ process_status_t process_rpc_request(SVCXPRT *xprt)
 
   /* Set up xprt */
   pnfsreq->rcontent.nfs.xprt = xprt;
+  pnfsreq->rcontent.nfs.conn_sock = -1;
   preq->rq_xprt = xprt;
 
   /*
@@ -822,16 +1233,16 @@ process_status_t process_rpc_request(SVCXPRT *xprt)
                    "Client on socket=%d, addr=%s disappeared...",
                    pnfsreq->rcontent.nfs.xprt->XP_SOCK, addrbuf);
 
-          if(Xports[pnfsreq->rcontent.nfs.xprt->XP_SOCK] != NULL)
-            SVC_DESTROY(Xports[pnfsreq->rcontent.nfs.xprt->XP_SOCK]);
+          nfs_rpc_close_conn(pnfsreq->rcontent.nfs.xprt);
 
           rc = PROCESS_LOST_CONN;
         }
       else if(stat == XPRT_MOREREQS)
         {
-          LogDebug(COMPONENT_DISPATCH,
-                   "Client on socket=%d, addr=%s has status XPRT_MOREREQS",
-                   pnfsreq->rcontent.nfs.xprt->XP_SOCK, addrbuf);
+          /* The record is not complete yet, wait for more data */
+          LogFullDebug(COMPONENT_DISPATCH,
+                       "Client on socket=%d, addr=%s has status XPRT_MOREREQS",
+                       pnfsreq->rcontent.nfs.xprt->XP_SOCK, addrbuf);
         }
       else if(stat == XPRT_IDLE)
         {
@@ -853,6 +1264,7 @@ process_status_t process_rpc_request(SVCXPRT *xprt)
       struct timeval timer_start;
       struct timeval timer_end;
       struct timeval timer_diff;
+      sockaddr_t addr;
 
       nfs_stat_type_t stat_type;
       nfs_request_latency_stat_t latency_stat;
@@ -894,7 +1306,17 @@ process_status_t process_rpc_request(SVCXPRT *xprt)
       preq->rq_xprt = pnfsreq->rcontent.nfs.xprt_copy;
 
       /* Regular management of the request (UDP request or TCP request on connected handler */
-      DispatchWorkNFS(pnfsreq, worker_index);
+      nfs_rpc_hold_conn(&pnfsreq->rcontent.nfs);
+
+      /* The requests of the clients share the workers fairly, MOUNT stays
+       * on its own worker */
+      if(!nfs_param.fair_share_param.enabled ||
+         pnfsreq->rcontent.nfs.req.rq_prog == nfs_param.core_param.program[P_MNT] ||
+         copy_xprt_addr(&addr, xprt) != 1 ||
+         DispatchWorkFairShare(pnfsreq, &addr,
+                               nfs_rpc_get_exportid(&pnfsreq->rcontent.nfs)) !=
+         NFS_FAIR_SHARE_SUCCESS)
+        DispatchWorkNFS(pnfsreq, worker_index);
 
       gettimeofday(&timer_end, NULL);
       timer_diff = time_diff(timer_start, timer_end);
@@ -928,219 +1350,310 @@ free_req:
 }
 
 /**
- * nfs_rpc_getreq: Do half of the work done by svc_getreqset.
+ * nfs_rpc_getreq_sock: process one event on a socket watched by a dispatcher.
  *
- * This function wait for an incoming ONC message by waiting on a 'select' statement. Then getting a request
- * it perform the authentication and extracts the RPC message for the related socket. It then find the less busy
- * worker (the one with the shortest pending queue) and put the msg in this queue.
+ * Find the SVCXPRT related to the socket, then perform the authentication and
+ * extracts the RPC message. The less busy worker (the one with the shortest
+ * pending queue) is chosen and the msg is put in its queue.
  *
- * @param readfds File Descriptor Set related to the socket used for RPC management.
+ * @param rpc_sock the socket on which input is waiting.
  *
  * @return Nothing (void function), but calls svcerr_* function to notify the client when an error occures.
  *
  */
-void nfs_rpc_getreq(fd_set * readfds)
+static void nfs_rpc_getreq_sock(int rpc_sock)
 {
   register SVCXPRT *xprt;
-  register int bit;
-  register long mask, *maskp;
-  register int sock;
-  register int rpc_sock;
-  process_status_t status;
-
-  /* portable access to fds_bits field */
-  maskp = __FDS_BITS(readfds);
 
-  for(sock = 0; sock < FD_SETSIZE; sock += NFDBITS)
+  xprt = Xports[rpc_sock];
+  if(xprt == NULL)
     {
-      for(mask = *maskp++; (bit = ffs(mask)); mask ^= (1 << (bit - 1)))
-        {
-          /* sock has input waiting */
-          rpc_sock = sock + bit - 1;
+      /* But do we control sock? */
+      LogCrit(COMPONENT_DISPATCH,
+              "CRITICAL ERROR: Incoherency found in Xports array");
+      return;
+    }
 
-          xprt = Xports[rpc_sock];
-          if(xprt == NULL)
-            {
-              /* But do we control sock? */
-              LogCrit(COMPONENT_DISPATCH,
-                      "CRITICAL ERROR: Incoherency found in Xports array");
-              continue;
-            }
+  /*
+   * UDP RPCs are quite simple: everything comes to the same socket, so several SVCXPRT
+   * can be defined, one per tbuf to handle the stuff
+   * TCP RPCs are more complex:
+   *   - a unique SVCXPRT exists that deals with initial tcp rendez vous. It does the accept
+   *     with the client, but recv no message from the client. But SVC_RECV on it creates
+   *     a new SVCXPRT dedicated to the client. This specific SVXPRT is bound on TCPSocket
+   *
+   * while receiving something on the Svc_fdset, I must know if this is a UDP request,
+   * an initial TCP request or a TCP socket from an already connected client.
+   * This is how to distinguish the cases:
+   * UDP connections are bound to socket NFS_UDPSocket
+   * TCP initial connections are bound to socket NFS_TCPSocket
+   * all the other cases are requests from already connected TCP Clients
+   */
 
-          /*
-           * UDP RPCs are quite simple: everything comes to the same socket, so several SVCXPRT
-           * can be defined, one per tbuf to handle the stuff
-           * TCP RPCs are more complex:
-           *   - a unique SVCXPRT exists that deals with initial tcp rendez vous. It does the accept
-           *     with the client, but recv no message from the client. But SVC_RECV on it creates
-           *     a new SVCXPRT dedicated to the client. This specific SVXPRT is bound on TCPSocket
-           *
-           * while receiving something on the Svc_fdset, I must know if this is a UDP request,
-           * an initial TCP request or a TCP socket from an already connected client.
-           * This is how to distinguish the cases:
-           * UDP connections are bound to socket NFS_UDPSocket
-           * TCP initial connections are bound to socket NFS_TCPSocket
-           * all the other cases are requests from already connected TCP Clients
-           */
-
-          if(udp_socket[P_NFS] == rpc_sock)
-            {
-              /* This is a regular UDP connection */
-              LogFullDebug(COMPONENT_DISPATCH, "A NFS UDP request");
-              if(xprt != udp_xprt[P_NFS])
-                LogCrit(COMPONENT_DISPATCH,
-                        "Oops, UDP xprt doesn't match xprt=%p xprt_nfs_udp=%p",
-                        xprt, udp_xprt[P_NFS]);
-              xprt = udp_xprt[P_NFS];
-            }
-          else if(udp_socket[P_MNT] == rpc_sock)
-            {
-              LogFullDebug(COMPONENT_DISPATCH, "A MOUNT UDP request");
-              if(xprt != udp_xprt[P_MNT])
-                LogCrit(COMPONENT_DISPATCH,
-                        "Oops, UDP xprt doesn't match xprt=%p xprt_mnt_udp=%p",
-                        xprt, udp_xprt[P_MNT]);
-              xprt = udp_xprt[P_MNT];
-            }
+  if(udp_socket[P_NFS] == rpc_sock)
+    {
+      /* This is a regular UDP connection */
+      LogFullDebug(COMPONENT_DISPATCH, "A NFS UDP request");
+      if(xprt != udp_xprt[P_NFS])
+        LogCrit(COMPONENT_DISPATCH,
+                "Oops, UDP xprt doesn't match xprt=%p xprt_nfs_udp=%p",
+                xprt, udp_xprt[P_NFS]);
+      xprt = udp_xprt[P_NFS];
+    }
+  else if(udp_socket[P_MNT] == rpc_sock)
+    {
+      LogFullDebug(COMPONENT_DISPATCH, "A MOUNT UDP request");
+      if(xprt != udp_xprt[P_MNT])
+        LogCrit(COMPONENT_DISPATCH,
+                "Oops, UDP xprt doesn't match xprt=%p xprt_mnt_udp=%p",
+                xprt, udp_xprt[P_MNT]);
+      xprt = udp_xprt[P_MNT];
+    }
 #ifdef _USE_NLM
-          else if(udp_socket[P_NLM] == rpc_sock)
-            {
-              LogFullDebug(COMPONENT_DISPATCH, "A NLM UDP request");
-              if(xprt != udp_xprt[P_NLM])
-                LogCrit(COMPONENT_DISPATCH,
-                        "Oops, UDP xprt doesn't match xprt=%p xprt_nlm_udp=%p",
-                        xprt, udp_xprt[P_NLM]);
-              xprt = udp_xprt[P_NLM];
-            }
+  else if(udp_socket[P_NLM] == rpc_sock)
+    {
+      LogFullDebug(COMPONENT_DISPATCH, "A NLM UDP request");
+      if(xprt != udp_xprt[P_NLM])
+        LogCrit(COMPONENT_DISPATCH,
+                "Oops, UDP xprt doesn't match xprt=%p xprt_nlm_udp=%p",
+                xprt, udp_xprt[P_NLM]);
+      xprt = udp_xprt[P_NLM];
+    }
 #endif                          /* _USE_NLM */
 #ifdef _USE_QUOTA
-          else if(udp_socket[P_RQUOTA] == rpc_sock)
-            {
-              LogFullDebug(COMPONENT_DISPATCH, "A RQUOTA UDP request");
-              if(xprt != udp_xprt[P_RQUOTA])
-                LogCrit(COMPONENT_DISPATCH,
-                        "Oops, UDP xprt doesn't match xprt=%p xprt_rquota_udp=%p",
-                        xprt, udp_xprt[P_RQUOTA]);
-              xprt = udp_xprt[P_RQUOTA];
-            }
+  else if(udp_socket[P_RQUOTA] == rpc_sock)
+    {
+      LogFullDebug(COMPONENT_DISPATCH, "A RQUOTA UDP request");
+      if(xprt != udp_xprt[P_RQUOTA])
+        LogCrit(COMPONENT_DISPATCH,
+                "Oops, UDP xprt doesn't match xprt=%p xprt_rquota_udp=%p",
+                xprt, udp_xprt[P_RQUOTA]);
+      xprt = udp_xprt[P_RQUOTA];
+    }
 #endif                          /* _USE_QUOTA */
-          else if(tcp_socket[P_NFS] == rpc_sock)
-            {
-              /*
-               * This is an initial tcp connection
-               * There is no RPC message, this is only a TCP connect.
-               * In this case, the SVC_RECV does only produces a new connected socket (it does
-               * just a call to accept and FD_SET)
-               * there is no need of worker thread processing to be done
-               */
-              LogFullDebug(COMPONENT_DISPATCH,
-                           "An initial NFS TCP request from a new client");
-              if(xprt != tcp_xprt[P_NFS])
-                LogCrit(COMPONENT_DISPATCH,
-                        "Oops, UDP xprt doesn't match xprt=%p xprt_nfs_tcp=%p",
-                        xprt, tcp_xprt[P_NFS]);
-              xprt = tcp_xprt[P_NFS];
-            }
-          else if(tcp_socket[P_MNT] == rpc_sock)
-            {
-              LogFullDebug(COMPONENT_DISPATCH,
-                           "An initial MOUNT TCP request from a new client");
-              if(xprt != tcp_xprt[P_MNT])
-                LogCrit(COMPONENT_DISPATCH,
-                        "Oops, UDP xprt doesn't match xprt=%p xprt_mnt_tcp=%p",
-                        xprt, tcp_xprt[P_MNT]);
-              xprt = tcp_xprt[P_MNT];
-            }
+  else if(tcp_socket[P_NFS] == rpc_sock)
+    {
+      /*
+       * This is an initial tcp connection
+       * There is no RPC message, this is only a TCP connect.
+       * In this case, the SVC_RECV does only produces a new connected socket (it does
+       * just a call to accept and FD_SET)
+       * there is no need of worker thread processing to be done
+       */
+      LogFullDebug(COMPONENT_DISPATCH,
+                   "An initial NFS TCP request from a new client");
+      if(xprt != tcp_xprt[P_NFS])
+        LogCrit(COMPONENT_DISPATCH,
+                "Oops, UDP xprt doesn't match xprt=%p xprt_nfs_tcp=%p",
+                xprt, tcp_xprt[P_NFS]);
+      xprt = tcp_xprt[P_NFS];
+    }
+  else if(tcp_socket[P_MNT] == rpc_sock)
+    {
+      LogFullDebug(COMPONENT_DISPATCH,
+                   "An initial MOUNT TCP request from a new client");
+      if(xprt != tcp_xprt[P_MNT])
+        LogCrit(COMPONENT_DISPATCH,
+                "Oops, UDP xprt doesn't match xprt=%p xprt_mnt_tcp=%p",
+                xprt, tcp_xprt[P_MNT]);
+      xprt = tcp_xprt[P_MNT];
+    }
 #ifdef _USE_NLM
-          else if(tcp_socket[P_NLM] == rpc_sock)
-            {
-              LogFullDebug(COMPONENT_DISPATCH,
-                           "An initial NLM request from a new client");
-              if(xprt != tcp_xprt[P_NLM])
-                LogCrit(COMPONENT_DISPATCH,
-                        "Oops, UDP xprt doesn't match xprt=%p xprt_nlm_tcp=%p",
-                        xprt, tcp_xprt[P_NLM]);
-              xprt = tcp_xprt[P_NLM];
-            }
+  else if(tcp_socket[P_NLM] == rpc_sock)
+    {
+      LogFullDebug(COMPONENT_DISPATCH,
+                   "An initial NLM request from a new client");
+      if(xprt != tcp_xprt[P_NLM])
+        LogCrit(COMPONENT_DISPATCH,
+                "Oops, UDP xprt doesn't match xprt=%p xprt_nlm_tcp=%p",
+                xprt, tcp_xprt[P_NLM]);
+      xprt = tcp_xprt[P_NLM];
+    }
 #endif                          /* _USE_NLM */
 #ifdef _USE_QUOTA
-          else if(tcp_socket[P_RQUOTA] == rpc_sock)
-            {
-              LogFullDebug(COMPONENT_DISPATCH,
-                           "An initial RQUOTA request from a new client");
-              if(xprt != tcp_xprt[P_RQUOTA])
-                LogCrit(COMPONENT_DISPATCH,
-                        "Oops, UDP xprt doesn't match xprt=%p xprt_rquota_tcp=%p",
-                        xprt, tcp_xprt[P_RQUOTA]);
-              xprt = tcp_xprt[P_RQUOTA];
-            }
+  else if(tcp_socket[P_RQUOTA] == rpc_sock)
+    {
+      LogFullDebug(COMPONENT_DISPATCH,
+                   "An initial RQUOTA request from a new client");
+      if(xprt != tcp_xprt[P_RQUOTA])
+        LogCrit(COMPONENT_DISPATCH,
+                "Oops, UDP xprt doesn't match xprt=%p xprt_rquota_tcp=%p",
+                xprt, tcp_xprt[P_RQUOTA]);
+      xprt = tcp_xprt[P_RQUOTA];
+    }
 #endif                          /* _USE_QUOTA */
-          else
-            {
-              /* This is a regular tcp request on an established connection, should be handle by a dedicated thread */
-              LogDebug(COMPONENT_DISPATCH,
-                       "A NFS TCP request from an already connected client");
-            }
+  else
+    {
+      /* This is a regular tcp request on an established connection */
+      LogFullDebug(COMPONENT_DISPATCH,
+                   "A NFS TCP request from an already connected client");
+    }
+
+  process_rpc_request(xprt);
+}                               /* nfs_rpc_getreq_sock */
+
+#ifdef HAVE_SYS_EPOLL_H
+/**
+ * rpc_is_udp_socket: tells if a socket is one of the UDP service sockets.
+ *
+ */
+static bool_t rpc_is_udp_socket(int sock)
+{
+  protos p;
+
+  for(p = P_NFS; p < P_COUNT; p++)
+    if(udp_socket[p] == sock)
+      return TRUE;
+
+  return FALSE;
+}
+
+/**
+ * rpc_dgram_pending: tells if a datagram is waiting on a UDP socket.
+ *
+ * Edge-triggered sockets must be drained before waiting on them again.
+ *
+ */
+static bool_t rpc_dgram_pending(int sock)
+{
+  char c;
 
-          status = process_rpc_request(xprt);
+  for(;;)
+    {
+      if(recvfrom(sock, &c, sizeof(c), MSG_PEEK | MSG_DONTWAIT, NULL, NULL) >= 0)
+        return TRUE;
+
+      if(errno == EAGAIN || errno == EWOULDBLOCK)
+        return FALSE;
+
+      /* An asynchronous error (ICMP unreachable) is reported once, then cleared */
+      if(errno != EINTR && errno != ECONNREFUSED)
+        {
+          LogCrit(COMPONENT_DISPATCH,
+                  "Cannot peek on udp socket %d, error %d (%s)",
+                  sock, errno, strerror(errno));
+          return FALSE;
         }
     }
-}                               /* nfs_rpc_getreq */
+}                               /* rpc_dgram_pending */
 
 /**
+ * nfs_rpc_flush_conn: write the replies waiting for room in a TCP socket.
  *
- * clean_pending_request: cleans an entry in a nfs request LRU,
+ * @param rpc_sock the connected socket
  *
- * cleans an entry in a nfs request LRU.
+ * @return FALSE if the connection died, TRUE otherwise.
  *
- * @param pentry [INOUT] entry to be cleaned.
- * @param addparam [IN] additional parameter used for cleaning.
+ */
+static bool_t nfs_rpc_flush_conn(int rpc_sock)
+{
+#ifdef _USE_TIRPC
+  SVCXPRT *xprt = Xports[rpc_sock];
+
+  if(xprt == NULL)
+    return FALSE;
+
+  if(Svc_vc_flush(xprt) < 0)
+    {
+      LogDebug(COMPONENT_DISPATCH,
+               "Cannot send the replies waiting on socket %d", rpc_sock);
+      nfs_rpc_close_conn(xprt);
+      return FALSE;
+    }
+#endif
+  return TRUE;
+}                               /* nfs_rpc_flush_conn */
+
+/**
+ * nfs_rpc_getreq: Do half of the work done by svc_getreqset.
  *
- * @return 0 if ok, other values mean an error.
+ * Process the events returned by epoll_wait. Each ready socket is handled by
+ * nfs_rpc_getreq_sock, UDP sockets being drained until no datagram is left.
+ * A connection with room again in its socket first sends its waiting replies.
+ *
+ * @param events the events returned by epoll_wait.
+ * @param nb_events number of entries in events.
+ *
+ * @return Nothing (void function).
  *
  */
-int clean_pending_request(LRU_entry_t * pentry, void *addparam)
+void nfs_rpc_getreq(struct epoll_event *events, int nb_events)
 {
-  struct prealloc_pool *request_pool = (struct prealloc_pool *) addparam;
-  nfs_request_data_t *preqnfs = (nfs_request_data_t *) (pentry->buffdata.pdata);
+  int i;
+  int rpc_sock;
 
-  /* Send the entry back to the pool */
-  ReleaseToPool(preqnfs, request_pool);
+  for(i = 0; i < nb_events; i++)
+    {
+      rpc_sock = events[i].data.fd;
 
-  return 0;
-}                               /* clean_pending_request */
+      if(events[i].events & EPOLLOUT)
+        {
+          if(!nfs_rpc_flush_conn(rpc_sock))
+            continue;
+          if(!(events[i].events & ~EPOLLOUT))
+            continue;
+        }
 
+      if(rpc_is_udp_socket(rpc_sock))
+        {
+          do
+            nfs_rpc_getreq_sock(rpc_sock);
+          while(rpc_dgram_pending(rpc_sock));
+        }
+      else
+        nfs_rpc_getreq_sock(rpc_sock);
+    }
+}                               /* nfs_rpc_getreq */
+#else
 /**
+ * nfs_rpc_getreq: Do half of the work done by svc_getreqset.
  *
- * print_pending_request: prints an entry related to a pending request in the LRU list.
- *
- * prints an entry related to a pending request in the LRU list.
+ * This function is called when the 'select' statement returns. Every socket
+ * set in readfds is handled by nfs_rpc_getreq_sock.
  *
- * @param data [IN] data stored in a LRU entry to be printed.
- * @param str [OUT] string used to store the result.
+ * @param readfds File Descriptor Set related to the socket used for RPC management.
  *
- * @return 0 if ok, other values mean an error.
+ * @return Nothing (void function).
  *
  */
-int print_pending_request(LRU_data_t data, char *str)
+void nfs_rpc_getreq(fd_set * readfds)
 {
-  return snprintf(str, LRU_DISPLAY_STRLEN, "not implemented for now");
-}                               /* print_pending_request */
+  register int bit;
+  register long mask, *maskp;
+  register int sock;
+
+  /* portable access to fds_bits field */
+  maskp = __FDS_BITS(readfds);
+
+  for(sock = 0; sock < FD_SETSIZE; sock += NFDBITS)
+    {
+      for(mask = *maskp++; (bit = ffs(mask)); mask ^= (1 << (bit - 1)))
+        {
+          /* sock has input waiting */
+          nfs_rpc_getreq_sock(sock + bit - 1);
+        }
+    }
+}                               /* nfs_rpc_getreq */
+#endif                          /* HAVE_SYS_EPOLL_H */
 
 /**
  * nfs_rpc_dispatcher_svc_run: the same as svc_run.
  *
- * The same as svc_run.
+ * The same as svc_run, but only the sockets owned by this dispatcher are watched.
  *
- * @param none
+ * @param index the index of this dispatcher thread
  *
  * @return nothing (void function)
  *
  */
 
-void rpc_dispatcher_svc_run()
+void rpc_dispatcher_svc_run(unsigned long index)
 {
+#ifdef HAVE_SYS_EPOLL_H
+  struct epoll_event events[RPC_EPOLL_MAX_EVENTS];
+#else
   fd_set readfdset;
+#endif
   int rc = 0;
 
 #ifdef _DEBUG_MEMLEAKS
@@ -1149,26 +1662,32 @@ void rpc_dispatcher_svc_run()
 
   while(TRUE)
     {
+      LogFullDebug(COMPONENT_DISPATCH,
+                   "rpc dispatcher thread #%lu waiting for incoming RPC requests",
+                   index);
+
+#ifdef HAVE_SYS_EPOLL_H
+      /* Wait on the epoll set owned by this dispatcher */
+      rc = epoll_wait(rpc_epoll_fd[index], events, RPC_EPOLL_MAX_EVENTS, -1);
+#else
       /* Always work on a copy of Svc_fdset */
       readfdset = Svc_fdset;
 
-      /* Select on a fdset build with all socket used in NFS/RPC */
-      LogFullDebug(COMPONENT_DISPATCH,
-                   "rpc dispatcher thread waiting for incoming RPC requests");
-
       /* Do the select on the RPC fdset */
       rc = select(FD_SETSIZE, &readfdset, NULL, NULL, NULL);
+#endif
 
       LogFullDebug(COMPONENT_DISPATCH,
-                   "Waiting for incoming RPC requests, after select rc=%d",
+                   "Waiting for incoming RPC requests, after wait rc=%d",
                    rc);
       switch (rc)
         {
         case -1:
-          if(errno == EBADF)
+          if(errno == EBADF || errno == EINVAL)
             {
               LogCrit(COMPONENT_DISPATCH,
-                      "Select failed, error %d (%s)", errno, strerror(errno));
+                      "Wait for RPC requests failed, error %d (%s)",
+                      errno, strerror(errno));
               return;
             }
           break;
@@ -1178,7 +1697,11 @@ void rpc_dispatcher_svc_run()
 
         default:
           LogFullDebug(COMPONENT_DISPATCH, "NFS SVC RUN: request(s) received");
+#ifdef HAVE_SYS_EPOLL_H
+          nfs_rpc_getreq(events, rc);
+#else
           nfs_rpc_getreq(&readfdset);
+#endif
           break;
 
         }                       /* switch */
@@ -1205,15 +1728,20 @@ void rpc_dispatcher_svc_run()
  *
  * Thead used for RPC dispatching. It gets the requests and then spool it to one of the worker's LRU.
  * The worker chosen is the one with the smaller load (its LRU is the shorter one).
+ * Several dispatchers may run, each of them watching its own share of the RPC sockets.
  *
- * @param Arg (unused)
+ * @param Arg the index of the dispatcher thread
  *
  * @return Pointer to the result (but this function will mostly loop forever).
  *
  */
 void *rpc_dispatcher_thread(void *Arg)
 {
-  SetNameFunction("dispatch_thr");
+  unsigned long index = (unsigned long)Arg;
+  char thr_name[32];
+
+  snprintf(thr_name, sizeof(thr_name), "dispatch_thr#%lu", index);
+  SetNameFunction(thr_name);
 
 #ifndef _NO_BUDDY_SYSTEM
   /* Initialisation of the Buddy Malloc */
@@ -1230,7 +1758,7 @@ void *rpc_dispatcher_thread(void *Arg)
   LogDebug(COMPONENT_DISPATCH,
            "My pthread id is %p", (caddr_t) pthread_self());
 
-  rpc_dispatcher_svc_run();
+  rpc_dispatcher_svc_run(index);
 
   return NULL;
 }                               /* rpc_dispatcher_thread */
@@ -58,6 +58,7 @@
 #include <signal.h>
 #include "nfs_core.h"
 #include "nfs_stat.h"
+#include "nfs_stat_registry.h"
 #include "nfs_exports.h"
 #include "nodelist.h"
 #include "stuff_alloc.h"
@@ -505,6 +506,44 @@ int merge_nfs_stats(char *stat_buf, nfs_stat_client_req_t *stat_client_req,
   return rc;
 }
 
+/**
+ *
+ * send_stat_snapshot: sends a snapshot of the statistics registry as JSON.
+ *
+ * @param new_fd [IN] the connection to the client, closed on return.
+ *
+ * @return 0 if successfull, -1 otherwise.
+ *
+ */
+static int send_stat_snapshot(int new_fd)
+{
+  nfs_stat_snapshot_t *psnap;
+  FILE *stream;
+  int rc;
+
+  if((stream = fdopen(new_fd, "w")) == NULL)
+    {
+      LogError(COMPONENT_MAIN, ERR_SYS, ERR_FOPEN, errno);
+      close(new_fd);
+      return -1;
+    }
+
+  if((psnap = nfs_stat_snapshot_take()) == NULL)
+    {
+      LogCrit(COMPONENT_MAIN, "Stat export server: no memory for a snapshot");
+      fclose(stream);
+      return -1;
+    }
+
+  rc = nfs_stat_snapshot_print_json(stream, psnap);
+  nfs_stat_snapshot_free(psnap);
+
+  if(fclose(stream) != 0)
+    rc = -1;
+
+  return rc;
+}                               /* send_stat_snapshot */
+
 int process_stat_request(void *addr, int new_fd)
 {
   int rc = ERR_STAT_NO_ERROR;
@@ -550,12 +589,20 @@ int process_stat_request(void *addr, int new_fd)
           {
             stat_client_req.stat_type = PER_SERVER_DETAIL;
           }
+        else if(strcmp(value, "snapshot") == 0)
+          {
+            stat_client_req.stat_type = SNAPSHOT;
+          }
       }
     }
 
     token = strtok_r(NULL, ",", &saveptr1);
   }
 
+  /* The registry is read without touching the workers, and its output has no fixed size */
+  if(stat_client_req.stat_type == SNAPSHOT)
+    return send_stat_snapshot(new_fd);
+
   memset(stat_buf, 0, 4096);
   merge_nfs_stats(stat_buf, &stat_client_req, &global_worker_stat, workers_data);
   if((rc = send(new_fd, stat_buf, 4096, 0)) == -1)
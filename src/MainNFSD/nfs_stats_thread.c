@@ -94,6 +94,10 @@ void *stats_thread(void *addr)
 
   unsigned long long total_fsal_calls;
   fsal_statistics_t global_fsal_stat;
+  fsal_admit_stats_t admit_stats[FSAL_ADMIT_NB_CLASS];
+  nfs_fair_share_stats_t fair_share_stats;
+  exportlist_t *pexport;
+  nfs_export_reader_t export_reader;
 
   unsigned int min_pending_request;
   unsigned int max_pending_request;
@@ -110,6 +114,9 @@ void *stats_thread(void *addr)
 
   SetNameFunction("stat_thr");
 
+  /* The exports walked for their windows are kept until the walk is done */
+  nfs_export_reader_register(&export_reader);
+
 #ifndef _NO_BUDDY_SYSTEM
   if((rc = BuddyInit(NULL)) != BUDDY_SUCCESS)
     {
@@ -569,8 +576,7 @@ void *stats_thread(void *addr)
 
           /* Computing the pending request stats */
           len_pending_request =
-              workers_data[i].pending_request->nb_entry -
-              workers_data[i].pending_request->nb_invalid;
+              req_queue_length(&workers_data[i].pending_request);
 
           if(len_pending_request < min_pending_request)
             min_pending_request = len_pending_request;
@@ -813,6 +819,46 @@ void *stats_thread(void *addr)
                 global_fsal_stat.func_stats.nb_err_unrecover[j]);
       fprintf(stats_file, "\n");
 
+      /* Window of each export: metadata calls, then data calls. For each:
+       * window, in progress, waiting, base and average latency (us),
+       * admitted, waited, refused, increases, decreases */
+      nfs_export_reader_enter(&export_reader);
+      for(pexport = nfs_param.pexportlist; pexport != NULL; pexport = pexport->next)
+        {
+          if(fsal_admit_get_stats(&pexport->FS_export_context, FSAL_ADMIT_METADATA,
+                                  &admit_stats[FSAL_ADMIT_METADATA]) != FSAL_ADMIT_SUCCESS ||
+             fsal_admit_get_stats(&pexport->FS_export_context, FSAL_ADMIT_DATA,
+                                  &admit_stats[FSAL_ADMIT_DATA]) != FSAL_ADMIT_SUCCESS)
+            continue;
+
+          fprintf(stats_file, "FSAL_ADMISSION,%s;%u", strdate, pexport->id);
+          for(j = 0; j < FSAL_ADMIT_NB_CLASS; j++)
+            fprintf(stats_file, "|%u,%u,%u,%llu,%llu,%llu,%llu,%llu,%llu,%llu",
+                    admit_stats[j].window, admit_stats[j].inflight,
+                    admit_stats[j].waiting,
+                    (unsigned long long)admit_stats[j].latency_base / 1000,
+                    (unsigned long long)admit_stats[j].latency_avg / 1000,
+                    (unsigned long long)admit_stats[j].nb_admitted,
+                    (unsigned long long)admit_stats[j].nb_waited,
+                    (unsigned long long)admit_stats[j].nb_refused,
+                    (unsigned long long)admit_stats[j].nb_increase,
+                    (unsigned long long)admit_stats[j].nb_decrease);
+          fprintf(stats_file, "\n");
+        }
+      nfs_export_reader_exit(&export_reader);
+
+      /* Fair share: queued, flows, clients, enqueued, dequeued, throttled */
+      if(nfs_param.fair_share_param.enabled)
+        {
+          nfs_fair_share_get_stats(&fair_share_stats);
+          fprintf(stats_file, "FAIR_SHARE,%s;%u,%u,%u,%llu,%llu,%llu\n", strdate,
+                  fair_share_stats.nb_queued, fair_share_stats.nb_flows,
+                  fair_share_stats.nb_clients,
+                  (unsigned long long)fair_share_stats.nb_enqueued,
+                  (unsigned long long)fair_share_stats.nb_dequeued,
+                  (unsigned long long)fair_share_stats.nb_throttled);
+        }
+
 #ifndef _NO_BUDDY_SYSTEM
 
       /* buddy memory */
@@ -46,6 +46,7 @@
 #include <stdio.h>
 #include <string.h>
 #include <pthread.h>
+#include <sched.h>
 #include <fcntl.h>
 #include <sys/file.h>           /* for having FNDELAY */
 #include "HashData.h"
@@ -67,6 +68,7 @@
 #include "nfs_dupreq.h"
 #include "nfs_file_handle.h"
 #include "nfs_stat.h"
+#include "nfs_stat_registry.h"
 #include "SemN.h"
 
 #ifdef _USE_PNFS
@@ -80,10 +82,6 @@ void nfs_debug_debug_label_info();
 
 nfs_worker_data_t *workers_data;
 
-/* These two variables keep state of the thread that gc at this time */
-unsigned int nb_current_gc_workers;
-pthread_mutex_t lock_nb_current_gc_workers;
-
 const nfs_function_desc_t invalid_funcdesc =
   {nfs_Null, nfs_Null_Free, (xdrproc_t) xdr_void, (xdrproc_t) xdr_void, "invalid_function",
    NOTHING_SPECIAL};
@@ -364,32 +362,107 @@ const nfs_function_desc_t rquota2_func_desc[] = {
 
 #endif
 
+/* Latency histogram ids of the functions, filled by nfs_rpc_register_stats */
+typedef struct nfs_function_stats__
+{
+  const nfs_function_desc_t *funcdesc;
+  unsigned int nb_func;
+  const char *prefix;
+  int *histograms;
+} nfs_function_stats_t;
+
+#define NFS_FUNCTION_STATS(table, prefix) \
+  { table, sizeof(table) / sizeof(nfs_function_desc_t), prefix, NULL }
+
+static nfs_function_stats_t nfs_function_stats[] = {
+  NFS_FUNCTION_STATS(nfs2_func_desc, "nfs2"),
+  NFS_FUNCTION_STATS(nfs3_func_desc, "nfs3"),
+  NFS_FUNCTION_STATS(nfs4_func_desc, "nfs4"),
+  NFS_FUNCTION_STATS(mnt1_func_desc, "mnt1"),
+  NFS_FUNCTION_STATS(mnt3_func_desc, "mnt3"),
+#ifdef _USE_NLM
+  NFS_FUNCTION_STATS(nlm4_func_desc, "nlm4"),
+#endif
+#ifdef _USE_QUOTA
+  NFS_FUNCTION_STATS(rquota1_func_desc, "rquota1"),
+  NFS_FUNCTION_STATS(rquota2_func_desc, "rquota2"),
+#endif
+};
+
+#define NFS_FUNCTION_STATS_NB (sizeof(nfs_function_stats) / sizeof(nfs_function_stats_t))
+
+static int nfs_stat_counter_requests = -1;
+static int nfs_stat_counter_dropped = -1;
+
 /**
- * nfs_Init_gc_counter: Init the worker's gc counters.
  *
- * This functions is used to init a mutex and a counter associated with it, to keep track of the number of worker currently
- * performing the garbagge collection.
+ * nfs_rpc_register_stats: registers the counters and histograms of the dispatcher.
  *
- * @param void No parameters
+ * Every function of every program gets a latency histogram named after
+ * its program and version, like "nfs3.nfs_Read". Must be called before
+ * the workers are started.
  *
- * @return 0 if successfull, -1 otherwise.
+ * @return 0 if successfull, -1 if memory is missing.
  *
  */
-
-int nfs_Init_gc_counter(void)
+int nfs_rpc_register_stats(void)
 {
-  pthread_mutexattr_t mutexattr;
+  char name[NFS_STAT_NAME_LEN];
+  unsigned int i, j;
 
-  if(pthread_mutexattr_init(&mutexattr) != 0)
-    return -1;
+  nfs_stat_counter_requests = nfs_stat_register_counter("rpc.requests");
+  nfs_stat_counter_dropped = nfs_stat_register_counter("rpc.dropped");
 
-  if(pthread_mutex_init(&lock_nb_current_gc_workers, &mutexattr) != 0)
-    return -1;
+  for(i = 0; i < NFS_FUNCTION_STATS_NB; i++)
+    {
+      if((nfs_function_stats[i].histograms =
+          (int *)Mem_Alloc_Label(sizeof(int) * nfs_function_stats[i].nb_func,
+                                 "nfs_function_stats")) == NULL)
+        return -1;
 
-  nb_current_gc_workers = 0;
+      for(j = 0; j < nfs_function_stats[i].nb_func; j++)
+        {
+          /* Holes of the NLM table have no name */
+          if(nfs_function_stats[i].funcdesc[j].funcname == NULL)
+            {
+              nfs_function_stats[i].histograms[j] = -1;
+              continue;
+            }
+
+          snprintf(name, NFS_STAT_NAME_LEN, "%s.%s", nfs_function_stats[i].prefix,
+                   nfs_function_stats[i].funcdesc[j].funcname);
+          nfs_function_stats[i].histograms[j] = nfs_stat_register_histogram(name);
+        }
+    }
 
-  return 0;                     /* Success */
-}                               /* nfs_Init_gc_counter */
+  return 0;
+}                               /* nfs_rpc_register_stats */
+
+/**
+ *
+ * nfs_rpc_get_histogram: finds the latency histogram of a function.
+ *
+ * @param pfuncdesc [IN] the function descriptor, as returned by nfs_rpc_get_funcdesc.
+ *
+ * @return the histogram id, -1 if there is none.
+ *
+ */
+static int nfs_rpc_get_histogram(const nfs_function_desc_t * pfuncdesc)
+{
+  unsigned int i;
+
+  for(i = 0; i < NFS_FUNCTION_STATS_NB; i++)
+    if(pfuncdesc >= nfs_function_stats[i].funcdesc &&
+       pfuncdesc < nfs_function_stats[i].funcdesc + nfs_function_stats[i].nb_func)
+      {
+        if(nfs_function_stats[i].histograms == NULL)
+          return -1;
+
+        return nfs_function_stats[i].histograms[pfuncdesc - nfs_function_stats[i].funcdesc];
+      }
+
+  return -1;
+}                               /* nfs_rpc_get_histogram */
 
 struct timeval time_diff(struct timeval time_from, struct timeval time_to)
 {
@@ -658,6 +731,30 @@ int nfs_rpc_get_args(nfs_request_data_t * preqnfs, const nfs_function_desc_t *pf
   return TRUE;
 }
 
+/**
+ * nfs_rpc_lock_reply: serialize the replies of a socket when needed.
+ *
+ * The replies of a TCP connection take its socket in turn through its send
+ * queue, so several workers may encode them at once. The replies protected
+ * by RPCSEC_GSS share the context of the client and, like the replies of the
+ * UDP sockets, are still sent one at a time.
+ *
+ * @param xprt the transport of the reply
+ * @param preq the request being replied to
+ *
+ * @return TRUE if the mutex of the socket is held, FALSE otherwise.
+ *
+ */
+static bool_t nfs_rpc_lock_reply(SVCXPRT * xprt, struct svc_req *preq)
+{
+#ifdef _USE_TIRPC
+  if(get_xprt_type(xprt) == XPRT_TCP && preq->rq_cred.oa_flavor != RPCSEC_GSS)
+    return FALSE;
+#endif
+  P(mutex_cond_xprt[xprt->XP_SOCK]);
+  return TRUE;
+}
+
 /**
  * nfs_rpc_execute: main rpc dispatcher routine
  *
@@ -678,15 +775,17 @@ static void nfs_rpc_execute(nfs_request_data_t * preqnfs,
   nfs_arg_t *parg_nfs = &preqnfs->arg_nfs;
   nfs_res_t res_nfs;
   short exportid;
-  LRU_list_t *lru_dupreq = NULL;
+  dupreq_reply_t dupreq_reply;
   struct svc_req *ptr_req = &preqnfs->req;
   SVCXPRT *ptr_svc = preqnfs->xprt;
+  bool_t reply_locked;
   nfs_stat_type_t stat_type;
   sockaddr_t hostaddr;
   int port;
   int rc;
   int do_dupreq_cache;
   int status;
+  bool_t sent;
   exportlist_client_entry_t related_client;
   struct user_cred user_credentials;
 
@@ -700,9 +799,8 @@ static void nfs_rpc_execute(nfs_request_data_t * preqnfs,
   struct timeval timer_end;
   struct timeval timer_diff;
   nfs_request_latency_stat_t latency_stat;
-
-  /* Get the value from the worker data */
-  lru_dupreq = pworker_data->duplicate_request;
+  uint64_t svc_start = 0;
+  uint64_t svc_latency = 0;
 
   /* initializing RPC structure */
   memset(&res_nfs, 0, sizeof(res_nfs));
@@ -741,8 +839,7 @@ static void nfs_rpc_execute(nfs_request_data_t * preqnfs,
   status = nfs_dupreq_add_not_finished(rpcxid,
                                        ptr_req,
                                        preqnfs->xprt,
-                                       &pworker_data->dupreq_pool,
-                                       &res_nfs);
+                                       &dupreq_reply);
   switch(status)
     {
       /* a new request, continue processing it */
@@ -762,17 +859,18 @@ static void nfs_rpc_execute(nfs_request_data_t * preqnfs,
                        "Before svc_sendreply on socket %d (dup req)",
                        ptr_svc->XP_SOCK);
 
-          P(mutex_cond_xprt[ptr_svc->XP_SOCK]);
+          reply_locked = nfs_rpc_lock_reply(ptr_svc, ptr_req);
 
           if(svc_sendreply
-             (ptr_svc, pworker_data->pfuncdesc->xdr_encode_func, (caddr_t) & res_nfs) == FALSE)
+             (ptr_svc, (xdrproc_t) xdr_dupreq_reply, (caddr_t) & dupreq_reply) == FALSE)
             {
               LogDebug(COMPONENT_DISPATCH,
                        "NFS DISPATCHER: FAILURE: Error while calling svc_sendreply");
               svcerr_systemerr(ptr_svc);
             }
 
-          V(mutex_cond_xprt[ptr_svc->XP_SOCK]);
+          if(reply_locked)
+            V(mutex_cond_xprt[ptr_svc->XP_SOCK]);
 
           LogFullDebug(COMPONENT_DISPATCH,
                        "After svc_sendreply on socket %d (dup req)",
@@ -867,8 +965,7 @@ static void nfs_rpc_execute(nfs_request_data_t * preqnfs,
                     }
                   /* Bad argument */
                   svcerr_auth(ptr_svc, AUTH_FAILED);
-                  if (nfs_dupreq_delete(rpcxid, ptr_req, preqnfs->xprt,
-                                        &pworker_data->dupreq_pool) != DUPREQ_SUCCESS)
+                  if (nfs_dupreq_delete(rpcxid, ptr_req, preqnfs->xprt) != DUPREQ_SUCCESS)
                     {
                       LogCrit(COMPONENT_DISPATCH,
                               "Attempt to delete duplicate request failed on line %d",
@@ -917,8 +1014,7 @@ static void nfs_rpc_execute(nfs_request_data_t * preqnfs,
                     }
                   /* Bad argument */
                   svcerr_auth(ptr_svc, AUTH_FAILED);
-                  if (nfs_dupreq_delete(rpcxid, ptr_req, preqnfs->xprt,
-                                        &pworker_data->dupreq_pool) != DUPREQ_SUCCESS)
+                  if (nfs_dupreq_delete(rpcxid, ptr_req, preqnfs->xprt) != DUPREQ_SUCCESS)
                     {
                       LogCrit(COMPONENT_DISPATCH,
                               "Attempt to delete duplicate request failed on line %d",
@@ -1022,8 +1118,7 @@ static void nfs_rpc_execute(nfs_request_data_t * preqnfs,
                 }
               /* Bad argument */
               svcerr_auth(ptr_svc, AUTH_FAILED);
-              if (nfs_dupreq_delete(rpcxid, ptr_req, preqnfs->xprt,
-                                    &pworker_data->dupreq_pool) != DUPREQ_SUCCESS)
+              if (nfs_dupreq_delete(rpcxid, ptr_req, preqnfs->xprt) != DUPREQ_SUCCESS)
                 {
                   LogCrit(COMPONENT_DISPATCH,
                           "Attempt to delete duplicate request failed on line %d",
@@ -1058,8 +1153,7 @@ static void nfs_rpc_execute(nfs_request_data_t * preqnfs,
                         "Export %s does not support AUTH_NONE",
                         pexport->dirname);
                 svcerr_auth(ptr_svc, AUTH_TOOWEAK);
-                if (nfs_dupreq_delete(rpcxid, ptr_req, preqnfs->xprt,
-                                      &pworker_data->dupreq_pool) != DUPREQ_SUCCESS)
+                if (nfs_dupreq_delete(rpcxid, ptr_req, preqnfs->xprt) != DUPREQ_SUCCESS)
                   {
                     LogCrit(COMPONENT_DISPATCH,
                             "Attempt to delete duplicate request failed on line %d",
@@ -1076,8 +1170,7 @@ static void nfs_rpc_execute(nfs_request_data_t * preqnfs,
                         "Export %s does not support AUTH_UNIX",
                         pexport->dirname);
                 svcerr_auth(ptr_svc, AUTH_TOOWEAK);
-                if (nfs_dupreq_delete(rpcxid, ptr_req, preqnfs->xprt,
-                                      &pworker_data->dupreq_pool) != DUPREQ_SUCCESS)
+                if (nfs_dupreq_delete(rpcxid, ptr_req, preqnfs->xprt) != DUPREQ_SUCCESS)
                   {
                     LogCrit(COMPONENT_DISPATCH,
                             "Attempt to delete duplicate request failed on line %d",
@@ -1097,8 +1190,7 @@ static void nfs_rpc_execute(nfs_request_data_t * preqnfs,
                 LogInfo(COMPONENT_DISPATCH,
                         "Export %s does not support RPCSEC_GSS",
                         pexport->dirname);
-                if (nfs_dupreq_delete(rpcxid, ptr_req, preqnfs->xprt,
-                                      &pworker_data->dupreq_pool) != DUPREQ_SUCCESS)
+                if (nfs_dupreq_delete(rpcxid, ptr_req, preqnfs->xprt) != DUPREQ_SUCCESS)
                   {
                     LogCrit(COMPONENT_DISPATCH,
                             "Attempt to delete duplicate request failed on line %d",
@@ -1124,8 +1216,7 @@ static void nfs_rpc_execute(nfs_request_data_t * preqnfs,
                                   "Export %s does not support RPCSEC_GSS_SVC_NONE",
                                   pexport->dirname);
                           svcerr_auth(ptr_svc, AUTH_TOOWEAK);
-                          if (nfs_dupreq_delete(rpcxid, ptr_req, preqnfs->xprt,
-                                                &pworker_data->dupreq_pool) != DUPREQ_SUCCESS)
+                          if (nfs_dupreq_delete(rpcxid, ptr_req, preqnfs->xprt) != DUPREQ_SUCCESS)
                             {
                               LogCrit(COMPONENT_DISPATCH,
                                       "Attempt to delete duplicate request failed on line %d",
@@ -1142,8 +1233,7 @@ static void nfs_rpc_execute(nfs_request_data_t * preqnfs,
                                   "Export %s does not support RPCSEC_GSS_SVC_INTEGRITY",
                                   pexport->dirname);
                           svcerr_auth(ptr_svc, AUTH_TOOWEAK);
-                          if (nfs_dupreq_delete(rpcxid, ptr_req, preqnfs->xprt,
-                                                &pworker_data->dupreq_pool) != DUPREQ_SUCCESS)
+                          if (nfs_dupreq_delete(rpcxid, ptr_req, preqnfs->xprt) != DUPREQ_SUCCESS)
                             {
                               LogCrit(COMPONENT_DISPATCH,
                                       "Attempt to delete duplicate request failed on line %d",
@@ -1160,8 +1250,7 @@ static void nfs_rpc_execute(nfs_request_data_t * preqnfs,
                                   "Export %s does not support RPCSEC_GSS_SVC_PRIVACY",
                                   pexport->dirname);
                           svcerr_auth(ptr_svc, AUTH_TOOWEAK);
-                          if (nfs_dupreq_delete(rpcxid, ptr_req, preqnfs->xprt,
-                                                &pworker_data->dupreq_pool) != DUPREQ_SUCCESS)
+                          if (nfs_dupreq_delete(rpcxid, ptr_req, preqnfs->xprt) != DUPREQ_SUCCESS)
                             {
                               LogCrit(COMPONENT_DISPATCH,
                                       "Attempt to delete duplicate request failed on line %d",
@@ -1176,8 +1265,7 @@ static void nfs_rpc_execute(nfs_request_data_t * preqnfs,
                               "Export %s does not support unknown RPCSEC_GSS_SVC %d",
                               pexport->dirname, (int) svc);
                       svcerr_auth(ptr_svc, AUTH_TOOWEAK);
-                      if (nfs_dupreq_delete(rpcxid, ptr_req, preqnfs->xprt,
-                                            &pworker_data->dupreq_pool) != DUPREQ_SUCCESS)
+                      if (nfs_dupreq_delete(rpcxid, ptr_req, preqnfs->xprt) != DUPREQ_SUCCESS)
                         {
                           LogCrit(COMPONENT_DISPATCH,
                                   "Attempt to delete duplicate request failed on line %d",
@@ -1193,8 +1281,7 @@ static void nfs_rpc_execute(nfs_request_data_t * preqnfs,
                     "Export %s does not support unknown oa_flavor %d",
                     pexport->dirname, (int) ptr_req->rq_cred.oa_flavor);
             svcerr_auth(ptr_svc, AUTH_TOOWEAK);
-            if (nfs_dupreq_delete(rpcxid, ptr_req, preqnfs->xprt,
-                                  &pworker_data->dupreq_pool) != DUPREQ_SUCCESS)
+            if (nfs_dupreq_delete(rpcxid, ptr_req, preqnfs->xprt) != DUPREQ_SUCCESS)
               {
                 LogCrit(COMPONENT_DISPATCH,
                         "Attempt to delete duplicate request failed on line %d",
@@ -1226,8 +1313,7 @@ static void nfs_rpc_execute(nfs_request_data_t * preqnfs,
           svcerr_auth(ptr_svc, AUTH_TOOWEAK);
           pworker_data->current_xid = 0;    /* No more xid managed */
 
-          if (nfs_dupreq_delete(rpcxid, ptr_req, preqnfs->xprt,
-                                &pworker_data->dupreq_pool) != DUPREQ_SUCCESS)
+          if (nfs_dupreq_delete(rpcxid, ptr_req, preqnfs->xprt) != DUPREQ_SUCCESS)
             {
               LogCrit(COMPONENT_DISPATCH,
                       "Attempt to delete duplicate request failed on line %d",
@@ -1246,8 +1332,7 @@ static void nfs_rpc_execute(nfs_request_data_t * preqnfs,
           svcerr_auth(ptr_svc, AUTH_TOOWEAK);
           pworker_data->current_xid = 0;    /* No more xid managed */
 
-          if (nfs_dupreq_delete(rpcxid, ptr_req, preqnfs->xprt,
-                                &pworker_data->dupreq_pool) != DUPREQ_SUCCESS)
+          if (nfs_dupreq_delete(rpcxid, ptr_req, preqnfs->xprt) != DUPREQ_SUCCESS)
             {
               LogCrit(COMPONENT_DISPATCH,
                       "Attempt to delete duplicate request failed on line %d",
@@ -1280,8 +1365,7 @@ static void nfs_rpc_execute(nfs_request_data_t * preqnfs,
       svcerr_auth( ptr_svc, AUTH_TOOWEAK );
       pworker_data->current_xid = 0;        /* No more xid managed */
 
-      if (nfs_dupreq_delete(rpcxid, ptr_req, preqnfs->xprt,
-                            &pworker_data->dupreq_pool) != DUPREQ_SUCCESS)
+      if (nfs_dupreq_delete(rpcxid, ptr_req, preqnfs->xprt) != DUPREQ_SUCCESS)
         {
           LogCrit(COMPONENT_DISPATCH,
                   "Attempt to delete duplicate request failed on line %d",
@@ -1352,8 +1436,7 @@ static void nfs_rpc_execute(nfs_request_data_t * preqnfs,
               svcerr_auth(ptr_svc, AUTH_TOOWEAK);
               pworker_data->current_xid = 0;    /* No more xid managed */
 
-              if (nfs_dupreq_delete(rpcxid, ptr_req, preqnfs->xprt,
-                                    &pworker_data->dupreq_pool) != DUPREQ_SUCCESS)
+              if (nfs_dupreq_delete(rpcxid, ptr_req, preqnfs->xprt) != DUPREQ_SUCCESS)
                 {
                   LogCrit(COMPONENT_DISPATCH,
                          "Attempt to delete duplicate request failed on line %d",
@@ -1365,6 +1448,7 @@ static void nfs_rpc_execute(nfs_request_data_t * preqnfs,
 
       /* processing */
       gettimeofday(timer_start, NULL);
+      svc_start = nfs_stat_now();
 
       LogDebug(COMPONENT_DISPATCH,
                "NFS DISPATCHER: Calling service function %s start_time %llu.%.6llu",
@@ -1403,6 +1487,7 @@ static void nfs_rpc_execute(nfs_request_data_t * preqnfs,
                                                      ptr_req, 
                                                      &res_nfs); 
 
+      svc_latency = nfs_stat_now() - svc_start;
       gettimeofday(&timer_end, NULL);
       timer_diff = time_diff(*timer_start, timer_end);
       memset(timer_start, 0, sizeof(struct timeval));
@@ -1430,6 +1515,12 @@ static void nfs_rpc_execute(nfs_request_data_t * preqnfs,
   nfs_stat_update(stat_type, &(pworker_data->stats.stat_req), ptr_req, &latency_stat);
   pworker_data->stats.nb_total_req += 1;
 
+  nfs_stat_counter_add(nfs_stat_counter_requests, 1);
+  if(rc == NFS_REQ_DROP)
+    nfs_stat_counter_add(nfs_stat_counter_dropped, 1);
+  if(svc_start != 0)
+    nfs_stat_histogram_record(nfs_rpc_get_histogram(pworker_data->pfuncdesc), svc_latency);
+
   /* Perform NFSv4 operations statistics if required */
   if(ptr_req->rq_vers == NFS_V4)
     if(ptr_req->rq_proc == NFSPROC4_COMPOUND)
@@ -1450,8 +1541,7 @@ static void nfs_rpc_execute(nfs_request_data_t * preqnfs,
        * later. We only remove a reply that is normally cached that has been
        * dropped. */
       if(do_dupreq_cache)
-        if (nfs_dupreq_delete(rpcxid, ptr_req, preqnfs->xprt,
-                              &pworker_data->dupreq_pool) != DUPREQ_SUCCESS)
+        if (nfs_dupreq_delete(rpcxid, ptr_req, preqnfs->xprt) != DUPREQ_SUCCESS)
           {
             LogCrit(COMPONENT_DISPATCH,
                     "Attempt to delete duplicate request failed on line %d",
@@ -1460,7 +1550,7 @@ static void nfs_rpc_execute(nfs_request_data_t * preqnfs,
     }
   else
     {
-      P(mutex_cond_xprt[ptr_svc->XP_SOCK]);
+      reply_locked = nfs_rpc_lock_reply(ptr_svc, ptr_req);
 
       LogFullDebug(COMPONENT_DISPATCH,
                    "Before svc_sendreply on socket %d",
@@ -1468,16 +1558,24 @@ static void nfs_rpc_execute(nfs_request_data_t * preqnfs,
 
       /* encoding the result on xdr output */
       CheckXprt(ptr_svc);
-      if(svc_sendreply(ptr_svc, pworker_data->pfuncdesc->xdr_encode_func, (caddr_t) & res_nfs) == FALSE)
+#ifdef _USE_NFS4_1
+      /* A replay of a session's slot is sent as it was encoded the first time */
+      if(pworker_data->drc_replay.buf != NULL)
+        sent = nfs41_Session_Replay_Send(ptr_svc, &pworker_data->drc_replay);
+      else
+#endif
+        sent = svc_sendreply(ptr_svc, pworker_data->pfuncdesc->xdr_encode_func,
+                             (caddr_t) & res_nfs);
+      if(sent == FALSE)
         {
           LogDebug(COMPONENT_DISPATCH,
                    "NFS DISPATCHER: FAILURE: Error while calling svc_sendreply");
           svcerr_systemerr(ptr_svc);
 
-          V(mutex_cond_xprt[ptr_svc->XP_SOCK]);
+          if(reply_locked)
+            V(mutex_cond_xprt[ptr_svc->XP_SOCK]);
 
-          if (nfs_dupreq_delete(rpcxid, ptr_req, preqnfs->xprt,
-                                &pworker_data->dupreq_pool) != DUPREQ_SUCCESS)
+          if (nfs_dupreq_delete(rpcxid, ptr_req, preqnfs->xprt) != DUPREQ_SUCCESS)
             {
               LogCrit(COMPONENT_DISPATCH,
                       "Attempt to delete duplicate request failed on line %d",
@@ -1490,7 +1588,8 @@ static void nfs_rpc_execute(nfs_request_data_t * preqnfs,
                    "After svc_sendreply on socket %d",
                    ptr_svc->XP_SOCK);
 
-      V(mutex_cond_xprt[ptr_svc->XP_SOCK]);
+      if(reply_locked)
+        V(mutex_cond_xprt[ptr_svc->XP_SOCK]);
 
       /* Mark request as finished */
       LogFullDebug(COMPONENT_DUPREQ, "YES?: %d", do_dupreq_cache);
@@ -1499,8 +1598,8 @@ static void nfs_rpc_execute(nfs_request_data_t * preqnfs,
           status = nfs_dupreq_finish(rpcxid,
                                      ptr_req,
                                      preqnfs->xprt,
-                                     &res_nfs,
-                                     lru_dupreq);
+                                     pworker_data->pfuncdesc->xdr_encode_func,
+                                     (caddr_t) & res_nfs);
         }
     } /* rc == NFS_REQ_DROP */
 
@@ -1514,24 +1613,21 @@ static void nfs_rpc_execute(nfs_request_data_t * preqnfs,
                 pworker_data->pfuncdesc->funcname);
       }
 
-  /* Free the reply.
-   * This should not be done if the request is dupreq cached because this will
-   * mark the dupreq cached info eligible for being reuse by other requests */
+  /* The requests that are not cached leave the cache once answered */
   if(!do_dupreq_cache)
     {
-      if (nfs_dupreq_delete(rpcxid, ptr_req, preqnfs->xprt,
-                            &pworker_data->dupreq_pool) != DUPREQ_SUCCESS)
+      if (nfs_dupreq_delete(rpcxid, ptr_req, preqnfs->xprt) != DUPREQ_SUCCESS)
         {
           LogCrit(COMPONENT_DISPATCH,
                   "Attempt to delete duplicate request failed on line %d",
                   __LINE__);
         }
-      /* Free only the non dropped requests */
-      if(rc == NFS_REQ_OK) {
-        pworker_data->pfuncdesc->free_function(&res_nfs);
-      }
-
     }
+
+  /* Free the reply, the cache keeps its own encoded copy.
+   * Free only the non dropped requests */
+  if(rc == NFS_REQ_OK)
+    pworker_data->pfuncdesc->free_function(&res_nfs);
 #ifdef _DEBUG_MEMLEAKS
   if(nb_iter_memleaks > 1000)
     {
@@ -1598,10 +1694,22 @@ const char *pause_rc_str[] =
   "PAUSE_EXIT",
 };
 
-worker_available_rc worker_available(unsigned long worker_index, unsigned int avg_number_pending)
+/**
+ * worker_available: tells if a worker can be given a new request.
+ *
+ * The state is read without taking the worker's request_mutex : the result is
+ * only a hint for the dispatcher, a request queued to a busy worker is
+ * eventually stolen by an idle one.
+ *
+ * @param worker_index index of the worker to check
+ *
+ * @return WORKER_AVAILABLE if the worker is idle, WORKER_BUSY if it has pending
+ * requests, other values if it can't take requests now.
+ */
+worker_available_rc worker_available(unsigned long worker_index)
 {
   worker_available_rc rc = WORKER_AVAILABLE;
-  P(workers_data[worker_index].request_mutex);
+
   switch(workers_data[worker_index].pause_state)
     {
       case STATE_AWAKE:
@@ -1619,7 +1727,7 @@ worker_available_rc worker_available(unsigned long worker_index, unsigned int av
                          "worker thread #%lu is doing garbage collection", worker_index);
             rc = WORKER_GC;
           }
-        else if(workers_data[worker_index].pending_request->nb_entry >= avg_number_pending)
+        else if(req_queue_length(&workers_data[worker_index].pending_request) > 0)
           {
             rc = WORKER_BUSY;
           }
@@ -1635,7 +1743,6 @@ worker_available_rc worker_available(unsigned long worker_index, unsigned int av
         rc = WORKER_EXIT;
         break;
     }
-  V(workers_data[worker_index].request_mutex);
 
   return rc;
 }
@@ -2107,9 +2214,6 @@ pause_rc wake_workers(awaken_reason_t reason)
 
 int nfs_Init_worker_data(nfs_worker_data_t * pdata)
 {
-  LRU_status_t status = LRU_LIST_SUCCESS;
-  char name[256];
-
   if(pthread_mutex_init(&(pdata->request_mutex), NULL) != 0)
     return -1;
 
@@ -2119,38 +2223,106 @@ int nfs_Init_worker_data(nfs_worker_data_t * pdata)
   if(pthread_cond_init(&(pdata->req_condvar), NULL) != 0)
     return -1;
 
-  sprintf(name, "Worker Thread #%u Pending Request", pdata->worker_index);
-  nfs_param.worker_param.lru_param.name = Str_Dup(name);
-
-  if((pdata->pending_request =
-      LRU_Init(nfs_param.worker_param.lru_param, &status)) == NULL)
-    {
-      LogError(COMPONENT_DISPATCH, ERR_LRU, ERR_LRU_LIST_INIT, status);
-      return -1;
-    }
-
-  sprintf(name, "Worker Thread #%u Duplicate Request", pdata->worker_index);
-  nfs_param.worker_param.lru_dupreq.name = Str_Dup(name);
-
-  if((pdata->duplicate_request =
-      LRU_Init(nfs_param.worker_param.lru_dupreq, &status)) == NULL)
+  if(req_queue_init(&pdata->pending_request,
+                    nfs_param.worker_param.pending_queue_size) != REQ_QUEUE_SUCCESS)
     {
-      LogError(COMPONENT_DISPATCH, ERR_LRU, ERR_LRU_LIST_INIT, status);
+      LogCrit(COMPONENT_DISPATCH,
+              "Could not allocate pending request queue for Worker Thread #%u",
+              pdata->worker_index);
       return -1;
     }
 
   pdata->passcounter = 0;
   pdata->is_ready = FALSE;
+  pdata->is_waiting = FALSE;
   pdata->gc_in_progress = FALSE;
   pdata->pfuncdesc = INVALID_FUNCDESC;
 
   return 0;
 }                               /* nfs_Init_worker_data */
 
+/* Number of workers sleeping on their req_condvar, used by DispatchWork to
+ * decide whether an idle sibling should be woken up to steal a request */
+static volatile unsigned int nb_waiting_workers = 0;
+
+#ifndef _NO_MOUNT_LIST
+/* Worker #0 is the only one to process MOUNT requests, its queue is never
+ * stolen from and it never steals from the other queues */
+#define worker_queue_can_be_stolen(index) ((index) != 0)
+#else
+#define worker_queue_can_be_stolen(index) TRUE
+#endif
+
+/**
+ * wake_worker: signals a worker sleeping on its req_condvar.
+ *
+ * @param worker_index index of the worker to wake up
+ */
+static void wake_worker(unsigned int worker_index)
+{
+  P(workers_data[worker_index].request_mutex);
+  if(pthread_cond_signal(&(workers_data[worker_index].req_condvar)) == -1)
+    {
+      V(workers_data[worker_index].request_mutex);
+      LogMajor(COMPONENT_THREAD,
+               "Error %d (%s) while signalling Worker Thread #%u... Exiting",
+               errno, strerror(errno), worker_index);
+      Fatal();
+    }
+  V(workers_data[worker_index].request_mutex);
+}                               /* wake_worker */
+
+/**
+ * DispatchWork: queues a request to a worker.
+ *
+ * The request is pushed to the worker's lock-free queue, no lock is taken on
+ * the fast path. The worker is only signalled if it is sleeping. If it is
+ * busy and some other worker is sleeping, that one is woken up so that it can
+ * steal the request.
+ *
+ * @param preq the request to be processed
+ * @param worker_index index of the worker the request is queued to
+ */
+void DispatchWork(request_data_t *preq, unsigned int worker_index)
+{
+  nfs_worker_data_t *pworker = &workers_data[worker_index];
+  unsigned int i;
+
+  /* The queue is bounded, when it is full wait for the worker to catch up */
+  while(req_queue_push(&pworker->pending_request, preq) != REQ_QUEUE_SUCCESS)
+    {
+      LogFullDebug(COMPONENT_DISPATCH,
+                   "Pending request queue of Worker Thread #%u is full",
+                   worker_index);
+      sched_yield();
+    }
+
+  /* Order the push before reading the waiting flags, this pairs with the
+   * barrier in worker_set_waiting */
+  __sync_synchronize();
+
+  if(pworker->is_waiting)
+    {
+      wake_worker(worker_index);
+      return;
+    }
+
+  if(nb_waiting_workers == 0 || !worker_queue_can_be_stolen(worker_index))
+    return;
+
+  for(i = 0; i < nfs_param.core_param.nb_worker; i++)
+    {
+      if(i != worker_index && worker_queue_can_be_stolen(i) &&
+         workers_data[i].is_waiting)
+        {
+          wake_worker(i);
+          return;
+        }
+    }
+}                               /* DispatchWork */
+
 void DispatchWorkNFS(request_data_t *pnfsreq, unsigned int worker_index)
 {
-  LRU_entry_t *pentry = NULL;
-  LRU_status_t status;
   struct svc_req *ptr_req = &pnfsreq->rcontent.nfs.req;
   unsigned int rpcxid = get_rpc_xid(ptr_req);
 
@@ -2158,36 +2330,54 @@ void DispatchWorkNFS(request_data_t *pnfsreq, unsigned int worker_index)
            "Awaking Worker Thread #%u for request %p, xid=%u",
            worker_index, pnfsreq, rpcxid);
 
-  P(workers_data[worker_index].request_mutex);
-  P(workers_data[worker_index].request_pool_mutex);
+  DispatchWork(pnfsreq, worker_index);
+}
 
-  pentry = LRU_new_entry(workers_data[worker_index].pending_request, &status);
+/**
+ * DispatchWorkFairShare: queues a request in the fair share between the clients.
+ *
+ * The request is taken by the first worker that looks at the fair share
+ * queue, one sleeping worker is woken up for it. The MOUNT worker does not
+ * serve this queue.
+ *
+ * @param preq the request to be processed
+ * @param paddr the address of the client
+ * @param exportid the export of the request, -1 if none
+ *
+ * @return NFS_FAIR_SHARE_SUCCESS, or an error if the request was not queued
+ * and has to be given to a worker with DispatchWorkNFS.
+ */
+int DispatchWorkFairShare(request_data_t *preq, sockaddr_t *paddr, int exportid)
+{
+  unsigned int i;
+  int rc;
 
-  if(pentry == NULL)
-    {
-      V(workers_data[worker_index].request_pool_mutex);
-      V(workers_data[worker_index].request_mutex);
-      LogMajor(COMPONENT_DISPATCH,
-               "Error while inserting pending request to Worker Thread #%u... Exiting",
-               worker_index);
-      Fatal();
-    }
+  if((rc = nfs_fair_share_enqueue(&preq->fair_share, paddr, exportid, preq)) !=
+     NFS_FAIR_SHARE_SUCCESS)
+    return rc;
 
-  pentry->buffdata.pdata = (caddr_t) pnfsreq;
-  pentry->buffdata.len = sizeof(*pnfsreq);
+  LogFullDebug(COMPONENT_DISPATCH,
+               "Request %p queued in the fair share, exportid=%d, xid=%u",
+               preq, exportid, get_rpc_xid(&preq->rcontent.nfs.req));
 
-  if(pthread_cond_signal(&(workers_data[worker_index].req_condvar)) == -1)
+  /* Order the push before reading the waiting flags, this pairs with the
+   * barrier in worker_set_waiting */
+  __sync_synchronize();
+
+  if(nb_waiting_workers == 0)
+    return rc;
+
+  for(i = 0; i < nfs_param.core_param.nb_worker; i++)
     {
-      V(workers_data[worker_index].request_pool_mutex);
-      V(workers_data[worker_index].request_mutex);
-      LogMajor(COMPONENT_THREAD,
-               "Error %d (%s) while signalling Worker Thread #%u... Exiting",
-               errno, strerror(errno), worker_index);
-      Fatal();
+      if(worker_queue_can_be_stolen(i) && workers_data[i].is_waiting)
+        {
+          wake_worker(i);
+          break;
+        }
     }
-  V(workers_data[worker_index].request_pool_mutex);
-  V(workers_data[worker_index].request_mutex);
-}
+
+  return rc;
+}                               /* DispatchWorkFairShare */
 
 enum auth_stat AuthenticateRequest(nfs_request_data_t *pnfsreq,
                                    bool_t *no_dispatch)
@@ -2256,7 +2446,8 @@ enum auth_stat AuthenticateRequest(nfs_request_data_t *pnfsreq,
 /**
  * _9p_execute: execute a 9p request.
  *
- * Executes 9P request
+ * Executes 9P request, then releases the reference the request held on its
+ * connection.
  *
  * @param pnfsreq      [INOUT] pointer to 9p request
  * @param pworker_data [INOUT] pointer to worker's specific data
@@ -2268,10 +2459,75 @@ static void _9p_execute( _9p_request_data_t * preq9p,
                           nfs_worker_data_t * pworker_data)
 {
   _9p_process_request( preq9p, pworker_data ) ;
+  _9p_conn_release( preq9p->pconn ) ;
   return ;
 } /* _9p_execute */
 #endif
 
+/**
+ * worker_get_request: gets the next request for a worker.
+ *
+ * The worker's own queue is looked at first, then the fair share queue. If
+ * both are empty, the request is stolen from the queue of another worker.
+ *
+ * @param pmydata the worker's data
+ *
+ * @return the request, or NULL if no request is pending.
+ */
+static request_data_t *worker_get_request(nfs_worker_data_t * pmydata)
+{
+  request_data_t *preq;
+  unsigned int i;
+  unsigned int victim;
+
+  preq = req_queue_pop(&pmydata->pending_request);
+  if(preq != NULL || !worker_queue_can_be_stolen(pmydata->worker_index))
+    return preq;
+
+  if((preq = (request_data_t *) nfs_fair_share_dequeue()) != NULL)
+    return preq;
+
+  /* Start right after our own queue so that thieves spread over the victims */
+  for(i = 1; i < nfs_param.core_param.nb_worker; i++)
+    {
+      victim = (pmydata->worker_index + i) % nfs_param.core_param.nb_worker;
+
+      if(!worker_queue_can_be_stolen(victim))
+        continue;
+
+      preq = req_queue_pop(&workers_data[victim].pending_request);
+      if(preq != NULL)
+        {
+          LogFullDebug(COMPONENT_DISPATCH,
+                       "Stole request %p from Worker Thread #%u",
+                       preq, victim);
+          return preq;
+        }
+    }
+
+  return NULL;
+}                               /* worker_get_request */
+
+/**
+ * worker_set_waiting: marks a worker as sleeping on its condition variable or not.
+ *
+ * The atomic operations are full memory barriers : a worker that has set its
+ * flag and then finds all the queues empty can't miss a request pushed by
+ * DispatchWork, that one will see the flag and signal the worker.
+ *
+ * @param pmydata the worker's data
+ * @param waiting TRUE when going to sleep, FALSE when waking up
+ */
+static void worker_set_waiting(nfs_worker_data_t * pmydata, unsigned int waiting)
+{
+  pmydata->is_waiting = waiting;
+
+  if(waiting)
+    __sync_fetch_and_add(&nb_waiting_workers, 1);
+  else
+    __sync_fetch_and_sub(&nb_waiting_workers, 1);
+}                               /* worker_set_waiting */
+
 /**
  * worker_thread: The main function for a worker thread
  *
@@ -2287,15 +2543,13 @@ static void _9p_execute( _9p_request_data_t * preq9p,
 void *worker_thread(void *IndexArg)
 {
   nfs_worker_data_t *pmydata;
-  request_data_t *pnfsreq;
-  LRU_entry_t *pentry;
+  request_data_t *pnfsreq = NULL;
   struct svc_req *preq;
   unsigned long worker_index;
-  bool_t found = FALSE;
   int rc = 0;
-  cache_inode_status_t cache_status = CACHE_INODE_SUCCESS;
-  unsigned int gc_allowed = FALSE;
   char thr_name[32];
+  struct timeval now;
+  struct timespec timeout;
 
 #ifdef _USE_MFSL
   fsal_status_t fsal_status ;
@@ -2321,8 +2575,8 @@ void *worker_thread(void *IndexArg)
     }
 
   LogFullDebug(COMPONENT_DISPATCH,
-               "Starting, nb_entry=%d",
-               pmydata->pending_request->nb_entry);
+               "Starting, nb_pending=%u",
+               req_queue_length(&pmydata->pending_request));
   /* Initialisation of the Buddy Malloc */
 #ifndef _NO_BUDDY_SYSTEM
   if((rc = BuddyInit(&nfs_param.buddy_param_worker)) != BUDDY_SUCCESS)
@@ -2445,22 +2699,21 @@ void *worker_thread(void *IndexArg)
 
       /* Wait on condition variable for work to be done */
       LogFullDebug(COMPONENT_DISPATCH,
-                   "waiting for requests to process, nb_entry=%d, nb_invalid=%d",
-                   pmydata->pending_request->nb_entry,
-                   pmydata->pending_request->nb_invalid);
+                   "waiting for requests to process, nb_pending=%u",
+                   req_queue_length(&pmydata->pending_request));
 
       P(pmydata->request_mutex);
       while(1)
        {
          if(pmydata->pause_state == STATE_AWAKE &&
-            pmydata->pending_request->nb_entry != pmydata->pending_request->nb_invalid)
+            (pnfsreq != NULL ||
+             (pnfsreq = worker_get_request(pmydata)) != NULL))
            {
              /* We have something to do, and we don't need to pause. */
              LogFullDebug(COMPONENT_DISPATCH,
-                          "Have work, pause_state: %s, nb_entry=%u, nb_invalid=%u",
+                          "Have work, pause_state: %s, nb_pending=%u",
                           pause_state_str[pmydata->pause_state],
-                          pmydata->pending_request->nb_entry,
-                          pmydata->pending_request->nb_invalid);
+                          req_queue_length(&pmydata->pending_request));
              break;
            }
 
@@ -2486,6 +2739,34 @@ void *worker_thread(void *IndexArg)
                continue;
 
              case STATE_AWAKE:
+               /* Advertise we are going to sleep, then look at the queues
+                * once more: a request pushed before the flag was visible
+                * would not be signalled */
+               worker_set_waiting(pmydata, TRUE);
+               if((pnfsreq = worker_get_request(pmydata)) == NULL)
+                 {
+                   if(worker_queue_can_be_stolen(pmydata->worker_index) &&
+                      nfs_fair_share_length() > 0)
+                     {
+                       /* Requests are held by a rate cap, nobody will signal
+                        * when they may go: look again at the next tick */
+                       gettimeofday(&now, NULL);
+                       timeout.tv_sec = now.tv_sec;
+                       timeout.tv_nsec = now.tv_usec * 1000 + NFS_FAIR_SHARE_TICK * 1000000;
+                       if(timeout.tv_nsec >= 1000000000)
+                         {
+                           timeout.tv_sec += 1;
+                           timeout.tv_nsec -= 1000000000;
+                         }
+                       pthread_cond_timedwait(&(pmydata->req_condvar),
+                                              &(pmydata->request_mutex), &timeout);
+                     }
+                   else
+                     pthread_cond_wait(&(pmydata->req_condvar), &(pmydata->request_mutex));
+                 }
+               worker_set_waiting(pmydata, FALSE);
+               break;
+
              case STATE_PAUSED:
                /* Wait for something to do */
                pthread_cond_wait(&(pmydata->req_condvar), &(pmydata->request_mutex));
@@ -2505,38 +2786,16 @@ void *worker_thread(void *IndexArg)
                    "Processing a new request");
       V(pmydata->request_mutex);
 
-      found = FALSE;
-      P(pmydata->request_pool_mutex);
-
-      for(pentry = pmydata->pending_request->LRU; pentry != NULL; pentry = pentry->next)
-        {
-          if(pentry->valid_state == LRU_ENTRY_VALID)
-            {
-              found = TRUE;
-              break;
-            }
-        }
-
-      V(pmydata->request_pool_mutex);
-
-      if(!found)
-        {
-          LogMajor(COMPONENT_DISPATCH,
-                   "No pending request available");
-          continue;             /* return to main loop */
-        }
+      /* The export list read by the request is kept until it is done */
+      nfs_export_epoch_enter(pmydata);
 
-      pnfsreq = (request_data_t *) (pentry->buffdata.pdata);
-
-     
       switch( pnfsreq->rtype )
        {
           case NFS_REQUEST:
            LogFullDebug(COMPONENT_DISPATCH,
-                        "I have some work to do, pnfsreq=%p, length=%d, invalid=%d, xid=%lu",
+                        "I have some work to do, pnfsreq=%p, length=%u, xid=%lu",
                         pnfsreq,
-                        pmydata->pending_request->nb_entry,
-                        pmydata->pending_request->nb_invalid,
+                        req_queue_length(&pmydata->pending_request),
                         (unsigned long) pnfsreq->rcontent.nfs.msg.rm_xid);
 
            if(pnfsreq->rcontent.nfs.xprt->XP_SOCK == 0)
@@ -2557,9 +2816,20 @@ void *worker_thread(void *IndexArg)
                            (int)preq->rq_prog, (int)preq->rq_vers,
                            (int)preq->rq_proc, preq->rq_xprt);
 
+              /* The first FSAL call of a NFSv3 request fails with a DELAY
+               * error rather than wait behind a congested export. A NFSv4
+               * COMPOUND may have done some of its operations before the
+               * call, it always waits */
+              if(preq->rq_prog == nfs_param.core_param.program[P_NFS] &&
+                 preq->rq_vers == NFS_V3)
+                FSAL_SetCongestionDelay(TRUE);
+
               if(is_rpc_call_valid(preq->rq_xprt, preq) == TRUE)
                   nfs_rpc_execute(&pnfsreq->rcontent.nfs, pmydata);
             }
+
+           /* The reply is sent, the connection may be read again */
+           nfs_rpc_release_conn(&pnfsreq->rcontent.nfs);
            break ;
 
 	  case _9P_REQUEST:
@@ -2571,69 +2841,27 @@ void *worker_thread(void *IndexArg)
 	    break ;
          }
 
-      /* Free the req by releasing the entry */
+      FSAL_SetCongestionDelay(FALSE);
+      nfs_export_epoch_exit(pmydata);
+
+      /* Free the req by sending it back to the pool it was taken from,
+       * which is not ours if the request was stolen */
       LogFullDebug(COMPONENT_DISPATCH,
-                   "Invalidating processed entry");
-      P(pmydata->request_pool_mutex);
-      if(LRU_invalidate(pmydata->pending_request, pentry) != LRU_LIST_SUCCESS)
-        {
-          LogCrit(COMPONENT_DISPATCH,
-                  "Incoherency: released entry for dispatch could not be tagged invalid");
-        }
-      V(pmydata->request_pool_mutex);
+                   "Releasing processed request");
+      P(workers_data[pnfsreq->pool_index].request_pool_mutex);
+      ReleaseToPool(pnfsreq, &workers_data[pnfsreq->pool_index].request_pool);
+      V(workers_data[pnfsreq->pool_index].request_pool_mutex);
+      pnfsreq = NULL;
 
       if(pmydata->passcounter > nfs_param.worker_param.nb_before_gc)
         {
-          /* Garbage collection on dup req cache */
+          /* Garbage collection on dup req cache, for the partitions that
+           * had no request finishing recently */
           LogFullDebug(COMPONENT_DISPATCH,
-                       "before dupreq invalidation nb_entry=%d nb_invalid=%d",
-                       pmydata->duplicate_request->nb_entry,
-                       pmydata->duplicate_request->nb_invalid);
-          if((rc =
-              LRU_invalidate_by_function(pmydata->duplicate_request,
-                                         nfs_dupreq_gc_function,
-                                         NULL)) != LRU_LIST_SUCCESS)
-            {
-              LogCrit(COMPONENT_DISPATCH,
-                      "FAILURE: Impossible to invalidate entries for duplicate request cache (error %d)",
-                      rc);
-            }
-          LogFullDebug(COMPONENT_DISPATCH,
-                       "after dupreq invalidation nb_entry=%d nb_invalid=%d",
-                       pmydata->duplicate_request->nb_entry,
-                       pmydata->duplicate_request->nb_invalid);
-          if((rc =
-              LRU_gc_invalid(pmydata->duplicate_request,
-                             (void *)&pmydata->dupreq_pool)) != LRU_LIST_SUCCESS)
-            LogCrit(COMPONENT_DISPATCH,
-                    "FAILURE: Impossible to gc entries for duplicate request cache (error %d)",
-                    rc);
-          else
-            LogFullDebug(COMPONENT_DISPATCH,
-                         "gc entries for duplicate request cache OK");
+                       "gc entries for duplicate request cache");
+          nfs_dupreq_gc();
 
-          LogFullDebug(COMPONENT_DISPATCH,
-                       "after dupreq gc nb_entry=%d nb_invalid=%d",
-                       pmydata->duplicate_request->nb_entry,
-                       pmydata->duplicate_request->nb_invalid);
-
-          /* Performing garbabbge collection */
-          LogFullDebug(COMPONENT_DISPATCH,
-                       "Garbage collecting on pending request list");
           pmydata->passcounter = 0;
-
-          P(pmydata->request_pool_mutex);
-
-          if(LRU_gc_invalid(pmydata->pending_request, (void *)&pmydata->request_pool) !=
-             LRU_LIST_SUCCESS)
-            LogCrit(COMPONENT_DISPATCH,
-                    "ERROR: Impossible garbage collection on pending request list");
-          else
-            LogFullDebug(COMPONENT_DISPATCH,
-                         "Garbage collection on pending request list OK");
-
-          V(pmydata->request_pool_mutex);
-
         }
       else
         LogFullDebug(COMPONENT_DISPATCH,
@@ -2641,41 +2869,7 @@ void *worker_thread(void *IndexArg)
                      pmydata->passcounter, nfs_param.worker_param.nb_before_gc);
       pmydata->passcounter += 1;
 
-      /* If needed, perform garbage collection on cache_inode layer */
-      P(lock_nb_current_gc_workers);
-      if(nb_current_gc_workers < nfs_param.core_param.nb_max_concurrent_gc)
-        {
-          nb_current_gc_workers += 1;
-          gc_allowed = TRUE;
-        }
-      else
-        gc_allowed = FALSE;
-      V(lock_nb_current_gc_workers);
-
       P(pmydata->request_mutex);
-      if(gc_allowed == TRUE && pmydata->pause_state == STATE_AWAKE)
-        {
-          pmydata->gc_in_progress = TRUE;
-          V(pmydata->request_mutex);
-          LogFullDebug(COMPONENT_DISPATCH,
-                       "There are %d concurrent garbage collection",
-                       nb_current_gc_workers);
-
-          if(cache_inode_gc(pmydata->ht,
-                            &(pmydata->cache_inode_client),
-                            &cache_status) != CACHE_INODE_SUCCESS)
-            {
-              LogCrit(COMPONENT_DISPATCH,
-                      "NFS WORKER: FAILURE: Bad cache_inode garbage collection");
-            }
-
-          P(lock_nb_current_gc_workers);
-          nb_current_gc_workers -= 1;
-          V(lock_nb_current_gc_workers);
-
-          P(pmydata->request_mutex);
-          pmydata->gc_in_progress = FALSE;
-        }
 #ifdef _USE_MFSL
       /* As MFSL context are refresh, and because this could be a time consuming operation, the worker is
        * set as "making garbagge collection" to avoid new requests to come in its pending queue */
@@ -134,8 +134,10 @@ int _9p_attach( _9p_request_data_t * preq9p,
       return rc ;
     }
  
-  /* Set pexport and fid id in fid */
+  /* Set pexport and fid id in fid, the fid holds its export until it is clunked */
   pfid= &preq9p->pconn->fids[*fid] ;
+  nfs_export_get( pexport ) ;
+  nfs_export_put( pfid->pexport ) ;
   pfid->pexport = pexport ;
   pfid->fid = *fid ;
  
@@ -86,6 +86,7 @@ int _9p_clunk( _9p_request_data_t * preq9p,
   pfid =  &preq9p->pconn->fids[*fid] ;
 
   /* Clean the fid */
+  nfs_export_put( pfid->pexport ) ;
   memset( (char *)pfid, 0, sizeof( _9p_fid_t ) ) ;
 
   /* Build the reply */
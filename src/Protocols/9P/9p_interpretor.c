@@ -43,6 +43,9 @@
 #include <stdio.h>
 #include <string.h>
 #include <pthread.h>
+#include <errno.h>
+#include <poll.h>
+#include <sys/socket.h>
 
 
 #include "stuff_alloc.h"
@@ -57,6 +60,7 @@
 #include "nfs_dupreq.h"
 #include "nfs_file_handle.h"
 #include "nfs_stat.h"
+#include "nfs_stat_registry.h"
 #include "SemN.h"
 
 /* This array maps a 9P Tmessage type to the 
@@ -120,6 +124,35 @@ const _9p_function_desc_t _9pfuncdesc[] = {
         { _9p_dummy, "no function" }
 } ;
 
+#define _9P_NB_FUNCDESC (sizeof( _9pfuncdesc ) / sizeof( _9p_function_desc_t ))
+
+/* Latency histogram of each 9P function */
+static int _9p_histograms[_9P_NB_FUNCDESC] ;
+static int _9p_stats_registered = FALSE ;
+
+/**
+ * _9p_register_stats: registers the latency histograms of the 9P functions.
+ *
+ * Histograms are named like "9p._9P_TREAD". Must be called before the
+ * workers are started.
+ *
+ * @return nothing (void function)
+ *
+ */
+void _9p_register_stats( void )
+{
+  char name[NFS_STAT_NAME_LEN] ;
+  unsigned int i ;
+
+  for( i = 0 ; i < _9P_NB_FUNCDESC ; i++ )
+   {
+     snprintf( name, NFS_STAT_NAME_LEN, "9p.%s", _9pfuncdesc[i].funcname ) ;
+     _9p_histograms[i] = nfs_stat_register_histogram( name ) ;
+   }
+
+  _9p_stats_registered = TRUE ;
+} /* _9p_register_stats */
+
 /* Will disappear when all work will have been done */
 int _9p_dummy( _9p_request_data_t * preq9p, 
                void * pworker_data,
@@ -141,6 +174,61 @@ int _9p_dummy( _9p_request_data_t * preq9p,
 } /* _9p_dummy */
 
 
+/**
+ * _9p_send_reply: sends a reply on a 9P connection.
+ *
+ * The socket is non blocking and shared by all the workers processing
+ * requests of this connection: the reply is sent whole under the connection's
+ * lock, waiting for the client to make room when the socket buffer is full.
+ *
+ * @param pconn   [IN] connection to send the reply on
+ * @param data    [IN] reply, including its header
+ * @param datalen [IN] length of the reply
+ *
+ * @return 0 if successful, -1 otherwise.
+ *
+ */
+static int _9p_send_reply( _9p_conn_t * pconn, char * data, u32 datalen )
+{
+  struct pollfd fds ;
+  ssize_t sent = 0 ;
+  u32 offset = 0 ;
+  int rc = 0 ;
+
+  P( pconn->lock ) ;
+
+  while( offset < datalen )
+   {
+     sent = send( pconn->sockfd, data + offset, datalen - offset, MSG_NOSIGNAL ) ;
+
+     if( sent > 0 )
+      {
+        offset += sent ;
+        continue ;
+      }
+
+     if( sent < 0 && errno == EINTR )
+       continue ;
+
+     if( sent < 0 && ( errno == EAGAIN || errno == EWOULDBLOCK ) )
+      {
+        fds.fd = pconn->sockfd ;
+        fds.events = POLLOUT ;
+        fds.revents = 0 ;
+
+        if( poll( &fds, 1, _9P_SEND_TIMEOUT ) > 0 || errno == EINTR )
+          continue ;
+      }
+
+     rc = -1 ;
+     break ;
+   }
+
+  V( pconn->lock ) ;
+
+  return rc ;
+} /* _9p_send_reply */
+
 void _9p_process_request( _9p_request_data_t * preq9p, nfs_worker_data_t * pworker_data)
 {
   char * msgdata ;
@@ -148,6 +236,7 @@ void _9p_process_request( _9p_request_data_t * preq9p, nfs_worker_data_t * pwork
   u8 * pmsgtype = NULL ;
   u32 outdatalen = 0 ;
   int rc = 0 ; 
+  uint64_t start = 0 ;
 
   char replydata[_9P_MSG_SIZE] ;
 
@@ -170,11 +259,18 @@ void _9p_process_request( _9p_request_data_t * preq9p, nfs_worker_data_t * pwork
   LogFullDebug( COMPONENT_9P, "9P msg: length=%u type (%u|%s)",  *pmsglen, (u32)*pmsgtype, _9pfuncdesc[_9ptabindex[*pmsgtype]].funcname ) ;
 
   /* Call the 9P service function */  
-  if(  ( ( rc = _9pfuncdesc[_9ptabindex[*pmsgtype]].service_function( preq9p, 
-                                                                      (void *)pworker_data,
-                                                                      &outdatalen, 
-                                                                      replydata ) ) < 0 )  ||
-             ( send( preq9p->pconn->sockfd, replydata, outdatalen, 0 ) != outdatalen ) )
+  if( _9p_stats_registered )
+    start = nfs_stat_now() ;
+
+  rc = _9pfuncdesc[_9ptabindex[*pmsgtype]].service_function( preq9p, 
+                                                            (void *)pworker_data,
+                                                            &outdatalen, 
+                                                            replydata ) ;
+
+  if( start != 0 )
+    nfs_stat_histogram_record( _9p_histograms[_9ptabindex[*pmsgtype]], nfs_stat_now() - start ) ;
+
+  if( ( rc < 0 ) || ( _9p_send_reply( preq9p->pconn, replydata, outdatalen ) != 0 ) )
      LogDebug( COMPONENT_9P, "%s: Error", _9pfuncdesc[_9ptabindex[*pmsgtype]].funcname ) ;
 
   return ;
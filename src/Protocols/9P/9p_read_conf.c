@@ -91,6 +91,18 @@ int _9p_read_conf( config_file_t   in_config,
         {
           pparam->_9p_port = atoi( key_value ) ;
         }
+      else if(!strcasecmp(key_name, "Nb_IO_Threads"))
+        {
+          pparam->nb_io_threads = atoi( key_value ) ;
+
+          if( pparam->nb_io_threads == 0 || pparam->nb_io_threads > _9P_MAX_IO_THREADS )
+            {
+              fprintf(stderr,
+                      "9P: ERROR: Nb_IO_Threads must be between 1 and %u\n",
+                      _9P_MAX_IO_THREADS);
+              return -1 ;
+            }
+        }
       else if(!strcasecmp(key_name, "DebugLevel"))
         {
           DebugLevel = ReturnLevelAscii(key_value);
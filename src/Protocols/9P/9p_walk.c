@@ -122,6 +122,8 @@ int _9p_walk( _9p_request_data_t * preq9p,
   if( *nwname == 0 )
    {
       /* Cloning operation */
+      nfs_export_get( pfid->pexport ) ;
+      nfs_export_put( pnewfid->pexport ) ;
       memcpy( (char *)pnewfid, (char *)pfid, sizeof( _9p_fid_t ) ) ;
   
       /* Set the new fid id */
@@ -131,6 +133,8 @@ int _9p_walk( _9p_request_data_t * preq9p,
    {
       pnewfid->fid = *newfid ;
       pnewfid->fsal_op_context = pfid->fsal_op_context ;
+      nfs_export_get( pfid->pexport ) ;
+      nfs_export_put( pnewfid->pexport ) ;
       pnewfid->pexport = pfid->pexport ;
 
       /* the walk is in fact a lookup */
@@ -121,40 +121,30 @@ int mnt_Mnt(nfs_arg_t * parg /* IN      */ ,
   /*
    * Find the export for the dirname (using as well Path or Tag ) 
    */
-  for(p_current_item = pexport; p_current_item != NULL;
-      p_current_item = p_current_item->next)
+  if(exportPath[0] != '/')
     {
-      if(exportPath[0] != '/')
+      /* The input value may be a "Tag" */
+      if((p_current_item = nfs_Get_export_by_tag(pexport, exportPath)) != NULL)
         {
-          /* The input value may be a "Tag" */
-          if(!strcmp(exportPath, p_current_item->FS_tag))
-            {
-              strncpy(exported_path, p_current_item->fullpath, MAXPATHLEN);
-              bytag = TRUE;
-              break;
-            }
+          strncpy(exported_path, p_current_item->fullpath, MAXPATHLEN);
+          bytag = TRUE;
         }
+    }
+  else if((p_current_item = nfs_Get_export_by_path(pexport, exportPath)) != NULL)
+    {
+      /* Make sure the path in export entry ends with a '/', if not adds one */
+      if(p_current_item->fullpath[strlen(p_current_item->fullpath) - 1] == '/')
+        strncpy(tmplist_path, p_current_item->fullpath, MAXPATHLEN);
       else
-        {
-          /* Make sure the path in export entry ends with a '/', if not adds one */
-          if(p_current_item->fullpath[strlen(p_current_item->fullpath) - 1] == '/')
-            strncpy(tmplist_path, p_current_item->fullpath, MAXPATHLEN);
-          else
-            snprintf(tmplist_path, MAXPATHLEN, "%s/", p_current_item->fullpath);
+        snprintf(tmplist_path, MAXPATHLEN, "%s/", p_current_item->fullpath);
 
-          /* Make sure that the argument from MNT ends with a '/', if not adds one */
-          if(exportPath[strlen(exportPath) - 1] == '/')
-            strncpy(tmpexport_path, exportPath, MAXPATHLEN);
-          else
-            snprintf(tmpexport_path, MAXPATHLEN, "%s/", exportPath);
+      /* Make sure that the argument from MNT ends with a '/', if not adds one */
+      if(exportPath[strlen(exportPath) - 1] == '/')
+        strncpy(tmpexport_path, exportPath, MAXPATHLEN);
+      else
+        snprintf(tmpexport_path, MAXPATHLEN, "%s/", exportPath);
 
-          /* Is tmplist_path a subdirectory of tmpexport_path ? */
-          if(!strncmp(tmplist_path, tmpexport_path, strlen(tmplist_path)))
-            {
-              strncpy(exported_path, p_current_item->fullpath, MAXPATHLEN);
-              break;
-            }
-        }
+      strncpy(exported_path, p_current_item->fullpath, MAXPATHLEN);
     }
 
   /* if p_current_item is not null,
@@ -162,8 +162,7 @@ int nfs3_Commit(nfs_arg_t * parg,
                  ppre_attr, ppre_attr, &(pres->res_commit3.COMMIT3res_u.resok.file_wcc));
 
   /* Set the write verifier */
-  memcpy(pres->res_commit3.COMMIT3res_u.resok.verf, NFS3_write_verifier,
-         sizeof(writeverf3));
+  nfs3_GetWriteVerifier(pres->res_commit3.COMMIT3res_u.resok.verf);
   pres->res_commit3.status = NFS3_OK;
 
   return NFS_REQ_OK;
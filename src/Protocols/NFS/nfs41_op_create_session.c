@@ -117,7 +117,7 @@ int nfs41_op_create_session(struct nfs_argop4 *op,
          && (pnfs_clientid->create_session_slot.cache_used == TRUE))
         {
           data->use_drc = TRUE;
-          data->pcached_res = pnfs_clientid->create_session_slot.cached_result;
+          data->pcached_slot = &pnfs_clientid->create_session_slot;
 
           res_CREATE_SESSION4.csr_status = NFS4_OK;
           return res_CREATE_SESSION4.csr_status;
@@ -159,12 +159,22 @@ int nfs41_op_create_session(struct nfs_argop4 *op,
   pnfs41_session->fore_channel_attrs = arg_CREATE_SESSION4.csa_fore_chan_attrs;
   pnfs41_session->back_channel_attrs = arg_CREATE_SESSION4.csa_back_chan_attrs;
 
+  /* Size the slot table from the ca_maxrequests asked by the client */
+  if(!nfs41_Session_Alloc_Slots(pnfs41_session,
+                                arg_CREATE_SESSION4.csa_fore_chan_attrs.ca_maxrequests))
+    {
+      res_CREATE_SESSION4.csr_status = NFS4ERR_SERVERFAULT;
+      return res_CREATE_SESSION4.csr_status;
+    }
+
   /* Set ca_maxrequests */
-  pnfs41_session->fore_channel_attrs.ca_maxrequests = NFS41_NB_SLOTS;
-  pnfs41_session->fore_channel_attrs.ca_maxrequests = NFS41_NB_SLOTS;
+  pnfs41_session->fore_channel_attrs.ca_maxrequests = pnfs41_session->nb_slots;
+  if(pnfs41_session->fore_channel_attrs.ca_maxresponsesize_cached > NFS41_DRC_SIZE)
+    pnfs41_session->fore_channel_attrs.ca_maxresponsesize_cached = NFS41_DRC_SIZE;
 
   if(nfs41_Build_sessionid(&clientid, pnfs41_session->session_id) != 1)
     {
+      nfs41_Session_Free_Slots(pnfs41_session);
       res_CREATE_SESSION4.csr_status = NFS4ERR_SERVERFAULT;
       return res_CREATE_SESSION4.csr_status;
     }
@@ -183,11 +193,11 @@ int nfs41_op_create_session(struct nfs_argop4 *op,
          pnfs41_session->session_id, NFS4_SESSIONID_SIZE);
 
   /* Create Session replay cache */
-  data->pcached_res = pnfs_clientid->create_session_slot.cached_result;
-  pnfs_clientid->create_session_slot.cache_used = TRUE;
+  data->pcached_slot = &pnfs_clientid->create_session_slot;
 
   if(!nfs41_Session_Set(pnfs41_session->session_id, pnfs41_session))
     {
+      nfs41_Session_Free_Slots(pnfs41_session);
       res_CREATE_SESSION4.csr_status = NFS4ERR_SERVERFAULT;     /* Maybe a more precise status would be better */
       return res_CREATE_SESSION4.csr_status;
     }
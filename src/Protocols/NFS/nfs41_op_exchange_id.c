@@ -254,6 +254,8 @@ int nfs41_op_exchange_id(struct nfs_argop4 *op,
       nfs_clientid.last_renew = 0;
       nfs_clientid.nb_session = 0;
       nfs_clientid.create_session_sequence = 1;
+      memset(&nfs_clientid.create_session_slot, 0, sizeof(nfs41_session_slot_t));
+      pthread_mutex_init(&nfs_clientid.create_session_slot.lock, NULL);
       nfs_clientid.credential = data->credential;
 
       if(gethostname(nfs_clientid.server_owner, MAXNAMLEN) == -1)
@@ -85,6 +85,9 @@ int nfs41_op_sequence(struct nfs_argop4 *op,
 #define res_SEQUENCE4  resp->nfs_resop4_u.opsequence
 
   nfs41_session_t *psession;
+  nfs41_session_slot_t *pslot;
+  nfs_worker_data_t *pworker = NULL;
+  unsigned int queue_length = 0;
 
   resp->resop = NFS4_OP_SEQUENCE;
   res_SEQUENCE4.sr_status = NFS4_OK;
@@ -102,26 +105,33 @@ int nfs41_op_sequence(struct nfs_argop4 *op,
       return res_SEQUENCE4.sr_status;
     }
 
-  /* Check is slot is compliant with ca_maxrequests */
-  if(arg_SEQUENCE4.sa_slotid >= psession->fore_channel_attrs.ca_maxrequests)
+  /* Keep memory of the session in the COMPOUND's data, its reference is
+   * released with the COMPOUND's data */
+  data->psession = psession;
+
+  /* Check is slot is compliant with the slot table granted at CREATE_SESSION */
+  if(arg_SEQUENCE4.sa_slotid >= psession->nb_slots)
     {
       res_SEQUENCE4.sr_status = NFS4ERR_BADSLOT;
       return res_SEQUENCE4.sr_status;
     }
 
+  pslot = &psession->slots[arg_SEQUENCE4.sa_slotid];
+
   /* By default, no DRC replay */
   data->use_drc = FALSE;
 
-  P(psession->slots[arg_SEQUENCE4.sa_slotid].lock);
-  if(psession->slots[arg_SEQUENCE4.sa_slotid].sequence + 1 != arg_SEQUENCE4.sa_sequenceid)
+  P(pslot->lock);
+  if(pslot->sequence + 1 != arg_SEQUENCE4.sa_sequenceid)
     {
-      if(psession->slots[arg_SEQUENCE4.sa_slotid].sequence == arg_SEQUENCE4.sa_sequenceid)
+      if(pslot->sequence == arg_SEQUENCE4.sa_sequenceid)
         {
-          if(psession->slots[arg_SEQUENCE4.sa_slotid].cache_used == TRUE)
+          if(pslot->cache_used == TRUE)
             {
               /* Replay operation through the DRC */
               data->use_drc = TRUE;
-              data->pcached_res = psession->slots[arg_SEQUENCE4.sa_slotid].cached_result;
+              data->pcached_slot = pslot;
+              V(pslot->lock);
 
               res_SEQUENCE4.sr_status = NFS4_OK;
               return res_SEQUENCE4.sr_status;
@@ -129,41 +139,44 @@ int nfs41_op_sequence(struct nfs_argop4 *op,
           else
             {
               /* Illegal replay */
+              V(pslot->lock);
               res_SEQUENCE4.sr_status = NFS4ERR_RETRY_UNCACHED_REP;
               return res_SEQUENCE4.sr_status;
             }
         }
-      V(psession->slots[arg_SEQUENCE4.sa_slotid].lock);
+      V(pslot->lock);
       res_SEQUENCE4.sr_status = NFS4ERR_SEQ_MISORDERED;
       return res_SEQUENCE4.sr_status;
     }
 
-  /* Keep memory of the session in the COMPOUND's data */
-  data->psession = psession;
-
   /* Update the sequence id within the slot */
-  psession->slots[arg_SEQUENCE4.sa_slotid].sequence += 1;
+  pslot->sequence += 1;
 
-  memcpy((char *)res_SEQUENCE4.SEQUENCE4res_u.sr_resok4.sr_sessionid,
-         (char *)arg_SEQUENCE4.sa_sessionid, NFS4_SESSIONID_SIZE);
-  res_SEQUENCE4.SEQUENCE4res_u.sr_resok4.sr_sequenceid =
-      psession->slots[arg_SEQUENCE4.sa_slotid].sequence;
-  res_SEQUENCE4.SEQUENCE4res_u.sr_resok4.sr_slotid = arg_SEQUENCE4.sa_slotid;
-  res_SEQUENCE4.SEQUENCE4res_u.sr_resok4.sr_highest_slotid = NFS41_NB_SLOTS - 1;
-  res_SEQUENCE4.SEQUENCE4res_u.sr_resok4.sr_target_highest_slotid = arg_SEQUENCE4.sa_slotid;    /* Maybe not the best choice */
-  res_SEQUENCE4.SEQUENCE4res_u.sr_resok4.sr_status_flags = 0;   /* What is to be set here ? */
+  /* The reply to the previous request in this slot will never be replayed */
+  nfs41_Session_Slot_Drop(pslot);
 
   if(arg_SEQUENCE4.sa_cachethis == TRUE)
-    {
-      data->pcached_res = psession->slots[arg_SEQUENCE4.sa_slotid].cached_result;
-      psession->slots[arg_SEQUENCE4.sa_slotid].cache_used = TRUE;
-    }
+    data->pcached_slot = pslot;
   else
+    data->pcached_slot = NULL;
+
+  memcpy((char *)res_SEQUENCE4.SEQUENCE4res_u.sr_resok4.sr_sessionid,
+         (char *)arg_SEQUENCE4.sa_sessionid, NFS4_SESSIONID_SIZE);
+  res_SEQUENCE4.SEQUENCE4res_u.sr_resok4.sr_sequenceid = pslot->sequence;
+  V(pslot->lock);
+
+  /* Grow or shrink the slots the client should use according to the server's load */
+  if(data->pclient != NULL && data->pclient->pworker != NULL)
     {
-      data->pcached_res = NULL;
-      psession->slots[arg_SEQUENCE4.sa_slotid].cache_used = FALSE;
+      pworker = (nfs_worker_data_t *) data->pclient->pworker;
+      queue_length = req_queue_length(&pworker->pending_request);
     }
-  V(psession->slots[arg_SEQUENCE4.sa_slotid].lock);
+
+  res_SEQUENCE4.SEQUENCE4res_u.sr_resok4.sr_slotid = arg_SEQUENCE4.sa_slotid;
+  res_SEQUENCE4.SEQUENCE4res_u.sr_resok4.sr_highest_slotid = psession->nb_slots - 1;
+  res_SEQUENCE4.SEQUENCE4res_u.sr_resok4.sr_target_highest_slotid =
+      nfs41_Session_Target_Slotid(psession, arg_SEQUENCE4.sa_highest_slotid, queue_length);
+  res_SEQUENCE4.SEQUENCE4res_u.sr_resok4.sr_status_flags = 0;   /* What is to be set here ? */
 
   res_SEQUENCE4.sr_status = NFS4_OK;
   return res_SEQUENCE4.sr_status;
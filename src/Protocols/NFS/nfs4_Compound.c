@@ -60,6 +60,7 @@
 #include "nfs_exports.h"
 #include "nfs_creds.h"
 #include "nfs_proto_functions.h"
+#include "nfs_stat_registry.h"
 
 typedef struct nfs4_op_desc__
 {
@@ -199,6 +200,50 @@ nfs4_op_desc_t *optabvers[] =
 nfs4_op_desc_t *optabvers[] = { (nfs4_op_desc_t *) optab4v0 };
 #endif
 
+#define NFS4_NB_MINOR (sizeof(optabvers) / sizeof(nfs4_op_desc_t *))
+
+/* Latency histogram of each operation, per minor version */
+static int nfs4_op_histograms[NFS4_NB_MINOR][POS_ILLEGAL + 1];
+static int nfs4_op_stats_registered = FALSE;
+
+/**
+ * nfs4_Compound_register_stats: registers the latency histograms of the operations.
+ *
+ * Histograms are named after the minor version and the operation, like
+ * "nfs4.OP_READ" or "nfs41.OP_SEQUENCE". Must be called before the
+ * workers are started.
+ *
+ * @return nothing (void function)
+ *
+ */
+void nfs4_Compound_register_stats(void)
+{
+  static const unsigned int nb_ops[] = {
+    sizeof(optab4v0) / sizeof(nfs4_op_desc_t),
+#ifdef _USE_NFS4_1
+    sizeof(optab4v1) / sizeof(nfs4_op_desc_t),
+#endif
+  };
+  char name[NFS_STAT_NAME_LEN];
+  unsigned int minor, i;
+
+  for(minor = 0; minor < NFS4_NB_MINOR; minor++)
+    for(i = 0; i <= POS_ILLEGAL; i++)
+      {
+        if(i >= nb_ops[minor])
+          {
+            nfs4_op_histograms[minor][i] = -1;
+            continue;
+          }
+
+        snprintf(name, NFS_STAT_NAME_LEN, "nfs4%s.%s", minor == 0 ? "" : "1",
+                 optabvers[minor][i].name);
+        nfs4_op_histograms[minor][i] = nfs_stat_register_histogram(name);
+      }
+
+  nfs4_op_stats_registered = TRUE;
+}                               /* nfs4_Compound_register_stats */
+
 /**
  * nfs4_COMPOUND: The NFS PROC4 COMPOUND
  *
@@ -235,8 +280,12 @@ int nfs4_Compound(nfs_arg_t * parg /* IN     */ ,
   char __attribute__ ((__unused__)) funcname[] = "nfs4_Compound";
   compound_data_t data;
   int opindex;
+  uint64_t op_start;
   #define TAGLEN 64
   char tagstr[TAGLEN + 1 + 5];
+#ifdef _USE_NFS4_1
+  nfs41_session_replay_t *preplay = NULL;
+#endif
 
   /* A "local" #define to avoid typo with nfs (too) long structure names */
 #define COMPOUND4_ARRAY parg->arg_compound4.argarray
@@ -408,9 +457,13 @@ int nfs4_Compound(nfs_arg_t * parg /* IN     */ ,
                tagstr);
 
       memset(&res, 0, sizeof(res));
+      op_start = nfs4_op_stats_registered ? nfs_stat_now() : 0;
       status = (optabvers[COMPOUND4_MINOR][opindex].funct) (&(COMPOUND4_ARRAY.argarray_val[i]),
                                                             &data,
                                                             &res);
+      if(op_start != 0)
+        nfs_stat_histogram_record(nfs4_op_histograms[COMPOUND4_MINOR][opindex],
+                                  nfs_stat_now() - op_start);
 
       memcpy(&(pres->res_compound4.resarray.resarray_val[i]), &res, sizeof(res));
 
@@ -449,10 +502,13 @@ int nfs4_Compound(nfs_arg_t * parg /* IN     */ ,
                   /* Manage sessions's DRC : replay previously cached request */
                   if(data.use_drc == TRUE)
                     {
-                      /* Replay cache */
-                      memcpy((char *)pres, data.pcached_res,
-                             (COMPOUND4_ARRAY.argarray_len) * sizeof(struct nfs_resop4));
-                      status = ((COMPOUND4res *) data.pcached_res)->status;
+                      /* Replay cache, the worker sends the cached reply */
+                      if(data.pclient->pworker != NULL)
+                        preplay = &((nfs_worker_data_t *) data.pclient->pworker)->drc_replay;
+
+                      status = nfs41_Session_Slot_Replay(data.pcached_slot,
+                                                         &pres->res_compound4, preplay);
+                      data.pcached_slot = NULL;
                       break;    /* Exit the for loop */
                     }
                 }
@@ -468,11 +524,11 @@ int nfs4_Compound(nfs_arg_t * parg /* IN     */ ,
   /* Manage session's DRC : keep NFS4.1 replay for later use */
   if(COMPOUND4_MINOR == 1)
     {
-      if(data.pcached_res != NULL)      /* Pointer has been set by nfs41_op_sequence and points to cached zone */
-        {
-          memcpy(data.pcached_res, (char *)pres,
-                 (COMPOUND4_ARRAY.argarray_len) * sizeof(struct nfs_resop4));
-        }
+      if(data.pcached_slot != NULL)     /* Pointer has been set by nfs41_op_sequence and points to the slot */
+        nfs41_Session_Slot_Store(data.pcached_slot, &pres->res_compound4,
+                                 data.pclient->pworker != NULL ?
+                                 &((nfs_worker_data_t *) data.pclient->pworker)->drc_encode :
+                                 NULL);
     }
 #endif
 
@@ -765,6 +821,11 @@ void compound_data_Free(compound_data_t * data)
   if(data->mounted_on_FH.nfs_fh4_val != NULL)
     Mem_Free((char *)data->mounted_on_FH.nfs_fh4_val);
 
+#ifdef _USE_NFS4_1
+  /* The session can go now that its slot is no more used */
+  if(data->psession != NULL)
+    nfs41_Session_Release(data->psession);
+#endif
 }                               /* compound_data_Free */
 
 /**
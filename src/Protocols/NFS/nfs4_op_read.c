@@ -331,13 +331,12 @@ int nfs4_op_read(struct nfs_argop4 *op, compound_data_t * data, struct nfs_resop
 
     }
 
-  /* Some work is to be done */
-  if((bufferdata = (char *)Mem_Alloc(size)) == NULL)
+  /* Some work is to be done, the FSAL reads straight into the buffer that is given to the encoder */
+  if((bufferdata = (char *)nfs_read_buffer_get(size)) == NULL)
     {
       res_READ4.status = NFS4ERR_SERVERFAULT;
       return res_READ4.status;
     }
-  memset((char *)bufferdata, 0, size);
 
   seek_descriptor.whence = FSAL_SEEK_SET;
   seek_descriptor.offset = offset;
@@ -354,6 +353,7 @@ int nfs4_op_read(struct nfs_argop4 *op, compound_data_t * data, struct nfs_resop
                       data->pclient,
                       data->pcontext, TRUE, &cache_status) != CACHE_INODE_SUCCESS)
     {
+      nfs_read_buffer_put(bufferdata);
       res_READ4.status = nfs4_Errno(cache_status);
       return res_READ4.status;
     }
@@ -394,7 +394,7 @@ int nfs4_op_read(struct nfs_argop4 *op, compound_data_t * data, struct nfs_resop
 void nfs4_op_read_Free(READ4res * resp)
 {
   if(resp->status == NFS4_OK)
-    if(resp->READ4res_u.resok4.data.data_len != 0)
-      Mem_Free(resp->READ4res_u.resok4.data.data_val);
+    if(resp->READ4res_u.resok4.data.data_val != NULL)
+      nfs_read_buffer_put(resp->READ4res_u.resok4.data.data_val);
   return;
 }                               /* nfs4_op_read_Free */
@@ -295,7 +295,8 @@ int nfs_Read(nfs_arg_t * parg,
     }
   else
     {
-      data = Mem_Alloc(size);
+      /* The FSAL reads straight into the buffer that is given to the encoder */
+      data = nfs_read_buffer_get(size);
 
       if(data == NULL)
         {
@@ -329,6 +330,8 @@ int nfs_Read(nfs_arg_t * parg,
                * with error CACHE_INODE_CACHE_CONTENT_EXISTS which is not a pathological thing here */
 
               /* If we are here, there was an error */
+              nfs_read_buffer_put(data);
+
               if(nfs_RetryableError(cache_status))
                 {
                   return NFS_REQ_DROP;
@@ -398,6 +401,8 @@ int nfs_Read(nfs_arg_t * parg,
 
           return NFS_REQ_OK;
         }
+
+      nfs_read_buffer_put(data);
     }
 
   /* If we are here, there was an error */
@@ -429,8 +434,8 @@ int nfs_Read(nfs_arg_t * parg,
 void nfs2_Read_Free(nfs_res_t * resp)
 {
   if((resp->res_read2.status == NFS_OK) &&
-     (resp->res_read2.READ2res_u.readok.data.nfsdata2_len != 0))
-    Mem_Free(resp->res_read2.READ2res_u.readok.data.nfsdata2_val);
+     (resp->res_read2.READ2res_u.readok.data.nfsdata2_val != NULL))
+    nfs_read_buffer_put(resp->res_read2.READ2res_u.readok.data.nfsdata2_val);
 }                               /* nfs2_Read_Free */
 
 /**
@@ -444,6 +449,6 @@ void nfs2_Read_Free(nfs_res_t * resp)
 void nfs3_Read_Free(nfs_res_t * resp)
 {
   if((resp->res_read3.status == NFS3_OK) &&
-     (resp->res_read3.READ3res_u.resok.data.data_len != 0))
-    Mem_Free(resp->res_read3.READ3res_u.resok.data.data_val);
+     (resp->res_read3.READ3res_u.resok.data.data_val != NULL))
+    nfs_read_buffer_put(resp->res_read3.READ3res_u.resok.data.data_val);
 }                               /* nfs3_Read_Free */
@@ -450,8 +450,7 @@ int nfs_Write(nfs_arg_t * parg,
                 }
 
               /* Set the write verifier */
-              memcpy(pres->res_write3.WRITE3res_u.resok.verf,
-                     NFS3_write_verifier, sizeof(writeverf3));
+              nfs3_GetWriteVerifier(pres->res_write3.WRITE3res_u.resok.verf);
 
               pres->res_write3.status = NFS3_OK;
               break;
@@ -698,6 +698,525 @@ static int nfs4_encode_acl(fsal_attrib_list_t * pattr, char *attrvalsBuffer, u_i
 }
 #endif                          /* _USE_NFS4_ACL */
 
+/*
+ * Compiled fattr4 encoding plans.
+ *
+ * READDIR replies encode the same few attribute bitmaps over and over. Each
+ * distinct bitmap is compiled once into a plan: the ordered list of the
+ * attributes to encode, with a direct encoder and a precomputed offset for
+ * every fixed-size attribute. Plans made only of fixed-size attributes are
+ * encoded straight into the reply buffer, the others fall back to the
+ * generic code for their variable-size attributes only.
+ */
+
+#define FATTR4_PLAN_CACHE_SIZE    64    /* distinct bitmaps kept, must be a power of 2 */
+#define FATTR4_PLAN_BITMAP_WORDS  3
+#ifdef _USE_NFS4_1
+#define FATTR4_PLAN_MAX_ATTR      FATTR4_FS_CHARSET_CAP
+#else
+#define FATTR4_PLAN_MAX_ATTR      FATTR4_MOUNTED_ON_FILEID
+#endif
+
+typedef struct fattr4_encode_ctx__
+{
+  exportlist_t *pexport;
+  fsal_attrib_list_t *pattr;
+  nfs_fh4 *objFH;
+  fsal_staticfsinfo_t *pstaticinfo;
+} fattr4_encode_ctx_t;
+
+typedef void (*fattr4_encoder_t) (char *buff, fattr4_encode_ctx_t * pctx);
+
+typedef struct fattr4_plan_step__
+{
+  uint32_t attr;
+  unsigned int size;            /* 0 for variable-size attributes */
+  unsigned int offset;          /* only meaningful in the fixed-size prefix */
+  fattr4_encoder_t encode;      /* NULL for variable-size attributes */
+} fattr4_plan_step_t;
+
+typedef struct fattr4_plan__
+{
+  uint32_t bitmap[FATTR4_PLAN_BITMAP_WORDS];
+  u_int bitmap_len;
+  unsigned int nb_steps;
+  unsigned int nb_prefix;       /* number of steps in the fixed-size prefix */
+  unsigned int prefix_size;     /* encoded size of the fixed-size prefix */
+  uint32_t result_bitmap[2];    /* bitmap returned when all steps are fixed-size */
+  u_int result_bitmap_len;
+  fattr4_plan_step_t steps[FATTR4_PLAN_MAX_ATTR + 1];
+} fattr4_plan_t;
+
+static fattr4_plan_t *fattr4_plan_cache[FATTR4_PLAN_CACHE_SIZE];
+static int fattr4_plans_enabled = TRUE;
+
+static inline void fattr4_put32(char *buff, uint32_t val)
+{
+  val = htonl(val);
+  memcpy(buff, &val, sizeof(uint32_t));
+}
+
+static inline void fattr4_put64(char *buff, uint64_t val)
+{
+  val = nfs_htonl64(val);
+  memcpy(buff, &val, sizeof(uint64_t));
+}
+
+static inline void fattr4_put_time(char *buff, int64_t seconds, uint32_t nseconds)
+{
+  fattr4_put64(buff, (uint64_t) seconds);
+  fattr4_put32(buff + sizeof(uint64_t), nseconds);
+}
+
+static void fattr4_enc_type(char *buff, fattr4_encode_ctx_t * pctx)
+{
+  uint32_t file_type;
+
+  switch (pctx->pattr->type)
+    {
+    case FSAL_TYPE_FILE:
+    case FSAL_TYPE_XATTR:
+      file_type = NF4REG;
+      break;
+    case FSAL_TYPE_DIR:
+      file_type = NF4DIR;
+      break;
+    case FSAL_TYPE_BLK:
+      file_type = NF4BLK;
+      break;
+    case FSAL_TYPE_CHR:
+      file_type = NF4CHR;
+      break;
+    case FSAL_TYPE_LNK:
+      file_type = NF4LNK;
+      break;
+    case FSAL_TYPE_SOCK:
+      file_type = NF4SOCK;
+      break;
+    case FSAL_TYPE_FIFO:
+      file_type = NF4FIFO;
+      break;
+    default:
+      file_type = 0;
+      break;
+    }
+  fattr4_put32(buff, file_type);
+}
+
+static void fattr4_enc_fh_expire_type(char *buff, fattr4_encode_ctx_t * pctx)
+{
+  fattr4_put32(buff, (nfs_param.nfsv4_param.fh_expire == TRUE) ?
+               FH4_VOLATILE_ANY : FH4_PERSISTENT);
+}
+
+static void fattr4_enc_change(char *buff, fattr4_encode_ctx_t * pctx)
+{
+  fattr4_put64(buff, (uint64_t) pctx->pattr->change);
+}
+
+static void fattr4_enc_size(char *buff, fattr4_encode_ctx_t * pctx)
+{
+  fattr4_put64(buff, (uint64_t) pctx->pattr->filesize);
+}
+
+static void fattr4_enc_true(char *buff, fattr4_encode_ctx_t * pctx)
+{
+  fattr4_put32(buff, TRUE);
+}
+
+static void fattr4_enc_false(char *buff, fattr4_encode_ctx_t * pctx)
+{
+  fattr4_put32(buff, FALSE);
+}
+
+static void fattr4_enc_fsid(char *buff, fattr4_encode_ctx_t * pctx)
+{
+  uint64_t major = pctx->pexport->filesystem_id.major;
+  uint64_t minor = pctx->pexport->filesystem_id.minor;
+
+  /* A directory attached to a referral shows a different fsid */
+  if(nfs4_Is_Fh_Referral(pctx->objFH))
+    {
+      major = ~major;
+      minor = ~minor;
+    }
+  fattr4_put64(buff, major);
+  fattr4_put64(buff + sizeof(uint64_t), minor);
+}
+
+static void fattr4_enc_lease_time(char *buff, fattr4_encode_ctx_t * pctx)
+{
+  fattr4_put32(buff, nfs_param.nfsv4_param.lease_lifetime);
+}
+
+static void fattr4_enc_rdattr_error(char *buff, fattr4_encode_ctx_t * pctx)
+{
+  fattr4_put32(buff, NFS4_OK);
+}
+
+static void fattr4_enc_aclsupport(char *buff, fattr4_encode_ctx_t * pctx)
+{
+#ifdef _USE_NFS4_ACL
+  fattr4_put32(buff, ACL4_SUPPORT_ALLOW_ACL | ACL4_SUPPORT_DENY_ACL);
+#else
+  fattr4_put32(buff, 0);
+#endif
+}
+
+static void fattr4_enc_case_insensitive(char *buff, fattr4_encode_ctx_t * pctx)
+{
+  fattr4_put32(buff, pctx->pstaticinfo->case_insensitive);
+}
+
+static void fattr4_enc_case_preserving(char *buff, fattr4_encode_ctx_t * pctx)
+{
+  fattr4_put32(buff, pctx->pstaticinfo->case_preserving);
+}
+
+static void fattr4_enc_chown_restricted(char *buff, fattr4_encode_ctx_t * pctx)
+{
+  fattr4_put32(buff, pctx->pstaticinfo->chown_restricted);
+}
+
+static void fattr4_enc_fileid(char *buff, fattr4_encode_ctx_t * pctx)
+{
+  fattr4_put64(buff, pctx->pattr->fileid);
+}
+
+static void fattr4_enc_maxfilesize(char *buff, fattr4_encode_ctx_t * pctx)
+{
+  fattr4_put64(buff, (uint64_t) FSINFO_MAX_FILESIZE);
+}
+
+static void fattr4_enc_maxlink(char *buff, fattr4_encode_ctx_t * pctx)
+{
+  fattr4_put32(buff, pctx->pstaticinfo->maxlink);
+}
+
+static void fattr4_enc_maxname(char *buff, fattr4_encode_ctx_t * pctx)
+{
+  fattr4_put32(buff, pctx->pstaticinfo->maxnamelen);
+}
+
+static void fattr4_enc_maxread(char *buff, fattr4_encode_ctx_t * pctx)
+{
+  fattr4_put64(buff, (uint64_t) pctx->pstaticinfo->maxread);
+}
+
+static void fattr4_enc_maxwrite(char *buff, fattr4_encode_ctx_t * pctx)
+{
+  fattr4_put64(buff, (uint64_t) pctx->pstaticinfo->maxwrite);
+}
+
+static void fattr4_enc_mode(char *buff, fattr4_encode_ctx_t * pctx)
+{
+  fattr4_put32(buff, fsal2unix_mode(pctx->pattr->mode));
+}
+
+static void fattr4_enc_no_trunc(char *buff, fattr4_encode_ctx_t * pctx)
+{
+  fattr4_put32(buff, pctx->pstaticinfo->no_trunc);
+}
+
+static void fattr4_enc_numlinks(char *buff, fattr4_encode_ctx_t * pctx)
+{
+  fattr4_put32(buff, pctx->pattr->numlinks);
+}
+
+static void fattr4_enc_quota_avail_hard(char *buff, fattr4_encode_ctx_t * pctx)
+{
+  fattr4_put64(buff, (uint64_t) NFS_V4_MAX_QUOTA_HARD);
+}
+
+static void fattr4_enc_quota_avail_soft(char *buff, fattr4_encode_ctx_t * pctx)
+{
+  fattr4_put64(buff, (uint64_t) NFS_V4_MAX_QUOTA_SOFT);
+}
+
+static void fattr4_enc_quota_used(char *buff, fattr4_encode_ctx_t * pctx)
+{
+  fattr4_put64(buff, (uint64_t) pctx->pattr->filesize);
+}
+
+static void fattr4_enc_rawdev(char *buff, fattr4_encode_ctx_t * pctx)
+{
+  fattr4_put32(buff, pctx->pattr->rawdev.major);
+  fattr4_put32(buff + sizeof(uint32_t), pctx->pattr->rawdev.minor);
+}
+
+static void fattr4_enc_space_used(char *buff, fattr4_encode_ctx_t * pctx)
+{
+  fattr4_put64(buff, (uint64_t) pctx->pattr->spaceused);
+}
+
+static void fattr4_enc_time_access(char *buff, fattr4_encode_ctx_t * pctx)
+{
+  fattr4_put_time(buff, pctx->pattr->atime.seconds, pctx->pattr->atime.nseconds);
+}
+
+static void fattr4_enc_time_zero(char *buff, fattr4_encode_ctx_t * pctx)
+{
+  fattr4_put_time(buff, 0LL, 0);
+}
+
+static void fattr4_enc_time_delta(char *buff, fattr4_encode_ctx_t * pctx)
+{
+  fattr4_put_time(buff, 1LL, 0);
+}
+
+static void fattr4_enc_time_metadata(char *buff, fattr4_encode_ctx_t * pctx)
+{
+  fattr4_put_time(buff, pctx->pattr->ctime.seconds, pctx->pattr->ctime.nseconds);
+}
+
+static void fattr4_enc_time_modify(char *buff, fattr4_encode_ctx_t * pctx)
+{
+  fattr4_put_time(buff, pctx->pattr->mtime.seconds, pctx->pattr->mtime.nseconds);
+}
+
+/* Encoders for the attributes whose encoding has a fixed size and never fails,
+ * they must produce exactly what nfs4_FSALattr_To_Fattr's switch produces */
+static const fattr4_encoder_t fattr4_fixed_encoders[FATTR4_MOUNTED_ON_FILEID + 1] =
+{
+  [FATTR4_TYPE] = fattr4_enc_type,
+  [FATTR4_FH_EXPIRE_TYPE] = fattr4_enc_fh_expire_type,
+  [FATTR4_CHANGE] = fattr4_enc_change,
+  [FATTR4_SIZE] = fattr4_enc_size,
+  [FATTR4_LINK_SUPPORT] = fattr4_enc_true,
+  [FATTR4_SYMLINK_SUPPORT] = fattr4_enc_true,
+  [FATTR4_NAMED_ATTR] = fattr4_enc_false,
+  [FATTR4_FSID] = fattr4_enc_fsid,
+  [FATTR4_UNIQUE_HANDLES] = fattr4_enc_true,
+  [FATTR4_LEASE_TIME] = fattr4_enc_lease_time,
+  [FATTR4_RDATTR_ERROR] = fattr4_enc_rdattr_error,
+  [FATTR4_ACLSUPPORT] = fattr4_enc_aclsupport,
+  [FATTR4_ARCHIVE] = fattr4_enc_false,
+  [FATTR4_CANSETTIME] = fattr4_enc_true,
+  [FATTR4_CASE_INSENSITIVE] = fattr4_enc_case_insensitive,
+  [FATTR4_CASE_PRESERVING] = fattr4_enc_case_preserving,
+  [FATTR4_CHOWN_RESTRICTED] = fattr4_enc_chown_restricted,
+  [FATTR4_FILEID] = fattr4_enc_fileid,
+  [FATTR4_HIDDEN] = fattr4_enc_false,
+  [FATTR4_HOMOGENEOUS] = fattr4_enc_true,
+  [FATTR4_MAXFILESIZE] = fattr4_enc_maxfilesize,
+  [FATTR4_MAXLINK] = fattr4_enc_maxlink,
+  [FATTR4_MAXNAME] = fattr4_enc_maxname,
+  [FATTR4_MAXREAD] = fattr4_enc_maxread,
+  [FATTR4_MAXWRITE] = fattr4_enc_maxwrite,
+  [FATTR4_MODE] = fattr4_enc_mode,
+  [FATTR4_NO_TRUNC] = fattr4_enc_no_trunc,
+  [FATTR4_NUMLINKS] = fattr4_enc_numlinks,
+  [FATTR4_QUOTA_AVAIL_HARD] = fattr4_enc_quota_avail_hard,
+  [FATTR4_QUOTA_AVAIL_SOFT] = fattr4_enc_quota_avail_soft,
+  [FATTR4_QUOTA_USED] = fattr4_enc_quota_used,
+  [FATTR4_RAWDEV] = fattr4_enc_rawdev,
+  [FATTR4_SPACE_USED] = fattr4_enc_space_used,
+  [FATTR4_SYSTEM] = fattr4_enc_false,
+  [FATTR4_TIME_ACCESS] = fattr4_enc_time_access,
+  [FATTR4_TIME_BACKUP] = fattr4_enc_time_zero,
+  [FATTR4_TIME_CREATE] = fattr4_enc_time_zero,
+  [FATTR4_TIME_DELTA] = fattr4_enc_time_delta,
+  [FATTR4_TIME_METADATA] = fattr4_enc_time_metadata,
+  [FATTR4_TIME_MODIFY] = fattr4_enc_time_modify,
+  [FATTR4_MOUNTED_ON_FILEID] = fattr4_enc_fileid,
+};
+
+/**
+ *
+ * nfs4_Fattr_Plans_Enable: turns the compiled fattr4 plans on or off.
+ *
+ * Plans are on by default, turning them off makes nfs4_FSALattr_To_Fattr
+ * walk the bitmap for every call (used to benchmark and cross-check plans).
+ *
+ * @param enable [IN] TRUE to use the plans, FALSE otherwise.
+ *
+ * @return nothing (void function)
+ *
+ */
+void nfs4_Fattr_Plans_Enable(int enable)
+{
+  fattr4_plans_enabled = enable;
+}                               /* nfs4_Fattr_Plans_Enable */
+
+/**
+ *
+ * nfs4_Fattr_Plan_Compile: builds the encoding plan of a bitmap.
+ *
+ * @param words [IN] the bitmap, zero-padded to FATTR4_PLAN_BITMAP_WORDS words
+ * @param len   [IN] the length of the bitmap as received
+ *
+ * @return the new plan, or NULL if no memory.
+ *
+ */
+static fattr4_plan_t *nfs4_Fattr_Plan_Compile(uint32_t * words, u_int len)
+{
+  fattr4_plan_t *plan;
+  bitmap4 bitmap;
+  bitmap4 result;
+  uint32_t attrlist[FATTR4_PLAN_BITMAP_WORDS * 32];
+  uint32_t fixedlist[FATTR4_PLAN_MAX_ATTR + 1];
+  uint_t attrlen = 0;
+  uint_t fixedlen = 0;
+  unsigned int offset = 0;
+  int in_prefix = TRUE;
+  uint_t i;
+
+  if((plan = (fattr4_plan_t *) Mem_Alloc_Label(sizeof(fattr4_plan_t),
+                                               "fattr4_plan_t")) == NULL)
+    return NULL;
+  memset(plan, 0, sizeof(fattr4_plan_t));
+
+  memcpy(plan->bitmap, words, sizeof(plan->bitmap));
+  plan->bitmap_len = len;
+
+  bitmap.bitmap4_len = len;
+  bitmap.bitmap4_val = words;
+  nfs4_bitmap4_to_list(&bitmap, &attrlen, attrlist);
+
+  for(i = 0; i < attrlen; i++)
+    {
+      fattr4_plan_step_t *pstep;
+
+      /* Erroneous values are skipped, as the generic code does */
+      if(attrlist[i] > FATTR4_PLAN_MAX_ATTR)
+        continue;
+
+      pstep = &plan->steps[plan->nb_steps++];
+      pstep->attr = attrlist[i];
+
+      if(attrlist[i] <= FATTR4_MOUNTED_ON_FILEID &&
+         fattr4_fixed_encoders[attrlist[i]] != NULL)
+        {
+          pstep->encode = fattr4_fixed_encoders[attrlist[i]];
+          pstep->size = fattr4tab[attrlist[i]].size_fattr4;
+          fixedlist[fixedlen++] = attrlist[i];
+        }
+      else
+        in_prefix = FALSE;
+
+      if(in_prefix)
+        {
+          pstep->offset = offset;
+          offset += pstep->size;
+          plan->nb_prefix += 1;
+        }
+    }
+
+  plan->prefix_size = offset;
+
+  /* Only used when every attribute is fixed-size, and then all of them succeed */
+  result.bitmap4_val = plan->result_bitmap;
+  nfs4_list_to_bitmap4(&result, &fixedlen, fixedlist);
+  plan->result_bitmap_len = result.bitmap4_len;
+
+  LogFullDebug(COMPONENT_NFS_V4,
+               "Compiled fattr4 plan for bitmap %u|%u|%u: %u attributes, %u fixed-size ones (%u bytes) first",
+               words[0], words[1], words[2], plan->nb_steps, plan->nb_prefix, plan->prefix_size);
+
+  return plan;
+}                               /* nfs4_Fattr_Plan_Compile */
+
+/**
+ *
+ * nfs4_Fattr_Plan_Get: finds or compiles the encoding plan of a bitmap.
+ *
+ * Plans are never freed. Lookups take no lock, a new plan is published with
+ * a compare and swap into a free slot of the cache.
+ *
+ * @param Bitmap [IN] the requested attributes
+ *
+ * @return the plan, or NULL if the bitmap can't be planned (cache full, bitmap too long).
+ *
+ */
+static fattr4_plan_t *nfs4_Fattr_Plan_Get(bitmap4 * Bitmap)
+{
+  uint32_t words[FATTR4_PLAN_BITMAP_WORDS];
+  fattr4_plan_t *plan;
+  fattr4_plan_t *newplan = NULL;
+  unsigned int hash;
+  unsigned int i;
+  unsigned int slot;
+
+  if(!fattr4_plans_enabled || Bitmap->bitmap4_len > FATTR4_PLAN_BITMAP_WORDS)
+    return NULL;
+
+  memset(words, 0, sizeof(words));
+  for(i = 0; i < Bitmap->bitmap4_len; i++)
+    words[i] = Bitmap->bitmap4_val[i];
+
+  hash = (words[0] * 2654435761U) ^ (words[1] * 40503U) ^ words[2] ^ Bitmap->bitmap4_len;
+  hash ^= hash >> 16;
+
+  for(i = 0; i < FATTR4_PLAN_CACHE_SIZE; i++)
+    {
+      slot = (hash + i) & (FATTR4_PLAN_CACHE_SIZE - 1);
+      plan = fattr4_plan_cache[slot];
+
+      if(plan == NULL)
+        {
+          if(newplan == NULL &&
+             (newplan = nfs4_Fattr_Plan_Compile(words, Bitmap->bitmap4_len)) == NULL)
+            return NULL;
+
+          if(__sync_bool_compare_and_swap(&fattr4_plan_cache[slot], NULL, newplan))
+            return newplan;
+
+          /* Someone else took the slot, it may hold the same bitmap */
+          plan = fattr4_plan_cache[slot];
+        }
+
+      if(plan->bitmap_len == Bitmap->bitmap4_len &&
+         !memcmp(plan->bitmap, words, sizeof(words)))
+        {
+          if(newplan != NULL)
+            Mem_Free(newplan);
+          return plan;
+        }
+    }
+
+  /* Too many distinct bitmaps, use the generic code for this one */
+  if(newplan != NULL)
+    Mem_Free(newplan);
+  return NULL;
+}                               /* nfs4_Fattr_Plan_Get */
+
+/**
+ *
+ * nfs4_Fattr_Plan_Encode_Fixed: encodes attributes with an all fixed-size plan.
+ *
+ * @param plan  [IN]  a plan whose attributes are all fixed-size
+ * @param pctx  [IN]  the values to encode
+ * @param Fattr [OUT] NFSv4 Fattr buffer
+ *
+ * @return -1 if failed, 0 if successful.
+ *
+ */
+static int nfs4_Fattr_Plan_Encode_Fixed(fattr4_plan_t * plan,
+                                        fattr4_encode_ctx_t * pctx, fattr4 * Fattr)
+{
+  unsigned int i;
+
+  if((Fattr->attrmask.bitmap4_val = (uint32_t *) Mem_Alloc_Label(2 * sizeof(uint32_t),
+                                                                 "FSALattr_To_Fattr:bitmap")) == NULL)
+    return -1;
+  Fattr->attrmask.bitmap4_val[0] = plan->result_bitmap[0];
+  Fattr->attrmask.bitmap4_val[1] = plan->result_bitmap[1];
+  Fattr->attrmask.bitmap4_len = plan->result_bitmap_len;
+
+  Fattr->attr_vals.attrlist4_len = plan->prefix_size;
+  if(plan->prefix_size == 0)    /* No need to allocate an empty buffer */
+    return 0;
+
+  if((Fattr->attr_vals.attrlist4_val =
+      Mem_Alloc_Label(plan->prefix_size, "FSALattr_To_Fattr:attrvals")) == NULL)
+    return -1;
+
+  for(i = 0; i < plan->nb_steps; i++)
+    plan->steps[i].encode(Fattr->attr_vals.attrlist4_val + plan->steps[i].offset, pctx);
+
+  return 0;
+}                               /* nfs4_Fattr_Plan_Encode_Fixed */
+
 /**
  *
  * nfs4_FSALattr_To_Fattr: Converts FSAL Attributes to NFSv4 Fattr buffer.
@@ -811,11 +1330,27 @@ int nfs4_FSALattr_To_Fattr(exportlist_t * pexport,
   cache_inode_status_t cache_status;
 
   int statfscalled = 0;
-  fsal_staticfsinfo_t * pstaticinfo = data->pcontext->export_context->fe_static_fs_info;
+  fsal_staticfsinfo_t * pstaticinfo = NULL;
   fsal_dynamicfsinfo_t dynamicinfo;
 #ifdef _USE_NFS4_ACL
   int rc;
 #endif
+  fattr4_plan_t *plan;
+  fattr4_encode_ctx_t ctx;
+
+  /* FSAL_PROXY converts settable attributes without any compound data */
+  if(data != NULL)
+    pstaticinfo = data->pcontext->export_context->fe_static_fs_info;
+
+  ctx.pexport = pexport;
+  ctx.pattr = pattr;
+  ctx.objFH = objFH;
+  ctx.pstaticinfo = pstaticinfo;
+
+  /* Fast path: every requested attribute has a fixed size */
+  plan = nfs4_Fattr_Plan_Get(Bitmap);
+  if(plan != NULL && plan->nb_prefix == plan->nb_steps)
+    return nfs4_Fattr_Plan_Encode_Fixed(plan, &ctx, Fattr);
 
   /* basic init */
   memset(attrvalsBuffer, 0, NFS4_ATTRVALS_BUFFLEN);
@@ -827,8 +1362,11 @@ int nfs4_FSALattr_To_Fattr(exportlist_t * pexport,
   memset((uint32_t *) attrvalslist, 0, FATTR4_MOUNTED_ON_FILEID * sizeof(uint32_t));
 #endif
 
-  /* Convert the attribute bitmap to an attribute list */
-  nfs4_bitmap4_to_list(Bitmap, &attrmasklen, attrmasklist);
+  /* Convert the attribute bitmap to an attribute list, the plan already holds it */
+  if(plan != NULL)
+    attrmasklen = plan->nb_steps;
+  else
+    nfs4_bitmap4_to_list(Bitmap, &attrmasklen, attrmasklist);
 
   /* Once the bitmap has been converted to a list of attribute, manage each attribute */
   Fattr->attr_vals.attrlist4_len = 0;
@@ -837,12 +1375,27 @@ int nfs4_FSALattr_To_Fattr(exportlist_t * pexport,
 
   for(i = 0; i < attrmasklen; i++)
     {
-      attribute_to_set = attrmasklist[i];
+      if(plan != NULL)
+        {
+          attribute_to_set = plan->steps[i].attr;
+
+          /* Fixed-size attributes are encoded directly */
+          if(plan->steps[i].encode != NULL)
+            {
+              plan->steps[i].encode(attrvalsBuffer + LastOffset, &ctx);
+              LastOffset += plan->steps[i].size;
+              attrvalslist[j] = attribute_to_set;
+              j += 1;
+              continue;
+            }
+        }
+      else
+        attribute_to_set = attrmasklist[i];
 
 #ifdef _USE_NFS4_1
-      if(attrmasklist[i] > FATTR4_FS_CHARSET_CAP)
+      if(attribute_to_set > FATTR4_FS_CHARSET_CAP)
 #else
-      if(attrmasklist[i] > FATTR4_MOUNTED_ON_FILEID)
+      if(attribute_to_set > FATTR4_MOUNTED_ON_FILEID)
 #endif
         {
           /* Erroneous value... skip */
@@ -850,7 +1403,7 @@ int nfs4_FSALattr_To_Fattr(exportlist_t * pexport,
         }
       LogFullDebug(COMPONENT_NFS_V4,
                    "Flag for Operation (Regular) = %d|%d is ON,  name  = %s  reply_size = %d",
-                   attrmasklist[i],
+                   attribute_to_set,
                    fattr4tab[attribute_to_set].val,
                    fattr4tab[attribute_to_set].name,
                    fattr4tab[attribute_to_set].size_fattr4);
@@ -4101,3 +4654,160 @@ void nfs4_access_debug(char *label, uint32_t access, fsal_aceperm_t v4mask)
              FSAL_TEST_MASK(v4mask, FSAL_ACE_PERM_WRITE_OWNER)	 ? 'o':'-',
              FSAL_TEST_MASK(v4mask, FSAL_ACE_PERM_SYNCHRONIZE)	 ? 'z':'-');
 }
+
+/*
+ * READ reply buffers.
+ *
+ * The data returned by a READ is read by the FSAL straight into one of these
+ * buffers and given as is to the XDR encoder, it is released by the free
+ * function of the operation once the reply is sent. The buffers are cached
+ * in free lists by size class (power of 2, from 4 KB to 1 MB) so that a
+ * steady READ load does no large allocation.
+ */
+
+#define NFS_READ_BUFFER_MIN_SHIFT   12
+#define NFS_READ_BUFFER_NB_CLASS    9
+#define NFS_READ_BUFFER_NO_CLASS    NFS_READ_BUFFER_NB_CLASS
+#define NFS_READ_BUFFER_CACHE_BYTES (16 * 1024 * 1024)
+#define NFS_READ_BUFFER_MAX_FREE    256
+
+typedef struct nfs_read_buffer__
+{
+  struct nfs_read_buffer__ *next;       /**< Next free buffer of the same class */
+  unsigned int size_class;              /**< Size class, NFS_READ_BUFFER_NO_CLASS if too big */
+} nfs_read_buffer_t;
+
+static struct
+{
+  pthread_mutex_t lock;
+  nfs_read_buffer_t *free_list;
+  unsigned int nb_free;
+} nfs_read_buffer_class[NFS_READ_BUFFER_NB_CLASS];
+
+static pthread_once_t nfs_read_buffer_once = PTHREAD_ONCE_INIT;
+
+static void nfs_read_buffer_init(void)
+{
+  unsigned int i;
+
+  for(i = 0; i < NFS_READ_BUFFER_NB_CLASS; i++)
+    {
+      pthread_mutex_init(&nfs_read_buffer_class[i].lock, NULL);
+      nfs_read_buffer_class[i].free_list = NULL;
+      nfs_read_buffer_class[i].nb_free = 0;
+    }
+}                               /* nfs_read_buffer_init */
+
+static size_t nfs_read_buffer_class_size(unsigned int size_class)
+{
+  return (size_t) 1 << (NFS_READ_BUFFER_MIN_SHIFT + size_class);
+}                               /* nfs_read_buffer_class_size */
+
+/**
+ * nfs_read_buffer_get: gets a buffer for the data of a READ reply.
+ *
+ * @param size [IN] the number of bytes needed.
+ *
+ * @return the buffer, or NULL if no memory is available.
+ *
+ */
+caddr_t nfs_read_buffer_get(size_t size)
+{
+  nfs_read_buffer_t *pbuff = NULL;
+  unsigned int size_class = 0;
+
+  pthread_once(&nfs_read_buffer_once, nfs_read_buffer_init);
+
+  while(size_class < NFS_READ_BUFFER_NB_CLASS &&
+        nfs_read_buffer_class_size(size_class) < size)
+    size_class++;
+
+  if(size_class < NFS_READ_BUFFER_NB_CLASS)
+    {
+      P(nfs_read_buffer_class[size_class].lock);
+      pbuff = nfs_read_buffer_class[size_class].free_list;
+      if(pbuff != NULL)
+        {
+          nfs_read_buffer_class[size_class].free_list = pbuff->next;
+          nfs_read_buffer_class[size_class].nb_free -= 1;
+        }
+      V(nfs_read_buffer_class[size_class].lock);
+
+      if(pbuff == NULL)
+        pbuff = (nfs_read_buffer_t *) Mem_Alloc(sizeof(nfs_read_buffer_t) +
+                                                nfs_read_buffer_class_size(size_class));
+    }
+  else
+    pbuff = (nfs_read_buffer_t *) Mem_Alloc(sizeof(nfs_read_buffer_t) + size);
+
+  if(pbuff == NULL)
+    return NULL;
+
+  pbuff->next = NULL;
+  pbuff->size_class = size_class;
+
+  return (caddr_t) (pbuff + 1);
+}                               /* nfs_read_buffer_get */
+
+/**
+ * nfs_read_buffer_put: releases a READ buffer.
+ *
+ * The buffer goes back to its free list, or to the memory allocator if this
+ * list is full.
+ *
+ * @param data [IN] a buffer returned by nfs_read_buffer_get.
+ *
+ * @return nothing (void function)
+ *
+ */
+void nfs_read_buffer_put(caddr_t data)
+{
+  nfs_read_buffer_t *pbuff = ((nfs_read_buffer_t *) data) - 1;
+  unsigned int size_class = pbuff->size_class;
+  unsigned int max_free;
+
+  if(size_class < NFS_READ_BUFFER_NB_CLASS)
+    {
+      max_free = NFS_READ_BUFFER_CACHE_BYTES / nfs_read_buffer_class_size(size_class);
+      if(max_free > NFS_READ_BUFFER_MAX_FREE)
+        max_free = NFS_READ_BUFFER_MAX_FREE;
+
+      P(nfs_read_buffer_class[size_class].lock);
+      if(nfs_read_buffer_class[size_class].nb_free < max_free)
+        {
+          pbuff->next = nfs_read_buffer_class[size_class].free_list;
+          nfs_read_buffer_class[size_class].free_list = pbuff;
+          nfs_read_buffer_class[size_class].nb_free += 1;
+          pbuff = NULL;
+        }
+      V(nfs_read_buffer_class[size_class].lock);
+    }
+
+  if(pbuff != NULL)
+    Mem_Free(pbuff);
+}                               /* nfs_read_buffer_put */
+
+extern writeverf3 NFS3_write_verifier;  /* NFS V3 write verifier      */
+
+/**
+ *
+ * nfs3_GetWriteVerifier: builds the write verifier returned by WRITE and COMMIT.
+ *
+ * The verifier is the server boot time, mixed with the number of times
+ * cache_inode had to drop uncommitted unstable data: a client that sees it
+ * change knows it must send its uncommitted writes again.
+ *
+ * @param verf [OUT] the write verifier (a writeverf3).
+ *
+ * @return nothing (void function)
+ *
+ */
+void nfs3_GetWriteVerifier(char *verf)
+{
+  unsigned int epoch = cache_inode_unstable_get_epoch();
+  unsigned int i;
+
+  memcpy(verf, NFS3_write_verifier, sizeof(writeverf3));
+  for(i = 0; i < sizeof(unsigned int) && i + 4 < sizeof(writeverf3); i++)
+    verf[i + 4] ^= (char)(epoch >> (8 * i));
+}                               /* nfs3_GetWriteVerifier */
@@ -0,0 +1,248 @@
+/*
+ * vim:expandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * ---------------------------------------
+ */
+
+/**
+ * \file    test_fattr4_encode.c
+ * \brief   Cross-checks and benchmarks the compiled fattr4 encoding plans.
+ *
+ * Every bitmap is encoded with the compiled plans and with the generic
+ * code, the results must be identical. Then both are timed on the bitmaps
+ * a Linux client sends with READDIR.
+ *
+ * Usage: test_fattr4_encode [iterations]
+ *
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include "rpc.h"
+#include "log_macros.h"
+#include "stuff_alloc.h"
+#include "nfs4.h"
+#include "nfs_core.h"
+#include "nfs_exports.h"
+#include "nfs_proto_functions.h"
+#include "nfs_file_handle.h"
+
+nfs_parameter_t nfs_param;
+
+#define BIT(attr) (1U << ((attr) % 32))
+
+/* READDIR bitmap of a Linux client doing "ls -l" */
+static uint32_t readdir_plus[2] = {
+  BIT(FATTR4_TYPE) | BIT(FATTR4_CHANGE) | BIT(FATTR4_SIZE) | BIT(FATTR4_FSID) |
+      BIT(FATTR4_RDATTR_ERROR) | BIT(FATTR4_FILEID),
+  BIT(FATTR4_MODE) | BIT(FATTR4_NUMLINKS) | BIT(FATTR4_RAWDEV) |
+      BIT(FATTR4_SPACE_USED) | BIT(FATTR4_TIME_ACCESS) | BIT(FATTR4_TIME_METADATA) |
+      BIT(FATTR4_TIME_MODIFY) | BIT(FATTR4_MOUNTED_ON_FILEID)
+};
+
+/* Same with the file handle, which is variable-size */
+static uint32_t readdir_plus_fh[2] = {
+  BIT(FATTR4_TYPE) | BIT(FATTR4_CHANGE) | BIT(FATTR4_SIZE) | BIT(FATTR4_FSID) |
+      BIT(FATTR4_RDATTR_ERROR) | BIT(FATTR4_FILEHANDLE) | BIT(FATTR4_FILEID),
+  BIT(FATTR4_MODE) | BIT(FATTR4_NUMLINKS) | BIT(FATTR4_RAWDEV) |
+      BIT(FATTR4_SPACE_USED) | BIT(FATTR4_TIME_ACCESS) | BIT(FATTR4_TIME_METADATA) |
+      BIT(FATTR4_TIME_MODIFY) | BIT(FATTR4_MOUNTED_ON_FILEID)
+};
+
+/* Everything about the filesystem, fixed-size */
+static uint32_t fsinfo[2] = {
+  BIT(FATTR4_FH_EXPIRE_TYPE) | BIT(FATTR4_LINK_SUPPORT) | BIT(FATTR4_SYMLINK_SUPPORT) |
+      BIT(FATTR4_NAMED_ATTR) | BIT(FATTR4_UNIQUE_HANDLES) | BIT(FATTR4_LEASE_TIME) |
+      BIT(FATTR4_ACLSUPPORT) | BIT(FATTR4_ARCHIVE) | BIT(FATTR4_CANSETTIME) |
+      BIT(FATTR4_CASE_INSENSITIVE) | BIT(FATTR4_CASE_PRESERVING) |
+      BIT(FATTR4_CHOWN_RESTRICTED) | BIT(FATTR4_HIDDEN) | BIT(FATTR4_HOMOGENEOUS) |
+      BIT(FATTR4_MAXFILESIZE) | BIT(FATTR4_MAXLINK) | BIT(FATTR4_MAXNAME) |
+      BIT(FATTR4_MAXREAD) | BIT(FATTR4_MAXWRITE),
+  BIT(FATTR4_NO_TRUNC) | BIT(FATTR4_QUOTA_AVAIL_HARD) | BIT(FATTR4_QUOTA_AVAIL_SOFT) |
+      BIT(FATTR4_QUOTA_USED) | BIT(FATTR4_SYSTEM) | BIT(FATTR4_TIME_BACKUP) |
+      BIT(FATTR4_TIME_CREATE) | BIT(FATTR4_TIME_DELTA)
+};
+
+/* Supported attributes list in front of fixed-size ones */
+static uint32_t supported[2] = {
+  BIT(FATTR4_SUPPORTED_ATTRS) | BIT(FATTR4_TYPE) | BIT(FATTR4_SIZE),
+  BIT(FATTR4_MODE)
+};
+
+static exportlist_t export;
+static fsal_export_context_t export_context;
+static fsal_op_context_t op_context;
+static compound_data_t data;
+static fsal_attrib_list_t attr;
+static file_handle_v4_t fhandle;
+static nfs_fh4 fh;
+
+static void init(void)
+{
+  memset(&export, 0, sizeof(export));
+  export.filesystem_id.major = 0x12345678;
+  export.filesystem_id.minor = 42;
+
+  memset(&export_context, 0, sizeof(export_context));
+  export_context.fe_static_fs_info = (fsal_staticfsinfo_t *) Mem_Alloc(sizeof(fsal_staticfsinfo_t));
+  memset(export_context.fe_static_fs_info, 0, sizeof(fsal_staticfsinfo_t));
+  export_context.fe_static_fs_info->maxlink = 1024;
+  export_context.fe_static_fs_info->maxnamelen = 255;
+  export_context.fe_static_fs_info->maxread = 1048576;
+  export_context.fe_static_fs_info->maxwrite = 1048576;
+  export_context.fe_static_fs_info->case_preserving = TRUE;
+  export_context.fe_static_fs_info->chown_restricted = TRUE;
+  export_context.fe_static_fs_info->no_trunc = TRUE;
+
+  memset(&op_context, 0, sizeof(op_context));
+  op_context.export_context = &export_context;
+
+  memset(&data, 0, sizeof(data));
+  data.pcontext = &op_context;
+  data.pexport = &export;
+
+  nfs_param.nfsv4_param.lease_lifetime = 60;
+
+  memset(&fhandle, 0, sizeof(fhandle));
+  fh.nfs_fh4_len = sizeof(fhandle);
+  fh.nfs_fh4_val = (char *)&fhandle;
+
+  memset(&attr, 0, sizeof(attr));
+  attr.type = FSAL_TYPE_FILE;
+  attr.filesize = 123456789;
+  attr.fileid = 987654321;
+  attr.change = 17;
+  attr.numlinks = 2;
+  attr.mode = 0644;
+  attr.spaceused = 131072;
+  attr.rawdev.major = 8;
+  attr.rawdev.minor = 1;
+  attr.atime.seconds = 1300000000;
+  attr.atime.nseconds = 1;
+  attr.mtime.seconds = 1300000001;
+  attr.mtime.nseconds = 2;
+  attr.ctime.seconds = 1300000002;
+  attr.ctime.nseconds = 3;
+}
+
+static int encode(uint32_t * words, int plans, fattr4 * Fattr)
+{
+  bitmap4 bitmap;
+
+  bitmap.bitmap4_len = 2;
+  bitmap.bitmap4_val = words;
+
+  memset(Fattr, 0, sizeof(fattr4));
+  nfs4_Fattr_Plans_Enable(plans);
+  return nfs4_FSALattr_To_Fattr(&export, &attr, Fattr, &data, &fh, &bitmap);
+}
+
+static void release(fattr4 * Fattr)
+{
+  Mem_Free(Fattr->attrmask.bitmap4_val);
+  if(Fattr->attr_vals.attrlist4_len != 0)
+    Mem_Free(Fattr->attr_vals.attrlist4_val);
+}
+
+static void check(char *name, uint32_t * words)
+{
+  fattr4 generic, compiled;
+  int pass;
+
+  /* Twice with plans: once compiling the plan, once using it */
+  for(pass = 0; pass < 2; pass++)
+    {
+      if(encode(words, FALSE, &generic) != 0 || encode(words, TRUE, &compiled) != 0)
+        {
+          LogTest("%s: encoding failed", name);
+          exit(1);
+        }
+
+      if(generic.attrmask.bitmap4_len != compiled.attrmask.bitmap4_len ||
+         memcmp(generic.attrmask.bitmap4_val, compiled.attrmask.bitmap4_val,
+                generic.attrmask.bitmap4_len * sizeof(uint32_t)) ||
+         generic.attr_vals.attrlist4_len != compiled.attr_vals.attrlist4_len ||
+         memcmp(generic.attr_vals.attrlist4_val, compiled.attr_vals.attrlist4_val,
+                generic.attr_vals.attrlist4_len))
+        {
+          LogTest("%s: compiled plan does not match the generic encoding", name);
+          exit(1);
+        }
+
+      release(&generic);
+      release(&compiled);
+    }
+
+  LogTest("%s: compiled plan matches the generic encoding", name);
+}
+
+static void bench(char *name, uint32_t * words, int iterations)
+{
+  struct timeval start, end;
+  double ns[2];
+  fattr4 Fattr;
+  int plans;
+  int i;
+
+  for(plans = FALSE; plans <= TRUE; plans++)
+    {
+      gettimeofday(&start, NULL);
+      for(i = 0; i < iterations; i++)
+        {
+          encode(words, plans, &Fattr);
+          release(&Fattr);
+        }
+      gettimeofday(&end, NULL);
+
+      ns[plans] = ((end.tv_sec - start.tv_sec) * 1e9 +
+                   (end.tv_usec - start.tv_usec) * 1e3) / iterations;
+    }
+
+  LogTest("%-16s generic %7.1f ns/entry, compiled %7.1f ns/entry (x%.1f)",
+          name, ns[FALSE], ns[TRUE], ns[FALSE] / ns[TRUE]);
+}
+
+int main(int argc, char **argv)
+{
+  int iterations = 1000000;
+
+  if(argc > 1)
+    iterations = atoi(argv[1]);
+
+  SetDefaultLogging("TEST");
+  SetNamePgm("test_fattr4_encode");
+
+  BuddyInit(NULL);
+
+  init();
+
+  check("readdir", readdir_plus);
+  check("readdir+fh", readdir_plus_fh);
+  check("fsinfo", fsinfo);
+  check("supported_attrs", supported);
+
+  bench("readdir", readdir_plus, iterations);
+  bench("readdir+fh", readdir_plus_fh, iterations);
+  bench("fsinfo", fsinfo, iterations);
+
+  return 0;
+}
@@ -183,6 +183,7 @@ int test_mnt_Export()
         export_entries[i].next = &(export_entries[i + 1]);
       else
         export_entries[i].next = NULL;
+        export_entries[i].clients.matcher = NULL;
 
       /* tests several clients list type */
       switch (i % 4)
@@ -305,6 +305,11 @@ SVCXPRT *Svcxprt_copy(SVCXPRT *xprt_copy, SVCXPRT *xprt_orig)
       if(!cd_c)
         goto fail;
       memcpy(cd_c, cd_o, sizeof(*cd_c));
+      /* The send queue is shared, the reply being written is not */
+      cd_c->replying = FALSE;
+      cd_c->writer = FALSE;
+      cd_c->rec_head = cd_c->rec_tail = NULL;
+      cd_c->rec_len = 0;
       xprt_copy->xp_p1 = cd_c;
 #ifndef NO_XDRREC_PATCH
       Xdrrec_create(&(cd_c->xdrs), cd_c->sendsize, cd_c->recvsize, xprt_copy, Read_vc, Write_vc);
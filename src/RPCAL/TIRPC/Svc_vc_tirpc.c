@@ -68,11 +68,14 @@
 #include "stuff_alloc.h"
 
 int getpeereid(int s, uid_t * euid, gid_t * egid);
-int fridgethr_get( pthread_t * pthrid, void *(*thrfunc)(void*), void * thrarg ) ;
 
 extern rw_lock_t Svc_fd_lock;
 
-extern void *rpc_tcp_socket_manager_thread(void *Arg);
+extern int nfs_rpc_add_conn(int sock);
+extern bool_t nfs_rpc_conn_pending(int sock, unsigned int pending);
+
+/* Buffers of a send queue written by a single writev */
+#define SENDQ_IOV 16
 
 static SVCXPRT *Makefd_xprt(int, u_int, u_int);
 static bool_t Rendezvous_request(SVCXPRT *, struct rpc_msg *);
@@ -88,6 +91,11 @@ static void Svc_vc_rendezvous_ops(SVCXPRT *);
 static void Svc_vc_ops(SVCXPRT *);
 static bool_t Svc_vc_control(SVCXPRT * xprt, const u_int rq, void *in);
 static bool_t Svc_vc_rendezvous_control(SVCXPRT * xprt, const u_int rq, void *in);
+static struct cf_sendq *Sendq_create(void);
+static void Sendq_destroy(struct cf_sendq *);
+static int Sendq_write(int, struct cf_sendq *);
+static int Sendq_wait(int, struct cf_sendq *);
+static bool_t Sendq_end(SVCXPRT *);
 
 /*
  * Usage:
@@ -200,6 +208,11 @@ static SVCXPRT *Makefd_xprt(int fd, u_int sendsize, u_int recvsize)
   xprt->xp_p1 = cd;
 
   cd->strm_stat = XPRT_IDLE;
+  cd->sendq = NULL;
+  cd->replying = FALSE;
+  cd->writer = FALSE;
+  cd->rec_head = cd->rec_tail = NULL;
+  cd->rec_len = 0;
 #ifndef NO_XDRREC_PATCH
   Xdrrec_create(&(cd->xdrs), sendsize, recvsize, xprt, Read_vc, Write_vc);
 #else
@@ -233,9 +246,6 @@ static bool_t Rendezvous_request(SVCXPRT *xprt, struct rpc_msg *msg)
   struct __rpc_sockinfo si;
   SVCXPRT *newxprt;
 
-  pthread_t sockmgr_thrid;
-  int rc = 0;
-
   assert(xprt != NULL);
   assert(msg != NULL);
 
@@ -298,33 +308,30 @@ static bool_t Rendezvous_request(SVCXPRT *xprt, struct rpc_msg *msg)
   cd->sendsize = r->sendsize;
   cd->maxrec = r->maxrec;
 
-  if(cd->maxrec != 0)
+  /* Connections are always non blocking: the dispatcher threads reassemble
+   * the records of many connections, reading only what has arrived */
+  flags = fcntl(sock, F_GETFL);
+  if(flags == -1 || fcntl(sock, F_SETFL, flags | O_NONBLOCK) == -1)
     {
-      flags = fcntl(sock, F_GETFL);
-      if(flags == -1)
-        {
-          FreeXprt(xprt);
-          return (FALSE);
-        }
-      /*if (fcntl(sock, F_SETFL, flags | O_NONBLOCK) == -1)
-         return (FALSE); */
-      if(cd->recvsize > cd->maxrec)
-        cd->recvsize = cd->maxrec;
-      cd->nonblock = TRUE;
-      __Xdrrec_setnonblock(&cd->xdrs, cd->maxrec);
+      Svc_vc_destroy(newxprt);
+      return (FALSE);
     }
-  else
-    cd->nonblock = FALSE;
+  if(cd->maxrec != 0 && cd->recvsize > cd->maxrec)
+    cd->recvsize = cd->maxrec;
+  cd->sendq = Sendq_create();
+  if(cd->sendq == NULL)
+    {
+      Svc_vc_destroy(newxprt);
+      return (FALSE);
+    }
+  cd->nonblock = TRUE;
+  __Xdrrec_setnonblock(&cd->xdrs, cd->maxrec);
   gettimeofday(&cd->last_recv_time, NULL);
 
-  FD_CLR(newxprt->xp_fd, &Svc_fdset);
-
-  if((rc =
-      fridgethr_get(&sockmgr_thrid, rpc_tcp_socket_manager_thread,
-                     (void *)((unsigned long)newxprt->xp_fd))) != 0)
+  if(nfs_rpc_add_conn(newxprt->xp_fd) != 0)
     {
-      FreeXprt(xprt);
-      return FALSE;
+      Svc_vc_destroy(newxprt);
+      return (FALSE);
     }
 
   return (FALSE);               /* there is never an rpc msg to be processed */
@@ -345,6 +352,14 @@ void Svc_vc_destroy(SVCXPRT *xprt)
 
 void __Svc_vc_dodestroy(SVCXPRT *xprt)
 {
+  struct cf_conn *cd = (struct cf_conn *)xprt->xp_p1;
+
+  /* Replies still waiting are lost with the connection */
+  if(cd != NULL && cd->sendq != NULL)
+    {
+      Sendq_destroy(cd->sendq);
+      cd->sendq = NULL;
+    }
   if(xprt->xp_fd != RPC_ANYFD)
     (void)close(xprt->xp_fd);
   FreeXprt(xprt);
@@ -400,16 +415,17 @@ int Read_vc(void *xprtp, void *buf, int len)
 
   if(cfp->nonblock)
     {
+      /* 0 means that nothing has arrived yet, end of stream is an error */
       len = read(sock, buf, (size_t) len);
       if(len < 0)
         {
-          if(errno == EAGAIN)
-            len = 0;
-          else
-            goto fatal_err;
+          if(errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+            return 0;
+          goto fatal_err;
         }
-      if(len != 0)
-        gettimeofday(&cfp->last_recv_time, NULL);
+      if(len == 0)
+        goto fatal_err;
+      gettimeofday(&cfp->last_recv_time, NULL);
       return len;
     }
 
@@ -443,52 +459,343 @@ int Read_vc(void *xprtp, void *buf, int len)
   return (-1);
 }
 
+static struct cf_sendq *Sendq_create(void)
+{
+  struct cf_sendq *sq;
+
+  sq = (struct cf_sendq *)Mem_Alloc(sizeof(struct cf_sendq));
+  if(sq == NULL)
+    return NULL;
+  memset(sq, 0, sizeof(struct cf_sendq));
+  if(pthread_mutex_init(&sq->lock, NULL) != 0)
+    {
+      Mem_Free(sq);
+      return NULL;
+    }
+  return sq;
+}
+
+/* Drop the bytes still waiting */
+static void Sendq_drop(struct cf_sendq *sq)
+{
+  struct cf_sendbuf *sb;
+
+  while((sb = sq->head) != NULL)
+    {
+      sq->head = sb->next;
+      Mem_Free(sb);
+    }
+  sq->tail = NULL;
+  sq->pending = 0;
+}
+
+static void Sendq_destroy(struct cf_sendq *sq)
+{
+  Sendq_drop(sq);
+  pthread_mutex_destroy(&sq->lock);
+  Mem_Free(sq);
+}
+
+/* Keep a copy of bytes of a reply that the socket could not take */
+static bool_t Sendrec_append(struct cf_conn *cd, void *buf, int len)
+{
+  struct cf_sendbuf *sb;
+
+  sb = (struct cf_sendbuf *)Mem_Alloc(sizeof(struct cf_sendbuf) + len);
+  if(sb == NULL)
+    return FALSE;
+  sb->next = NULL;
+  sb->data = (char *)(sb + 1);
+  sb->len = len;
+  sb->off = 0;
+  memcpy(sb->data, buf, len);
+
+  if(cd->rec_tail == NULL)
+    cd->rec_head = sb;
+  else
+    cd->rec_tail->next = sb;
+  cd->rec_tail = sb;
+  cd->rec_len += len;
+  return TRUE;
+}
+
+static void Sendrec_drop(struct cf_conn *cd)
+{
+  struct cf_sendbuf *sb;
+
+  while((sb = cd->rec_head) != NULL)
+    {
+      cd->rec_head = sb->next;
+      Mem_Free(sb);
+    }
+  cd->rec_tail = NULL;
+  cd->rec_len = 0;
+}
+
+/*
+ * Write as much of the send queue as the socket takes, without waiting.
+ * Called with the queue locked. Returns the number of bytes still waiting,
+ * or -1 if the connection is dead: the queue is then emptied.
+ */
+static int Sendq_write(int fd, struct cf_sendq *sq)
+{
+  struct iovec iov[SENDQ_IOV];
+  struct cf_sendbuf *sb;
+  ssize_t n;
+  int cnt;
+
+  if(sq->dead)
+    return (-1);
+
+  while(sq->head != NULL)
+    {
+      for(cnt = 0, sb = sq->head; sb != NULL && cnt < SENDQ_IOV; sb = sb->next, cnt++)
+        {
+          iov[cnt].iov_base = sb->data + sb->off;
+          iov[cnt].iov_len = sb->len - sb->off;
+        }
+
+      n = writev(fd, iov, cnt);
+      if(n < 0)
+        {
+          if(errno == EINTR)
+            continue;
+          if(errno == EAGAIN || errno == EWOULDBLOCK)
+            break;
+          sq->dead = TRUE;
+          Sendq_drop(sq);
+          return (-1);
+        }
+
+      sq->pending -= n;
+      while(n > 0)
+        {
+          sb = sq->head;
+          if(n < sb->len - sb->off)
+            {
+              sb->off += n;
+              break;
+            }
+          n -= sb->len - sb->off;
+          sq->head = sb->next;
+          if(sq->head == NULL)
+            sq->tail = NULL;
+          Mem_Free(sb);
+        }
+    }
+
+  return (sq->pending);
+}
+
+/*
+ * Write the whole send queue, waiting for room in the socket, for when no
+ * dispatcher watches it. A client that does not read for 35 seconds is dead.
+ */
+static int Sendq_wait(int fd, struct cf_sendq *sq)
+{
+  struct pollfd pollfd;
+
+  while(Sendq_write(fd, sq) > 0)
+    {
+      pollfd.fd = fd;
+      pollfd.events = POLLOUT;
+      pollfd.revents = 0;
+      if(poll(&pollfd, 1, 35 * 1000) == 0)
+        {
+          sq->dead = TRUE;
+          Sendq_drop(sq);
+        }
+    }
+
+  return sq->dead ? -1 : 0;
+}
+
+/*
+ * Tell the dispatcher how many bytes wait, and have them written. Called
+ * with the queue locked and no writer. Returns the number of bytes still
+ * waiting, or -1 if the connection is dead.
+ */
+static int Sendq_report(int fd, struct cf_sendq *sq)
+{
+  if(sq->pending == 0 && sq->reported == 0)
+    return 0;
+
+  sq->reported = sq->pending;
+  if(nfs_rpc_conn_pending(fd, sq->pending))
+    return (sq->pending);
+
+  sq->reported = 0;
+  return Sendq_wait(fd, sq);
+}
+
+/*
+ * Flush the send queue of a connection: called by the dispatcher owning the
+ * socket when it has room again. Returns the number of bytes still waiting,
+ * or -1 if the connection is dead.
+ */
+int Svc_vc_flush(SVCXPRT *xprt)
+{
+  struct cf_conn *cd;
+  struct cf_sendq *sq;
+  int rc;
+
+  assert(xprt != NULL);
+
+  cd = (struct cf_conn *)xprt->xp_p1;
+  sq = cd->sendq;
+  if(sq == NULL)
+    return 0;
+
+  P(sq->lock);
+  /* The writer writes the queue once its reply is complete */
+  if(sq->writer != NULL)
+    rc = sq->pending;
+  else
+    {
+      rc = Sendq_write(xprt->xp_fd, sq);
+      if(rc >= 0)
+        rc = Sendq_report(xprt->xp_fd, sq);
+    }
+  if(rc < 0)
+    cd->strm_stat = XPRT_DIED;
+  V(sq->lock);
+
+  return rc;
+}
+
+/*
+ * End the reply being written on a non-blocking connection: what the socket
+ * did not take is queued, before the replies queued meanwhile if this reply
+ * was the writer, and the queue is written as far as the socket allows.
+ */
+static bool_t Sendq_end(SVCXPRT *xprt)
+{
+  struct cf_conn *cd = (struct cf_conn *)xprt->xp_p1;
+  struct cf_sendq *sq = cd->sendq;
+  bool_t writer;
+  int rc = 0;
+
+  if(sq == NULL || !cd->replying)
+    return TRUE;
+  cd->replying = FALSE;
+
+  P(sq->lock);
+
+  writer = cd->writer;
+  cd->writer = FALSE;
+  if(writer)
+    sq->writer = NULL;
+
+  if(sq->dead || cd->strm_stat == XPRT_DIED)
+    {
+      /* A reply cut short breaks the record stream */
+      sq->dead = TRUE;
+      Sendq_drop(sq);
+      Sendrec_drop(cd);
+      rc = -1;
+    }
+  else if(cd->rec_head != NULL)
+    {
+      if(writer)
+        {
+          cd->rec_tail->next = sq->head;
+          sq->head = cd->rec_head;
+          if(sq->tail == NULL)
+            sq->tail = cd->rec_tail;
+        }
+      else
+        {
+          if(sq->tail == NULL)
+            sq->head = cd->rec_head;
+          else
+            sq->tail->next = cd->rec_head;
+          sq->tail = cd->rec_tail;
+        }
+      sq->pending += cd->rec_len;
+      cd->rec_head = cd->rec_tail = NULL;
+      cd->rec_len = 0;
+    }
+
+  /* With a writer, the queue is written when it is done */
+  if(rc == 0 && sq->writer == NULL)
+    {
+      rc = Sendq_write(xprt->xp_fd, sq);
+      if(rc >= 0)
+        rc = Sendq_report(xprt->xp_fd, sq);
+    }
+
+  V(sq->lock);
+
+  if(rc < 0)
+    {
+      cd->strm_stat = XPRT_DIED;
+      return FALSE;
+    }
+  return TRUE;
+}
+
 /*
  * writes data to the tcp connection.
  * Any error is fatal and the connection is closed.
+ * A non-blocking connection never waits for room in its socket. The first
+ * write of a reply makes it the writer if nothing waits to be sent: it
+ * writes what the socket takes. The rest of its bytes, and all the bytes of
+ * a reply that is not the writer, are kept until the reply is complete
+ * (see Sendq_end).
  */
 int Write_vc(void *xprtp, void *buf, int len)
 {
   SVCXPRT *xprt;
   int i, cnt;
   struct cf_conn *cd;
-  struct timeval tv0, tv1;
+  struct cf_sendq *sq;
 
   xprt = (SVCXPRT *) xprtp;
   assert(xprt != NULL);
 
   cd = (struct cf_conn *)xprt->xp_p1;
+  sq = cd->sendq;
 
-  if(cd->nonblock)
-    gettimeofday(&tv0, NULL);
+  if(sq != NULL && !cd->replying)
+    {
+      cd->replying = TRUE;
+      P(sq->lock);
+      if(sq->dead)
+        cd->strm_stat = XPRT_DIED;
+      else if(sq->writer == NULL && sq->head == NULL)
+        sq->writer = cd;
+      cd->writer = (sq->writer == cd);
+      V(sq->lock);
+    }
 
-  for(cnt = len; cnt > 0; cnt -= i, buf += i)
+  if(cd->strm_stat == XPRT_DIED)
+    return (-1);
+
+  cnt = len;
+  if(sq == NULL || (cd->writer && cd->rec_head == NULL))
+    for(; cnt > 0; cnt -= i, buf += i)
+      {
+        i = write(xprt->xp_fd, buf, (size_t) cnt);
+        if(i >= 0)
+          continue;
+
+        i = 0;
+        if(errno == EINTR)
+          continue;
+
+        if((errno == EAGAIN || errno == EWOULDBLOCK) && sq != NULL)
+          break;
+
+        cd->strm_stat = XPRT_DIED;
+        return (-1);
+      }
+
+  if(cnt > 0 && !Sendrec_append(cd, buf, cnt))
     {
-      i = write(xprt->xp_fd, buf, (size_t) cnt);
-      if(i < 0)
-        {
-          if(errno != EAGAIN || !cd->nonblock)
-            {
-              cd->strm_stat = XPRT_DIED;
-              return (-1);
-            }
-          if(cd->nonblock && i != cnt)
-            {
-              /*
-               * For non-blocking connections, do not
-               * take more than 2 seconds writing the
-               * data out.
-               *
-               * XXX 2 is an arbitrary amount.
-               */
-              gettimeofday(&tv1, NULL);
-              if(tv1.tv_sec - tv0.tv_sec >= 2)
-                {
-                  cd->strm_stat = XPRT_DIED;
-                  return (-1);
-                }
-            }
-        }
+      LogCrit(COMPONENT_RPC,
+              "Write_vc: out of memory, dropping connection %d", xprt->xp_fd);
+      cd->strm_stat = XPRT_DIED;
+      return (-1);
     }
 
   return (len);
@@ -520,14 +827,17 @@ bool_t Svc_vc_recv(SVCXPRT *xprt, struct rpc_msg *msg)
   cd = (struct cf_conn *)(xprt->xp_p1);
   xdrs = &(cd->xdrs);
 
+  /* A non-blocking stream holds exactly one record once it is complete,
+   * skipping to the next one would read it from the socket */
   if(cd->nonblock)
     {
       if(!__Xdrrec_getrec(xdrs, &cd->strm_stat, TRUE))
         return FALSE;
     }
+  else
+    (void)Xdrrec_skiprecord(xdrs);
 
   xdrs->x_op = XDR_DECODE;
-  (void)Xdrrec_skiprecord(xdrs);
   if(xdr_callmsg(xdrs, msg))
     {
       cd->x_id = msg->rm_xid;
@@ -607,6 +917,8 @@ bool_t Svc_vc_reply(SVCXPRT *xprt, struct rpc_msg *msg)
       stat = TRUE;
     }
   (void)Xdrrec_endofrecord(xdrs, TRUE);
+  if(!Sendq_end(xprt))
+    stat = FALSE;
   return (stat);
 }
 
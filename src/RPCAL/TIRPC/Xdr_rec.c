@@ -123,6 +123,18 @@ static const struct  xdr_ops Xdrrec_ops = {
 
 #define LAST_FRAG ((u_int32_t)(1 << 31))
 
+/*
+ * Opaque data of at least this size is written directly from the caller's
+ * buffer instead of being copied into the output buffer.
+ */
+#define XDRREC_DIRECT_PUT_MIN 8192
+
+/*
+ * An input buffer grown for a large record goes back to its default size
+ * once this many records in a row have fit in the default size.
+ */
+#define XDRREC_SHRINK_RECORDS 16
+
 typedef struct rec_strm {
 	char *tcp_handle;
 	/*
@@ -155,6 +167,8 @@ typedef struct rec_strm {
 	int in_reclen;
 	int in_received;
 	int in_maxrec;
+	u_int in_defsize;	/* recvsize before any large record */
+	u_int in_small;		/* records in a row that fit in in_defsize */
 } RECSTREAM;
 
 static u_int	fix_buf_size(u_int);
@@ -164,6 +178,7 @@ static bool_t	get_input_bytes(RECSTREAM *, char *, int);
 static bool_t	set_input_fragment(RECSTREAM *);
 static bool_t	skip_input_bytes(RECSTREAM *, long);
 static bool_t	realloc_stream(RECSTREAM *, int);
+static void	shrink_stream(RECSTREAM *);
 
 
 /*
@@ -235,6 +250,8 @@ Xdrrec_create(xdrs, sendsize, recvsize, tcp_handle, readit, writeit)
 	rstrm->nonblock = FALSE;
 	rstrm->in_reclen = 0;
 	rstrm->in_received = 0;
+	rstrm->in_defsize = recvsize;
+	rstrm->in_small = 0;
 }
 
 
@@ -327,6 +344,32 @@ Xdrrec_putbytes(xdrs, addr, len)
 {
 	RECSTREAM *rstrm = (RECSTREAM *)(xdrs->x_private);
 	size_t current;
+	u_int32_t fraglen;
+
+	/*
+	 * Large opaque data (READ replies) that does not fit in the
+	 * output buffer is not copied: the current fragment is extended
+	 * to cover it, the buffered bytes are sent and the data is
+	 * written directly from the caller's buffer.
+	 */
+	if (len >= XDRREC_DIRECT_PUT_MIN &&
+	    len > (u_int)((u_long)rstrm->out_boundry - (u_long)rstrm->out_finger)) {
+		fraglen = (u_int32_t)((u_long)(rstrm->out_finger) -
+		    (u_long)(rstrm->frag_header) - sizeof(u_int32_t)) + len;
+		*(rstrm->frag_header) = htonl(fraglen);
+		current = (size_t)((u_long)(rstrm->out_finger) -
+		    (u_long)(rstrm->out_base));
+		if ((*(rstrm->writeit))(rstrm->tcp_handle, rstrm->out_base,
+		    (int)current) != (int)current)
+			return (FALSE);
+		if ((*(rstrm->writeit))(rstrm->tcp_handle, (void *)addr,
+		    (int)len) != (int)len)
+			return (FALSE);
+		rstrm->frag_header = (u_int32_t *)(void *)rstrm->out_base;
+		rstrm->out_finger = (char *)rstrm->out_base + sizeof(u_int32_t);
+		rstrm->frag_sent = TRUE;
+		return (TRUE);
+	}
 
 	while (len > 0) {
 		current = (size_t)((u_long)rstrm->out_boundry -
@@ -545,6 +588,10 @@ Xdrrec_endofrecord(xdrs, sendnow)
 /*
  * Fill the stream buffer with a record for a non-blocking connection.
  * Return true if a record is available in the buffer, false if not.
+ * The readit routine returns 0 when no data is available yet and -1 when
+ * the peer is gone, so a record can be reassembled over several calls,
+ * each one reading only what the socket already holds. The fragments of
+ * a record are read one after the other in the same call.
  */
 bool_t
 __Xdrrec_getrec(xdrs, statp, expectdata)
@@ -556,60 +603,81 @@ __Xdrrec_getrec(xdrs, statp, expectdata)
 	ssize_t n;
 	int fraglen;
 
-	if (!rstrm->in_haveheader) {
-		n = rstrm->readit(rstrm->tcp_handle, rstrm->in_hdrp,
-		    (int)sizeof (rstrm->in_header) - rstrm->in_hdrlen);
-		if (n == 0) {
-			*statp = expectdata ? XPRT_DIED : XPRT_IDLE;
-			return FALSE;
+	for (;;) {
+		if (!rstrm->in_haveheader) {
+			n = rstrm->readit(rstrm->tcp_handle, rstrm->in_hdrp,
+			    (int)sizeof (rstrm->in_header) - rstrm->in_hdrlen);
+			if (n < 0) {
+				*statp = XPRT_DIED;
+				return FALSE;
+			}
+			if (n == 0) {
+				*statp = (rstrm->in_hdrlen == 0 &&
+				    rstrm->in_reclen == 0) ?
+				    XPRT_IDLE : XPRT_MOREREQS;
+				return FALSE;
+			}
+			rstrm->in_hdrp += n;
+			rstrm->in_hdrlen += n;
+			if (rstrm->in_hdrlen < sizeof (rstrm->in_header)) {
+				*statp = XPRT_MOREREQS;
+				return FALSE;
+			}
+			rstrm->in_header = ntohl(rstrm->in_header);
+			fraglen = (int)(rstrm->in_header & ~LAST_FRAG);
+			if (fraglen == 0 || fraglen > rstrm->in_maxrec ||
+			    (rstrm->in_reclen + fraglen) > rstrm->in_maxrec) {
+				*statp = XPRT_DIED;
+				return FALSE;
+			}
+			/* first fragment of a new record, the previous
+			 * one has been consumed */
+			if (rstrm->in_reclen == 0) {
+				rstrm->last_frag = FALSE;
+				shrink_stream(rstrm);
+			}
+			rstrm->in_reclen += fraglen;
+			if (rstrm->in_reclen > rstrm->recvsize &&
+			    !realloc_stream(rstrm, rstrm->in_reclen)) {
+				*statp = XPRT_DIED;
+				return FALSE;
+			}
+			if (rstrm->in_header & LAST_FRAG) {
+				rstrm->in_header &= ~LAST_FRAG;
+				rstrm->last_frag = TRUE;
+			}
+			rstrm->in_haveheader = TRUE;
 		}
+
+		n =  rstrm->readit(rstrm->tcp_handle,
+		    rstrm->in_base + rstrm->in_received,
+		    (rstrm->in_reclen - rstrm->in_received));
+
 		if (n < 0) {
 			*statp = XPRT_DIED;
 			return FALSE;
 		}
-		rstrm->in_hdrp += n;
-		rstrm->in_hdrlen += n;
-		if (rstrm->in_hdrlen < sizeof (rstrm->in_header)) {
+
+		if (n == 0) {
 			*statp = XPRT_MOREREQS;
 			return FALSE;
 		}
-		rstrm->in_header = ntohl(rstrm->in_header);
-		fraglen = (int)(rstrm->in_header & ~LAST_FRAG);
-		if (fraglen == 0 || fraglen > rstrm->in_maxrec ||
-		    (rstrm->in_reclen + fraglen) > rstrm->in_maxrec) {
-			*statp = XPRT_DIED;
-			return FALSE;
-		}
-		rstrm->in_reclen += fraglen;
-		if (rstrm->in_reclen > rstrm->recvsize)
-			realloc_stream(rstrm, rstrm->in_reclen);
-		if (rstrm->in_header & LAST_FRAG) {
-			rstrm->in_header &= ~LAST_FRAG;
-			rstrm->last_frag = TRUE;
-		}
-	}
-
-	n =  rstrm->readit(rstrm->tcp_handle,
-	    rstrm->in_base + rstrm->in_received,
-	    (rstrm->in_reclen - rstrm->in_received));
-
-	if (n < 0) {
-		*statp = XPRT_DIED;
-		return FALSE;
-	}
 
-	if (n == 0) {
-		*statp = expectdata ? XPRT_DIED : XPRT_IDLE;
-		return FALSE;
-	}
+		rstrm->in_received += n;
 
-	rstrm->in_received += n;
+		if (rstrm->in_received < rstrm->in_reclen) {
+			*statp = XPRT_MOREREQS;
+			return FALSE;
+		}
 
-	if (rstrm->in_received == rstrm->in_reclen) {
 		rstrm->in_haveheader = FALSE;
 		rstrm->in_hdrp = (char *)(void *)&rstrm->in_header;
 		rstrm->in_hdrlen = 0;
 		if (rstrm->last_frag) {
+			if (rstrm->in_reclen > rstrm->in_defsize)
+				rstrm->in_small = 0;
+			else
+				rstrm->in_small++;
 			rstrm->fbtbc = rstrm->in_reclen;
 			rstrm->in_boundry = rstrm->in_base + rstrm->in_reclen;
 			rstrm->in_finger = rstrm->in_base;
@@ -618,9 +686,6 @@ __Xdrrec_getrec(xdrs, statp, expectdata)
 			return TRUE;
 		}
 	}
-
-	*statp = XPRT_MOREREQS;
-	return FALSE;
 }
 
 bool_t
@@ -799,3 +864,27 @@ realloc_stream(rstrm, size)
 
 	return TRUE;
 }
+
+/*
+ * Give back the memory of an input buffer grown for large records, once
+ * the records of the stream are small again. Called between two records.
+ */
+static void
+shrink_stream(rstrm)
+	RECSTREAM *rstrm;
+{
+	char *buf;
+
+	if (rstrm->recvsize <= rstrm->in_defsize ||
+	    rstrm->in_small < XDRREC_SHRINK_RECORDS)
+		return;
+
+	/* Keep the large buffer if it cannot be reallocated */
+	buf = realloc(rstrm->in_base, (size_t)rstrm->in_defsize);
+	if (buf == NULL)
+		return;
+	rstrm->in_base = buf;
+	rstrm->in_finger = rstrm->in_boundry = buf;
+	rstrm->recvsize = rstrm->in_size = rstrm->in_defsize;
+	rstrm->in_small = 0;
+}
@@ -40,6 +40,41 @@ struct cf_conn
   int maxrec;
   bool_t nonblock;
   struct timeval last_recv_time;
+  struct cf_sendq *sendq;       /* shared with the copies of the xprt */
+  bool_t replying;              /* a reply is being written */
+  bool_t writer;                /* it is the writer of the connection */
+  struct cf_sendbuf *rec_head;  /* bytes of the reply that could not be */
+  struct cf_sendbuf *rec_tail;  /* written yet, queued once it is complete */
+  u_int rec_len;
+};
+
+/*
+ * Bytes of a non-blocking connection that its socket could not take yet,
+ * in the order they must be sent. The dispatcher owning the socket writes
+ * them when there is room again.
+ *
+ * Several workers may encode replies of the same connection at once. The
+ * first one to write while nothing waits becomes the writer and writes its
+ * reply to the socket as it is encoded. The others keep their reply until
+ * it is complete, then queue it whole.
+ */
+struct cf_sendbuf
+{
+  struct cf_sendbuf *next;
+  char *data;
+  u_int len;
+  u_int off;                    /* bytes already written */
+};
+
+struct cf_sendq
+{
+  pthread_mutex_t lock;
+  struct cf_sendbuf *head;
+  struct cf_sendbuf *tail;
+  u_int pending;                /* bytes waiting in the queue */
+  u_int reported;               /* pending, as last told to the dispatcher */
+  struct cf_conn *writer;       /* the reply writing to the socket */
+  bool_t dead;                  /* a write failed, nothing more is sent */
 };
 
 #define	SPARSENESS 4            /* 75% sparse */
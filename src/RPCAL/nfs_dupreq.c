@@ -23,14 +23,25 @@
  */
 
 /**
- * \file    nfs_tools.c
+ * \file    nfs_dupreq.c
  * \author  $Author: deniel $
  * \date    $Date: 2006/01/20 07:39:22 $
  * \version $Revision: 1.14 $
- * \brief   Some tools very usefull in the nfs protocol implementation.
+ * \brief   Duplicate request cache.
  *
- * nfs_tools.c : Some tools very usefull in the nfs protocol implementation
+ * nfs_dupreq.c : Duplicate request cache. The cache is split in partitions,
+ * each one with its own lock, hash chains, list of finished entries and pool
+ * of entries, so a request only ever takes the lock of its own partition.
  *
+ * Over UDP, a request goes to the partition of its xid and address, and its
+ * reply is kept until it expires. Over TCP, all the requests of a connection
+ * go to the partition of the connection, which keeps the last replies of the
+ * connection in a bounded window: when the window is full, the oldest reply
+ * is retired.
+ *
+ * Replies are kept as they were encoded, so a retransmission is answered by
+ * copying bytes, and the results of the request are released as soon as it
+ * is finished.
  *
  */
 #ifdef HAVE_CONFIG_H
@@ -57,7 +68,6 @@
 #include <grp.h>
 
 #include "rpcal.h"
-#include "LRU_List.h"
 #include "HashData.h"
 #include "HashTable.h"
 #include "log_macros.h"
@@ -71,20 +81,21 @@
 #include "nfs_file_handle.h"
 #include "nfs_dupreq.h"
 
-extern nfs_function_desc_t nfs2_func_desc[];
-extern nfs_function_desc_t nfs3_func_desc[];
-extern nfs_function_desc_t nfs4_func_desc[];
-extern nfs_function_desc_t mnt1_func_desc[];
-extern nfs_function_desc_t mnt3_func_desc[];
-#ifdef _USE_NLM
-extern nfs_function_desc_t nlm4_func_desc[];
-#endif                          /* _USE_NLM */
-#ifdef _USE_QUOTA
-extern nfs_function_desc_t rquota1_func_desc[];
-extern nfs_function_desc_t rquota2_func_desc[];
-#endif                          /* _USE_QUOTA */
-/* Structure used for duplicated request cache */
-hash_table_t *ht_dupreq;
+typedef struct dupreq_partition__
+{
+  pthread_mutex_t lock;
+  dupreq_entry_t *buckets[DUPREQ_PARTITION_BUCKETS];
+  dupreq_window_t *windows[DUPREQ_PARTITION_BUCKETS];
+  dupreq_entry_t *lru_head;             /* finished entries, oldest first */
+  dupreq_entry_t *lru_tail;
+  struct prealloc_pool entry_pool;
+  struct prealloc_pool window_pool;
+  hash_stat_dynamic_t stat;
+} dupreq_partition_t;
+
+static dupreq_partition_t *dupreq_partitions = NULL;
+static unsigned int dupreq_nb_partitions = 0;
+static unsigned int dupreq_tcp_window = 0;
 
 void LogDupReq(const char *label, sockaddr_t *addr, long xid, u_long rq_prog)
 {
@@ -155,335 +166,274 @@ unsigned int get_rpc_xid(struct svc_req *reqp)
 
 /**
  *
- * print_entry_dupreq: prints an entry in the LRU list.
+ * dupreq_locate: finds the partition and the hash chain of a request.
  *
- * prints an entry in the LRU list.
+ * Over TCP, the partition only depends on the connection, so its window and
+ * all its entries are protected by the same lock.
  *
- * @param data [IN] data stored in a LRU entry to be printed.
- * @param str [OUT] string used to store the result.
+ * @param pkey [IN] the key of the request.
+ * @param is_tcp [IN] TRUE if the request came on a TCP connection.
+ * @param pbucket [OUT] the hash chain of the request in its partition.
  *
- * @return 0 if ok, other values mean an error.
+ * @return the partition of the request.
  *
  */
-int print_entry_dupreq(LRU_data_t data, char *str)
+static dupreq_partition_t *dupreq_locate(dupreq_key_t * pkey, int is_tcp,
+                                         unsigned int *pbucket)
 {
-  strcpy(str, "");
-  return 0;
-}
-
-static int _remove_dupreq(hash_buffer_t *buffkey, dupreq_entry_t *pdupreq,
-                          struct prealloc_pool *dupreq_pool, int nfs_req_status)
-{
-  int rc;
-  nfs_function_desc_t funcdesc = nfs2_func_desc[0];
-
-  rc = HashTable_Del(ht_dupreq, buffkey, NULL, NULL);
-
-  /* if hashtable no such key => dupreq garbaged by another thread */
-  if(rc != HASHTABLE_SUCCESS && rc != HASHTABLE_ERROR_NO_SUCH_KEY)
-    return 1;                   /* Error while cleaning */
-  else if(rc == HASHTABLE_ERROR_NO_SUCH_KEY)
-    return 0;                   /* don't free the dupreq twice */
+  unsigned long addr_hash = hash_sockaddr(&pkey->addr, CHECK_PORT);
+  unsigned long hash = ((unsigned long)pkey->xid * 2654435761UL) ^ addr_hash;
 
-  /* Locate the function descriptor associated with this cached request */
-  if(pdupreq->rq_prog == nfs_param.core_param.program[P_NFS])
+  if(is_tcp)
     {
-      switch (pdupreq->rq_vers)
-        {
-        case NFS_V2:
-          funcdesc = nfs2_func_desc[pdupreq->rq_proc];
-          break;
-
-        case NFS_V3:
-          funcdesc = nfs3_func_desc[pdupreq->rq_proc];
-          break;
-
-        case NFS_V4:
-          funcdesc = nfs4_func_desc[pdupreq->rq_proc];
-          break;
-
-        default:
-          /* We should never go there (this situation is filtered in nfs_rpc_getreq) */
-          LogMajor(COMPONENT_DUPREQ,
-                   "NFS Protocol version %d unknown in dupreq_gc",
-                   (int)pdupreq->rq_vers);
-        }
-    }
-  else if(pdupreq->rq_prog == nfs_param.core_param.program[P_MNT])
-    {
-      switch (pdupreq->rq_vers)
-        {
-        case MOUNT_V1:
-          funcdesc = mnt1_func_desc[pdupreq->rq_proc];
-          break;
-
-        case MOUNT_V3:
-          funcdesc = mnt3_func_desc[pdupreq->rq_proc];
-          break;
-
-        default:
-          /* We should never go there (this situation is filtered in nfs_rpc_getreq) */
-          LogMajor(COMPONENT_DUPREQ,
-                   "MOUNT Protocol version %d unknown in dupreq_gc",
-                   (int)pdupreq->rq_vers);
-          break;
-        }                       /* switch( pdupreq->vers ) */
+      *pbucket = hash & (DUPREQ_PARTITION_BUCKETS - 1);
+      return &dupreq_partitions[addr_hash % dupreq_nb_partitions];
     }
-#ifdef _USE_NLM
-  else if(pdupreq->rq_prog == nfs_param.core_param.program[P_NLM])
-    {
 
-      switch (pdupreq->rq_vers)
-        {
-        case NLM4_VERS:
-          funcdesc = nlm4_func_desc[pdupreq->rq_proc];
-          break;
-        }                       /* switch( pdupreq->vers ) */
-    }
-#endif                          /* _USE_NLM */
-#ifdef _USE_QUOTA
-  else if(pdupreq->rq_prog == nfs_param.core_param.program[P_RQUOTA])
-    {
+  *pbucket = (hash / dupreq_nb_partitions) & (DUPREQ_PARTITION_BUCKETS - 1);
+  return &dupreq_partitions[hash % dupreq_nb_partitions];
+}                               /* dupreq_locate */
 
-      switch (pdupreq->rq_vers)
-        {
-        case RQUOTAVERS:
-          funcdesc = rquota1_func_desc[pdupreq->rq_proc];
-          break;
-
-        case EXT_RQUOTAVERS:
-          funcdesc = rquota2_func_desc[pdupreq->rq_proc];
-          break;
-        }                       /* switch( pdupreq->vers ) */
-    }
-#endif
-  else
-    {
-      /* We should never go there (this situation is filtered in nfs_rpc_getreq) */
-      LogMajor(COMPONENT_DUPREQ,
-               "protocol %d is not managed",
-               (int)pdupreq->rq_prog);
-    }
+/**
+ *
+ * dupreq_make_key: builds the key of a request.
+ *
+ * @param pkey [OUT] the key.
+ * @param xid [IN] the transfer id of the request.
+ * @param xprt [IN] the transport the request came from.
+ *
+ * @return 1 if ok, 0 if the address of the client could not be found.
+ *
+ */
+static int dupreq_make_key(dupreq_key_t * pkey, long xid, SVCXPRT * xprt)
+{
+  memset(pkey, 0, sizeof(dupreq_key_t));
 
-  /* Call the free function */
-  if (nfs_req_status == NFS_REQ_OK)
-    funcdesc.free_function(&(pdupreq->res_nfs));
+  if(copy_xprt_addr(&pkey->addr, xprt) == 0)
+    return 0;
 
-  /* Send the entry back to the pool */
-  ReleaseToPool(pdupreq, dupreq_pool);
+  pkey->xid = xid;
+  pkey->checksum = 0;
 
-  return DUPREQ_SUCCESS;
-}
+  return 1;
+}                               /* dupreq_make_key */
 
-int nfs_dupreq_delete(long xid, struct svc_req *ptr_req, SVCXPRT *xprt,
-                      struct prealloc_pool *dupreq_pool)
+/**
+ *
+ * dupreq_lookup: finds an entry in a hash chain, the partition must be locked.
+ *
+ * @param ppart [IN] the partition.
+ * @param bucket [IN] the hash chain.
+ * @param pkey [IN] the key of the request.
+ *
+ * @return the entry, or NULL if the request is not in the cache.
+ *
+ */
+static dupreq_entry_t *dupreq_lookup(dupreq_partition_t * ppart, unsigned int bucket,
+                                     dupreq_key_t * pkey)
 {
-  int status;
-
-  hash_buffer_t buffkey;
-  hash_buffer_t buffval;
-  dupreq_key_t dupkey;
   dupreq_entry_t *pdupreq;
 
-  /* Get the socket address for the key */
-  if(copy_xprt_addr(&dupkey.addr, xprt) == 0)
-    return DUPREQ_NOT_FOUND;
-
-  dupkey.xid = xid;
-  dupkey.checksum = 0;
-
-  /* I have to keep an integer as key, I wil use the pointer buffkey->pdata for this,
-   * this also means that buffkey->len will be 0 */
-  buffkey.pdata = (caddr_t) &dupkey;
-  buffkey.len = sizeof(dupreq_key_t);
-
-  if(HashTable_Get(ht_dupreq, &buffkey, &buffval) == HASHTABLE_SUCCESS)
-    {
-      pdupreq = (dupreq_entry_t *) buffval.pdata;
-
-      /* reset timestamp */
-      pdupreq->timestamp = time(NULL);
-
-      status = DUPREQ_SUCCESS;
-    }
-  else {
-    return DUPREQ_NOT_FOUND;
-  }
+  for(pdupreq = ppart->buckets[bucket]; pdupreq != NULL; pdupreq = pdupreq->hash_next)
+    if(pdupreq->key.xid == pkey->xid &&
+       pdupreq->key.checksum == pkey->checksum &&
+       cmp_sockaddr(&pdupreq->key.addr, &pkey->addr, CHECK_PORT))
+      return pdupreq;
 
-  LogDupReq("REMOVING", &pdupreq->addr, pdupreq->xid, pdupreq->rq_prog);
-
-  status = _remove_dupreq(&buffkey, pdupreq, dupreq_pool, ! NFS_REQ_OK);
-  return status;
-}
+  return NULL;
+}                               /* dupreq_lookup */
 
 /**
  *
- * clean_entry_dupreq: cleans an entry in the dupreq cache.
+ * dupreq_get_window: finds or creates the window of a TCP connection, the
+ * partition must be locked.
  *
- * cleans an entry in the dupreq cache.
+ * @param ppart [IN] the partition of the connection.
+ * @param paddr [IN] the address of the client.
  *
- * @param pentry [INOUT] entry to be cleaned.
- * @param addparam [IN] additional parameter used for cleaning.
- *
- * @return 0 if ok, other values mean an error.
+ * @return the window, or NULL if no memory is available.
  *
  */
-int clean_entry_dupreq(LRU_entry_t * pentry, void *addparam)
+static dupreq_window_t *dupreq_get_window(dupreq_partition_t * ppart, sockaddr_t * paddr)
 {
-  hash_buffer_t buffkey;
-  struct prealloc_pool *dupreq_pool = (struct prealloc_pool *) addparam;
-  dupreq_entry_t *pdupreq = (dupreq_entry_t *) (pentry->buffdata.pdata);
-  dupreq_key_t dupkey;
+  unsigned int bucket = hash_sockaddr(paddr, CHECK_PORT) & (DUPREQ_PARTITION_BUCKETS - 1);
+  dupreq_window_t *pwindow;
 
-  /* Get the socket address for the key */
-  memcpy((char *)&dupkey.addr, (char *)&pdupreq->addr, sizeof(dupkey.addr));
-  dupkey.xid = pdupreq->xid;
-  dupkey.checksum = pdupreq->checksum;
+  for(pwindow = ppart->windows[bucket]; pwindow != NULL; pwindow = pwindow->hash_next)
+    if(cmp_sockaddr(&pwindow->addr, paddr, CHECK_PORT))
+      return pwindow;
 
-  /* I have to keep an integer as key, I wil use the pointer buffkey->pdata for this,
-   * this also means that buffkey->len will be 0 */
-  buffkey.pdata = (caddr_t) &dupkey;
-  buffkey.len = sizeof(dupreq_key_t);
+  GetFromPool(pwindow, &ppart->window_pool, dupreq_window_t);
+  if(pwindow == NULL)
+    return NULL;
 
-  LogDupReq("Garbage collection on", &pdupreq->addr, pdupreq->xid, pdupreq->rq_prog);
+  memset(pwindow, 0, sizeof(dupreq_window_t));
+  memcpy(&pwindow->addr, paddr, sizeof(sockaddr_t));
+  pwindow->hash_next = ppart->windows[bucket];
+  ppart->windows[bucket] = pwindow;
 
-  return _remove_dupreq(&buffkey, pdupreq, dupreq_pool, NFS_REQ_OK);
-}                               /* clean_entry_dupreq */
+  return pwindow;
+}                               /* dupreq_get_window */
 
 /**
  *
- *  dupreq_rbt_hash_func: computes the hash value for the entry in dupreq cache.
+ * dupreq_put_window: releases the window of a TCP connection once it is
+ * empty, the partition must be locked.
  *
- * Computes the hash value for the entry in dupreq cache. In fact, it just use the Xid modulo the hash array size.
- * This function is called internal in the HasTable_* function
+ * @param ppart [IN] the partition of the connection.
+ * @param pwindow [IN] the window.
  *
- * @param hparam [IN] hash table parameter.
- * @param buffcleff[in] pointer to the hash key buffer
- *
- * @return the computed hash value.
- *
- * @see HashTable_Init
+ * @return nothing (void function)
  *
  */
-unsigned long dupreq_value_hash_func(hash_parameter_t * p_hparam,
-                                     hash_buffer_t * buffclef)
+static void dupreq_put_window(dupreq_partition_t * ppart, dupreq_window_t * pwindow)
 {
-  dupreq_key_t *pdupkey = (dupreq_key_t *)(buffclef->pdata);
-  unsigned long addr_hash = hash_sockaddr((sockaddr_t *) &pdupkey->addr, CHECK_PORT);
+  unsigned int bucket;
+  dupreq_window_t **pprev;
 
-  return (((unsigned long)pdupkey->xid + addr_hash)^(pdupkey->checksum)) % p_hparam->index_size;
-}                               /*  dupreq_value_hash_func */
+  if(pwindow->nb_entries != 0)
+    return;
+
+  bucket = hash_sockaddr(&pwindow->addr, CHECK_PORT) & (DUPREQ_PARTITION_BUCKETS - 1);
+
+  for(pprev = &ppart->windows[bucket]; *pprev != NULL; pprev = &(*pprev)->hash_next)
+    if(*pprev == pwindow)
+      {
+        *pprev = pwindow->hash_next;
+        break;
+      }
+
+  ReleaseToPool(pwindow, &ppart->window_pool);
+}                               /* dupreq_put_window */
 
 /**
  *
- *  dupreq_rbt_hash_func: computes the rbt value for the entry in dupreq cache.
+ * dupreq_remove: removes an entry from the cache, the partition must be locked.
  *
- * Computes the rbt value for the entry in dupreq cache. In fact, it just use the Xid
- * itself (which is an unsigned integer) as the rbt value.
- * This function is called internal in the HasTable_* function
+ * @param ppart [IN] the partition of the entry.
+ * @param pdupreq [IN] the entry.
  *
- * @param hparam [IN] hash table parameter.
- * @param buffcleff[in] pointer to the hash key buffer
- *
- * @return the computed rbt value.
- *
- * @see HashTable_Init
+ * @return nothing (void function)
  *
  */
-unsigned long dupreq_rbt_hash_func(hash_parameter_t * p_hparam, hash_buffer_t * buffclef)
+static void dupreq_remove(dupreq_partition_t * ppart, dupreq_entry_t * pdupreq)
 {
-  dupreq_key_t *pdupkey = (dupreq_key_t *)(buffclef->pdata);
+  dupreq_entry_t **pprev;
 
-  unsigned long addr_hash = hash_sockaddr((sockaddr_t *) &pdupkey->addr, CHECK_PORT);
+  LogDupReq("REMOVING", &pdupreq->key.addr, pdupreq->key.xid, pdupreq->rq_prog);
 
-  return (((unsigned long)pdupkey->xid + addr_hash)^(pdupkey->checksum)) % p_hparam->index_size;
-}                               /* dupreq_rbt_hash_func */
+  for(pprev = &ppart->buckets[pdupreq->bucket]; *pprev != NULL; pprev = &(*pprev)->hash_next)
+    if(*pprev == pdupreq)
+      {
+        *pprev = pdupreq->hash_next;
+        break;
+      }
+
+  /* Only finished entries are in the lists */
+  if(!pdupreq->processing)
+    {
+      if(pdupreq->lru_prev != NULL)
+        pdupreq->lru_prev->lru_next = pdupreq->lru_next;
+      else
+        ppart->lru_head = pdupreq->lru_next;
+
+      if(pdupreq->lru_next != NULL)
+        pdupreq->lru_next->lru_prev = pdupreq->lru_prev;
+      else
+        ppart->lru_tail = pdupreq->lru_prev;
+
+      if(pdupreq->pwindow != NULL)
+        {
+          dupreq_window_t *pwindow = pdupreq->pwindow;
+
+          if(pdupreq->win_prev != NULL)
+            pdupreq->win_prev->win_next = pdupreq->win_next;
+          else
+            pwindow->head = pdupreq->win_next;
+
+          if(pdupreq->win_next != NULL)
+            pdupreq->win_next->win_prev = pdupreq->win_prev;
+          else
+            pwindow->tail = pdupreq->win_prev;
+
+          pwindow->nb_entries -= 1;
+          dupreq_put_window(ppart, pwindow);
+        }
+    }
+
+  ppart->stat.nb_entries -= 1;
+  ppart->stat.ok.nb_del += 1;
+
+  ReleaseToPool(pdupreq, &ppart->entry_pool);
+}                               /* dupreq_remove */
 
 /**
  *
- * compare_req: compares the xid, ip, and port stored in the key buffers.
- * may also compare the checksum if the relevant option was enabled during
- * compile.
- *
- * compare the xid, ip, and port stored in the key buffers. This function is
- * to be used as 'compare_key' field in
- * the hashtable storing the nfs duplicated requests.
+ * dupreq_expire: removes the expired entries of a partition, which must be
+ * locked. The finished entries are kept by age, so only the expired ones
+ * are looked at.
  *
- * @param buff1 [IN] first key
- * @param buff2 [IN] second key
+ * @param ppart [IN] the partition.
+ * @param now [IN] the current date.
  *
- * @return 0 if keys are identifical, 1 if they are different.
+ * @return nothing (void function)
  *
  */
-int compare_req(hash_buffer_t * buff1, hash_buffer_t * buff2)
+static void dupreq_expire(dupreq_partition_t * ppart, time_t now)
 {
-  dupreq_key_t *key1 = (dupreq_key_t *)(buff1->pdata);
-  dupreq_key_t *key2 = (dupreq_key_t *)(buff2->pdata);
-
-  if (key1->xid != key2->xid)
-    return 1;
-  if (cmp_sockaddr(&key1->addr, &key2->addr, CHECK_PORT) == 0)
-    return 1;
-  if (key1->checksum != key2->checksum)
-    return 1;
-  return 0;
-}                               /* compare_xid */
+  while(ppart->lru_head != NULL &&
+        now - ppart->lru_head->timestamp > nfs_param.core_param.expiration_dupreq)
+    dupreq_remove(ppart, ppart->lru_head);
+}                               /* dupreq_expire */
 
 /**
  *
- * display_req_key: displays the key stored in the buffer.
+ * nfs_dupreq_delete: removes a request that will not be answered from the
+ * duplicate requests cache.
  *
- * displays the key stored in the buffer. This function is to be used as 'key_to_str' field in
- * the hashtable storing the nfs duplicated requests.
+ * @param xid [IN] the transfer id of the request
+ * @param ptr_req [IN] the request
+ * @param xprt [IN] the transport the request came from
  *
- * @param buff1 [IN]  buffer to display
- * @param buff2 [OUT] output string
- *
- * @return number of character written.
+ * @return DUPREQ_SUCCESS if successfull, DUPREQ_NOT_FOUND if the request was
+ * not in the cache.
  *
  */
-int display_req_key(hash_buffer_t * pbuff, char *str)
+int nfs_dupreq_delete(long xid, struct svc_req *ptr_req, SVCXPRT *xprt)
 {
-  dupreq_key_t *pdupkey = (dupreq_key_t *)(pbuff->pdata);
-  char namebuf[SOCK_NAME_MAX];
+  dupreq_key_t dupkey;
+  dupreq_partition_t *ppart;
+  dupreq_entry_t *pdupreq;
+  unsigned int bucket;
+  int status = DUPREQ_SUCCESS;
 
-  sprint_sockaddr(&pdupkey->addr, namebuf, sizeof(namebuf));
+  if(dupreq_make_key(&dupkey, xid, xprt) == 0)
+    return DUPREQ_NOT_FOUND;
 
-  return sprintf("addr=%s xid=%ld checksum=%d",
-                 namebuf, pdupkey->xid, pdupkey->checksum);
+  ppart = dupreq_locate(&dupkey, get_xprt_type(xprt) == XPRT_TCP, &bucket);
 
-}
+  P(ppart->lock);
 
-/**
- *
- * display_req_val: displays the value stored in the buffer.
- *
- * displays the value stored in the buffer. This function is to be used as 'val_to_str' field in
- * the hashtable storing the nfs duplicated requests.
- *
- * @param buff1 [IN]  buffer to display
- * @param buff2 [OUT] output string
- *
- * @return number of character written.
- *
- */
-int display_req_val(hash_buffer_t * pbuff, char *str)
-{
-  dupreq_entry_t *pdupreq = (dupreq_entry_t *)(pbuff->pdata);
-  char namebuf[SOCK_NAME_MAX];
+  if((pdupreq = dupreq_lookup(ppart, bucket, &dupkey)) != NULL)
+    dupreq_remove(ppart, pdupreq);
+  else
+    {
+      ppart->stat.notfound.nb_del += 1;
+      status = DUPREQ_NOT_FOUND;
+    }
 
-  sprint_sockaddr(&pdupreq->addr, namebuf, sizeof(namebuf));
+  V(ppart->lock);
 
-  return sprintf("addr=%s xid=%ld checksum=%d rq_prog=%lu rq_vers=%lu rq_proc=%lu",
-                 namebuf, pdupreq->xid, pdupreq->checksum,
-                 pdupreq->rq_prog, pdupreq->rq_vers, pdupreq->rq_proc);
-}
+  return status;
+}                               /* nfs_dupreq_delete */
 
 /**
  *
- * nfs_Init_dupreq: Init the hashtable and LRU for duplicate request cache
+ * nfs_Init_dupreq: Init the partitions of the duplicate request cache
  *
- * Perform all the required initialization for hashtable and LRU for duplicate request cache
+ * Perform all the required initialization for the duplicate request cache.
+ * hash_param.index_size is the number of partitions, hash_param.nb_node_prealloc
+ * the number of entries preallocated in each partition.
  *
  * @param param [IN] parameter used to init the duplicate request cache
  *
@@ -492,13 +442,55 @@ int display_req_val(hash_buffer_t * pbuff, char *str)
  */
 int nfs_Init_dupreq(nfs_rpc_dupreq_parameter_t param)
 {
-  if((ht_dupreq = HashTable_Init(param.hash_param)) == NULL)
+  unsigned int i;
+
+  if(param.hash_param.index_size == 0)
     {
       LogCrit(COMPONENT_DUPREQ,
-              "Cannot init the duplicate request hash table");
+              "The duplicate request cache needs at least one partition");
       return -1;
     }
 
+  dupreq_nb_partitions = param.hash_param.index_size;
+  dupreq_tcp_window = param.tcp_window;
+
+  dupreq_partitions = (dupreq_partition_t *)
+      Mem_Alloc_Label(dupreq_nb_partitions * sizeof(dupreq_partition_t),
+                      "dupreq_partitions");
+  if(dupreq_partitions == NULL)
+    {
+      LogCrit(COMPONENT_DUPREQ,
+              "Cannot allocate the partitions of the duplicate request cache");
+      return -1;
+    }
+
+  memset(dupreq_partitions, 0, dupreq_nb_partitions * sizeof(dupreq_partition_t));
+
+  for(i = 0; i < dupreq_nb_partitions; i++)
+    {
+      if(pthread_mutex_init(&dupreq_partitions[i].lock, NULL) != 0)
+        {
+          LogCrit(COMPONENT_DUPREQ,
+                  "Cannot init the lock of duplicate request cache partition #%u", i);
+          return -1;
+        }
+
+      MakePool(&dupreq_partitions[i].entry_pool, param.hash_param.nb_node_prealloc,
+               dupreq_entry_t, NULL, NULL);
+      NamePool(&dupreq_partitions[i].entry_pool, "Duplicate Request Pool %u", i);
+
+      if(!IsPoolPreallocated(&dupreq_partitions[i].entry_pool))
+        {
+          LogCrit(COMPONENT_DUPREQ,
+                  "Cannot allocate duplicate request pool #%u", i);
+          return -1;
+        }
+
+      InitPool(&dupreq_partitions[i].window_pool, param.hash_param.nb_node_prealloc,
+               dupreq_window_t, NULL, NULL);
+      NamePool(&dupreq_partitions[i].window_pool, "Duplicate Request Window Pool %u", i);
+    }
+
   return DUPREQ_SUCCESS;
 }                               /* nfs_Init_dupreq */
 
@@ -506,12 +498,17 @@ int nfs_Init_dupreq(nfs_rpc_dupreq_parameter_t param)
  *
  * nfs_dupreq_add_not_finished: adds an entry in the duplicate requests cache.
  *
- * Adds an entry in the duplicate requests cache.
+ * Adds an entry in the duplicate requests cache. If the request is already
+ * there and finished, its reply is copied to preply.
  *
  * @param xid [IN] the transfer id to be used as key
- * @param pnfsreq [IN] the request pointer to cache
+ * @param ptr_req [IN] the request to cache
+ * @param xprt [IN] the transport the request came from
+ * @param preply [OUT] the reply to send again if DUPREQ_ALREADY_EXISTS is returned
  *
  * @return DUPREQ_SUCCESS if successfull\n.
+ * @return DUPREQ_ALREADY_EXISTS if the request was already answered.
+ * @return DUPREQ_BEING_PROCESSED if the request is being processed.
  * @return DUPREQ_INSERT_MALLOC_ERROR if an error occured during the insertion process.
  *
  */
@@ -519,257 +516,283 @@ int nfs_Init_dupreq(nfs_rpc_dupreq_parameter_t param)
 int nfs_dupreq_add_not_finished(long xid,
                                 struct svc_req *ptr_req,
                                 SVCXPRT *xprt,
-                                struct prealloc_pool *dupreq_pool,
-                                nfs_res_t *res_nfs)
+                                dupreq_reply_t *preply)
 {
-  hash_buffer_t buffkey;
-  hash_buffer_t buffval;
-  hash_buffer_t buffdata;
-  dupreq_entry_t *pdupreq = NULL;
-  int status = 0;
-  dupreq_key_t *pdupkey = NULL;
-  
-  /* Entry to be cached */
-  GetFromPool(pdupreq, dupreq_pool, dupreq_entry_t);
-  if(pdupreq == NULL)
+  dupreq_key_t dupkey;
+  dupreq_partition_t *ppart;
+  dupreq_entry_t *pdupreq;
+  unsigned int bucket;
+  int status;
+
+  if(dupreq_make_key(&dupkey, xid, xprt) == 0)
     return DUPREQ_INSERT_MALLOC_ERROR;
 
-  memset(pdupreq, 0, sizeof(*pdupreq));
-  if(pthread_mutex_init(&pdupreq->dupreq_mutex, NULL) == -1)
-    {
-      ReleaseToPool(pdupreq, dupreq_pool);
-      return DUPREQ_INSERT_MALLOC_ERROR;
-    }
+  ppart = dupreq_locate(&dupkey, get_xprt_type(xprt) == XPRT_TCP, &bucket);
 
-  if((pdupkey = (dupreq_key_t *) Mem_Alloc(sizeof(dupreq_key_t))) == NULL)
+  LogDupReq("Add Not Finished", &dupkey.addr, dupkey.xid, ptr_req->rq_prog);
+
+  P(ppart->lock);
+
+  if((pdupreq = dupreq_lookup(ppart, bucket, &dupkey)) != NULL)
     {
-      ReleaseToPool(pdupreq, dupreq_pool);
-      return DUPREQ_INSERT_MALLOC_ERROR;
+      ppart->stat.ok.nb_test += 1;
+
+      if(pdupreq->processing)
+        status = DUPREQ_BEING_PROCESSED;
+      else
+        {
+          preply->len = pdupreq->reply.len;
+          memcpy(preply->buf, pdupreq->reply.buf, pdupreq->reply.len);
+          status = DUPREQ_ALREADY_EXISTS;
+        }
+
+      V(ppart->lock);
+      return status;
     }
 
-  /* Get the socket address for the key and the request */
-  if(copy_xprt_addr(&pdupkey->addr, xprt) == 0 ||
-     copy_xprt_addr(&pdupreq->addr, xprt) == 0)
+  GetFromPool(pdupreq, &ppart->entry_pool, dupreq_entry_t);
+  if(pdupreq == NULL)
     {
-      Mem_Free(pdupkey);
-      ReleaseToPool(pdupreq, dupreq_pool);
+      ppart->stat.err.nb_set += 1;
+      V(ppart->lock);
       return DUPREQ_INSERT_MALLOC_ERROR;
     }
 
-  pdupkey->xid = xid;
-  pdupreq->xid = xid;
-
-  /* Checksum the request */
-  pdupkey->checksum = 0;
-  pdupreq->checksum = 0;
-
-  /* I have to keep an integer as key, I wil use the pointer buffkey->pdata for this,
-   * this also means that buffkey->len will be 0 */
-  buffkey.pdata = (caddr_t) pdupkey;
-  buffkey.len = sizeof(dupreq_key_t);
-
-  /* I build the data with the request pointer that should be in state 'IN USE' */
+  memcpy(&pdupreq->key, &dupkey, sizeof(dupreq_key_t));
+  pdupreq->processing = 1;
   pdupreq->rq_prog = ptr_req->rq_prog;
   pdupreq->rq_vers = ptr_req->rq_vers;
   pdupreq->rq_proc = ptr_req->rq_proc;
-  pdupreq->timestamp = time(NULL);
-  pdupreq->processing = 1;
-  buffdata.pdata = (caddr_t) pdupreq;
-  buffdata.len = sizeof(dupreq_entry_t);
+  pdupreq->timestamp = 0;
+  pdupreq->lru_prev = pdupreq->lru_next = NULL;
+  pdupreq->pwindow = NULL;
+  pdupreq->win_prev = pdupreq->win_next = NULL;
+  pdupreq->reply.len = 0;
 
-  LogDupReq("Add Not Finished", &pdupreq->addr, pdupreq->xid, pdupreq->rq_prog);
+  pdupreq->bucket = bucket;
+  pdupreq->hash_next = ppart->buckets[bucket];
+  ppart->buckets[bucket] = pdupreq;
 
-  status = HashTable_Test_And_Set(ht_dupreq, &buffkey, &buffdata,
-                                  HASHTABLE_SET_HOW_SET_NO_OVERWRITE);
+  ppart->stat.nb_entries += 1;
+  ppart->stat.ok.nb_set += 1;
 
-  if (status == HASHTABLE_ERROR_KEY_ALREADY_EXISTS)
-    {
-      if(HashTable_Get(ht_dupreq, &buffkey, &buffval) == HASHTABLE_SUCCESS)
-        {
-          P(((dupreq_entry_t *)buffval.pdata)->dupreq_mutex);
-          if ( ((dupreq_entry_t *)buffval.pdata)->processing == 1)
-            {
-              status = DUPREQ_BEING_PROCESSED;
-            }
-          else
-            {
-              *res_nfs = ((dupreq_entry_t *) buffval.pdata)->res_nfs;
-              status = DUPREQ_ALREADY_EXISTS;
-            }
-          V(((dupreq_entry_t *)buffval.pdata)->dupreq_mutex);
-        }
-      else
-        status = DUPREQ_NOT_FOUND;
-    }
-  else if (status == HASHTABLE_INSERT_MALLOC_ERROR)
-      status = DUPREQ_INSERT_MALLOC_ERROR;
-  else
-    status = DUPREQ_SUCCESS;
-  if (status != DUPREQ_SUCCESS)
-    ReleaseToPool(pdupreq, dupreq_pool);
-  return status;
+  V(ppart->lock);
+
+  return DUPREQ_SUCCESS;
 }                               /* nfs_dupreq_add_not_finished */
 
 /**
  *
- * nfs_dupreq_finish: Changes the being_processed flag in a dupreq to 0 and
- * adds the reply info to the buffval.
+ * nfs_dupreq_finish: Keeps the reply of a request in the cache.
  *
- * Changes the being_processed flag in a dupreq to 0 and adds the reply info
- * to the buffval. Used after the duplicate request has already been added to
- * the dupreq cache but has not been fully processed yet.
+ * Encodes the reply of a request added by nfs_dupreq_add_not_finished, and
+ * marks it as finished. Once this is done, the results can be freed by the
+ * caller. Over TCP, the oldest replies of the connection are retired when
+ * its window is full.
  *
  * @param xid [IN] the transfer id to be used as key
- * @param pnfsreq [IN] the request pointer to cache
+ * @param ptr_req [IN] the request
+ * @param xprt [IN] the transport the request came from
+ * @param xdr_encode_func [IN] the function encoding the results
+ * @param pres [IN] the results
  *
  * @return DUPREQ_SUCCESS if successfull\n.
- * @return DUPREQ_INSERT_MALLOC_ERROR if an error occured during the insertion process.
+ * @return DUPREQ_NOT_FOUND if the request is not in the cache.
+ * @return DUPREQ_REPLY_TOO_BIG if the reply can't be cached, the request is removed.
  *
  */
 
 int nfs_dupreq_finish(long xid,
                       struct svc_req *ptr_req,
                       SVCXPRT *xprt,
-                      nfs_res_t * p_res_nfs,
-                      LRU_list_t * lru_dupreq)
+                      xdrproc_t xdr_encode_func,
+                      caddr_t pres)
 {
-  hash_buffer_t buffkey;
-  hash_buffer_t buffval;
-  LRU_entry_t *pentry = NULL;
-  LRU_status_t lru_status;
   dupreq_key_t dupkey;
+  dupreq_partition_t *ppart;
   dupreq_entry_t *pdupreq;
-
-  /* Get the socket address for the key */
-  if(copy_xprt_addr(&dupkey.addr, xprt) == 0)
+  dupreq_window_t *pwindow = NULL;
+  dupreq_reply_t reply;
+  unsigned int bucket;
+  int is_tcp;
+  int encoded;
+  XDR xdrs;
+
+  if(dupreq_make_key(&dupkey, xid, xprt) == 0)
     return DUPREQ_NOT_FOUND;
 
-  dupkey.xid = xid;
-  dupkey.checksum = 0;
+  is_tcp = (get_xprt_type(xprt) == XPRT_TCP);
+  ppart = dupreq_locate(&dupkey, is_tcp, &bucket);
 
-  /* I have to keep an integer as key, I wil use the pointer buffkey->pdata for this,
-   * this also means that buffkey->len will be 0 */
-  buffkey.pdata = (caddr_t) &dupkey;
-  buffkey.len = sizeof(dupreq_key_t);
-  if(HashTable_Get(ht_dupreq, &buffkey, &buffval) != HASHTABLE_SUCCESS)
-    return DUPREQ_NOT_FOUND;
+  /* Encode out of the lock, the entry can't go away while it is processed */
+  xdrmem_create(&xdrs, reply.buf, DUPREQ_REPLY_SIZE, XDR_ENCODE);
+  encoded = (*xdr_encode_func) (&xdrs, pres);
+  reply.len = XDR_GETPOS(&xdrs);
+  XDR_DESTROY(&xdrs);
 
-  pdupreq = (dupreq_entry_t *)buffval.pdata;
+  P(ppart->lock);
 
-  LogDupReq("Finish", &pdupreq->addr, pdupreq->xid, pdupreq->rq_prog);
+  if((pdupreq = dupreq_lookup(ppart, bucket, &dupkey)) == NULL)
+    {
+      ppart->stat.notfound.nb_get += 1;
+      V(ppart->lock);
+      return DUPREQ_NOT_FOUND;
+    }
+
+  if(!encoded)
+    {
+      LogDupReq("Reply too big for", &dupkey.addr, dupkey.xid, ptr_req->rq_prog);
+      dupreq_remove(ppart, pdupreq);
+      V(ppart->lock);
+      return DUPREQ_REPLY_TOO_BIG;
+    }
 
-  P(pdupreq->dupreq_mutex);
+  LogDupReq("Finish", &dupkey.addr, dupkey.xid, ptr_req->rq_prog);
 
-  pdupreq->res_nfs = *p_res_nfs;
+  if(is_tcp && (pwindow = dupreq_get_window(ppart, &dupkey.addr)) == NULL)
+    {
+      dupreq_remove(ppart, pdupreq);
+      ppart->stat.err.nb_get += 1;
+      V(ppart->lock);
+      return DUPREQ_INSERT_MALLOC_ERROR;
+    }
+
+  ppart->stat.ok.nb_get += 1;
+
+  memcpy(pdupreq->reply.buf, reply.buf, reply.len);
+  pdupreq->reply.len = reply.len;
   pdupreq->timestamp = time(NULL);
   pdupreq->processing = 0;
 
-  V(pdupreq->dupreq_mutex);
+  /* Newest finished entry of the partition */
+  pdupreq->lru_prev = ppart->lru_tail;
+  if(ppart->lru_tail != NULL)
+    ppart->lru_tail->lru_next = pdupreq;
+  else
+    ppart->lru_head = pdupreq;
+  ppart->lru_tail = pdupreq;
 
-  /* Add it to lru list */
-  if((pentry = LRU_new_entry(lru_dupreq, &lru_status)) == NULL)
-    return DUPREQ_INSERT_MALLOC_ERROR;
-  pentry->buffdata.pdata = buffval.pdata;
-  pentry->buffdata.len = buffval.len;
+  if(pwindow != NULL)
+    {
+      /* Newest finished entry of the connection, the oldest ones leave the window */
+      pdupreq->pwindow = pwindow;
+      pdupreq->win_prev = pwindow->tail;
+      if(pwindow->tail != NULL)
+        pwindow->tail->win_next = pdupreq;
+      else
+        pwindow->head = pdupreq;
+      pwindow->tail = pdupreq;
+      pwindow->nb_entries += 1;
+
+      while(pwindow->nb_entries > dupreq_tcp_window)
+        dupreq_remove(ppart, pwindow->head);
+    }
+
+  dupreq_expire(ppart, pdupreq->timestamp);
+
+  V(ppart->lock);
 
   return DUPREQ_SUCCESS;
 }                               /* nfs_dupreq_finish */
 
 /**
  *
- * nfs_dupreq_get: Tries to get a duplicated requests for dupreq cache
+ * xdr_dupreq_reply: sends again the results of a request.
  *
- * Tries to get a duplicated requests for dupreq cache.
+ * To be given to svc_sendreply with the reply returned by
+ * nfs_dupreq_add_not_finished.
  *
- * @param xid [IN] the transfer id we are looking for
- * @param pstatus [OUT] the pointer to the status for the operation
+ * @param xdrs [INOUT] the XDR stream
+ * @param preply [IN] the encoded results
  *
- * @return the result previously set if *pstatus == DUPREQ_SUCCESS
+ * @return TRUE if ok, FALSE otherwise.
  *
  */
-nfs_res_t nfs_dupreq_get(long xid, struct svc_req *ptr_req, SVCXPRT *xprt, int *pstatus)
+bool_t xdr_dupreq_reply(XDR * xdrs, dupreq_reply_t * preply)
 {
-  hash_buffer_t buffkey;
-  hash_buffer_t buffval;
-  nfs_res_t res_nfs;
-  dupreq_key_t dupkey;
-
-  memset(&res_nfs, 0, sizeof(res_nfs));
-
-  /* Get the socket address for the key */
-  if(copy_xprt_addr(&dupkey.addr, xprt) == 0)
-    {
-      *pstatus = DUPREQ_NOT_FOUND;
-      return res_nfs;
-    }
-
-  dupkey.xid = xid;
-  dupkey.checksum = 0;
+  if(xdrs->x_op != XDR_ENCODE)
+    return TRUE;
 
-  /* I have to keep an integer as key, I wil use the pointer buffkey->pdata for this,
-   * this also means that buffkey->len will be 0 */
-  buffkey.pdata = (caddr_t) &dupkey;
-  buffkey.len = sizeof(dupreq_key_t);
-  if(HashTable_Get(ht_dupreq, &buffkey, &buffval) == HASHTABLE_SUCCESS)
-    {
-      dupreq_entry_t *pdupreq = (dupreq_entry_t *)buffval.pdata;
-      /* reset timestamp */
-      pdupreq->timestamp = time(NULL);
-
-      *pstatus = DUPREQ_SUCCESS;
-      res_nfs = pdupreq->res_nfs;
-      LogDupReq(" dupreq_get: Hit in the dupreq cache for", &pdupreq->addr,
-		pdupreq->xid, pdupreq->rq_prog);
-    }
-  else
-    {
-      LogDupReq("Failed to get dupreq entry", &dupkey.addr, dupkey.xid, ptr_req->rq_prog);
-      *pstatus = DUPREQ_NOT_FOUND;
-    }
-  return res_nfs;
-}                               /* nfs_dupreq_get */
+  return XDR_PUTBYTES(xdrs, preply->buf, preply->len);
+}                               /* xdr_dupreq_reply */
 
 /**
  *
- * nfs_dupreq_gc_function: Tests is an entry in dupreq cache is to be set invalid (has expired).
- *
- * Tests is an entry in dupreq cache is to be set invalid (has expired).
+ * nfs_dupreq_gc: removes the expired entries of the duplicate requests cache.
  *
- * @param pentry [IN] pointer to the entry to test
+ * Finishing a request already removes the expired entries of its partition,
+ * this is for the partitions without any activity. A partition being used
+ * by another thread is skipped.
  *
- * @return 1 if entry must be set invalid, 0 if not.
- *
- * @see LRU_invalidate_by_function
- * @see LRU_gc_invalid
+ * @return nothing (void function)
  *
  */
-int nfs_dupreq_gc_function(LRU_entry_t * pentry, void *addparam)
+void nfs_dupreq_gc(void)
 {
-  dupreq_entry_t *pdupreq = NULL;
+  time_t now = time(NULL);
+  unsigned int i;
 
-  pdupreq = (dupreq_entry_t *) (pentry->buffdata.pdata);
+  for(i = 0; i < dupreq_nb_partitions; i++)
+    {
+      if(pthread_mutex_trylock(&dupreq_partitions[i].lock) != 0)
+        continue;
 
-  /* Test if entry is expired */
-  if(time(NULL) - pdupreq->timestamp > nfs_param.core_param.expiration_dupreq)
-    return LRU_LIST_SET_INVALID;
+      dupreq_expire(&dupreq_partitions[i], now);
 
-  return LRU_LIST_DO_NOT_SET_INVALID;
-}                               /* nfs_dupreq_fc_function */
+      V(dupreq_partitions[i].lock);
+    }
+}                               /* nfs_dupreq_gc */
 
 /**
  *
- * nfs_dupreq_get_stats: gets the hash table statistics for the duplicate requests.
+ * nfs_dupreq_get_stats: gets the statistics for the duplicate requests.
  *
- * Gets the hash table statistics for the duplicate requests.
+ * Gets the statistics for the duplicate requests, summed over all the
+ * partitions. The computed statistics are the number of entries in the
+ * partitions.
  *
  * @param phstat [OUT] pointer to the resulting stats.
  *
  * @return nothing (void function)
  *
- * @see HashTable_GetStats
- *
  */
 void nfs_dupreq_get_stats(hash_stat_t * phstat)
 {
-  HashTable_GetStats(ht_dupreq, phstat);
+  hash_stat_dynamic_t *pstat;
+  unsigned int total = 0;
+  unsigned int i;
+
+  memset(phstat, 0, sizeof(hash_stat_t));
+
+  if(dupreq_nb_partitions == 0)
+    return;
+
+  phstat->computed.min_rbt_num_node = ~0U;
+
+  for(i = 0; i < dupreq_nb_partitions; i++)
+    {
+      P(dupreq_partitions[i].lock);
+
+      pstat = &dupreq_partitions[i].stat;
+
+      phstat->dynamic.nb_entries += pstat->nb_entries;
+      phstat->dynamic.ok.nb_set += pstat->ok.nb_set;
+      phstat->dynamic.ok.nb_test += pstat->ok.nb_test;
+      phstat->dynamic.ok.nb_get += pstat->ok.nb_get;
+      phstat->dynamic.ok.nb_del += pstat->ok.nb_del;
+      phstat->dynamic.err.nb_set += pstat->err.nb_set;
+      phstat->dynamic.err.nb_get += pstat->err.nb_get;
+      phstat->dynamic.notfound.nb_get += pstat->notfound.nb_get;
+      phstat->dynamic.notfound.nb_del += pstat->notfound.nb_del;
+
+      if(pstat->nb_entries < phstat->computed.min_rbt_num_node)
+        phstat->computed.min_rbt_num_node = pstat->nb_entries;
+      if(pstat->nb_entries > phstat->computed.max_rbt_num_node)
+        phstat->computed.max_rbt_num_node = pstat->nb_entries;
+      total += pstat->nb_entries;
+
+      V(dupreq_partitions[i].lock);
+    }
+
+  phstat->computed.average_rbt_num_node = total / dupreq_nb_partitions;
 }                               /* nfs_dupreq_get_stats */
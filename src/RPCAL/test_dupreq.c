@@ -0,0 +1,262 @@
+/*****
+ * test the duplicate request cache: UDP entries, TCP windows, expiration,
+ * and several threads using the cache at the same time.
+ */
+
+#include "config.h"
+#include <stdio.h>
+#include <sys/types.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "rpcal.h"
+#include "stuff_alloc.h"
+#include "nfs_core.h"
+#include "nfs_dupreq.h"
+
+nfs_parameter_t nfs_param;
+
+extern struct xp_ops dg_ops;
+extern struct xp_ops vc_ops;
+
+int nfs_rpc_add_conn(int sock)
+{
+  return 0;
+}
+
+bool_t nfs_rpc_conn_pending(int sock, unsigned int pending)
+{
+  return FALSE;
+}
+
+#define EQUALS(a, b, msg, args...) do {           \
+  if (a != b) {                             \
+      printf(msg "\n", ## args);                  \
+      exit(1);                                    \
+    }                                             \
+} while(0)
+
+#define NB_THREADS     4
+#define NB_PER_THREAD  20000
+#define TCP_WINDOW     4
+
+typedef struct client__
+{
+  struct sockaddr_in udp_addr;
+  struct sockaddr_in tcp_addr;
+  SVCXPRT udp;
+  SVCXPRT tcp;
+} client_t;
+
+struct svc_req req;
+client_t clients[NB_THREADS];
+
+void create_client(client_t * pclient, int port)
+{
+    memset(pclient, 0, sizeof(client_t));
+    pclient->udp_addr.sin_family = AF_INET;
+    pclient->udp_addr.sin_port = htons(port);
+    inet_pton(AF_INET, "10.10.5.1", &(pclient->udp_addr.sin_addr));
+    memcpy(&pclient->tcp_addr, &pclient->udp_addr, sizeof(struct sockaddr_in));
+    pclient->tcp_addr.sin_port = htons(port + 100);
+
+    pclient->udp.xp_ops = &dg_ops;
+    pclient->udp.xp_rtaddr.buf = &pclient->udp_addr;
+    pclient->udp.xp_rtaddr.len = sizeof(pclient->udp_addr);
+
+    pclient->tcp.xp_ops = &vc_ops;
+    pclient->tcp.xp_rtaddr.buf = &pclient->tcp_addr;
+    pclient->tcp.xp_rtaddr.len = sizeof(pclient->tcp_addr);
+}
+
+/* A reply much bigger than DUPREQ_REPLY_SIZE */
+bool_t xdr_big_reply(XDR * xdrs, char *buf)
+{
+    return xdr_opaque(xdrs, buf, 2 * DUPREQ_REPLY_SIZE);
+}
+
+unsigned int decode_reply(dupreq_reply_t * preply)
+{
+    XDR xdrs;
+    u_int value = 0;
+
+    xdrmem_create(&xdrs, preply->buf, preply->len, XDR_DECODE);
+    EQUALS(xdr_u_int(&xdrs, &value), TRUE, "cannot decode the cached reply");
+    return value;
+}
+
+void udpcheck() {
+    client_t *pclient = &clients[0];
+    dupreq_reply_t reply;
+    char wire[64];
+    u_int value = 42;
+    XDR xdrs;
+
+    EQUALS(nfs_dupreq_add_not_finished(1, &req, &pclient->udp, &reply), DUPREQ_SUCCESS,
+           "new request not added");
+    EQUALS(nfs_dupreq_add_not_finished(1, &req, &pclient->udp, &reply), DUPREQ_BEING_PROCESSED,
+           "request in progress not detected");
+    EQUALS(nfs_dupreq_finish(1, &req, &pclient->udp, (xdrproc_t) xdr_u_int, (caddr_t) &value),
+           DUPREQ_SUCCESS, "request not finished");
+
+    /* Same xid from another port is another request */
+    EQUALS(nfs_dupreq_add_not_finished(1, &req, &clients[1].udp, &reply), DUPREQ_SUCCESS,
+           "request from another port is a duplicate");
+    EQUALS(nfs_dupreq_delete(1, &req, &clients[1].udp), DUPREQ_SUCCESS,
+           "request from another port not deleted");
+
+    memset(&reply, 0, sizeof(reply));
+    EQUALS(nfs_dupreq_add_not_finished(1, &req, &pclient->udp, &reply), DUPREQ_ALREADY_EXISTS,
+           "retransmission not detected");
+    EQUALS(decode_reply(&reply), 42, "wrong cached reply");
+
+    /* The reply is sent again as it was encoded */
+    xdrmem_create(&xdrs, wire, sizeof(wire), XDR_ENCODE);
+    EQUALS(xdr_dupreq_reply(&xdrs, &reply), TRUE, "cannot send the cached reply");
+    EQUALS(XDR_GETPOS(&xdrs), reply.len, "wrong length sent");
+    EQUALS(memcmp(wire, reply.buf, reply.len), 0, "wrong bytes sent");
+
+    EQUALS(nfs_dupreq_delete(1, &req, &pclient->udp), DUPREQ_SUCCESS, "request not deleted");
+    EQUALS(nfs_dupreq_delete(1, &req, &pclient->udp), DUPREQ_NOT_FOUND, "request deleted twice");
+    EQUALS(nfs_dupreq_finish(1, &req, &pclient->udp, (xdrproc_t) xdr_u_int, (caddr_t) &value),
+           DUPREQ_NOT_FOUND, "deleted request finished");
+}
+
+void toobigcheck() {
+    client_t *pclient = &clients[0];
+    dupreq_reply_t reply;
+    char big[2 * DUPREQ_REPLY_SIZE];
+
+    EQUALS(nfs_dupreq_add_not_finished(2, &req, &pclient->udp, &reply), DUPREQ_SUCCESS,
+           "new request not added");
+    EQUALS(nfs_dupreq_finish(2, &req, &pclient->udp, (xdrproc_t) xdr_big_reply, (caddr_t) big),
+           DUPREQ_REPLY_TOO_BIG, "big reply cached");
+    EQUALS(nfs_dupreq_delete(2, &req, &pclient->udp), DUPREQ_NOT_FOUND,
+           "request with a big reply still cached");
+}
+
+void tcpcheck() {
+    client_t *pclient = &clients[0];
+    dupreq_reply_t reply;
+    u_int xid;
+
+    for(xid = 100; xid < 110; xid++)
+      {
+        EQUALS(nfs_dupreq_add_not_finished(xid, &req, &pclient->tcp, &reply), DUPREQ_SUCCESS,
+               "new request %u not added", xid);
+        EQUALS(nfs_dupreq_finish(xid, &req, &pclient->tcp, (xdrproc_t) xdr_u_int, (caddr_t) &xid),
+               DUPREQ_SUCCESS, "request %u not finished", xid);
+      }
+
+    /* Only the last replies of the connection are kept */
+    for(xid = 110 - TCP_WINDOW; xid < 110; xid++)
+      {
+        EQUALS(nfs_dupreq_add_not_finished(xid, &req, &pclient->tcp, &reply), DUPREQ_ALREADY_EXISTS,
+               "request %u left the window", xid);
+        EQUALS(decode_reply(&reply), xid, "wrong cached reply for %u", xid);
+      }
+
+    for(xid = 100; xid < 110 - TCP_WINDOW; xid++)
+      {
+        EQUALS(nfs_dupreq_add_not_finished(xid, &req, &pclient->tcp, &reply), DUPREQ_SUCCESS,
+               "request %u still in the window", xid);
+        EQUALS(nfs_dupreq_delete(xid, &req, &pclient->tcp), DUPREQ_SUCCESS,
+               "request %u not deleted", xid);
+      }
+
+    /* Requests in progress do not count in the window */
+    EQUALS(nfs_dupreq_add_not_finished(200, &req, &pclient->tcp, &reply), DUPREQ_SUCCESS,
+           "new request not added");
+    EQUALS(nfs_dupreq_add_not_finished(110 - TCP_WINDOW, &req, &pclient->tcp, &reply),
+           DUPREQ_ALREADY_EXISTS, "request in progress advanced the window");
+    EQUALS(nfs_dupreq_delete(200, &req, &pclient->tcp), DUPREQ_SUCCESS, "request not deleted");
+}
+
+void expirecheck() {
+    hash_stat_t hstat;
+
+    nfs_dupreq_get_stats(&hstat);
+    EQUALS(hstat.dynamic.nb_entries, TCP_WINDOW, "%u entries in the cache", hstat.dynamic.nb_entries);
+
+    sleep(nfs_param.core_param.expiration_dupreq + 1);
+    nfs_dupreq_gc();
+
+    nfs_dupreq_get_stats(&hstat);
+    EQUALS(hstat.dynamic.nb_entries, 0, "%u entries left after expiration", hstat.dynamic.nb_entries);
+}
+
+void *worker(void *arg)
+{
+    client_t *pclient = (client_t *) arg;
+    dupreq_reply_t reply;
+    u_int xid;
+
+    for(xid = 1; xid <= NB_PER_THREAD; xid++)
+      {
+        EQUALS(nfs_dupreq_add_not_finished(xid, &req, &pclient->udp, &reply), DUPREQ_SUCCESS,
+               "udp request %u not added", xid);
+        EQUALS(nfs_dupreq_add_not_finished(xid, &req, &pclient->tcp, &reply), DUPREQ_SUCCESS,
+               "tcp request %u not added", xid);
+        EQUALS(nfs_dupreq_finish(xid, &req, &pclient->udp, (xdrproc_t) xdr_u_int, (caddr_t) &xid),
+               DUPREQ_SUCCESS, "udp request %u not finished", xid);
+        EQUALS(nfs_dupreq_finish(xid, &req, &pclient->tcp, (xdrproc_t) xdr_u_int, (caddr_t) &xid),
+               DUPREQ_SUCCESS, "tcp request %u not finished", xid);
+      }
+
+    return NULL;
+}
+
+void threadcheck() {
+    pthread_t threads[NB_THREADS];
+    hash_stat_t hstat;
+    int i;
+
+    nfs_param.core_param.expiration_dupreq = 180;
+
+    for(i = 0; i < NB_THREADS; i++)
+      pthread_create(&threads[i], NULL, worker, &clients[i]);
+    for(i = 0; i < NB_THREADS; i++)
+      pthread_join(threads[i], NULL);
+
+    /* All the UDP replies, and the window of each connection */
+    nfs_dupreq_get_stats(&hstat);
+    EQUALS(hstat.dynamic.nb_entries, NB_THREADS * (NB_PER_THREAD + TCP_WINDOW),
+           "%u entries in the cache", hstat.dynamic.nb_entries);
+}
+
+int main()
+{
+    nfs_rpc_dupreq_parameter_t param;
+    int i;
+
+#ifndef _NO_BUDDY_SYSTEM
+    BuddyInit(NULL);
+#endif
+
+    memset(&param, 0, sizeof(param));
+    param.hash_param.index_size = 7;
+    param.hash_param.nb_node_prealloc = 10;
+    param.tcp_window = TCP_WINDOW;
+    nfs_param.core_param.expiration_dupreq = 1;
+
+    EQUALS(nfs_Init_dupreq(param), DUPREQ_SUCCESS, "cannot init the cache");
+
+    for(i = 0; i < NB_THREADS; i++)
+      create_client(&clients[i], 700 + i);
+
+    req.rq_prog = 100003;
+    req.rq_vers = 3;
+    req.rq_proc = 2;
+
+    udpcheck();
+    toobigcheck();
+    tcpcheck();
+    expirecheck();
+    threadcheck();
+
+    printf("PASSED\n");
+    return 0;
+}
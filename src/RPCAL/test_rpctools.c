@@ -20,6 +20,16 @@ void *rpc_tcp_socket_manager_thread(void *Arg)
   return NULL;
 }
 
+int nfs_rpc_add_conn(int sock)
+{
+  return 0;
+}
+
+bool_t nfs_rpc_conn_pending(int sock, unsigned int pending)
+{
+  return FALSE;
+}
+
 
 void Fatal(void) 
 {
@@ -32,6 +32,7 @@
 #include <sys/stat.h>
 #include <unistd.h>
 #include <sys/select.h>
+#include <pthread.h>
 #include "fsal.h"
 #include "cache_inode.h"
 #include "cache_content.h"
@@ -51,6 +52,12 @@ typedef uint64_t u64;
 #define _9p_READ_BUFFER_SIZE _9P_SEND_BUFFER_SIZE
 #define _9P_MAXDIRCOUNT 2000 /* Must be bigger than _9P_SEND_BUFFER_SIZE / 40 */
 
+#define _9P_NB_IO_THREADS     4
+#define _9P_MAX_IO_THREADS    64
+#define _9P_EPOLL_MAX_EVENTS  64
+#define _9P_MAX_MSG_PER_EVENT 16    /* messages read from a socket before looking at the others */
+#define _9P_SEND_TIMEOUT      30000 /* ms waited for room in a full socket buffer */
+
 #define CONF_LABEL_9P "_9P"
 
 #define _9P_MSG_SIZE 70000 
@@ -271,6 +278,7 @@ typedef struct _9p_qid {
 typedef struct _9p_param__
 {
   unsigned short _9p_port ;
+  unsigned int   nb_io_threads ;
 } _9p_parameter_t ;
 
 typedef struct _9p_fid__
@@ -288,10 +296,23 @@ typedef struct _9p_fid__
 } _9p_fid_t ;
 
 
+struct request_data__ ;
+
+/* A connection is read by a single I/O thread, which reassembles the messages
+ * and hands them to the workers. It is freed, and its socket closed, when the
+ * I/O thread and all the requests in progress have released it. */
 typedef struct _9p_conn__
 {
   long int        sockfd ;
   struct timeval  birth;  /* This is useful if same sockfd is reused on socket's close/open  */
+  pthread_mutex_t lock ;  /* Serializes the replies sent on the socket */
+  unsigned int    refcount ;
+  unsigned int    io_thread ;
+  char            hdr[_9P_HDR_SIZE] ;      /* Header of the next message */
+  u32             hdr_len ;
+  struct request_data__ * preq ;           /* Request the current message is read into */
+  u32             msg_len ;
+  u32             read_len ;
   _9p_fid_t       fids[_9P_FID_PER_CONN] ;
 } _9p_conn_t ;
 
@@ -452,6 +473,7 @@ else                                                  \
 int _9p_read_conf( config_file_t   in_config,
                    _9p_parameter_t *pparam ) ;
 int _9p_init( _9p_parameter_t * pparam ) ;
+void _9p_register_stats( void ) ;
 
 /* Tools functions */
 int _9p_tools_get_fsal_op_context_by_uid( u32 uid, _9p_fid_t * pfid ) ;
@@ -71,6 +71,7 @@
 #define FSAL_PROXY_RECV_BUFFER_SIZE   32768
 #define FSAL_PROXY_NFS_V4             4
 #define FSAL_PROXY_RETRY_SLEEPTIME    10
+#define FSAL_PROXY_NB_RPC_CONNECTIONS 2
 
 #include "fsal_glue_const.h"
 
@@ -162,6 +163,7 @@ typedef struct
   unsigned int srv_timeout;
   unsigned short srv_port;
   unsigned int use_privileged_client_port ;
+  unsigned int nb_rpc_connections;    /* Shared multiplexed connections, 0 for one per thread */
   char srv_proto[MAXNAMLEN];
   char local_principal[MAXNAMLEN];
   char remote_principal[MAXNAMLEN];
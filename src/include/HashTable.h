@@ -56,6 +56,12 @@ typedef struct hashparameter__ *p_hash_parameter_t;
 
 typedef int (*ref_func)(void *);
 
+typedef enum hash_engine__
+{
+  HASHTABLE_ENGINE_RBT = 0,              /**< One red-black tree and one rw-lock per index (default). */
+  HASHTABLE_ENGINE_OPEN_ADDRESSING = 1   /**< One resizable linear probing table and one mutex per index, lock-free reads. */
+} hash_engine_t;
+
 typedef struct hashparameter__
 {
   unsigned int index_size;                                    /**< Number of rbtree managed, this MUST be a prime number. */
@@ -69,6 +75,7 @@ typedef struct hashparameter__
   int (*key_to_str) (hash_buffer_t *, char *);                                  /**< Function used to convert a key to a string. */
   int (*val_to_str) (hash_buffer_t *, char *);                                  /**< Function used to convert a value to a string. */
   char *name;                                                                   /**< Name of this hash table. */
+  hash_engine_t engine;                                                         /**< Storage engine, see HashTable_EngineFromStr. */
 } hash_parameter_t;
 
 typedef unsigned long (*hash_function_t) (hash_parameter_t *, hash_buffer_t *);
@@ -105,6 +112,39 @@ typedef struct hashstat__
   hash_stat_computed_t computed;  /**< Statistics computed when HashTable_GetStats is called. */
 } hash_stat_t;
 
+/* Open addressing engine: the slot array of a partition. A resized partition
+ * gets a new array, the old one is retired and only freed once no lock-free
+ * reader is left on the partition, so that a reader still walking it never
+ * touches released memory. Lock-free readers
+ * never follow data.buffkey.pdata either (the key may be freed as soon as it
+ * is removed), they compare the inline copy of the key. */
+#define HASHTABLE_OPEN_INLINE_KEY 32
+
+typedef struct hash_slot__
+{
+  uint64_t tag;                          /**< Mix of hashval and rbt value, 0 means empty slot */
+  hash_data_t data;                      /**< The (key,val) couple */
+  unsigned int key_len;                  /**< Length of the inline copy of the key, 0 if the key does not fit */
+  char key[HASHTABLE_OPEN_INLINE_KEY];   /**< Inline copy of the key, for lock-free readers */
+} hash_slot_t;
+
+typedef struct hash_slot_array__
+{
+  unsigned int mask;                     /**< Number of slots - 1, the number of slots is a power of 2 */
+  struct hash_slot_array__ *retired;     /**< Next array in the retired list of the partition */
+  hash_slot_t slots[1];                  /**< The slots themselves */
+} hash_slot_array_t;
+
+typedef struct hash_partition__
+{
+  pthread_mutex_t lock;                  /**< Serializes the writers of the partition */
+  volatile unsigned int seq;             /**< Odd while a writer is modifying the slots */
+  unsigned int nb_used;                  /**< Number of busy slots */
+  volatile unsigned int nb_readers;      /**< Number of lock-free readers in the partition */
+  hash_slot_array_t *volatile array;     /**< Current slot array */
+  hash_slot_array_t *retired;            /**< Arrays replaced by a resize, not freed yet */
+} hash_partition_t;
+
 typedef struct hashtable__
 {
   hash_parameter_t parameter;           /**< Definition parameter for the HashTable */
@@ -113,6 +153,7 @@ typedef struct hashtable__
   rw_lock_t *array_lock;                /**< Array of rw-locks for MT-safe management */
   struct prealloc_pool *node_prealloc;  /**< Pre-allocated nodes, ready to use for new entries (array of size parameter.nb_node_prealloc) */
   struct prealloc_pool *pdata_prealloc; /**< Pre-allocated pdata buffers  ready to use for new entries */
+  hash_partition_t *partitions;         /**< Open addressing partitions (of size parameter.index_size), NULL for the RBT engine */
 } hash_table_t;
 
 typedef enum hashtable_set_how__
@@ -123,6 +164,12 @@ typedef enum hashtable_set_how__
 
 /* @} */
 
+/* Initial number of slots of an open addressing partition */
+#define HASHTABLE_OPEN_MIN_SLOTS 16
+
+/* Number of optimistic attempts of a lock-free read before taking the partition lock */
+#define HASHTABLE_OPEN_READ_RETRIES 8
+
 /* How many character used to display a key or value */
 #define HASHTABLE_DISPLAY_STRLEN 8192
 
@@ -151,6 +198,8 @@ void HashTable_GetStats(hash_table_t * ht, hash_stat_t * hstat);
 void HashTable_Log(log_components_t component, hash_table_t * ht);
 void HashTable_Print(hash_table_t * ht);
 unsigned int HashTable_GetSize(hash_table_t * ht);
+int HashTable_EngineFromStr(char *str);
+const char *HashTable_EngineToStr(hash_engine_t engine);
 
 /* The following function allows an atomic fetch hash only once,
  * If the entry is found, it is removed.
@@ -171,4 +220,27 @@ int HashTable_DelRef(hash_table_t * ht, hash_buffer_t * buffkey,
                      hash_buffer_t * p_usedbuffkey, hash_buffer_t * p_usedbuffdata,
                      int (*put_ref)(hash_buffer_t *) );
 
+/*
+ * Open addressing engine (HashTable_open.c), reached through the functions
+ * above when parameter.engine is HASHTABLE_ENGINE_OPEN_ADDRESSING.
+ *
+ * HashTable_Get does not take any lock with this engine: it may call
+ * compare_key on the key buffer of an entry being removed concurrently, so
+ * the key buffers of removed entries must remain readable memory (pool or
+ * malloc'ed buffers are fine). The result of such a call is never used.
+ */
+int HashTable_Open_Init(hash_table_t * ht);
+int HashTable_Open_Test_And_Set(hash_table_t * ht, hash_buffer_t * buffkey,
+                                hash_buffer_t * buffval, hashtable_set_how_t how);
+int HashTable_Open_GetRef(hash_table_t * ht, hash_buffer_t * buffkey, hash_buffer_t * buffval,
+                          void (*get_ref)(hash_buffer_t *) );
+int HashTable_Open_Get_and_Del(hash_table_t  * ht, hash_buffer_t * buffkey,
+                               hash_buffer_t * buffval, hash_buffer_t * buff_used_key);
+int HashTable_Open_DelRef(hash_table_t * ht, hash_buffer_t * buffkey,
+                          hash_buffer_t * p_usedbuffkey, hash_buffer_t * p_usedbuffdata,
+                          int (*put_ref)(hash_buffer_t *) );
+int HashTable_Open_Delall(hash_table_t * ht,
+                          int (*free_func)(hash_buffer_t, hash_buffer_t) );
+void HashTable_Open_Dump(hash_table_t * ht, log_components_t component, int to_stderr);
+
 #endif                          /* _HASHTABLE_H */
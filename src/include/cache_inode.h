@@ -89,6 +89,12 @@ typedef struct cache_inode_client_t cache_inode_client_t;
 #define NB_CHUNCK_READDIR 4     /* Should be equal to FSAL_READDIR_SIZE divided by CHILDREN_ARRAY_SIZE */
 
 #define CACHE_INODE_UNSTABLE_BUFFERSIZE 100*1024*1024
+#define CACHE_INODE_UNSTABLE_MAX_TOTAL  (4*CACHE_INODE_UNSTABLE_BUFFERSIZE)
+
+#define CACHE_INODE_READAHEAD_NB_EXTENTS 2      /* Prefetched extents kept per file        */
+#define CACHE_INODE_READAHEAD_MIN_SEQ    2      /* Sequential reads before prefetching     */
+#define CACHE_INODE_READAHEAD_LIFETIME   30     /* Seconds a prefetched extent stays valid */
+#define CACHE_INODE_READAHEAD_NB_LOCKS   64
 #define DIR_ENTRY_NAMLEN 1024
 
 #define CACHE_INODE_TIME( pentry ) (pentry->internal_md.read_time > pentry->internal_md.mod_time)?pentry->internal_md.read_time:pentry->internal_md.mod_time
@@ -150,6 +156,7 @@ typedef struct cache_inode_stat__
     unsigned int nb_err_unrecover[CACHE_INODE_NB_COMMAND];                /**< failed/unrecoverable calls per function */
   } func_stats;
   unsigned int nb_call_total;                                       /**< Total number of calls */
+  uint64_t func_start[CACHE_INODE_NB_COMMAND];                      /**< Start of the pending call per function, in ns */
 } cache_inode_stat_t;
 
 typedef struct cache_inode_parameter__
@@ -181,6 +188,9 @@ typedef struct cache_inode_client_parameter__
   time_t retention;                                    /**< Fd retention duration                            */
   unsigned int use_cache;                              /** Do we cache fd or not ?                           */
   unsigned int use_fsal_hash ;                         /** Do we rely on FSAL to hash handle or not ?        */
+  unsigned int readahead_max_window;                   /**< Max bytes prefetched per file, 0 to disable      */
+  unsigned int readahead_max_memory;                   /**< Max bytes prefetched for all the files           */
+  unsigned int nb_readahead_thread;                    /**< Number of read-ahead threads                     */
 } cache_inode_client_parameter_t;
 
 typedef struct cache_inode_opened_file__
@@ -260,13 +270,40 @@ struct cache_inode_symlink__
   fsal_path_t content;                                    /**< Content of the link */
 };
 
+typedef struct cache_inode_unstable_range__
+{
+  struct glist_head q;          /**< Link in the file's range list, sorted by offset */
+  uint64_t offset;              /**< Offset of the range in the file                 */
+  uint64_t length;              /**< Number of bytes in the range                    */
+  uint64_t size;                /**< Allocated size of buffer                        */
+  caddr_t buffer;               /**< The unstable data                               */
+} cache_inode_unstable_range_t;
+
 typedef struct cache_inode_unstable_data__
 {
-  caddr_t buffer;
-  uint64_t offset;
-  uint32_t length;
+  struct glist_head ranges;     /**< Disjoint, non adjacent, unstable ranges         */
+  uint64_t length;              /**< Number of unstable bytes for this file          */
 } cache_inode_unstable_data_t;
 
+typedef struct cache_inode_readahead_extent__
+{
+  uint64_t offset;              /**< Offset of the prefetched data in the file       */
+  uint64_t length;              /**< Number of bytes prefetched                      */
+  caddr_t buffer;               /**< The prefetched data, NULL if the slot is free   */
+  fsal_boolean_t eof;           /**< The extent ends at the end of the file          */
+  time_t time;                  /**< When the data was read from the FSAL            */
+} cache_inode_readahead_extent_t;
+
+typedef struct cache_inode_readahead__
+{
+  uint64_t next_offset;         /**< Where the next sequential read would start      */
+  unsigned int seq_count;       /**< Number of consecutive sequential reads          */
+  uint64_t window;              /**< Current read-ahead window, 0 if none yet        */
+  unsigned int generation;      /**< Changed when the file is modified               */
+  struct cache_inode_readahead_job__ *pjob;     /**< Prefetch queued or running      */
+  cache_inode_readahead_extent_t extent[CACHE_INODE_READAHEAD_NB_EXTENTS];
+} cache_inode_readahead_t;
+
 struct cache_entry_t
 {
   union cache_inode_fsobj__
@@ -288,6 +325,7 @@ struct cache_entry_t
       struct glist_head lock_list;                                   /**< Pointers for lock list                               */
       pthread_mutex_t lock_list_mutex;                               /**< Mutex to protect lock list                           */
       cache_inode_unstable_data_t unstable_data;                     /**< Unstable data, for use with WRITE/COMMIT             */
+      cache_inode_readahead_t readahead;                             /**< Sequential read detection and prefetched data        */
     } file;                                   /**< file related filed     */
 
     struct cache_inode_symlink__ *symlink;     /**< symlink related field  */
@@ -303,6 +341,10 @@ struct cache_entry_t
       unsigned int nbdircont;                   /**< Number of DIR_CONT associated with the DIR_BEGIN        */
       cache_inode_flag_t has_been_readdir;      /**< True if a full readdir was performed on the directory   */
       char *referral;                           /**< NULL is not a referral, is not this a 'referral string' */
+      struct rbt_head dirent_names;             /**< Index of the active dirents of the chain, by name hash  */
+      cache_entry_t **pdir_cont_index;          /**< DIR_CONTINUE of the chain, by dir_cont_pos              */
+      unsigned int dir_cont_index_size;         /**< Allocated size of pdir_cont_index                       */
+      unsigned int dir_cont_index_nb;           /**< Number of chunks in the chain (DIR_BEGINNING included)  */
 
       struct cache_inode_dir_data__
       {
@@ -311,6 +353,7 @@ struct cache_entry_t
           cache_inode_entry_valid_state_t active;       /**< A flag to get the validity state for the direntry   */
           cache_entry_t *pentry;                        /**< Pointer to the cached entry (if direntry is active) */
           fsal_name_t name;                             /**< Name of the entry                                   */
+          rbt_node_t name_node;                         /**< Node in dirent_names (if direntry is active)       */
         } dir_entries[CHILDREN_ARRAY_SIZE];             /**< Array of cached directory entries                   */
       } *pdir_data;
 
@@ -338,8 +381,8 @@ struct cache_entry_t
 
   rw_lock_t lock;                             /**< a reader-writter lock used to protect the data     */
   cache_inode_internal_md_t internal_md;      /**< My metadata (from this cache's point of view)      */
-  LRU_entry_t *gc_lru_entry;                  /**< related LRU entry in the LRU list used for GC      */
-  LRU_list_t *gc_lru;                         /**< related LRU list for GC                            */
+  struct glist_head lru_q;                    /**< Link in the global LRU lane used for GC            */
+  unsigned int lru_flags;                     /**< CACHE_INODE_LRU_* flags, protected by the lane lock */
 
   struct cache_inode_parent_entry__
   {
@@ -367,12 +410,12 @@ typedef struct cache_inode_fsal_data__
   unsigned int cookie;                          /**< Cache inode cookie    */
 } cache_inode_fsal_data_t;
 
-#define SMALL_CLIENT_INDEX 0x20000000
-#define NLM_THREAD_INDEX   0x40000000
+#define SMALL_CLIENT_INDEX  0x20000000
+#define NLM_THREAD_INDEX    0x40000000
+#define REAPER_THREAD_INDEX 0x60000000
 
 struct cache_inode_client_t
 {
-  LRU_list_t *lru_gc;                                              /**< Pointer to the worker's LRU used for Garbagge collection */
   struct prealloc_pool pool_entry;                                 /**< Worker's preallocad cache entries pool                   */
   struct prealloc_pool pool_entry_symlink;                         /**< Symlink data for cache entries of type symlink           */
   struct prealloc_pool pool_dir_data;                              /**< Worker's preallocad cache directory data pool            */
@@ -398,8 +441,6 @@ struct cache_inode_client_t
   time_t grace_period_dirent;                                      /**< Cached directory entries grace period                    */
   unsigned int use_test_access;                                    /**< Is FSAL_test_access to be used instead of FSAL_access    */
   unsigned int getattr_dir_invalidation;                           /**< Use getattr as cookie for directory invalidation         */
-  unsigned int call_since_last_gc;                                 /**< Number of call to cache_inode since the last gc run      */
-  time_t time_of_last_gc;                                          /**< Epoch time for the last gc run for this thread           */
   time_t time_of_last_gc_fd;                                       /**< Epoch time for the last file descriptor gc               */
   caddr_t pcontent_client;                                         /**< Pointer to cache content client                          */
   void *pworker;                                                   /**< Pointer to the information on the worker I belong to     */
@@ -429,6 +470,76 @@ typedef struct cache_inode_param_gc__
   unsigned int nb_to_be_purged;
 } cache_inode_param_gc_t;
 
+/* The global LRU used by the garbage collector is split into lanes, each one
+ * protected by its own mutex, so that workers validating entries only contend
+ * when they touch entries hashed to the same lane. */
+#define CACHE_INODE_LRU_NB_LANES 17
+#define CACHE_INODE_LRU_BATCH    64
+
+#define CACHE_INODE_LRU_LINKED   0x01   /**< entry is queued in its lane                 */
+#define CACHE_INODE_LRU_RECLAIM  0x02   /**< entry is detached and examined by the gc    */
+
+#define CACHE_INODE_LRU_LANE( pentry ) \
+  ((unsigned int)(((unsigned long)(pentry) >> 6) % CACHE_INODE_LRU_NB_LANES))
+
+typedef struct cache_inode_lru_lane__
+{
+  pthread_mutex_t lock;
+  struct glist_head q;                  /**< LRU at the head, MRU at the tail */
+  unsigned int size;
+} cache_inode_lru_lane_t;
+
+/* Entries garbaged by the reaper thread are released to the reaper's own
+ * pools. Workers take them back from there before growing their own pools so
+ * that the memory does not pile up in the reaper. The prealloc pools are not
+ * thread safe, hence the mutex around every access to the reaper's pools. */
+typedef struct cache_inode_lru_recycle__
+{
+  pthread_mutex_t lock;
+  cache_inode_client_t *pclient;        /**< the reaper's client, NULL if none */
+  unsigned int nb_pool_entry;
+  unsigned int nb_pool_entry_symlink;
+  unsigned int nb_pool_dir_data;
+  unsigned int nb_pool_parent;
+  unsigned int nb_pool_key;
+} cache_inode_lru_recycle_t;
+
+extern cache_inode_lru_recycle_t cache_inode_lru_recycle;
+
+#define CACHE_INODE_GET_FROM_POOL( entry, pcl, pool, type )                     \
+do {                                                                            \
+  entry = NULL;                                                                 \
+  if( cache_inode_lru_recycle.pclient != NULL &&                                \
+      ( (pcl) == cache_inode_lru_recycle.pclient ||                             \
+        cache_inode_lru_recycle.nb_##pool > 0 ) )                               \
+    {                                                                           \
+      P( cache_inode_lru_recycle.lock ) ;                                       \
+      if( (pcl) == cache_inode_lru_recycle.pclient ||                           \
+          cache_inode_lru_recycle.nb_##pool > 0 )                               \
+        {                                                                       \
+          GetFromPool( entry, &cache_inode_lru_recycle.pclient->pool, type ) ;  \
+          if( entry != NULL && cache_inode_lru_recycle.nb_##pool > 0 )          \
+            cache_inode_lru_recycle.nb_##pool -= 1 ;                            \
+        }                                                                       \
+      V( cache_inode_lru_recycle.lock ) ;                                       \
+    }                                                                           \
+  if( entry == NULL )                                                           \
+    GetFromPool( entry, &(pcl)->pool, type ) ;                                  \
+} while( 0 )
+
+#define CACHE_INODE_RELEASE_TO_POOL( entry, pcl, pool )                         \
+do {                                                                            \
+  if( (pcl) == cache_inode_lru_recycle.pclient )                                \
+    {                                                                           \
+      P( cache_inode_lru_recycle.lock ) ;                                       \
+      ReleaseToPool( entry, &(pcl)->pool ) ;                                    \
+      cache_inode_lru_recycle.nb_##pool += 1 ;                                  \
+      V( cache_inode_lru_recycle.lock ) ;                                       \
+    }                                                                           \
+  else                                                                          \
+    ReleaseToPool( entry, &(pcl)->pool ) ;                                      \
+} while( 0 )
+
 typedef union cache_inode_create_arg__
 {
   fsal_path_t link_content;
@@ -492,14 +603,31 @@ typedef enum cache_inode_status_t
 
 const char *cache_inode_err_str(cache_inode_status_t err);
 
+/* A call starts the latency measure of the function, its outcome ends it */
 #define inc_func_call(pclient, x)                       \
-    pclient->stat.func_stats.nb_call[x] += 1
+  do {                                                  \
+    pclient->stat.func_stats.nb_call[x] += 1;           \
+    cache_inode_stat_start(pclient, x);                 \
+  } while(0)
 #define inc_func_success(pclient, x)                    \
-    pclient->stat.func_stats.nb_success[x] += 1
+  do {                                                  \
+    pclient->stat.func_stats.nb_success[x] += 1;        \
+    cache_inode_stat_end(pclient, x);                   \
+  } while(0)
 #define inc_func_err_retryable(pclient, x)              \
-    pclient->stat.func_stats.nb_err_retryable[x] += 1
+  do {                                                  \
+    pclient->stat.func_stats.nb_err_retryable[x] += 1;  \
+    cache_inode_stat_end(pclient, x);                   \
+  } while(0)
 #define inc_func_err_unrecover(pclient, x)              \
-    pclient->stat.func_stats.nb_err_unrecover[x] += 1
+  do {                                                  \
+    pclient->stat.func_stats.nb_err_unrecover[x] += 1;  \
+    cache_inode_stat_end(pclient, x);                   \
+  } while(0)
+
+void cache_inode_register_stats(void);
+void cache_inode_stat_start(cache_inode_client_t * pclient, int func);
+void cache_inode_stat_end(cache_inode_client_t * pclient, int func);
 
 cache_inode_status_t cache_inode_clean_entry(cache_entry_t * pentry);
 
@@ -512,7 +640,7 @@ void cache_inode_release_fsaldata_key(hash_buffer_t * pkey,
                                       cache_inode_client_t * pclient);
 
 void cache_inode_release_symlink(cache_entry_t * pentry,
-                                 struct prealloc_pool *pool);
+                                 cache_inode_client_t * pclient);
 
 hash_table_t *cache_inode_init(cache_inode_parameter_t param,
                                cache_inode_status_t * pstatus);
@@ -698,6 +826,19 @@ cache_entry_t *cache_inode_operate_cached_dirent(cache_entry_t * pentry_parent,
                                                  cache_inode_dirent_op_t dirent_op,
                                                  cache_inode_status_t * pstatus);
 
+void cache_inode_dirent_index_init(cache_entry_t * pentry_dir);
+
+void cache_inode_dirent_index_release(cache_entry_t * pentry_dir);
+
+cache_inode_dir_entry_t *cache_inode_dirent_find(cache_entry_t * pentry_parent,
+                                                 fsal_name_t * pname,
+                                                 int check_state,
+                                                 cache_entry_t ** ppdir_chain);
+
+void cache_inode_dirent_invalidate(cache_entry_t * pdir_chain, unsigned int slot);
+
+cache_entry_t *cache_inode_dirent_chunk(cache_entry_t * pentry_dir, unsigned int pos);
+
 cache_inode_status_t cache_inode_remove_cached_dirent(cache_entry_t * pentry_parent,
                                                       fsal_name_t * pname,
                                                       hash_table_t * ht,
@@ -804,6 +945,53 @@ cache_inode_status_t cache_inode_commit(cache_entry_t * pentry,
                                         uint64_t typeofcommit,
                                         cache_inode_status_t * pstatus);
 
+void cache_inode_unstable_init(cache_entry_t * pentry);
+
+cache_inode_status_t cache_inode_unstable_add(cache_entry_t * pentry,
+                                              uint64_t offset,
+                                              fsal_size_t length,
+                                              caddr_t buffer,
+                                              cache_inode_client_t * pclient,
+                                              fsal_op_context_t * pcontext,
+                                              cache_inode_status_t * pstatus);
+
+cache_inode_status_t cache_inode_unstable_flush(cache_entry_t * pentry,
+                                                uint64_t offset,
+                                                fsal_size_t count,
+                                                cache_inode_client_t * pclient,
+                                                fsal_op_context_t * pcontext,
+                                                cache_inode_status_t * pstatus);
+
+void cache_inode_unstable_truncate(cache_entry_t * pentry, uint64_t length);
+
+void cache_inode_unstable_release(cache_entry_t * pentry);
+
+unsigned int cache_inode_unstable_get_epoch(void);
+
+int cache_inode_readahead_set_param(cache_inode_client_parameter_t * pparam);
+
+void *cache_inode_readahead_thread(void *arg);
+
+void cache_inode_readahead_init(cache_entry_t * pentry);
+
+fsal_boolean_t cache_inode_readahead_get(cache_entry_t * pentry,
+                                         fsal_op_context_t * pcontext,
+                                         uint64_t offset,
+                                         fsal_size_t size,
+                                         caddr_t buffer,
+                                         fsal_size_t * pio_size,
+                                         fsal_boolean_t * p_fsal_eof);
+
+void cache_inode_readahead_update(cache_entry_t * pentry,
+                                  fsal_op_context_t * pcontext,
+                                  uint64_t offset,
+                                  fsal_size_t io_size, fsal_boolean_t eof);
+
+void cache_inode_readahead_invalidate(cache_entry_t * pentry);
+
+void cache_inode_readahead_release(cache_entry_t * pentry);
+void cache_inode_readahead_drain(void);
+
 cache_inode_status_t cache_inode_readdir_populate(cache_entry_t * pentry_dir,
                                                   hash_table_t * ht,
                                                   cache_inode_client_t * pclient,
@@ -888,6 +1076,18 @@ cache_inode_status_t cache_inode_gc(hash_table_t * ht,
 cache_inode_status_t cache_inode_gc_fd(cache_inode_client_t * pclient,
                                        cache_inode_status_t * pstatus);
 
+typedef int (*cache_inode_lru_func_t) (cache_entry_t * pentry,
+                                       cache_inode_param_gc_t * pgcparam);
+
+void cache_inode_lru_init(void);
+void cache_inode_lru_ref(cache_entry_t * pentry);
+void cache_inode_lru_remove(cache_entry_t * pentry);
+unsigned int cache_inode_lru_count(void);
+unsigned int cache_inode_lru_apply(cache_inode_lru_func_t func,
+                                   cache_inode_param_gc_t * pgcparam);
+void cache_inode_lru_set_recycle_client(cache_inode_client_t * pclient);
+void cache_inode_lru_wait_reaper(unsigned int hwmark, unsigned int timeout);
+
 cache_inode_status_t cache_inode_kill_entry(cache_entry_t * pentry,
                                             hash_table_t * ht,
                                             cache_inode_client_t * pclient,
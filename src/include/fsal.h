@@ -536,6 +536,16 @@ fsal_status_t FSAL_readdir(fsal_dir_t * dir_descriptor, /* IN */
                            fsal_boolean_t * end_of_dir  /* OUT */
     );
 
+fsal_status_t FSAL_readdir_plus(fsal_dir_t * dir_descriptor,    /* IN */
+                                fsal_cookie_t start_position,   /* IN */
+                                fsal_attrib_mask_t get_attr_mask,       /* IN */
+                                fsal_count_t nb_max,    /* IN */
+                                fsal_dirent_t * pdirent,        /* OUT */
+                                fsal_cookie_t * end_position,   /* OUT */
+                                fsal_count_t * nb_entries,      /* OUT */
+                                fsal_boolean_t * end_of_dir     /* OUT */
+    );
+
 fsal_status_t FSAL_closedir(fsal_dir_t * dir_descriptor /* IN */
     );
 
@@ -683,6 +693,12 @@ fsal_status_t FSAL_UP_GetEvents(struct fsal_up_event_t_ ** pevents,
 /* To be called before exiting */
 fsal_status_t FSAL_terminate();
 
+/* Latency histograms of the FSAL calls, to be called before the workers start */
+void FSAL_register_stats(void);
+
+/* The next call of the current thread fails with ERR_FSAL_DELAY if its export is congested */
+void FSAL_SetCongestionDelay(fsal_boolean_t delay);
+
 #ifndef _USE_SWIG
 
 /******************************************************
@@ -1028,6 +1044,16 @@ typedef struct fsal_functions__
                                 fsal_count_t * p_nb_entries,    /* OUT */
                                 fsal_boolean_t * p_end_of_dir /* OUT */ );
 
+  /* FSAL_readdir_plus (optional, FSAL_readdir is used when NULL) */
+  fsal_status_t(*fsal_readdir_plus) (fsal_dir_t * p_dir_descriptor,     /* IN */
+                                     fsal_cookie_t start_position,      /* IN */
+                                     fsal_attrib_mask_t get_attr_mask,  /* IN */
+                                     fsal_count_t nb_max,       /* IN */
+                                     fsal_dirent_t * p_pdirent, /* OUT */
+                                     fsal_cookie_t * p_end_position,    /* OUT */
+                                     fsal_count_t * p_nb_entries,       /* OUT */
+                                     fsal_boolean_t * p_end_of_dir /* OUT */ );
+
   /* FSAL_closedir */
   fsal_status_t(*fsal_closedir) (fsal_dir_t * p_dir_descriptor /* IN */ );
 
@@ -0,0 +1,104 @@
+/*
+ * vim:expandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * ---------------------------------------
+ */
+
+/**
+ * \file    fsal_admission.h
+ * \brief   Adaptive limit of the FSAL calls in progress, per export.
+ *
+ * fsal_admission.h : Every export has two windows, one for the metadata
+ * calls and one for the data calls, which bound how many calls of the kind
+ * reach the backend at the same time. A window follows the latency of its
+ * calls (AIMD): it grows by one call each time a full window of calls
+ * completes without congestion, and shrinks by a quarter when the average
+ * latency exceeds the lowest recent latency by more than the tolerance, or
+ * when the backend asks to retry later.
+ *
+ * A call that finds its window full waits behind it. At most a window of
+ * calls wait, the next ones that may be refused (the first call of a NFSv3
+ * request) fail with ERR_FSAL_DELAY so that a slow export cannot hold every
+ * worker.
+ *
+ */
+
+#ifndef _FSAL_ADMISSION_H
+#define _FSAL_ADMISSION_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+/* Admission errors */
+#define FSAL_ADMIT_SUCCESS         0
+#define FSAL_ADMIT_REFUSED         1
+
+/* Defaults */
+#define FSAL_ADMIT_MIN_WINDOW      4
+#define FSAL_ADMIT_MAX_WINDOW      64
+#define FSAL_ADMIT_TOLERANCE       200  /* percent of the base latency */
+#define FSAL_ADMIT_BASE_PERIOD     1000 /* calls over which the base latency is the lowest one */
+
+typedef enum fsal_admit_class__
+{
+  FSAL_ADMIT_METADATA = 0,
+  FSAL_ADMIT_DATA = 1,
+  FSAL_ADMIT_NB_CLASS = 2
+} fsal_admit_class_t;
+
+typedef struct fsal_admit_parameter__
+{
+  unsigned int enabled;
+  unsigned int min_window;
+  unsigned int max_window;
+  unsigned int tolerance;
+  unsigned int base_period;
+} fsal_admit_parameter_t;
+
+typedef struct fsal_admit_stats__
+{
+  unsigned int window;
+  unsigned int inflight;
+  unsigned int waiting;
+  uint64_t latency_base;        /* ns */
+  uint64_t latency_avg;         /* ns */
+  uint64_t nb_admitted;
+  uint64_t nb_waited;
+  uint64_t nb_refused;
+  uint64_t nb_increase;
+  uint64_t nb_decrease;
+} fsal_admit_stats_t;
+
+struct fsal_admit_queue__;
+
+typedef struct fsal_admit_ticket__
+{
+  struct fsal_admit_queue__ *queue;     /* NULL if the call was not counted */
+  uint64_t start;
+} fsal_admit_ticket_t;
+
+int fsal_admit_init(fsal_admit_parameter_t * pparam);
+
+int fsal_admit_enter(fsal_admit_ticket_t * pticket, void *key,
+                     fsal_admit_class_t class, int may_refuse);
+void fsal_admit_exit(fsal_admit_ticket_t * pticket, int congested);
+void fsal_admit_release(void *key);
+
+int fsal_admit_get_stats(void *key, fsal_admit_class_t class,
+                         fsal_admit_stats_t * pstats);
+
+#endif                          /* _FSAL_ADMISSION_H */
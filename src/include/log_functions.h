@@ -311,6 +311,20 @@ char *ReturnLevelInt(int level);
 int MakeLogError(char *buffer, int num_family, int num_error, int status,
                   int ma_ligne);
 
+/* Asynchronous logging to files: each thread formats its messages into a
+ * private ring of LOG_RING_SIZE bytes, a single writer thread drains the
+ * rings every LOG_FLUSH_DELAY ms and writes them with writev to log files
+ * it keeps open. Messages that don't fit in a full ring are dropped and
+ * counted. */
+#define LOG_RING_SIZE      65536
+#define LOG_FLUSH_DELAY    100  /* milliseconds */
+#define LOG_MAX_FILES      16
+
+int StartLogWriter(void);       /* not thread safe */
+void ReopenLogFiles(void);
+void FlushLogs(void);
+unsigned long GetLogDropCount(void);
+
 int log_vsnprintf(char *out, size_t n, char *format, va_list arguments);
 int log_snprintf(char *out, size_t n, char *format, ...);
 int log_fprintf(FILE * file, char *format, ...);
@@ -134,6 +134,7 @@ typedef struct log_component_info
   int   comp_log_type;
   char  comp_log_file[MAXPATHLEN];
   char *comp_buffer;
+  int   comp_log_fileidx; /* 1 + index of comp_log_file in the async writer's table, 0 if unknown */
 } log_component_info;
 
 #define ReturnLevelComponent(component) LogComponents[component].comp_log_level
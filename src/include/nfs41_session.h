@@ -59,17 +59,29 @@
 #include "nfs4.h"
 
 #define NFS41_SESSION_PER_CLIENT 3
-#define NFS41_NB_SLOTS           3
-#define NFS41_DRC_SIZE          32768
+#define NFS41_NB_SLOTS           3      /* Slots granted when the client asks for none */
+#define NFS41_MAX_SLOTS          1024   /* Hard limit on a session's slot table */
+#define NFS41_DRC_SIZE           32768  /* Largest reply kept in a slot's cache */
+#define NFS41_DRC_MAX_MEMORY     67108864       /* Default cap for all the slots' caches */
+#define NFS41_SESSION_BUSY_QUEUE 32     /* Worker backlog above which slots are reclaimed */
 
 typedef struct nfs41_session_slot__
 {
   sequenceid4 sequence;
   pthread_mutex_t lock;
-  char cached_result[NFS41_DRC_SIZE];
+  caddr_t cached_result;        /* XDR encoded reply to the last request, allocated on demand */
+  unsigned int cached_size;
   unsigned int cache_used;
+  nfsstat4 cached_status;
 } nfs41_session_slot_t;
 
+/* Copy of a cached reply, sent again by the worker as it was encoded */
+typedef struct nfs41_session_replay__
+{
+  caddr_t buf;
+  unsigned int len;
+} nfs41_session_replay_t;
+
 typedef struct nfs41_session__
 {
   clientid4 clientid;
@@ -78,7 +90,10 @@ typedef struct nfs41_session__
   char session_id[NFS4_SESSIONID_SIZE];
   channel_attrs4 fore_channel_attrs;
   channel_attrs4 back_channel_attrs;
-  nfs41_session_slot_t slots[NFS41_NB_SLOTS];
+  unsigned int nb_slots;        /* Negotiated from ca_maxrequests at CREATE_SESSION */
+  unsigned int target_highest_slotid;   /* Adjusted according to the server's load */
+  nfs41_session_slot_t *slots;
+  unsigned int refcount;        /* Sessions table and COMPOUNDs using the slots */
 } nfs41_session_t;
 
 #endif                          /* _NFS41_SESSION_H */
@@ -53,6 +53,8 @@
 #include "sal_data.h"
 #include "cache_content.h"
 #include "nfs_stat.h"
+#include "fsal_admission.h"
+#include "nfs_fair_share.h"
 #include "external_tools.h"
 
 #include "stuff_alloc.h"
@@ -62,6 +64,7 @@
 #include "mount.h"
 #include "nfs_proto_functions.h"
 #include "nfs_dupreq.h"
+#include "nfs_req_queue.h"
 #include "err_LRU_List.h"
 #include "err_HashTable.h"
 
@@ -90,20 +93,21 @@
 /* Maximum thread count */
 #define NB_MAX_WORKER_THREAD 4096
 #define NB_MAX_FLUSHER_THREAD 100
+#define NB_MAX_DISPATCHER_THREAD 64
 
 /* NFS daemon behavior default values */
 #define NB_WORKER_THREAD_DEFAULT  16
 #define NB_FLUSHER_THREAD_DEFAULT 16
+#define NB_DISPATCHER_THREAD_DEFAULT 2
 #define NB_REQUEST_BEFORE_QUEUE_AVG  1000
-#define NB_MAX_CONCURRENT_GC 3
 #define NB_MAX_PENDING_REQUEST 30
-#define NB_PREALLOC_LRU_WORKER 100
+#define NB_PENDING_QUEUE_SIZE 1024
 #define NB_REQUEST_BEFORE_GC 50
 #define PRIME_DUPREQ 17         /* has to be a prime number */
 #define PRIME_ID_MAPPER 17      /* has to be a prime number */
 #define DUPREQ_EXPIRATION 180
 #define NB_PREALLOC_HASH_DUPREQ 100
-#define NB_PREALLOC_LRU_DUPREQ 100
+#define DUPREQ_TCP_WINDOW 128
 #define NB_PREALLOC_GC_DUPREQ 100
 #define NB_PREALLOC_ID_MAPPER 200
 
@@ -114,6 +118,10 @@
 #define PRIME_IP_NAME            17
 #define NB_PREALLOC_HASH_IP_NAME 10
 #define IP_NAME_EXPIRATION       36000
+#define IP_NAME_NEGATIVE_EXPIRATION 60
+#define IP_NAME_RESOLVER_THREADS 2
+#define IP_NAME_RESOLVE_TIMEOUT  2
+#define IP_NAME_MAX_ENTRIES      4096
 
 #define PRIME_IP_STATS            17
 #define NB_PREALLOC_HASH_IP_STATS 10
@@ -132,6 +140,7 @@
 #define CONF_LABEL_NFS_WORKER       "NFS_Worker_Param"
 #define CONF_LABEL_NFS_DUPREQ       "NFS_DupReq_Hash"
 #define CONF_LABEL_NFS_IP_NAME      "NFS_IP_Name"
+#define CONF_LABEL_NFS_FAIR_SHARE   "NFS_Fair_Share"
 #define CONF_LABEL_NFS_KRB5         "NFS_KRB5"
 #define CONF_LABEL_PNFS             "pNFS"
 #define CONF_LABEL_NFS_VERSION4     "NFSv4"
@@ -154,6 +163,9 @@
 #define	RQCRED_SIZE	     400        /* this size is excessive */
 #define NFS_DEFAULT_SEND_BUFFER_SIZE 32768
 #define NFS_DEFAULT_RECV_BUFFER_SIZE 32768
+#define NFS_MAX_TCP_RECORD_SIZE      (4 * 1024 * 1024 + 4096)  /* the largest READ/WRITE and its header */
+#define NFS_MAX_CONN_REQUESTS        128        /* requests in progress per TCP connection */
+#define NFS_MAX_CONN_PENDING         (2 * NFS_MAX_TCP_RECORD_SIZE)  /* unsent reply bytes beyond which a connection is not read */
 
 /* Default 'Raw Dev' values */
 #define GANESHA_RAW_DEV_MAJOR 168
@@ -233,10 +245,8 @@ typedef char path_str_t[MAXPATHLEN] ;
 
 typedef struct nfs_worker_param__
 {
-  LRU_parameter_t lru_param;
-  LRU_parameter_t lru_dupreq;
   unsigned int nb_pending_prealloc;
-  unsigned int nb_dupreq_prealloc;
+  unsigned int pending_queue_size;
   unsigned int nb_client_id_prealloc;
   unsigned int nb_ip_stats_prealloc;
   unsigned int nb_before_gc;
@@ -246,6 +256,7 @@ typedef struct nfs_worker_param__
 typedef struct nfs_rpc_dupreq_param__
 {
   hash_parameter_t hash_param;
+  unsigned int tcp_window;
 } nfs_rpc_dupreq_parameter_t;
 
 typedef struct nfs_cache_layer_parameter__
@@ -276,8 +287,10 @@ typedef struct nfs_core_param__
   struct sockaddr_in bind_addr; // IPv4 only for now...
   unsigned int program[P_COUNT];
   unsigned int nb_worker;
+  unsigned int nb_dispatcher;
   unsigned int nb_call_before_queue_avg;
-  unsigned int nb_max_concurrent_gc;
+  unsigned int max_conn_requests;
+  fsal_admit_parameter_t fsal_admission;
   long core_dump_size;
   int nb_max_fd;
   unsigned int drop_io_errors;
@@ -288,6 +301,7 @@ typedef struct nfs_core_param__
   unsigned int stats_update_delay;
   unsigned int long_processing_threshold;
   unsigned int dump_stats_per_client;
+  unsigned int async_logging;
   char stats_file_path[MAXPATHLEN];
   char stats_per_client_directory[MAXPATHLEN];
   char fsal_shared_library[MAXPATHLEN];
@@ -304,6 +318,10 @@ typedef struct nfs_ip_name_param__
 {
   hash_parameter_t hash_param;
   unsigned int expiration_time;
+  unsigned int negative_expiration_time;
+  unsigned int resolver_threads;
+  unsigned int resolve_timeout;
+  unsigned int max_entries;
   char mapfile[MAXPATHLEN];
 } nfs_ip_name_parameter_t;
 
@@ -347,6 +365,8 @@ typedef struct nfs_version4_parameter__
   unsigned int returns_err_fh_expired;
   unsigned int use_open_confirm;
   unsigned int return_bad_stateid;
+  unsigned int max_session_slots;
+  size_t session_drc_max_memory;
   char domainname[NFS4_MAX_DOMAIN_LEN];
   char idmapconf[MAXPATHLEN];
 } nfs_version4_parameter_t;
@@ -363,6 +383,7 @@ typedef struct nfs_param__
   nfs_idmap_cache_parameter_t gnamemap_cache_param;
   nfs_idmap_cache_parameter_t uidgidmap_cache_param;
   nfs_ip_stats_parameter_t ip_stats_param;
+  nfs_fair_share_parameter_t fair_share_param;
 #ifdef _USE_9P
   _9p_parameter_t _9p_param ;
 #endif
@@ -443,6 +464,7 @@ typedef struct nfs_request_data__
   char cred_area[2 * MAX_AUTH_BYTES + RQCRED_SIZE];
   nfs_res_t res_nfs;
   nfs_arg_t arg_nfs;
+  int conn_sock;                /* TCP connection accounting the request, or -1 */
 } nfs_request_data_t;
 
 typedef enum request_type__
@@ -454,6 +476,8 @@ typedef enum request_type__
 typedef struct request_data__
 {
   request_type_t rtype ;
+  unsigned int pool_index ; /* worker whose request_pool this entry belongs to */
+  nfs_fair_share_entry_t fair_share ; /* link in its flow while in the fair share queue */
   union request_content__
    {
       nfs_request_data_t nfs ;
@@ -498,14 +522,19 @@ typedef enum pause_state
   STATE_PAUSED,
   STATE_EXIT
 } pause_state_t;
+
+/* A thread other than the workers that walks the export list */
+typedef struct nfs_export_reader__
+{
+  volatile unsigned int export_epoch;   /* Export epoch of the walk in progress, 0 if none */
+  struct nfs_export_reader__ *next;
+} nfs_export_reader_t;
   
 typedef struct nfs_worker_data__
 {
   unsigned int worker_index;
-  LRU_list_t *pending_request;
-  LRU_list_t *duplicate_request;
+  req_queue_t pending_request;
   struct prealloc_pool request_pool;
-  struct prealloc_pool dupreq_pool;
   struct prealloc_pool ip_stats_pool;
   struct prealloc_pool clientid_pool;
   cache_inode_client_t cache_inode_client;
@@ -522,6 +551,8 @@ typedef struct nfs_worker_data__
   unsigned int passcounter;
   sockaddr_t hostaddr;
   int is_ready;
+  volatile unsigned int is_waiting;
+  volatile unsigned int export_epoch;   /* Export epoch of the request in progress, 0 if idle */
   pause_state_t pause_state;
   unsigned int gc_in_progress;
   unsigned int current_xid;
@@ -534,6 +565,10 @@ typedef struct nfs_worker_data__
   /* Description of current or most recent function processed and start time (or 0) */
   const nfs_function_desc_t *pfuncdesc;
   struct timeval timer_start;
+#ifdef _USE_NFS4_1
+  nfs41_session_replay_t drc_replay;    /* Reply of a session's slot to be sent again */
+  caddr_t drc_encode;                   /* NFS41_DRC_SIZE buffer to encode the replies to be cached */
+#endif
 } nfs_worker_data_t;
 
 /* flush thread data */
@@ -608,13 +643,19 @@ typedef enum worker_available_rc
  */
 enum auth_stat AuthenticateRequest(nfs_request_data_t *pnfsreq,
                                    bool_t *dispatch);
-worker_available_rc worker_available(unsigned long index, unsigned int avg_number_pending);
+worker_available_rc worker_available(unsigned long index);
 pause_rc pause_workers(pause_reason_t reason);
 pause_rc wake_workers(awaken_reason_t reason);
 pause_rc wait_for_workers_to_awaken();
+unsigned int select_worker_queue(void);
+void DispatchWork(request_data_t *preq, unsigned int worker_index);
 void DispatchWorkNFS(request_data_t *pnfsreq, unsigned int worker_index);
+int DispatchWorkFairShare(request_data_t *preq, sockaddr_t *paddr, int exportid);
 void *worker_thread(void *IndexArg);
 process_status_t process_rpc_request(SVCXPRT *xprt);
+int nfs_rpc_add_conn(int sock);
+bool_t nfs_rpc_conn_pending(int sock, unsigned int pending);
+void nfs_rpc_release_conn(nfs_request_data_t * preqnfs);
 void *rpc_dispatcher_thread(void *arg);
 void *admin_thread(void *arg);
 void *stats_thread(void *IndexArg);
@@ -622,11 +663,13 @@ void *long_processing_thread(void *arg);
 void *stat_exporter_thread(void *IndexArg);
 int stats_snmp(nfs_worker_data_t * workers_data_local);
 void *file_content_gc_thread(void *IndexArg);
+void *cache_inode_reaper_thread(void *arg);
 void *nfs_file_content_flush_thread(void *flush_data_arg);
 
 #ifdef _USE_9P
 void * _9p_dispatcher_thread(void *arg);
 void DispatchWork9P(request_data_t *pnfsreq, unsigned int worker_index);
+void _9p_conn_release(_9p_conn_t * pconn);
 void _9p_process_request( _9p_request_data_t * preq9p, nfs_worker_data_t * pworker_data ) ;
 #endif
 
@@ -638,7 +681,6 @@ void nfs_Init_svc(void);
 void nfs_Init_admin_data(hash_table_t *ht);
 int nfs_Init_worker_data(nfs_worker_data_t * pdata);
 int nfs_Init_request_data(nfs_request_data_t * pdata);
-int nfs_Init_gc_counter(void);
 void constructor_nfs_request_data_t(void *ptr);
 void constructor_request_data_t(void *ptr);
 
@@ -649,6 +691,7 @@ int nfs_read_worker_conf(config_file_t in_config, nfs_worker_parameter_t * ppara
 int nfs_read_dupreq_hash_conf(config_file_t in_config,
                               nfs_rpc_dupreq_parameter_t * pparam);
 int nfs_read_ip_name_conf(config_file_t in_config, nfs_ip_name_parameter_t * pparam);
+int nfs_read_fair_share_conf(config_file_t in_config, nfs_fair_share_parameter_t * pparam);
 int nfs_read_version4_conf(config_file_t in_config, nfs_version4_parameter_t * pparam);
 int nfs_read_client_id_conf(config_file_t in_config, nfs_client_id_parameter_t * pparam);
 #ifdef _HAVE_GSSAPI
@@ -671,6 +714,8 @@ int nfs_export_create_root_entry(exportlist_t * pexportlist, hash_table_t * ht);
  * another service that has a client array (like snmp or statistics exporter) */
 int nfs_AddClientsToClientArray(exportlist_client_t *clients, int new_clients_number,
     char **new_clients_name, int option);
+int nfs_CompileClientArray(exportlist_client_t *clients);
+void nfs_FreeCompiledClientArray(exportlist_client_t *clients);
 
 int parseAccessParam(char *var_name, char *var_value,
                      exportlist_t *p_entry, int access_option);
@@ -688,6 +733,12 @@ int export_client_matchv6(struct in6_addr *paddrv6,
 
 /* Config reparsing routines */
 void admin_replace_exports();
+void nfs_export_epoch_enter(nfs_worker_data_t * pworker);
+void nfs_export_epoch_exit(nfs_worker_data_t * pworker);
+void nfs_export_reader_register(nfs_export_reader_t * preader);
+void nfs_export_reader_unregister(nfs_export_reader_t * preader);
+void nfs_export_reader_enter(nfs_export_reader_t * preader);
+void nfs_export_reader_exit(nfs_export_reader_t * preader);
 int CleanUpExportContext(fsal_export_context_t * p_export_context);
 exportlist_t *RemoveExportEntry(exportlist_t * exportEntry);
 
@@ -698,16 +749,6 @@ void Print_param_in_log();
 
 void nfs_reset_stats(void);
 
-int display_req_key(hash_buffer_t * pbuff, char *str);
-int display_req_val(hash_buffer_t * pbuff, char *str);
-int compare_req(hash_buffer_t * buff1, hash_buffer_t * buff2);
-
-int print_entry_dupreq(LRU_data_t data, char *str);
-int clean_entry_dupreq(LRU_entry_t * pentry, void *addparam);
-
-int clean_pending_request(LRU_entry_t * pentry, void *addparam);
-int print_pending_request(LRU_data_t data, char *str);
-
 void auth_stat2str(enum auth_stat, char *str);
 
 int nfs_Init_client_id(nfs_client_id_parameter_t param);
@@ -844,6 +885,18 @@ int nfs41_Session_Update(char sessionid[NFS4_SESSIONID_SIZE],
                          nfs41_session_t * psession_data);
 int nfs41_Session_Del(char sessionid[NFS4_SESSIONID_SIZE]);
 int nfs41_Build_sessionid(clientid4 * pclientid, char sessionid[NFS4_SESSIONID_SIZE]);
+int nfs41_Session_Alloc_Slots(nfs41_session_t * psession, unsigned int nb_slots);
+void nfs41_Session_Free_Slots(nfs41_session_t * psession);
+unsigned int nfs41_Session_Target_Slotid(nfs41_session_t * psession,
+                                         unsigned int highest_used_slotid,
+                                         unsigned int queue_length);
+void nfs41_Session_Slot_Drop(nfs41_session_slot_t * pslot);
+void nfs41_Session_Release(nfs41_session_t * psession);
+void nfs41_Session_Slot_Store(nfs41_session_slot_t * pslot, COMPOUND4res * pres,
+                              caddr_t * pencode);
+int nfs41_Session_Slot_Replay(nfs41_session_slot_t * pslot, COMPOUND4res * pres,
+                              nfs41_session_replay_t * preplay);
+bool_t nfs41_Session_Replay_Send(SVCXPRT * xprt, nfs41_session_replay_t * preplay);
 void nfs41_Session_PrintAll(void);
 #endif
 
@@ -854,6 +907,7 @@ int nfs_Init_dupreq(nfs_rpc_dupreq_parameter_t param);
 extern const nfs_function_desc_t *INVALID_FUNCDESC;
 const nfs_function_desc_t *nfs_rpc_get_funcdesc(nfs_request_data_t * preqnfs);
 int nfs_rpc_get_args(nfs_request_data_t * preqnfs, const nfs_function_desc_t *pfuncdesc);
+int nfs_rpc_register_stats(void);
 
 void create_fsal_up_threads();
 void nfs_Init_FSAL_UP();
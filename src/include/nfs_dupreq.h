@@ -53,6 +53,13 @@ typedef unsigned long u_long;
 #include "fsal.h"
 #include "nfs_tools.h"
 
+/* Largest reply kept in the cache, the replies of the non-idempotent NFSv2 and
+ * NFSv3 procedures (wcc_data, post_op_fh3...) are a few hundred bytes */
+#define DUPREQ_REPLY_SIZE          512
+
+/* Hash chains of a partition of the cache, a power of two */
+#define DUPREQ_PARTITION_BUCKETS   256
+
 typedef struct dupreq_key__
 {
   /* Each NFS request is identified by the client by an xid.
@@ -72,47 +79,64 @@ typedef struct dupreq_key__
   int checksum;
 } dupreq_key_t;
 
-typedef struct dupreq_entry__
+/* A reply as it was encoded on the wire, results only (no RPC header) */
+typedef struct dupreq_reply__
 {
-  long xid;
-  sockaddr_t addr;
-  int checksum;
+  unsigned int len;
+  char buf[DUPREQ_REPLY_SIZE];
+} dupreq_reply_t;
 
-  pthread_mutex_t dupreq_mutex;
+struct dupreq_window__;
+
+typedef struct dupreq_entry__
+{
+  dupreq_key_t key;
   int processing; /* if currently being processed, this should be = 1 */
 
-  nfs_res_t res_nfs;
   u_long rq_prog;               /* service program number        */
   u_long rq_vers;               /* service protocol version      */
   u_long rq_proc;
   time_t timestamp;
+
+  unsigned int bucket;                    /* hash chain in the partition */
+  struct dupreq_entry__ *hash_next;
+  struct dupreq_entry__ *lru_prev;        /* finished entries of the partition, oldest first */
+  struct dupreq_entry__ *lru_next;
+  struct dupreq_window__ *pwindow;        /* TCP connection the entry belongs to, or NULL */
+  struct dupreq_entry__ *win_prev;        /* finished entries of the connection, oldest first */
+  struct dupreq_entry__ *win_next;
+
+  dupreq_reply_t reply;
 } dupreq_entry_t;
 
-unsigned int get_rpc_xid(struct svc_req *reqp);
+/* The replies cached for a TCP connection. A client only retransmits on a
+ * connection after a reconnection, from the same address and port, so the
+ * window only has to cover the requests that were in flight at that time */
+typedef struct dupreq_window__
+{
+  sockaddr_t addr;
+  unsigned int nb_entries;
+  dupreq_entry_t *head;
+  dupreq_entry_t *tail;
+  struct dupreq_window__ *hash_next;
+} dupreq_window_t;
 
-int compare_req(hash_buffer_t * buff1, hash_buffer_t * buff2);
-int print_entry_dupreq(LRU_data_t data, char *str);
-int clean_entry_dupreq(LRU_entry_t * pentry, void *addparam);
-int nfs_dupreq_gc_function(LRU_entry_t * pentry, void *addparam);
+unsigned int get_rpc_xid(struct svc_req *reqp);
 
-nfs_res_t nfs_dupreq_get(long xid, struct svc_req *ptr_req, SVCXPRT *xprt, int *pstatus);
-int nfs_dupreq_delete(long xid, struct svc_req *ptr_req, SVCXPRT *xprt,
-                      struct prealloc_pool *dupreq_pool);
+int nfs_dupreq_delete(long xid, struct svc_req *ptr_req, SVCXPRT *xprt);
 int nfs_dupreq_add_not_finished(long xid,
 				struct svc_req *ptr_req,
 				SVCXPRT *xprt,
-				struct prealloc_pool *dupreq_pool,
-				nfs_res_t *res_nfs);
+				dupreq_reply_t *preply);
 
 int nfs_dupreq_finish(long xid,
 		      struct svc_req *ptr_req,
 		      SVCXPRT *xprt,
-		      nfs_res_t * p_res_nfs,
-		      LRU_list_t * lru_dupreq);
+		      xdrproc_t xdr_encode_func,
+		      caddr_t pres);
 
-unsigned long dupreq_value_hash_func(hash_parameter_t * p_hparam,
-                                     hash_buffer_t * buffclef);
-unsigned long dupreq_rbt_hash_func(hash_parameter_t * p_hparam, hash_buffer_t * buffclef);
+bool_t xdr_dupreq_reply(XDR * xdrs, dupreq_reply_t * preply);
+void nfs_dupreq_gc(void);
 void nfs_dupreq_get_stats(hash_stat_t * phstat);
 
 #define DUPREQ_SUCCESS             0
@@ -120,5 +144,6 @@ void nfs_dupreq_get_stats(hash_stat_t * phstat);
 #define DUPREQ_NOT_FOUND           2
 #define DUPREQ_BEING_PROCESSED     3
 #define DUPREQ_ALREADY_EXISTS      4
+#define DUPREQ_REPLY_TOO_BIG       5
 
 #endif                          /* _NFS_DUPREQ_H */
@@ -139,10 +139,14 @@ typedef struct exportlist_client_entry__
 
 #define EXPORTS_NB_MAX_CLIENTS 128
 
+/* Compiled form of a client array, see nfs_CompileClientArray */
+typedef struct exportlist_client_matcher__ exportlist_client_matcher_t;
+
 typedef struct exportlist_client__
 {
   unsigned int num_clients;     /* num clients        */
   exportlist_client_entry_t clientarray[EXPORTS_NB_MAX_CLIENTS];        /* allowed clients    */
+  exportlist_client_matcher_t *matcher; /* NULL if not compiled */
 } exportlist_client_t;
 
 /* fsal up filter list is needed in exportlist.
@@ -195,8 +199,11 @@ typedef struct exportlist__
   fsal_off_t MaxOffsetRead;     /* Maximum Offset allowed for read                   */
   fsal_off_t MaxCacheSize;      /* Maximum Cache Size allowed                        */
   unsigned int UseCookieVerifier;       /* Is Cookie verifier to be used ?                   */
+  unsigned int share_weight;    /* Weight in the fair share of the workers           */
+  unsigned int share_max_rate;  /* Cap on the requests per second, 0 for none        */
   exportlist_client_t clients;  /* allowed clients                                   */
   struct exportlist__ *next;    /* next entry                                        */
+  unsigned int refcount;        /* Holders beyond a request (9P fids, read-ahead)    */
   unsigned int fsalid ;
 
 #ifdef _USE_FSAL_UP
@@ -344,15 +351,42 @@ typedef struct compoud_data
   cache_inode_client_t *pclient;                      /**< client ressource for the request                              */
   nfs_client_cred_t credential;                       /**< RPC Request related to the compound                           */
 #ifdef _USE_NFS4_1
-  caddr_t pcached_res;                                /**< NFv41: pointer to cached RPC res in a session's slot          */
+  nfs41_session_slot_t *pcached_slot;                 /**< NFv41: session's slot whose reply cache is to be used         */
   bool_t use_drc;                                     /**< Set to TRUE if session DRC is to be used                      */
   uint32_t oppos;                                     /**< Position of the operation within the request processed        */
   nfs41_session_t *psession;                          /**< Related session (found by OP_SEQUENCE)                        */
 #endif                          /* USE_NFS4_1 */
 } compound_data_t;
 
+/* Index of the export list, rebuilt as a whole and published when the list changes */
+#define EXPORT_INDEX_NB_ID     65536    /* export ids are unsigned short */
+
+typedef struct export_index_slot__
+{
+  unsigned long hash;
+  unsigned int len;
+  unsigned int rank;            /* position of the entry in the list */
+  exportlist_t *pexport;        /* first entry of the list with this key, NULL if the slot is free */
+} export_index_slot_t;
+
+typedef struct export_index__
+{
+  exportlist_t *exportroot;     /* the list this index was built from */
+  exportlist_t *by_id[EXPORT_INDEX_NB_ID];
+  unsigned int path_mask;
+  export_index_slot_t *by_path; /* keyed by fullpath, without trailing '/' */
+  unsigned int tag_mask;
+  export_index_slot_t *by_tag;  /* keyed by FS_tag */
+} export_index_t;
+
 /* Export list related functions */
 exportlist_t *nfs_Get_export_by_id(exportlist_t * exportroot, unsigned short exportid);
+exportlist_t *nfs_Get_export_by_path(exportlist_t * exportroot, char *path);
+exportlist_t *nfs_Get_export_by_tag(exportlist_t * exportroot, char *tag);
+int nfs_export_index_publish(exportlist_t * exportroot, export_index_t ** ppold);
+void nfs_export_index_free(export_index_t * pindex);
+void nfs_export_get(exportlist_t * pexport);
+void nfs_export_put(exportlist_t * pexport);
 int nfs_check_anon(exportlist_client_entry_t * pexport_client,
                     exportlist_t * pexport,
                     struct user_cred *user_credentials);
@@ -0,0 +1,99 @@
+/*
+ * vim:expandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * ---------------------------------------
+ */
+
+/**
+ * \file    nfs_fair_share.h
+ * \brief   Fair share of the workers between the clients and the exports.
+ *
+ * nfs_fair_share.h : The requests are queued by flow, a flow being the
+ * requests of one client (its address, whatever the port) to one export.
+ * The workers take them from the flows in Deficit Round Robin: each turn a
+ * flow may have as many requests served as the weight of its client times
+ * the weight of its export. A client or an export may also have a rate cap,
+ * in requests per second, beyond which its requests are held in the queue.
+ *
+ */
+
+#ifndef _NFS_FAIR_SHARE_H
+#define _NFS_FAIR_SHARE_H
+
+#include <stdint.h>
+#include "rpc.h"
+
+/* Errors */
+#define NFS_FAIR_SHARE_SUCCESS         0
+#define NFS_FAIR_SHARE_MALLOC_ERROR    1
+#define NFS_FAIR_SHARE_DISABLED        2
+
+/* Defaults */
+#define NFS_FAIR_SHARE_WEIGHT          1
+#define NFS_FAIR_SHARE_MAX_RATE        0        /* requests per second, 0 for no cap */
+#define NFS_FAIR_SHARE_MAX_WEIGHT      1000
+#define NFS_FAIR_SHARE_MAX_CLIENTS     64       /* clients with their own weight or cap */
+#define NFS_FAIR_SHARE_IDLE_CLIENTS    1024     /* clients without requests whose bucket is kept */
+#define NFS_FAIR_SHARE_TICK            10       /* ms between two looks at requests held by a cap */
+
+typedef struct nfs_fair_share_client_param__
+{
+  sockaddr_t addr;
+  unsigned int weight;
+  unsigned int max_rate;
+} nfs_fair_share_client_param_t;
+
+typedef struct nfs_fair_share_parameter__
+{
+  unsigned int enabled;
+  unsigned int default_weight;
+  unsigned int default_max_rate;
+  unsigned int nb_clients;
+  nfs_fair_share_client_param_t clients[NFS_FAIR_SHARE_MAX_CLIENTS];
+} nfs_fair_share_parameter_t;
+
+typedef struct nfs_fair_share_stats__
+{
+  unsigned int nb_queued;
+  unsigned int nb_flows;
+  unsigned int nb_clients;
+  unsigned int nb_idle_clients; /* clients without flows, their buckets are kept */
+  uint64_t nb_enqueued;
+  uint64_t nb_dequeued;
+  uint64_t nb_throttled;        /* times a flow was skipped because of a rate cap */
+} nfs_fair_share_stats_t;
+
+/* Link of a request in its flow, kept within the request */
+typedef struct nfs_fair_share_entry__
+{
+  struct nfs_fair_share_entry__ *next;
+  void *data;
+  uint64_t enqueued;
+} nfs_fair_share_entry_t;
+
+int nfs_fair_share_init(nfs_fair_share_parameter_t * pparam);
+int nfs_fair_share_set_export(unsigned short exportid, unsigned int weight,
+                              unsigned int max_rate);
+
+int nfs_fair_share_enqueue(nfs_fair_share_entry_t * pentry, sockaddr_t * paddr,
+                           int exportid, void *data);
+void *nfs_fair_share_dequeue(void);
+unsigned int nfs_fair_share_length(void);
+
+void nfs_fair_share_get_stats(nfs_fair_share_stats_t * pstats);
+
+#endif                          /* _NFS_FAIR_SHARE_H */
@@ -25,13 +25,26 @@
 
 #define IP_NAME_PREALLOC_SIZE      200
 
+/* Number of distinct addresses that can wait for the resolver threads */
+#define IP_NAME_PENDING_SIZE       64
+
+/* IP/name cache entry status */
+#define IP_NAME_ENTRY_POSITIVE     0
+#define IP_NAME_ENTRY_NEGATIVE     1
+#define IP_NAME_ENTRY_STATIC       2
+
 /* NFS IPaddr cache entry structure */
 typedef struct nfs_ip_name__
 {
   time_t timestamp;
+  unsigned int status;
+  unsigned int refreshing;
   char hostname[MAXHOSTNAMELEN];
 } nfs_ip_name_t;
 
+/* Reverse lookup function used by the IP/name cache, returns 0 or a EAI_* code */
+typedef int (*nfs_ip_name_resolver_t) (sockaddr_t * ipaddr, char *hostname, size_t len);
+
 typedef struct nfs_ip_stats__
 {
   unsigned int nb_call;
@@ -49,6 +62,8 @@ typedef struct nfs_ip_stats__
 int nfs_ip_name_get(sockaddr_t *ipaddr, char *hostname);
 int nfs_ip_name_add(sockaddr_t *ipaddr, char *hostname);
 int nfs_ip_name_remove(sockaddr_t *ipaddr);
+int nfs_ip_name_resolve(sockaddr_t *ipaddr, char *hostname);
+void nfs_ip_name_set_resolver(nfs_ip_name_resolver_t resolver);
 
 int nfs_ip_stats_add(hash_table_t * ht_ip_stats,
                      sockaddr_t * ipaddr, struct prealloc_pool *ip_stats_pool);
@@ -625,6 +625,8 @@ int nfs4_Compound(nfs_arg_t * parg /* IN  */ ,
                   struct svc_req *preq /* IN  */ ,
                   nfs_res_t * pres /* OUT */ );
 
+void nfs4_Compound_register_stats(void);
+
 typedef int (*nfs4_op_function_t) (struct nfs_argop4 *, compound_data_t *,
                                    struct nfs_resop4 *);
 
@@ -1522,6 +1524,7 @@ int nfs4_FSALattr_To_Fattr(exportlist_t * pexport,
 
 void nfs4_list_to_bitmap4(bitmap4 * b, uint_t * plen, uint32_t * pval);
 void nfs4_bitmap4_to_list(bitmap4 * b, uint_t * plen, uint32_t * pval);
+void nfs4_Fattr_Plans_Enable(int enable);
 
 int nfs4_bitmap4_Remove_Unsupported(bitmap4 * pbitmap) ;
 
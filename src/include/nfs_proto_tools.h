@@ -135,4 +135,10 @@ void nfs3_access_debug(char *label, uint32_t access);
 
 void nfs4_access_debug(char *label, uint32_t access, fsal_aceperm_t v4mask);
 
+caddr_t nfs_read_buffer_get(size_t size);
+
+void nfs_read_buffer_put(caddr_t data);
+
+void nfs3_GetWriteVerifier(char *verf);
+
 #endif                          /* _NFS_PROTO_TOOLS_H */
@@ -0,0 +1,65 @@
+/*
+ * vim:expandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * ---------------------------------------
+ */
+
+/**
+ * \file    nfs_req_queue.h
+ * \brief   Bounded lock-free queue carrying requests from dispatchers to workers.
+ *
+ * nfs_req_queue.h : A fixed size ring of pointers that can be pushed and
+ * popped concurrently by any number of threads without locking. Every cell
+ * carries a sequence number telling whether it is ready to be written or
+ * read for the current lap of the ring.
+ *
+ */
+
+#ifndef _NFS_REQ_QUEUE_H
+#define _NFS_REQ_QUEUE_H
+
+/* Request queue errors */
+#define REQ_QUEUE_SUCCESS          0
+#define REQ_QUEUE_FULL             1
+#define REQ_QUEUE_MALLOC_ERROR     2
+
+/* Keeps the producer and the consumer positions on different cache lines */
+#define REQ_QUEUE_CACHE_LINE_SIZE  64
+
+typedef struct req_queue_cell__
+{
+  volatile unsigned long sequence;
+  void *data;
+} req_queue_cell_t;
+
+typedef struct req_queue__
+{
+  req_queue_cell_t *cells;
+  unsigned long mask;
+  char pad0[REQ_QUEUE_CACHE_LINE_SIZE];
+  volatile unsigned long enqueue_pos;
+  char pad1[REQ_QUEUE_CACHE_LINE_SIZE];
+  volatile unsigned long dequeue_pos;
+  char pad2[REQ_QUEUE_CACHE_LINE_SIZE];
+} req_queue_t;
+
+int req_queue_init(req_queue_t * pqueue, unsigned int size);
+int req_queue_push(req_queue_t * pqueue, void *data);
+void *req_queue_pop(req_queue_t * pqueue);
+unsigned int req_queue_length(req_queue_t * pqueue);
+
+#endif                          /* _NFS_REQ_QUEUE_H */
@@ -141,7 +141,8 @@ typedef enum
   PER_SERVER_DETAIL,
   PER_CLIENT,
   PER_SHARE,
-  PER_CLIENTSHARE
+  PER_CLIENTSHARE,
+  SNAPSHOT
 } nfs_stat_client_req_type_t;
 
 typedef struct
@@ -0,0 +1,116 @@
+/*
+ * vim:expandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * ---------------------------------------
+ */
+
+/**
+ * \file    nfs_stat_registry.h
+ * \brief   Per-thread statistics counters and latency histograms.
+ *
+ * nfs_stat_registry.h : Counters and histograms are registered by name once,
+ * then every thread updates its own copy of them without any lock or atomic
+ * operation. A snapshot sums the copies of all the threads. Each histogram
+ * is protected by a sequence counter written by its owner thread only, so a
+ * snapshot never sees a histogram in the middle of an update.
+ *
+ * Histograms are log-linear: values below 2^NFS_STAT_HISTO_SUB_BITS have
+ * their own bucket, above that every power of two is split into
+ * 2^NFS_STAT_HISTO_SUB_BITS buckets, which bounds the error at 12.5%.
+ *
+ */
+
+#ifndef _NFS_STAT_REGISTRY_H
+#define _NFS_STAT_REGISTRY_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <sys/time.h>
+#include <time.h>
+
+/* Registry errors */
+#define NFS_STAT_SUCCESS           0
+#define NFS_STAT_FULL              1
+#define NFS_STAT_MALLOC_ERROR      2
+
+#define NFS_STAT_MAX_COUNTERS      256
+#define NFS_STAT_MAX_HISTOGRAMS    512
+#define NFS_STAT_NAME_LEN          48
+
+/* 8 buckets per power of two, values up to 2^36 ns (68 seconds) */
+#define NFS_STAT_HISTO_SUB_BITS    3
+#define NFS_STAT_HISTO_SUB_COUNT   (1 << NFS_STAT_HISTO_SUB_BITS)
+#define NFS_STAT_HISTO_MAX_BITS    36
+#define NFS_STAT_HISTO_BUCKETS     ((NFS_STAT_HISTO_MAX_BITS - NFS_STAT_HISTO_SUB_BITS + 1) * \
+                                    NFS_STAT_HISTO_SUB_COUNT)
+
+typedef struct nfs_stat_histogram__
+{
+  volatile unsigned int sequence;       /* odd while the owner thread updates it */
+  uint64_t count;
+  uint64_t sum;
+  uint64_t max;
+  uint64_t buckets[NFS_STAT_HISTO_BUCKETS];
+} nfs_stat_histogram_t;
+
+typedef struct nfs_stat_snapshot__
+{
+  struct timeval date;
+  unsigned int nb_threads;
+  unsigned int nb_counters;
+  unsigned int nb_histograms;
+  char (*counter_names)[NFS_STAT_NAME_LEN];
+  char (*histogram_names)[NFS_STAT_NAME_LEN];
+  uint64_t *counters;
+  nfs_stat_histogram_t *histograms;
+} nfs_stat_snapshot_t;
+
+/**
+ *
+ * nfs_stat_now: reads the clock used to measure latencies.
+ *
+ * CLOCK_MONOTONIC is served by the vDSO, without a system call, and is not
+ * affected by changes of the date. The coarse clocks tick every few
+ * milliseconds, which is longer than most requests.
+ *
+ * @return the time in nanoseconds, from an arbitrary origin.
+ *
+ */
+static inline uint64_t nfs_stat_now(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}                               /* nfs_stat_now */
+
+int nfs_stat_register_counter(const char *name);
+int nfs_stat_register_histogram(const char *name);
+int nfs_stat_lookup_histogram(const char *name);
+
+void nfs_stat_counter_add(int id, uint64_t value);
+void nfs_stat_histogram_record(int id, uint64_t value);
+
+unsigned int nfs_stat_histogram_bucket(uint64_t value);
+uint64_t nfs_stat_histogram_bucket_max(unsigned int bucket);
+uint64_t nfs_stat_histogram_percentile(nfs_stat_histogram_t * phisto, double percent);
+
+nfs_stat_snapshot_t *nfs_stat_snapshot_take(void);
+void nfs_stat_snapshot_free(nfs_stat_snapshot_t * psnap);
+int nfs_stat_snapshot_print_json(FILE * stream, nfs_stat_snapshot_t * psnap);
+
+#endif                          /* _NFS_STAT_REGISTRY_H */
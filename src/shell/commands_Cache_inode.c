@@ -1578,10 +1578,7 @@ int fn_Cache_inode_callstat(int argc,   /* IN : number of args in argv */
   fprintf(output,
           "------------------------------------------------------------------------------\n");
   fprintf(output,
-          "Client LRU_GC: nb_entry=%d, nb_invalid=%d, nb_call_gc=%d, param.nb_call_gc_invalid=%d\n",
-          context->client.lru_gc->nb_entry, context->client.lru_gc->nb_invalid,
-          context->client.lru_gc->nb_call_gc,
-          context->client.lru_gc->parameter.nb_call_gc_invalid);
+          "Global LRU_GC: nb_entry=%u\n", cache_inode_lru_count());
   fprintf(output,
           "------------------------------------------------------------------------------\n");
 
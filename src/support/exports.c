@@ -119,6 +119,8 @@ cache_content_client_t recover_datacache_client;
 #define CONF_EXPORT_USE_COMMIT                  "Use_NFS_Commit"
 #define CONF_EXPORT_USE_GANESHA_WRITE_BUFFER    "Use_Ganesha_Write_Buffer"
 #define CONF_EXPORT_USE_FSAL_UP        "Use_FSAL_UP"
+#define CONF_EXPORT_SHARE_WEIGHT       "Share_Weight"
+#define CONF_EXPORT_SHARE_MAX_RATE     "Share_Max_Rate"
 #define CONF_EXPORT_FSAL_UP_FILTERS    "FSAL_UP_Filters"
 #define CONF_EXPORT_FSAL_UP_TIMEOUT    "FSAL_UP_Timeout"
 #define CONF_EXPORT_FSAL_UP_TYPE       "FSAL_UP_Type"
@@ -581,6 +583,9 @@ int nfs_AddClientsToClientArray(exportlist_client_t *clients,
    */
   (*clients).num_clients += new_clients_number;
 
+  /* Rebuild the compiled form of the array, used by export_client_match */
+  nfs_CompileClientArray(clients);
+
   return 0;                     /* success !! */
 }                               /* nfs_AddClientsToClientArray */
 
@@ -739,6 +744,8 @@ static int BuildExportEntry(config_item_t block, exportlist_t ** pp_export)
   p_entry->anonymous_uid = (uid_t) ANON_UID;
   p_entry->anonymous_gid = (gid_t) ANON_GID;
   p_entry->use_commit = TRUE;
+  p_entry->share_weight = NFS_FAIR_SHARE_WEIGHT;
+  p_entry->share_max_rate = NFS_FAIR_SHARE_MAX_RATE;
 
   /* Defaults for FSAL_UP. It is ok to leave the filter list NULL
    * even if we enable the FSAL_UP. */
@@ -1962,6 +1969,46 @@ static int BuildExportEntry(config_item_t block, exportlist_t ** pp_export)
               }
             }
         }
+      else if(!STRCMP(var_name, CONF_EXPORT_SHARE_WEIGHT))
+        {
+          long int weight;
+          char *end_ptr;
+
+          errno = 0;
+          weight = strtol(var_value, &end_ptr, 10);
+
+          if(end_ptr == NULL || *end_ptr != '\0' || errno != 0 ||
+             weight < 1 || weight > NFS_FAIR_SHARE_MAX_WEIGHT)
+            {
+              LogCrit(COMPONENT_CONFIG,
+                      "NFS READ_EXPORT: ERROR: Invalid %s: \"%s\", expected 1 to %d",
+                      var_name, var_value, NFS_FAIR_SHARE_MAX_WEIGHT);
+              err_flag = TRUE;
+              continue;
+            }
+
+          p_entry->share_weight = (unsigned int) weight;
+        }
+      else if(!STRCMP(var_name, CONF_EXPORT_SHARE_MAX_RATE))
+        {
+          long int rate;
+          char *end_ptr;
+
+          errno = 0;
+          rate = strtol(var_value, &end_ptr, 10);
+
+          if(end_ptr == NULL || *end_ptr != '\0' || errno != 0 ||
+             rate < 0 || rate > 1000000)
+            {
+              LogCrit(COMPONENT_CONFIG,
+                      "NFS READ_EXPORT: ERROR: Invalid %s: \"%s\", expected 0 to 1000000",
+                      var_name, var_value);
+              err_flag = TRUE;
+              continue;
+            }
+
+          p_entry->share_max_rate = (unsigned int) rate;
+        }
       else if(!STRCMP(var_name, CONF_EXPORT_USE_GANESHA_WRITE_BUFFER))
         {
           switch (StrToBoolean(var_value))
@@ -2156,9 +2203,11 @@ exportlist_t *BuildDefaultExport()
   /** @todo set default values here */
 
   p_entry->next = NULL;
+  p_entry->refcount = 0;
   p_entry->options = 0;
   p_entry->status = EXPORTLIST_OK;
   p_entry->clients.num_clients = 0;
+  p_entry->clients.matcher = NULL;
   p_entry->access_type = ACCESSTYPE_RW;
   p_entry->anonymous_uid = (uid_t) ANON_UID;
   p_entry->MaxOffsetWrite = (fsal_off_t) 0;
@@ -2198,6 +2247,8 @@ exportlist_t *BuildDefaultExport()
   strcpy(p_entry->referral, "");
 
   p_entry->UseCookieVerifier = FALSE;
+  p_entry->share_weight = NFS_FAIR_SHARE_WEIGHT;
+  p_entry->share_max_rate = NFS_FAIR_SHARE_MAX_RATE;
 
   /**
    * Grant root access to all clients
@@ -2306,6 +2357,456 @@ int ReadExports(config_file_t in_config,        /* The file that contains the ex
     return nb_entries;
 }
 
+/* Compiled client arrays: the HOSTIF and NETWORK entries are put in a binary
+ * trie per address family, the entries that need a name resolution keep their
+ * verdict in a cache keyed by client address */
+#define EXPORT_CLIENT_NO_ENTRY        EXPORTS_NB_MAX_CLIENTS
+#define EXPORT_CLIENT_CACHE_SIZE      4093
+#define EXPORT_CLIENT_CACHE_NB_LOCKS  61
+#define EXPORT_CLIENT_BITMAP_LEN      ((EXPORTS_NB_MAX_CLIENTS + 31) / 32)
+
+#define EXPORT_CLIENT_V4 0
+#define EXPORT_CLIENT_V6 1
+
+typedef struct export_client_node__
+{
+  unsigned int child[2];        /* index of the children, 0 if none (0 is the root) */
+  unsigned int first_entry;     /* entries for this prefix, in array order */
+} export_client_node_t;
+
+struct exportlist_client_matcher__
+{
+  unsigned int id;              /* key of this array in the decision cache */
+  unsigned int nb_nodes[2];
+  unsigned int size_nodes[2];
+  export_client_node_t *nodes[2];
+  unsigned int next_entry[EXPORTS_NB_MAX_CLIENTS];
+  unsigned int nb_others[2];    /* entries not in the tries, in array order */
+  unsigned int others[2][EXPORTS_NB_MAX_CLIENTS];
+};
+
+typedef struct export_client_verdict__
+{
+  unsigned int id;
+  in_addr_t addr;
+  time_t expire;                /* end of validity of the matching verdicts */
+  time_t negative_expire;       /* end of validity of the other verdicts */
+  uint32_t evaluated[EXPORT_CLIENT_BITMAP_LEN];
+  uint32_t matched[EXPORT_CLIENT_BITMAP_LEN];
+} export_client_verdict_t;
+
+static unsigned int export_client_matcher_id = 0;
+static export_client_verdict_t export_client_cache[EXPORT_CLIENT_CACHE_SIZE];
+static pthread_mutex_t export_client_cache_lock[EXPORT_CLIENT_CACHE_NB_LOCKS];
+static pthread_once_t export_client_cache_once = PTHREAD_ONCE_INIT;
+
+static void export_client_cache_init(void)
+{
+  unsigned int i;
+
+  for(i = 0; i < EXPORT_CLIENT_CACHE_NB_LOCKS; i++)
+    pthread_mutex_init(&export_client_cache_lock[i], NULL);
+}                               /* export_client_cache_init */
+
+/**
+ *
+ * export_client_trie_insert: adds a client entry for an address prefix.
+ *
+ * @param pmatcher [INOUT] the compiled array
+ * @param family   [IN]    EXPORT_CLIENT_V4 or EXPORT_CLIENT_V6
+ * @param key      [IN]    the address, in network order
+ * @param len      [IN]    the length of the prefix, in bits
+ * @param entry    [IN]    index of the entry in the client array
+ *
+ * @return 0 if ok, ENOMEM otherwise.
+ *
+ */
+static int export_client_trie_insert(exportlist_client_matcher_t * pmatcher,
+                                     int family,
+                                     unsigned char *key,
+                                     unsigned int len, unsigned int entry)
+{
+  export_client_node_t *nodes = pmatcher->nodes[family];
+  unsigned int node = 0;
+  unsigned int depth;
+  unsigned int bit;
+  unsigned int *plast;
+
+  for(depth = 0; depth < len; depth++)
+    {
+      bit = (key[depth / 8] >> (7 - depth % 8)) & 1;
+      if(nodes[node].child[bit] == 0)
+        {
+          if(pmatcher->nb_nodes[family] == pmatcher->size_nodes[family])
+            {
+              nodes = (export_client_node_t *) Mem_Realloc(nodes,
+                                                           2 * pmatcher->size_nodes[family] *
+                                                           sizeof(export_client_node_t));
+              if(nodes == NULL)
+                return ENOMEM;
+              pmatcher->nodes[family] = nodes;
+              pmatcher->size_nodes[family] *= 2;
+            }
+          nodes[pmatcher->nb_nodes[family]].child[0] = 0;
+          nodes[pmatcher->nb_nodes[family]].child[1] = 0;
+          nodes[pmatcher->nb_nodes[family]].first_entry = EXPORT_CLIENT_NO_ENTRY;
+          nodes[node].child[bit] = pmatcher->nb_nodes[family]++;
+        }
+      node = nodes[node].child[bit];
+    }
+
+  /* Entries are compiled in array order, keep them so */
+  for(plast = &nodes[node].first_entry; *plast != EXPORT_CLIENT_NO_ENTRY;
+      plast = &pmatcher->next_entry[*plast]) ;
+  *plast = entry;
+  pmatcher->next_entry[entry] = EXPORT_CLIENT_NO_ENTRY;
+
+  return 0;
+}                               /* export_client_trie_insert */
+
+/**
+ *
+ * export_client_trie_match: looks for the first entry matching an address.
+ *
+ * @param pmatcher      [IN] the compiled array
+ * @param clients       [IN] the client array
+ * @param family        [IN] EXPORT_CLIENT_V4 or EXPORT_CLIENT_V6
+ * @param key           [IN] the address, in network order
+ * @param len           [IN] the length of the address, in bits
+ * @param export_option [IN] the options looked for
+ *
+ * @return the index of the entry, EXPORT_CLIENT_NO_ENTRY if none matches.
+ *
+ */
+static unsigned int export_client_trie_match(exportlist_client_matcher_t * pmatcher,
+                                             exportlist_client_t * clients,
+                                             int family,
+                                             unsigned char *key,
+                                             unsigned int len,
+                                             unsigned int export_option)
+{
+  export_client_node_t *nodes = pmatcher->nodes[family];
+  unsigned int best = EXPORT_CLIENT_NO_ENTRY;
+  unsigned int node = 0;
+  unsigned int depth = 0;
+  unsigned int entry;
+
+  while(1)
+    {
+      for(entry = nodes[node].first_entry; entry < best; entry = pmatcher->next_entry[entry])
+        if((clients->clientarray[entry].options & export_option) != 0 &&
+           (clients->clientarray[entry].options & EXPORT_OPTION_ROOT) ==
+           (export_option & EXPORT_OPTION_ROOT))
+          {
+            best = entry;
+            break;
+          }
+
+      if(depth == len)
+        break;
+
+      node = nodes[node].child[(key[depth / 8] >> (7 - depth % 8)) & 1];
+      if(node == 0)
+        break;
+      depth += 1;
+    }
+
+  return best;
+}                               /* export_client_trie_match */
+
+/**
+ *
+ * nfs_FreeCompiledClientArray: releases the compiled form of a client array.
+ *
+ * @param clients [INOUT] the client array
+ *
+ * @return nothing (void function)
+ *
+ */
+void nfs_FreeCompiledClientArray(exportlist_client_t *clients)
+{
+  exportlist_client_matcher_t *pmatcher = clients->matcher;
+
+  if(pmatcher == NULL)
+    return;
+
+  clients->matcher = NULL;
+  Mem_Free(pmatcher->nodes[EXPORT_CLIENT_V4]);
+  Mem_Free(pmatcher->nodes[EXPORT_CLIENT_V6]);
+  Mem_Free(pmatcher);
+}                               /* nfs_FreeCompiledClientArray */
+
+/**
+ *
+ * nfs_CompileClientArray: builds the compiled form of a client array.
+ *
+ * The HOSTIF and NETWORK entries are put in a binary trie, so that looking for
+ * an address costs its length in bits whatever the number of clients. The
+ * other entries are kept apart, in array order, and only looked at when they
+ * come before the entry found in the trie.
+ *
+ * @param clients [INOUT] the client array
+ *
+ * @return 0 if ok, ENOMEM otherwise (the array is then walked linearly).
+ *
+ */
+int nfs_CompileClientArray(exportlist_client_t *clients)
+{
+  exportlist_client_matcher_t *pmatcher = NULL;
+  exportlist_client_entry_t *pentry;
+  in_addr_t netaddr;
+  unsigned int netmask;
+  unsigned int len;
+  unsigned int i;
+  int family;
+
+  pthread_once(&export_client_cache_once, export_client_cache_init);
+
+  nfs_FreeCompiledClientArray(clients);
+
+  if((pmatcher = (exportlist_client_matcher_t *)
+      Mem_Alloc_Label(sizeof(exportlist_client_matcher_t),
+                      "exportlist_client_matcher_t")) == NULL)
+    return ENOMEM;
+
+  memset(pmatcher, 0, sizeof(exportlist_client_matcher_t));
+  pmatcher->id = __sync_add_and_fetch(&export_client_matcher_id, 1);
+
+  for(family = EXPORT_CLIENT_V4; family <= EXPORT_CLIENT_V6; family++)
+    {
+      pmatcher->size_nodes[family] = 64;
+      pmatcher->nb_nodes[family] = 1;
+      pmatcher->nodes[family] = (export_client_node_t *)
+          Mem_Alloc_Label(64 * sizeof(export_client_node_t), "export_client_node_t");
+      if(pmatcher->nodes[family] == NULL)
+        goto enomem;
+      pmatcher->nodes[family][0].child[0] = 0;
+      pmatcher->nodes[family][0].child[1] = 0;
+      pmatcher->nodes[family][0].first_entry = EXPORT_CLIENT_NO_ENTRY;
+    }
+
+  for(i = 0; i < clients->num_clients; i++)
+    {
+      pentry = &clients->clientarray[i];
+
+      switch (pentry->type)
+        {
+        case HOSTIF_CLIENT:
+          if(export_client_trie_insert(pmatcher, EXPORT_CLIENT_V4,
+                                       (unsigned char *)&pentry->client.hostif.clientaddr,
+                                       32, i))
+            goto enomem;
+          break;
+
+        case NETWORK_CLIENT:
+          netmask = pentry->client.network.netmask;
+          for(len = 0; len < 32 && (netmask & (0x80000000U >> len)); len++) ;
+
+          if(len < 32 && (netmask << len) != 0)
+            {
+              /* Not a prefix, tested as is */
+              pmatcher->others[EXPORT_CLIENT_V4][pmatcher->nb_others[EXPORT_CLIENT_V4]++] = i;
+              break;
+            }
+
+          /* netaddr and netmask are in host order */
+          netaddr = htonl(pentry->client.network.netaddr);
+          if((pentry->client.network.netaddr & ~netmask) != 0)
+            break;              /* Can never match */
+
+          if(export_client_trie_insert(pmatcher, EXPORT_CLIENT_V4,
+                                       (unsigned char *)&netaddr, len, i))
+            goto enomem;
+          break;
+
+        case NETGROUP_CLIENT:
+        case WILDCARDHOST_CLIENT:
+        case GSSPRINCIPAL_CLIENT:
+          pmatcher->others[EXPORT_CLIENT_V4][pmatcher->nb_others[EXPORT_CLIENT_V4]++] = i;
+          break;
+
+        case HOSTIF_CLIENT_V6:
+          if(export_client_trie_insert(pmatcher, EXPORT_CLIENT_V6,
+                                       clients->clientarray[i].client.hostif.clientaddr6.s6_addr,
+                                       128, i))
+            goto enomem;
+          break;
+
+        default:
+          /* BAD_CLIENT and unknown entries stop the IPv6 lookups */
+          pmatcher->others[EXPORT_CLIENT_V6][pmatcher->nb_others[EXPORT_CLIENT_V6]++] = i;
+          break;
+        }
+    }
+
+  clients->matcher = pmatcher;
+
+  LogFullDebug(COMPONENT_CONFIG,
+               "Client array compiled: %u clients, %u+%u trie nodes, %u+%u other entries",
+               clients->num_clients,
+               pmatcher->nb_nodes[EXPORT_CLIENT_V4], pmatcher->nb_nodes[EXPORT_CLIENT_V6],
+               pmatcher->nb_others[EXPORT_CLIENT_V4], pmatcher->nb_others[EXPORT_CLIENT_V6]);
+  return 0;
+
+ enomem:
+  clients->matcher = pmatcher;
+  nfs_FreeCompiledClientArray(clients);
+  LogCrit(COMPONENT_CONFIG,
+          "Could not compile a client array, it will be walked linearly");
+  return ENOMEM;
+}                               /* nfs_CompileClientArray */
+
+/**
+ *
+ * export_client_match_name: checks a NETGROUP or WILDCARDHOST client entry.
+ *
+ * This needs the name of the client, hence a reverse name resolution when it
+ * is not in the IP/name cache.
+ *
+ * @param hostaddr [IN]  the address of the client
+ * @param ipstring [IN]  the address of the client, as a string
+ * @param pentry   [IN]  the client entry
+ * @param pstatus  [OUT] IP_NAME_SUCCESS if the verdict is final,
+ *                       IP_NAME_NETDB_ERROR if the name could not be resolved,
+ *                       IP_NAME_NOT_FOUND if it was not resolved in time yet.
+ *
+ * @return TRUE if the client matches the entry, FALSE otherwise.
+ *
+ */
+static int export_client_match_name(sockaddr_t *hostaddr,
+                                    char *ipstring,
+                                    exportlist_client_entry_t *pentry,
+                                    int *pstatus)
+{
+  int rc;
+  char hostname[MAXHOSTNAMELEN];
+  in_addr_t addr = get_in_addr(hostaddr);
+
+  *pstatus = IP_NAME_SUCCESS;
+
+  /* Now checking for IP wildcards */
+  if(pentry->type == WILDCARDHOST_CLIENT)
+    {
+      if(fnmatch(pentry->client.wildcard.wildcard, ipstring, FNM_PATHNAME) == 0)
+        return TRUE;
+
+      LogFullDebug(COMPONENT_DISPATCH,
+                   "Did not match the ip address with a wildcard.");
+    }
+
+  /* Get the name from the IP/name cache, the resolver threads fill it on a miss */
+  if((rc = nfs_ip_name_resolve(hostaddr, hostname)) != IP_NAME_SUCCESS)
+    {
+      /* Name could not be resolved (or not in time) */
+      LogFullDebug(COMPONENT_DISPATCH,
+                   "Could not resolve hostame for addr %u.%u.%u.%u (rc=%d) ... not checking if a hostname matches",
+                   (unsigned int)(addr & 0xFF),
+                   (unsigned int)(addr >> 8) & 0xFF,
+                   (unsigned int)(addr >> 16) & 0xFF,
+                   (unsigned int)(addr >> 24), rc);
+      *pstatus = rc;
+      return FALSE;
+    }
+
+  /* At this point 'hostname' should contain the name that was found */
+  if(pentry->type == NETGROUP_CLIENT)
+    return (innetgr(pentry->client.netgroup.netgroupname, hostname, NULL, NULL) == 1);
+
+  LogFullDebug(COMPONENT_DISPATCH,
+               "Wildcarded hostname: testing if '%s' matches '%s'",
+               hostname, pentry->client.wildcard.wildcard);
+
+  if(fnmatch(pentry->client.wildcard.wildcard, hostname, FNM_PATHNAME) == 0)
+    return TRUE;
+
+  LogFullDebug(COMPONENT_DISPATCH, "'%s' not matching '%s'",
+               hostname, pentry->client.wildcard.wildcard);
+  return FALSE;
+}                               /* export_client_match_name */
+
+/**
+ *
+ * export_client_match_cached: checks a NETGROUP or WILDCARDHOST client entry
+ * through the decision cache.
+ *
+ * The verdicts are kept per client address and client array, so that name
+ * resolutions, netgroups and patterns are only looked at once in a while for
+ * a given client. They last as long as the names of the IP/name cache: the
+ * matching ones for Expiration_Time, the others (including failed name
+ * resolutions) for Negative_Expiration_Time. A name not resolved in time yet
+ * is not kept at all.
+ *
+ * @param pmatcher [IN] the compiled array
+ * @param hostaddr [IN] the address of the client
+ * @param ipstring [IN] the address of the client, as a string
+ * @param pentry   [IN] the client entry
+ * @param entry    [IN] index of the client entry in the array
+ *
+ * @return TRUE if the client matches the entry, FALSE otherwise.
+ *
+ */
+static int export_client_match_cached(exportlist_client_matcher_t * pmatcher,
+                                      sockaddr_t *hostaddr,
+                                      char *ipstring,
+                                      exportlist_client_entry_t *pentry,
+                                      unsigned int entry)
+{
+  in_addr_t addr = get_in_addr(hostaddr);
+  unsigned int h = (addr * 2654435761U + pmatcher->id) % EXPORT_CLIENT_CACHE_SIZE;
+  pthread_mutex_t *plock = &export_client_cache_lock[h % EXPORT_CLIENT_CACHE_NB_LOCKS];
+  export_client_verdict_t *pverdict = &export_client_cache[h];
+  uint32_t bit = 1U << (entry % 32);
+  time_t now = time(NULL);
+  int rc;
+  int status;
+  unsigned int i;
+
+  P(*plock);
+  if(pverdict->id == pmatcher->id && pverdict->addr == addr && pverdict->expire > now &&
+     (pverdict->evaluated[entry / 32] & bit) &&
+     ((pverdict->matched[entry / 32] & bit) || pverdict->negative_expire > now))
+    {
+      rc = (pverdict->matched[entry / 32] & bit) ? TRUE : FALSE;
+      V(*plock);
+      return rc;
+    }
+  V(*plock);
+
+  /* Resolve outside of the lock */
+  rc = export_client_match_name(hostaddr, ipstring, pentry, &status);
+
+  /* The resolver threads are still working on it, ask again next time */
+  if(status == IP_NAME_NOT_FOUND)
+    return rc;
+
+  P(*plock);
+  if(pverdict->id != pmatcher->id || pverdict->addr != addr || pverdict->expire <= now)
+    {
+      memset(pverdict, 0, sizeof(export_client_verdict_t));
+      pverdict->id = pmatcher->id;
+      pverdict->addr = addr;
+      pverdict->expire = now + nfs_param.ip_name_param.expiration_time;
+    }
+  if(rc)
+    pverdict->matched[entry / 32] |= bit;
+  else
+    {
+      /* The other verdicts share one deadline: drop those that are over
+       * before starting a new one */
+      if(pverdict->negative_expire <= now)
+        {
+          for(i = 0; i < EXPORT_CLIENT_BITMAP_LEN; i++)
+            pverdict->evaluated[i] &= pverdict->matched[i];
+          pverdict->negative_expire = now + nfs_param.ip_name_param.negative_expiration_time;
+        }
+      pverdict->matched[entry / 32] &= ~bit;
+    }
+  pverdict->evaluated[entry / 32] |= bit;
+  V(*plock);
+
+  return rc;
+}                               /* export_client_match_cached */
+
 /**
  * function for matching a specific option in the client export list.
  */
@@ -2316,9 +2817,12 @@ int export_client_match(sockaddr_t *hostaddr,
 			unsigned int export_option)
 {
   unsigned int i;
+  unsigned int j;
+  unsigned int best;
   int rc;
-  char hostname[MAXHOSTNAMELEN];
+  int status;
   in_addr_t addr = get_in_addr(hostaddr);
+  exportlist_client_matcher_t *pmatcher;
 
   if(export_option & EXPORT_OPTION_ROOT)
     LogFullDebug(COMPONENT_DISPATCH,
@@ -2332,6 +2836,57 @@ int export_client_match(sockaddr_t *hostaddr,
     LogFullDebug(COMPONENT_DISPATCH,
                  "Looking for nonroot access write entries");
 
+  if((pmatcher = clients->matcher) != NULL)
+    {
+      /* First entry of the trie matching the address, then the other
+       * entries that come before it in the array */
+      best = export_client_trie_match(pmatcher, clients, EXPORT_CLIENT_V4,
+                                      (unsigned char *)&addr, 32, export_option);
+
+      for(j = 0; j < pmatcher->nb_others[EXPORT_CLIENT_V4]; j++)
+        {
+          i = pmatcher->others[EXPORT_CLIENT_V4][j];
+          if(i >= best)
+            break;
+
+          if(((clients->clientarray[i].options & export_option) == 0) ||
+             ((clients->clientarray[i].options & EXPORT_OPTION_ROOT) != (export_option & EXPORT_OPTION_ROOT)))
+            continue;
+
+          switch (clients->clientarray[i].type)
+            {
+            case NETWORK_CLIENT:
+              rc = ((clients->clientarray[i].client.network.netmask & ntohl(addr)) ==
+                    clients->clientarray[i].client.network.netaddr);
+              break;
+
+            case NETGROUP_CLIENT:
+            case WILDCARDHOST_CLIENT:
+              rc = export_client_match_cached(pmatcher, hostaddr, ipstring,
+                                              &clients->clientarray[i], i);
+              break;
+
+            default:
+              LogFullDebug(COMPONENT_DISPATCH,
+                           "----------> Unsupported type GSS_PRINCIPAL_CLIENT");
+              return FALSE;
+            }
+
+          if(rc)
+            {
+              *pclient_found = clients->clientarray[i];
+              return TRUE;
+            }
+        }
+
+      if(best == EXPORT_CLIENT_NO_ENTRY)
+        return FALSE;
+
+      LogFullDebug(COMPONENT_DISPATCH, "This matches host or network address");
+      *pclient_found = clients->clientarray[best];
+      return TRUE;
+    }
+
   for(i = 0; i < clients->num_clients; i++)
     {
       /* Make sure the client entry has the permission flags we're looking for
@@ -2376,76 +2931,13 @@ int export_client_match(sockaddr_t *hostaddr,
           break;
 
         case NETGROUP_CLIENT:
-          /* Try to get the entry from th IP/name cache */
-          if((rc = nfs_ip_name_get(hostaddr, hostname)) != IP_NAME_SUCCESS)
-            {
-              if(rc == IP_NAME_NOT_FOUND)
-                {
-                  /* IPaddr was not cached, add it to the cache */
-                  if(nfs_ip_name_add(hostaddr, hostname) != IP_NAME_SUCCESS)
-                    {
-                      /* Major failure, name could not be resolved */
-                      break;
-                    }
-                }
-            }
-
-          /* At this point 'hostname' should contain the name that was found */
-          if(innetgr
-             (clients->clientarray[i].client.netgroup.netgroupname, hostname,
-              NULL, NULL) == 1)
-            {
-              *pclient_found = clients->clientarray[i];
-              return TRUE;
-            }
-          break;
-
         case WILDCARDHOST_CLIENT:
-          /* Now checking for IP wildcards */
-          if(fnmatch
-             (clients->clientarray[i].client.wildcard.wildcard, ipstring,
-              FNM_PATHNAME) == 0)
+          if(export_client_match_name(hostaddr, ipstring, &clients->clientarray[i],
+                                      &status))
             {
               *pclient_found = clients->clientarray[i];
               return TRUE;
             }
-
-          LogFullDebug(COMPONENT_DISPATCH,
-                       "Did not match the ip address with a wildcard.");
-
-          /* Try to get the entry from th IP/name cache */
-          if((rc = nfs_ip_name_get(hostaddr, hostname)) != IP_NAME_SUCCESS)
-            {
-              if(rc == IP_NAME_NOT_FOUND)
-                {
-                  /* IPaddr was not cached, add it to the cache */
-                  if(nfs_ip_name_add(hostaddr, hostname) != IP_NAME_SUCCESS)
-                    {
-                      /* Major failure, name could not be resolved */
-                      LogFullDebug(COMPONENT_DISPATCH,
-                                   "Could not resolve hostame for addr %u.%u.%u.%u ... not checking if a hostname wildcard matches",
-                                   (unsigned int)(addr & 0xFF),
-                                   (unsigned int)(addr >> 8) & 0xFF,
-                                   (unsigned int)(addr >> 16) & 0xFF,
-                                   (unsigned int)(addr >> 24));
-                      break;
-                    }
-                }
-            }
-          LogFullDebug(COMPONENT_DISPATCH,
-                       "Wildcarded hostname: testing if '%s' matches '%s'",
-                       hostname, clients->clientarray[i].client.wildcard.wildcard);
-
-          /* At this point 'hostname' should contain the name that was found */
-          if(fnmatch
-             (clients->clientarray[i].client.wildcard.wildcard, hostname,
-              FNM_PATHNAME) == 0)
-            {
-              *pclient_found = clients->clientarray[i];
-              return TRUE;
-            }
-          LogFullDebug(COMPONENT_DISPATCH, "'%s' not matching '%s'",
-                       hostname, clients->clientarray[i].client.wildcard.wildcard);
           break;
 
         case GSSPRINCIPAL_CLIENT:
@@ -2478,6 +2970,9 @@ int export_client_matchv6(struct in6_addr *paddrv6,
 			  unsigned int export_option)
 {
   unsigned int i;
+  unsigned int j;
+  unsigned int best;
+  exportlist_client_matcher_t *pmatcher;
 
   if(export_option & EXPORT_OPTION_ROOT)
     LogFullDebug(COMPONENT_DISPATCH,
@@ -2491,6 +2986,32 @@ int export_client_matchv6(struct in6_addr *paddrv6,
     LogFullDebug(COMPONENT_DISPATCH,
                  "Looking for nonroot access write entries");
 
+  if((pmatcher = clients->matcher) != NULL)
+    {
+      best = export_client_trie_match(pmatcher, clients, EXPORT_CLIENT_V6,
+                                      paddrv6->s6_addr, 128, export_option);
+
+      /* An unsupported entry before the one found ends the lookup */
+      for(j = 0; j < pmatcher->nb_others[EXPORT_CLIENT_V6]; j++)
+        {
+          i = pmatcher->others[EXPORT_CLIENT_V6][j];
+          if(i >= best)
+            break;
+
+          if(((clients->clientarray[i].options & export_option) != 0) &&
+             ((clients->clientarray[i].options & EXPORT_OPTION_ROOT) == (export_option & EXPORT_OPTION_ROOT)))
+            return FALSE;
+        }
+
+      if(best == EXPORT_CLIENT_NO_ENTRY)
+        return FALSE;
+
+      LogFullDebug(COMPONENT_DISPATCH,
+                   "This matches host adress in IPv6");
+      *pclient_found = clients->clientarray[best];
+      return TRUE;
+    }
+
   for(i = 0; i < clients->num_clients; i++)
     {
       /* Make sure the client entry has the permission flags we're looking for
@@ -3100,6 +3621,8 @@ exportlist_t *RemoveExportEntry(exportlist_t * exportEntry)
   if (exportEntry->proot_handle != NULL)
     Mem_Free(exportEntry->proot_handle);
 
+  nfs_FreeCompiledClientArray(&exportEntry->clients);
+
   Mem_Free(exportEntry);
   return next;
 }
@@ -0,0 +1,488 @@
+/*
+ * vim:expandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * ---------------------------------------
+ */
+
+/**
+ * \file    fsal_admission.c
+ * \brief   Adaptive limit of the FSAL calls in progress, per export.
+ *
+ * fsal_admission.c : The state of an export is created, with the largest
+ * windows, the first time one of its calls is admitted, and released when
+ * the export is cleaned up by a reload. The table of the states is read
+ * without locking, only the creation and the release of a state take the
+ * table's mutex. A released state is not freed, a lookup may still walk
+ * through it: it is kept aside and reused for the next export once no call
+ * holds it anymore. Each state has its own mutex, shared by its two windows.
+ *
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#ifdef _SOLARIS
+#include "solaris_port.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "RW_Lock.h"
+#include "log_macros.h"
+#include "nfs_stat_registry.h"
+#include "fsal_admission.h"
+
+#define FSAL_ADMIT_BUCKETS 61
+
+typedef struct fsal_admit_queue__
+{
+  pthread_mutex_t *pmutex;      /* the mutex of the export */
+  pthread_cond_t cond;
+  fsal_admit_class_t class;
+  unsigned int window;
+  unsigned int inflight;
+  unsigned int waiting;
+  unsigned int acked;           /* calls completed without congestion since the last increase */
+  unsigned int since_decrease;  /* calls completed since the last decrease */
+  unsigned int period_count;
+  uint64_t period_min;
+  uint64_t latency_base;
+  uint64_t latency_avg;
+  uint64_t nb_admitted;
+  uint64_t nb_waited;
+  uint64_t nb_refused;
+  uint64_t nb_increase;
+  uint64_t nb_decrease;
+} fsal_admit_queue_t;
+
+typedef struct fsal_admit_export__
+{
+  struct fsal_admit_export__ *volatile next;
+  struct fsal_admit_export__ *next_released;
+  void *key;
+  pthread_mutex_t mutex;
+  fsal_admit_queue_t queues[FSAL_ADMIT_NB_CLASS];
+} fsal_admit_export_t;
+
+static fsal_admit_parameter_t fsal_admit_param;
+static pthread_mutex_t fsal_admit_table_mutex = PTHREAD_MUTEX_INITIALIZER;
+static fsal_admit_export_t *volatile fsal_admit_table[FSAL_ADMIT_BUCKETS];
+static fsal_admit_export_t *fsal_admit_released = NULL;      /* under the table's mutex */
+static int fsal_admit_histograms[FSAL_ADMIT_NB_CLASS] = { -1, -1 };
+
+static const char *fsal_admit_class_names[FSAL_ADMIT_NB_CLASS] = { "metadata", "data" };
+
+/**
+ *
+ * fsal_admit_init: sets the limits, and registers the histograms of the waits.
+ *
+ * Until it is called, or if pparam->enabled is FALSE, every call is admitted
+ * without being counted.
+ *
+ * @param pparam [IN] the limits.
+ *
+ * @return FSAL_ADMIT_SUCCESS, or -1 if the limits are not consistent.
+ *
+ */
+int fsal_admit_init(fsal_admit_parameter_t * pparam)
+{
+  char name[NFS_STAT_NAME_LEN];
+  unsigned int i;
+
+  if(pparam->min_window == 0 || pparam->min_window > pparam->max_window ||
+     pparam->tolerance <= 100 || pparam->base_period == 0)
+    return -1;
+
+  for(i = 0; i < FSAL_ADMIT_NB_CLASS; i++)
+    {
+      snprintf(name, NFS_STAT_NAME_LEN, "fsal.admit.%s.wait", fsal_admit_class_names[i]);
+      fsal_admit_histograms[i] = nfs_stat_register_histogram(name);
+    }
+
+  fsal_admit_param = *pparam;
+
+  return FSAL_ADMIT_SUCCESS;
+}                               /* fsal_admit_init */
+
+/**
+ *
+ * fsal_admit_reset: gives its largest windows to a new or reused state.
+ *
+ * @param pexp [INOUT] the state, its mutex held if it is reused.
+ * @param key  [IN]    identifies its export.
+ *
+ * @return nothing (void function)
+ *
+ */
+static void fsal_admit_reset(fsal_admit_export_t * pexp, void *key)
+{
+  fsal_admit_queue_t *pqueue;
+  unsigned int i;
+
+  pexp->key = key;
+  pexp->next_released = NULL;
+
+  for(i = 0; i < FSAL_ADMIT_NB_CLASS; i++)
+    {
+      pqueue = &pexp->queues[i];
+      pqueue->pmutex = &pexp->mutex;
+      pqueue->class = i;
+      pqueue->window = fsal_admit_param.max_window;
+      pqueue->inflight = 0;
+      pqueue->waiting = 0;
+      pqueue->acked = 0;
+      pqueue->since_decrease = 0;
+      pqueue->period_count = 0;
+      pqueue->period_min = UINT64_MAX;
+      pqueue->latency_base = 0;
+      pqueue->latency_avg = 0;
+      pqueue->nb_admitted = 0;
+      pqueue->nb_waited = 0;
+      pqueue->nb_refused = 0;
+      pqueue->nb_increase = 0;
+      pqueue->nb_decrease = 0;
+    }
+}                               /* fsal_admit_reset */
+
+/**
+ *
+ * fsal_admit_reuse: takes a released state that no call holds anymore.
+ *
+ * The table's mutex must be held.
+ *
+ * @param key [IN] identifies the export the state is now for.
+ *
+ * @return the state, NULL if every released state is still held.
+ *
+ */
+static fsal_admit_export_t *fsal_admit_reuse(void *key)
+{
+  fsal_admit_export_t **ppexp;
+  fsal_admit_export_t *pexp;
+  unsigned int i;
+
+  for(ppexp = &fsal_admit_released; (pexp = *ppexp) != NULL; ppexp = &pexp->next_released)
+    {
+      P(pexp->mutex);
+
+      for(i = 0; i < FSAL_ADMIT_NB_CLASS; i++)
+        if(pexp->queues[i].inflight > 0 || pexp->queues[i].waiting > 0)
+          break;
+
+      if(i == FSAL_ADMIT_NB_CLASS)
+        {
+          *ppexp = pexp->next_released;
+          fsal_admit_reset(pexp, key);
+          V(pexp->mutex);
+          return pexp;
+        }
+
+      V(pexp->mutex);
+    }
+
+  return NULL;
+}                               /* fsal_admit_reuse */
+
+/**
+ *
+ * fsal_admit_lookup: finds the state of an export.
+ *
+ * @param key    [IN] identifies the export.
+ * @param create [IN] creates the state if it does not exist yet.
+ *
+ * @return the state, NULL if it does not exist or could not be allocated.
+ *
+ */
+static fsal_admit_export_t *fsal_admit_lookup(void *key, int create)
+{
+  unsigned int bucket = ((unsigned long)key >> 4) % FSAL_ADMIT_BUCKETS;
+  fsal_admit_export_t *pexp;
+  unsigned int i;
+
+  for(pexp = fsal_admit_table[bucket]; pexp != NULL; pexp = pexp->next)
+    if(pexp->key == key)
+      return pexp;
+
+  if(!create)
+    return NULL;
+
+  P(fsal_admit_table_mutex);
+
+  /* Another thread may have created it in the meantime */
+  for(pexp = fsal_admit_table[bucket]; pexp != NULL; pexp = pexp->next)
+    if(pexp->key == key)
+      break;
+
+  if(pexp == NULL)
+    {
+      /* A state released by a removed export, or a new one shared by every
+       * thread and never freed, not taken from a thread's pool */
+      if((pexp = fsal_admit_reuse(key)) == NULL &&
+         (pexp = (fsal_admit_export_t *) malloc(sizeof(fsal_admit_export_t))) != NULL)
+        {
+          memset(pexp, 0, sizeof(fsal_admit_export_t));
+          pthread_mutex_init(&pexp->mutex, NULL);
+          for(i = 0; i < FSAL_ADMIT_NB_CLASS; i++)
+            pthread_cond_init(&pexp->queues[i].cond, NULL);
+          fsal_admit_reset(pexp, key);
+        }
+
+      if(pexp != NULL)
+        {
+          pexp->next = fsal_admit_table[bucket];
+
+          /* The state is complete before the readers can find it */
+          __sync_synchronize();
+          fsal_admit_table[bucket] = pexp;
+        }
+      else
+        LogCrit(COMPONENT_FSAL, "FSAL admission: cannot allocate the state of an export");
+    }
+
+  V(fsal_admit_table_mutex);
+
+  return pexp;
+}                               /* fsal_admit_lookup */
+
+/**
+ *
+ * fsal_admit_enter: waits until a call may reach the backend.
+ *
+ * @param pticket    [OUT] to be given to fsal_admit_exit once the call is done.
+ * @param key        [IN]  identifies the export, NULL for the calls of no export.
+ * @param class      [IN]  metadata or data call.
+ * @param may_refuse [IN]  refuse the call when too many calls already wait,
+ *                         instead of waiting anyway.
+ *
+ * @return FSAL_ADMIT_SUCCESS if the call is admitted, FSAL_ADMIT_REFUSED otherwise.
+ *
+ */
+int fsal_admit_enter(fsal_admit_ticket_t * pticket, void *key,
+                     fsal_admit_class_t class, int may_refuse)
+{
+  fsal_admit_export_t *pexp;
+  fsal_admit_queue_t *pqueue;
+  uint64_t wait_start;
+
+  pticket->queue = NULL;
+  pticket->start = 0;
+
+  if(!fsal_admit_param.enabled || (pexp = fsal_admit_lookup(key, 1)) == NULL)
+    return FSAL_ADMIT_SUCCESS;
+
+  pqueue = &pexp->queues[class];
+
+  P(pexp->mutex);
+
+  if(pqueue->inflight >= pqueue->window)
+    {
+      if(may_refuse && pqueue->waiting >= pqueue->window)
+        {
+          pqueue->nb_refused += 1;
+          V(pexp->mutex);
+          return FSAL_ADMIT_REFUSED;
+        }
+
+      pqueue->nb_waited += 1;
+      pqueue->waiting += 1;
+      wait_start = nfs_stat_now();
+
+      while(pqueue->inflight >= pqueue->window)
+        pthread_cond_wait(&pqueue->cond, &pexp->mutex);
+
+      pqueue->waiting -= 1;
+      nfs_stat_histogram_record(fsal_admit_histograms[class], nfs_stat_now() - wait_start);
+    }
+
+  pqueue->inflight += 1;
+  pqueue->nb_admitted += 1;
+
+  V(pexp->mutex);
+
+  pticket->queue = pqueue;
+  pticket->start = nfs_stat_now();
+
+  return FSAL_ADMIT_SUCCESS;
+}                               /* fsal_admit_enter */
+
+/**
+ *
+ * fsal_admit_exit: a call admitted by fsal_admit_enter is done.
+ *
+ * The latency of the call moves the window of its export: a full window of
+ * calls completed without congestion while the window was in use grows it
+ * by one, congestion shrinks it by a quarter, at most once per window of
+ * calls so that the calls already in progress do not shrink it again.
+ *
+ * @param pticket   [IN] the ticket of the call.
+ * @param congested [IN] the backend asked to retry later.
+ *
+ * @return nothing (void function)
+ *
+ */
+void fsal_admit_exit(fsal_admit_ticket_t * pticket, int congested)
+{
+  fsal_admit_queue_t *pqueue = pticket->queue;
+  uint64_t latency;
+  unsigned int full;
+  unsigned int slots;
+
+  if(pqueue == NULL)
+    return;
+
+  latency = nfs_stat_now() - pticket->start;
+  pticket->queue = NULL;
+
+  P(*pqueue->pmutex);
+
+  full = (pqueue->inflight >= pqueue->window || pqueue->waiting > 0);
+  pqueue->inflight -= 1;
+
+  /* The base is the lowest latency of the last period, so that it follows
+   * a backend that got slower for good */
+  if(latency < pqueue->period_min)
+    pqueue->period_min = latency;
+  if(pqueue->latency_base == 0)
+    pqueue->latency_base = latency;
+  if(++pqueue->period_count >= fsal_admit_param.base_period)
+    {
+      pqueue->latency_base = pqueue->period_min;
+      pqueue->period_min = UINT64_MAX;
+      pqueue->period_count = 0;
+    }
+
+  /* Average over the last 8 calls or so, one slow call is not congestion */
+  if(pqueue->latency_avg == 0)
+    pqueue->latency_avg = latency;
+  else
+    pqueue->latency_avg = pqueue->latency_avg - pqueue->latency_avg / 8 + latency / 8;
+
+  if(pqueue->latency_avg > pqueue->latency_base * fsal_admit_param.tolerance / 100)
+    congested = 1;
+
+  pqueue->since_decrease += 1;
+
+  if(congested)
+    {
+      pqueue->acked = 0;
+      if(pqueue->since_decrease >= pqueue->window &&
+         pqueue->window > fsal_admit_param.min_window)
+        {
+          pqueue->window -= (pqueue->window + 3) / 4;
+          if(pqueue->window < fsal_admit_param.min_window)
+            pqueue->window = fsal_admit_param.min_window;
+          pqueue->since_decrease = 0;
+          pqueue->nb_decrease += 1;
+        }
+    }
+  else if(full && ++pqueue->acked >= pqueue->window)
+    {
+      pqueue->acked = 0;
+      if(pqueue->window < fsal_admit_param.max_window)
+        {
+          pqueue->window += 1;
+          pqueue->nb_increase += 1;
+        }
+    }
+
+  /* One waiter per free slot */
+  if(pqueue->waiting > 0 && pqueue->inflight < pqueue->window)
+    {
+      slots = pqueue->window - pqueue->inflight;
+      if(slots >= pqueue->waiting)
+        pthread_cond_broadcast(&pqueue->cond);
+      else
+        while(slots-- > 0)
+          pthread_cond_signal(&pqueue->cond);
+    }
+
+  V(*pqueue->pmutex);
+}                               /* fsal_admit_exit */
+
+/**
+ *
+ * fsal_admit_release: forgets the state of an export that is removed.
+ *
+ * The state leaves the table but is not freed: a lookup may be walking
+ * through it, and calls of the export may still be in progress. It is
+ * reused for another export once they are done.
+ *
+ * @param key [IN] identifies the export.
+ *
+ * @return nothing (void function)
+ *
+ */
+void fsal_admit_release(void *key)
+{
+  unsigned int bucket = ((unsigned long)key >> 4) % FSAL_ADMIT_BUCKETS;
+  fsal_admit_export_t *volatile *ppexp;
+  fsal_admit_export_t *pexp;
+
+  P(fsal_admit_table_mutex);
+
+  for(ppexp = &fsal_admit_table[bucket]; (pexp = *ppexp) != NULL; ppexp = &pexp->next)
+    if(pexp->key == key)
+      {
+        /* Its own link is left as is for the lookups walking through it */
+        *ppexp = pexp->next;
+        pexp->next_released = fsal_admit_released;
+        fsal_admit_released = pexp;
+        break;
+      }
+
+  V(fsal_admit_table_mutex);
+}                               /* fsal_admit_release */
+
+/**
+ *
+ * fsal_admit_get_stats: reads the window of an export.
+ *
+ * @param key    [IN]  identifies the export.
+ * @param class  [IN]  metadata or data calls.
+ * @param pstats [OUT] the state of the window, and its counters.
+ *
+ * @return FSAL_ADMIT_SUCCESS, or -1 if no call of the export was admitted yet.
+ *
+ */
+int fsal_admit_get_stats(void *key, fsal_admit_class_t class,
+                         fsal_admit_stats_t * pstats)
+{
+  fsal_admit_export_t *pexp;
+  fsal_admit_queue_t *pqueue;
+
+  if((pexp = fsal_admit_lookup(key, 0)) == NULL)
+    return -1;
+
+  pqueue = &pexp->queues[class];
+
+  P(pexp->mutex);
+  pstats->window = pqueue->window;
+  pstats->inflight = pqueue->inflight;
+  pstats->waiting = pqueue->waiting;
+  pstats->latency_base = pqueue->latency_base;
+  pstats->latency_avg = pqueue->latency_avg;
+  pstats->nb_admitted = pqueue->nb_admitted;
+  pstats->nb_waited = pqueue->nb_waited;
+  pstats->nb_refused = pqueue->nb_refused;
+  pstats->nb_increase = pqueue->nb_increase;
+  pstats->nb_decrease = pqueue->nb_decrease;
+  V(pexp->mutex);
+
+  return FSAL_ADMIT_SUCCESS;
+}                               /* fsal_admit_get_stats */
@@ -109,6 +109,11 @@
 #include "nfs_exports.h"
 #include "nfs_file_handle.h"
 
+/* Index of the current export list, see nfs_export_index_publish */
+static export_index_t *export_index = NULL;
+
+size_t strnlen(const char *s, size_t maxlen);
+
 const char *Rpc_gss_svc_name[] =
     { "no name", "RPCSEC_GSS_SVC_NONE", "RPCSEC_GSS_SVC_INTEGRITY",
   "RPCSEC_GSS_SVC_PRIVACY"
@@ -129,8 +134,13 @@ const char *Rpc_gss_svc_name[] =
 exportlist_t *nfs_Get_export_by_id(exportlist_t * exportroot, unsigned short exportid)
 {
   exportlist_t *piter;
+  export_index_t *pindex = export_index;
   int found = 0;
 
+  /* Use the index if it was built from this very list */
+  if(pindex != NULL && pindex->exportroot == exportroot)
+    return pindex->by_id[exportid];
+
   for(piter = exportroot; piter != NULL; piter = piter->next)
     {
       if(piter->id == exportid)
@@ -146,6 +156,347 @@ exportlist_t *nfs_Get_export_by_id(exportlist_t * exportroot, unsigned short exp
     return piter;
 }                               /* nfs_Get_export_by_id */
 
+/**
+ *
+ * export_index_hash: hashes a key of the export index.
+ *
+ * @param key [IN] the key (not null terminated)
+ * @param len [IN] its length
+ *
+ * @return the hash value.
+ *
+ */
+static unsigned long export_index_hash(const char *key, unsigned int len)
+{
+  unsigned long hash = 2166136261UL;
+  unsigned int i;
+
+  for(i = 0; i < len; i++)
+    hash = (hash ^ (unsigned char)key[i]) * 16777619UL;
+
+  return hash;
+}                               /* export_index_hash */
+
+/**
+ *
+ * export_index_path_len: length of an export path without its trailing '/'.
+ *
+ * The root "/" gives an empty key, so that it is a prefix of every path.
+ *
+ * @param path [IN] the path
+ *
+ * @return the length of the key.
+ *
+ */
+static unsigned int export_index_path_len(const char *path)
+{
+  unsigned int len = strnlen(path, MAXPATHLEN);
+
+  while(len > 0 && path[len - 1] == '/')
+    len -= 1;
+
+  return len;
+}                               /* export_index_path_len */
+
+/**
+ *
+ * export_index_find: looks for a key in one of the tables of the index.
+ *
+ * @param table  [IN] the table
+ * @param mask   [IN] its size minus one
+ * @param bypath [IN] TRUE if keyed by fullpath, FALSE if keyed by FS_tag
+ * @param key    [IN] the key
+ * @param len    [IN] its length
+ *
+ * @return the slot of the key, NULL if not found.
+ *
+ */
+static export_index_slot_t *export_index_find(export_index_slot_t * table,
+                                              unsigned int mask,
+                                              int bypath,
+                                              const char *key, unsigned int len)
+{
+  unsigned long hash = export_index_hash(key, len);
+  unsigned int i;
+
+  for(i = hash & mask; table[i].pexport != NULL; i = (i + 1) & mask)
+    if(table[i].hash == hash && table[i].len == len &&
+       !memcmp(bypath ? table[i].pexport->fullpath : table[i].pexport->FS_tag, key, len))
+      return &table[i];
+
+  return NULL;
+}                               /* export_index_find */
+
+/**
+ *
+ * export_index_insert: adds an entry to one of the tables of the index.
+ *
+ * When several entries share the same key, the first one in the list is kept,
+ * as the linear walks of the list used to do.
+ *
+ * @param table   [INOUT] the table
+ * @param mask    [IN]    its size minus one
+ * @param bypath  [IN]    TRUE if keyed by fullpath, FALSE if keyed by FS_tag
+ * @param pexport [IN]    the entry
+ * @param rank    [IN]    position of the entry in the list
+ *
+ * @return nothing (void function)
+ *
+ */
+static void export_index_insert(export_index_slot_t * table,
+                                unsigned int mask,
+                                int bypath, exportlist_t * pexport, unsigned int rank)
+{
+  const char *key = bypath ? pexport->fullpath : pexport->FS_tag;
+  unsigned int len = bypath ? export_index_path_len(key) : strnlen(key, MAXPATHLEN);
+  unsigned long hash = export_index_hash(key, len);
+  unsigned int i;
+
+  if(export_index_find(table, mask, bypath, key, len) != NULL)
+    return;
+
+  for(i = hash & mask; table[i].pexport != NULL; i = (i + 1) & mask) ;
+
+  table[i].hash = hash;
+  table[i].len = len;
+  table[i].rank = rank;
+  table[i].pexport = pexport;
+}                               /* export_index_insert */
+
+/**
+ *
+ * nfs_export_index_free: releases an index that is no more published.
+ *
+ * @param pindex [IN] the index (may be NULL)
+ *
+ * @return nothing (void function)
+ *
+ */
+void nfs_export_index_free(export_index_t * pindex)
+{
+  if(pindex == NULL)
+    return;
+
+  Mem_Free(pindex->by_path);
+  Mem_Free(pindex->by_tag);
+  Mem_Free(pindex);
+}                               /* nfs_export_index_free */
+
+/**
+ *
+ * nfs_export_get: keeps an export beyond the request that found it.
+ *
+ * An export removed by a reload is freed once the requests that were running
+ * are done, unless it is still held: it is then freed by a later reload once
+ * the last holder released it. The caller must be within a request, so that
+ * the export can not be freed before it is held.
+ *
+ * @param pexport [INOUT] the export (may be NULL)
+ *
+ * @return nothing (void function)
+ *
+ */
+void nfs_export_get(exportlist_t * pexport)
+{
+  if(pexport != NULL)
+    __sync_add_and_fetch(&pexport->refcount, 1);
+}                               /* nfs_export_get */
+
+/**
+ *
+ * nfs_export_put: releases an export kept by nfs_export_get.
+ *
+ * @param pexport [INOUT] the export (may be NULL)
+ *
+ * @return nothing (void function)
+ *
+ */
+void nfs_export_put(exportlist_t * pexport)
+{
+  if(pexport != NULL)
+    __sync_sub_and_fetch(&pexport->refcount, 1);
+}                               /* nfs_export_put */
+
+/**
+ *
+ * nfs_export_index_publish: builds the index of an export list and makes it
+ * the one used by the lookups.
+ *
+ * The index is built aside and published with a single pointer store, so
+ * readers never see a partially built index. The previous index is handed
+ * back to the caller, who releases it with nfs_export_index_free once no
+ * lookup can still be running on it. If ppold is NULL, it is released right
+ * away (workers are not started yet). The weights and caps of the entries
+ * in the fair share of the workers are set at the same time.
+ *
+ * @param exportroot [IN]  the export list
+ * @param ppold      [OUT] the index that was replaced (may be NULL)
+ *
+ * @return 1 if ok, 0 otherwise.
+ *
+ */
+int nfs_export_index_publish(exportlist_t * exportroot, export_index_t ** ppold)
+{
+  export_index_t *pindex = NULL;
+  export_index_t *pold = NULL;
+  exportlist_t *piter;
+  unsigned int nb_entries = 0;
+  unsigned int size = 16;
+  unsigned int rank = 0;
+
+  for(piter = exportroot; piter != NULL; piter = piter->next)
+    nb_entries += 1;
+
+  while(size < 2 * nb_entries)
+    size *= 2;
+
+  if((pindex = (export_index_t *) Mem_Alloc_Label(sizeof(export_index_t),
+                                                  "export_index_t")) == NULL)
+    goto publish;
+
+  memset(pindex, 0, sizeof(export_index_t));
+  pindex->exportroot = exportroot;
+  pindex->path_mask = size - 1;
+  pindex->tag_mask = size - 1;
+  pindex->by_path = (export_index_slot_t *)
+      Mem_Alloc_Label(size * sizeof(export_index_slot_t), "export_index_slot_t");
+  pindex->by_tag = (export_index_slot_t *)
+      Mem_Alloc_Label(size * sizeof(export_index_slot_t), "export_index_slot_t");
+
+  if(pindex->by_path == NULL || pindex->by_tag == NULL)
+    {
+      if(pindex->by_path != NULL)
+        Mem_Free(pindex->by_path);
+      if(pindex->by_tag != NULL)
+        Mem_Free(pindex->by_tag);
+      Mem_Free(pindex);
+      pindex = NULL;
+      goto publish;
+    }
+
+  memset(pindex->by_path, 0, size * sizeof(export_index_slot_t));
+  memset(pindex->by_tag, 0, size * sizeof(export_index_slot_t));
+
+  for(piter = exportroot; piter != NULL; piter = piter->next, rank++)
+    {
+      if(pindex->by_id[piter->id] == NULL)
+        pindex->by_id[piter->id] = piter;
+
+      export_index_insert(pindex->by_path, pindex->path_mask, TRUE, piter, rank);
+      export_index_insert(pindex->by_tag, pindex->tag_mask, FALSE, piter, rank);
+    }
+
+  for(piter = exportroot; piter != NULL; piter = piter->next)
+    if(nfs_fair_share_set_export(piter->id, piter->share_weight,
+                                 piter->share_max_rate) != NFS_FAIR_SHARE_SUCCESS)
+      LogCrit(COMPONENT_CONFIG,
+              "Cannot set the fair share of export %u, it keeps the previous one",
+              piter->id);
+
+  /* Publish the new index. If it could not be built, the previous one is
+   * withdrawn anyway since it may refer to entries of a released list */
+ publish:
+  pold = __sync_lock_test_and_set(&export_index, pindex);
+
+  if(ppold != NULL)
+    *ppold = pold;
+  else
+    nfs_export_index_free(pold);
+
+  if(pindex == NULL)
+    return 0;
+
+  LogDebug(COMPONENT_CONFIG, "Export index built for %u entries", nb_entries);
+
+  return 1;
+}                               /* nfs_export_index_publish */
+
+/**
+ *
+ * nfs_Get_export_by_path: Gets the export entry for a path used by MOUNT.
+ *
+ * The entry is the first one in the list whose fullpath is the path or one of
+ * its parent directories. With the index, every parent of the path is looked
+ * up instead of walking the list.
+ *
+ * @param exportroot [IN] the root for the export list
+ * @param path       [IN] the path to be mounted
+ *
+ * @return the export entry or NULL if failed.
+ *
+ */
+exportlist_t *nfs_Get_export_by_path(exportlist_t * exportroot, char *path)
+{
+  export_index_t *pindex = export_index;
+  export_index_slot_t *pslot = NULL;
+  exportlist_t *pfound = NULL;
+  exportlist_t *piter;
+  unsigned int found_rank = 0;
+  unsigned int pathlen = export_index_path_len(path);
+  unsigned int len;
+  unsigned int plen;
+
+  if(pindex != NULL && pindex->exportroot == exportroot)
+    {
+      for(len = 0; len <= pathlen; len++)
+        {
+          if(len < pathlen && path[len] != '/')
+            continue;
+
+          pslot = export_index_find(pindex->by_path, pindex->path_mask, TRUE, path, len);
+          if(pslot != NULL && (pfound == NULL || pslot->rank < found_rank))
+            {
+              pfound = pslot->pexport;
+              found_rank = pslot->rank;
+            }
+        }
+
+      return pfound;
+    }
+
+  for(piter = exportroot; piter != NULL; piter = piter->next)
+    {
+      plen = export_index_path_len(piter->fullpath);
+
+      /* Is the export's path the path or one of its parents ? */
+      if(plen <= pathlen && !strncmp(piter->fullpath, path, plen) &&
+         (plen == pathlen || path[plen] == '/'))
+        return piter;
+    }
+
+  return NULL;
+}                               /* nfs_Get_export_by_path */
+
+/**
+ *
+ * nfs_Get_export_by_tag: Gets an export entry from its tag.
+ *
+ * @param exportroot [IN] the root for the export list
+ * @param tag        [IN] the tag of the entry to be found
+ *
+ * @return the export entry or NULL if failed.
+ *
+ */
+exportlist_t *nfs_Get_export_by_tag(exportlist_t * exportroot, char *tag)
+{
+  export_index_t *pindex = export_index;
+  export_index_slot_t *pslot = NULL;
+  exportlist_t *piter;
+
+  if(pindex != NULL && pindex->exportroot == exportroot)
+    {
+      pslot = export_index_find(pindex->by_tag, pindex->tag_mask, FALSE,
+                                tag, strnlen(tag, MAXPATHLEN));
+      return (pslot == NULL) ? NULL : pslot->pexport;
+    }
+
+  for(piter = exportroot; piter != NULL; piter = piter->next)
+    if(!strcmp(tag, piter->FS_tag))
+      return piter;
+
+  return NULL;
+}                               /* nfs_Get_export_by_tag */
+
 /**
  *
  * get_req_uid_gid: 
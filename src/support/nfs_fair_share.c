@@ -0,0 +1,676 @@
+/*
+ * vim:expandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * ---------------------------------------
+ */
+
+/**
+ * \file    nfs_fair_share.c
+ * \brief   Fair share of the workers between the clients and the exports.
+ *
+ * nfs_fair_share.c : Everything is under one mutex, held for a few list
+ * operations per request. A flow exists while it has requests queued. The
+ * state of a client is kept when it has no more flows, so that its rate
+ * bucket is not filled again between two requests, but only the
+ * NFS_FAIR_SHARE_IDLE_CLIENTS most recently idle clients are remembered.
+ * The states of the exports are kept, they hold the weights set from the
+ * export list. Freed flows and clients are kept aside for the next ones,
+ * nothing is given back to the allocator.
+ *
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#ifdef _SOLARIS
+#include "solaris_port.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "RW_Lock.h"
+#include "log_macros.h"
+#include "nfs_stat_registry.h"
+#include "nfs_fair_share.h"
+
+#define NFS_FAIR_SHARE_BUCKETS   61
+#define NFS_FAIR_SHARE_MAX_RATE_LIMIT  1000000
+
+/* A rate bucket counts in requests x ns per s: a request costs one second
+ * of tokens, and each ns of elapsed time brings rate tokens */
+#define NFS_FAIR_SHARE_COST      1000000000ULL
+
+typedef struct nfs_fair_share_bucket__
+{
+  unsigned int rate;            /* requests per second, 0 for no cap */
+  uint64_t tokens;
+  uint64_t last;                /* ns */
+} nfs_fair_share_bucket_t;
+
+typedef struct nfs_fair_share_export__
+{
+  struct nfs_fair_share_export__ *next;
+  int exportid;
+  unsigned int weight;
+  nfs_fair_share_bucket_t bucket;
+} nfs_fair_share_export_t;
+
+typedef struct nfs_fair_share_client__
+{
+  struct nfs_fair_share_client__ *next;
+  struct nfs_fair_share_client__ *idle_prev;   /* from the oldest idle client */
+  struct nfs_fair_share_client__ *idle_next;
+  sockaddr_t addr;
+  unsigned long hash;
+  unsigned int weight;
+  unsigned int nb_flows;
+  nfs_fair_share_bucket_t bucket;
+} nfs_fair_share_client_t;
+
+typedef struct nfs_fair_share_flow__
+{
+  struct nfs_fair_share_flow__ *next;   /* in its hash bucket */
+  struct nfs_fair_share_flow__ *next_active;    /* in the round */
+  nfs_fair_share_client_t *pclient;
+  nfs_fair_share_export_t *pexport;
+  unsigned int quantum;
+  unsigned int deficit;
+  unsigned int has_turn;        /* the quantum of the current turn was given */
+  nfs_fair_share_entry_t *head;
+  nfs_fair_share_entry_t *tail;
+} nfs_fair_share_flow_t;
+
+static nfs_fair_share_parameter_t nfs_fair_share_param;
+static pthread_mutex_t nfs_fair_share_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static nfs_fair_share_flow_t *nfs_fair_share_flows[NFS_FAIR_SHARE_BUCKETS];
+static nfs_fair_share_client_t *nfs_fair_share_clients[NFS_FAIR_SHARE_BUCKETS];
+static nfs_fair_share_export_t *nfs_fair_share_exports[NFS_FAIR_SHARE_BUCKETS];
+
+/* The round of the flows with requests queued */
+static nfs_fair_share_flow_t *nfs_fair_share_active_head = NULL;
+static nfs_fair_share_flow_t *nfs_fair_share_active_tail = NULL;
+
+static nfs_fair_share_flow_t *nfs_fair_share_free_flows = NULL;
+static nfs_fair_share_client_t *nfs_fair_share_free_clients = NULL;
+
+/* The clients without flows, the oldest one is forgotten first */
+static nfs_fair_share_client_t *nfs_fair_share_idle_head = NULL;
+static nfs_fair_share_client_t *nfs_fair_share_idle_tail = NULL;
+
+/* Read without the mutex by the workers looking for something to do */
+static volatile unsigned int nfs_fair_share_queued = 0;
+
+static nfs_fair_share_stats_t nfs_fair_share_stats;
+static int nfs_fair_share_histogram = -1;
+
+/**
+ *
+ * nfs_fair_share_init: sets the weights and caps of the clients, and
+ * registers the histogram of the time spent in the queue.
+ *
+ * Until it is called, or if pparam->enabled is FALSE, no request is queued
+ * (nfs_fair_share_enqueue returns NFS_FAIR_SHARE_DISABLED).
+ *
+ * @param pparam [IN] the weights and caps.
+ *
+ * @return NFS_FAIR_SHARE_SUCCESS, or -1 if a weight or a cap is out of range.
+ *
+ */
+int nfs_fair_share_init(nfs_fair_share_parameter_t * pparam)
+{
+  unsigned int i;
+
+  if(pparam->default_weight == 0 || pparam->default_weight > NFS_FAIR_SHARE_MAX_WEIGHT ||
+     pparam->default_max_rate > NFS_FAIR_SHARE_MAX_RATE_LIMIT ||
+     pparam->nb_clients > NFS_FAIR_SHARE_MAX_CLIENTS)
+    return -1;
+
+  for(i = 0; i < pparam->nb_clients; i++)
+    if(pparam->clients[i].weight == 0 ||
+       pparam->clients[i].weight > NFS_FAIR_SHARE_MAX_WEIGHT ||
+       pparam->clients[i].max_rate > NFS_FAIR_SHARE_MAX_RATE_LIMIT)
+      return -1;
+
+  nfs_fair_share_histogram = nfs_stat_register_histogram("fair_share.wait");
+
+  P(nfs_fair_share_mutex);
+  nfs_fair_share_param = *pparam;
+  V(nfs_fair_share_mutex);
+
+  return NFS_FAIR_SHARE_SUCCESS;
+}                               /* nfs_fair_share_init */
+
+/**
+ *
+ * nfs_fair_share_bucket_init: fills a rate bucket.
+ *
+ * @param pbucket [OUT] the bucket.
+ * @param rate    [IN]  requests per second, 0 for no cap.
+ * @param now     [IN]  current time, in ns.
+ *
+ * @return nothing (void function)
+ *
+ */
+static void nfs_fair_share_bucket_init(nfs_fair_share_bucket_t * pbucket,
+                                       unsigned int rate, uint64_t now)
+{
+  /* The burst is one second of requests */
+  pbucket->rate = rate;
+  pbucket->tokens = (uint64_t) rate * NFS_FAIR_SHARE_COST;
+  pbucket->last = now;
+}                               /* nfs_fair_share_bucket_init */
+
+/**
+ *
+ * nfs_fair_share_bucket_ready: refills a rate bucket, and tells if it has a
+ * request's worth of tokens.
+ *
+ * @param pbucket [INOUT] the bucket.
+ * @param now     [IN]    current time, in ns.
+ *
+ * @return 1 if a request may go, 0 otherwise.
+ *
+ */
+static int nfs_fair_share_bucket_ready(nfs_fair_share_bucket_t * pbucket, uint64_t now)
+{
+  uint64_t elapsed;
+
+  if(pbucket->rate == 0)
+    return 1;
+
+  if(now > pbucket->last)
+    {
+      /* A full bucket is one second of tokens, no need to count further */
+      elapsed = now - pbucket->last;
+      if(elapsed > NFS_FAIR_SHARE_COST)
+        elapsed = NFS_FAIR_SHARE_COST;
+
+      pbucket->tokens += elapsed * pbucket->rate;
+      if(pbucket->tokens > (uint64_t) pbucket->rate * NFS_FAIR_SHARE_COST)
+        pbucket->tokens = (uint64_t) pbucket->rate * NFS_FAIR_SHARE_COST;
+      pbucket->last = now;
+    }
+
+  return pbucket->tokens >= NFS_FAIR_SHARE_COST;
+}                               /* nfs_fair_share_bucket_ready */
+
+/**
+ *
+ * nfs_fair_share_get_export: finds or creates the state of an export.
+ * The mutex is held.
+ *
+ * @param exportid [IN] the export, -1 for the requests of no export.
+ *
+ * @return the state, NULL if it could not be allocated.
+ *
+ */
+static nfs_fair_share_export_t *nfs_fair_share_get_export(int exportid)
+{
+  unsigned int bucket = (unsigned int)(exportid + 1) % NFS_FAIR_SHARE_BUCKETS;
+  nfs_fair_share_export_t *pexport;
+
+  for(pexport = nfs_fair_share_exports[bucket]; pexport != NULL; pexport = pexport->next)
+    if(pexport->exportid == exportid)
+      return pexport;
+
+  /* Shared by every thread and never freed, not taken from a thread's pool */
+  if((pexport = (nfs_fair_share_export_t *) malloc(sizeof(nfs_fair_share_export_t))) == NULL)
+    return NULL;
+
+  pexport->exportid = exportid;
+  pexport->weight = NFS_FAIR_SHARE_WEIGHT;
+  nfs_fair_share_bucket_init(&pexport->bucket, NFS_FAIR_SHARE_MAX_RATE, nfs_stat_now());
+
+  pexport->next = nfs_fair_share_exports[bucket];
+  nfs_fair_share_exports[bucket] = pexport;
+
+  return pexport;
+}                               /* nfs_fair_share_get_export */
+
+/**
+ *
+ * nfs_fair_share_set_export: sets the weight and the cap of an export.
+ *
+ * The flows already queued keep the weight they were created with.
+ *
+ * @param exportid [IN] the export.
+ * @param weight   [IN] its weight, 0 for the default one.
+ * @param max_rate [IN] requests per second, 0 for no cap.
+ *
+ * @return NFS_FAIR_SHARE_SUCCESS, -1 if out of range, or NFS_FAIR_SHARE_MALLOC_ERROR.
+ *
+ */
+int nfs_fair_share_set_export(unsigned short exportid, unsigned int weight,
+                              unsigned int max_rate)
+{
+  nfs_fair_share_export_t *pexport;
+
+  if(weight == 0)
+    weight = NFS_FAIR_SHARE_WEIGHT;
+
+  if(weight > NFS_FAIR_SHARE_MAX_WEIGHT || max_rate > NFS_FAIR_SHARE_MAX_RATE_LIMIT)
+    return -1;
+
+  P(nfs_fair_share_mutex);
+
+  if((pexport = nfs_fair_share_get_export(exportid)) == NULL)
+    {
+      V(nfs_fair_share_mutex);
+      return NFS_FAIR_SHARE_MALLOC_ERROR;
+    }
+
+  pexport->weight = weight;
+  if(pexport->bucket.rate != max_rate)
+    nfs_fair_share_bucket_init(&pexport->bucket, max_rate, nfs_stat_now());
+
+  V(nfs_fair_share_mutex);
+
+  return NFS_FAIR_SHARE_SUCCESS;
+}                               /* nfs_fair_share_set_export */
+
+/**
+ *
+ * nfs_fair_share_client_busy: takes a client out of the idle clients, it is
+ * going to have a flow. The mutex is held.
+ *
+ * @param pclient [IN] the client.
+ *
+ * @return nothing (void function)
+ *
+ */
+static void nfs_fair_share_client_busy(nfs_fair_share_client_t * pclient)
+{
+  if(pclient->idle_prev != NULL)
+    pclient->idle_prev->idle_next = pclient->idle_next;
+  else
+    nfs_fair_share_idle_head = pclient->idle_next;
+
+  if(pclient->idle_next != NULL)
+    pclient->idle_next->idle_prev = pclient->idle_prev;
+  else
+    nfs_fair_share_idle_tail = pclient->idle_prev;
+
+  pclient->idle_prev = NULL;
+  pclient->idle_next = NULL;
+  nfs_fair_share_stats.nb_idle_clients -= 1;
+}                               /* nfs_fair_share_client_busy */
+
+/**
+ *
+ * nfs_fair_share_client_idle: keeps a client that has no more flows among
+ * the idle clients, and forgets the oldest idle client if there are too many
+ * of them. The mutex is held.
+ *
+ * @param pclient [IN] the client.
+ *
+ * @return nothing (void function)
+ *
+ */
+static void nfs_fair_share_client_idle(nfs_fair_share_client_t * pclient)
+{
+  nfs_fair_share_client_t **ppclient;
+
+  pclient->idle_next = NULL;
+  pclient->idle_prev = nfs_fair_share_idle_tail;
+  if(nfs_fair_share_idle_tail != NULL)
+    nfs_fair_share_idle_tail->idle_next = pclient;
+  else
+    nfs_fair_share_idle_head = pclient;
+  nfs_fair_share_idle_tail = pclient;
+  nfs_fair_share_stats.nb_idle_clients += 1;
+
+  if(nfs_fair_share_stats.nb_idle_clients <= NFS_FAIR_SHARE_IDLE_CLIENTS)
+    return;
+
+  pclient = nfs_fair_share_idle_head;
+  nfs_fair_share_client_busy(pclient);
+
+  ppclient = &nfs_fair_share_clients[pclient->hash % NFS_FAIR_SHARE_BUCKETS];
+  while(*ppclient != pclient)
+    ppclient = &(*ppclient)->next;
+  *ppclient = pclient->next;
+
+  pclient->next = nfs_fair_share_free_clients;
+  nfs_fair_share_free_clients = pclient;
+  nfs_fair_share_stats.nb_clients -= 1;
+}                               /* nfs_fair_share_client_idle */
+
+/**
+ *
+ * nfs_fair_share_get_client: finds or creates the state of a client.
+ * The mutex is held.
+ *
+ * @param paddr [IN] the address of the client, its port is ignored.
+ * @param now   [IN] current time, in ns.
+ *
+ * @return the state, NULL if it could not be allocated.
+ *
+ */
+static nfs_fair_share_client_t *nfs_fair_share_get_client(sockaddr_t * paddr, uint64_t now)
+{
+  unsigned long hash = hash_sockaddr(paddr, IGNORE_PORT);
+  unsigned int bucket = hash % NFS_FAIR_SHARE_BUCKETS;
+  nfs_fair_share_client_t *pclient;
+  unsigned int weight = nfs_fair_share_param.default_weight;
+  unsigned int max_rate = nfs_fair_share_param.default_max_rate;
+  unsigned int i;
+
+  for(pclient = nfs_fair_share_clients[bucket]; pclient != NULL; pclient = pclient->next)
+    if(pclient->hash == hash && cmp_sockaddr(&pclient->addr, paddr, IGNORE_PORT))
+      {
+        /* Its bucket is as it was left by its last requests */
+        if(pclient->nb_flows == 0)
+          nfs_fair_share_client_busy(pclient);
+        return pclient;
+      }
+
+  if(nfs_fair_share_free_clients != NULL)
+    {
+      pclient = nfs_fair_share_free_clients;
+      nfs_fair_share_free_clients = pclient->next;
+    }
+  else if((pclient = (nfs_fair_share_client_t *)
+           malloc(sizeof(nfs_fair_share_client_t))) == NULL)
+    return NULL;
+
+  for(i = 0; i < nfs_fair_share_param.nb_clients; i++)
+    if(cmp_sockaddr(&nfs_fair_share_param.clients[i].addr, paddr, IGNORE_PORT))
+      {
+        weight = nfs_fair_share_param.clients[i].weight;
+        max_rate = nfs_fair_share_param.clients[i].max_rate;
+        break;
+      }
+
+  memcpy(&pclient->addr, paddr, sizeof(sockaddr_t));
+  pclient->hash = hash;
+  pclient->weight = weight;
+  pclient->nb_flows = 0;
+  pclient->idle_prev = NULL;
+  pclient->idle_next = NULL;
+  nfs_fair_share_bucket_init(&pclient->bucket, max_rate, now);
+
+  pclient->next = nfs_fair_share_clients[bucket];
+  nfs_fair_share_clients[bucket] = pclient;
+  nfs_fair_share_stats.nb_clients += 1;
+
+  return pclient;
+}                               /* nfs_fair_share_get_client */
+
+/**
+ *
+ * nfs_fair_share_release_flow: forgets a flow that has no more requests,
+ * its client becomes idle if it was its last flow. The mutex is held.
+ *
+ * @param pflow [IN] the flow, already out of the round.
+ *
+ * @return nothing (void function)
+ *
+ */
+static void nfs_fair_share_release_flow(nfs_fair_share_flow_t * pflow)
+{
+  nfs_fair_share_client_t *pclient = pflow->pclient;
+  nfs_fair_share_flow_t **ppflow;
+
+  ppflow = &nfs_fair_share_flows[(pclient->hash + pflow->pexport->exportid + 1) %
+                                 NFS_FAIR_SHARE_BUCKETS];
+  while(*ppflow != pflow)
+    ppflow = &(*ppflow)->next;
+  *ppflow = pflow->next;
+
+  pflow->next = nfs_fair_share_free_flows;
+  nfs_fair_share_free_flows = pflow;
+  nfs_fair_share_stats.nb_flows -= 1;
+
+  pclient->nb_flows -= 1;
+  if(pclient->nb_flows == 0)
+    nfs_fair_share_client_idle(pclient);
+}                               /* nfs_fair_share_release_flow */
+
+/**
+ *
+ * nfs_fair_share_enqueue: queues a request in the flow of its client and export.
+ *
+ * @param pentry   [OUT] the link of the request, kept within the request.
+ * @param paddr    [IN]  the address of the client.
+ * @param exportid [IN]  the export of the request, -1 if it has none.
+ * @param data     [IN]  the request, returned by nfs_fair_share_dequeue.
+ *
+ * @return NFS_FAIR_SHARE_SUCCESS, NFS_FAIR_SHARE_DISABLED or
+ * NFS_FAIR_SHARE_MALLOC_ERROR if the request was not queued.
+ *
+ */
+int nfs_fair_share_enqueue(nfs_fair_share_entry_t * pentry, sockaddr_t * paddr,
+                           int exportid, void *data)
+{
+  nfs_fair_share_client_t *pclient;
+  nfs_fair_share_export_t *pexport;
+  nfs_fair_share_flow_t *pflow;
+  unsigned int bucket;
+  uint64_t now = nfs_stat_now();
+
+  pentry->next = NULL;
+  pentry->data = data;
+  pentry->enqueued = now;
+
+  if(exportid < 0)
+    exportid = -1;
+
+  P(nfs_fair_share_mutex);
+
+  if(!nfs_fair_share_param.enabled)
+    {
+      V(nfs_fair_share_mutex);
+      return NFS_FAIR_SHARE_DISABLED;
+    }
+
+  if((pexport = nfs_fair_share_get_export(exportid)) == NULL ||
+     (pclient = nfs_fair_share_get_client(paddr, now)) == NULL)
+    {
+      V(nfs_fair_share_mutex);
+      return NFS_FAIR_SHARE_MALLOC_ERROR;
+    }
+
+  bucket = (pclient->hash + exportid + 1) % NFS_FAIR_SHARE_BUCKETS;
+
+  for(pflow = nfs_fair_share_flows[bucket]; pflow != NULL; pflow = pflow->next)
+    if(pflow->pclient == pclient && pflow->pexport == pexport)
+      break;
+
+  if(pflow == NULL)
+    {
+      if(nfs_fair_share_free_flows != NULL)
+        {
+          pflow = nfs_fair_share_free_flows;
+          nfs_fair_share_free_flows = pflow->next;
+        }
+      else if((pflow = (nfs_fair_share_flow_t *)
+               malloc(sizeof(nfs_fair_share_flow_t))) == NULL)
+        {
+          /* Back with the idle clients */
+          if(pclient->nb_flows == 0)
+            nfs_fair_share_client_idle(pclient);
+          V(nfs_fair_share_mutex);
+          return NFS_FAIR_SHARE_MALLOC_ERROR;
+        }
+
+      memset(pflow, 0, sizeof(nfs_fair_share_flow_t));
+      pflow->pclient = pclient;
+      pflow->pexport = pexport;
+      pflow->quantum = pclient->weight * pexport->weight;
+      pclient->nb_flows += 1;
+      nfs_fair_share_stats.nb_flows += 1;
+
+      pflow->next = nfs_fair_share_flows[bucket];
+      nfs_fair_share_flows[bucket] = pflow;
+
+      /* A new flow waits for its turn behind the others */
+      if(nfs_fair_share_active_tail != NULL)
+        nfs_fair_share_active_tail->next_active = pflow;
+      else
+        nfs_fair_share_active_head = pflow;
+      nfs_fair_share_active_tail = pflow;
+    }
+
+  if(pflow->tail != NULL)
+    pflow->tail->next = pentry;
+  else
+    pflow->head = pentry;
+  pflow->tail = pentry;
+
+  nfs_fair_share_stats.nb_enqueued += 1;
+  __sync_fetch_and_add(&nfs_fair_share_queued, 1);
+
+  V(nfs_fair_share_mutex);
+
+  return NFS_FAIR_SHARE_SUCCESS;
+}                               /* nfs_fair_share_enqueue */
+
+/**
+ *
+ * nfs_fair_share_rotate: the flow at the head of the round goes to its tail.
+ * The mutex is held.
+ *
+ * @return nothing (void function)
+ *
+ */
+static void nfs_fair_share_rotate(void)
+{
+  nfs_fair_share_flow_t *pflow = nfs_fair_share_active_head;
+
+  if(pflow->next_active == NULL)
+    return;
+
+  nfs_fair_share_active_head = pflow->next_active;
+  pflow->next_active = NULL;
+  nfs_fair_share_active_tail->next_active = pflow;
+  nfs_fair_share_active_tail = pflow;
+}                               /* nfs_fair_share_rotate */
+
+/**
+ *
+ * nfs_fair_share_dequeue: takes the next request to be served.
+ *
+ * The flow at the head of the round is given its quantum when its turn
+ * starts, and is served until the quantum is used. A flow whose client or
+ * export is over its cap keeps its turn but goes behind the others, so that
+ * it does not bank quanta while it is held.
+ *
+ * @return the request, or NULL if none is queued or every queued request is
+ * held by a cap.
+ *
+ */
+void *nfs_fair_share_dequeue(void)
+{
+  nfs_fair_share_flow_t *pflow;
+  nfs_fair_share_entry_t *pentry;
+  unsigned int nb_visited;
+  uint64_t now;
+
+  if(nfs_fair_share_queued == 0)
+    return NULL;
+
+  P(nfs_fair_share_mutex);
+
+  now = nfs_stat_now();
+
+  for(nb_visited = 0; nb_visited < nfs_fair_share_stats.nb_flows; nb_visited++)
+    {
+      if((pflow = nfs_fair_share_active_head) == NULL)
+        break;
+
+      if(!pflow->has_turn)
+        {
+          pflow->deficit += pflow->quantum;
+          pflow->has_turn = 1;
+        }
+
+      if(!nfs_fair_share_bucket_ready(&pflow->pclient->bucket, now) ||
+         !nfs_fair_share_bucket_ready(&pflow->pexport->bucket, now))
+        {
+          nfs_fair_share_stats.nb_throttled += 1;
+          nfs_fair_share_rotate();
+          continue;
+        }
+
+      if(pflow->pclient->bucket.rate != 0)
+        pflow->pclient->bucket.tokens -= NFS_FAIR_SHARE_COST;
+      if(pflow->pexport->bucket.rate != 0)
+        pflow->pexport->bucket.tokens -= NFS_FAIR_SHARE_COST;
+
+      pentry = pflow->head;
+      pflow->head = pentry->next;
+      pflow->deficit -= 1;
+
+      if(pflow->head == NULL)
+        {
+          nfs_fair_share_active_head = pflow->next_active;
+          if(nfs_fair_share_active_head == NULL)
+            nfs_fair_share_active_tail = NULL;
+          nfs_fair_share_release_flow(pflow);
+        }
+      else if(pflow->deficit == 0)
+        {
+          pflow->has_turn = 0;
+          nfs_fair_share_rotate();
+        }
+
+      nfs_fair_share_stats.nb_dequeued += 1;
+      __sync_fetch_and_sub(&nfs_fair_share_queued, 1);
+
+      V(nfs_fair_share_mutex);
+
+      nfs_stat_histogram_record(nfs_fair_share_histogram, now - pentry->enqueued);
+
+      return pentry->data;
+    }
+
+  V(nfs_fair_share_mutex);
+
+  return NULL;
+}                               /* nfs_fair_share_dequeue */
+
+/**
+ *
+ * nfs_fair_share_length: number of requests queued, served or held.
+ *
+ * @return the number of requests.
+ *
+ */
+unsigned int nfs_fair_share_length(void)
+{
+  return nfs_fair_share_queued;
+}                               /* nfs_fair_share_length */
+
+/**
+ *
+ * nfs_fair_share_get_stats: gets the counters of the scheduler.
+ *
+ * @param pstats [OUT] the counters.
+ *
+ * @return nothing (void function)
+ *
+ */
+void nfs_fair_share_get_stats(nfs_fair_share_stats_t * pstats)
+{
+  P(nfs_fair_share_mutex);
+  *pstats = nfs_fair_share_stats;
+  pstats->nb_queued = nfs_fair_share_queued;
+  V(nfs_fair_share_mutex);
+}                               /* nfs_fair_share_get_stats */
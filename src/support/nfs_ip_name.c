@@ -53,10 +53,44 @@
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
+#include <errno.h>
+#include <pthread.h>
 
 /* Hashtable used to cache the hostname, accessed by their IP addess */
 hash_table_t *ht_ip_name;
 unsigned int expiration_time;
+unsigned int negative_expiration_time;
+
+/* Protects the cached entries, the hashtable only protects its own structure */
+static rw_lock_t ip_name_lock;
+
+/* FIFO ring of the dynamically cached addresses, used to bound the cache */
+static sockaddr_t *ip_name_fifo = NULL;
+static unsigned int ip_name_max_entries = 0;
+static unsigned int ip_name_fifo_head = 0;
+static unsigned int ip_name_fifo_count = 0;
+
+/* Addresses waiting for (or being resolved by) the resolver threads */
+#define IP_NAME_PENDING_FREE    0
+#define IP_NAME_PENDING_QUEUED  1
+#define IP_NAME_PENDING_RUNNING 2
+#define IP_NAME_PENDING_DONE    3
+
+typedef struct nfs_ip_name_pending__
+{
+  sockaddr_t ipaddr;
+  unsigned int state;
+  unsigned int waiters;
+  int rc;
+  char hostname[MAXHOSTNAMELEN];
+  pthread_cond_t cond_done;
+} nfs_ip_name_pending_t;
+
+static nfs_ip_name_pending_t ip_name_pending[IP_NAME_PENDING_SIZE];
+static pthread_mutex_t ip_name_pending_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t ip_name_pending_cond = PTHREAD_COND_INITIALIZER;
+static unsigned int ip_name_nb_resolvers = 0;
+static unsigned int ip_name_resolve_timeout = IP_NAME_RESOLVE_TIMEOUT;
 
 /**
  *
@@ -159,108 +193,408 @@ int display_ip_name_val(hash_buffer_t * pbuff, char *str)
 
 /**
  *
- * nfs_ip_name_add: adds an entry in the duplicate requests cache.
+ * nfs_ip_name_getnameinfo: default reverse lookup used by the IP/name cache.
  *
- * Adds an entry in the duplicate requests cache.
+ * Calls getnameinfo and warns if the DNS took too long to answer.
  *
- * @param ipaddr           [IN]    the ipaddr to be used as key
- * @param hostname         [IN]    the hostname added (found by using gethostbyaddr)
+ * @param ipaddr   [IN]  the address to resolve
+ * @param hostname [OUT] the name found
+ * @param len      [IN]  size of the hostname buffer
  *
- * @return IP_NAME_SUCCESS if successfull\n.
- * @return IP_NAME_INSERT_MALLOC_ERROR if an error occured during the insertion process \n
- * @return IP_NAME_NETDB_ERROR if an error occured during the netdb query (via gethostbyaddr).
+ * @return 0 if successful, a EAI_* error code otherwise.
  *
  */
+static int nfs_ip_name_getnameinfo(sockaddr_t *ipaddr, char *hostname, size_t len)
+{
+  struct timeval tv0, tv1, dur;
+  int rc;
+  char ipstring[SOCK_NAME_MAX];
 
-int nfs_ip_name_add(sockaddr_t *ipaddr, char *hostname)
+  gettimeofday(&tv0, NULL) ;
+  rc = getnameinfo((struct sockaddr *)ipaddr, sizeof(sockaddr_t),
+                   hostname, len, NULL, 0, 0);
+  gettimeofday(&tv1, NULL) ;
+  timersub(&tv1, &tv0, &dur) ;
+
+  /* display warning if DNS resolution took more that 1.0s */
+  if (dur.tv_sec >= 1)
+  {
+       sprint_sockaddr(ipaddr, ipstring, sizeof(ipstring));
+       LogEvent(COMPONENT_DISPATCH,
+                "Warning: long DNS query for %s: %u.%06u sec", ipstring,
+                (unsigned int)dur.tv_sec, (unsigned int)dur.tv_usec );
+  }
+
+  return rc;
+}                               /* nfs_ip_name_getnameinfo */
+
+static nfs_ip_name_resolver_t ip_name_resolver = nfs_ip_name_getnameinfo;
+
+/**
+ *
+ * nfs_ip_name_set_resolver: replaces the reverse lookup function.
+ *
+ * Replaces the function used to turn an address into a name. Passing NULL
+ * restores getnameinfo. Mostly useful to run the cache against a stub resolver.
+ *
+ * @param resolver [IN] the new reverse lookup function
+ *
+ * @return nothing (void function)
+ *
+ */
+void nfs_ip_name_set_resolver(nfs_ip_name_resolver_t resolver)
+{
+  ip_name_resolver = (resolver != NULL) ? resolver : nfs_ip_name_getnameinfo;
+}                               /* nfs_ip_name_set_resolver */
+
+/**
+ *
+ * nfs_ip_name_evict: makes room for a new dynamic entry.
+ *
+ * Dynamic entries are remembered in a FIFO ring of Max_Entries addresses.
+ * When the ring is full, the oldest address is dropped from the cache.
+ * Must be called with ip_name_lock held for writing.
+ *
+ * @param ipaddr [IN] the address about to be inserted
+ *
+ * @return nothing (void function)
+ *
+ */
+static void nfs_ip_name_evict(sockaddr_t *ipaddr)
+{
+  hash_buffer_t buffkey, old_key, old_value;
+
+  if(ip_name_fifo == NULL)
+    return;
+
+  if(ip_name_fifo_count == ip_name_max_entries)
+    {
+      buffkey.pdata = (caddr_t) &ip_name_fifo[ip_name_fifo_head];
+      buffkey.len = sizeof(sockaddr_t);
+
+      /* The address may already be gone if it was removed in the meantime */
+      if(HashTable_Del(ht_ip_name, &buffkey, &old_key, &old_value) == HASHTABLE_SUCCESS)
+        {
+          Mem_Free(old_key.pdata);
+          Mem_Free(old_value.pdata);
+        }
+
+      ip_name_fifo_head = (ip_name_fifo_head + 1) % ip_name_max_entries;
+      ip_name_fifo_count -= 1;
+    }
+
+  memcpy(&ip_name_fifo[(ip_name_fifo_head + ip_name_fifo_count) % ip_name_max_entries],
+         ipaddr, sizeof(sockaddr_t));
+  ip_name_fifo_count += 1;
+}                               /* nfs_ip_name_evict */
+
+/**
+ *
+ * nfs_ip_name_store: caches the result of a reverse lookup.
+ *
+ * Updates the cached entry in place if the address is already known,
+ * inserts a new one otherwise.
+ *
+ * @param ipaddr   [IN] the address used as key
+ * @param hostname [IN] the name found (ignored for negative entries)
+ * @param status   [IN] IP_NAME_ENTRY_POSITIVE, _NEGATIVE or _STATIC
+ *
+ * @return IP_NAME_SUCCESS or IP_NAME_INSERT_MALLOC_ERROR
+ *
+ */
+static int nfs_ip_name_store(sockaddr_t *ipaddr, char *hostname, unsigned int status)
 {
   hash_buffer_t buffkey;
   hash_buffer_t buffdata;
   nfs_ip_name_t *pnfs_ip_name = NULL;
   sockaddr_t *pipaddr = NULL;
-  struct timeval tv0, tv1, dur;
-  int rc;
-  char ipstring[SOCK_NAME_MAX];
 
-  pnfs_ip_name = (nfs_ip_name_t *) Mem_Alloc_Label(sizeof(nfs_ip_name_t), "nfs_ip_name_t");
+  buffkey.pdata = (caddr_t) ipaddr;
+  buffkey.len = sizeof(sockaddr_t);
 
-  if(pnfs_ip_name == NULL)
-    return IP_NAME_INSERT_MALLOC_ERROR;
+  P_w(&ip_name_lock);
+
+  if(HashTable_Get(ht_ip_name, &buffkey, &buffdata) == HASHTABLE_SUCCESS)
+    {
+      pnfs_ip_name = (nfs_ip_name_t *) buffdata.pdata;
+
+      /* A failed refresh does not hide a name we already know,
+       * and names from the map file are only replaced by the map file */
+      if((status != IP_NAME_ENTRY_NEGATIVE ||
+          pnfs_ip_name->status == IP_NAME_ENTRY_NEGATIVE) &&
+         (status == IP_NAME_ENTRY_STATIC ||
+          pnfs_ip_name->status != IP_NAME_ENTRY_STATIC))
+        {
+          if(status != IP_NAME_ENTRY_NEGATIVE)
+            strncpy(pnfs_ip_name->hostname, hostname, MAXHOSTNAMELEN);
+          pnfs_ip_name->status = status;
+        }
+      pnfs_ip_name->timestamp = time(NULL);
+      pnfs_ip_name->refreshing = FALSE;
+
+      V_w(&ip_name_lock);
+      return IP_NAME_SUCCESS;
+    }
 
+  pnfs_ip_name = (nfs_ip_name_t *) Mem_Alloc_Label(sizeof(nfs_ip_name_t), "nfs_ip_name_t");
   pipaddr = (sockaddr_t *) Mem_Alloc(sizeof(sockaddr_t));
-  if(pipaddr == NULL) 
+
+  if(pnfs_ip_name == NULL || pipaddr == NULL)
     {
-      Mem_Free(pnfs_ip_name);
+      V_w(&ip_name_lock);
+      if(pnfs_ip_name != NULL)
+        Mem_Free(pnfs_ip_name);
+      if(pipaddr != NULL)
+        Mem_Free(pipaddr);
       return IP_NAME_INSERT_MALLOC_ERROR;
     }
 
-  /* I have to keep an integer as key, I wil use the pointer buffkey->pdata for this, 
-   * this also means that buffkey->len will be 0 */
   memcpy(pipaddr, ipaddr, sizeof(sockaddr_t));
- 
+  pnfs_ip_name->timestamp = time(NULL);
+  pnfs_ip_name->status = status;
+  pnfs_ip_name->refreshing = FALSE;
+  if(status == IP_NAME_ENTRY_NEGATIVE)
+    pnfs_ip_name->hostname[0] = '\0';
+  else
+    strncpy(pnfs_ip_name->hostname, hostname, MAXHOSTNAMELEN);
+
+  /* Static entries come from the map file and are never evicted */
+  if(status != IP_NAME_ENTRY_STATIC)
+    nfs_ip_name_evict(pipaddr);
+
   buffkey.pdata = (caddr_t) pipaddr;
-  buffkey.len = sizeof(sockaddr_t);
+  buffdata.pdata = (caddr_t) pnfs_ip_name;
+  buffdata.len = sizeof(nfs_ip_name_t);
 
-  gettimeofday(&tv0, NULL) ;
-  rc = getnameinfo((struct sockaddr *)pipaddr, sizeof(sockaddr_t),
-                   pnfs_ip_name->hostname, sizeof(pnfs_ip_name->hostname),
-                   NULL, 0, 0);
-  gettimeofday(&tv1, NULL) ;
-  timersub(&tv1, &tv0, &dur) ;
+  if(HashTable_Test_And_Set(ht_ip_name, &buffkey, &buffdata,
+                            HASHTABLE_SET_HOW_SET_NO_OVERWRITE) != HASHTABLE_SUCCESS)
+    {
+      V_w(&ip_name_lock);
+      Mem_Free(pnfs_ip_name);
+      Mem_Free(pipaddr);
+      return IP_NAME_INSERT_MALLOC_ERROR;
+    }
 
+  V_w(&ip_name_lock);
+  return IP_NAME_SUCCESS;
+}                               /* nfs_ip_name_store */
 
-  sprint_sockaddr(pipaddr, ipstring, sizeof(ipstring));
+/**
+ *
+ * nfs_ip_name_lookup: resolves an address and caches the result.
+ *
+ * Runs the reverse lookup and stores a positive or a negative entry.
+ *
+ * @param ipaddr   [IN]  the address to resolve
+ * @param hostname [OUT] the name found
+ *
+ * @return IP_NAME_SUCCESS, IP_NAME_NETDB_ERROR or IP_NAME_INSERT_MALLOC_ERROR
+ *
+ */
+static int nfs_ip_name_lookup(sockaddr_t *ipaddr, char *hostname)
+{
+  char name[MAXHOSTNAMELEN];
+  char ipstring[SOCK_NAME_MAX];
+  int rc;
 
-  /* display warning if DNS resolution took more that 1.0s */
-  if (dur.tv_sec >= 1)
-  {
-       LogEvent(COMPONENT_DISPATCH,
-                "Warning: long DNS query for %s: %u.%06u sec", ipstring,
-                (unsigned int)dur.tv_sec, (unsigned int)dur.tv_usec );
-  }
+  rc = ip_name_resolver(ipaddr, name, sizeof(name));
 
+  sprint_sockaddr(ipaddr, ipstring, sizeof(ipstring));
 
-  /* Ask for the name to be cached */
   if(rc != 0)
     {
-       LogEvent(COMPONENT_DISPATCH,
-                "Cannot resolve address %s, error %s",
-                ipstring, gai_strerror(rc));
+      LogEvent(COMPONENT_DISPATCH,
+               "Cannot resolve address %s, error %s",
+               ipstring, gai_strerror(rc));
 
-       Mem_Free(pnfs_ip_name);
-       Mem_Free(pipaddr);
-       return IP_NAME_NETDB_ERROR;
+      /* Remember the failure so that the DNS is not asked again on every request */
+      nfs_ip_name_store(ipaddr, NULL, IP_NAME_ENTRY_NEGATIVE);
+      return IP_NAME_NETDB_ERROR;
     }
 
   LogDebug(COMPONENT_DISPATCH,
            "Inserting %s->%s to addr cache",
-           ipstring, pnfs_ip_name->hostname);
-
-  /* I build the data with the request pointer that should be in state 'IN USE' */
-  pnfs_ip_name->timestamp = time(NULL);
+           ipstring, name);
 
-  buffdata.pdata = (caddr_t) pnfs_ip_name;
-  buffdata.len = sizeof(nfs_ip_name_t);
-
-  if(HashTable_Set(ht_ip_name, &buffkey, &buffdata) != HASHTABLE_SUCCESS)
+  if(nfs_ip_name_store(ipaddr, name, IP_NAME_ENTRY_POSITIVE) != IP_NAME_SUCCESS)
     return IP_NAME_INSERT_MALLOC_ERROR;
 
   /* Copy the value for the caller */
-  strncpy(hostname, pnfs_ip_name->hostname, MAXHOSTNAMELEN);
+  strncpy(hostname, name, MAXHOSTNAMELEN);
 
   return IP_NAME_SUCCESS;
+}                               /* nfs_ip_name_lookup */
+
+/**
+ *
+ * nfs_ip_name_add: adds an entry in the IP/name cache.
+ *
+ * Resolves the address synchronously and caches the result, a failure
+ * is cached as a negative entry.
+ *
+ * @param ipaddr           [IN]    the ipaddr to be used as key
+ * @param hostname         [OUT]   the hostname added (found by using getnameinfo)
+ *
+ * @return IP_NAME_SUCCESS if successfull\n.
+ * @return IP_NAME_INSERT_MALLOC_ERROR if an error occured during the insertion process \n
+ * @return IP_NAME_NETDB_ERROR if an error occured during the netdb query (via getnameinfo).
+ *
+ */
+int nfs_ip_name_add(sockaddr_t *ipaddr, char *hostname)
+{
+  return nfs_ip_name_lookup(ipaddr, hostname);
 }                               /* nfs_ip_name_add */
 
+/**
+ *
+ * nfs_ip_name_enqueue: asks the resolver threads to resolve an address.
+ *
+ * Requests for an address that is already queued or being resolved are
+ * coalesced into the pending slot. Must be called with ip_name_pending_mutex held.
+ *
+ * @param ipaddr [IN] the address to resolve
+ *
+ * @return the pending slot, or NULL if there is no resolver thread or no free slot.
+ *
+ */
+static nfs_ip_name_pending_t *nfs_ip_name_enqueue(sockaddr_t *ipaddr)
+{
+  nfs_ip_name_pending_t *pfree = NULL;
+  int i;
+
+  if(ip_name_nb_resolvers == 0)
+    return NULL;
+
+  for(i = 0; i < IP_NAME_PENDING_SIZE; i++)
+    {
+      if(ip_name_pending[i].state == IP_NAME_PENDING_FREE)
+        {
+          if(pfree == NULL)
+            pfree = &ip_name_pending[i];
+        }
+      else if(ip_name_pending[i].state != IP_NAME_PENDING_DONE &&
+              cmp_sockaddr(&ip_name_pending[i].ipaddr, ipaddr, IGNORE_PORT))
+        return &ip_name_pending[i];
+    }
+
+  if(pfree == NULL)
+    return NULL;
+
+  memcpy(&pfree->ipaddr, ipaddr, sizeof(sockaddr_t));
+  pfree->state = IP_NAME_PENDING_QUEUED;
+  pfree->waiters = 0;
+  pfree->rc = IP_NAME_NOT_FOUND;
+  pfree->hostname[0] = '\0';
+
+  pthread_cond_signal(&ip_name_pending_cond);
+
+  return pfree;
+}                               /* nfs_ip_name_enqueue */
+
+/**
+ *
+ * nfs_ip_name_resolver_thread: body of the resolver threads.
+ *
+ * Picks queued addresses, resolves them, caches the result and wakes up
+ * the workers waiting for it.
+ *
+ * @param arg [IN] unused
+ *
+ * @return NULL, never returns.
+ *
+ */
+static void *nfs_ip_name_resolver_thread(void *arg)
+{
+  nfs_ip_name_pending_t *ppending;
+  sockaddr_t ipaddr;
+  char hostname[MAXHOSTNAMELEN];
+  int rc;
+  int i;
+
+  SetNameFunction("ip_name_resolver");
+
+#ifndef _NO_BUDDY_SYSTEM
+  /* The results are cached with Mem_Alloc, as a worker would do */
+  if(BuddyInit(&nfs_param.buddy_param_worker) != BUDDY_SUCCESS)
+    LogFatal(COMPONENT_DISPATCH,
+             "IP/name resolver thread: Memory manager could not be initialized");
+#endif
+
+  P(ip_name_pending_mutex);
+
+  while(1)
+    {
+      ppending = NULL;
+      for(i = 0; i < IP_NAME_PENDING_SIZE; i++)
+        if(ip_name_pending[i].state == IP_NAME_PENDING_QUEUED)
+          {
+            ppending = &ip_name_pending[i];
+            break;
+          }
+
+      if(ppending == NULL)
+        {
+          pthread_cond_wait(&ip_name_pending_cond, &ip_name_pending_mutex);
+          continue;
+        }
+
+      ppending->state = IP_NAME_PENDING_RUNNING;
+      memcpy(&ipaddr, &ppending->ipaddr, sizeof(sockaddr_t));
+
+      V(ip_name_pending_mutex);
+
+      hostname[0] = '\0';
+      rc = nfs_ip_name_lookup(&ipaddr, hostname);
+
+      P(ip_name_pending_mutex);
+
+      ppending->rc = rc;
+      strncpy(ppending->hostname, hostname, MAXHOSTNAMELEN);
+
+      /* The last waiter releases the slot, or we do if nobody is waiting */
+      if(ppending->waiters == 0)
+        ppending->state = IP_NAME_PENDING_FREE;
+      else
+        {
+          ppending->state = IP_NAME_PENDING_DONE;
+          pthread_cond_broadcast(&ppending->cond_done);
+        }
+    }
+
+  V(ip_name_pending_mutex);
+  return NULL;
+}                               /* nfs_ip_name_resolver_thread */
+
+/**
+ *
+ * nfs_ip_name_refresh: refreshes a cached entry in the background.
+ *
+ * @param ipaddr [IN] the address to refresh
+ *
+ * @return nothing (void function)
+ *
+ */
+static void nfs_ip_name_refresh(sockaddr_t *ipaddr)
+{
+  P(ip_name_pending_mutex);
+  nfs_ip_name_enqueue(ipaddr);
+  V(ip_name_pending_mutex);
+}                               /* nfs_ip_name_refresh */
+
 /**
  *
  * nfs_ip_name_get: Tries to get an entry for ip_name cache.
  *
- * Tries to get an entry for ip_name cache.
+ * Tries to get an entry for ip_name cache. Positive entries that are close
+ * to their expiration are refreshed in the background, expired entries are
+ * reported as not found.
  * 
  * @param ipaddr   [IN]  the ip address requested
  * @param hostname [OUT] the hostname
  *
- * @return the result previously set if *pstatus == IP_NAME_SUCCESS
+ * @return IP_NAME_SUCCESS if a name is known for the address
+ * @return IP_NAME_NETDB_ERROR if the address recently failed to resolve
+ * @return IP_NAME_NOT_FOUND if the address is not cached or has expired
  *
  */
 int nfs_ip_name_get(sockaddr_t *ipaddr, char *hostname)
@@ -269,31 +603,140 @@ int nfs_ip_name_get(sockaddr_t *ipaddr, char *hostname)
   hash_buffer_t buffval;
   nfs_ip_name_t *pnfs_ip_name;
   char ipstring[SOCK_NAME_MAX];
+  time_t age;
+  int refresh = FALSE;
+  int rc;
 
   sprint_sockaddr(ipaddr, ipstring, sizeof(ipstring));
 
   buffkey.pdata = (caddr_t) ipaddr;
   buffkey.len = sizeof(sockaddr_t);
 
-  if(HashTable_Get(ht_ip_name, &buffkey, &buffval) == HASHTABLE_SUCCESS)
+  P_r(&ip_name_lock);
+
+  if(HashTable_Get(ht_ip_name, &buffkey, &buffval) != HASHTABLE_SUCCESS)
     {
-      pnfs_ip_name = (nfs_ip_name_t *) buffval.pdata;
-      strncpy(hostname, pnfs_ip_name->hostname, MAXHOSTNAMELEN);
+      V_r(&ip_name_lock);
 
       LogFullDebug(COMPONENT_DISPATCH,
-                   "Cache get hit for %s->%s",
-                   ipstring, pnfs_ip_name->hostname);
+                   "Cache get miss for %s",
+                   ipstring);
 
-      return IP_NAME_SUCCESS;
+      return IP_NAME_NOT_FOUND;
+    }
+
+  pnfs_ip_name = (nfs_ip_name_t *) buffval.pdata;
+  age = time(NULL) - pnfs_ip_name->timestamp;
+
+  switch (pnfs_ip_name->status)
+    {
+    case IP_NAME_ENTRY_STATIC:
+      strncpy(hostname, pnfs_ip_name->hostname, MAXHOSTNAMELEN);
+      rc = IP_NAME_SUCCESS;
+      break;
+
+    case IP_NAME_ENTRY_NEGATIVE:
+      rc = (age < negative_expiration_time) ? IP_NAME_NETDB_ERROR : IP_NAME_NOT_FOUND;
+      break;
+
+    default:
+      if(age >= expiration_time)
+        {
+          rc = IP_NAME_NOT_FOUND;
+          break;
+        }
+
+      strncpy(hostname, pnfs_ip_name->hostname, MAXHOSTNAMELEN);
+      rc = IP_NAME_SUCCESS;
+
+      /* Refresh ahead once three quarters of the lifetime are gone */
+      if(age >= expiration_time - expiration_time / 4 &&
+         __sync_bool_compare_and_swap(&pnfs_ip_name->refreshing, FALSE, TRUE))
+        refresh = TRUE;
+      break;
     }
 
+  V_r(&ip_name_lock);
+
   LogFullDebug(COMPONENT_DISPATCH,
-               "Cache get miss for %s",
-               ipstring);
+               "Cache get %s for %s (age %u)",
+               rc == IP_NAME_SUCCESS ? "hit" :
+               rc == IP_NAME_NETDB_ERROR ? "negative hit" : "expired",
+               ipstring, (unsigned int)age);
 
-  return IP_NAME_NOT_FOUND;
+  if(refresh)
+    nfs_ip_name_refresh(ipaddr);
+
+  return rc;
 }                               /* nfs_ip_name_get */
 
+/**
+ *
+ * nfs_ip_name_resolve: gets the name of an address, resolving it if needed.
+ *
+ * Looks the address up in the cache. On a miss, the resolution is handed to
+ * the resolver threads, concurrent requests for the same address share it,
+ * and the caller waits at most Resolve_Timeout seconds for the answer. If no
+ * resolver thread can take the request, the address is resolved in place.
+ *
+ * @param ipaddr   [IN]  the ip address requested
+ * @param hostname [OUT] the hostname
+ *
+ * @return IP_NAME_SUCCESS if a name is known for the address
+ * @return IP_NAME_NETDB_ERROR if the address could not be resolved
+ * @return IP_NAME_NOT_FOUND if the resolution did not complete in time
+ *
+ */
+int nfs_ip_name_resolve(sockaddr_t *ipaddr, char *hostname)
+{
+  nfs_ip_name_pending_t *ppending;
+  struct timespec timeout;
+  int rc;
+
+  if((rc = nfs_ip_name_get(ipaddr, hostname)) != IP_NAME_NOT_FOUND)
+    return rc;
+
+  P(ip_name_pending_mutex);
+
+  if((ppending = nfs_ip_name_enqueue(ipaddr)) == NULL)
+    {
+      V(ip_name_pending_mutex);
+      return nfs_ip_name_lookup(ipaddr, hostname);
+    }
+
+  ppending->waiters += 1;
+
+  timeout.tv_sec = time(NULL) + ip_name_resolve_timeout;
+  timeout.tv_nsec = 0;
+
+  while(ppending->state != IP_NAME_PENDING_DONE)
+    if(pthread_cond_timedwait(&ppending->cond_done, &ip_name_pending_mutex,
+                              &timeout) == ETIMEDOUT)
+      break;
+
+  if(ppending->state == IP_NAME_PENDING_DONE)
+    {
+      rc = ppending->rc;
+      if(rc == IP_NAME_SUCCESS)
+        strncpy(hostname, ppending->hostname, MAXHOSTNAMELEN);
+    }
+  else
+    {
+      rc = IP_NAME_NOT_FOUND;
+      LogEvent(COMPONENT_DISPATCH,
+               "DNS resolution did not complete within %u sec",
+               ip_name_resolve_timeout);
+    }
+
+  ppending->waiters -= 1;
+  if(ppending->waiters == 0 && ppending->state == IP_NAME_PENDING_DONE)
+    ppending->state = IP_NAME_PENDING_FREE;
+
+  V(ip_name_pending_mutex);
+
+  return rc;
+}                               /* nfs_ip_name_resolve */
+
 /**
  *
  * nfs_ip_name_remove: Tries to remove an entry for ip_name cache
@@ -307,7 +750,7 @@ int nfs_ip_name_get(sockaddr_t *ipaddr, char *hostname)
  */
 int nfs_ip_name_remove(sockaddr_t *ipaddr)
 {
-  hash_buffer_t buffkey, old_value;
+  hash_buffer_t buffkey, old_key, old_value;
   nfs_ip_name_t *pnfs_ip_name = NULL;
   char ipstring[SOCK_NAME_MAX];
 
@@ -316,18 +759,25 @@ int nfs_ip_name_remove(sockaddr_t *ipaddr)
   buffkey.pdata = (caddr_t) ipaddr;
   buffkey.len = sizeof(sockaddr_t);
 
-  if(HashTable_Del(ht_ip_name, &buffkey, NULL, &old_value) == HASHTABLE_SUCCESS)
+  P_w(&ip_name_lock);
+
+  if(HashTable_Del(ht_ip_name, &buffkey, &old_key, &old_value) == HASHTABLE_SUCCESS)
     {
+      V_w(&ip_name_lock);
+
       pnfs_ip_name = (nfs_ip_name_t *) old_value.pdata;
 
       LogFullDebug(COMPONENT_DISPATCH,
                    "Cache remove hit for %s->%s",
                    ipstring, pnfs_ip_name->hostname);
 
+      Mem_Free(old_key.pdata);
       Mem_Free((void *)pnfs_ip_name);
       return IP_NAME_SUCCESS;
     }
 
+  V_w(&ip_name_lock);
+
   LogFullDebug(COMPONENT_DISPATCH,
                "Cache remove miss for %s",
                ipstring);
@@ -348,14 +798,65 @@ int nfs_ip_name_remove(sockaddr_t *ipaddr)
  */
 int nfs_Init_ip_name(nfs_ip_name_parameter_t param)
 {
+  pthread_attr_t attr_thr;
+  pthread_t thrid;
+  unsigned int i;
+
   if((ht_ip_name = HashTable_Init(param.hash_param)) == NULL)
     {
       LogCrit(COMPONENT_INIT, "NFS IP_NAME: Cannot init IP/name cache");
       return -1;
     }
 
-  /* Set the expiration time */
+  if(rw_lock_init(&ip_name_lock) != 0)
+    {
+      LogCrit(COMPONENT_INIT, "NFS IP_NAME: Cannot init IP/name cache lock");
+      return -1;
+    }
+
+  /* Set the expiration times */
   expiration_time = param.expiration_time;
+  negative_expiration_time = param.negative_expiration_time;
+  ip_name_resolve_timeout = param.resolve_timeout;
+
+  /* Bound the number of dynamic entries, 0 means unbounded */
+  if(param.max_entries != 0)
+    {
+      ip_name_fifo = (sockaddr_t *) Mem_Alloc_Label(param.max_entries * sizeof(sockaddr_t),
+                                                    "ip_name_fifo");
+      if(ip_name_fifo == NULL)
+        {
+          LogCrit(COMPONENT_INIT, "NFS IP_NAME: Cannot allocate IP/name FIFO");
+          return -1;
+        }
+      ip_name_max_entries = param.max_entries;
+    }
+
+  for(i = 0; i < IP_NAME_PENDING_SIZE; i++)
+    {
+      ip_name_pending[i].state = IP_NAME_PENDING_FREE;
+      pthread_cond_init(&ip_name_pending[i].cond_done, NULL);
+    }
+
+  /* Start the resolver threads, without them names are resolved by the workers */
+  pthread_attr_init(&attr_thr);
+  pthread_attr_setscope(&attr_thr, PTHREAD_SCOPE_SYSTEM);
+  pthread_attr_setdetachstate(&attr_thr, PTHREAD_CREATE_DETACHED);
+
+  for(i = 0; i < param.resolver_threads; i++)
+    {
+      if(pthread_create(&thrid, &attr_thr, nfs_ip_name_resolver_thread, NULL) != 0)
+        {
+          LogCrit(COMPONENT_INIT,
+                  "NFS IP_NAME: Cannot create resolver thread #%u", i);
+          break;
+        }
+      ip_name_nb_resolvers += 1;
+    }
+
+  LogInfo(COMPONENT_INIT,
+          "NFS IP_NAME: %u resolver threads, cache bounded to %u entries",
+          ip_name_nb_resolvers, ip_name_max_entries);
 
   return IP_NAME_SUCCESS;
 }                               /* nfs_Init_ip_name */
@@ -371,10 +872,6 @@ int nfs_ip_name_populate(char *path)
   char *key_value;
   char label[MAXNAMLEN];
   sockaddr_t ipaddr;
-  nfs_ip_name_t *pnfs_ip_name;
-  sockaddr_t *pipaddr;
-  hash_buffer_t buffkey;
-  hash_buffer_t buffdata;
 
   config_file = config_ParseFile(path);
 
@@ -425,34 +922,9 @@ int nfs_ip_name_populate(char *path)
           return IP_NAME_NOT_FOUND;
         }
 
-      /* Entry to be cached */
-      pnfs_ip_name = (nfs_ip_name_t *) Mem_Alloc(sizeof(nfs_ip_name_t));
-      if(pnfs_ip_name == NULL)
+      /* Entries from the map file never expire */
+      if(nfs_ip_name_store(&ipaddr, key_name, IP_NAME_ENTRY_STATIC) != IP_NAME_SUCCESS)
         return IP_NAME_INSERT_MALLOC_ERROR;
-
-      pipaddr = (sockaddr_t *) Mem_Alloc(sizeof(sockaddr_t));
-      if(pipaddr == NULL)
-        {
-          Mem_Free(pnfs_ip_name);
-          return IP_NAME_INSERT_MALLOC_ERROR;
-        }
-
-      strncpy(pnfs_ip_name->hostname, key_name, MAXHOSTNAMELEN);
-      pnfs_ip_name->timestamp = time(NULL);
-      memcpy(pipaddr, &ipaddr, sizeof(sockaddr_t));
-
-      buffdata.pdata = (caddr_t) pnfs_ip_name;
-      buffdata.len = sizeof(nfs_ip_name_t);
-
-      buffkey.pdata = (caddr_t) pipaddr;
-      buffkey.len = sizeof(sockaddr_t);
-
-      if(HashTable_Set(ht_ip_name, &buffkey, &buffdata) != HASHTABLE_SUCCESS)
-        {
-          Mem_Free(pnfs_ip_name);
-          Mem_Free(pipaddr);
-          return IP_NAME_INSERT_MALLOC_ERROR;
-        }
     }
 
   if(isFullDebug(COMPONENT_CONFIG))
@@ -171,7 +171,9 @@ int nfs_read_worker_conf(config_file_t in_config, nfs_worker_parameter_t * ppara
         }
       else if(!strcasecmp(key_name, "Nb_DupReq_Prealloc"))
         {
-          pparam->nb_dupreq_prealloc = atoi(key_value);
+          LogWarn(COMPONENT_CONFIG,
+                  "Key %s (item %s) is no longer used, see Prealloc_Node_Pool_Size in %s",
+                  key_name, CONF_LABEL_NFS_WORKER, CONF_LABEL_NFS_DUPREQ);
         }
       else if(!strcasecmp(key_name, "Nb_DupReq_Before_GC"))
         {
@@ -185,13 +187,21 @@ int nfs_read_worker_conf(config_file_t in_config, nfs_worker_parameter_t * ppara
         {
           pparam->nb_ip_stats_prealloc = atoi(key_value);
         }
+      else if(!strcasecmp(key_name, "Pending_Queue_Size"))
+        {
+          pparam->pending_queue_size = atoi(key_value);
+        }
       else if(!strcasecmp(key_name, "LRU_Pending_Job_Prealloc_PoolSize"))
         {
-          pparam->lru_param.nb_entry_prealloc = atoi(key_value);
+          LogWarn(COMPONENT_CONFIG,
+                  "Key %s (item %s) is no longer used, see Pending_Queue_Size",
+                  key_name, CONF_LABEL_NFS_WORKER);
         }
       else if(!strcasecmp(key_name, "LRU_DupReq_Prealloc_PoolSize"))
         {
-          pparam->lru_dupreq.nb_entry_prealloc = atoi(key_value);
+          LogWarn(COMPONENT_CONFIG,
+                  "Key %s (item %s) is no longer used",
+                  key_name, CONF_LABEL_NFS_WORKER);
         }
       else
         {
@@ -269,18 +279,28 @@ int nfs_read_core_conf(config_file_t in_config, nfs_core_parameter_t * pparam)
         {
           pparam->nb_worker = atoi(key_value);
         }
+      else if(!strcasecmp(key_name, "Nb_Dispatcher"))
+        {
+          pparam->nb_dispatcher = atoi(key_value);
+        }
       else if(!strcasecmp(key_name, "Nb_Call_Before_Queue_Avg"))
         {
           pparam->nb_call_before_queue_avg = atoi(key_value);
         }
       else if(!strcasecmp(key_name, "Nb_MaxConcurrentGC"))
         {
-          pparam->nb_max_concurrent_gc = atoi(key_value);
+          LogWarn(COMPONENT_CONFIG,
+                  "Key %s (item %s) is no longer used, cache inode gc is done by the reaper thread",
+                  key_name, CONF_LABEL_NFS_CORE);
         }
       else if(!strcasecmp(key_name, "DupReq_Expiration"))
         {
           pparam->expiration_dupreq = atoi(key_value);
         }
+      else if(!strcasecmp(key_name, "Async_Logging"))
+        {
+          pparam->async_logging = StrToBoolean(key_value);
+        }
       else if(!strcasecmp(key_name, "Drop_IO_Errors"))
         {
           pparam->drop_io_errors = StrToBoolean(key_value);
@@ -426,6 +446,26 @@ int nfs_read_core_conf(config_file_t in_config, nfs_core_parameter_t * pparam)
         {
           pparam->nb_max_fd = atoi(key_value);
         }
+      else if(!strcasecmp(key_name, "Max_Conn_Requests"))
+        {
+          pparam->max_conn_requests = atoi(key_value);
+        }
+      else if(!strcasecmp(key_name, "FSAL_Admission"))
+        {
+          pparam->fsal_admission.enabled = StrToBoolean(key_value);
+        }
+      else if(!strcasecmp(key_name, "FSAL_Min_Calls"))
+        {
+          pparam->fsal_admission.min_window = atoi(key_value);
+        }
+      else if(!strcasecmp(key_name, "FSAL_Max_Calls"))
+        {
+          pparam->fsal_admission.max_window = atoi(key_value);
+        }
+      else if(!strcasecmp(key_name, "FSAL_Latency_Tolerance"))
+        {
+          pparam->fsal_admission.tolerance = atoi(key_value);
+        }
       else if(!strcasecmp(key_name, "Stats_File_Path"))
         {
           strncpy(pparam->stats_file_path, key_value, MAXPATHLEN);
@@ -553,6 +593,16 @@ int nfs_read_dupreq_hash_conf(config_file_t in_config,
         {
           pparam->hash_param.nb_node_prealloc = atoi(key_value);
         }
+      else if(!strcasecmp(key_name, "Hash_Engine"))
+        {
+          LogWarn(COMPONENT_CONFIG,
+                  "Key %s (item %s) is no longer used, the cache has its own partitions",
+                  key_name, CONF_LABEL_NFS_DUPREQ);
+        }
+      else if(!strcasecmp(key_name, "TCP_Window"))
+        {
+          pparam->tcp_window = atoi(key_value);
+        }
       else
         {
           LogCrit(COMPONENT_CONFIG,
@@ -584,6 +634,7 @@ int nfs_read_ip_name_conf(config_file_t in_config, nfs_ip_name_parameter_t * ppa
   int err;
   char *key_name;
   char *key_value;
+  int engine;
   config_item_t block;
 
   /* Is the config tree initialized ? */
@@ -634,10 +685,37 @@ int nfs_read_ip_name_conf(config_file_t in_config, nfs_ip_name_parameter_t * ppa
         {
           pparam->hash_param.nb_node_prealloc = atoi(key_value);
         }
+      else if(!strcasecmp(key_name, "Hash_Engine"))
+        {
+          if((engine = HashTable_EngineFromStr(key_value)) < 0)
+            {
+              LogCrit(COMPONENT_CONFIG,
+                      "Invalid hash engine %s (item %s), expected RBT or Open_Addressing",
+                      key_value, CONF_LABEL_NFS_IP_NAME);
+              return -1;
+            }
+          pparam->hash_param.engine = engine;
+        }
       else if(!strcasecmp(key_name, "Expiration_Time"))
         {
           pparam->expiration_time = atoi(key_value);
         }
+      else if(!strcasecmp(key_name, "Negative_Expiration_Time"))
+        {
+          pparam->negative_expiration_time = atoi(key_value);
+        }
+      else if(!strcasecmp(key_name, "Resolver_Threads"))
+        {
+          pparam->resolver_threads = atoi(key_value);
+        }
+      else if(!strcasecmp(key_name, "Resolve_Timeout"))
+        {
+          pparam->resolve_timeout = atoi(key_value);
+        }
+      else if(!strcasecmp(key_name, "Max_Entries"))
+        {
+          pparam->max_entries = atoi(key_value);
+        }
       else if(!strcasecmp(key_name, "Map"))
         {
           strncpy(pparam->mapfile, key_value, MAXPATHLEN);
@@ -654,6 +732,161 @@ int nfs_read_ip_name_conf(config_file_t in_config, nfs_ip_name_parameter_t * ppa
   return 0;
 }                               /* nfs_read_ip_name_conf */
 
+/**
+ *
+ * nfs_read_fair_share_client: parses the weight and cap of a client,
+ * "address,weight[,max_rate]".
+ *
+ * @param value     [IN]  the value of the Client key
+ * @param pclient   [OUT] the client
+ * @param prate_set [OUT] TRUE if the cap was given
+ *
+ * @return 0 if ok, -1 if not.
+ *
+ */
+static int nfs_read_fair_share_client(char *value, nfs_fair_share_client_param_t * pclient,
+                                      int *prate_set)
+{
+  char addr[SOCK_NAME_MAX];
+  char *comma;
+  char *end_ptr;
+  unsigned long weight;
+  unsigned long max_rate = 0;
+
+  if((comma = strchr(value, ',')) == NULL || comma - value >= SOCK_NAME_MAX)
+    return -1;
+
+  strncpy(addr, value, comma - value);
+  addr[comma - value] = '\0';
+  if(ipstring_to_sockaddr(addr, &pclient->addr) != 0)
+    return -1;
+
+  weight = strtoul(comma + 1, &end_ptr, 10);
+  if(end_ptr == comma + 1 || (*end_ptr != '\0' && *end_ptr != ','))
+    return -1;
+
+  if(*end_ptr == ',')
+    {
+      comma = end_ptr;
+      max_rate = strtoul(comma + 1, &end_ptr, 10);
+      if(end_ptr == comma + 1 || *end_ptr != '\0')
+        return -1;
+    }
+
+  *prate_set = (comma != strchr(value, ','));
+  pclient->weight = weight;
+  pclient->max_rate = max_rate;
+
+  return 0;
+}                               /* nfs_read_fair_share_client */
+
+/**
+ *
+ * nfs_read_fair_share_conf: reads the configuration of the fair share of
+ * the workers between the clients.
+ *
+ * @param in_config [IN] configuration file handle
+ * @param pparam [OUT] read parameters
+ *
+ * @return 0 if ok,  -1 if not, 1 is stanza is not there.
+ *
+ */
+int nfs_read_fair_share_conf(config_file_t in_config, nfs_fair_share_parameter_t * pparam)
+{
+  int var_max;
+  int var_index;
+  int err;
+  char *key_name;
+  char *key_value;
+  config_item_t block;
+  int rate_set[NFS_FAIR_SHARE_MAX_CLIENTS];
+  unsigned int i;
+
+  /* Is the config tree initialized ? */
+  if(in_config == NULL || pparam == NULL)
+    return -1;
+
+  /* Get the config BLOCK */
+  if((block = config_FindItemByName(in_config, CONF_LABEL_NFS_FAIR_SHARE)) == NULL)
+    {
+      LogDebug(COMPONENT_CONFIG,
+               "Cannot read item \"%s\" from configuration file", CONF_LABEL_NFS_FAIR_SHARE);
+      return 1;
+    }
+  else if(config_ItemType(block) != CONFIG_ITEM_BLOCK)
+    {
+      /* Expected to be a block */
+      LogDebug(COMPONENT_CONFIG,
+               "Item \"%s\" is expected to be a block", CONF_LABEL_NFS_FAIR_SHARE);
+      return 1;
+    }
+
+  var_max = config_GetNbItems(block);
+
+  for(var_index = 0; var_index < var_max; var_index++)
+    {
+      config_item_t item;
+
+      item = config_GetItemByIndex(block, var_index);
+
+      /* Get key's name */
+      if((err = config_GetKeyValue(item, &key_name, &key_value)) != 0)
+        {
+          LogCrit(COMPONENT_CONFIG,
+                  "Error reading key[%d] from section \"%s\" of configuration file.",
+                  var_index, CONF_LABEL_NFS_FAIR_SHARE);
+          return -1;
+        }
+
+      if(!strcasecmp(key_name, "Enabled"))
+        {
+          pparam->enabled = StrToBoolean(key_value);
+        }
+      else if(!strcasecmp(key_name, "Default_Weight"))
+        {
+          pparam->default_weight = atoi(key_value);
+        }
+      else if(!strcasecmp(key_name, "Default_Max_Rate"))
+        {
+          pparam->default_max_rate = atoi(key_value);
+        }
+      else if(!strcasecmp(key_name, "Client"))
+        {
+          if(pparam->nb_clients >= NFS_FAIR_SHARE_MAX_CLIENTS)
+            {
+              LogCrit(COMPONENT_CONFIG,
+                      "Too many clients (item %s), at most %d",
+                      CONF_LABEL_NFS_FAIR_SHARE, NFS_FAIR_SHARE_MAX_CLIENTS);
+              return -1;
+            }
+
+          if(nfs_read_fair_share_client(key_value, &pparam->clients[pparam->nb_clients],
+                                        &rate_set[pparam->nb_clients]) != 0)
+            {
+              LogCrit(COMPONENT_CONFIG,
+                      "Invalid client %s (item %s), expected \"address,weight[,max_rate]\"",
+                      key_value, CONF_LABEL_NFS_FAIR_SHARE);
+              return -1;
+            }
+          pparam->nb_clients += 1;
+        }
+      else
+        {
+          LogCrit(COMPONENT_CONFIG,
+                  "Unknown or unsettable key: %s (item %s)",
+                  key_name, CONF_LABEL_NFS_FAIR_SHARE);
+          return -1;
+        }
+    }
+
+  /* The clients without their own cap have the default one, wherever it is set */
+  for(i = 0; i < pparam->nb_clients; i++)
+    if(!rate_set[i])
+      pparam->clients[i].max_rate = pparam->default_max_rate;
+
+  return 0;
+}                               /* nfs_read_fair_share_conf */
+
 /**
  *
  * nfs_read_ip_name_conf: reads the configuration for the Client/ID Cache
@@ -673,6 +906,7 @@ int nfs_read_client_id_conf(config_file_t in_config, nfs_client_id_parameter_t *
   int err;
   char *key_name;
   char *key_value;
+  int engine;
   config_item_t block;
 
   /* Is the config tree initialized ? */
@@ -716,6 +950,18 @@ int nfs_read_client_id_conf(config_file_t in_config, nfs_client_id_parameter_t *
         {
           pparam->hash_param.nb_node_prealloc = atoi(key_value);
         }
+      else if(!strcasecmp(key_name, "Hash_Engine"))
+        {
+          if((engine = HashTable_EngineFromStr(key_value)) < 0)
+            {
+              LogCrit(COMPONENT_CONFIG,
+                      "Invalid hash engine %s (item %s), expected RBT or Open_Addressing",
+                      key_value, CONF_LABEL_CLIENT_ID);
+              return -1;
+            }
+          pparam->hash_param.engine = engine;
+          pparam->hash_param_reverse.engine = engine;
+        }
       else
         {
           LogCrit(COMPONENT_CONFIG,
@@ -747,6 +993,7 @@ int nfs_read_state_id_conf(config_file_t in_config, nfs_state_id_parameter_t * p
   int err;
   char *key_name;
   char *key_value;
+  int engine;
   config_item_t block;
 
   /* Is the config tree initialized ? */
@@ -790,6 +1037,17 @@ int nfs_read_state_id_conf(config_file_t in_config, nfs_state_id_parameter_t * p
         {
           pparam->hash_param.nb_node_prealloc = atoi(key_value);
         }
+      else if(!strcasecmp(key_name, "Hash_Engine"))
+        {
+          if((engine = HashTable_EngineFromStr(key_value)) < 0)
+            {
+              LogCrit(COMPONENT_CONFIG,
+                      "Invalid hash engine %s (item %s), expected RBT or Open_Addressing",
+                      key_value, CONF_LABEL_STATE_ID);
+              return -1;
+            }
+          pparam->hash_param.engine = engine;
+        }
       else
         {
           LogCrit(COMPONENT_CONFIG,
@@ -810,6 +1068,7 @@ int nfs_read_session_id_conf(config_file_t in_config, nfs_session_id_parameter_t
   int err;
   char *key_name;
   char *key_value;
+  int engine;
   config_item_t block;
 
   /* Is the config tree initialized ? */
@@ -853,6 +1112,17 @@ int nfs_read_session_id_conf(config_file_t in_config, nfs_session_id_parameter_t
         {
           pparam->hash_param.nb_node_prealloc = atoi(key_value);
         }
+      else if(!strcasecmp(key_name, "Hash_Engine"))
+        {
+          if((engine = HashTable_EngineFromStr(key_value)) < 0)
+            {
+              LogCrit(COMPONENT_CONFIG,
+                      "Invalid hash engine %s (item %s), expected RBT or Open_Addressing",
+                      key_value, CONF_LABEL_SESSION_ID);
+              return -1;
+            }
+          pparam->hash_param.engine = engine;
+        }
       else
         {
           LogCrit(COMPONENT_CONFIG,
@@ -886,6 +1156,7 @@ int nfs_read_uidmap_conf(config_file_t in_config, nfs_idmap_cache_parameter_t *
   int err;
   char *key_name;
   char *key_value;
+  int engine;
   config_item_t block;
 
   /* Is the config tree initialized ? */
@@ -938,6 +1209,17 @@ int nfs_read_uidmap_conf(config_file_t in_config, nfs_idmap_cache_parameter_t *
         {
           pparam->hash_param.nb_node_prealloc = atoi(key_value);
         }
+      else if(!strcasecmp(key_name, "Hash_Engine"))
+        {
+          if((engine = HashTable_EngineFromStr(key_value)) < 0)
+            {
+              LogCrit(COMPONENT_CONFIG,
+                      "Invalid hash engine %s (item %s), expected RBT or Open_Addressing",
+                      key_value, CONF_LABEL_UID_MAPPER);
+              return -1;
+            }
+          pparam->hash_param.engine = engine;
+        }
       else if(!strcasecmp(key_name, "Map"))
         {
           strncpy(pparam->mapfile, key_value, MAXPATHLEN);
@@ -973,6 +1255,7 @@ int nfs_read_gidmap_conf(config_file_t in_config, nfs_idmap_cache_parameter_t *
   int err;
   char *key_name;
   char *key_value;
+  int engine;
   config_item_t block;
 
   /* Is the config tree initialized ? */
@@ -1025,6 +1308,17 @@ int nfs_read_gidmap_conf(config_file_t in_config, nfs_idmap_cache_parameter_t *
         {
           pparam->hash_param.nb_node_prealloc = atoi(key_value);
         }
+      else if(!strcasecmp(key_name, "Hash_Engine"))
+        {
+          if((engine = HashTable_EngineFromStr(key_value)) < 0)
+            {
+              LogCrit(COMPONENT_CONFIG,
+                      "Invalid hash engine %s (item %s), expected RBT or Open_Addressing",
+                      key_value, CONF_LABEL_GID_MAPPER);
+              return -1;
+            }
+          pparam->hash_param.engine = engine;
+        }
       else if(!strcasecmp(key_name, "Map"))
         {
           strncpy(pparam->mapfile, key_value, MAXPATHLEN);
@@ -1213,6 +1507,16 @@ int nfs_read_version4_conf(config_file_t in_config, nfs_version4_parameter_t * p
         {
           pparam->return_bad_stateid = StrToBoolean(key_value);
         }
+#ifdef _USE_NFS4_1
+      else if(!strcasecmp(key_name, "Max_Session_Slots"))
+        {
+          pparam->max_session_slots = atoi(key_value);
+        }
+      else if(!strcasecmp(key_name, "Session_DRC_Max_Memory"))
+        {
+          pparam->session_drc_max_memory = atol(key_value);
+        }
+#endif
       else
         {
           LogCrit(COMPONENT_CONFIG,
@@ -1239,8 +1543,8 @@ int nfs_read_version4_conf(config_file_t in_config, nfs_version4_parameter_t * p
 void Print_param_worker_in_log(nfs_worker_parameter_t * pparam)
 {
   LogInfo(COMPONENT_INIT,
-          "NFS PARAM : worker_param.lru_param.nb_entry_prealloc = %d",
-          pparam->lru_param.nb_entry_prealloc);
+          "NFS PARAM : worker_param.pending_queue_size = %d",
+          pparam->pending_queue_size);
   LogInfo(COMPONENT_INIT,
           "NFS PARAM : worker_param.nb_pending_prealloc = %d",
           pparam->nb_pending_prealloc);
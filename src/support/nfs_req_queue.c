@@ -0,0 +1,195 @@
+/*
+ * vim:expandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * ---------------------------------------
+ */
+
+/**
+ * \file    nfs_req_queue.c
+ * \brief   Bounded lock-free queue carrying requests from dispatchers to workers.
+ *
+ * nfs_req_queue.c : Multi-producer/multi-consumer ring. A producer reserves a
+ * cell by advancing enqueue_pos with a compare and swap, fills it, then
+ * publishes it by updating the cell's sequence number. Consumers do the
+ * same on dequeue_pos. No thread ever waits on another one.
+ *
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#ifdef _SOLARIS
+#include "solaris_port.h"
+#endif
+
+#include <string.h>
+#include "stuff_alloc.h"
+#include "nfs_req_queue.h"
+
+/**
+ *
+ * req_queue_init: initializes a request queue.
+ *
+ * @param pqueue [OUT] the queue to be initialized.
+ * @param size   [IN]  minimum number of entries, rounded up to a power of 2.
+ *
+ * @return REQ_QUEUE_SUCCESS if successfull, REQ_QUEUE_MALLOC_ERROR otherwise.
+ *
+ */
+int req_queue_init(req_queue_t * pqueue, unsigned int size)
+{
+  unsigned long nb_cells = 2;
+  unsigned long i;
+
+  while(nb_cells < size)
+    nb_cells <<= 1;
+
+  memset(pqueue, 0, sizeof(req_queue_t));
+
+  pqueue->cells = (req_queue_cell_t *) Mem_Alloc_Label(nb_cells * sizeof(req_queue_cell_t),
+                                                       "req_queue_cell_t");
+  if(pqueue->cells == NULL)
+    return REQ_QUEUE_MALLOC_ERROR;
+
+  for(i = 0; i < nb_cells; i++)
+    {
+      pqueue->cells[i].sequence = i;
+      pqueue->cells[i].data = NULL;
+    }
+
+  pqueue->mask = nb_cells - 1;
+  pqueue->enqueue_pos = 0;
+  pqueue->dequeue_pos = 0;
+
+  return REQ_QUEUE_SUCCESS;
+}                               /* req_queue_init */
+
+/**
+ *
+ * req_queue_push: adds an entry at the tail of the queue.
+ *
+ * @param pqueue [INOUT] the queue.
+ * @param data   [IN]    the entry to be added.
+ *
+ * @return REQ_QUEUE_SUCCESS if successfull, REQ_QUEUE_FULL if no cell is free.
+ *
+ */
+int req_queue_push(req_queue_t * pqueue, void *data)
+{
+  req_queue_cell_t *pcell;
+  unsigned long pos;
+  long diff;
+
+  pos = pqueue->enqueue_pos;
+  for(;;)
+    {
+      pcell = &pqueue->cells[pos & pqueue->mask];
+      diff = (long)pcell->sequence - (long)pos;
+
+      if(diff == 0)
+        {
+          /* The cell is free for this lap, try to reserve it */
+          if(__sync_bool_compare_and_swap(&pqueue->enqueue_pos, pos, pos + 1))
+            break;
+          pos = pqueue->enqueue_pos;
+        }
+      else if(diff < 0)
+        {
+          /* The cell still holds the entry pushed one lap ago */
+          return REQ_QUEUE_FULL;
+        }
+      else
+        pos = pqueue->enqueue_pos;
+    }
+
+  pcell->data = data;
+
+  /* Make the entry visible before publishing the cell */
+  __sync_synchronize();
+  pcell->sequence = pos + 1;
+
+  return REQ_QUEUE_SUCCESS;
+}                               /* req_queue_push */
+
+/**
+ *
+ * req_queue_pop: removes the entry at the head of the queue.
+ *
+ * @param pqueue [INOUT] the queue.
+ *
+ * @return the entry, or NULL if the queue is empty.
+ *
+ */
+void *req_queue_pop(req_queue_t * pqueue)
+{
+  req_queue_cell_t *pcell;
+  unsigned long pos;
+  long diff;
+  void *data;
+
+  pos = pqueue->dequeue_pos;
+  for(;;)
+    {
+      pcell = &pqueue->cells[pos & pqueue->mask];
+      diff = (long)pcell->sequence - (long)(pos + 1);
+
+      if(diff == 0)
+        {
+          /* The cell has been published, try to take it */
+          if(__sync_bool_compare_and_swap(&pqueue->dequeue_pos, pos, pos + 1))
+            break;
+          pos = pqueue->dequeue_pos;
+        }
+      else if(diff < 0)
+        {
+          /* Nothing was published in this cell yet */
+          return NULL;
+        }
+      else
+        pos = pqueue->dequeue_pos;
+    }
+
+  data = pcell->data;
+
+  /* Read the entry before giving the cell back to the producers */
+  __sync_synchronize();
+  pcell->sequence = pos + pqueue->mask + 1;
+
+  return data;
+}                               /* req_queue_pop */
+
+/**
+ *
+ * req_queue_length: gives an estimation of the number of entries in the queue.
+ *
+ * The value is exact only when no push or pop is in progress.
+ *
+ * @param pqueue [IN] the queue.
+ *
+ * @return the number of entries.
+ *
+ */
+unsigned int req_queue_length(req_queue_t * pqueue)
+{
+  unsigned long enqueue_pos = pqueue->enqueue_pos;
+  unsigned long dequeue_pos = pqueue->dequeue_pos;
+
+  if(enqueue_pos <= dequeue_pos)
+    return 0;
+
+  return (unsigned int)(enqueue_pos - dequeue_pos);
+}                               /* req_queue_length */
@@ -70,6 +70,7 @@ size_t strnlen(const char *s, size_t maxlen);
 hash_table_t *ht_session_id;
 uint32_t global_sequence = 0;
 pthread_mutex_t mutex_sequence = PTHREAD_MUTEX_INITIALIZER;
+size_t nfs41_drc_memory_used = 0;
 
 int display_session_id_key(hash_buffer_t * pbuff, char *str)
 {
@@ -280,11 +281,30 @@ int nfs41_Session_Get(char sessionid[NFS4_SESSIONID_SIZE],
   return 1;
 }                               /* nfs41_Session_Get */
 
+/**
+ *
+ * nfs41_Session_Hash_Ref
+ *
+ * This routine takes a reference on a session found in the sessions's
+ * hashtable, called with the hashtable's lock held.
+ *
+ * @param pbuffval [IN] the session found
+ *
+ * @return nothing (void function)
+ *
+ */
+static void nfs41_Session_Hash_Ref(hash_buffer_t * pbuffval)
+{
+  __sync_fetch_and_add(&((nfs41_session_t *) pbuffval->pdata)->refcount, 1);
+}                               /* nfs41_Session_Hash_Ref */
+
 /**
  *
  * nfs41_Session_Get_Pointer
  *
  * This routine gets a pointer to a session from the sessions's hashtable.
+ * The session is referenced until nfs41_Session_Release is called, it keeps
+ * its slots even if it is destroyed meanwhile.
  *
  * @param psession       [IN] pointer to the sessionid to be checked.
  * @param ppsession_data [OUT] pointer's session found
@@ -310,7 +330,8 @@ int nfs41_Session_Get_Pointer(char sessionid[NFS4_SESSIONID_SIZE],
   buffkey.pdata = (caddr_t) sessionid;
   buffkey.len = NFS4_SESSIONID_SIZE;
 
-  if(HashTable_Get(ht_session_id, &buffkey, &buffval) != HASHTABLE_SUCCESS)
+  if(HashTable_GetRef(ht_session_id, &buffkey, &buffval,
+                      nfs41_Session_Hash_Ref) != HASHTABLE_SUCCESS)
     {
       LogFullDebug(COMPONENT_SESSIONS,
                    "---> nfs41_Session_Get_Pointer  NOT FOUND !!!!!!");
@@ -402,7 +423,10 @@ int nfs41_Session_Del(char sessionid[NFS4_SESSIONID_SIZE])
       /* free the key that was stored in hash table */
       Mem_Free((void *)old_key.pdata);
 
-      /* State is managed in stuff alloc, no fre is needed for old_value.pdata */
+      /* State is managed in stuff alloc, no fre is needed for old_value.pdata,
+       * but the slot table and its cached replies belong to the session, they
+       * go with the last COMPOUND still using them */
+      nfs41_Session_Release((nfs41_session_t *) old_value.pdata);
 
       return 1;
     }
@@ -410,6 +434,356 @@ int nfs41_Session_Del(char sessionid[NFS4_SESSIONID_SIZE])
     return 0;
 }                               /* nfs41_Session_Del */
 
+/**
+ *
+ * nfs41_Session_Release
+ *
+ * This routine releases a reference got by nfs41_Session_Get_Pointer. The
+ * slot table is freed with the last reference, once the session left the
+ * sessions's hashtable.
+ *
+ * @param psession [INOUT] the session
+ *
+ * @return nothing (void function)
+ *
+ */
+void nfs41_Session_Release(nfs41_session_t * psession)
+{
+  if(__sync_sub_and_fetch(&psession->refcount, 1) == 0)
+    nfs41_Session_Free_Slots(psession);
+}                               /* nfs41_Session_Release */
+
+/**
+ *
+ * nfs41_Session_Alloc_Slots
+ *
+ * This routine allocates the slot table of a session. The table is sized from
+ * the ca_maxrequests negotiated at CREATE_SESSION, the cached replies are only
+ * allocated when a request asks for it.
+ *
+ * @param psession [INOUT] the session
+ * @param nb_slots [IN]    number of slots to be granted
+ *
+ * @return 1 if ok, 0 otherwise.
+ *
+ */
+int nfs41_Session_Alloc_Slots(nfs41_session_t * psession, unsigned int nb_slots)
+{
+  unsigned int i = 0;
+
+  if(nb_slots == 0)
+    nb_slots = NFS41_NB_SLOTS;
+  if(nb_slots > nfs_param.nfsv4_param.max_session_slots)
+    nb_slots = nfs_param.nfsv4_param.max_session_slots;
+  if(nb_slots > NFS41_MAX_SLOTS)
+    nb_slots = NFS41_MAX_SLOTS;
+  if(nb_slots == 0)
+    nb_slots = 1;
+
+  psession->slots = (nfs41_session_slot_t *)
+      Mem_Alloc_Label(nb_slots * sizeof(nfs41_session_slot_t), "nfs41_session_slot_t");
+  if(psession->slots == NULL)
+    return 0;
+
+  memset(psession->slots, 0, nb_slots * sizeof(nfs41_session_slot_t));
+  for(i = 0; i < nb_slots; i++)
+    pthread_mutex_init(&psession->slots[i].lock, NULL);
+
+  psession->nb_slots = nb_slots;
+  psession->target_highest_slotid = nb_slots - 1;
+
+  /* Reference of the sessions's hashtable */
+  psession->refcount = 1;
+
+  LogDebug(COMPONENT_SESSIONS, "Session granted %u slots", nb_slots);
+
+  return 1;
+}                               /* nfs41_Session_Alloc_Slots */
+
+/**
+ *
+ * nfs41_Session_Free_Slots
+ *
+ * This routine releases the slot table of a session and all the replies it
+ * was caching.
+ *
+ * @param psession [INOUT] the session
+ *
+ * @return nothing (void function)
+ *
+ */
+void nfs41_Session_Free_Slots(nfs41_session_t * psession)
+{
+  unsigned int i = 0;
+
+  if(psession->slots == NULL)
+    return;
+
+  for(i = 0; i < psession->nb_slots; i++)
+    {
+      P(psession->slots[i].lock);
+      nfs41_Session_Slot_Drop(&psession->slots[i]);
+      V(psession->slots[i].lock);
+      pthread_mutex_destroy(&psession->slots[i].lock);
+    }
+
+  Mem_Free(psession->slots);
+  psession->slots = NULL;
+  psession->nb_slots = 0;
+}                               /* nfs41_Session_Free_Slots */
+
+/**
+ *
+ * nfs41_Session_Target_Slotid
+ *
+ * This routine computes the sr_target_highest_slotid returned by SEQUENCE.
+ * The target shrinks by half when the worker's backlog or the memory used by
+ * the replies cache gets too high and grows back by one slot per request
+ * otherwise. The caches of the slots the client gave up using are released.
+ *
+ * @param psession            [INOUT] the session
+ * @param highest_used_slotid [IN]    sa_highest_slotid sent by the client
+ * @param queue_length        [IN]    number of requests waiting for this worker
+ *
+ * @return the new target highest slotid.
+ *
+ */
+unsigned int nfs41_Session_Target_Slotid(nfs41_session_t * psession,
+                                         unsigned int highest_used_slotid,
+                                         unsigned int queue_length)
+{
+  unsigned int old_target = 0;
+  unsigned int target = 0;
+  unsigned int i = 0;
+
+  /* The SEQUENCEs of the other slots update the target concurrently: start
+   * again from the value they left when one of them came first */
+  do
+    {
+      old_target = psession->target_highest_slotid;
+      target = old_target;
+
+      if(queue_length > NFS41_SESSION_BUSY_QUEUE ||
+         nfs41_drc_memory_used > nfs_param.nfsv4_param.session_drc_max_memory / 4 * 3)
+        target = target / 2;
+      else if(target + 1 < psession->nb_slots)
+        target += 1;
+
+      if(target < NFS41_NB_SLOTS - 1 && NFS41_NB_SLOTS <= psession->nb_slots)
+        target = NFS41_NB_SLOTS - 1;
+    }
+  while(!__sync_bool_compare_and_swap(&psession->target_highest_slotid, old_target, target));
+
+  /* The client now stays below the target: the slots above are no more used */
+  if(highest_used_slotid <= target)
+    for(i = highest_used_slotid + 1; i < psession->nb_slots; i++)
+      if(psession->slots[i].cached_result != NULL &&
+         pthread_mutex_trylock(&psession->slots[i].lock) == 0)
+        {
+          nfs41_Session_Slot_Drop(&psession->slots[i]);
+          V(psession->slots[i].lock);
+        }
+
+  return target;
+}                               /* nfs41_Session_Target_Slotid */
+
+/**
+ *
+ * nfs41_Session_Slot_Drop
+ *
+ * This routine forgets the reply cached in a slot. The slot's lock is to be
+ * held by the caller.
+ *
+ * @param pslot [INOUT] the slot
+ *
+ * @return nothing (void function)
+ *
+ */
+void nfs41_Session_Slot_Drop(nfs41_session_slot_t * pslot)
+{
+  if(pslot->cached_result != NULL)
+    {
+      Mem_Free(pslot->cached_result);
+      __sync_fetch_and_sub(&nfs41_drc_memory_used, pslot->cached_size);
+    }
+
+  pslot->cached_result = NULL;
+  pslot->cached_size = 0;
+  pslot->cache_used = FALSE;
+}                               /* nfs41_Session_Slot_Drop */
+
+/**
+ *
+ * nfs41_Session_Slot_Store
+ *
+ * This routine keeps the reply to a COMPOUND in its slot for later replay. The
+ * reply is kept XDR encoded, the results themselves are freed once sent. It
+ * is not kept (and a replay will get NFS4ERR_RETRY_UNCACHED_REP) when it is
+ * bigger than NFS41_DRC_SIZE or when all the slots' caches reached
+ * Session_DRC_Max_Memory.
+ *
+ * The reply is encoded in a NFS41_DRC_SIZE buffer owned by the worker,
+ * allocated at its first cached reply and used again for the next ones.
+ *
+ * @param pslot   [INOUT] the slot
+ * @param pres    [IN]    the reply to be cached
+ * @param pencode [INOUT] the worker's encoding buffer, NULL if there is none
+ *
+ * @return nothing (void function)
+ *
+ */
+void nfs41_Session_Slot_Store(nfs41_session_slot_t * pslot, COMPOUND4res * pres,
+                              caddr_t * pencode)
+{
+  caddr_t buf = NULL;
+  unsigned int size = 0;
+  int encoded = 0;
+  XDR xdrs;
+
+  /* Encode out of the lock, only this request uses the slot */
+  if(pencode != NULL && *pencode != NULL)
+    buf = *pencode;
+  else if((buf = (caddr_t) Mem_Alloc_Label(NFS41_DRC_SIZE, "nfs41_drc")) == NULL)
+    return;
+  else if(pencode != NULL)
+    *pencode = buf;
+
+  xdrmem_create(&xdrs, buf, NFS41_DRC_SIZE, XDR_ENCODE);
+  encoded = xdr_COMPOUND4res(&xdrs, pres);
+  size = XDR_GETPOS(&xdrs);
+  XDR_DESTROY(&xdrs);
+
+  P(pslot->lock);
+
+  nfs41_Session_Slot_Drop(pslot);
+
+  if(!encoded ||
+     __sync_add_and_fetch(&nfs41_drc_memory_used, size) >
+     nfs_param.nfsv4_param.session_drc_max_memory)
+    {
+      if(encoded)
+        __sync_fetch_and_sub(&nfs41_drc_memory_used, size);
+      LogDebug(COMPONENT_SESSIONS,
+               "Reply of %u bytes not kept in the session's replies cache", size);
+      V(pslot->lock);
+      if(pencode == NULL)
+        Mem_Free(buf);
+      return;
+    }
+
+  if((pslot->cached_result = (caddr_t) Mem_Alloc_Label(size, "nfs41_drc")) == NULL)
+    {
+      __sync_fetch_and_sub(&nfs41_drc_memory_used, size);
+      V(pslot->lock);
+      if(pencode == NULL)
+        Mem_Free(buf);
+      return;
+    }
+
+  memcpy(pslot->cached_result, buf, size);
+  pslot->cached_size = size;
+  pslot->cached_status = pres->status;
+  pslot->cache_used = TRUE;
+
+  V(pslot->lock);
+
+  if(pencode == NULL)
+    Mem_Free(buf);
+}                               /* nfs41_Session_Slot_Store */
+
+/**
+ *
+ * nfs41_Session_Slot_Replay
+ *
+ * This routine copies the reply cached in a slot for the worker to send it
+ * again. The COMPOUND's own reply is emptied, it is only freed.
+ *
+ * @param pslot   [IN]  the slot
+ * @param pres    [OUT] the reply of the COMPOUND
+ * @param preplay [OUT] the encoded reply to be sent instead
+ *
+ * @return the status of the replayed COMPOUND, NFS4ERR_RETRY_UNCACHED_REP if
+ * nothing was cached.
+ *
+ */
+int nfs41_Session_Slot_Replay(nfs41_session_slot_t * pslot, COMPOUND4res * pres,
+                              nfs41_session_replay_t * preplay)
+{
+  P(pslot->lock);
+
+  if(pslot->cache_used != TRUE || pslot->cached_result == NULL || preplay == NULL)
+    {
+      V(pslot->lock);
+      pres->resarray.resarray_len = 1;
+      pres->resarray.resarray_val[0].nfs_resop4_u.opaccess.status =
+          NFS4ERR_RETRY_UNCACHED_REP;
+      return NFS4ERR_RETRY_UNCACHED_REP;
+    }
+
+  if((preplay->buf = (caddr_t) Mem_Alloc(pslot->cached_size)) == NULL)
+    {
+      V(pslot->lock);
+      pres->resarray.resarray_len = 1;
+      pres->resarray.resarray_val[0].nfs_resop4_u.opaccess.status = NFS4ERR_SERVERFAULT;
+      return NFS4ERR_SERVERFAULT;
+    }
+
+  memcpy(preplay->buf, pslot->cached_result, pslot->cached_size);
+  preplay->len = pslot->cached_size;
+  pres->status = pslot->cached_status;
+
+  V(pslot->lock);
+
+  /* Nothing of the COMPOUND's own results is to be sent or freed */
+  pres->resarray.resarray_len = 0;
+
+  return pres->status;
+}                               /* nfs41_Session_Slot_Replay */
+
+/**
+ *
+ * xdr_nfs41_session_replay: encodes again a reply copied from a slot.
+ *
+ * @param xdrs    [INOUT] the XDR stream
+ * @param preplay [IN]    the encoded reply
+ *
+ * @return TRUE if ok, FALSE otherwise.
+ *
+ */
+static bool_t xdr_nfs41_session_replay(XDR * xdrs, nfs41_session_replay_t * preplay)
+{
+  if(xdrs->x_op != XDR_ENCODE)
+    return TRUE;
+
+  return XDR_PUTBYTES(xdrs, preplay->buf, preplay->len);
+}                               /* xdr_nfs41_session_replay */
+
+/**
+ *
+ * nfs41_Session_Replay_Send
+ *
+ * This routine sends a reply copied by nfs41_Session_Slot_Replay, then frees
+ * the copy. The xprt's lock is to be held by the caller.
+ *
+ * @param xprt    [IN]    the transport of the request
+ * @param preplay [INOUT] the encoded reply
+ *
+ * @return TRUE if ok, FALSE otherwise.
+ *
+ */
+bool_t nfs41_Session_Replay_Send(SVCXPRT * xprt, nfs41_session_replay_t * preplay)
+{
+  bool_t rc;
+
+  rc = svc_sendreply(xprt, (xdrproc_t) xdr_nfs41_session_replay, (caddr_t) preplay);
+
+  Mem_Free(preplay->buf);
+  preplay->buf = NULL;
+  preplay->len = 0;
+
+  return rc;
+}                               /* nfs41_Session_Replay_Send */
+
 /**
  *
  *  nfs41_Session_PrintAll
@@ -0,0 +1,541 @@
+/*
+ * vim:expandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * ---------------------------------------
+ */
+
+/**
+ * \file    nfs_stat_registry.c
+ * \brief   Per-thread statistics counters and latency histograms.
+ *
+ * nfs_stat_registry.c : Every thread that updates a statistic gets a block
+ * holding its own copy of the counters and of the histograms it has used.
+ * Blocks are pushed on a list that is never shrunk, the snapshot walks it
+ * without locking. Only the registration of a new name takes a mutex.
+ *
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#ifdef _SOLARIS
+#include "solaris_port.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <errno.h>
+#include "RW_Lock.h"
+#include "log_macros.h"
+#include "stuff_alloc.h"
+#include "nfs_stat_registry.h"
+
+/* The owner thread is the only writer of a block, ordering its stores is
+ * enough. x86 does not reorder stores with stores nor loads with loads. */
+#if defined(__i386__) || defined(__x86_64__)
+#define NFS_STAT_BARRIER() __asm__ __volatile__("" ::: "memory")
+#else
+#define NFS_STAT_BARRIER() __sync_synchronize()
+#endif
+
+typedef struct nfs_stat_block__
+{
+  struct nfs_stat_block__ *next;
+  uint64_t counters[NFS_STAT_MAX_COUNTERS];
+  nfs_stat_histogram_t *volatile histograms[NFS_STAT_MAX_HISTOGRAMS];
+} nfs_stat_block_t;
+
+static pthread_mutex_t nfs_stat_names_mutex = PTHREAD_MUTEX_INITIALIZER;
+static char nfs_stat_counter_names[NFS_STAT_MAX_COUNTERS][NFS_STAT_NAME_LEN];
+static char nfs_stat_histogram_names[NFS_STAT_MAX_HISTOGRAMS][NFS_STAT_NAME_LEN];
+static volatile unsigned int nfs_stat_nb_counters = 0;
+static volatile unsigned int nfs_stat_nb_histograms = 0;
+
+static nfs_stat_block_t *volatile nfs_stat_blocks = NULL;
+static __thread nfs_stat_block_t *nfs_stat_my_block = NULL;
+
+/**
+ *
+ * nfs_stat_register: adds a name to a table of names, or finds it.
+ *
+ * @param names    [INOUT] the table of names.
+ * @param pnb      [INOUT] number of names in the table.
+ * @param max      [IN]    size of the table.
+ * @param name     [IN]    the name to be registered.
+ *
+ * @return the index of the name, -1 if the table is full.
+ *
+ */
+static int nfs_stat_register(char (*names)[NFS_STAT_NAME_LEN],
+                             volatile unsigned int *pnb, unsigned int max,
+                             const char *name)
+{
+  unsigned int i;
+  int id = -1;
+
+  P(nfs_stat_names_mutex);
+
+  for(i = 0; i < *pnb; i++)
+    if(!strncmp(names[i], name, NFS_STAT_NAME_LEN - 1))
+      {
+        id = i;
+        break;
+      }
+
+  if(id == -1 && *pnb < max)
+    {
+      id = *pnb;
+      strncpy(names[id], name, NFS_STAT_NAME_LEN - 1);
+      names[id][NFS_STAT_NAME_LEN - 1] = '\0';
+
+      /* The name is visible before the snapshot can count it */
+      __sync_synchronize();
+      *pnb = id + 1;
+    }
+
+  V(nfs_stat_names_mutex);
+
+  if(id == -1)
+    LogCrit(COMPONENT_MAIN,
+            "NFS STATS: no room left to register \"%s\", it will not be measured", name);
+
+  return id;
+}                               /* nfs_stat_register */
+
+/**
+ *
+ * nfs_stat_register_counter: registers a counter.
+ *
+ * Registering an already known name returns the same counter.
+ *
+ * @param name [IN] name of the counter.
+ *
+ * @return the counter id, -1 if there is no room left. Updates of id -1 are ignored.
+ *
+ */
+int nfs_stat_register_counter(const char *name)
+{
+  return nfs_stat_register(nfs_stat_counter_names, &nfs_stat_nb_counters,
+                           NFS_STAT_MAX_COUNTERS, name);
+}                               /* nfs_stat_register_counter */
+
+/**
+ *
+ * nfs_stat_register_histogram: registers a histogram.
+ *
+ * Registering an already known name returns the same histogram.
+ *
+ * @param name [IN] name of the histogram.
+ *
+ * @return the histogram id, -1 if there is no room left. Records in id -1 are ignored.
+ *
+ */
+int nfs_stat_register_histogram(const char *name)
+{
+  return nfs_stat_register(nfs_stat_histogram_names, &nfs_stat_nb_histograms,
+                           NFS_STAT_MAX_HISTOGRAMS, name);
+}                               /* nfs_stat_register_histogram */
+
+/**
+ *
+ * nfs_stat_lookup_histogram: finds a registered histogram.
+ *
+ * @param name [IN] name of the histogram.
+ *
+ * @return the histogram id, -1 if it is not registered.
+ *
+ */
+int nfs_stat_lookup_histogram(const char *name)
+{
+  unsigned int i;
+  unsigned int nb = nfs_stat_nb_histograms;
+
+  for(i = 0; i < nb; i++)
+    if(!strncmp(nfs_stat_histogram_names[i], name, NFS_STAT_NAME_LEN - 1))
+      return i;
+
+  return -1;
+}                               /* nfs_stat_lookup_histogram */
+
+/**
+ *
+ * nfs_stat_get_block: returns the block of the current thread.
+ *
+ * The block outlives its thread, the counters of a thread that exited
+ * still count. So it is not taken from the thread's memory pool.
+ *
+ * @return the block, NULL if it could not be allocated.
+ *
+ */
+static nfs_stat_block_t *nfs_stat_get_block(void)
+{
+  nfs_stat_block_t *pblock;
+
+  if(nfs_stat_my_block != NULL)
+    return nfs_stat_my_block;
+
+  if((pblock = (nfs_stat_block_t *) calloc(1, sizeof(nfs_stat_block_t))) == NULL)
+    return NULL;
+
+  do
+    pblock->next = nfs_stat_blocks;
+  while(!__sync_bool_compare_and_swap(&nfs_stat_blocks, pblock->next, pblock));
+
+  nfs_stat_my_block = pblock;
+  return pblock;
+}                               /* nfs_stat_get_block */
+
+/**
+ *
+ * nfs_stat_counter_add: adds a value to a counter of the current thread.
+ *
+ * @param id    [IN] the counter id, as returned by nfs_stat_register_counter.
+ * @param value [IN] value to be added.
+ *
+ * @return nothing (void function)
+ *
+ */
+void nfs_stat_counter_add(int id, uint64_t value)
+{
+  nfs_stat_block_t *pblock;
+
+  if(id < 0 || id >= NFS_STAT_MAX_COUNTERS || (pblock = nfs_stat_get_block()) == NULL)
+    return;
+
+  /* A 64 bits aligned store is never seen half done by the snapshot */
+  pblock->counters[id] += value;
+}                               /* nfs_stat_counter_add */
+
+/**
+ *
+ * nfs_stat_histogram_bucket: computes the bucket of a value.
+ *
+ * @param value [IN] the value.
+ *
+ * @return the bucket index, values too large go to the last bucket.
+ *
+ */
+unsigned int nfs_stat_histogram_bucket(uint64_t value)
+{
+  unsigned int msb;
+
+  if(value < NFS_STAT_HISTO_SUB_COUNT)
+    return (unsigned int)value;
+
+  if(value >> NFS_STAT_HISTO_MAX_BITS)
+    return NFS_STAT_HISTO_BUCKETS - 1;
+
+  msb = 63 - __builtin_clzll(value);
+
+  return ((msb - NFS_STAT_HISTO_SUB_BITS + 1) << NFS_STAT_HISTO_SUB_BITS) +
+      (unsigned int)((value >> (msb - NFS_STAT_HISTO_SUB_BITS)) & (NFS_STAT_HISTO_SUB_COUNT - 1));
+}                               /* nfs_stat_histogram_bucket */
+
+/**
+ *
+ * nfs_stat_histogram_bucket_max: computes the largest value of a bucket.
+ *
+ * @param bucket [IN] the bucket index.
+ *
+ * @return the largest value that goes to this bucket.
+ *
+ */
+uint64_t nfs_stat_histogram_bucket_max(unsigned int bucket)
+{
+  unsigned int shift;
+  uint64_t sub;
+
+  if(bucket < NFS_STAT_HISTO_SUB_COUNT)
+    return bucket;
+
+  shift = (bucket >> NFS_STAT_HISTO_SUB_BITS) - 1;
+  sub = NFS_STAT_HISTO_SUB_COUNT + (bucket & (NFS_STAT_HISTO_SUB_COUNT - 1));
+
+  return ((sub + 1) << shift) - 1;
+}                               /* nfs_stat_histogram_bucket_max */
+
+/**
+ *
+ * nfs_stat_histogram_record: records a value in a histogram of the current thread.
+ *
+ * @param id    [IN] the histogram id, as returned by nfs_stat_register_histogram.
+ * @param value [IN] value to be recorded, latencies are in nanoseconds.
+ *
+ * @return nothing (void function)
+ *
+ */
+void nfs_stat_histogram_record(int id, uint64_t value)
+{
+  nfs_stat_block_t *pblock;
+  nfs_stat_histogram_t *phisto;
+
+  if(id < 0 || id >= NFS_STAT_MAX_HISTOGRAMS || (pblock = nfs_stat_get_block()) == NULL)
+    return;
+
+  if((phisto = pblock->histograms[id]) == NULL)
+    {
+      /* Allocated the first time this thread uses it, most threads only use a few */
+      if((phisto = (nfs_stat_histogram_t *) calloc(1, sizeof(nfs_stat_histogram_t))) == NULL)
+        return;
+
+      NFS_STAT_BARRIER();
+      pblock->histograms[id] = phisto;
+    }
+
+  phisto->sequence += 1;
+  NFS_STAT_BARRIER();
+
+  phisto->count += 1;
+  phisto->sum += value;
+  if(value > phisto->max)
+    phisto->max = value;
+  phisto->buckets[nfs_stat_histogram_bucket(value)] += 1;
+
+  NFS_STAT_BARRIER();
+  phisto->sequence += 1;
+}                               /* nfs_stat_histogram_record */
+
+/**
+ *
+ * nfs_stat_histogram_read: reads a histogram updated by another thread.
+ *
+ * @param phisto [IN]  the histogram of a thread.
+ * @param pcopy  [OUT] a consistent copy of it.
+ *
+ * @return nothing (void function)
+ *
+ */
+static void nfs_stat_histogram_read(nfs_stat_histogram_t * phisto,
+                                    nfs_stat_histogram_t * pcopy)
+{
+  unsigned int sequence;
+
+  do
+    {
+      while((sequence = phisto->sequence) & 1)
+        ;
+      NFS_STAT_BARRIER();
+
+      memcpy(pcopy, phisto, sizeof(nfs_stat_histogram_t));
+
+      NFS_STAT_BARRIER();
+    }
+  while(phisto->sequence != sequence);
+}                               /* nfs_stat_histogram_read */
+
+/**
+ *
+ * nfs_stat_histogram_percentile: computes a percentile from a histogram.
+ *
+ * @param phisto  [IN] the histogram.
+ * @param percent [IN] the percentile, between 0 and 100.
+ *
+ * @return the upper bound of the bucket holding the percentile, 0 if the histogram is empty.
+ *
+ */
+uint64_t nfs_stat_histogram_percentile(nfs_stat_histogram_t * phisto, double percent)
+{
+  uint64_t target;
+  uint64_t seen = 0;
+  uint64_t value;
+  unsigned int i;
+
+  if(phisto->count == 0)
+    return 0;
+
+  target = (uint64_t) (phisto->count * percent / 100.0);
+  if(target == 0)
+    target = 1;
+
+  for(i = 0; i < NFS_STAT_HISTO_BUCKETS; i++)
+    {
+      seen += phisto->buckets[i];
+      if(seen >= target)
+        break;
+    }
+
+  value = nfs_stat_histogram_bucket_max(i < NFS_STAT_HISTO_BUCKETS ? i : NFS_STAT_HISTO_BUCKETS - 1);
+
+  return value < phisto->max ? value : phisto->max;
+}                               /* nfs_stat_histogram_percentile */
+
+/**
+ *
+ * nfs_stat_snapshot_take: sums the statistics of all the threads.
+ *
+ * The threads are never stopped nor locked. Counters are read as they are,
+ * each histogram is a consistent copy.
+ *
+ * @return the snapshot, to be released with nfs_stat_snapshot_free. NULL if no memory.
+ *
+ */
+nfs_stat_snapshot_t *nfs_stat_snapshot_take(void)
+{
+  nfs_stat_snapshot_t *psnap;
+  nfs_stat_block_t *pblock;
+  nfs_stat_histogram_t copy;
+  nfs_stat_histogram_t *phisto;
+  unsigned int i, j;
+
+  if((psnap = (nfs_stat_snapshot_t *) Mem_Alloc(sizeof(nfs_stat_snapshot_t))) == NULL)
+    return NULL;
+
+  memset(psnap, 0, sizeof(nfs_stat_snapshot_t));
+  gettimeofday(&psnap->date, NULL);
+
+  psnap->nb_counters = nfs_stat_nb_counters;
+  psnap->nb_histograms = nfs_stat_nb_histograms;
+  __sync_synchronize();
+
+  psnap->counter_names = (char (*)[NFS_STAT_NAME_LEN])
+      Mem_Alloc(NFS_STAT_NAME_LEN * (psnap->nb_counters + 1));
+  psnap->histogram_names = (char (*)[NFS_STAT_NAME_LEN])
+      Mem_Alloc(NFS_STAT_NAME_LEN * (psnap->nb_histograms + 1));
+  psnap->counters = (uint64_t *) Mem_Alloc(sizeof(uint64_t) * (psnap->nb_counters + 1));
+  psnap->histograms = (nfs_stat_histogram_t *)
+      Mem_Alloc(sizeof(nfs_stat_histogram_t) * (psnap->nb_histograms + 1));
+
+  if(psnap->counter_names == NULL || psnap->histogram_names == NULL ||
+     psnap->counters == NULL || psnap->histograms == NULL)
+    {
+      nfs_stat_snapshot_free(psnap);
+      return NULL;
+    }
+
+  memcpy(psnap->counter_names, nfs_stat_counter_names, NFS_STAT_NAME_LEN * psnap->nb_counters);
+  memcpy(psnap->histogram_names, nfs_stat_histogram_names,
+         NFS_STAT_NAME_LEN * psnap->nb_histograms);
+  memset(psnap->counters, 0, sizeof(uint64_t) * psnap->nb_counters);
+  memset(psnap->histograms, 0, sizeof(nfs_stat_histogram_t) * psnap->nb_histograms);
+
+  for(pblock = nfs_stat_blocks; pblock != NULL; pblock = pblock->next)
+    {
+      psnap->nb_threads += 1;
+
+      for(i = 0; i < psnap->nb_counters; i++)
+        psnap->counters[i] += pblock->counters[i];
+
+      for(i = 0; i < psnap->nb_histograms; i++)
+        {
+          if((phisto = pblock->histograms[i]) == NULL)
+            continue;
+
+          nfs_stat_histogram_read(phisto, &copy);
+
+          psnap->histograms[i].count += copy.count;
+          psnap->histograms[i].sum += copy.sum;
+          if(copy.max > psnap->histograms[i].max)
+            psnap->histograms[i].max = copy.max;
+          for(j = 0; j < NFS_STAT_HISTO_BUCKETS; j++)
+            psnap->histograms[i].buckets[j] += copy.buckets[j];
+        }
+    }
+
+  return psnap;
+}                               /* nfs_stat_snapshot_take */
+
+/**
+ *
+ * nfs_stat_snapshot_free: releases a snapshot.
+ *
+ * @param psnap [IN] the snapshot returned by nfs_stat_snapshot_take.
+ *
+ * @return nothing (void function)
+ *
+ */
+void nfs_stat_snapshot_free(nfs_stat_snapshot_t * psnap)
+{
+  if(psnap == NULL)
+    return;
+
+  if(psnap->counter_names != NULL)
+    Mem_Free(psnap->counter_names);
+  if(psnap->histogram_names != NULL)
+    Mem_Free(psnap->histogram_names);
+  if(psnap->counters != NULL)
+    Mem_Free(psnap->counters);
+  if(psnap->histograms != NULL)
+    Mem_Free(psnap->histograms);
+
+  Mem_Free(psnap);
+}                               /* nfs_stat_snapshot_free */
+
+/**
+ *
+ * nfs_stat_snapshot_print_json: writes a snapshot as a JSON object.
+ *
+ * Histograms carry their count, sum, max, usual percentiles and the
+ * non empty buckets as [largest value, count] pairs. Latencies are in
+ * nanoseconds.
+ *
+ * @param stream [IN] where to write.
+ * @param psnap  [IN] the snapshot.
+ *
+ * @return 0 if successfull, -1 if writing failed.
+ *
+ */
+int nfs_stat_snapshot_print_json(FILE * stream, nfs_stat_snapshot_t * psnap)
+{
+  nfs_stat_histogram_t *phisto;
+  unsigned int i, j;
+  int first;
+
+  fprintf(stream, "{\"date\": %llu.%06llu, \"threads\": %u,\n \"counters\": {",
+          (unsigned long long)psnap->date.tv_sec,
+          (unsigned long long)psnap->date.tv_usec, psnap->nb_threads);
+
+  for(i = 0; i < psnap->nb_counters; i++)
+    fprintf(stream, "%s\n  \"%s\": %llu", i ? "," : "", psnap->counter_names[i],
+            (unsigned long long)psnap->counters[i]);
+
+  fprintf(stream, "},\n \"histograms\": {");
+
+  for(i = 0; i < psnap->nb_histograms; i++)
+    {
+      phisto = &psnap->histograms[i];
+
+      fprintf(stream,
+              "%s\n  \"%s\": {\"count\": %llu, \"sum\": %llu, \"max\": %llu, "
+              "\"p50\": %llu, \"p90\": %llu, \"p99\": %llu, \"p999\": %llu, \"buckets\": [",
+              i ? "," : "", psnap->histogram_names[i],
+              (unsigned long long)phisto->count, (unsigned long long)phisto->sum,
+              (unsigned long long)phisto->max,
+              (unsigned long long)nfs_stat_histogram_percentile(phisto, 50.0),
+              (unsigned long long)nfs_stat_histogram_percentile(phisto, 90.0),
+              (unsigned long long)nfs_stat_histogram_percentile(phisto, 99.0),
+              (unsigned long long)nfs_stat_histogram_percentile(phisto, 99.9));
+
+      for(j = 0, first = 1; j < NFS_STAT_HISTO_BUCKETS; j++)
+        {
+          if(phisto->buckets[j] == 0)
+            continue;
+
+          fprintf(stream, "%s[%llu, %llu]", first ? "" : ", ",
+                  (unsigned long long)nfs_stat_histogram_bucket_max(j),
+                  (unsigned long long)phisto->buckets[j]);
+          first = 0;
+        }
+
+      fprintf(stream, "]}");
+    }
+
+  fprintf(stream, "}}\n");
+
+  return ferror(stream) ? -1 : 0;
+}                               /* nfs_stat_snapshot_print_json */
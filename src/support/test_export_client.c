@@ -0,0 +1,199 @@
+/*
+ * vim:expandtab:shiftwidth=8:tabstop=8:
+ *
+ * Test of the compiled client arrays of the exports: random client arrays
+ * are looked up through their compiled form and through the linear walk,
+ * for random addresses and options, and both must give the same entry.
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <arpa/inet.h>
+#include "rpc.h"
+#include "stuff_alloc.h"
+#include "nfs_core.h"
+#include "nfs_exports.h"
+
+#define NB_ARRAYS        60
+#define NB_LOOKUPS       1000   /* per array, 60000 lookups in all */
+#define NB_OPTIONS       4
+
+#define EQUALS(a, b, msg, args...) do {             \
+  if (a != b) {                             \
+      printf(msg "\n", ## args);                          \
+      exit(1);                                    \
+    }                                             \
+} while(0)
+
+nfs_parameter_t nfs_param;
+
+unsigned int options[NB_OPTIONS] = {
+  EXPORT_OPTION_READ_ACCESS,
+  EXPORT_OPTION_WRITE_ACCESS,
+  EXPORT_OPTION_MD_WRITE_ACCESS,
+  EXPORT_OPTION_MD_READ_ACCESS
+};
+
+unsigned int nb_found = 0;
+
+/* Addresses are taken from 10.0.0.0/22 so that entries and lookups meet */
+unsigned int random_addr()
+{
+  return 0x0A000000U | (random() % 1024);
+}
+
+void random_addr6(struct in6_addr *paddr6)
+{
+  memset(paddr6, 0, sizeof(struct in6_addr));
+  paddr6->s6_addr[0] = 0xfe;
+  paddr6->s6_addr[1] = 0x80;
+  paddr6->s6_addr[15] = random() % 64;
+}
+
+unsigned int random_options()
+{
+  unsigned int opt = 0;
+  int i;
+
+  for(i = 0; i < NB_OPTIONS; i++)
+    if(random() % 2)
+      opt |= options[i];
+  if(random() % 4 == 0)
+    opt |= EXPORT_OPTION_ROOT;
+
+  return opt;
+}
+
+void random_entry(exportlist_client_entry_t * pentry)
+{
+  unsigned int len;
+  int kind = random() % 20;
+
+  memset(pentry, 0, sizeof(exportlist_client_entry_t));
+  pentry->options = random_options();
+
+  if(kind < 8)
+    {
+      pentry->type = HOSTIF_CLIENT;
+      pentry->client.hostif.clientaddr = htonl(random_addr());
+    }
+  else if(kind < 15)
+    {
+      /* Prefixes, and a few entries with bits outside of their mask */
+      len = 20 + random() % 13;
+      pentry->type = NETWORK_CLIENT;
+      pentry->client.network.netmask = len == 32 ? 0xFFFFFFFFU : ~(0xFFFFFFFFU >> len);
+      pentry->client.network.netaddr = random_addr();
+      if(random() % 8 != 0)
+        pentry->client.network.netaddr &= pentry->client.network.netmask;
+    }
+  else if(kind < 16)
+    {
+      /* Not a prefix */
+      pentry->type = NETWORK_CLIENT;
+      pentry->client.network.netmask = 0xFFFFFF0FU;
+      pentry->client.network.netaddr = random_addr() & 0xFFFFFF0FU;
+    }
+  else if(kind < 18)
+    {
+      pentry->type = HOSTIF_CLIENT_V6;
+      random_addr6(&pentry->client.hostif.clientaddr6);
+    }
+  else if(kind < 19)
+    pentry->type = BAD_CLIENT;
+  else
+    pentry->type = GSSPRINCIPAL_CLIENT;
+}
+
+void lookup_check(exportlist_client_t * pclients, int array)
+{
+  exportlist_client_matcher_t *pmatcher = pclients->matcher;
+  exportlist_client_entry_t found, found_linear;
+  struct sockaddr_in *paddr;
+  struct in6_addr addr6;
+  sockaddr_t hostaddr;
+  char ipstring[INET_ADDRSTRLEN];
+  unsigned int export_option;
+  int rc, rc_linear;
+
+  memset(&hostaddr, 0, sizeof(sockaddr_t));
+  paddr = (struct sockaddr_in *)&hostaddr;
+  paddr->sin_family = AF_INET;
+  paddr->sin_addr.s_addr = htonl(random_addr());
+  inet_ntop(AF_INET, &paddr->sin_addr, ipstring, INET_ADDRSTRLEN);
+  random_addr6(&addr6);
+
+  export_option = options[random() % NB_OPTIONS];
+  if(random() % 4 == 0)
+    export_option |= EXPORT_OPTION_ROOT;
+
+  rc = export_client_match(&hostaddr, ipstring, pclients, &found, export_option);
+  pclients->matcher = NULL;
+  rc_linear = export_client_match(&hostaddr, ipstring, pclients, &found_linear,
+                                  export_option);
+  pclients->matcher = pmatcher;
+
+  EQUALS(rc, rc_linear, "array %d, %s option %#x: compiled %d, linear %d",
+         array, ipstring, export_option, rc, rc_linear);
+  if(rc)
+    {
+      EQUALS(memcmp(&found, &found_linear, sizeof(found)), 0,
+             "array %d, %s option %#x: not the same entry", array, ipstring,
+             export_option);
+      nb_found += 1;
+    }
+
+  rc = export_client_matchv6(&addr6, pclients, &found, export_option);
+  pclients->matcher = NULL;
+  rc_linear = export_client_matchv6(&addr6, pclients, &found_linear, export_option);
+  pclients->matcher = pmatcher;
+
+  EQUALS(rc, rc_linear, "array %d, IPv6 option %#x: compiled %d, linear %d",
+         array, export_option, rc, rc_linear);
+  if(rc)
+    {
+      EQUALS(memcmp(&found, &found_linear, sizeof(found)), 0,
+             "array %d, IPv6 option %#x: not the same entry", array, export_option);
+      nb_found += 1;
+    }
+}
+
+int main()
+{
+  static exportlist_client_t clients;
+  unsigned int i;
+  int array;
+
+#ifndef _NO_BUDDY_SYSTEM
+  BuddyInit(NULL);
+#endif
+
+  srandom(2049);
+
+  for(array = 0; array < NB_ARRAYS; array++)
+    {
+      memset(&clients, 0, sizeof(clients));
+      clients.num_clients = 1 + random() % EXPORTS_NB_MAX_CLIENTS;
+      for(i = 0; i < clients.num_clients; i++)
+        random_entry(&clients.clientarray[i]);
+
+      EQUALS(nfs_CompileClientArray(&clients), 0, "cannot compile array %d", array);
+      EQUALS(clients.matcher != NULL, 1, "array %d not compiled", array);
+
+      for(i = 0; i < NB_LOOKUPS; i++)
+        lookup_check(&clients, array);
+
+      nfs_FreeCompiledClientArray(&clients);
+      EQUALS(clients.matcher, NULL, "compiled array %d not released", array);
+    }
+
+  /* Make sure that the lookups did not all fail */
+  EQUALS(nb_found > NB_ARRAYS * NB_LOOKUPS / 10, 1, "only %u entries found", nb_found);
+
+  printf("PASSED\n");
+  return 0;
+}
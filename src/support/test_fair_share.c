@@ -0,0 +1,280 @@
+/*
+ * vim:expandtab:shiftwidth=8:tabstop=8:
+ *
+ * Test of the fair share scheduler: the flows of the clients and of the
+ * exports are served in proportion to their weights, in order within a
+ * flow, and a client over its rate cap is held while the others go on, even
+ * when its queue drains between its requests.
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "stuff_alloc.h"
+#include "nfs_fair_share.h"
+
+#define NB_REQUESTS  120
+#define CAP          10
+
+#define EQUALS(a, b, msg, args...) do {             \
+  if (a != b) {                             \
+      printf(msg "\n", ## args);                          \
+      exit(1);                                    \
+    }                                             \
+} while(0)
+
+typedef struct request__
+{
+  nfs_fair_share_entry_t entry;
+  int client;
+  int exportid;
+  int rank;
+} request_t;
+
+request_t requests[NB_REQUESTS];
+sockaddr_t addrs[6];
+unsigned int nb_requests = 0;
+
+void set_addr(sockaddr_t * paddr, const char *str)
+{
+  EQUALS(ipstring_to_sockaddr(str, paddr), 0, "bad address %s", str);
+}
+
+void enqueue(int client, int exportid, int rank)
+{
+  request_t *preq = &requests[nb_requests++];
+
+  preq->client = client;
+  preq->exportid = exportid;
+  preq->rank = rank;
+  EQUALS(nfs_fair_share_enqueue(&preq->entry, &addrs[client], exportid, preq),
+         NFS_FAIR_SHARE_SUCCESS, "request %d of client %d not queued", rank, client);
+}
+
+void disabledcheck()
+{
+  nfs_fair_share_parameter_t param;
+  nfs_fair_share_entry_t entry;
+
+  EQUALS(nfs_fair_share_enqueue(&entry, &addrs[0], 1, NULL), NFS_FAIR_SHARE_DISABLED,
+         "request queued before init");
+  EQUALS(nfs_fair_share_dequeue(), NULL, "request served before init");
+
+  memset(&param, 0, sizeof(param));
+  param.enabled = 1;
+  EQUALS(nfs_fair_share_init(&param), -1, "null weight accepted");
+}
+
+void init()
+{
+  nfs_fair_share_parameter_t param;
+
+  memset(&param, 0, sizeof(param));
+  param.enabled = 1;
+  param.default_weight = 1;
+  param.default_max_rate = 0;
+  param.nb_clients = 3;
+
+  /* Client 0 weighs 3, clients 3 and 5 are capped */
+  memcpy(&param.clients[0].addr, &addrs[0], sizeof(sockaddr_t));
+  param.clients[0].weight = 3;
+  memcpy(&param.clients[1].addr, &addrs[3], sizeof(sockaddr_t));
+  param.clients[1].weight = 1;
+  param.clients[1].max_rate = CAP;
+  memcpy(&param.clients[2].addr, &addrs[5], sizeof(sockaddr_t));
+  param.clients[2].weight = 1;
+  param.clients[2].max_rate = CAP;
+
+  EQUALS(nfs_fair_share_init(&param), NFS_FAIR_SHARE_SUCCESS, "cannot init the scheduler");
+}
+
+void drain()
+{
+  nfs_fair_share_stats_t stats;
+
+  while(nfs_fair_share_dequeue() != NULL) ;
+
+  nfs_fair_share_get_stats(&stats);
+  EQUALS(stats.nb_queued, 0, "%u requests left", stats.nb_queued);
+  EQUALS(stats.nb_flows, 0, "%u flows left", stats.nb_flows);
+  EQUALS(stats.nb_clients, stats.nb_idle_clients, "%u clients left with flows",
+         stats.nb_clients - stats.nb_idle_clients);
+  nb_requests = 0;
+}
+
+void clientcheck()
+{
+  unsigned int served[2] = { 0, 0 };
+  int last[2] = { -1, -1 };
+  request_t *preq;
+  int i;
+
+  for(i = 0; i < 40; i++)
+    {
+      enqueue(0, 1, i);
+      enqueue(1, 1, i);
+    }
+
+  for(i = 0; i < 40; i++)
+    {
+      preq = (request_t *) nfs_fair_share_dequeue();
+      EQUALS(preq != NULL, 1, "nothing to serve after %d requests", i);
+      EQUALS(preq->rank, last[preq->client] + 1, "request %d of client %d out of order",
+             preq->rank, preq->client);
+      last[preq->client] = preq->rank;
+      served[preq->client] += 1;
+    }
+
+  EQUALS(served[0], 30, "client of weight 3 served %u times", served[0]);
+  EQUALS(served[1], 10, "client of weight 1 served %u times", served[1]);
+
+  drain();
+}
+
+void exportcheck()
+{
+  unsigned int served[4] = { 0, 0, 0, 0 };
+  request_t *preq;
+  int i;
+
+  EQUALS(nfs_fair_share_set_export(2, 2, 0), NFS_FAIR_SHARE_SUCCESS, "cannot set export 2");
+  EQUALS(nfs_fair_share_set_export(3, 0, 0), NFS_FAIR_SHARE_SUCCESS, "cannot set export 3");
+  EQUALS(nfs_fair_share_set_export(3, NFS_FAIR_SHARE_MAX_WEIGHT + 1, 0), -1,
+         "weight out of range accepted");
+
+  for(i = 0; i < 30; i++)
+    {
+      enqueue(2, 3, i);
+      enqueue(2, 2, i);
+    }
+
+  for(i = 0; i < 30; i++)
+    {
+      preq = (request_t *) nfs_fair_share_dequeue();
+      EQUALS(preq != NULL, 1, "nothing to serve after %d requests", i);
+      served[preq->exportid] += 1;
+    }
+
+  EQUALS(served[2], 20, "export of weight 2 served %u times", served[2]);
+  EQUALS(served[3], 10, "export of weight 1 served %u times", served[3]);
+
+  drain();
+}
+
+void boundcheck()
+{
+  nfs_fair_share_entry_t entry;
+  nfs_fair_share_stats_t stats;
+  sockaddr_t addr;
+  char str[32];
+  int i;
+
+  /* Only the most recently idle clients are remembered */
+  for(i = 0; i < 2 * NFS_FAIR_SHARE_IDLE_CLIENTS; i++)
+    {
+      snprintf(str, sizeof(str), "10.20.%d.%d", i / 250, 1 + i % 250);
+      set_addr(&addr, str);
+      EQUALS(nfs_fair_share_enqueue(&entry, &addr, 1, &entry), NFS_FAIR_SHARE_SUCCESS,
+             "request of %s not queued", str);
+      EQUALS(nfs_fair_share_dequeue(), &entry, "request of %s not served", str);
+    }
+
+  nfs_fair_share_get_stats(&stats);
+  EQUALS(stats.nb_idle_clients, NFS_FAIR_SHARE_IDLE_CLIENTS, "%u idle clients kept",
+         stats.nb_idle_clients);
+  EQUALS(stats.nb_clients, NFS_FAIR_SHARE_IDLE_CLIENTS, "%u clients kept", stats.nb_clients);
+}
+
+void idlecheck()
+{
+  unsigned int served = 0;
+  int i;
+
+  /* One request at a time: the queue of the capped client drains after each
+   * of them, but its bucket is not filled again */
+  for(i = 0; i < 3 * CAP; i++)
+    {
+      enqueue(5, 1, i);
+      if(nfs_fair_share_dequeue() == NULL)
+        break;
+      served += 1;
+    }
+
+  EQUALS(served, CAP, "capped client served %u times one request at a time", served);
+  EQUALS(nfs_fair_share_length(), 1, "%u requests held", nfs_fair_share_length());
+
+  /* The held request goes with the next token */
+  usleep(2 * 1000000 / CAP);
+  EQUALS(nfs_fair_share_dequeue() != NULL, 1, "held request not served");
+
+  drain();
+}
+
+void capcheck()
+{
+  unsigned int served[5] = { 0, 0, 0, 0, 0 };
+  nfs_fair_share_stats_t stats;
+  request_t *preq;
+  int i;
+
+  for(i = 0; i < 3 * CAP; i++)
+    enqueue(3, 1, i);
+  for(i = 0; i < 5; i++)
+    enqueue(4, 1, i);
+
+  /* The capped client has a burst of one second of requests */
+  while((preq = (request_t *) nfs_fair_share_dequeue()) != NULL)
+    served[preq->client] += 1;
+
+  EQUALS(served[3], CAP, "capped client served %u times", served[3]);
+  EQUALS(served[4], 5, "other client served %u times", served[4]);
+  EQUALS(nfs_fair_share_length(), 2 * CAP, "%u requests held", nfs_fair_share_length());
+
+  nfs_fair_share_get_stats(&stats);
+  EQUALS(stats.nb_throttled > 0, 1, "held flow not counted");
+
+  /* A quarter of a second brings a quarter of the rate */
+  usleep(250000);
+  served[3] = 0;
+  while((preq = (request_t *) nfs_fair_share_dequeue()) != NULL)
+    served[preq->client] += 1;
+  EQUALS(served[3] >= CAP / 5 && served[3] <= CAP / 2, 1,
+         "capped client served %u times after 250ms", served[3]);
+
+  /* An export cap holds the requests of every client */
+  EQUALS(nfs_fair_share_set_export(4, 0, CAP), NFS_FAIR_SHARE_SUCCESS, "cannot cap export 4");
+  nb_requests = 0;
+  for(i = 0; i < 2 * CAP; i++)
+    enqueue(i % 2, 4, i);
+  for(i = 0; nfs_fair_share_dequeue() != NULL; i++) ;
+  EQUALS(i, CAP, "capped export served %d times", i);
+}
+
+int main()
+{
+#ifndef _NO_BUDDY_SYSTEM
+  BuddyInit(NULL);
+#endif
+
+  set_addr(&addrs[0], "10.10.5.1");
+  set_addr(&addrs[1], "10.10.5.2");
+  set_addr(&addrs[2], "10.10.5.3");
+  set_addr(&addrs[3], "10.10.5.4");
+  set_addr(&addrs[4], "10.10.5.5");
+  set_addr(&addrs[5], "10.10.5.6");
+
+  disabledcheck();
+  init();
+  clientcheck();
+  exportcheck();
+  boundcheck();
+  idlecheck();
+  capcheck();
+
+  printf("PASSED\n");
+  return 0;
+}
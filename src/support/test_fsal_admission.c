@@ -0,0 +1,234 @@
+/*
+ * vim:expandtab:shiftwidth=8:tabstop=8:
+ *
+ * Test of the FSAL admission windows: a full window makes calls wait, then
+ * refuses them, congestion shrinks the window down to its minimum, a busy
+ * window without congestion grows back, slow calls are congestion, and the
+ * state of a removed export is reused once its calls are done.
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "stuff_alloc.h"
+#include "fsal_admission.h"
+
+#define MIN_WINDOW  2
+#define MAX_WINDOW  8
+
+#define EQUALS(a, b, msg, args...) do {             \
+  if (a != b) {                             \
+      printf(msg "\n", ## args);                          \
+      exit(1);                                    \
+    }                                             \
+} while(0)
+
+int export_a;
+int export_b;
+int export_c;
+int export_d;
+int export_e;
+
+void init(unsigned int tolerance)
+{
+  fsal_admit_parameter_t param;
+
+  param.enabled = 1;
+  param.min_window = MIN_WINDOW;
+  param.max_window = MAX_WINDOW;
+  param.tolerance = tolerance;
+  param.base_period = 1000;
+
+  EQUALS(fsal_admit_init(&param), FSAL_ADMIT_SUCCESS, "cannot init the windows");
+}
+
+fsal_admit_stats_t get_stats(void *key, fsal_admit_class_t class)
+{
+  fsal_admit_stats_t stats;
+
+  EQUALS(fsal_admit_get_stats(key, class, &stats), FSAL_ADMIT_SUCCESS, "no window");
+  return stats;
+}
+
+void *waiter(void *arg)
+{
+  fsal_admit_ticket_t ticket;
+
+  EQUALS(fsal_admit_enter(&ticket, &export_a, FSAL_ADMIT_DATA, 1), FSAL_ADMIT_SUCCESS,
+         "waiting call refused");
+  fsal_admit_exit(&ticket, 0);
+  return NULL;
+}
+
+void disabledcheck()
+{
+  fsal_admit_ticket_t ticket;
+  fsal_admit_parameter_t param;
+
+  EQUALS(fsal_admit_enter(&ticket, &export_a, FSAL_ADMIT_DATA, 1), FSAL_ADMIT_SUCCESS,
+         "call refused before init");
+  EQUALS(ticket.queue, NULL, "call counted before init");
+  fsal_admit_exit(&ticket, 0);
+
+  memset(&param, 0, sizeof(param));
+  param.min_window = MAX_WINDOW;
+  param.max_window = MIN_WINDOW;
+  param.tolerance = 200;
+  param.base_period = 1;
+  EQUALS(fsal_admit_init(&param), -1, "inconsistent windows accepted");
+}
+
+void waitcheck()
+{
+  fsal_admit_ticket_t tickets[MAX_WINDOW];
+  fsal_admit_ticket_t ticket;
+  pthread_t threads[MAX_WINDOW];
+  unsigned int i;
+
+  for(i = 0; i < MAX_WINDOW; i++)
+    EQUALS(fsal_admit_enter(&tickets[i], &export_a, FSAL_ADMIT_DATA, 1), FSAL_ADMIT_SUCCESS,
+           "call %u refused", i);
+
+  /* The metadata window is another one */
+  EQUALS(fsal_admit_enter(&ticket, &export_a, FSAL_ADMIT_METADATA, 1), FSAL_ADMIT_SUCCESS,
+         "metadata call refused");
+  fsal_admit_exit(&ticket, 0);
+
+  for(i = 0; i < MAX_WINDOW; i++)
+    pthread_create(&threads[i], NULL, waiter, NULL);
+  while(get_stats(&export_a, FSAL_ADMIT_DATA).waiting < MAX_WINDOW)
+    usleep(1000);
+
+  EQUALS(fsal_admit_enter(&ticket, &export_a, FSAL_ADMIT_DATA, 1), FSAL_ADMIT_REFUSED,
+         "call admitted beyond the waiters");
+  EQUALS(get_stats(&export_a, FSAL_ADMIT_DATA).nb_refused, 1, "refusal not counted");
+
+  for(i = 0; i < MAX_WINDOW; i++)
+    fsal_admit_exit(&tickets[i], 0);
+  for(i = 0; i < MAX_WINDOW; i++)
+    pthread_join(threads[i], NULL);
+
+  EQUALS(get_stats(&export_a, FSAL_ADMIT_DATA).inflight, 0, "calls left in progress");
+  EQUALS(get_stats(&export_a, FSAL_ADMIT_DATA).nb_admitted, 2 * MAX_WINDOW, "wrong count of calls");
+  EQUALS(get_stats(&export_a, FSAL_ADMIT_DATA).nb_waited, MAX_WINDOW, "wrong count of waits");
+}
+
+void aimdcheck()
+{
+  fsal_admit_ticket_t tickets[MAX_WINDOW];
+  fsal_admit_ticket_t ticket;
+  fsal_admit_stats_t stats;
+  unsigned int i;
+
+  /* Congestion shrinks the window down to its minimum */
+  for(i = 0; i < 100; i++)
+    {
+      EQUALS(fsal_admit_enter(&ticket, &export_b, FSAL_ADMIT_METADATA, 0), FSAL_ADMIT_SUCCESS,
+             "congested call refused");
+      fsal_admit_exit(&ticket, 1);
+    }
+  stats = get_stats(&export_b, FSAL_ADMIT_METADATA);
+  EQUALS(stats.window, MIN_WINDOW, "window %u after congestion", stats.window);
+  EQUALS(stats.nb_decrease, 4, "%llu decreases", (unsigned long long)stats.nb_decrease);
+
+  /* A call alone does not use the window, it does not grow it */
+  for(i = 0; i < 100; i++)
+    {
+      fsal_admit_enter(&ticket, &export_b, FSAL_ADMIT_METADATA, 0);
+      fsal_admit_exit(&ticket, 0);
+    }
+  EQUALS(get_stats(&export_b, FSAL_ADMIT_METADATA).window, MIN_WINDOW, "idle window grew");
+
+  /* A full window grows by one each time a window of calls completes */
+  for(i = 0; i < MIN_WINDOW; i++)
+    fsal_admit_enter(&tickets[i], &export_b, FSAL_ADMIT_METADATA, 0);
+  for(i = 0; i < 1000; i++)
+    {
+      fsal_admit_exit(&tickets[i % MIN_WINDOW], 0);
+      fsal_admit_enter(&tickets[i % MIN_WINDOW], &export_b, FSAL_ADMIT_METADATA, 0);
+      stats = get_stats(&export_b, FSAL_ADMIT_METADATA);
+      if(stats.window > MIN_WINDOW)
+        break;
+    }
+  EQUALS(i, MIN_WINDOW - 1, "window grew after %u calls", i + 1);
+  for(i = 0; i < MIN_WINDOW; i++)
+    fsal_admit_exit(&tickets[i], 0);
+}
+
+void latencycheck()
+{
+  fsal_admit_ticket_t ticket;
+  fsal_admit_stats_t stats;
+  unsigned int i;
+
+  for(i = 0; i < MAX_WINDOW / 2; i++)
+    {
+      fsal_admit_enter(&ticket, &export_c, FSAL_ADMIT_DATA, 0);
+      fsal_admit_exit(&ticket, 0);
+    }
+
+  /* Calls far slower than the fast ones are congestion */
+  for(i = 0; i < 20; i++)
+    {
+      fsal_admit_enter(&ticket, &export_c, FSAL_ADMIT_DATA, 0);
+      usleep(20000);
+      fsal_admit_exit(&ticket, 0);
+    }
+  stats = get_stats(&export_c, FSAL_ADMIT_DATA);
+  EQUALS(stats.nb_decrease > 0, 1, "slow calls did not shrink the window");
+  EQUALS(stats.window < MAX_WINDOW, 1, "window %u after slow calls", stats.window);
+}
+
+void releasecheck()
+{
+  fsal_admit_ticket_t ticket;
+  fsal_admit_ticket_t held;
+  fsal_admit_stats_t stats;
+
+  /* A removed export forgets its windows, the next export starts afresh */
+  fsal_admit_release(&export_c);
+  EQUALS(fsal_admit_get_stats(&export_c, FSAL_ADMIT_DATA, &stats), -1,
+         "removed export still known");
+
+  fsal_admit_enter(&ticket, &export_d, FSAL_ADMIT_DATA, 0);
+  stats = get_stats(&export_d, FSAL_ADMIT_DATA);
+  EQUALS(stats.window, MAX_WINDOW, "window %u of a new export", stats.window);
+  EQUALS(stats.nb_admitted, 1, "%llu calls of a new export",
+         (unsigned long long)stats.nb_admitted);
+  fsal_admit_exit(&ticket, 0);
+
+  /* The state of an export with a call in progress is not reused */
+  fsal_admit_enter(&held, &export_d, FSAL_ADMIT_METADATA, 0);
+  fsal_admit_release(&export_d);
+  fsal_admit_enter(&ticket, &export_e, FSAL_ADMIT_METADATA, 0);
+  fsal_admit_exit(&held, 0);
+  EQUALS(get_stats(&export_e, FSAL_ADMIT_METADATA).inflight, 1,
+         "state reused while a call held it");
+  fsal_admit_exit(&ticket, 0);
+}
+
+int main()
+{
+#ifndef _NO_BUDDY_SYSTEM
+  BuddyInit(NULL);
+#endif
+
+  disabledcheck();
+
+  /* Tiny calls have a noisy latency, only the flag is congestion */
+  init(1000000);
+  waitcheck();
+  aimdcheck();
+
+  init(200);
+  latencycheck();
+  releasecheck();
+
+  printf("PASSED\n");
+  return 0;
+}
@@ -8,6 +8,8 @@
 #include <stdlib.h>
 #include <string.h>
 #include <arpa/inet.h>
+#include <pthread.h>
+#include <unistd.h>
 #include "../MainNFSD/nfs_init.h"
 #include "nfs23.h"
 
@@ -46,6 +48,16 @@ void *rpc_tcp_socket_manager_thread(void *Arg)
   return NULL;
 }
 
+int nfs_rpc_add_conn(int sock)
+{
+  return 0;
+}
+
+bool_t nfs_rpc_conn_pending(int sock, unsigned int pending)
+{
+  return FALSE;
+}
+
 void create_ipv4(char * ip, int port, struct sockaddr_in * addr) 
 {
     memset(addr, 0, sizeof(struct sockaddr_in));
@@ -82,6 +94,10 @@ void nfs_set_ip_name_param_default()
     nfs_param.ip_name_param.hash_param.val_to_str = display_ip_name_val;
     nfs_param.ip_name_param.hash_param.name = "IP Name";
     nfs_param.ip_name_param.expiration_time = IP_NAME_EXPIRATION;
+    nfs_param.ip_name_param.negative_expiration_time = IP_NAME_NEGATIVE_EXPIRATION;
+    nfs_param.ip_name_param.resolver_threads = IP_NAME_RESOLVER_THREADS;
+    nfs_param.ip_name_param.resolve_timeout = IP_NAME_RESOLVE_TIMEOUT;
+    nfs_param.ip_name_param.max_entries = IP_NAME_MAX_ENTRIES;
     strncpy(nfs_param.ip_name_param.mapfile, "", MAXPATHLEN);
 
     nfs_param.core_param.dump_stats_per_client = 1;
@@ -92,6 +108,10 @@ void init()
 {
     BuddyInit(NULL);
 
+#ifndef _NO_BUDDY_SYSTEM
+    /* The resolver threads have their own memory manager */
+    Buddy_set_default_parameter(&nfs_param.buddy_param_worker);
+#endif
     nfs_set_ip_name_param_default();
     nfs_Init_ip_name(nfs_param.ip_name_param);
 
@@ -247,6 +267,67 @@ void test_remove_6()
     test_not_found_none_6();
 }
 
+// Resolver threads, run against a stub resolver
+//
+//
+
+unsigned int stub_calls = 0;
+
+/* Names 10.0.0.<even>, fails on 10.0.0.<odd>, and takes its time doing so */
+int stub_resolver(sockaddr_t *ipaddr, char *hostname, size_t len)
+{
+    unsigned char *bytes = (unsigned char *)&((struct sockaddr_in *)ipaddr)->sin_addr;
+
+    __sync_fetch_and_add(&stub_calls, 1);
+    usleep(200000);
+
+    if (bytes[3] & 1)
+        return EAI_NONAME;
+
+    snprintf(hostname, len, "stub-%u", bytes[3]);
+    return 0;
+}
+
+void *resolve_thread(void *arg)
+{
+    char name[MAXHOSTNAMELEN];
+    int rc = nfs_ip_name_resolve((sockaddr_t *)arg, name);
+
+    EQUALS(rc, IP_NAME_SUCCESS, "Can't resolve through the resolver threads, rc = %d", rc);
+    CMP(name, "stub-2", MAXHOSTNAMELEN, "Wrong name from the resolver threads");
+    return NULL;
+}
+
+void test_resolver()
+{
+    sockaddr_t good, bad;
+    pthread_t thr[8];
+    int i, rc;
+
+    nfs_ip_name_set_resolver(stub_resolver);
+    create_ipv4("10.0.0.2", 2048, (struct sockaddr_in *) &good);
+    create_ipv4("10.0.0.3", 2048, (struct sockaddr_in *) &bad);
+
+    /* Concurrent requests for the same address share one DNS query */
+    for (i = 0; i < 8; i++)
+        pthread_create(&thr[i], NULL, resolve_thread, &good);
+    for (i = 0; i < 8; i++)
+        pthread_join(thr[i], NULL);
+    EQUALS(stub_calls, 1, "Requests were not coalesced, %u DNS queries", stub_calls);
+
+    EQUALS(nfs_ip_name_get(&good, out), IP_NAME_SUCCESS, "There should be a 10.0.0.2");
+
+    /* Failures are cached as well */
+    rc = nfs_ip_name_resolve(&bad, out);
+    EQUALS(rc, IP_NAME_NETDB_ERROR, "10.0.0.3 shouldn't resolve, rc = %d", rc);
+    rc = nfs_ip_name_resolve(&bad, out);
+    EQUALS(rc, IP_NAME_NETDB_ERROR, "10.0.0.3 should be negatively cached, rc = %d", rc);
+    EQUALS(stub_calls, 2, "Negative entry was not cached, %u DNS queries", stub_calls);
+
+    EQUALS(nfs_ip_name_remove(&bad), IP_NAME_SUCCESS, "Can't remove 10.0.0.3");
+    nfs_ip_name_set_resolver(NULL);
+}
+
 //
 
 int main()
@@ -270,5 +351,7 @@ int main()
     }
 #endif
 
+    test_resolver();
+
     return 0;
 }
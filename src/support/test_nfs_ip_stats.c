@@ -44,6 +44,16 @@ void *rpc_tcp_socket_manager_thread(void *Arg)
   return NULL;
 }
 
+int nfs_rpc_add_conn(int sock)
+{
+  return 0;
+}
+
+bool_t nfs_rpc_conn_pending(int sock, unsigned int pending)
+{
+  return FALSE;
+}
+
 void create_ipv4(char * ip, int port, struct sockaddr_in * addr) 
 {
     memset(addr, 0, sizeof(struct sockaddr_in));
@@ -0,0 +1,112 @@
+/*
+ * vim:expandtab:shiftwidth=8:tabstop=8:
+ *
+ * Test of the lock-free request queue: several producers and consumers
+ * exchange entries concurrently, every entry must be received exactly once.
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+#include "stuff_alloc.h"
+#include "nfs_req_queue.h"
+
+#define NB_PRODUCER    4
+#define NB_CONSUMER    4
+#define NB_PER_PRODUCER 200000
+#define QUEUE_SIZE     64
+
+#define EQUALS(a, b, msg, args...) do {             \
+  if (a != b) {                             \
+      printf(msg "\n", ## args);                          \
+      exit(1);                                    \
+    }                                             \
+} while(0)
+
+req_queue_t queue;
+unsigned long values[NB_PRODUCER * NB_PER_PRODUCER];
+unsigned char seen[NB_PRODUCER * NB_PER_PRODUCER];
+unsigned long nb_consumed = 0;
+
+void *producer(void *arg)
+{
+  unsigned long first = (unsigned long)arg * NB_PER_PRODUCER;
+  unsigned long i;
+
+  for(i = first; i < first + NB_PER_PRODUCER; i++)
+    while(req_queue_push(&queue, &values[i]) != REQ_QUEUE_SUCCESS)
+      sched_yield();
+
+  return NULL;
+}
+
+void *consumer(void *arg)
+{
+  unsigned long *pval;
+
+  while(__sync_fetch_and_add(&nb_consumed, 0) < NB_PRODUCER * NB_PER_PRODUCER)
+    {
+      if((pval = req_queue_pop(&queue)) == NULL)
+        {
+          sched_yield();
+          continue;
+        }
+      seen[*pval] += 1;
+      __sync_fetch_and_add(&nb_consumed, 1);
+    }
+
+  return NULL;
+}
+
+int main(int argc, char *argv[])
+{
+  pthread_t prod[NB_PRODUCER];
+  pthread_t cons[NB_CONSUMER];
+  unsigned long i;
+  int dummy;
+
+#ifndef _NO_BUDDY_SYSTEM
+  BuddyInit(NULL);
+#endif
+
+  EQUALS(req_queue_init(&queue, 3), REQ_QUEUE_SUCCESS, "init failed");
+
+  /* Single threaded behaviour: size 3 is rounded up to 4 */
+  for(i = 0; i < 4; i++)
+    EQUALS(req_queue_push(&queue, &dummy), REQ_QUEUE_SUCCESS, "push %lu failed", i);
+  EQUALS(req_queue_push(&queue, &dummy), REQ_QUEUE_FULL, "queue should be full");
+  EQUALS(req_queue_length(&queue), 4, "queue length should be 4");
+  for(i = 0; i < 4; i++)
+    EQUALS(req_queue_pop(&queue), (void *)&dummy, "pop %lu failed", i);
+  EQUALS(req_queue_pop(&queue), NULL, "queue should be empty");
+  EQUALS(req_queue_length(&queue), 0, "queue length should be 0");
+
+  /* Concurrent behaviour */
+  EQUALS(req_queue_init(&queue, QUEUE_SIZE), REQ_QUEUE_SUCCESS, "init failed");
+
+  for(i = 0; i < NB_PRODUCER * NB_PER_PRODUCER; i++)
+    values[i] = i;
+
+  for(i = 0; i < NB_CONSUMER; i++)
+    pthread_create(&cons[i], NULL, consumer, NULL);
+  for(i = 0; i < NB_PRODUCER; i++)
+    pthread_create(&prod[i], NULL, producer, (void *)i);
+
+  for(i = 0; i < NB_PRODUCER; i++)
+    pthread_join(prod[i], NULL);
+  for(i = 0; i < NB_CONSUMER; i++)
+    pthread_join(cons[i], NULL);
+
+  for(i = 0; i < NB_PRODUCER * NB_PER_PRODUCER; i++)
+    EQUALS(seen[i], 1, "entry %lu was received %d times", i, seen[i]);
+
+  EQUALS(req_queue_pop(&queue), NULL, "queue should be empty");
+
+  printf("PASSED\n");
+  return 0;
+}
@@ -0,0 +1,157 @@
+/*
+ * vim:expandtab:shiftwidth=8:tabstop=8:
+ *
+ * Test of the statistics registry: bucket boundaries, percentiles, and
+ * several threads recording while snapshots are taken, the final snapshot
+ * must hold exactly what was recorded.
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "stuff_alloc.h"
+#include "nfs_stat_registry.h"
+
+#define NB_THREADS     4
+#define NB_PER_THREAD  200000
+
+#define EQUALS(a, b, msg, args...) do {             \
+  if (a != b) {                             \
+      printf(msg "\n", ## args);                          \
+      exit(1);                                    \
+    }                                             \
+} while(0)
+
+int counter;
+int histogram;
+volatile int running = 1;
+
+void *recorder(void *arg)
+{
+  unsigned long i;
+
+  for(i = 1; i <= NB_PER_THREAD; i++)
+    {
+      nfs_stat_counter_add(counter, 2);
+      nfs_stat_histogram_record(histogram, i * 1000);
+    }
+
+  return NULL;
+}
+
+void *reader(void *arg)
+{
+  nfs_stat_snapshot_t *psnap;
+  unsigned long long total;
+  unsigned int i;
+
+#ifndef _NO_BUDDY_SYSTEM
+  BuddyInit(NULL);
+#endif
+
+  while(running)
+    {
+      psnap = nfs_stat_snapshot_take();
+
+      /* Every histogram copy is consistent: its buckets add up to its count */
+      for(i = 0, total = 0; i < NFS_STAT_HISTO_BUCKETS; i++)
+        total += psnap->histograms[histogram].buckets[i];
+      EQUALS(total, psnap->histograms[histogram].count,
+             "inconsistent snapshot: %llu in buckets, count %llu", total,
+             (unsigned long long)psnap->histograms[histogram].count);
+
+      nfs_stat_snapshot_free(psnap);
+    }
+
+  return NULL;
+}
+
+int main(int argc, char *argv[])
+{
+  pthread_t threads[NB_THREADS];
+  pthread_t snapper;
+  nfs_stat_snapshot_t *psnap;
+  nfs_stat_histogram_t histo;
+  unsigned long long sum;
+  uint64_t value;
+  unsigned int bucket;
+  unsigned long i;
+  FILE *stream;
+  char buf[4096];
+
+#ifndef _NO_BUDDY_SYSTEM
+  BuddyInit(NULL);
+#endif
+
+  /* Every value is below the bound of its bucket and above the previous one */
+  for(value = 0; value < (1ULL << 20); value++)
+    {
+      bucket = nfs_stat_histogram_bucket(value);
+      EQUALS((value <= nfs_stat_histogram_bucket_max(bucket)), 1,
+             "%llu above the bound of bucket %u", (unsigned long long)value, bucket);
+      if(bucket > 0)
+        EQUALS((value > nfs_stat_histogram_bucket_max(bucket - 1)), 1,
+               "%llu fits in bucket %u", (unsigned long long)value, bucket - 1);
+    }
+  EQUALS(nfs_stat_histogram_bucket(~0ULL), NFS_STAT_HISTO_BUCKETS - 1,
+         "huge values must go to the last bucket");
+
+  /* Percentiles of 1..1000 are within the bucket error */
+  memset(&histo, 0, sizeof(histo));
+  for(value = 1; value <= 1000; value++)
+    {
+      histo.buckets[nfs_stat_histogram_bucket(value)] += 1;
+      histo.count += 1;
+    }
+  histo.max = 1000;
+  value = nfs_stat_histogram_percentile(&histo, 50.0);
+  EQUALS((value >= 500 && value <= 500 + 500 / 8), 1, "p50 is %llu", (unsigned long long)value);
+  value = nfs_stat_histogram_percentile(&histo, 99.0);
+  EQUALS((value >= 990 && value <= 1000), 1, "p99 is %llu", (unsigned long long)value);
+
+  /* Registration is idempotent */
+  counter = nfs_stat_register_counter("test.counter");
+  histogram = nfs_stat_register_histogram("test.latency");
+  EQUALS(nfs_stat_register_counter("test.counter"), counter, "counter registered twice");
+  EQUALS(nfs_stat_register_histogram("test.latency"), histogram, "histogram registered twice");
+  EQUALS(nfs_stat_lookup_histogram("test.latency"), histogram, "histogram not found");
+  EQUALS(nfs_stat_lookup_histogram("test.unknown"), -1, "unknown histogram found");
+
+  /* Concurrent recording while snapshots are taken */
+  pthread_create(&snapper, NULL, reader, NULL);
+  for(i = 0; i < NB_THREADS; i++)
+    pthread_create(&threads[i], NULL, recorder, NULL);
+  for(i = 0; i < NB_THREADS; i++)
+    pthread_join(threads[i], NULL);
+  running = 0;
+  pthread_join(snapper, NULL);
+
+  psnap = nfs_stat_snapshot_take();
+  sum = (unsigned long long)NB_PER_THREAD * (NB_PER_THREAD + 1) / 2 * 1000 * NB_THREADS;
+
+  EQUALS(psnap->counters[counter], 2ULL * NB_PER_THREAD * NB_THREADS, "counter is %llu",
+         (unsigned long long)psnap->counters[counter]);
+  EQUALS(psnap->histograms[histogram].count, (unsigned long long)NB_PER_THREAD * NB_THREADS,
+         "count is %llu", (unsigned long long)psnap->histograms[histogram].count);
+  EQUALS(psnap->histograms[histogram].sum, sum, "sum is %llu",
+         (unsigned long long)psnap->histograms[histogram].sum);
+  EQUALS(psnap->histograms[histogram].max, NB_PER_THREAD * 1000ULL, "max is %llu",
+         (unsigned long long)psnap->histograms[histogram].max);
+
+  /* JSON output */
+  memset(buf, 0, sizeof(buf));
+  stream = fmemopen(buf, sizeof(buf) - 1, "w");
+  nfs_stat_snapshot_print_json(stream, psnap);
+  fclose(stream);
+  EQUALS((strstr(buf, "\"test.counter\": 1600000") != NULL), 1, "bad JSON: %s", buf);
+  EQUALS((strstr(buf, "\"test.latency\": {\"count\": 800000,") != NULL), 1, "bad JSON: %s", buf);
+
+  nfs_stat_snapshot_free(psnap);
+
+  printf("PASSED\n");
+  return 0;
+}